@@ -33,6 +33,94 @@ blconf_perl_ghashtable_to_hv(gpointer key,
     hv_store(hv, (const char *)key, strlen(key), val_sv, 0);
 }
 
+/* like gperl_sv_from_value(), but an array comes back as a reference
+ * to one, so the value fits in a single scalar */
+static SV *
+blconf_perl_sv_from_value(const GValue *value)
+{
+    if(G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY) {
+        GPtrArray *arr = g_value_get_boxed(value);
+        AV *av = newAV();
+        guint i;
+
+        for(i = 0; arr && i < arr->len; ++i)
+            av_push(av, gperl_sv_from_value(g_ptr_array_index(arr, i)));
+
+        return newRV_noinc((SV *)av);
+    }
+
+    return gperl_sv_from_value(value);
+}
+
+static void
+blconf_perl_ghashtable_to_hv_ref(gpointer key,
+                                 gpointer valuep,
+                                 gpointer data)
+{
+    HV *hv = (HV *)data;
+    SV *val_sv = blconf_perl_sv_from_value((GValue *)valuep);
+
+    hv_store(hv, (const char *)key, strlen(key), val_sv, 0);
+}
+
+static GType
+blconf_perl_guess_gtype(SV *sv)
+{
+    if(SvNOKp(sv))
+        return G_TYPE_DOUBLE;
+    else if(SvIOKp(sv))
+        return G_TYPE_INT;
+    else
+        return G_TYPE_STRING;
+}
+
+/* fills |value| from |sv|, guessing the types the way set_array does
+ * without a types array.  an array reference becomes an array.
+ * returns FALSE if |sv| can't be stored */
+static gboolean
+blconf_perl_value_from_sv(GValue *value,
+                          SV *sv)
+{
+    if(!sv || !SvOK(sv))
+        return FALSE;
+
+    if(SvROK(sv)) {
+        GPtrArray *arr;
+        AV *av;
+        gint num_elements, i;
+
+        if(SvTYPE(SvRV(sv)) != SVt_PVAV)
+            return FALSE;
+
+        av = (AV *)SvRV(sv);
+        num_elements = av_len(av) + 1;
+        arr = g_ptr_array_sized_new(num_elements);
+        for(i = 0; i < num_elements; ++i) {
+            SV **val_sv = av_fetch(av, i, 0);
+            GValue *arrval;
+
+            if(!val_sv || !*val_sv || !SvOK(*val_sv) || SvROK(*val_sv)) {
+                blconf_array_free(arr);
+                return FALSE;
+            }
+
+            arrval = g_new0(GValue, 1);
+            g_value_init(arrval, blconf_perl_guess_gtype(*val_sv));
+            gperl_value_from_sv(arrval, *val_sv);
+
+            g_ptr_array_add(arr, arrval);
+        }
+
+        g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+        g_value_take_boxed(value, arr);
+    } else {
+        g_value_init(value, blconf_perl_guess_gtype(sv));
+        gperl_value_from_sv(value, sv);
+    }
+
+    return TRUE;
+}
+
 MODULE = Xfce4::Blconf::Channel    PACKAGE = Xfce4::Blconf::Channel    PREFIX = blconf_channel_
 PROTOTYPES: ENABLE
 
@@ -111,6 +199,88 @@ blconf_channel_get_property(channel, property, default_value=NULL)
             g_value_unset(&val);
         }
 
+HV *
+blconf_channel_get_many(channel, ...)
+        BlconfChannel * channel
+    PREINIT:
+        GHashTable *properties;
+        const gchar **names;
+        gint i;
+    CODE:
+        names = g_new0(const gchar *, items);
+        for(i = 1; i < items; ++i)
+            names[i - 1] = SvGChar(ST(i));
+        properties = blconf_channel_get_many(channel, names);
+        g_free(names);
+        if(!properties)
+            RETVAL = (HV *)&PL_sv_undef;
+        else {
+            RETVAL = newHV();
+            g_hash_table_foreach(properties,
+                                 blconf_perl_ghashtable_to_hv_ref,
+                                 RETVAL);
+            sv_2mortal((SV *)RETVAL);
+            g_hash_table_destroy(properties);
+        }
+        ST(0) = (SV *)RETVAL;  /* why isn't xsubpp doing this for us? */
+
+gboolean
+blconf_channel_set_many(channel, properties)
+        BlconfChannel * channel
+        SV * properties
+    PREINIT:
+        GHashTable *values;
+        HV *hv;
+        HE *he;
+    CODE:
+        if(!SvROK(properties) || SvTYPE(SvRV(properties)) != SVt_PVHV)
+            croak("Usage: Xfce4::Blconf::Channel::set_many(\\%properties)");
+
+        values = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)_blconf_gvalue_free);
+
+        hv = (HV *)SvRV(properties);
+        hv_iterinit(hv);
+        while((he = hv_iternext(hv))) {
+            I32 len;
+            const gchar *property = hv_iterkey(he, &len);
+            GValue *value = g_new0(GValue, 1);
+
+            if(!blconf_perl_value_from_sv(value, hv_iterval(hv, he))) {
+                g_free(value);
+                g_hash_table_destroy(values);
+                croak("Xfce4::Blconf::Channel::set_many(): invalid value for property '%s'", property);
+            }
+
+            g_hash_table_insert(values, g_strdup(property), value);
+        }
+
+        RETVAL = blconf_channel_set_properties(channel, values);
+        g_hash_table_destroy(values);
+        /* why isn't xsubpp doing this for us? */
+        ST(0) = sv_2mortal(boolSV(RETVAL));
+
+gchar_own *
+blconf_channel_get_next_property(channel, property=NULL)
+        BlconfChannel * channel
+        const gchar_ornull * property
+
+SV *
+_fetch(channel, property)
+        BlconfChannel * channel
+        const gchar * property
+    PREINIT:
+        GValue val = { 0, };
+    CODE:
+        if(blconf_channel_get_property(channel, property, &val)) {
+            RETVAL = blconf_perl_sv_from_value(&val);
+            g_value_unset(&val);
+        } else
+            RETVAL = newSVsv(&PL_sv_undef);
+    OUTPUT:
+        RETVAL
+
 gboolean
 _set_property(channel, property, value, arraytypes=NULL)
         BlconfChannel * channel
@@ -193,12 +363,7 @@ _set_property(channel, property, value, arraytypes=NULL)
                 if(gtype == G_TYPE_INVALID) {
                     if(av_types)
                         warn("Xfce4::Blconf::Channel::set_array(): unable to determine type at index %d; guessing", i);
-                    if(SvNOKp(*val_sv))
-                        gtype = G_TYPE_DOUBLE;
-                    else if(SvIOKp(*val_sv))
-                        gtype = G_TYPE_INT;
-                    else
-                        gtype = G_TYPE_STRING;
+                    gtype = blconf_perl_guess_gtype(*val_sv);
                 }
 
                 if(gtype == G_TYPE_NONE || gtype == BLCONF_TYPE_G_VALUE_ARRAY) {
@@ -73,6 +73,19 @@ static gchar *channel_name = NULL;
 static gchar *property_name = NULL;
 static gchar **set_value = NULL;
 static gchar **type = NULL;
+static gchar *import_file = NULL;
+static gboolean export = FALSE;
+static gboolean batch = FALSE;
+static GPatternSpec *monitor_pattern = NULL;
+static guint monitor_flush_id = 0;
+
+typedef struct
+{
+    FILE *fp;
+    const gchar *filename;
+    guint lineno;
+    GString *line;
+} BlconfQueryReader;
 
 static void
 blconf_query_monitor (BlconfChannel *channel, const gchar *changed_property, GValue *property_value)
@@ -101,6 +114,259 @@ blconf_query_monitor (BlconfChannel *channel, const gchar *changed_property, GVa
     }
 }
 
+/* Monitoring every channel (or those matching a glob) doesn't go
+ * through BlconfChannel at all: there is a single subscription to the
+ * daemon's PropertiesChanged signal, which carries all of a channel's
+ * changes from one main loop iteration, and each change is written
+ * out as a line of JSON.  Output is block-buffered and flushed once
+ * things quiet down, so bursts turn into a few large writes. */
+
+static void
+blconf_query_json_append_string(GString *out,
+                                const gchar *str)
+{
+    const gchar *p;
+
+    g_string_append_c(out, '"');
+    for(p = str; *p; ++p) {
+        switch(*p) {
+            case '"':
+                g_string_append(out, "\\\"");
+                break;
+            case '\\':
+                g_string_append(out, "\\\\");
+                break;
+            case '\n':
+                g_string_append(out, "\\n");
+                break;
+            case '\t':
+                g_string_append(out, "\\t");
+                break;
+            default:
+                if((guchar)*p < 0x20)
+                    g_string_append_printf(out, "\\u%04x", (guchar)*p);
+                else
+                    g_string_append_c(out, *p);
+                break;
+        }
+    }
+    g_string_append_c(out, '"');
+}
+
+/* appends "type":...,"value":... for a value off the wire */
+static void
+blconf_query_json_append_value(GString *out,
+                               GVariant *variant)
+{
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+    const gchar *type_name;
+    GVariant *inner = NULL;
+
+    if(g_variant_is_of_type(variant, G_VARIANT_TYPE_VARIANT))
+        variant = inner = g_variant_get_variant(variant);
+
+    switch(g_variant_classify(variant)) {
+        case G_VARIANT_CLASS_STRING:   type_name = "string"; break;
+        case G_VARIANT_CLASS_BYTE:     type_name = "uchar";  break;
+        case G_VARIANT_CLASS_INT16:    type_name = "int16";  break;
+        case G_VARIANT_CLASS_UINT16:   type_name = "uint16"; break;
+        case G_VARIANT_CLASS_INT32:    type_name = "int";    break;
+        case G_VARIANT_CLASS_UINT32:   type_name = "uint";   break;
+        case G_VARIANT_CLASS_INT64:    type_name = "int64";  break;
+        case G_VARIANT_CLASS_UINT64:   type_name = "uint64"; break;
+        case G_VARIANT_CLASS_DOUBLE:   type_name = "double"; break;
+        case G_VARIANT_CLASS_BOOLEAN:  type_name = "bool";   break;
+        case G_VARIANT_CLASS_ARRAY:    type_name = "array";  break;
+        default:                       type_name = NULL;     break;
+    }
+
+    g_string_append(out, "\"type\":");
+    if(type_name)
+        g_string_append_printf(out, "\"%s\"", type_name);
+    else
+        blconf_query_json_append_string(out, g_variant_get_type_string(variant));
+    g_string_append(out, ",\"value\":");
+
+    switch(g_variant_classify(variant)) {
+        case G_VARIANT_CLASS_STRING:
+            blconf_query_json_append_string(out, g_variant_get_string(variant, NULL));
+            break;
+        case G_VARIANT_CLASS_BYTE:
+            g_string_append_printf(out, "%u", g_variant_get_byte(variant));
+            break;
+        case G_VARIANT_CLASS_INT16:
+            g_string_append_printf(out, "%d", g_variant_get_int16(variant));
+            break;
+        case G_VARIANT_CLASS_UINT16:
+            g_string_append_printf(out, "%u", g_variant_get_uint16(variant));
+            break;
+        case G_VARIANT_CLASS_INT32:
+            g_string_append_printf(out, "%d", g_variant_get_int32(variant));
+            break;
+        case G_VARIANT_CLASS_UINT32:
+            g_string_append_printf(out, "%u", g_variant_get_uint32(variant));
+            break;
+        case G_VARIANT_CLASS_INT64:
+            g_string_append_printf(out, "%" G_GINT64_FORMAT, g_variant_get_int64(variant));
+            break;
+        case G_VARIANT_CLASS_UINT64:
+            g_string_append_printf(out, "%" G_GUINT64_FORMAT, g_variant_get_uint64(variant));
+            break;
+        case G_VARIANT_CLASS_DOUBLE: {
+            gdouble d = g_variant_get_double(variant);
+
+            /* JSON has no infinities or NaN */
+            if(d >= -G_MAXDOUBLE && d <= G_MAXDOUBLE)
+                g_string_append(out, g_ascii_dtostr(buf, sizeof(buf), d));
+            else
+                g_string_append(out, "null");
+            break;
+        }
+        case G_VARIANT_CLASS_BOOLEAN:
+            g_string_append(out, g_variant_get_boolean(variant) ? "true" : "false");
+            break;
+        case G_VARIANT_CLASS_ARRAY: {
+            gsize i, n = g_variant_n_children(variant);
+
+            g_string_append_c(out, '[');
+            for(i = 0; i < n; ++i) {
+                GVariant *child = g_variant_get_child_value(variant, i);
+
+                g_string_append(out, i ? ",{" : "{");
+                blconf_query_json_append_value(out, child);
+                g_string_append_c(out, '}');
+                g_variant_unref(child);
+            }
+            g_string_append_c(out, ']');
+            break;
+        }
+        default:
+            g_string_append(out, "null");
+            break;
+    }
+
+    if(inner)
+        g_variant_unref(inner);
+}
+
+static gboolean
+blconf_query_monitor_flush(gpointer data)
+{
+    monitor_flush_id = 0;
+    fflush(stdout);
+
+    return FALSE;
+}
+
+static void
+blconf_query_monitor_all_signal(GDBusConnection *connection,
+                                const gchar *sender_name,
+                                const gchar *object_path,
+                                const gchar *interface_name,
+                                const gchar *signal_name,
+                                GVariant *parameters,
+                                gpointer user_data)
+{
+    GString *out = user_data;
+    const gchar *channel, *property;
+    const gchar **removed;
+    GVariantIter *changed;
+    GVariant *variant;
+    gint64 now;
+    gsize prefix_len;
+    guint i;
+
+    g_variant_get(parameters, "(&sa{sv}^a&s)", &channel, &changed, &removed);
+
+    if(monitor_pattern && !g_pattern_match_string(monitor_pattern, channel)) {
+        g_variant_iter_free(changed);
+        g_free(removed);
+        return;
+    }
+
+    /* everything in one signal happened at the same time */
+    now = g_get_real_time();
+
+    /* the part of each line up to the property name only depends
+     * on the channel */
+    g_string_truncate(out, 0);
+    g_string_append_printf(out, "{\"time\":%" G_GINT64_FORMAT ".%06d,\"channel\":",
+                           now / G_USEC_PER_SEC, (gint)(now % G_USEC_PER_SEC));
+    blconf_query_json_append_string(out, channel);
+    g_string_append(out, ",\"property\":");
+    prefix_len = out->len;
+
+    while(g_variant_iter_loop(changed, "{&sv}", &property, &variant)) {
+        if(property_name && !g_str_has_prefix(property, property_name))
+            continue;
+
+        g_string_truncate(out, prefix_len);
+        blconf_query_json_append_string(out, property);
+        g_string_append(out, ",\"event\":\"set\",");
+        blconf_query_json_append_value(out, variant);
+        g_string_append(out, "}\n");
+        fwrite(out->str, 1, out->len, stdout);
+    }
+
+    for(i = 0; removed[i]; ++i) {
+        if(property_name && !g_str_has_prefix(removed[i], property_name))
+            continue;
+
+        g_string_truncate(out, prefix_len);
+        blconf_query_json_append_string(out, removed[i]);
+        g_string_append(out, ",\"event\":\"reset\"}\n");
+        fwrite(out->str, 1, out->len, stdout);
+    }
+
+    g_variant_iter_free(changed);
+    g_free(removed);
+
+    if(!monitor_flush_id)
+        monitor_flush_id = g_idle_add_full(G_PRIORITY_LOW, blconf_query_monitor_flush,
+                                           NULL, NULL);
+}
+
+static gboolean
+blconf_query_monitor_all(void)
+{
+    GDBusConnection *connection;
+    GMainLoop *loop;
+    GString *out;
+    GError *error = NULL;
+
+    /* libblconf already holds the shared session bus connection,
+     * so this doesn't open another one */
+    connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if(!connection)
+    {
+        blconf_query_printerr(_("Failed to connect to the session bus: %s"), error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    if(channel_name)
+        monitor_pattern = g_pattern_spec_new(channel_name);
+
+    setvbuf(stdout, NULL, _IOFBF, 64 * 1024);
+
+    out = g_string_sized_new(256);
+    g_dbus_connection_signal_subscribe(connection,
+                                       "org.blade.Blconf",
+                                       "org.blade.Blconf",
+                                       "PropertiesChanged",
+                                       "/org/blade/Blconf",
+                                       NULL,
+                                       G_DBUS_SIGNAL_FLAGS_NONE,
+                                       blconf_query_monitor_all_signal,
+                                       out, NULL);
+
+    loop = g_main_loop_new (NULL, TRUE);
+    g_main_loop_run (loop);
+    g_main_loop_unref (loop);
+
+    return TRUE;
+}
+
 static void
 blconf_query_get_propname_size (gpointer key, gpointer value, gpointer user_data)
 {
@@ -170,6 +436,463 @@ blconf_query_printerr(const gchar *message,
     g_free(str);
 }
 
+/* --import, --export and --batch use a line-based format, with one
+ * property per line:
+ *
+ *   <property> <type> <value>
+ *
+ * <value> is the rest of the line, with backslashes, tabs and line
+ * breaks escaped C-style.  An array is written as
+ *
+ *   <property> array <n>
+ *
+ * followed by its <n> elements, one "<type> <value>" per line.  Blank
+ * lines and lines starting with '#' are skipped.  --batch reads the
+ * same thing, with a channel name in front of each property. */
+
+static void
+blconf_query_reader_error(BlconfQueryReader *reader,
+                          const gchar *message,
+                          ...)
+{
+    va_list args;
+    gchar *str;
+
+    va_start(args, message);
+    str = g_strdup_vprintf(message, args);
+    va_end(args);
+
+    blconf_query_printerr("%s:%u: %s", reader->filename, reader->lineno, str);
+    g_free(str);
+}
+
+/* returns the next line that isn't blank or a comment, without
+ * its leading blanks, or NULL at the end of the input */
+static const gchar *
+blconf_query_reader_next(BlconfQueryReader *reader)
+{
+    gchar buf[1024];
+
+    for(;;) {
+        gboolean eol = FALSE;
+        const gchar *p;
+
+        g_string_truncate(reader->line, 0);
+        while(!eol && fgets(buf, sizeof(buf), reader->fp)) {
+            gsize len = strlen(buf);
+
+            if(len && buf[len - 1] == '\n') {
+                buf[--len] = '\0';
+                eol = TRUE;
+            }
+            g_string_append_len(reader->line, buf, len);
+        }
+
+        if(!eol && !reader->line->len)
+            return NULL;
+
+        reader->lineno++;
+        if(reader->line->len && reader->line->str[reader->line->len - 1] == '\r')
+            g_string_truncate(reader->line, reader->line->len - 1);
+
+        for(p = reader->line->str; *p == ' ' || *p == '\t'; ++p)
+            ;
+        if(*p && *p != '#')
+            return p;
+    }
+}
+
+/* parses "<type> <value>", reading the elements of an array from the
+ * lines that follow */
+static gboolean
+blconf_query_parse_value(BlconfQueryReader *reader,
+                         const gchar *spec,
+                         GValue *value,
+                         gboolean allow_array)
+{
+    const gchar *sep = strchr(spec, ' ');
+    gsize type_len = sep ? (gsize)(sep - spec) : strlen(spec);
+    const gchar *str = sep ? sep + 1 : "";
+    GType gtype;
+
+    gtype = _blconf_gtype_from_string_len(spec, type_len);
+    if(G_TYPE_INVALID == gtype || G_TYPE_NONE == gtype) {
+        blconf_query_reader_error(reader, _("Unknown value type \"%.*s\""),
+                                  (gint)type_len, spec);
+        return FALSE;
+    }
+
+    if(BLCONF_TYPE_G_VALUE_ARRAY == gtype) {
+        GPtrArray *arr;
+        guint64 n_elements, i;
+        gchar *end = NULL;
+
+        if(!allow_array) {
+            blconf_query_reader_error(reader, _("Arrays can not contain arrays"));
+            return FALSE;
+        }
+
+        n_elements = g_ascii_strtoull(str, &end, 10);
+        if(end == str || *end) {
+            blconf_query_reader_error(reader, _("Invalid array size \"%s\""), str);
+            return FALSE;
+        }
+
+        arr = g_ptr_array_new();
+        for(i = 0; i < n_elements; ++i) {
+            const gchar *line = blconf_query_reader_next(reader);
+            GValue *element;
+
+            if(!line) {
+                blconf_query_reader_error(reader, _("Unexpected end of input"));
+                blconf_array_free(arr);
+                return FALSE;
+            }
+
+            element = g_new0(GValue, 1);
+            if(!blconf_query_parse_value(reader, line, element, FALSE)) {
+                g_free(element);
+                blconf_array_free(arr);
+                return FALSE;
+            }
+            g_ptr_array_add(arr, element);
+        }
+
+        g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+        g_value_take_boxed(value, arr);
+    } else {
+        gboolean ret;
+
+        g_value_init(value, gtype);
+        if(!strchr(str, '\\'))
+            ret = _blconf_gvalue_from_string_len(value, str, strlen(str));
+        else {
+            gchar *unescaped = g_strcompress(str);
+            ret = _blconf_gvalue_from_string(value, unescaped);
+            g_free(unescaped);
+        }
+
+        if(!ret) {
+            blconf_query_reader_error(reader, _("Unable to convert \"%s\" to type \"%s\""),
+                                      str, g_type_name(gtype));
+            g_value_unset(value);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* reads the next "[<channel> ]<property> <type> <value>" entry; at
+ * the end of the input, this succeeds with *property set to NULL */
+static gboolean
+blconf_query_read_entry(BlconfQueryReader *reader,
+                        gchar **channel,
+                        gchar **property,
+                        GValue **value)
+{
+    const gchar *line, *sep;
+
+    *property = NULL;
+
+    line = blconf_query_reader_next(reader);
+    if(!line)
+        return TRUE;
+
+    if(channel) {
+        sep = strchr(line, ' ');
+        if(!sep || sep == line) {
+            blconf_query_reader_error(reader, _("Expected a channel name"));
+            return FALSE;
+        }
+        *channel = g_strndup(line, sep - line);
+        line = sep + 1;
+    }
+
+    sep = strchr(line, ' ');
+    if(*line != '/' || !sep) {
+        blconf_query_reader_error(reader, _("Expected a property name and a value"));
+        if(channel)
+            g_free(*channel);
+        return FALSE;
+    }
+
+    *value = g_new0(GValue, 1);
+    if(!blconf_query_parse_value(reader, sep + 1, *value, TRUE)) {
+        g_free(*value);
+        if(channel)
+            g_free(*channel);
+        return FALSE;
+    }
+    *property = g_strndup(line, sep - line);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_query_reader_open(BlconfQueryReader *reader,
+                         const gchar *filename)
+{
+    reader->filename = filename;
+    reader->lineno = 0;
+
+    if(!strcmp(filename, "-")) {
+        reader->filename = _("(stdin)");
+        reader->fp = stdin;
+    } else {
+        reader->fp = fopen(filename, "r");
+        if(!reader->fp) {
+            blconf_query_printerr(_("Failed to open \"%s\": %s"),
+                                  filename, g_strerror(errno));
+            return FALSE;
+        }
+    }
+
+    reader->line = g_string_sized_new(128);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_query_reader_close(BlconfQueryReader *reader)
+{
+    gboolean ret = !ferror(reader->fp);
+
+    if(!ret) {
+        blconf_query_printerr(_("Failed to read \"%s\": %s"),
+                              reader->filename, g_strerror(errno));
+    }
+
+    if(reader->fp != stdin)
+        fclose(reader->fp);
+    g_string_free(reader->line, TRUE);
+
+    return ret;
+}
+
+static gboolean
+blconf_query_property_in_base(const gchar *property,
+                              const gchar *property_base)
+{
+    gsize len = strlen(property_base);
+
+    if(len == 1 && property_base[0] == '/')
+        return TRUE;
+
+    return !strncmp(property, property_base, len)
+           && (property[len] == '\0' || property[len] == '/');
+}
+
+static gboolean
+blconf_query_apply(const gchar *name,
+                   GHashTable *properties)
+{
+    BlconfChannel *channel;
+    gboolean ret;
+
+    if(!g_hash_table_size(properties))
+        return TRUE;
+
+    /* nothing is read back, so there's no point in prefetching */
+    channel = blconf_channel_new_full(name, NULL, BLCONF_CHANNEL_PREFETCH_NONE);
+    ret = blconf_channel_set_properties(channel, properties);
+    g_object_unref(channel);
+
+    if(!ret)
+        blconf_query_printerr(_("Failed to set properties on channel \"%s\""), name);
+
+    return ret;
+}
+
+static gboolean
+blconf_query_import(void)
+{
+    BlconfQueryReader reader;
+    GHashTable *properties;
+    gchar *property;
+    GValue *value;
+    gboolean ret;
+
+    if(!blconf_query_reader_open(&reader, import_file))
+        return FALSE;
+
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)_blconf_gvalue_free);
+
+    while((ret = blconf_query_read_entry(&reader, NULL, &property, &value))
+          && property)
+    {
+        if(property_name && !blconf_query_property_in_base(property, property_name)) {
+            g_free(property);
+            _blconf_gvalue_free(value);
+            continue;
+        }
+
+        g_hash_table_insert(properties, property, value);
+    }
+
+    if(!blconf_query_reader_close(&reader))
+        ret = FALSE;
+
+    if(ret)
+        ret = blconf_query_apply(channel_name, properties);
+
+    g_hash_table_destroy(properties);
+
+    return ret;
+}
+
+static gboolean
+blconf_query_batch(void)
+{
+    BlconfQueryReader reader;
+    GHashTable *channels;
+    GHashTableIter iter;
+    gpointer name, properties;
+    gchar *channel, *property;
+    GValue *value;
+    gboolean ret;
+
+    if(!blconf_query_reader_open(&reader, "-"))
+        return FALSE;
+
+    channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                     (GDestroyNotify)g_free,
+                                     (GDestroyNotify)g_hash_table_destroy);
+
+    while((ret = blconf_query_read_entry(&reader, &channel, &property, &value))
+          && property)
+    {
+        properties = g_hash_table_lookup(channels, channel);
+        if(!properties) {
+            properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               (GDestroyNotify)g_free,
+                                               (GDestroyNotify)_blconf_gvalue_free);
+            g_hash_table_insert(channels, channel, properties);
+        } else
+            g_free(channel);
+
+        g_hash_table_insert(properties, property, value);
+    }
+
+    if(!blconf_query_reader_close(&reader))
+        ret = FALSE;
+
+    /* only touch the configuration if all of the input made sense */
+    if(ret) {
+        g_hash_table_iter_init(&iter, channels);
+        while(g_hash_table_iter_next(&iter, &name, &properties)) {
+            if(!blconf_query_apply(name, properties))
+                ret = FALSE;
+        }
+    }
+
+    g_hash_table_destroy(channels);
+
+    return ret;
+}
+
+static void
+blconf_query_append_escaped(GString *out,
+                            const gchar *str)
+{
+    const gchar *p;
+
+    for(p = str; *p; ++p) {
+        switch(*p) {
+            case '\\':
+                g_string_append(out, "\\\\");
+                break;
+            case '\n':
+                g_string_append(out, "\\n");
+                break;
+            case '\r':
+                g_string_append(out, "\\r");
+                break;
+            case '\t':
+                g_string_append(out, "\\t");
+                break;
+            default:
+                g_string_append_c(out, *p);
+                break;
+        }
+    }
+}
+
+static gboolean
+blconf_query_append_value(GString *out,
+                          GValue *value)
+{
+    const gchar *type_name = _blconf_string_from_gtype(G_VALUE_TYPE(value));
+    gchar *str;
+
+    if(!type_name)
+        return FALSE;
+
+    g_string_append(out, type_name);
+    g_string_append_c(out, ' ');
+
+    if(BLCONF_TYPE_G_VALUE_ARRAY == G_VALUE_TYPE(value)) {
+        GPtrArray *arr = g_value_get_boxed(value);
+        guint i;
+
+        g_string_append_printf(out, "%u\n", arr->len);
+        for(i = 0; i < arr->len; ++i) {
+            g_string_append(out, "    ");
+            if(!blconf_query_append_value(out, g_ptr_array_index(arr, i)))
+                return FALSE;
+        }
+    } else {
+        str = _blconf_string_from_gvalue(value);
+        if(!str)
+            return FALSE;
+        blconf_query_append_escaped(out, str);
+        g_string_append_c(out, '\n');
+        g_free(str);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+blconf_query_export(void)
+{
+    BlconfChannel *channel;
+    GHashTable *properties;
+    GSList *sorted = NULL, *l;
+    GString *out;
+
+    channel = blconf_channel_new_full(channel_name, NULL, BLCONF_CHANNEL_PREFETCH_NONE);
+    properties = blconf_channel_get_properties(channel, property_name);
+    g_object_unref(channel);
+
+    if(!properties)
+        return TRUE;
+
+    g_hash_table_foreach(properties, (GHFunc)blconf_query_list_sorted, &sorted);
+
+    out = g_string_sized_new(256);
+    for(l = sorted; l; l = l->next) {
+        g_string_truncate(out, 0);
+        g_string_append(out, l->data);
+        g_string_append_c(out, ' ');
+
+        if(blconf_query_append_value(out, g_hash_table_lookup(properties, l->data)))
+            fputs(out->str, stdout);
+        else {
+            g_warning("Skipping property \"%s\", which has an unsupported type",
+                      (gchar *)l->data);
+        }
+    }
+    g_string_free(out, TRUE);
+
+    g_slist_free(sorted);
+    g_hash_table_destroy(properties);
+
+    return TRUE;
+}
+
 static GOptionEntry entries[] =
 {
      {   "version", 'V', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &version,
@@ -221,9 +944,22 @@ static GOptionEntry entries[] =
         NULL
     },
     {   "monitor", 'm', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &monitor,
-        N_("Monitor a channel for property changes"),
+        N_("Monitor a channel for property changes (all channels, as JSON lines, if -c is "
+           "not specified or is a glob pattern)"),
         NULL,
     },
+    {   "import", 'i', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_FILENAME, &import_file,
+        N_("Set the properties listed in FILE (or stdin, for -) all at once"),
+        N_("FILE")
+    },
+    {   "export", 'e', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &export,
+        N_("Print a channel (or the properties under -p) in a form --import reads"),
+        NULL
+    },
+    {   "batch", 'b', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &batch,
+        N_("Set the \"channel property type value\" lines read from stdin"),
+        NULL
+    },
     { NULL }
 };
 
@@ -273,6 +1009,28 @@ main(int argc, char **argv)
         return EXIT_SUCCESS;
     }
 
+    if(batch)
+    {
+        if(channel_name || import_file || export)
+        {
+            blconf_query_printerr(_("--batch can not be used together with --channel, --import or --export"));
+            return EXIT_FAILURE;
+        }
+
+        return blconf_query_batch() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if(monitor && (!channel_name || strpbrk(channel_name, "*?")))
+    {
+        if(list || reset || create || toggle || set_value || import_file || export)
+        {
+            blconf_query_printerr(_("--monitor can only be used together with --channel and --property"));
+            return EXIT_FAILURE;
+        }
+
+        return blconf_query_monitor_all() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     /** Check if the channel is specified */
     if(!channel_name)
     {
@@ -292,6 +1050,26 @@ main(int argc, char **argv)
         return EXIT_SUCCESS;
     }
 
+    if(import_file || export)
+    {
+        if(import_file && export)
+        {
+            blconf_query_printerr(_("--import and --export options can not be used together"));
+            return EXIT_FAILURE;
+        }
+
+        if(set_value || list || monitor || reset || toggle || create)
+        {
+            blconf_query_printerr(_("--import and --export options can only be used together with --channel and --property"));
+            return EXIT_FAILURE;
+        }
+
+        if(import_file)
+            return blconf_query_import() ? EXIT_SUCCESS : EXIT_FAILURE;
+        else
+            return blconf_query_export() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     /** Check if the property is specified */
     if(!property_name && !list && !monitor)
     {
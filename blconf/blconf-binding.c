@@ -35,10 +35,12 @@
 
 typedef struct
 {
+    gulong id;
+
     BlconfChannel *channel;
     gchar *blconf_property;
     GType blconf_property_type;
-    gulong channel_handler;
+    guint channel_blocked;  /* >0 while we write @blconf_property */
 
     GObject *object;
     gchar *object_property;
@@ -64,23 +66,38 @@ typedef struct
     gdouble alpha;
 } FakeGdkRGBA;
 
+/* each channel with bindings has a single property-changed handler,
+ * which hands the change to the bindings of that property */
+typedef struct
+{
+    BlconfChannel *channel;
+    gulong handler;
+    GHashTable *bindings;  /* blconf property -> GSList of BlconfGBinding */
+} BlconfGBindingDispatcher;
+
 
 static void blconf_g_property_object_notify(GObject *object,
                                             GParamSpec *pspec,
                                             gpointer user_data);
 static void blconf_g_property_object_disconnect(gpointer user_data,
                                                 GClosure *closure);
-static void blconf_g_property_channel_notify(BlconfChannel *channel,
-                                             const gchar *property,
-                                             const GValue *value,
-                                             gpointer user_data);
-static void blconf_g_property_channel_disconnect(gpointer user_data,
-                                                 GClosure *closure);
+static void blconf_g_property_channel_notify(BlconfGBinding *binding,
+                                             const GValue *value);
+static void blconf_g_binding_dispatcher_notify(BlconfChannel *channel,
+                                               const gchar *property,
+                                               const GValue *value,
+                                               gpointer user_data);
+static void blconf_g_binding_dispatcher_disconnect(gpointer user_data,
+                                                   GClosure *closure);
+static void blconf_g_binding_dispatcher_remove(BlconfGBinding *binding);
 
 
 
 G_LOCK_DEFINE_STATIC(__bindings);
-static GSList *__bindings = NULL;
+static GHashTable *__bindings = NULL;  /* id -> BlconfGBinding */
+static gulong  __last_binding_id = 0;
+G_LOCK_DEFINE_STATIC(__dispatchers);
+static GQuark  __dispatcher_quark = 0;
 static GType   __gdkcolor_gtype = 0;
 static GType   __gdkrgba_gtype = 0;
 
@@ -98,14 +115,14 @@ blconf_g_property_object_notify_gdkcolor(BlconfGBinding *binding)
         return;
     }
 
-    g_signal_handler_block(G_OBJECT(binding->channel), binding->channel_handler);
+    binding->channel_blocked++;
     blconf_channel_set_array(binding->channel, binding->blconf_property,
                              BLCONF_TYPE_UINT16, &color->red,
                              BLCONF_TYPE_UINT16, &color->green,
                              BLCONF_TYPE_UINT16, &color->blue,
                              BLCONF_TYPE_UINT16, &alpha,
                              G_TYPE_INVALID);
-    g_signal_handler_unblock(G_OBJECT(binding->channel), binding->channel_handler);
+    binding->channel_blocked--;
 }
 
 static void
@@ -119,14 +136,14 @@ blconf_g_property_object_notify_gdkrgba(BlconfGBinding *binding)
         return;
     }
 
-    g_signal_handler_block(G_OBJECT(binding->channel), binding->channel_handler);
+    binding->channel_blocked++;
     blconf_channel_set_array(binding->channel, binding->blconf_property,
                              G_TYPE_DOUBLE, &color->red,
                              G_TYPE_DOUBLE, &color->green,
                              G_TYPE_DOUBLE, &color->blue,
                              G_TYPE_DOUBLE, &color->alpha,
                              G_TYPE_INVALID);
-    g_signal_handler_unblock(G_OBJECT(binding->channel), binding->channel_handler);
+    binding->channel_blocked--;
 }
 
 static void
@@ -161,13 +178,11 @@ blconf_g_property_object_notify(GObject *object,
 
     g_value_init(&dst_val, binding->blconf_property_type);
     if(g_value_transform(&src_val, &dst_val)) {
-        g_signal_handler_block(G_OBJECT(binding->channel),
-                               binding->channel_handler);
+        binding->channel_blocked++;
         blconf_channel_set_property(binding->channel,
                                     binding->blconf_property,
                                     &dst_val);
-        g_signal_handler_unblock(G_OBJECT(binding->channel),
-                                 binding->channel_handler);
+        binding->channel_blocked--;
     }
 
     g_value_unset(&dst_val);
@@ -186,17 +201,14 @@ blconf_g_property_object_disconnect(gpointer user_data,
     /* remove the binding from the internal list */
     if(G_LIKELY(__bindings)) {
         G_LOCK(__bindings);
-        __bindings = g_slist_remove(__bindings, binding);
+        g_hash_table_remove(__bindings, GSIZE_TO_POINTER(binding->id));
         G_UNLOCK(__bindings);
     }
 
-    /* unset the prevent recursing in channel_disconnect */
     binding->object = NULL;
 
-    if(binding->channel) {
-        g_signal_handler_disconnect(G_OBJECT(binding->channel),
-                                    binding->channel_handler);
-    }
+    if(binding->channel)
+        blconf_g_binding_dispatcher_remove(binding);
 
     g_free(binding->blconf_property);
     g_free(binding->object_property);
@@ -256,18 +268,41 @@ blconf_g_property_channel_notify_gdkrgba(BlconfGBinding *binding,
                              binding->object_handler);
 }
 
+/* whether the bound object property already holds |value| */
+static gboolean
+blconf_g_property_object_has_value(BlconfGBinding *binding,
+                                   const GValue *value)
+{
+    GParamSpec *pspec;
+    GValue cur_val = { 0, };
+    gboolean ret;
+
+    /* boxed values would only be compared by address */
+    if(g_type_is_a(binding->object_property_type, G_TYPE_BOXED))
+        return FALSE;
+
+    pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(binding->object),
+                                         binding->object_property);
+    if(G_UNLIKELY(!pspec || !(pspec->flags & G_PARAM_READABLE)))
+        return FALSE;
+
+    g_value_init(&cur_val, binding->object_property_type);
+    g_object_get_property(G_OBJECT(binding->object),
+                          binding->object_property, &cur_val);
+    ret = !g_param_values_cmp(pspec, &cur_val, value);
+    g_value_unset(&cur_val);
+
+    return ret;
+}
+
 static void
-blconf_g_property_channel_notify(BlconfChannel *channel,
-                                 const gchar *property,
-                                 const GValue *value,
-                                 gpointer user_data)
+blconf_g_property_channel_notify(BlconfGBinding *binding,
+                                 const GValue *value)
 {
-    BlconfGBinding *binding = user_data;
     GParamSpec *pspec;
     GValue dst_val = { 0, };
 
-    g_return_if_fail(BLCONF_IS_CHANNEL(channel));
-    g_return_if_fail(binding->channel == channel);
+    g_return_if_fail(BLCONF_IS_CHANNEL(binding->channel));
     g_return_if_fail(G_IS_OBJECT(binding->object));
 
    if(__gdkcolor_gtype == binding->blconf_property_type) {
@@ -312,6 +347,13 @@ blconf_g_property_channel_notify(BlconfChannel *channel,
         return;
     }
 
+    /* nothing to do if the object already has the value; mostly this
+     * is the daemon telling us about the object's own change */
+    if(blconf_g_property_object_has_value(binding, &dst_val)) {
+        g_value_unset(&dst_val);
+        return;
+    }
+
     g_signal_handler_block(G_OBJECT(binding->object),
                            binding->object_handler);
     g_object_set_property(G_OBJECT(binding->object),
@@ -322,39 +364,194 @@ blconf_g_property_channel_notify(BlconfChannel *channel,
     g_value_unset(&dst_val);
 }
 
+static BlconfGBindingDispatcher *
+blconf_g_binding_dispatcher_get(BlconfChannel *channel)
+{
+    BlconfGBindingDispatcher *dispatcher;
+
+    if(!__dispatcher_quark)
+        __dispatcher_quark = g_quark_from_static_string("--blconf-g-binding-dispatcher");
+
+    dispatcher = g_object_get_qdata(G_OBJECT(channel), __dispatcher_quark);
+    if(!dispatcher) {
+        dispatcher = g_slice_new0(BlconfGBindingDispatcher);
+        dispatcher->channel = channel;
+        dispatcher->bindings = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                     (GDestroyNotify)g_free,
+                                                     NULL);
+        g_object_set_qdata(G_OBJECT(channel), __dispatcher_quark, dispatcher);
+
+        dispatcher->handler = g_signal_connect_data(G_OBJECT(channel),
+                                                    "property-changed",
+                                                    G_CALLBACK(blconf_g_binding_dispatcher_notify),
+                                                    dispatcher,
+                                                    blconf_g_binding_dispatcher_disconnect, 0);
+    }
+
+    return dispatcher;
+}
+
 static void
-blconf_g_property_channel_disconnect(gpointer user_data,
-                                     GClosure *closure)
+blconf_g_binding_dispatcher_add(BlconfGBinding *binding)
 {
-    BlconfGBinding *binding = user_data;
+    BlconfGBindingDispatcher *dispatcher;
+    GSList *bindings;
+
+    dispatcher = blconf_g_binding_dispatcher_get(binding->channel);
+
+    G_LOCK(__dispatchers);
+    bindings = g_hash_table_lookup(dispatcher->bindings,
+                                   binding->blconf_property);
+    if(bindings)
+        bindings = g_slist_append(bindings, binding);
+    else {
+        g_hash_table_insert(dispatcher->bindings,
+                            g_strdup(binding->blconf_property),
+                            g_slist_prepend(NULL, binding));
+    }
+    G_UNLOCK(__dispatchers);
+}
 
-    g_return_if_fail(BLCONF_IS_CHANNEL(binding->channel));
-    g_return_if_fail(!binding->object || G_IS_OBJECT(binding->object));
+/* the last binding of a channel takes its dispatcher with it */
+static void
+blconf_g_binding_dispatcher_remove(BlconfGBinding *binding)
+{
+    BlconfGBindingDispatcher *dispatcher;
+    GSList *bindings;
+    gboolean empty;
+
+    dispatcher = g_object_get_qdata(G_OBJECT(binding->channel),
+                                    __dispatcher_quark);
+    if(G_UNLIKELY(!dispatcher))
+        return;
+
+    G_LOCK(__dispatchers);
+    bindings = g_hash_table_lookup(dispatcher->bindings,
+                                   binding->blconf_property);
+    if(bindings) {
+        GSList *bindings_new = g_slist_remove(bindings, binding);
+
+        if(!bindings_new)
+            g_hash_table_remove(dispatcher->bindings, binding->blconf_property);
+        else if(bindings_new != bindings) {
+            g_hash_table_insert(dispatcher->bindings,
+                                g_strdup(binding->blconf_property),
+                                bindings_new);
+        }
+    }
+    empty = !g_hash_table_size(dispatcher->bindings);
+    G_UNLOCK(__dispatchers);
 
-    /* unset the prevent recursing in object_disconnect */
     binding->channel = NULL;
 
-    if(binding->object) {
+    if(empty) {
+        g_object_set_qdata(G_OBJECT(dispatcher->channel), __dispatcher_quark,
+                           NULL);
+        g_signal_handler_disconnect(G_OBJECT(dispatcher->channel),
+                                    dispatcher->handler);
+    }
+}
+
+static void
+blconf_g_binding_dispatcher_notify(BlconfChannel *channel,
+                                   const gchar *property,
+                                   const GValue *value,
+                                   gpointer user_data)
+{
+    BlconfGBindingDispatcher *dispatcher = user_data;
+    GSList *bindings, *l;
+
+    g_return_if_fail(dispatcher->channel == channel);
+
+    /* an object that's updated may well drop some bindings, so work on
+     * a copy and skip those that are gone by the time we get to them */
+    G_LOCK(__dispatchers);
+    bindings = g_slist_copy(g_hash_table_lookup(dispatcher->bindings,
+                                                property));
+    G_UNLOCK(__dispatchers);
+
+    for(l = bindings; l; l = l->next) {
+        BlconfGBinding *binding = l->data;
+        gboolean bound;
+
+        if(l != bindings) {
+            G_LOCK(__dispatchers);
+            bound = !!g_slist_find(g_hash_table_lookup(dispatcher->bindings,
+                                                       property),
+                                   binding);
+            G_UNLOCK(__dispatchers);
+            if(!bound)
+                continue;
+        }
+
+        if(!binding->channel_blocked)
+            blconf_g_property_channel_notify(binding, value);
+    }
+
+    g_slist_free(bindings);
+}
+
+/* the handler is gone, either because the last binding went away or
+ * because the channel is being destroyed; in the latter case the
+ * remaining bindings go with it */
+static void
+blconf_g_binding_dispatcher_disconnect(gpointer user_data,
+                                       GClosure *closure)
+{
+    BlconfGBindingDispatcher *dispatcher = user_data;
+    GHashTableIter iter;
+    gpointer value;
+    GSList *bindings = NULL, *l;
+
+    /* a binding added since the last one went may have a new one */
+    if(g_object_get_qdata(G_OBJECT(dispatcher->channel),
+                          __dispatcher_quark) == dispatcher)
+    {
+        g_object_set_qdata(G_OBJECT(dispatcher->channel), __dispatcher_quark,
+                           NULL);
+    }
+
+    G_LOCK(__dispatchers);
+    g_hash_table_iter_init(&iter, dispatcher->bindings);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+        bindings = g_slist_concat(bindings, value);
+    g_hash_table_destroy(dispatcher->bindings);
+    G_UNLOCK(__dispatchers);
+
+    for(l = bindings; l; l = l->next) {
+        BlconfGBinding *binding = l->data;
+
+        /* unset the prevent recursing in object_disconnect */
+        binding->channel = NULL;
+
         /* disconnect from the object. the disconnect closure of
          * the object will free the binding data */
-        g_signal_handler_disconnect(G_OBJECT(binding->object),
-                                    binding->object_handler);
+        if(binding->object) {
+            g_signal_handler_disconnect(G_OBJECT(binding->object),
+                                        binding->object_handler);
+        }
     }
+    g_slist_free(bindings);
+
+    g_slice_free(BlconfGBindingDispatcher, dispatcher);
 }
 
+/* sets up a binding.  the bound object picks up the current value
+ * from |values| if given, and from the channel otherwise */
 static gulong
 blconf_g_property_init(BlconfChannel *channel,
                        const gchar *blconf_property,
                        GType blconf_property_type,
                        GObject *object,
                        const gchar *object_property,
-                       GType object_property_type)
+                       GType object_property_type,
+                       GHashTable *values)
 {
     BlconfGBinding *binding;
     gchar *detailed_signal;
     GValue value = { 0, };
 
-    binding = g_slice_new(BlconfGBinding);
+    binding = g_slice_new0(BlconfGBinding);
     binding->channel = channel;
     binding->blconf_property_type = blconf_property_type;
     binding->blconf_property = g_strdup(blconf_property);
@@ -372,34 +569,35 @@ blconf_g_property_init(BlconfChannel *channel,
     g_free(detailed_signal);
 
     /* transfer channel property to the object */
-    if(blconf_channel_get_property(channel, blconf_property, &value)) {
-        blconf_g_property_channel_notify(channel, blconf_property,
-                                         &value, binding);
+    if(values) {
+        GValue *val = g_hash_table_lookup(values, blconf_property);
+
+        if(val)
+            blconf_g_property_channel_notify(binding, val);
+    } else if(blconf_channel_get_property(channel, blconf_property, &value)) {
+        blconf_g_property_channel_notify(binding, &value);
         g_value_unset(&value);
     }
 
     /* monitor channel for property changes */
-    detailed_signal = g_strconcat("property-changed::", blconf_property, NULL);
-    binding->channel_handler = g_signal_connect_data(G_OBJECT(channel),
-                                                     detailed_signal,
-                                                     G_CALLBACK(blconf_g_property_channel_notify),
-                                                     binding,
-                                                     blconf_g_property_channel_disconnect, 0);
-    g_free(detailed_signal);
+    blconf_g_binding_dispatcher_add(binding);
 
     /* add binding to internal list */
     G_LOCK(__bindings);
-    __bindings = g_slist_prepend(__bindings, binding);
+    if(!__bindings)
+        __bindings = g_hash_table_new(g_direct_hash, g_direct_equal);
+    binding->id = ++__last_binding_id;
+    g_hash_table_insert(__bindings, GSIZE_TO_POINTER(binding->id), binding);
     G_UNLOCK(__bindings);
 
-    /* we use the channel signal id as binding id  */
-    return binding->channel_handler;
+    return binding->id;
 }
 
 void
 _blconf_g_bindings_shutdown(void)
 {
-    GSList *bindings, *l;
+    GHashTable *bindings;
+    GList *values, *l;
     guint n;
     BlconfGBinding *binding;
 
@@ -411,23 +609,64 @@ _blconf_g_bindings_shutdown(void)
         __bindings = NULL;
 
         /* remove all the remaining bindings */
-        for(l = bindings, n = 0; l; l = g_slist_next(l), n++) {
+        values = g_hash_table_get_values(bindings);
+        for(l = values, n = 0; l; l = g_list_next(l), n++) {
             binding = l->data;
             g_signal_handler_disconnect(G_OBJECT(binding->object),
                                         binding->object_handler);
         }
-        g_slist_free(bindings);
+        g_list_free(values);
+        g_hash_table_destroy(bindings);
 
 #ifndef NDEBUG
         /* scare the developer a bit */
-        g_debug("%d blconf binding(s) are still connected. Are you sure all blconf "
-                "channels are released before calling blconf_shutdown()?", n);
+        if(n)
+            g_debug("%d blconf binding(s) are still connected. Are you sure all blconf "
+                    "channels are released before calling blconf_shutdown()?", n);
 #endif
 
         G_UNLOCK(__bindings);
     }
 }
 
+/* the type of |object_property|, or G_TYPE_INVALID, after a warning,
+ * if it can't be bound to a blconf property of |blconf_property_type| */
+static GType
+blconf_g_property_check(GType blconf_property_type,
+                        gpointer object,
+                        const gchar *object_property)
+{
+    GParamSpec *pspec;
+
+    pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(object),
+                                         object_property);
+    if(G_UNLIKELY(!pspec)) {
+        g_warning("Property \"%s\" is not valid for GObject type \"%s\"",
+                  object_property, G_OBJECT_TYPE_NAME(object));
+        return G_TYPE_INVALID;
+    }
+
+    if(G_UNLIKELY(!g_value_type_transformable(blconf_property_type,
+                                              G_PARAM_SPEC_VALUE_TYPE(pspec))))
+    {
+        g_warning("Converting from type \"%s\" to type \"%s\" is not supported",
+                  g_type_name(blconf_property_type),
+                  g_type_name(G_PARAM_SPEC_VALUE_TYPE(pspec)));
+        return G_TYPE_INVALID;
+    }
+
+    if(G_UNLIKELY(!g_value_type_transformable(G_PARAM_SPEC_VALUE_TYPE(pspec),
+                                              blconf_property_type)))
+    {
+        g_warning("Converting from type \"%s\" to type \"%s\" is not supported",
+                  g_type_name(G_PARAM_SPEC_VALUE_TYPE(pspec)),
+                  g_type_name(blconf_property_type));
+        return G_TYPE_INVALID;
+    }
+
+    return G_PARAM_SPEC_VALUE_TYPE(pspec);
+}
+
 /**
  * blconf_g_property_bind:
  * @channel: An #BlconfChannel.
@@ -455,7 +694,7 @@ blconf_g_property_bind(BlconfChannel *channel,
                        gpointer object,
                        const gchar *object_property)
 {
-    GParamSpec *pspec;
+    GType object_property_type;
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel), 0UL);
     g_return_val_if_fail(blconf_property && *blconf_property == '/', 0UL);
@@ -464,36 +703,126 @@ blconf_g_property_bind(BlconfChannel *channel,
     g_return_val_if_fail(G_IS_OBJECT(object), 0UL);
     g_return_val_if_fail(object_property && *object_property != '\0', 0UL);
 
-    pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(object),
-                                         object_property);
-    if(G_UNLIKELY(!pspec)) {
-        g_warning("Property \"%s\" is not valid for GObject type \"%s\"",
-                  object_property, G_OBJECT_TYPE_NAME(object));
+    object_property_type = blconf_g_property_check(blconf_property_type,
+                                                   object, object_property);
+    if(object_property_type == G_TYPE_INVALID)
         return 0UL;
+
+    return blconf_g_property_init(channel, blconf_property,
+                                  blconf_property_type, G_OBJECT(object),
+                                  object_property, object_property_type,
+                                  NULL);
+}
+
+/**
+ * BlconfGPropertyBinding:
+ * @blconf_property: A property on the channel.
+ * @blconf_property_type: The type of @blconf_property.
+ * @object: A #GObject.
+ * @object_property: A valid property on @object.
+ *
+ * One entry of the table given to blconf_g_property_bind_many(); the
+ * members are the arguments of blconf_g_property_bind().
+ *
+ * Since: 4.14
+ **/
+
+/**
+ * blconf_g_property_bind_many:
+ * @channel: An #BlconfChannel.
+ * @entries: An array of @n_entries #BlconfGPropertyBinding<!-- -->s.
+ * @n_entries: The number of entries in @entries.
+ * @ids: (out) (allow-none): Room for @n_entries binding IDs, or %NULL.
+ *
+ * Binds a whole table of Blconf properties to #GObject properties,
+ * each like blconf_g_property_bind() would.  The current values of
+ * all the properties are fetched in one go, and the objects only
+ * emit their notifications once all of them are set.
+ *
+ * If @ids is given, it receives the ID of each binding, or 0 for an
+ * entry that couldn't be bound.
+ *
+ * Returns: The number of bindings made.
+ *
+ * Since: 4.14
+ **/
+guint
+blconf_g_property_bind_many(BlconfChannel *channel,
+                            const BlconfGPropertyBinding *entries,
+                            guint n_entries,
+                            gulong *ids)
+{
+    const gchar **properties;
+    GType *object_property_types;
+    GHashTable *values;
+    guint i, n_bound = 0;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel), 0);
+    g_return_val_if_fail(entries || !n_entries, 0);
+
+    properties = g_new0(const gchar *, n_entries + 1);
+    object_property_types = g_new0(GType, n_entries);
+
+    for(i = 0; i < n_entries; ++i) {
+        const BlconfGPropertyBinding *entry = &entries[i];
+
+        if(G_UNLIKELY(!entry->blconf_property
+                      || *entry->blconf_property != '/'
+                      || entry->blconf_property_type == G_TYPE_NONE
+                      || entry->blconf_property_type == G_TYPE_INVALID
+                      || !G_IS_OBJECT(entry->object)
+                      || !entry->object_property
+                      || !*entry->object_property))
+        {
+            g_warning("Binding entry %u is invalid", i);
+            continue;
+        }
+
+        object_property_types[i] = blconf_g_property_check(entry->blconf_property_type,
+                                                           entry->object,
+                                                           entry->object_property);
+        if(object_property_types[i] != G_TYPE_INVALID)
+            properties[n_bound++] = entry->blconf_property;
     }
 
-    if(G_UNLIKELY(!g_value_type_transformable(blconf_property_type,
-                                              G_PARAM_SPEC_VALUE_TYPE(pspec))))
-    {
-        g_warning("Converting from type \"%s\" to type \"%s\" is not supported",
-                  g_type_name(blconf_property_type),
-                  g_type_name(G_PARAM_SPEC_VALUE_TYPE(pspec)));
-        return 0UL;
+    values = blconf_channel_get_many(channel, properties);
+    if(!values) {
+        /* the bindings can still follow changes */
+        values = g_hash_table_new(g_str_hash, g_str_equal);
     }
 
-    if(G_UNLIKELY(!g_value_type_transformable(G_PARAM_SPEC_VALUE_TYPE(pspec),
-                                              blconf_property_type)))
-    {
-        g_warning("Converting from type \"%s\" to type \"%s\" is not supported",
-                  g_type_name(G_PARAM_SPEC_VALUE_TYPE(pspec)),
-                  g_type_name(blconf_property_type));
-        return 0UL;
+    for(i = 0; i < n_entries; ++i) {
+        if(object_property_types[i] != G_TYPE_INVALID)
+            g_object_freeze_notify(G_OBJECT(entries[i].object));
     }
 
-    return blconf_g_property_init(channel, blconf_property,
-                                  blconf_property_type, G_OBJECT(object),
-                                  object_property,
-                                  G_PARAM_SPEC_VALUE_TYPE(pspec));
+    for(i = 0; i < n_entries; ++i) {
+        const BlconfGPropertyBinding *entry = &entries[i];
+        gulong id = 0;
+
+        if(object_property_types[i] != G_TYPE_INVALID) {
+            id = blconf_g_property_init(channel, entry->blconf_property,
+                                        entry->blconf_property_type,
+                                        G_OBJECT(entry->object),
+                                        entry->object_property,
+                                        object_property_types[i],
+                                        values);
+        }
+
+        if(ids)
+            ids[i] = id;
+    }
+
+    for(i = 0; i < n_entries; ++i) {
+        if(object_property_types[i] != G_TYPE_INVALID)
+            g_object_thaw_notify(G_OBJECT(entries[i].object));
+    }
+
+    g_hash_table_destroy(values);
+    g_free(object_property_types);
+    g_free(properties);
+
+    return n_bound;
 }
 
 /**
@@ -556,7 +885,7 @@ blconf_g_property_bind_gdkcolor(BlconfChannel *channel,
 
     return blconf_g_property_init(channel, blconf_property,
                                   __gdkcolor_gtype, G_OBJECT(object),
-                                  object_property, __gdkcolor_gtype);
+                                  object_property, __gdkcolor_gtype, NULL);
 }
 
 /**
@@ -617,7 +946,7 @@ blconf_g_property_bind_gdkrgba(BlconfChannel *channel,
 
     return blconf_g_property_init(channel, blconf_property,
                                   __gdkrgba_gtype, G_OBJECT(object),
-                                  object_property, __gdkrgba_gtype);
+                                  object_property, __gdkrgba_gtype, NULL);
 }
 
 /**
@@ -630,19 +959,14 @@ blconf_g_property_bind_gdkrgba(BlconfChannel *channel,
 void
 blconf_g_property_unbind(gulong id)
 {
-    GSList *l;
-    BlconfGBinding *binding;
+    BlconfGBinding *binding = NULL;
 
     G_LOCK(__bindings);
-    for(l = __bindings; l; l = g_slist_next(l)) {
-        binding = l->data;
-        if(G_UNLIKELY(binding->channel_handler == id))
-            break;
-    }
+    if(__bindings)
+        binding = g_hash_table_lookup(__bindings, GSIZE_TO_POINTER(id));
     G_UNLOCK(__bindings);
 
-    if(G_LIKELY(l)) {
-        binding = l->data;
+    if(G_LIKELY(binding)) {
         g_signal_handler_disconnect(G_OBJECT(binding->object),
                                     binding->object_handler);
     } else {
@@ -666,27 +990,31 @@ blconf_g_property_unbind_by_property(BlconfChannel *channel,
                                      gpointer object,
                                      const gchar *object_property)
 {
-    GSList *l;
-    BlconfGBinding *binding;
+    BlconfGBindingDispatcher *dispatcher = NULL;
+    BlconfGBinding *binding = NULL;
+    GSList *l = NULL;
 
     g_return_if_fail(BLCONF_IS_CHANNEL(channel));
     g_return_if_fail(blconf_property && *blconf_property == '/');
     g_return_if_fail(G_IS_OBJECT(object));
     g_return_if_fail(object_property && *object_property != '\0');
 
-    G_LOCK(__bindings);
-    for(l = __bindings; l; l = g_slist_next(l)) {
+    /* only the bindings of |blconf_property| need looking at */
+    if(__dispatcher_quark)
+        dispatcher = g_object_get_qdata(G_OBJECT(channel), __dispatcher_quark);
+
+    G_LOCK(__dispatchers);
+    if(dispatcher)
+        l = g_hash_table_lookup(dispatcher->bindings, blconf_property);
+    for(; l; l = g_slist_next(l)) {
         binding = l->data;
         if(binding->object == object
-           && binding->channel == channel
-           && !strcmp(blconf_property, binding->blconf_property)
            && !strcmp(object_property, binding->object_property))
             break;
     }
-    G_UNLOCK(__bindings);
+    G_UNLOCK(__dispatchers);
 
     if(G_LIKELY(l)) {
-        binding = l->data;
         g_signal_handler_disconnect(G_OBJECT(binding->object),
                                     binding->object_handler);
     } else {
@@ -714,7 +1042,7 @@ blconf_g_property_unbind_all(gpointer channel_or_object)
     if(BLCONF_IS_CHANNEL(channel_or_object)) {
         n = g_signal_handlers_disconnect_matched(channel_or_object, G_SIGNAL_MATCH_FUNC,
                                                  0, 0, NULL,
-                                                 blconf_g_property_channel_notify,
+                                                 blconf_g_binding_dispatcher_notify,
                                                  NULL);
     } else {
         n = g_signal_handlers_disconnect_matched(channel_or_object, G_SIGNAL_MATCH_FUNC,
@@ -30,6 +30,14 @@
 
 G_BEGIN_DECLS
 
+typedef struct
+{
+    const gchar *blconf_property;
+    GType blconf_property_type;
+    gpointer object;
+    const gchar *object_property;
+} BlconfGPropertyBinding;
+
 gulong blconf_g_property_bind(BlconfChannel *channel,
                               const gchar *blconf_property,
                               GType blconf_property_type,
@@ -46,6 +54,11 @@ gulong blconf_g_property_bind_gdkrgba(BlconfChannel *channel,
                                       gpointer object,
                                       const gchar *object_property);
 
+guint blconf_g_property_bind_many(BlconfChannel *channel,
+                                  const BlconfGPropertyBinding *entries,
+                                  guint n_entries,
+                                  gulong *ids);
+
 void blconf_g_property_unbind(gulong id);
 
 void blconf_g_property_unbind_by_property(BlconfChannel *channel,
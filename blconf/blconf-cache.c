@@ -18,32 +18,66 @@
  *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* for the memfd sealing fcntl()s */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
 
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
 #ifdef HAVE_STRING_H
 #include <string.h>
 #endif
 
+#include <gio/gunixfdlist.h>
+
 #include "blconf-cache.h"
 #include "blconf-channel.h"
 #include "blconf-errors.h"
-#include "blconf-dbus-bindings.h"
 #include "common/blconf-gvaluefuncs.h"
 #include "blconf-private.h"
 #include "common/blconf-marshal.h"
 #include "common/blconf-common-private.h"
+#include "common/blconf-probes.h"
+#include "common/blconf-snapshot.h"
 #if 0
 #include "blconf-types.h"
 #include "blconf.h"
 #include "blconf-alias.h"
 #endif
 
-#if 0
 #define DEFAULT_MAX_ENTRIES  -1  /* no limit */
+#define DEFAULT_MAX_BYTES    -1  /* no limit */
 #define DEFAULT_MAX_AGE      (60*60)  /* 1 hour */
-#endif
+
+/* misses remembered at most; random probes can't grow it further */
+#define MAX_MISSING  1024
+
+/* locked hits in a row before blconf_cache_lookup() publishes a new
+ * read view, see below */
+#define VIEW_REBUILD_HITS  16
 
 #define ALIGN_VAL(val, align)  ( ((val) + ((align) -1)) & ~((align) - 1) )
 
@@ -59,17 +93,109 @@
 
 
 
+/****************** BlconfCacheViewEntry ******************/
+
+
+/* an item's value as the lock-free readers see it.  never changed
+ * once made, and shared by every view published until the item's
+ * value changes, see blconf_cache_view_publish() */
+typedef struct
+{
+    gint ref_count;
+    gchar *property;  /* its key in the views */
+    GValue value;
+    /* set by the lock-free readers, and moved to the item's place in
+     * the LRU queue once the lock is held */
+    volatile gint used;
+} BlconfCacheViewEntry;
+
+static BlconfCacheViewEntry *
+blconf_cache_view_entry_new(const gchar *property,
+                            const GValue *value)
+{
+    BlconfCacheViewEntry *entry = g_slice_new0(BlconfCacheViewEntry);
+
+    entry->ref_count = 1;
+    entry->property = g_strdup(property);
+    g_value_init(&entry->value, G_VALUE_TYPE(value));
+    g_value_copy(value, &entry->value);
+
+    return entry;
+}
+
+static BlconfCacheViewEntry *
+blconf_cache_view_entry_ref(BlconfCacheViewEntry *entry)
+{
+    g_atomic_int_inc(&entry->ref_count);
+    return entry;
+}
+
+static void
+blconf_cache_view_entry_unref(BlconfCacheViewEntry *entry)
+{
+    if(!g_atomic_int_dec_and_test(&entry->ref_count))
+        return;
+
+    g_free(entry->property);
+    g_value_unset(&entry->value);
+    g_slice_free(BlconfCacheViewEntry, entry);
+}
+
+
+
 /**************** BlconfCacheItem ****************/
 
 
 typedef struct
 {
-#if 0
-    GTimeVal last_used;
-#endif
+    GList lru_link;  /* in |cache->lru|, most recently used first */
+    const gchar *property;  /* the item's key in |cache->properties| */
+    GSequenceIter *index_iter;  /* its place in |cache->index| */
+    gint64 last_used;
+    gsize size;  /* roughly, in bytes, key included */
+    /* the value is the same as in the cache's snapshot, so the item
+     * can be dropped and fetched from there again */
+    guint from_snapshot : 1;
+    /* the daemon's generation for the value, if the item was filled
+     * with one, or 0; see blconf_cache_patch_array() */
+    guint64 generation;
     GValue *value;
+    /* the value as published, or NULL; its size is part of |size| */
+    BlconfCacheViewEntry *entry;
 } BlconfCacheItem;
 
+/* a rough guess of the memory held by |value| */
+static gsize
+blconf_cache_value_size(const GValue *value)
+{
+    gsize size = sizeof(GValue);
+
+    if(G_VALUE_HOLDS_STRING(value)) {
+        const gchar *str = g_value_get_string(value);
+
+        if(str)
+            size += strlen(str) + 1;
+    } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_PACKED_ARRAY)
+        size += g_variant_get_size(g_value_get_boxed(value));
+    else if(G_VALUE_TYPE(value) == G_TYPE_STRV) {
+        gchar **strv = g_value_get_boxed(value);
+
+        for(; strv && *strv; ++strv)
+            size += sizeof(gchar *) + strlen(*strv) + 1;
+    } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY) {
+        GPtrArray *arr = g_value_get_boxed(value);
+        guint i;
+
+        if(arr) {
+            size += sizeof(GPtrArray) + arr->len * sizeof(gpointer);
+            for(i = 0; i < arr->len; ++i)
+                size += blconf_cache_value_size(g_ptr_array_index(arr, i));
+        }
+    }
+
+    return size;
+}
+
 static BlconfCacheItem *
 blconf_cache_item_new(const GValue *value,
                       gboolean steal)
@@ -79,16 +205,16 @@ blconf_cache_item_new(const GValue *value,
     g_return_val_if_fail(value, NULL);
 
     item = g_slice_new0(BlconfCacheItem);
-#if 0
-    g_get_current_time(&item->last_used);
-#endif
+    item->lru_link.data = item;
 
-    if(G_LIKELY(steal)) {
+    if(G_LIKELY(steal) && G_VALUE_TYPE(value) != BLCONF_TYPE_G_VALUE_ARRAY)
         item->value = (GValue *) value;
-    } else {
+    else {
+        /* arrays are kept packed where they can be */
         item->value = g_new0(GValue, 1);
-        g_value_init(item->value, G_VALUE_TYPE(value));
-        g_value_copy(value, item->value);
+        _blconf_gvalue_copy_packed(value, item->value);
+        if(steal)
+            _blconf_gvalue_free((GValue *) value);
     }
 
     return item;
@@ -101,14 +227,9 @@ blconf_cache_item_update(BlconfCacheItem *item,
     if(value && _blconf_gvalue_is_equal(item->value, value))
         return FALSE;
 
-#if 0
-    g_get_current_time(&item->last_used);
-#endif
-
     if(value) {
         g_value_unset(item->value);
-        g_value_init(item->value, G_VALUE_TYPE(value));
-        g_value_copy(value, item->value);
+        _blconf_gvalue_copy_packed(value, item->value);
 
         return TRUE;
     }
@@ -121,6 +242,8 @@ blconf_cache_item_free(BlconfCacheItem *item)
 {
     g_return_if_fail(item);
 
+    if(item->entry)
+        blconf_cache_view_entry_unref(item->entry);
     g_value_unset(item->value);
     g_free(item->value);
     g_slice_free(BlconfCacheItem, item);
@@ -133,10 +256,19 @@ blconf_cache_item_free(BlconfCacheItem *item)
 typedef struct
 {
     gchar *property;
-    DBusGProxyCall *call;
+    /* id of the SetProperty call in flight, 0 if none */
+    guint call;
     BlconfCacheItem *item;
 } BlconfCacheOldItem;
 
+typedef struct
+{
+    BlconfCache *cache;
+    guint call;
+    /* for a SetProperties call, the ids of the properties in it */
+    GArray *calls;
+} BlconfCacheCallData;
+
 static BlconfCacheOldItem *
 blconf_cache_old_item_new(const gchar *property)
 {
@@ -168,30 +300,6 @@ blconf_cache_old_item_free(BlconfCacheOldItem *old_item)
     g_slice_free(BlconfCacheOldItem, old_item);
 }
 
-static gboolean
-blconf_cache_old_item_end_call(gpointer key,
-                               gpointer value,
-                               gpointer user_data)
-{
-    const gchar *channel_name = user_data;
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
-    GError *error = NULL;
-    BlconfCacheOldItem *old_item = value;
-
-    g_return_val_if_fail(old_item->call, TRUE);
-
-    if(!dbus_g_proxy_end_call(proxy, old_item->call, &error, G_TYPE_INVALID)) {
-       g_warning("Failed to set property \"%s::%s\": %s",
-                  channel_name, old_item->property, error->message);
-        g_error_free(error);
-    }
-
-    old_item->call = NULL;
-
-    return TRUE;
-}
-
-
 /************************* BlconfCache ********************/
 
 
@@ -206,16 +314,83 @@ struct _BlconfCache
 
     gchar *channel_name;
 
-#if 0
+    GDBusProxy *proxy;
+    guint signal_id;  /* signal subscription for |channel_name| only */
+    /* property base -> number of channel objects looking at it.  only
+     * changes below these are heard of, see blconf_cache_watch() */
+    GHashTable *watched;
+
+    /* limits on |properties|, -1 (0 for the age) means none.  see
+     * blconf_cache_trim() */
     gint max_entries;
+    gint64 max_bytes;
     gint max_age;
-#endif
-
-    GTree *properties;
-
+    GSource *expire_source;
+
+    /* property -> BlconfCacheItem, for lookups by name.  |index| has
+     * the same items sorted by name, for whole subtrees at a time */
+    GHashTable *properties;
+    GSequence *index;
+    GQueue lru;  /* of every item in |properties| */
+    gint64 n_bytes;
+
+    /* properties known not to exist, and the bases under which we
+     * have every property that does.  neither is used while there's a
+     * snapshot, which answers the same by itself. */
+    GHashTable *missing;
+    GSList *complete_bases;
+    gboolean prefetch_truncated;
+    guint insertions;  /* bumped whenever a property appears */
+
+    /* the daemon's shared snapshot of the whole channel, if we have
+     * one.  it is never updated; |properties| has everything that
+     * changed since, and |removed| what went away */
+    GVariant *snapshot;
+    GHashTable *removed;
+    gboolean snapshot_tried;
+
+    /* a generation of the channel we have every change since, either
+     * fetched or from the signals; 0 if unknown.  lets a reconnect
+     * catch up, see blconf_cache_reconnect() */
+    guint64 generation;
+    gboolean generation_tried;
+
+    /* call id -> BlconfCacheOldItem */
     GHashTable *pending_calls;
+    guint last_call;
     GHashTable *old_properties;
 
+    /* properties written locally but not sent yet, and the timer that
+     * sends them.  see blconf_cache_set() */
+    GHashTable *deferred;
+    GSource *flush_source;
+
+    /* property -> BlconfCacheViewEntry, an immutable view of
+     * |properties| for lookups that don't take the lock, or NULL.
+     * replaced views wait in |retired_views| until no reader is left
+     * that may still be looking at one.  see blconf_cache_view_lookup() */
+    GHashTable *volatile view;
+    volatile gint view_readers;
+    GSList *retired_views;
+    guint view_hits;  /* locked hits since |view| went away */
+    gint64 view_bytes;  /* of the items' entries, part of |n_bytes| */
+
+    /* property -> BlconfCacheLookup, see blconf_cache_lookup_async() */
+    GHashTable *pending_lookups;
+    guint users;  /* channel objects, see blconf_cache_acquire() */
+    guint removals;  /* bumped whenever cached properties may go away */
+    guint evictions;  /* bumped whenever blconf_cache_trim() drops one */
+
+    /* see blconf_cache_get_stats().  they're bumped from lookups that
+     * don't take the lock, so always atomically */
+    volatile gint n_hits;
+    volatile gint n_misses;
+    volatile gint n_round_trips;
+    volatile gssize round_trip_time;
+    volatile gint n_prefetched;
+    volatile gint n_signals;
+    volatile gint n_relevant_signals;
+
 #if GLIB_CHECK_VERSION (2, 32, 0)
     GMutex cache_lock;
 #else
@@ -243,10 +418,9 @@ enum
 {
     PROP0 = 0,
     PROP_CHANNEL_NAME,
-#if 0
     PROP_MAX_ENTRIES,
+    PROP_MAX_BYTES,
     PROP_MAX_AGE,
-#endif
 };
 
 static void blconf_cache_set_g_property(GObject *object,
@@ -257,17 +431,36 @@ static void blconf_cache_get_g_property(GObject *object,
                                         guint property_id,
                                         GValue *value,
                                         GParamSpec *pspec);
+static void blconf_cache_constructed(GObject *obj);
 static void blconf_cache_finalize(GObject *obj);
 
-static void blconf_cache_property_changed(DBusGProxy *proxy,
+static void blconf_cache_dbus_signal(GDBusConnection *connection,
+                                     const gchar *sender_name,
+                                     const gchar *object_path,
+                                     const gchar *interface_name,
+                                     const gchar *signal_name,
+                                     GVariant *parameters,
+                                     gpointer user_data);
+static void blconf_cache_property_changed(BlconfCache *cache,
                                           const gchar *cache_name,
                                           const gchar *property,
-                                          const GValue *value,
-                                          gpointer user_data);
-static void blconf_cache_property_removed(DBusGProxy *proxy,
+                                          const GValue *value);
+static void blconf_cache_property_removed(BlconfCache *cache,
+                                          const gchar *cache_name,
+                                          const gchar *property);
+static void blconf_cache_property_patched(BlconfCache *cache,
                                           const gchar *cache_name,
                                           const gchar *property,
-                                          gpointer user_data);
+                                          guint64 base,
+                                          guint64 generation,
+                                          GVariant *splices_variant);
+static void blconf_cache_properties_reset(BlconfCache *cache,
+                                          const gchar *cache_name,
+                                          const gchar *property_base,
+                                          const gchar **properties);
+static void blconf_cache_detach_snapshot(BlconfCache *cache);
+static void blconf_cache_remove_subtree(BlconfCache *cache,
+                                        const gchar *property_base);
 
 
 static guint signals[N_SIGS] = { 0, };
@@ -283,6 +476,7 @@ blconf_cache_class_init(BlconfCacheClass *klass)
 
     object_class->set_property = blconf_cache_set_g_property;
     object_class->get_property = blconf_cache_get_g_property;
+    object_class->constructed = blconf_cache_constructed;
     object_class->finalize = blconf_cache_finalize;
 
     signals[SIG_PROPERTY_CHANGED] = g_signal_new(I_("property-changed"),
@@ -308,7 +502,7 @@ blconf_cache_class_init(BlconfCacheClass *klass)
                                                         | G_PARAM_STATIC_NAME
                                                         | G_PARAM_STATIC_NICK
                                                         | G_PARAM_STATIC_BLURB));
-#if 0
+
     g_object_class_install_property(object_class, PROP_MAX_ENTRIES,
                                     g_param_spec_int("max-entries",
                                                      "Maximum entries",
@@ -321,6 +515,18 @@ blconf_cache_class_init(BlconfCacheClass *klass)
                                                      | G_PARAM_STATIC_NICK
                                                      | G_PARAM_STATIC_BLURB));
 
+    g_object_class_install_property(object_class, PROP_MAX_BYTES,
+                                    g_param_spec_int64("max-bytes",
+                                                       "Maximum bytes",
+                                                       "Roughly, the maximum memory the cache entries may take up",
+                                                       -1, G_MAXINT64,
+                                                       DEFAULT_MAX_BYTES,
+                                                       G_PARAM_READWRITE
+                                                       | G_PARAM_CONSTRUCT
+                                                       | G_PARAM_STATIC_NAME
+                                                       | G_PARAM_STATIC_NICK
+                                                       | G_PARAM_STATIC_BLURB));
+
     g_object_class_install_property(object_class, PROP_MAX_AGE,
                                     g_param_spec_int("max-age",
                                                      "Maximum age",
@@ -332,30 +538,34 @@ blconf_cache_class_init(BlconfCacheClass *klass)
                                                      | G_PARAM_STATIC_NAME
                                                      | G_PARAM_STATIC_NICK
                                                      | G_PARAM_STATIC_BLURB));
-#endif
 }
 
 static void
 blconf_cache_init(BlconfCache *cache)
 {
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
+    /* keep our own ref, so the subscription can still be dropped if
+     * a late SetProperty reply outlives blconf_shutdown() */
+    cache->proxy = g_object_ref(_blconf_get_gdbus_proxy());
 
-    dbus_g_proxy_connect_signal(proxy, "PropertyChanged",
-                                G_CALLBACK(blconf_cache_property_changed),
-                                cache, NULL);
-    dbus_g_proxy_connect_signal(proxy, "PropertyRemoved",
-                                G_CALLBACK(blconf_cache_property_removed),
-                                cache, NULL);
-
-    cache->properties = g_tree_new_full((GCompareDataFunc)strcmp, NULL,
-                                        (GDestroyNotify)g_free,
-                                        (GDestroyNotify)blconf_cache_item_free);
+    cache->properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              (GDestroyNotify)g_free,
+                                              (GDestroyNotify)blconf_cache_item_free);
+    cache->index = g_sequence_new(NULL);
+    g_queue_init(&cache->lru);
 
     cache->pending_calls = g_hash_table_new_full(g_direct_hash, g_direct_equal,
                                                  NULL,
                                                  (GDestroyNotify)blconf_cache_old_item_free);
     cache->old_properties = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                   NULL, NULL);
+    cache->deferred = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->removed = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free, NULL);
+    cache->pending_lookups = g_hash_table_new(g_str_hash, g_str_equal);
+    cache->missing = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free, NULL);
+    cache->watched = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free, NULL);
 
 #if GLIB_CHECK_VERSION (2, 32, 0)
     g_mutex_init (&cache->cache_lock);
@@ -377,15 +587,19 @@ blconf_cache_set_g_property(GObject *object,
             g_free(cache->channel_name);
             cache->channel_name = g_value_dup_string(value);
             break;
-#if 0
+
         case PROP_MAX_ENTRIES:
             blconf_cache_set_max_entries(cache, g_value_get_int(value));
             break;
 
+        case PROP_MAX_BYTES:
+            blconf_cache_set_max_bytes(cache, g_value_get_int64(value));
+            break;
+
         case PROP_MAX_AGE:
             blconf_cache_set_max_age(cache, g_value_get_int(value));
             break;
-#endif
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -404,348 +618,2987 @@ blconf_cache_get_g_property(GObject *object,
         case PROP_CHANNEL_NAME:
             g_value_set_string(value, cache->channel_name);
             break;
-#if 0
+
         case PROP_MAX_ENTRIES:
             g_value_set_int(value, cache->max_entries);
             break;
 
+        case PROP_MAX_BYTES:
+            g_value_set_int64(value, cache->max_bytes);
+            break;
+
         case PROP_MAX_AGE:
             g_value_set_int(value, cache->max_age);
             break;
-#endif
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
     }
 }
 
-static void
-blconf_cache_finalize(GObject *obj)
+/* whether |property| is |property_base| or below it */
+static gboolean
+blconf_cache_path_is_under(const gchar *property,
+                           const gchar *property_base)
 {
-    BlconfCache *cache = BLCONF_CACHE(obj);
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
-    GHashTable *pending_calls;
+    gsize len = strlen(property_base);
 
-    dbus_g_proxy_disconnect_signal(proxy, "PropertyChanged",
-                                   G_CALLBACK(blconf_cache_property_changed),
-                                   cache);
+    return !strcmp(property_base, "/")
+           || (!strncmp(property, property_base, len)
+               && (property[len] == '\0' || property[len] == '/'));
+}
 
-    dbus_g_proxy_disconnect_signal(proxy, "PropertyRemoved",
-                                   G_CALLBACK(blconf_cache_property_removed),
-                                   cache);
+/* whether the changes to |property| reach the cache.  called with the
+ * lock held */
+static gboolean
+blconf_cache_is_watched(BlconfCache *cache,
+                        const gchar *property)
+{
+    GHashTableIter iter;
+    gpointer base;
 
-    /* finish pending calls (without emitting signals, therefore we set
-     * the hash table in the cache to %NULL) */
-    pending_calls = cache->pending_calls;
-    cache->pending_calls = NULL;
-    g_hash_table_foreach_remove(pending_calls, blconf_cache_old_item_end_call,
-                                cache->channel_name);
-    g_hash_table_unref(pending_calls);
+    g_hash_table_iter_init(&iter, cache->watched);
+    while(g_hash_table_iter_next(&iter, &base, NULL)) {
+        if(blconf_cache_path_is_under(property, base))
+            return TRUE;
+    }
 
-    g_free(cache->channel_name);
+    return FALSE;
+}
 
-    g_tree_destroy(cache->properties);
-    g_hash_table_destroy(cache->old_properties);
+/* "type='signal',...,arg0='<channel>'" and so on, for AddMatch */
+static gchar *
+blconf_cache_match_rule(BlconfCache *cache,
+                        const gchar *member,
+                        const gchar *property_base)
+{
+    GString *rule = g_string_new("type='signal'");
+    const gchar *keys[] = { "sender", "interface", "path", "member",
+                            "arg0", "arg1path" };
+    const gchar *values[G_N_ELEMENTS(keys)];
+    gchar *subtree = NULL;
+    guint i;
+
+    values[0] = g_dbus_proxy_get_name(cache->proxy);
+    values[1] = g_dbus_proxy_get_interface_name(cache->proxy);
+    values[2] = g_dbus_proxy_get_object_path(cache->proxy);
+    values[3] = member;
+    values[4] = cache->channel_name;
+    /* "/a/" matches "/a/" and everything below, but not "/ab" */
+    if(property_base)
+        values[5] = subtree = g_strconcat(property_base, "/", NULL);
+    else
+        values[5] = NULL;
+
+    for(i = 0; i < G_N_ELEMENTS(keys); ++i) {
+        const gchar *p;
+
+        if(!values[i])
+            continue;
+
+        /* there's no escaping inside quotes, so a quote is closed,
+         * escaped and reopened */
+        g_string_append_printf(rule, ",%s='", keys[i]);
+        for(p = values[i]; *p; ++p) {
+            if(*p == '\'')
+                g_string_append(rule, "'\\''");
+            else
+                g_string_append_c(rule, *p);
+        }
+        g_string_append_c(rule, '\'');
+    }
 
-#if !GLIB_CHECK_VERSION (2, 32, 0)
-    g_mutex_free (cache->cache_lock);
-#endif
+    g_free(subtree);
 
-    G_OBJECT_CLASS(blconf_cache_parent_class)->finalize(obj);
+    return g_string_free(rule, FALSE);
 }
 
-
-
 static void
-blconf_cache_property_changed(DBusGProxy *proxy,
-                              const gchar *channel_name,
-                              const gchar *property,
-                              const GValue *value,
-                              gpointer user_data)
+blconf_cache_bus_match(BlconfCache *cache,
+                       gboolean add,
+                       const gchar *member,
+                       const gchar *property_base)
 {
-    BlconfCache *cache = BLCONF_CACHE(user_data);
-    BlconfCacheItem *item;
-    gboolean changed = TRUE;
+    gchar *rule = blconf_cache_match_rule(cache, member, property_base);
+
+    g_dbus_connection_call(g_dbus_proxy_get_connection(cache->proxy),
+                           "org.freedesktop.DBus",
+                           "/org/freedesktop/DBus",
+                           "org.freedesktop.DBus",
+                           add ? "AddMatch" : "RemoveMatch",
+                           g_variant_new("(s)", rule), NULL,
+                           G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+    g_free(rule);
+}
 
-    if(strcmp(channel_name, cache->channel_name))
-        return;
+/* asks for, or stops asking for, the changes below |property_base|.
+ * on the bus that's a match rule per signal, which the bus daemon
+ * checks; on a private connection the daemon itself filters, see
+ * Subscribe.  neither waits for a reply: later calls are on the same
+ * connection, so they're only answered after this is in place. */
+static void
+blconf_cache_watch_base(BlconfCache *cache,
+                        const gchar *property_base,
+                        gboolean add)
+{
+    GDBusConnection *connection = g_dbus_proxy_get_connection(cache->proxy);
 
-    /* if a call was cancelled, we still receive a property-changed from
-     * that value, in that case, abort the emission of the signal. we can
-     * detect this because the new reply is not processed yet and thus
-     * there is still an old_prop in the hash table */
-    if(g_hash_table_lookup(cache->old_properties, property))
+    if(g_dbus_connection_is_closed(connection))
         return;
 
-    item = g_tree_lookup(cache->properties, property);
-    if(item)
-        changed = blconf_cache_item_update(item, value);
-    else {
-        item = blconf_cache_item_new(value, FALSE);
-        g_tree_insert(cache->properties, g_strdup(property), item);
+    if(!g_dbus_proxy_get_name(cache->proxy)) {
+        g_dbus_proxy_call(cache->proxy, add ? "Subscribe" : "Unsubscribe",
+                          g_variant_new("(ss)", cache->channel_name,
+                                        property_base),
+                          G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+    } else {
+#if GLIB_CHECK_VERSION (2, 38, 0)
+        /* the whole channel is just the channel name; naming the
+         * signals keeps PropertiesChanged and the rest out */
+        if(!strcmp(property_base, "/"))
+            property_base = NULL;
+        blconf_cache_bus_match(cache, add, "PropertyChanged", property_base);
+        blconf_cache_bus_match(cache, add, "PropertyRemoved", property_base);
+#endif
     }
+}
 
-    if(changed) {
-        g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
-                      cache->channel_name, property, value);
+/* The proxy doesn't listen for signals itself.  Each cache asks only
+ * for the signals whose first argument is its channel name, and of
+ * the per-property ones, only for those below the property bases its
+ * channel objects look at.  So a change to one panel plugin wakes up
+ * just the process that has that plugin, rather than every client in
+ * the session.  (With a GLib too old to leave the match rules to us,
+ * the bus sends the whole channel, and blconf_cache_is_watched() sorts
+ * it out.) */
+static void
+blconf_cache_subscribe(BlconfCache *cache)
+{
+    GDBusConnection *connection = g_dbus_proxy_get_connection(cache->proxy);
+    GDBusSignalFlags flags = G_DBUS_SIGNAL_FLAGS_NONE;
+    GHashTableIter iter;
+    gpointer base;
+
+#if GLIB_CHECK_VERSION (2, 38, 0)
+    if(g_dbus_proxy_get_name(cache->proxy)) {
+        flags |= G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE;
+        /* resets are rare, and may be for a parent of what we watch */
+        blconf_cache_bus_match(cache, TRUE, "PropertiesReset", NULL);
     }
+#endif
+
+    cache->signal_id = g_dbus_connection_signal_subscribe(connection,
+                                                          g_dbus_proxy_get_name(cache->proxy),
+                                                          g_dbus_proxy_get_interface_name(cache->proxy),
+                                                          NULL,
+                                                          g_dbus_proxy_get_object_path(cache->proxy),
+                                                          cache->channel_name,
+                                                          flags,
+                                                          blconf_cache_dbus_signal,
+                                                          cache, NULL);
+
+    g_hash_table_iter_init(&iter, cache->watched);
+    while(g_hash_table_iter_next(&iter, &base, NULL))
+        blconf_cache_watch_base(cache, base, TRUE);
 }
 
 static void
-blconf_cache_property_removed(DBusGProxy *proxy,
-                              const gchar *channel_name,
-                              const gchar *property,
-                              gpointer user_data)
+blconf_cache_unsubscribe(BlconfCache *cache)
 {
-    BlconfCache *cache = BLCONF_CACHE(user_data);
-    GValue value = { 0, };
+    GDBusConnection *connection = g_dbus_proxy_get_connection(cache->proxy);
+    GHashTableIter iter;
+    gpointer base;
 
-    if(strcmp(channel_name, cache->channel_name))
-        return;
+    g_hash_table_iter_init(&iter, cache->watched);
+    while(g_hash_table_iter_next(&iter, &base, NULL))
+        blconf_cache_watch_base(cache, base, FALSE);
 
-    g_tree_remove(cache->properties, property);
+#if GLIB_CHECK_VERSION (2, 38, 0)
+    if(g_dbus_proxy_get_name(cache->proxy)
+       && !g_dbus_connection_is_closed(connection))
+    {
+        blconf_cache_bus_match(cache, FALSE, "PropertiesReset", NULL);
+    }
+#endif
 
-    g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
-                  cache->channel_name, property, &value);
+    g_dbus_connection_signal_unsubscribe(connection, cache->signal_id);
 }
 
+static void
+blconf_cache_constructed(GObject *obj)
+{
+    BlconfCache *cache = BLCONF_CACHE(obj);
+
+    blconf_cache_subscribe(cache);
 
+    if(G_OBJECT_CLASS(blconf_cache_parent_class)->constructed)
+        G_OBJECT_CLASS(blconf_cache_parent_class)->constructed(obj);
+}
 
 static void
-blconf_cache_set_property_reply_handler(DBusGProxy *proxy,
-                                        DBusGProxyCall *call,
-                                        gpointer user_data)
+blconf_cache_finalize(GObject *obj)
 {
-    BlconfCache *cache = user_data;
-    BlconfCacheOldItem *old_item = NULL; 
-    BlconfCacheItem *item;
-    GError *error = NULL;
+    BlconfCache *cache = BLCONF_CACHE(obj);
+    GHashTableIter iter;
+    gpointer value;
 
-    if(!cache->pending_calls)
-        return;
+    blconf_cache_unsubscribe(cache);
+    g_object_unref(cache->proxy);
+    g_hash_table_destroy(cache->watched);
 
-    blconf_cache_mutex_lock(cache);
+    if(cache->expire_source) {
+        g_source_destroy(cache->expire_source);
+        g_source_unref(cache->expire_source);
+    }
 
-    old_item = g_hash_table_lookup(cache->pending_calls, call);
-    if(G_UNLIKELY(!old_item)) {
-#ifndef NDEBUG
-        g_debug("Couldn't find old cache item based on pending call (libblconf bug?)");
-#endif
-        goto out;
+    /* blconf_cache_release() flushes, so these can only be left over
+     * from after the last channel object is gone */
+    if(cache->flush_source) {
+        g_source_destroy(cache->flush_source);
+        g_source_unref(cache->flush_source);
     }
+    g_hash_table_iter_init(&iter, cache->deferred);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+        blconf_cache_old_item_free(value);
+    g_hash_table_destroy(cache->deferred);
 
-    g_hash_table_remove(cache->old_properties, old_item->property);
-    /* don't destroy old_item yet */
-    g_hash_table_steal(cache->pending_calls, old_item->call);
+    /* every SetProperty and GetProperty call holds a ref on the cache
+     * until its reply arrives, so there can't be any left at this
+     * point */
+    g_hash_table_destroy(cache->pending_calls);
+    g_hash_table_destroy(cache->pending_lookups);
 
-    item = g_tree_lookup(cache->properties, old_item->property);
-    if(G_UNLIKELY(!item)) {
-#ifndef NDEBUG
-        g_debug("Couldn't find current cache item based on pending call (libblconf bug?)");
+    g_free(cache->channel_name);
+
+    g_sequence_free(cache->index);
+    g_hash_table_destroy(cache->properties);
+    g_hash_table_destroy(cache->old_properties);
+    if(cache->snapshot)
+        g_variant_unref(cache->snapshot);
+    g_hash_table_destroy(cache->removed);
+    g_hash_table_destroy(cache->missing);
+    g_slist_free_full(cache->complete_bases, g_free);
+    if(cache->view)
+        g_hash_table_destroy(cache->view);
+    g_slist_free_full(cache->retired_views,
+                      (GDestroyNotify)g_hash_table_destroy);
+
+#if !GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_free (cache->cache_lock);
 #endif
-        goto out;
-    }
 
-    if(!dbus_g_proxy_end_call(proxy, call, &error, G_TYPE_INVALID)) {
-        /* failed to set the value.  reset it to the old value and send
-         * a prop changed signal to the channel */
-        GValue empty_val = { 0, };
+    G_OBJECT_CLASS(blconf_cache_parent_class)->finalize(obj);
+}
 
-        g_warning("Failed to set property \"%s::%s\": %s",
-                  cache->channel_name, old_item->property, error->message);
-        g_error_free(error);
 
-        if(old_item->item)
-            blconf_cache_item_update(item, old_item->item->value);
-        else {
-            g_tree_remove(cache->properties, old_item->property);
-            item = NULL;
-        }
 
-        /* we need to drop the lock when running the signal handlers */
-        blconf_cache_mutex_unlock(cache);
-        g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED],
-                      g_quark_from_string(old_item->property),
-                      cache->channel_name, old_item->property,
-                      item ? item->value : &empty_val);
-        blconf_cache_mutex_lock(cache);
-    }
+/* Every cached item is also in the sorted index and on the LRU queue,
+ * so items are only ever added, changed and dropped through the
+ * functions below. */
 
-    /* we handled the call, so set it to %NULL */
-    old_item->call = NULL;
+static gint
+blconf_cache_item_compare(gconstpointer a,
+                          gconstpointer b,
+                          gpointer user_data)
+{
+    return strcmp(((const BlconfCacheItem *)a)->property,
+                  ((const BlconfCacheItem *)b)->property);
+}
 
-    if(old_item)
-        blconf_cache_old_item_free(old_item);
-out:
-    blconf_cache_mutex_unlock(cache);
+static void blconf_cache_touch_item(BlconfCache *cache,
+                                    BlconfCacheItem *item);
+
+/* Hits can be served without the lock, from a view of the cached
+ * values that is never changed once published.  Anything that changes
+ * |cache->properties| first retires the view, and the next one is
+ * only made after a run of hits under the lock, so a cache that is
+ * still filling up doesn't rebuild it over and over.  The views hold
+ * references to the items' entries rather than copies, so publishing
+ * one only copies the values that changed since the last; the
+ * entries count towards the cache's size, and a view that wouldn't
+ * fit in |cache->max_bytes| isn't published at all.  A retired view
+ * is freed once no lock-free reader is in the middle of a lookup;
+ * every reader counts itself in |cache->view_readers| before looking
+ * at |cache->view|, so one that wasn't counted yet when the view was
+ * retired can't find it anymore. */
+
+static gsize
+blconf_cache_view_entry_size(const gchar *property,
+                             const GValue *value)
+{
+    return sizeof(BlconfCacheViewEntry) - sizeof(GValue)
+           + strlen(property) + 1 + blconf_cache_value_size(value);
 }
 
+/* drops the published copy of |item|'s value, which is about to
+ * change; views that still hold it keep it alive */
+static void
+blconf_cache_item_unpublish(BlconfCache *cache,
+                            BlconfCacheItem *item)
+{
+    gsize size;
 
+    if(!item->entry)
+        return;
+
+    size = blconf_cache_view_entry_size(item->entry->property,
+                                        &item->entry->value);
+    item->size -= size;
+    cache->n_bytes -= size;
+    cache->view_bytes -= size;
+    blconf_cache_view_entry_unref(item->entry);
+    item->entry = NULL;
+}
 
-#if 0
 static void
-blconf_cache_reset_property_reply_handler(DBusGProxy *proxy,
-                                          DBusGProxyCall *call,
-                                          gpointer user_data)
+blconf_cache_view_collect(BlconfCache *cache)
 {
-    BlconfCache *cache = user_data;
-    BlconfCacheOldItem *old_item;
-    GError *error = NULL;
+    if(cache->retired_views && !g_atomic_int_get(&cache->view_readers)) {
+        g_slist_free_full(cache->retired_views,
+                          (GDestroyNotify)g_hash_table_destroy);
+        cache->retired_views = NULL;
+    }
+}
 
-    blconf_cache_mutex_lock(cache);
+/* to be called with the lock held, before |cache->properties|
+ * changes */
+static void
+blconf_cache_view_retire(BlconfCache *cache)
+{
+    GHashTable *view = cache->view;
+    GHashTableIter iter;
+    gpointer key, value;
 
-    old_item = g_hash_table_lookup(cache->pending_calls, call);
-    if(G_UNLIKELY(!old_item)) {
-        g_critical("Couldn't find old cache item based on pending call (libblconf bug?)");
-        goto out;
+    cache->view_hits = 0;
+    if(!view)
+        return;
+
+    g_atomic_pointer_set(&cache->view, NULL);
+
+    /* the readers' uses count for the LRU queue too */
+    g_hash_table_iter_init(&iter, view);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        BlconfCacheViewEntry *entry = value;
+
+        if(g_atomic_int_get(&entry->used)) {
+            BlconfCacheItem *item = g_hash_table_lookup(cache->properties, key);
+
+            if(item)
+                blconf_cache_touch_item(cache, item);
+            /* the entry may well be in the next view too */
+            g_atomic_int_set(&entry->used, FALSE);
+        }
     }
 
-    if(!dbus_g_proxy_end_call(proxy, call, &error, G_TYPE_INVALID)) {
-        g_warning("Failed to reset property \"%s::%s\": %s",
-                  cache->channel_name, old_item->property, error->message);
-        g_error_free(error);
+    cache->retired_views = g_slist_prepend(cache->retired_views, view);
+    blconf_cache_view_collect(cache);
+}
+
+static void
+blconf_cache_view_publish(BlconfCache *cache)
+{
+    GHashTable *view;
+    GHashTableIter iter;
+    gpointer key, value;
+    gint64 n_bytes = cache->n_bytes;
+
+    cache->view_hits = 0;
+
+    if(cache->max_bytes >= 0) {
+        g_hash_table_iter_init(&iter, cache->properties);
+        while(g_hash_table_iter_next(&iter, &key, &value)) {
+            BlconfCacheItem *item = value;
+
+            if(!item->entry)
+                n_bytes += blconf_cache_view_entry_size(key, item->value);
+        }
+
+        /* hits keep going through the lock instead */
+        if(n_bytes > cache->max_bytes)
+            return;
     }
 
-out:
-    if(old_item)
-        g_hash_table_remove(cache->pending_calls, old_item->call);
+    view = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                 (GDestroyNotify)blconf_cache_view_entry_unref);
 
-    blconf_cache_mutex_unlock(cache);
-}
-#endif
+    g_hash_table_iter_init(&iter, cache->properties);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        BlconfCacheItem *item = value;
 
+        if(!item->entry) {
+            gsize size = blconf_cache_view_entry_size(key, item->value);
 
+            item->entry = blconf_cache_view_entry_new(key, item->value);
+            item->size += size;
+            cache->n_bytes += size;
+            cache->view_bytes += size;
+        }
 
-BlconfCache *
-blconf_cache_new(const gchar *channel_name)
-{
-    return g_object_new(BLCONF_TYPE_CACHE,
-                        "channel-name", channel_name,
-                        NULL);
+        g_hash_table_insert(view, item->entry->property,
+                            blconf_cache_view_entry_ref(item->entry));
+    }
+
+    blconf_cache_view_collect(cache);
+    g_atomic_pointer_set(&cache->view, view);
 }
 
-static gboolean
-blconf_cache_prefetch_ht(gpointer key,
-                         gpointer value,
-                         gpointer user_data)
+/* retires the view and frees the entries, which only the view needed */
+static void
+blconf_cache_view_drop(BlconfCache *cache)
 {
-    BlconfCache *cache = BLCONF_CACHE(user_data);
-    BlconfCacheItem *item;
+    GHashTableIter iter;
+    gpointer value;
 
-    item = blconf_cache_item_new(value, TRUE);
-    g_tree_insert(cache->properties, key, item);
+    blconf_cache_view_retire(cache);
 
-    return TRUE;
+    g_hash_table_iter_init(&iter, cache->properties);
+    while(cache->view_bytes && g_hash_table_iter_next(&iter, NULL, &value))
+        blconf_cache_item_unpublish(cache, value);
 }
 
-gboolean
-blconf_cache_prefetch(BlconfCache *cache,
+/* without the lock.  only finds properties with a value; anything
+ * else is left to blconf_cache_lookup_locked() */
+static gboolean
+blconf_cache_view_lookup(BlconfCache *cache,
+                         const gchar *property,
+                         GValue *value)
+{
+    GHashTable *view;
+    BlconfCacheViewEntry *entry = NULL;
+    gboolean ret = FALSE;
+
+    g_atomic_int_inc(&cache->view_readers);
+
+    view = g_atomic_pointer_get(&cache->view);
+    if(view)
+        entry = g_hash_table_lookup(view, property);
+
+    if(entry) {
+        if(!g_atomic_int_get(&entry->used))
+            g_atomic_int_set(&entry->used, TRUE);
+
+        if(!value)
+            ret = TRUE;
+        else if(!G_VALUE_TYPE(value)) {
+            _blconf_gvalue_copy_unpacked(&entry->value, value);
+            ret = TRUE;
+        } else if(G_VALUE_TYPE(value) == G_VALUE_TYPE(&entry->value)) {
+            g_value_copy(&entry->value, value);
+            ret = TRUE;
+        } else
+            ret = g_value_transform(&entry->value, value);
+    }
+
+    g_atomic_int_add(&cache->view_readers, -1);
+
+    return ret;
+}
+
+static void
+blconf_cache_remove_item(BlconfCache *cache,
+                         const gchar *property)
+{
+    BlconfCacheItem *item = g_hash_table_lookup(cache->properties, property);
+
+    if(!item)
+        return;
+
+    blconf_cache_view_retire(cache);
+    blconf_cache_item_unpublish(cache, item);
+
+    g_sequence_remove(item->index_iter);
+    g_queue_unlink(&cache->lru, &item->lru_link);
+    cache->n_bytes -= item->size;
+    g_hash_table_remove(cache->properties, property);
+}
+
+/* whether the cache holds every property there is under |property| */
+static gboolean
+blconf_cache_is_complete(BlconfCache *cache,
+                         const gchar *property)
+{
+    GSList *l;
+
+    for(l = cache->complete_bases; l; l = l->next) {
+        if(blconf_cache_path_is_under(property, l->data))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* whether |property| is known not to exist, without a snapshot */
+static gboolean
+blconf_cache_is_missing(BlconfCache *cache,
+                        const gchar *property)
+{
+    return g_hash_table_lookup(cache->missing, property)
+           || blconf_cache_is_complete(cache, property);
+}
+
+static void
+blconf_cache_add_missing(BlconfCache *cache,
+                         const gchar *property)
+{
+    if(cache->snapshot || blconf_cache_is_missing(cache, property))
+        return;
+
+    if(g_hash_table_size(cache->missing) >= MAX_MISSING)
+        g_hash_table_remove_all(cache->missing);
+    g_hash_table_insert(cache->missing, g_strdup(property),
+                        GINT_TO_POINTER(TRUE));
+}
+
+/* the cache may no longer hold every property under its complete
+ * bases */
+static void
+blconf_cache_forget_complete(BlconfCache *cache)
+{
+    g_slist_free_full(cache->complete_bases, g_free);
+    cache->complete_bases = NULL;
+}
+
+/* takes |property| and |item|, replacing any item already there */
+static void
+blconf_cache_insert_item(BlconfCache *cache,
+                         gchar *property,
+                         BlconfCacheItem *item)
+{
+    blconf_cache_remove_item(cache, property);
+    blconf_cache_view_retire(cache);
+    g_hash_table_remove(cache->missing, property);
+    cache->insertions++;
+
+    item->property = property;
+    item->last_used = g_get_monotonic_time();
+    item->size = sizeof(BlconfCacheItem) + strlen(property) + 1
+                 + blconf_cache_value_size(item->value);
+    g_hash_table_insert(cache->properties, property, item);
+    item->index_iter = g_sequence_insert_sorted(cache->index, item,
+                                                blconf_cache_item_compare,
+                                                NULL);
+    g_queue_push_head_link(&cache->lru, &item->lru_link);
+    cache->n_bytes += item->size;
+}
+
+static void
+blconf_cache_touch_item(BlconfCache *cache,
+                        BlconfCacheItem *item)
+{
+    item->last_used = g_get_monotonic_time();
+    if(cache->lru.head != &item->lru_link) {
+        g_queue_unlink(&cache->lru, &item->lru_link);
+        g_queue_push_head_link(&cache->lru, &item->lru_link);
+    }
+}
+
+static gboolean
+blconf_cache_update_item(BlconfCache *cache,
+                         BlconfCacheItem *item,
+                         const GValue *value)
+{
+    gsize value_size = blconf_cache_value_size(item->value);
+
+    blconf_cache_touch_item(cache, item);
+    if(!value || _blconf_gvalue_is_equal(item->value, value))
+        return FALSE;
+
+    blconf_cache_view_retire(cache);
+    if(!blconf_cache_item_update(item, value))
+        return FALSE;
+
+    blconf_cache_item_unpublish(cache, item);
+
+    item->from_snapshot = FALSE;
+    item->generation = 0;
+    cache->n_bytes -= item->size;
+    item->size += blconf_cache_value_size(item->value) - value_size;
+    cache->n_bytes += item->size;
+
+    return TRUE;
+}
+
+/* for the stats: a blocking call to the daemon, started at |start| */
+static void
+blconf_cache_count_round_trip(BlconfCache *cache,
+                              gint64 start)
+{
+    g_atomic_int_inc(&cache->n_round_trips);
+    g_atomic_pointer_add(&cache->round_trip_time,
+                         (gssize)(g_get_monotonic_time() - start));
+}
+
+/* _blconf_dbus_call_sync(), counted as a round trip */
+static GVariant *
+blconf_cache_call_sync(BlconfCache *cache,
+                       const gchar *method,
+                       GVariant *parameters,
+                       const GVariantType *reply_type,
+                       GError **error)
+{
+    gint64 start = g_get_monotonic_time();
+    GVariant *reply;
+
+    reply = _blconf_dbus_call_sync(method, parameters, reply_type, error);
+    blconf_cache_count_round_trip(cache, start);
+
+    return reply;
+}
+
+/* GetPropertyWithGeneration: |property| as the daemon has it, and the
+ * generation it changed at.  called with the lock held */
+static gboolean
+blconf_cache_fetch_generation(BlconfCache *cache,
+                              const gchar *property,
+                              GValue *value,
+                              guint64 *generation,
+                              GError **error)
+{
+    GVariant *reply, *variant;
+    gboolean ret;
+
+    reply = blconf_cache_call_sync(cache, "GetPropertyWithGeneration",
+                                   g_variant_new("(ss)", cache->channel_name,
+                                                 property),
+                                   G_VARIANT_TYPE("(tv)"), error);
+    if(!reply)
+        return FALSE;
+
+    g_variant_get(reply, "(tv)", generation, &variant);
+    ret = _blconf_gvariant_to_gvalue_packed(variant, value);
+    if(!ret) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                    "Received a value of unsupported type \"%s\"",
+                    g_variant_get_type_string(variant));
+    }
+    g_variant_unref(variant);
+    g_variant_unref(reply);
+
+    return ret;
+}
+
+/* puts |value| in the cache as |property|, at the daemon's
+ * |generation|.  returns TRUE if that changed it.  called with the
+ * lock held; the caller trims */
+static gboolean
+blconf_cache_store_generation(BlconfCache *cache,
+                              const gchar *property,
+                              const GValue *value,
+                              guint64 generation)
+{
+    BlconfCacheItem *item = g_hash_table_lookup(cache->properties, property);
+    gboolean changed = TRUE;
+
+    if(item)
+        changed = blconf_cache_update_item(cache, item, value);
+    else {
+        item = blconf_cache_item_new(value, FALSE);
+        blconf_cache_insert_item(cache, g_strdup(property), item);
+    }
+    item->generation = generation;
+
+    return changed;
+}
+
+/* like g_hash_table_lookup(), counting as a use of the item */
+static BlconfCacheItem *
+blconf_cache_lookup_item(BlconfCache *cache,
+                         const gchar *property)
+{
+    BlconfCacheItem *item = g_hash_table_lookup(cache->properties, property);
+
+    if(item)
+        blconf_cache_touch_item(cache, item);
+
+    return item;
+}
+
+/* Dropped items are simply fetched again on the next lookup.  Some
+ * can't be dropped, though: one with a write in flight holds the copy
+ * the failure path needs, and while a snapshot is attached, only an
+ * item that still matches it may go, as the lookup would otherwise
+ * find the snapshot's stale value. */
+static gboolean
+blconf_cache_item_is_evictable(BlconfCache *cache,
+                               BlconfCacheItem *item)
+{
+    if(cache->snapshot && !item->from_snapshot)
+        return FALSE;
+
+    return !g_hash_table_lookup(cache->old_properties, item->property);
+}
+
+static gboolean blconf_cache_expire(gpointer data);
+
+static void
+blconf_cache_weak_ref_free(GWeakRef *weak_ref)
+{
+    g_weak_ref_clear(weak_ref);
+    g_slice_free(GWeakRef, weak_ref);
+}
+
+/* evicts least recently used items until the cache is within its
+ * limits, along with those unused for longer than |cache->max_age|.
+ * the most recently used item always stays, so callers can still
+ * use the one they just looked up. */
+static void
+blconf_cache_trim(BlconfCache *cache)
+{
+    gint64 expired = G_MININT64;
+    GList *l, *prev;
+
+    if(cache->max_age > 0)
+        expired = g_get_monotonic_time() - (gint64)cache->max_age * G_USEC_PER_SEC;
+
+    for(l = cache->lru.tail; l && l != cache->lru.head; l = prev) {
+        BlconfCacheItem *item = l->data;
+
+        prev = l->prev;
+
+        if((cache->max_entries < 0 || cache->lru.length <= (guint)cache->max_entries)
+           && (cache->max_bytes < 0 || cache->n_bytes <= cache->max_bytes)
+           && item->last_used > expired)
+        {
+            break;
+        }
+
+        /* items the lock-free readers used may not be due at all,
+         * and the view's copies go before any item does */
+        if(cache->view || cache->view_bytes) {
+            blconf_cache_view_drop(cache);
+            prev = cache->lru.tail;
+            continue;
+        }
+
+        if(blconf_cache_item_is_evictable(cache, item)) {
+            blconf_cache_remove_item(cache, item->property);
+            blconf_cache_forget_complete(cache);
+            cache->evictions++;
+        }
+    }
+
+    /* idle processes get their memory back too */
+    if(cache->max_age > 0 && cache->lru.length && !cache->expire_source) {
+        GWeakRef *weak_ref = g_slice_new(GWeakRef);
+
+        g_weak_ref_init(weak_ref, cache);
+        cache->expire_source = g_timeout_source_new_seconds(cache->max_age);
+        g_source_set_callback(cache->expire_source, blconf_cache_expire,
+                              weak_ref,
+                              (GDestroyNotify)blconf_cache_weak_ref_free);
+        g_source_attach(cache->expire_source,
+                        g_main_context_get_thread_default());
+    }
+}
+
+static gboolean
+blconf_cache_expire(gpointer data)
+{
+    BlconfCache *cache = g_weak_ref_get(data);
+    gboolean keep = FALSE;
+
+    if(!cache)
+        return FALSE;
+
+    blconf_cache_mutex_lock(cache);
+
+    /* unless blconf_cache_set_max_age() just replaced the timer */
+    if(cache->expire_source == g_main_current_source()) {
+        blconf_cache_trim(cache);
+        if(!cache->lru.length) {
+            g_source_unref(cache->expire_source);
+            cache->expire_source = NULL;
+        } else
+            keep = TRUE;
+    }
+
+    blconf_cache_mutex_unlock(cache);
+
+    g_object_unref(cache);
+
+    return keep;
+}
+
+
+
+static void
+blconf_cache_dbus_signal(GDBusConnection *connection,
+                         const gchar *sender_name,
+                         const gchar *object_path,
+                         const gchar *interface_name,
+                         const gchar *signal_name,
+                         GVariant *parameters,
+                         gpointer user_data)
+{
+    BlconfCache *cache = BLCONF_CACHE(user_data);
+    const gchar *channel_name, *property;
+
+    g_atomic_int_inc(&cache->n_signals);
+
+    if(!strcmp(signal_name, "PropertyChanged")) {
+        GVariant *variant;
+        GValue value = { 0, };
+
+        g_variant_get(parameters, "(&s&sv)", &channel_name, &property,
+                      &variant);
+        if(_blconf_gvariant_to_gvalue_packed(variant, &value)) {
+            blconf_cache_property_changed(cache, channel_name, property,
+                                          &value);
+            g_value_unset(&value);
+        }
+        g_variant_unref(variant);
+    } else if(!strcmp(signal_name, "PropertyPatched")) {
+        GVariant *splices;
+        guint64 base, generation;
+
+        g_variant_get(parameters, "(&s&stt@a(uuav))", &channel_name,
+                      &property, &base, &generation, &splices);
+        blconf_cache_property_patched(cache, channel_name, property, base,
+                                      generation, splices);
+        g_variant_unref(splices);
+    } else if(!strcmp(signal_name, "PropertyRemoved")) {
+        g_variant_get(parameters, "(&s&s)", &channel_name, &property);
+        blconf_cache_property_removed(cache, channel_name, property);
+    } else if(!strcmp(signal_name, "PropertiesReset")) {
+        const gchar **properties;
+
+        g_variant_get(parameters, "(&s&s^a&s)", &channel_name, &property,
+                      &properties);
+        blconf_cache_properties_reset(cache, channel_name, property,
+                                      properties);
+        g_free(properties);
+    }
+}
+
+/* the handlers get arrays as GPtrArrays, whatever the cache keeps */
+static void
+blconf_cache_emit_property_changed(BlconfCache *cache,
+                                   const gchar *property,
+                                   const GValue *value)
+{
+    GValue unpacked = { 0, };
+
+    if(G_VALUE_TYPE(value) == BLCONF_TYPE_PACKED_ARRAY) {
+        _blconf_gvalue_copy_unpacked(value, &unpacked);
+        value = &unpacked;
+    }
+
+    g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
+                  cache->channel_name, property, value);
+
+    if(value == &unpacked)
+        g_value_unset(&unpacked);
+}
+
+static void
+blconf_cache_property_changed(BlconfCache *cache,
+                              const gchar *channel_name,
+                              const gchar *property,
+                              const GValue *value)
+{
+    BlconfCacheItem *item;
+    gboolean changed = TRUE;
+
+    if(strcmp(channel_name, cache->channel_name))
+        return;
+
+    blconf_cache_mutex_lock(cache);
+
+    if(!blconf_cache_is_watched(cache, property)) {
+        blconf_cache_mutex_unlock(cache);
+        return;
+    }
+
+    /* if a call was cancelled, we still receive a property-changed from
+     * that value, in that case, abort the emission of the signal. we can
+     * detect this because the new reply is not processed yet and thus
+     * there is still an old_prop in the hash table */
+    if(g_hash_table_lookup(cache->old_properties, property)) {
+        blconf_cache_mutex_unlock(cache);
+        return;
+    }
+
+    item = g_hash_table_lookup(cache->properties, property);
+    if(item) {
+        g_atomic_int_inc(&cache->n_relevant_signals);
+        changed = blconf_cache_update_item(cache, item, value);
+    } else {
+        item = blconf_cache_item_new(value, FALSE);
+        blconf_cache_insert_item(cache, g_strdup(property), item);
+        blconf_cache_trim(cache);
+    }
+
+    /* the handlers may well look the property up again */
+    blconf_cache_mutex_unlock(cache);
+
+    if(changed)
+        blconf_cache_emit_property_changed(cache, property, value);
+}
+
+/* PropertyPatched only comes to those that asked for it, see
+ * EnablePatches.  the splices apply to the cached copy if that's the
+ * one they were made to; one that has them already, like our own after
+ * blconf_cache_patch_array(), stays as it is.  any other copy, or none,
+ * is fetched again, along with the generation the next one will need. */
+static void
+blconf_cache_property_patched(BlconfCache *cache,
+                              const gchar *channel_name,
+                              const gchar *property,
+                              guint64 base,
+                              guint64 generation,
+                              GVariant *splices_variant)
+{
+    BlconfCacheItem *item;
+    GArray *splices = NULL;
+    GValue value = { 0, };
+    gboolean patched = FALSE, changed;
+
+    if(strcmp(channel_name, cache->channel_name))
+        return;
+
+    blconf_cache_mutex_lock(cache);
+
+    /* see blconf_cache_property_changed() */
+    if(!blconf_cache_is_watched(cache, property)
+       || g_hash_table_lookup(cache->old_properties, property))
+    {
+        blconf_cache_mutex_unlock(cache);
+        return;
+    }
+
+    item = g_hash_table_lookup(cache->properties, property);
+    if(item) {
+        g_atomic_int_inc(&cache->n_relevant_signals);
+        if(item->generation && generation <= item->generation) {
+            blconf_cache_mutex_unlock(cache);
+            return;
+        }
+        if(item->generation == base)
+            splices = _blconf_gvariant_to_splices(splices_variant);
+    }
+
+    if(splices) {
+        g_value_init(&value, G_VALUE_TYPE(item->value));
+        g_value_copy(item->value, &value);
+        patched = _blconf_gvalue_splice(&value,
+                                        (const BlconfArraySplice *)splices->data,
+                                        splices->len);
+        if(!patched)
+            g_value_unset(&value);
+        g_array_free(splices, TRUE);
+    }
+
+    if(!patched
+       && !blconf_cache_fetch_generation(cache, property, &value,
+                                         &generation, NULL))
+    {
+        blconf_cache_mutex_unlock(cache);
+        return;
+    }
+
+    changed = blconf_cache_store_generation(cache, property, &value,
+                                            generation);
+    blconf_cache_trim(cache);
+
+    blconf_cache_mutex_unlock(cache);
+
+    if(changed)
+        blconf_cache_emit_property_changed(cache, property, &value);
+    g_value_unset(&value);
+}
+
+static void
+blconf_cache_property_removed(BlconfCache *cache,
+                              const gchar *channel_name,
+                              const gchar *property)
+{
+    GValue value = { 0, };
+
+    if(strcmp(channel_name, cache->channel_name))
+        return;
+
+    blconf_cache_mutex_lock(cache);
+    if(!blconf_cache_is_watched(cache, property)) {
+        blconf_cache_mutex_unlock(cache);
+        return;
+    }
+    cache->removals++;
+    if(g_hash_table_lookup(cache->properties, property))
+        g_atomic_int_inc(&cache->n_relevant_signals);
+    blconf_cache_remove_item(cache, property);
+    blconf_cache_add_missing(cache, property);
+    if(cache->snapshot)
+        g_hash_table_insert(cache->removed, g_strdup(property), GINT_TO_POINTER(TRUE));
+    blconf_cache_mutex_unlock(cache);
+
+    g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
+                  cache->channel_name, property, &value);
+}
+
+static void
+blconf_cache_properties_reset(BlconfCache *cache,
+                              const gchar *channel_name,
+                              const gchar *property_base,
+                              const gchar **properties)
+{
+    GValue value = { 0, };
+    gboolean relevant = FALSE;
+    GPtrArray *watched;
+    gint i;
+
+    if(strcmp(channel_name, cache->channel_name) || !properties)
+        return;
+
+    watched = g_ptr_array_new();
+
+    blconf_cache_mutex_lock(cache);
+
+    cache->removals++;
+
+    /* drop everything first, so handlers of the signals below already
+     * see the whole reset */
+    for(i = 0; properties[i]; ++i) {
+        if(!blconf_cache_is_watched(cache, properties[i]))
+            continue;
+        g_ptr_array_add(watched, (gpointer)properties[i]);
+
+        if(!relevant && g_hash_table_lookup(cache->properties, properties[i]))
+            relevant = TRUE;
+        blconf_cache_remove_item(cache, properties[i]);
+        blconf_cache_add_missing(cache, properties[i]);
+        if(cache->snapshot) {
+            g_hash_table_insert(cache->removed, g_strdup(properties[i]),
+                                GINT_TO_POINTER(TRUE));
+        }
+    }
+    if(relevant)
+        g_atomic_int_inc(&cache->n_relevant_signals);
+
+    blconf_cache_mutex_unlock(cache);
+
+    for(i = 0; i < (gint)watched->len; ++i) {
+        g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
+                      cache->channel_name, g_ptr_array_index(watched, i),
+                      &value);
+    }
+
+    g_ptr_array_free(watched, TRUE);
+}
+
+
+
+/* handles the reply to the set with id |call|, if it still matters.
+ * called and returns with the lock held */
+static void
+blconf_cache_set_reply(BlconfCache *cache,
+                       guint call,
+                       const GError *error)
+{
+    BlconfCacheOldItem *old_item;
+    BlconfCacheItem *item;
+
+    /* a call that was overtaken by a later set has already been
+     * dropped from the table; its reply no longer matters */
+    old_item = g_hash_table_lookup(cache->pending_calls,
+                                   GUINT_TO_POINTER(call));
+    if(!old_item)
+        return;
+
+    g_hash_table_remove(cache->old_properties, old_item->property);
+    /* don't destroy old_item yet */
+    g_hash_table_steal(cache->pending_calls, GUINT_TO_POINTER(old_item->call));
+    /* we handled the call, so clear it */
+    old_item->call = 0;
+
+    item = g_hash_table_lookup(cache->properties, old_item->property);
+    if(G_UNLIKELY(!item)) {
+#ifndef NDEBUG
+        g_debug("Couldn't find current cache item based on pending call (libblconf bug?)");
+#endif
+        blconf_cache_old_item_free(old_item);
+        return;
+    }
+
+    if(error) {
+        /* failed to set the value.  reset it to the old value and send
+         * a prop changed signal to the channel */
+        GValue empty_val = { 0, };
+
+        g_warning("Failed to set property \"%s::%s\": %s",
+                  cache->channel_name, old_item->property, error->message);
+
+        if(old_item->item)
+            blconf_cache_update_item(cache, item, old_item->item->value);
+        else {
+            blconf_cache_remove_item(cache, old_item->property);
+            if(cache->snapshot) {
+                g_hash_table_insert(cache->removed,
+                                    g_strdup(old_item->property),
+                                    GINT_TO_POINTER(TRUE));
+            }
+            item = NULL;
+        }
+
+        /* we need to drop the lock when running the signal handlers */
+        blconf_cache_mutex_unlock(cache);
+        blconf_cache_emit_property_changed(cache, old_item->property,
+                                           item ? item->value : &empty_val);
+        blconf_cache_mutex_lock(cache);
+    }
+
+    blconf_cache_old_item_free(old_item);
+}
+
+static void
+blconf_cache_set_property_reply_handler(GObject *source_object,
+                                        GAsyncResult *res,
+                                        gpointer user_data)
+{
+    BlconfCacheCallData *data = user_data;
+    BlconfCache *cache = data->cache;
+    GVariant *reply;
+    GError *error = NULL;
+    guint i;
+
+    reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object),
+                                          res, &error);
+    if(reply)
+        g_variant_unref(reply);
+    else if(g_dbus_error_is_remote_error(error))
+        g_dbus_error_strip_remote_error(error);
+
+    BLCONF_PROBE3(set__reply, cache->channel_name, data->call, !error);
+
+    blconf_cache_mutex_lock(cache);
+
+    /* SetProperties applies all of its properties or none */
+    if(data->calls) {
+        for(i = 0; i < data->calls->len; ++i)
+            blconf_cache_set_reply(cache, g_array_index(data->calls, guint, i),
+                                   error);
+        g_array_free(data->calls, TRUE);
+    } else
+        blconf_cache_set_reply(cache, data->call, error);
+
+    blconf_cache_mutex_unlock(cache);
+
+    if(error)
+        g_error_free(error);
+    g_object_unref(cache);
+    g_slice_free(BlconfCacheCallData, data);
+}
+
+/* sends the deferred writes, all in one SetProperties call.  called
+ * with the lock held */
+static void
+blconf_cache_flush_locked(BlconfCache *cache)
+{
+    BlconfCacheCallData *data;
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer value;
+
+    if(cache->flush_source) {
+        g_source_destroy(cache->flush_source);
+        g_source_unref(cache->flush_source);
+        cache->flush_source = NULL;
+    }
+
+    if(!g_hash_table_size(cache->deferred))
+        return;
+
+    data = g_slice_new0(BlconfCacheCallData);
+    data->calls = g_array_new(FALSE, FALSE, sizeof(guint));
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    g_hash_table_iter_init(&iter, cache->deferred);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        BlconfCacheOldItem *old_item = value;
+        BlconfCacheItem *item = g_hash_table_lookup(cache->properties,
+                                                    old_item->property);
+        GVariant *variant = item ? _blconf_gvalue_to_gvariant(item->value) : NULL;
+
+        g_hash_table_iter_remove(&iter);
+
+        /* reset in the meantime, so there's nothing left to write */
+        if(!variant) {
+            g_hash_table_remove(cache->old_properties, old_item->property);
+            blconf_cache_old_item_free(old_item);
+            continue;
+        }
+
+        if(G_UNLIKELY(++cache->last_call == 0))
+            ++cache->last_call;
+        old_item->call = cache->last_call;
+        g_hash_table_insert(cache->pending_calls,
+                            GUINT_TO_POINTER(old_item->call), old_item);
+        g_array_append_val(data->calls, old_item->call);
+
+        g_variant_builder_add(&builder, "{sv}", old_item->property, variant);
+    }
+
+    if(!data->calls->len) {
+        g_variant_builder_clear(&builder);
+        g_array_free(data->calls, TRUE);
+        g_slice_free(BlconfCacheCallData, data);
+        return;
+    }
+
+    data->cache = g_object_ref(cache);
+    g_dbus_connection_call(g_dbus_proxy_get_connection(cache->proxy),
+                           g_dbus_proxy_get_name(cache->proxy),
+                           g_dbus_proxy_get_object_path(cache->proxy),
+                           g_dbus_proxy_get_interface_name(cache->proxy),
+                           "SetProperties",
+                           g_variant_new("(sa{sv})", cache->channel_name,
+                                         &builder),
+                           NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+                           blconf_cache_set_property_reply_handler, data);
+}
+
+static gboolean
+blconf_cache_flush_timeout(gpointer data)
+{
+    BlconfCache *cache = g_weak_ref_get(data);
+
+    if(!cache)
+        return FALSE;
+
+    blconf_cache_mutex_lock(cache);
+    /* unless a flush just replaced the timer */
+    if(cache->flush_source == g_main_current_source())
+        blconf_cache_flush_locked(cache);
+    blconf_cache_mutex_unlock(cache);
+
+    g_object_unref(cache);
+
+    return FALSE;
+}
+
+/* sends any writes blconf_cache_set() is holding back right away */
+void
+blconf_cache_flush(BlconfCache *cache)
+{
+    g_return_if_fail(BLCONF_IS_CACHE(cache));
+
+    blconf_cache_mutex_lock(cache);
+    blconf_cache_flush_locked(cache);
+    blconf_cache_mutex_unlock(cache);
+}
+
+
+
+
+
+
+BlconfCache *
+blconf_cache_new(const gchar *channel_name)
+{
+    return g_object_new(BLCONF_TYPE_CACHE,
+                        "channel-name", channel_name,
+                        NULL);
+}
+
+/* Every channel object of the process uses the same cache for its
+ * channel, whatever its property base, so there's one copy of each
+ * value and one signal subscription per channel.  The registry holds
+ * no reference; a cache leaves it when its last user releases it,
+ * even if pending calls keep it alive a little longer. */
+
+G_LOCK_DEFINE_STATIC(__caches);
+static GHashTable *__shared_caches = NULL;
+
+/* returns a new reference to the shared cache for |channel_name|, to
+ * be given back with blconf_cache_release() */
+BlconfCache *
+blconf_cache_acquire(const gchar *channel_name)
+{
+    BlconfCache *cache = NULL;
+
+    g_return_val_if_fail(channel_name, NULL);
+
+    G_LOCK(__caches);
+
+    if(!__shared_caches)
+        __shared_caches = g_hash_table_new(g_str_hash, g_str_equal);
+    else
+        cache = g_hash_table_lookup(__shared_caches, channel_name);
+
+    if(cache)
+        g_object_ref(G_OBJECT(cache));
+    else {
+        cache = blconf_cache_new(channel_name);
+        g_hash_table_insert(__shared_caches, cache->channel_name, cache);
+    }
+    cache->users++;
+
+    G_UNLOCK(__caches);
+
+    return cache;
+}
+
+void
+blconf_cache_release(BlconfCache *cache)
+{
+    g_return_if_fail(BLCONF_IS_CACHE(cache));
+
+    /* held back writes still go out, the call keeps the cache alive */
+    blconf_cache_flush(cache);
+
+    G_LOCK(__caches);
+
+    /* after blconf_shutdown(), a cache left over from before isn't in
+     * the registry any more */
+    if(--cache->users == 0 && __shared_caches
+       && g_hash_table_lookup(__shared_caches, cache->channel_name) == cache)
+    {
+        g_hash_table_remove(__shared_caches, cache->channel_name);
+    }
+
+    G_UNLOCK(__caches);
+
+    g_object_unref(G_OBJECT(cache));
+}
+
+/* the cache only hears of changes below the bases it watches, so
+ * whatever it has from outside them may be stale by now */
+static void
+blconf_cache_forget_subtree(BlconfCache *cache,
+                            const gchar *property_base)
+{
+    GHashTableIter iter;
+    gpointer property;
+    GSList *l, *next;
+
+    cache->removals++;
+
+    blconf_cache_detach_snapshot(cache);
+    blconf_cache_remove_item(cache, property_base);
+    blconf_cache_remove_subtree(cache, property_base);
+
+    g_hash_table_iter_init(&iter, cache->missing);
+    while(g_hash_table_iter_next(&iter, &property, NULL)) {
+        if(blconf_cache_path_is_under(property, property_base))
+            g_hash_table_iter_remove(&iter);
+    }
+
+    for(l = cache->complete_bases; l; l = next) {
+        next = l->next;
+        if(blconf_cache_path_is_under(l->data, property_base)
+           || blconf_cache_path_is_under(property_base, l->data))
+        {
+            g_free(l->data);
+            cache->complete_bases = g_slist_delete_link(cache->complete_bases, l);
+        }
+    }
+}
+
+/* "/a/b/", "/a/b" and NULL for "/" */
+static gchar *
+blconf_cache_normalize_base(const gchar *property_base)
+{
+    gchar *base;
+    gsize len;
+
+    if(!property_base || !property_base[0])
+        return g_strdup("/");
+
+    base = g_strdup(property_base);
+    len = strlen(base);
+    while(len > 1 && base[len - 1] == '/')
+        base[--len] = '\0';
+
+    return base;
+}
+
+/* a channel object looks at the properties below |property_base|
+ * (%NULL for the whole channel) from now on, until it calls
+ * blconf_cache_unwatch().  it mustn't look anything up there before
+ * this. */
+void
+blconf_cache_watch(BlconfCache *cache,
+                   const gchar *property_base)
+{
+    gchar *base = blconf_cache_normalize_base(property_base);
+    guint count;
+
+    blconf_cache_mutex_lock(cache);
+
+    count = GPOINTER_TO_UINT(g_hash_table_lookup(cache->watched, base));
+    if(!count) {
+        if(!blconf_cache_is_watched(cache, base))
+            blconf_cache_forget_subtree(cache, base);
+        blconf_cache_watch_base(cache, base, TRUE);
+    }
+    g_hash_table_replace(cache->watched, base, GUINT_TO_POINTER(count + 1));
+
+    blconf_cache_mutex_unlock(cache);
+}
+
+/* what's cached below |property_base| stays, but is dropped by the
+ * next blconf_cache_watch() there, unless another base still covers
+ * it */
+void
+blconf_cache_unwatch(BlconfCache *cache,
+                     const gchar *property_base)
+{
+    gchar *base = blconf_cache_normalize_base(property_base);
+    guint count;
+
+    blconf_cache_mutex_lock(cache);
+
+    count = GPOINTER_TO_UINT(g_hash_table_lookup(cache->watched, base));
+    if(count == 1) {
+        blconf_cache_watch_base(cache, base, FALSE);
+        g_hash_table_remove(cache->watched, base);
+    } else if(count > 1) {
+        g_hash_table_insert(cache->watched, g_strdup(base),
+                            GUINT_TO_POINTER(count - 1));
+    }
+
+    blconf_cache_mutex_unlock(cache);
+
+    g_free(base);
+}
+
+static void
+blconf_cache_flush_ht(gpointer key,
+                      gpointer value,
+                      gpointer user_data)
+{
+    blconf_cache_flush(value);
+}
+
+static void
+blconf_cache_dump_stats_ht(gpointer key,
+                           gpointer value,
+                           gpointer user_data)
+{
+    GHashTable *stats = blconf_cache_get_stats(value);
+    GString *text = g_string_new(NULL);
+    GHashTableIter iter;
+    gpointer name, stat;
+
+    g_hash_table_iter_init(&iter, stats);
+    while(g_hash_table_iter_next(&iter, &name, &stat)) {
+        gchar *str = g_strdup_value_contents(stat);
+
+        g_string_append_printf(text, " %s=%s", (const gchar *)name, str);
+        g_free(str);
+    }
+    g_message("Cache stats for \"%s\":%s", (const gchar *)key, text->str);
+
+    g_string_free(text, TRUE);
+    g_hash_table_destroy(stats);
+}
+
+/* Whatever changed while nobody was connected went unannounced.  If
+ * the cache knows a generation of the channel, and the daemon still
+ * remembers what changed since, only that is applied, as if the
+ * signals had come in; otherwise nothing we have can be trusted any
+ * more.  The new subscription is in place first, so nothing falls in
+ * between, and as the signals are handled in this same main context,
+ * they're only applied after the changes. */
+static void
+blconf_cache_reconnect(BlconfCache *cache,
+                       GDBusProxy *proxy)
+{
+    GVariant *reply = NULL, *changed, *variant;
+    GVariantIter iter;
+    const gchar **removed, *property;
+    guint64 since, generation = 0;
+    gboolean too_old = TRUE;
+    gint i;
+
+    blconf_cache_mutex_lock(cache);
+
+    blconf_cache_unsubscribe(cache);
+    g_object_unref(cache->proxy);
+    cache->proxy = g_object_ref(proxy);
+    blconf_cache_subscribe(cache);
+    since = cache->generation;
+
+    blconf_cache_mutex_unlock(cache);
+
+    /* the calls go to |proxy| already */
+    if(since) {
+        reply = blconf_cache_call_sync(cache, "GetChangesSince",
+                                       g_variant_new("(st)",
+                                                     cache->channel_name,
+                                                     since),
+                                       G_VARIANT_TYPE("(tba{sv}as)"), NULL);
+    }
+    if(reply) {
+        g_variant_get(reply, "(tb@a{sv}^a&s)", &generation, &too_old,
+                      &changed, &removed);
+
+        if(!too_old) {
+            g_variant_iter_init(&iter, changed);
+            while(g_variant_iter_next(&iter, "{&sv}", &property, &variant)) {
+                GValue value = { 0, };
+
+                if(_blconf_gvariant_to_gvalue_packed(variant, &value)) {
+                    blconf_cache_property_changed(cache, cache->channel_name,
+                                                  property, &value);
+                    g_value_unset(&value);
+                }
+                g_variant_unref(variant);
+            }
+            for(i = 0; removed[i]; ++i)
+                blconf_cache_property_removed(cache, cache->channel_name,
+                                              removed[i]);
+        }
+
+        g_variant_unref(changed);
+        g_free(removed);
+        g_variant_unref(reply);
+    }
+
+    blconf_cache_mutex_lock(cache);
+
+    if(too_old) {
+        blconf_cache_detach_snapshot(cache);
+        blconf_cache_forget_complete(cache);
+        g_hash_table_remove_all(cache->missing);
+        blconf_cache_remove_subtree(cache, "/");
+        cache->generation_tried = FALSE;
+    }
+    /* an empty cache is up to date as of any generation, too */
+    cache->generation = generation;
+
+    blconf_cache_mutex_unlock(cache);
+}
+
+/* moves every cache over to |proxy|, when the private connection to
+ * the daemon is lost and libblconf goes back to the bus, or when the
+ * daemon on the bus was replaced.  the caches are caught up outside
+ * the registry lock, as the change handlers may well open a channel. */
+void
+_blconf_cache_reconnect(GDBusProxy *proxy)
+{
+    GList *caches = NULL, *l;
+
+    G_LOCK(__caches);
+    if(__shared_caches) {
+        caches = g_hash_table_get_values(__shared_caches);
+        g_list_foreach(caches, (GFunc)g_object_ref, NULL);
+    }
+    G_UNLOCK(__caches);
+
+    for(l = caches; l; l = l->next) {
+        blconf_cache_reconnect(l->data, proxy);
+        g_object_unref(l->data);
+    }
+    g_list_free(caches);
+}
+
+void
+_blconf_cache_shutdown(void)
+{
+    G_LOCK(__caches);
+    if(__shared_caches) {
+        /* for finding apps that defeat their cache, see
+         * blconf_channel_get_cache_stats() */
+        if(g_getenv("BLCONF_STATS") && strcmp(g_getenv("BLCONF_STATS"), "0"))
+            g_hash_table_foreach(__shared_caches, blconf_cache_dump_stats_ht, NULL);
+
+        /* blconf_shutdown() flushes the connection right after */
+        g_hash_table_foreach(__shared_caches, (GHFunc)blconf_cache_flush_ht,
+                             NULL);
+        g_hash_table_destroy(__shared_caches);
+        __shared_caches = NULL;
+    }
+    G_UNLOCK(__caches);
+}
+
+typedef struct
+{
+    gpointer addr;
+    gsize len;
+} BlconfCacheMapping;
+
+static void
+blconf_cache_mapping_free(BlconfCacheMapping *mapping)
+{
+#ifdef HAVE_SYS_MMAN_H
+    munmap(mapping->addr, mapping->len);
+#endif
+    g_slice_free(BlconfCacheMapping, mapping);
+}
+
+/* maps the daemon's snapshot of the channel, once per cache (or per
+ * reset, see blconf_cache_reset()).  any failure just means lookups
+ * keep going over the bus as before. */
+static void
+blconf_cache_attach_snapshot(BlconfCache *cache)
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(F_GET_SEALS)
+    GDBusConnection *connection = g_dbus_proxy_get_connection(cache->proxy);
+    GUnixFDList *fd_list = NULL;
+    BlconfCacheMapping *mapping;
+    const BlconfSnapshotHeader *header;
+    GVariant *reply;
+    struct stat st;
+    gint fd, seals;
+    gint32 handle;
+    guint64 serial;
+    gint64 start;
+
+    if(cache->snapshot_tried)
+        return;
+    cache->snapshot_tried = TRUE;
+
+    if(!(g_dbus_connection_get_capabilities(connection)
+         & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING))
+    {
+        return;
+    }
+
+    start = g_get_monotonic_time();
+    reply = _blconf_dbus_call_with_fds_sync("GetChannelSnapshot",
+                                            g_variant_new("(s)",
+                                                          cache->channel_name),
+                                            G_VARIANT_TYPE("(ht)"),
+                                            &fd_list, NULL);
+    blconf_cache_count_round_trip(cache, start);
+    if(!reply)
+        return;
+
+    g_variant_get(reply, "(ht)", &handle, &serial);
+    g_variant_unref(reply);
+
+    fd = fd_list ? g_unix_fd_list_get(fd_list, handle, NULL) : -1;
+    if(fd_list)
+        g_object_unref(fd_list);
+    if(fd < 0)
+        return;
+
+    /* only a segment nobody can change underneath us is safe to map */
+    seals = fcntl(fd, F_GET_SEALS);
+    if(seals < 0
+       || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE)
+       || fstat(fd, &st) < 0
+       || (gsize)st.st_size < BLCONF_SNAPSHOT_DATA_OFFSET)
+    {
+        close(fd);
+        return;
+    }
+
+    mapping = g_slice_new(BlconfCacheMapping);
+    mapping->len = st.st_size;
+    mapping->addr = mmap(NULL, mapping->len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapping->addr == MAP_FAILED) {
+        g_slice_free(BlconfCacheMapping, mapping);
+        return;
+    }
+
+    header = mapping->addr;
+    if(header->magic != BLCONF_SNAPSHOT_MAGIC
+       || header->format != BLCONF_SNAPSHOT_FORMAT
+       || header->serial != serial
+       || header->data_size > mapping->len - BLCONF_SNAPSHOT_DATA_OFFSET)
+    {
+        blconf_cache_mapping_free(mapping);
+        return;
+    }
+
+    /* not trusted: GVariant checks the data as it's read */
+    cache->snapshot = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE("a{sv}"),
+                                                                 (const guint8 *)mapping->addr
+                                                                 + BLCONF_SNAPSHOT_DATA_OFFSET,
+                                                                 header->data_size,
+                                                                 FALSE,
+                                                                 (GDestroyNotify)blconf_cache_mapping_free,
+                                                                 mapping));
+#endif
+}
+
+static void
+blconf_cache_detach_snapshot(BlconfCache *cache)
+{
+    if(cache->snapshot) {
+        g_variant_unref(cache->snapshot);
+        cache->snapshot = NULL;
+    }
+    g_hash_table_remove_all(cache->removed);
+    cache->snapshot_tried = FALSE;
+}
+
+/* looks |property| up in the snapshot; the entries are sorted by
+ * name, so this is a binary search over the mapped array.  only
+ * valid if the property isn't in |cache->properties|. */
+static gboolean
+blconf_cache_snapshot_lookup(BlconfCache *cache,
+                             const gchar *property,
+                             GValue *value)
+{
+    gsize lo = 0, hi;
+
+    if(g_hash_table_lookup(cache->removed, property))
+        return FALSE;
+
+    hi = g_variant_n_children(cache->snapshot);
+    while(lo < hi) {
+        gsize mid = lo + (hi - lo) / 2;
+        GVariant *entry = g_variant_get_child_value(cache->snapshot, mid);
+        GVariant *variant;
+        const gchar *name;
+        gint cmp;
+
+        g_variant_get_child(entry, 0, "&s", &name);
+        cmp = strcmp(property, name);
+        if(cmp < 0)
+            hi = mid;
+        else if(cmp > 0)
+            lo = mid + 1;
+        else {
+            gboolean ret;
+
+            variant = g_variant_get_child_value(entry, 1);
+            ret = _blconf_gvariant_to_gvalue_packed(variant, value);
+            g_variant_unref(variant);
+            g_variant_unref(entry);
+
+            return ret;
+        }
+
+        g_variant_unref(entry);
+    }
+
+    return FALSE;
+}
+
+/* finds |property| in the snapshot, copying it into the cache for
+ * the code that wants an item */
+static BlconfCacheItem *
+blconf_cache_snapshot_fetch(BlconfCache *cache,
+                            const gchar *property)
+{
+    BlconfCacheItem *item;
+    GValue *value = g_new0(GValue, 1);
+
+    if(!blconf_cache_snapshot_lookup(cache, property, value)) {
+        g_free(value);
+        return NULL;
+    }
+
+    item = blconf_cache_item_new(value, TRUE);
+    item->from_snapshot = TRUE;
+    blconf_cache_insert_item(cache, g_strdup(property), item);
+
+    return item;
+}
+
+static gboolean
+blconf_cache_insert_ht(gpointer key,
+                       gpointer value,
+                       gpointer user_data)
+{
+    BlconfCache *cache = BLCONF_CACHE(user_data);
+
+    blconf_cache_insert_item(cache, key, blconf_cache_item_new(value, TRUE));
+
+    return TRUE;
+}
+
+/* like blconf_cache_insert_ht(), but stops filling the cache once it
+ * holds as many entries as it may.  items already cached are at least
+ * as new as the fetched ones, and may hold a write still in flight */
+static gboolean
+blconf_cache_prefetch_ht(gpointer key,
+                         gpointer value,
+                         gpointer user_data)
+{
+    BlconfCache *cache = BLCONF_CACHE(user_data);
+
+    if(!g_hash_table_lookup(cache->properties, key)) {
+        if(cache->max_entries < 0
+           || cache->lru.length < (guint)cache->max_entries)
+        {
+            g_atomic_int_inc(&cache->n_prefetched);
+            return blconf_cache_insert_ht(key, value, user_data);
+        }
+        cache->prefetch_truncated = TRUE;
+    }
+
+    g_free(key);
+    _blconf_gvalue_free(value);
+
+    return TRUE;
+}
+
+/* learns the channel's generation, once per cache, before the first
+ * prefetch.  any generation taken while the signals come in will do,
+ * so the cache keeps it until it reconnects.  called with the lock
+ * held. */
+static void
+blconf_cache_learn_generation(BlconfCache *cache)
+{
+    GVariant *reply;
+    guint64 generation;
+    gboolean too_old;
+
+    if(cache->generation || cache->generation_tried)
+        return;
+    cache->generation_tried = TRUE;
+
+    /* an older daemon doesn't know the method; then reconnects just
+     * start over */
+    reply = blconf_cache_call_sync(cache, "GetChangesSince",
+                                   g_variant_new("(st)", cache->channel_name,
+                                                 (guint64)0),
+                                   G_VARIANT_TYPE("(tba{sv}as)"), NULL);
+    if(!reply)
+        return;
+
+    g_variant_get(reply, "(tb@a{sv}@as)", &generation, &too_old, NULL, NULL);
+    cache->generation = generation;
+    g_variant_unref(reply);
+}
+
+/* fills the cache with everything under |property_base|.  the cache
+ * is shared by every channel object of the process, so it may already
+ * hold the subtree because of another one. */
+gboolean
+blconf_cache_prefetch(BlconfCache *cache,
                       const gchar *property_base,
                       GError **error)
 {
-    gboolean ret = FALSE;
-    GHashTable *props = NULL;
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
-    GError *tmp_error = NULL;
+    gboolean ret;
+    gint64 start;
+
+    if(!property_base || !property_base[0])
+        property_base = "/";
+
+    blconf_cache_mutex_lock(cache);
+
+    if(cache->snapshot || blconf_cache_is_complete(cache, property_base)) {
+        blconf_cache_mutex_unlock(cache);
+        return TRUE;
+    }
+
+    blconf_cache_learn_generation(cache);
+
+    /* for the whole channel, mapping the snapshot beats copying it
+     * over the bus; values are then only unpacked when read */
+    if(!strcmp(property_base, "/")) {
+        blconf_cache_attach_snapshot(cache);
+        if(cache->snapshot) {
+            blconf_cache_mutex_unlock(cache);
+            return TRUE;
+        }
+    }
+
+    /* the cache fills a page at a time, so neither side ever holds
+     * the whole channel twice.  unless it fills up in between, it
+     * then knows that anything else under |property_base| doesn't
+     * exist */
+    cache->prefetch_truncated = FALSE;
+    BLCONF_PROBE2(prefetch__start, cache->channel_name, property_base);
+    start = g_get_monotonic_time();
+    ret = _blconf_channel_fetch_properties(cache->channel_name,
+                                           property_base, TRUE,
+                                           blconf_cache_prefetch_ht, cache,
+                                           error);
+    blconf_cache_count_round_trip(cache, start);
+    BLCONF_PROBE3(prefetch__done, cache->channel_name, property_base, ret);
+    if(ret && !cache->prefetch_truncated) {
+        cache->complete_bases = g_slist_prepend(cache->complete_bases,
+                                                g_strdup(property_base));
+    }
+    blconf_cache_trim(cache);
+
+    blconf_cache_mutex_unlock(cache);
+
+    return ret;
+}
+
+/* steals everything from |properties|, which holds every property
+ * under |property_base| */
+static void
+blconf_cache_merge(BlconfCache *cache,
+                   const gchar *property_base,
+                   GHashTable *properties)
+{
+    cache->prefetch_truncated = FALSE;
+    g_hash_table_foreach_steal(properties, blconf_cache_prefetch_ht, cache);
+    if(!cache->prefetch_truncated
+       && !blconf_cache_is_complete(cache, property_base))
+    {
+        cache->complete_bases = g_slist_prepend(cache->complete_bases,
+                                                g_strdup(property_base));
+    }
+    blconf_cache_trim(cache);
+}
+
+/* fills the cache from a fetch made elsewhere, taking whatever of
+ * |properties| it keeps; see blconf_prefetch_channels() */
+void
+blconf_cache_seed(BlconfCache *cache,
+                  const gchar *property_base,
+                  GHashTable *properties)
+{
+    if(!property_base || !property_base[0])
+        property_base = "/";
+
+    blconf_cache_mutex_lock(cache);
+
+    if(!cache->snapshot && !blconf_cache_is_complete(cache, property_base))
+        blconf_cache_merge(cache, property_base, properties);
+
+    blconf_cache_mutex_unlock(cache);
+}
+
+typedef struct
+{
+    gchar *property_base;
+    guint removals;  /* |cache->removals| when the fetch started */
+    guint evictions;  /* and |cache->evictions| */
+} BlconfCachePrefetch;
+
+static void
+blconf_cache_prefetch_free(BlconfCachePrefetch *prefetch)
+{
+    g_free(prefetch->property_base);
+    g_slice_free(BlconfCachePrefetch, prefetch);
+}
+
+static gboolean
+blconf_cache_collect_ht(gpointer key,
+                        gpointer value,
+                        gpointer user_data)
+{
+    g_hash_table_insert(user_data, key, value);
+
+    return TRUE;
+}
+
+static void
+blconf_cache_prefetch_thread(GTask *task,
+                             gpointer source_object,
+                             gpointer task_data,
+                             GCancellable *cancellable)
+{
+    BlconfCache *cache = BLCONF_CACHE(source_object);
+    BlconfCachePrefetch *prefetch = task_data;
+    GHashTable *properties;
+    GError *error = NULL;
+
+    blconf_cache_mutex_lock(cache);
+    blconf_cache_learn_generation(cache);
+    if(!strcmp(prefetch->property_base, "/")) {
+        blconf_cache_attach_snapshot(cache);
+        if(cache->snapshot) {
+            blconf_cache_mutex_unlock(cache);
+            g_task_return_pointer(task, NULL, NULL);
+            return;
+        }
+    }
+    blconf_cache_mutex_unlock(cache);
+
+    /* fetched without the lock held, so lookups go on meanwhile */
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)_blconf_gvalue_free);
+    if(_blconf_channel_fetch_properties(cache->channel_name,
+                                        prefetch->property_base, TRUE,
+                                        blconf_cache_collect_ht, properties,
+                                        &error))
+    {
+        g_task_return_pointer(task, properties,
+                              (GDestroyNotify)g_hash_table_destroy);
+    } else {
+        g_hash_table_destroy(properties);
+        g_task_return_error(task, error);
+    }
+}
+
+static void
+blconf_cache_prefetch_done(GObject *source_object,
+                           GAsyncResult *result,
+                           gpointer user_data)
+{
+    BlconfCache *cache = BLCONF_CACHE(source_object);
+    BlconfCachePrefetch *prefetch = g_task_get_task_data(G_TASK(result));
+    GHashTable *properties;
+
+    properties = g_task_propagate_pointer(G_TASK(result), NULL);
+    if(!properties)
+        return;
+
+    blconf_cache_mutex_lock(cache);
+
+    /* anything the cache dropped in the meantime may have changed
+     * after the daemon answered, so the answer is only good as long
+     * as nothing did.  items that are there already are at least as
+     * new, and are kept by blconf_cache_prefetch_ht(). */
+    if(!cache->snapshot
+       && prefetch->removals == cache->removals
+       && prefetch->evictions == cache->evictions)
+    {
+        blconf_cache_merge(cache, prefetch->property_base, properties);
+    }
+
+    blconf_cache_mutex_unlock(cache);
+
+    g_hash_table_destroy(properties);
+}
+
+/* like blconf_cache_prefetch(), but fetches in a thread of its own.
+ * until the answer is in, lookups go to the daemon one at a time as
+ * usual; it's then merged in the thread-default main context of the
+ * caller. */
+void
+blconf_cache_prefetch_async(BlconfCache *cache,
+                            const gchar *property_base)
+{
+    BlconfCachePrefetch *prefetch;
+    GTask *task;
+
+    if(!property_base || !property_base[0])
+        property_base = "/";
+
+    blconf_cache_mutex_lock(cache);
+
+    if(cache->snapshot || blconf_cache_is_complete(cache, property_base)) {
+        blconf_cache_mutex_unlock(cache);
+        return;
+    }
+
+    prefetch = g_slice_new(BlconfCachePrefetch);
+    prefetch->property_base = g_strdup(property_base);
+    prefetch->removals = cache->removals;
+    prefetch->evictions = cache->evictions;
+
+    blconf_cache_mutex_unlock(cache);
+
+    task = g_task_new(cache, NULL, blconf_cache_prefetch_done, NULL);
+    g_task_set_task_data(task, prefetch,
+                         (GDestroyNotify)blconf_cache_prefetch_free);
+    g_task_run_in_thread(task, blconf_cache_prefetch_thread);
+    g_object_unref(task);
+}
+
+static gboolean
+blconf_cache_lookup_locked(BlconfCache *cache,
+                           const gchar *property,
+                           GValue *value,
+                           GError **error)
+{
+    BlconfCacheItem *item = NULL;
+
+    item = blconf_cache_lookup_item(cache, property);
+    if(item) {
+        g_atomic_int_inc(&cache->n_hits);
+        BLCONF_PROBE2(cache__hit, cache->channel_name, property);
+    } else {
+        g_atomic_int_inc(&cache->n_misses);
+        BLCONF_PROBE2(cache__miss, cache->channel_name, property);
+        blconf_cache_attach_snapshot(cache);
+    }
+
+    if(!item && cache->snapshot) {
+        item = blconf_cache_snapshot_fetch(cache, property);
+        if(!item && error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                        "Property \"%s\" does not exist on channel \"%s\"",
+                        property, cache->channel_name);
+        }
+    } else if(!item && blconf_cache_is_missing(cache, property)) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                        "Property \"%s\" does not exist on channel \"%s\"",
+                        property, cache->channel_name);
+        }
+    } else if(!item) {
+        GVariant *reply, *variant;
+        GValue tmpval = { 0, };
+        GError *tmp_error = NULL;
+
+        /* blocking, ugh */
+        BLCONF_PROBE3(dbus__call__start, cache->channel_name, property,
+                      "GetProperty");
+        reply = blconf_cache_call_sync(cache, "GetProperty",
+                                       g_variant_new("(ss)",
+                                                     cache->channel_name,
+                                                     property),
+                                       G_VARIANT_TYPE("(v)"), &tmp_error);
+        BLCONF_PROBE3(dbus__call__done, cache->channel_name, property,
+                      reply != NULL);
+        if(!reply) {
+            if(g_error_matches(tmp_error, BLCONF_ERROR,
+                               BLCONF_ERROR_PROPERTY_NOT_FOUND)
+               || g_error_matches(tmp_error, BLCONF_ERROR,
+                                  BLCONF_ERROR_CHANNEL_NOT_FOUND))
+            {
+                blconf_cache_add_missing(cache, property);
+            }
+            g_propagate_error(error, tmp_error);
+        } else {
+            g_variant_get(reply, "(v)", &variant);
+            if(_blconf_gvariant_to_gvalue_packed(variant, &tmpval)) {
+                item = blconf_cache_item_new(&tmpval, FALSE);
+                blconf_cache_insert_item(cache, g_strdup(property), item);
+                g_value_unset(&tmpval);
+            } else if(error) {
+                g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                            "Received a value of unsupported type \"%s\"",
+                            g_variant_get_type_string(variant));
+            }
+            g_variant_unref(variant);
+            g_variant_unref(reply);
+        }
+    }
+
+    if(item && value) {
+        if(!G_VALUE_TYPE(value))
+            _blconf_gvalue_copy_unpacked(item->value, value);
+        else if(G_VALUE_TYPE(value) == G_VALUE_TYPE(item->value))
+            g_value_copy(item->value, value);
+        else if(!g_value_transform(item->value, value))
+            item = NULL;
+    }
+
+    blconf_cache_trim(cache);
+
+    return !!item;
+}
+
+gboolean
+blconf_cache_lookup(BlconfCache *cache,
+                    const gchar *property,
+                    GValue *value,
+                    GError **error)
+{
+    gboolean ret;
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && property
+                         && (!error || !*error), FALSE);
+
+    if(blconf_cache_view_lookup(cache, property, value)) {
+        g_atomic_int_inc(&cache->n_hits);
+        BLCONF_PROBE2(cache__hit, cache->channel_name, property);
+        return TRUE;
+    }
+
+    blconf_cache_mutex_lock(cache);
+    ret = blconf_cache_lookup_locked(cache, property, value, error);
+    if(ret && !cache->view && ++cache->view_hits >= VIEW_REBUILD_HITS)
+        blconf_cache_view_publish(cache);
+    blconf_cache_mutex_unlock(cache);
+
+    return ret;
+}
+
+/* the raw value of |src| into |dest|, if it's of |type| */
+static void
+blconf_cache_value_get(const GValue *src,
+                       GType type,
+                       gpointer dest)
+{
+    if(G_VALUE_TYPE(src) != type)
+        return;
+
+    switch(type) {
+        case G_TYPE_INT:
+            *(gint *)dest = g_value_get_int(src);
+            break;
+
+        case G_TYPE_UINT:
+            *(guint *)dest = g_value_get_uint(src);
+            break;
+
+        case G_TYPE_UINT64:
+            *(guint64 *)dest = g_value_get_uint64(src);
+            break;
+
+        case G_TYPE_DOUBLE:
+            *(gdouble *)dest = g_value_get_double(src);
+            break;
+
+        case G_TYPE_BOOLEAN:
+            *(gboolean *)dest = g_value_get_boolean(src);
+            break;
+
+        case G_TYPE_STRING:
+            *(gchar **)dest = g_value_dup_string(src);
+            break;
+
+        default:
+            g_warn_if_reached();
+            break;
+    }
+}
+
+/* Hands the cached value of |property| to |func| without copying it,
+ * from the view if there is one and under the lock otherwise, so
+ * |func| mustn't hold on to the value or call back into the cache.
+ * An array may come packed, as a BLCONF_TYPE_PACKED_ARRAY.
+ * Returns FALSE, without calling |func|, if the property isn't cached;
+ * the caller should then go through blconf_cache_lookup(), which
+ * fetches it. */
+gboolean
+blconf_cache_read_cached(BlconfCache *cache,
+                         const gchar *property,
+                         BlconfCacheReadFunc func,
+                         gpointer user_data)
+{
+    BlconfCacheViewEntry *entry = NULL;
+    BlconfCacheItem *item;
+    GHashTable *view;
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && property && func, FALSE);
+
+    g_atomic_int_inc(&cache->view_readers);
+    view = g_atomic_pointer_get(&cache->view);
+    if(view)
+        entry = g_hash_table_lookup(view, property);
+    if(entry) {
+        if(!g_atomic_int_get(&entry->used))
+            g_atomic_int_set(&entry->used, TRUE);
+        func(&entry->value, user_data);
+    }
+    g_atomic_int_add(&cache->view_readers, -1);
+
+    if(entry) {
+        g_atomic_int_inc(&cache->n_hits);
+        return TRUE;
+    }
+
+    /* a miss is counted by the blconf_cache_lookup() that follows */
+    blconf_cache_mutex_lock(cache);
+    item = blconf_cache_lookup_item(cache, property);
+    if(item) {
+        g_atomic_int_inc(&cache->n_hits);
+        func(item->value, user_data);
+    }
+    blconf_cache_mutex_unlock(cache);
+
+    return !!item;
+}
+
+typedef struct
+{
+    GType type;
+    gpointer dest;
+} BlconfCacheValueGet;
+
+static void
+blconf_cache_value_get_func(const GValue *value,
+                            gpointer user_data)
+{
+    BlconfCacheValueGet *get = user_data;
+
+    blconf_cache_value_get(value, get->type, get->dest);
+}
+
+/* For the typed getters: reads a cached value straight into |dest|,
+ * which for the basic types takes no GValue and, except for a string's
+ * copy, no allocation.  |dest| is only set if the value has |type|.
+ * Returns FALSE if the property isn't cached, like
+ * blconf_cache_read_cached(). */
+gboolean
+blconf_cache_lookup_cached(BlconfCache *cache,
+                           const gchar *property,
+                           GType type,
+                           gpointer dest)
+{
+    BlconfCacheValueGet get = { type, dest };
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && property && dest, FALSE);
+
+    return blconf_cache_read_cached(cache, property,
+                                    blconf_cache_value_get_func, &get);
+}
+
+/* Lookups that miss can also go out asynchronously.  Every property
+ * has at most one GetProperty call in flight; lookups that miss while
+ * it's out just wait for the same reply.  The reply is only cached if
+ * the cache didn't learn anything newer about the property meanwhile:
+ * a value set or announced in the meantime wins, and after a removal
+ * the reply is handed to the waiting callers but not kept. */
+
+typedef struct
+{
+    BlconfCache *cache;
+    gchar *property;
+    GSList *tasks;  /* waiting for the reply, newest first */
+    guint removals;  /* |cache->removals| when the call went out */
+    guint insertions;  /* |cache->insertions| likewise */
+} BlconfCacheLookup;
+
+/* looks |property| up without asking the daemon.  returns FALSE if
+ * only the daemon can tell; otherwise |*value| is a new copy of the
+ * value, or NULL if the property doesn't exist.  unlike
+ * blconf_cache_lookup_locked(), this never blocks, so a snapshot is
+ * only used if one is already attached. */
+static gboolean
+blconf_cache_lookup_local(BlconfCache *cache,
+                          const gchar *property,
+                          GValue **value)
+{
+    BlconfCacheItem *item = blconf_cache_lookup_item(cache, property);
+
+    if(!item) {
+        if(cache->snapshot)
+            item = blconf_cache_snapshot_fetch(cache, property);
+        else if(!blconf_cache_is_missing(cache, property))
+            return FALSE;
+    }
+
+    *value = NULL;
+    if(item) {
+        *value = g_new0(GValue, 1);
+        _blconf_gvalue_copy_unpacked(item->value, *value);
+    }
+
+    return TRUE;
+}
+
+/* completes |task| with |value| (which it takes), or |error|, or a
+ * not-found error if there's neither */
+static void
+blconf_cache_lookup_return(GTask *task,
+                           const gchar *channel_name,
+                           const gchar *property,
+                           GValue *value,
+                           const GError *error)
+{
+    if(value)
+        g_task_return_pointer(task, value, (GDestroyNotify)_blconf_gvalue_free);
+    else if(error)
+        g_task_return_error(task, g_error_copy(error));
+    else {
+        g_task_return_new_error(task, BLCONF_ERROR,
+                                BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                                "Property \"%s\" does not exist on channel \"%s\"",
+                                property, channel_name);
+    }
+
+    g_object_unref(task);
+}
+
+static void
+blconf_cache_lookup_reply_handler(GObject *source_object,
+                                  GAsyncResult *res,
+                                  gpointer user_data)
+{
+    BlconfCacheLookup *lookup = user_data;
+    BlconfCache *cache = lookup->cache;
+    BlconfCacheItem *item;
+    GVariant *reply, *variant;
+    GValue fetched = { 0, }, result = { 0, };
+    GError *error = NULL;
+    GSList *l;
+
+    reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source_object),
+                                          res, &error);
+    if(reply) {
+        g_variant_get(reply, "(v)", &variant);
+        if(!_blconf_gvariant_to_gvalue_packed(variant, &fetched)) {
+            g_set_error(&error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                        "Received a value of unsupported type \"%s\"",
+                        g_variant_get_type_string(variant));
+        }
+        g_variant_unref(variant);
+        g_variant_unref(reply);
+    } else if(g_dbus_error_is_remote_error(error))
+        g_dbus_error_strip_remote_error(error);
+
+    blconf_cache_mutex_lock(cache);
+
+    g_hash_table_remove(cache->pending_lookups, lookup->property);
+
+    item = g_hash_table_lookup(cache->properties, lookup->property);
+    if(!item && G_VALUE_TYPE(&fetched) && lookup->removals == cache->removals) {
+        item = blconf_cache_item_new(&fetched, FALSE);
+        blconf_cache_insert_item(cache, g_strdup(lookup->property), item);
+    } else if(!item && lookup->insertions == cache->insertions
+              && (g_error_matches(error, BLCONF_ERROR,
+                                  BLCONF_ERROR_PROPERTY_NOT_FOUND)
+                  || g_error_matches(error, BLCONF_ERROR,
+                                     BLCONF_ERROR_CHANNEL_NOT_FOUND)))
+    {
+        blconf_cache_add_missing(cache, lookup->property);
+    }
+
+    if(item) {
+        _blconf_gvalue_copy_unpacked(item->value, &result);
+        g_clear_error(&error);
+    } else if(G_VALUE_TYPE(&fetched))
+        _blconf_gvalue_copy_unpacked(&fetched, &result);
+
+    blconf_cache_trim(cache);
+
+    blconf_cache_mutex_unlock(cache);
+
+    /* the callbacks may well call back into the cache */
+    lookup->tasks = g_slist_reverse(lookup->tasks);
+    for(l = lookup->tasks; l; l = l->next) {
+        GValue *value = NULL;
+
+        if(G_VALUE_TYPE(&result)) {
+            value = g_new0(GValue, 1);
+            g_value_copy(&result, g_value_init(value, G_VALUE_TYPE(&result)));
+        }
+
+        blconf_cache_lookup_return(l->data, cache->channel_name,
+                                   lookup->property, value, error);
+    }
+
+    if(G_VALUE_TYPE(&result))
+        g_value_unset(&result);
+    if(G_VALUE_TYPE(&fetched))
+        g_value_unset(&fetched);
+    if(error)
+        g_error_free(error);
+
+    g_slist_free(lookup->tasks);
+    g_free(lookup->property);
+    g_object_unref(cache);
+    g_slice_free(BlconfCacheLookup, lookup);
+}
+
+/* like blconf_cache_lookup(), without blocking on the daemon */
+void
+blconf_cache_lookup_async(BlconfCache *cache,
+                          const gchar *property,
+                          GCancellable *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer user_data)
+{
+    BlconfCacheLookup *lookup;
+    GTask *task;
+    GValue *value;
+
+    g_return_if_fail(BLCONF_IS_CACHE(cache) && property);
+
+    task = g_task_new(cache, cancellable, callback, user_data);
+    g_task_set_source_tag(task, blconf_cache_lookup_async);
+
+    blconf_cache_mutex_lock(cache);
+
+    if(blconf_cache_lookup_local(cache, property, &value)) {
+        blconf_cache_trim(cache);
+        blconf_cache_mutex_unlock(cache);
+        blconf_cache_lookup_return(task, cache->channel_name, property,
+                                   value, NULL);
+        return;
+    }
+
+    lookup = g_hash_table_lookup(cache->pending_lookups, property);
+    if(lookup) {
+        lookup->tasks = g_slist_prepend(lookup->tasks, task);
+        blconf_cache_mutex_unlock(cache);
+        return;
+    }
+
+    lookup = g_slice_new0(BlconfCacheLookup);
+    lookup->cache = g_object_ref(cache);
+    lookup->property = g_strdup(property);
+    lookup->tasks = g_slist_prepend(NULL, task);
+    lookup->removals = cache->removals;
+    lookup->insertions = cache->insertions;
+    g_hash_table_insert(cache->pending_lookups, lookup->property, lookup);
+
+    /* the call isn't cancelled along with |task|: other lookups may be
+     * waiting for it too */
+    g_dbus_connection_call(g_dbus_proxy_get_connection(cache->proxy),
+                           g_dbus_proxy_get_name(cache->proxy),
+                           g_dbus_proxy_get_object_path(cache->proxy),
+                           g_dbus_proxy_get_interface_name(cache->proxy),
+                           "GetProperty",
+                           g_variant_new("(ss)", cache->channel_name, property),
+                           G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, -1,
+                           NULL, blconf_cache_lookup_reply_handler, lookup);
+
+    blconf_cache_mutex_unlock(cache);
+}
+
+/* returns a copy of the value in its native type in |value|, which
+ * must be unset, or may be NULL to only learn whether it exists */
+gboolean
+blconf_cache_lookup_finish(BlconfCache *cache,
+                           GAsyncResult *result,
+                           GValue *value,
+                           GError **error)
+{
+    GValue *found;
+
+    g_return_val_if_fail(g_task_is_valid(result, cache), FALSE);
+
+    found = g_task_propagate_pointer(G_TASK(result), error);
+    if(!found)
+        return FALSE;
+
+    if(value)
+        g_value_copy(found, g_value_init(value, G_VALUE_TYPE(found)));
+    _blconf_gvalue_free(found);
+
+    return TRUE;
+}
+
+/* fills |values| with copies of |properties|, asking the daemon in a
+ * single call for whichever of them aren't cached yet */
+gboolean
+blconf_cache_get_many(BlconfCache *cache,
+                      const gchar * const *properties,
+                      GHashTable *values,
+                      GError **error)
+{
+    GPtrArray *missing = g_ptr_array_new();
+    gboolean ret = TRUE;
+    gint i;
 
-    g_return_val_if_fail(g_tree_nnodes(cache->properties) == 0, FALSE);
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && properties && values
+                         && (!error || !*error), FALSE);
 
     blconf_cache_mutex_lock(cache);
 
-    if(blconf_client_get_all_properties(proxy, cache->channel_name,
-                                        property_base ? property_base : "/",
-                                        &props, &tmp_error))
-    {
-        g_hash_table_foreach_steal(props, blconf_cache_prefetch_ht, cache);
-        g_hash_table_destroy(props);
-        /* TODO: honor max entries */
-        ret = TRUE;
-    } else
-        g_propagate_error(error, tmp_error);
+    for(i = 0; properties[i]; ++i) {
+        if(!g_hash_table_lookup(cache->properties, properties[i]))
+            g_ptr_array_add(missing, (gpointer)properties[i]);
+    }
+
+    if(missing->len)
+        blconf_cache_attach_snapshot(cache);
+
+    if(missing->len && !cache->snapshot) {
+        guint j;
+
+        for(j = missing->len; j > 0; --j) {
+            if(blconf_cache_is_missing(cache, g_ptr_array_index(missing, j - 1)))
+                g_ptr_array_remove_index_fast(missing, j - 1);
+        }
+    }
+
+    if(missing->len && cache->snapshot) {
+        guint j;
+
+        for(j = 0; j < missing->len; ++j)
+            blconf_cache_snapshot_fetch(cache, g_ptr_array_index(missing, j));
+    } else if(missing->len) {
+        GVariant *reply;
+
+        g_ptr_array_add(missing, NULL);
+        reply = blconf_cache_call_sync(cache, "GetProperties",
+                                       g_variant_new("(s^as)",
+                                                     cache->channel_name,
+                                                     (gchar **)missing->pdata),
+                                       G_VARIANT_TYPE("(a{sv})"), error);
+        if(reply) {
+            GVariant *dict = g_variant_get_child_value(reply, 0);
+            GHashTable *fetched = _blconf_gvariant_to_hash_packed(dict);
+            guint j;
+
+            g_hash_table_foreach_steal(fetched, blconf_cache_insert_ht,
+                                       cache);
+            g_hash_table_destroy(fetched);
+
+            /* whatever didn't come back doesn't exist */
+            for(j = 0; j + 1 < missing->len; ++j) {
+                const gchar *property = g_ptr_array_index(missing, j);
+
+                if(!g_hash_table_lookup(cache->properties, property))
+                    blconf_cache_add_missing(cache, property);
+            }
+            g_variant_unref(dict);
+            g_variant_unref(reply);
+        } else
+            ret = FALSE;
+    }
+
+    if(ret) {
+        for(i = 0; properties[i]; ++i) {
+            BlconfCacheItem *item = blconf_cache_lookup_item(cache,
+                                                             properties[i]);
+            GValue *value;
+
+            if(!item)
+                continue;
+
+            value = g_new0(GValue, 1);
+            _blconf_gvalue_copy_unpacked(item->value, value);
+            g_hash_table_insert(values, g_strdup(properties[i]), value);
+        }
+    }
+
+    blconf_cache_trim(cache);
 
     blconf_cache_mutex_unlock(cache);
 
+    g_ptr_array_free(missing, TRUE);
+
+    return ret;
+}
+
+/* the first property after |after| in the sorted index that starts
+ * with |prefix| */
+static const gchar *
+blconf_cache_index_next(BlconfCache *cache,
+                        const gchar *prefix,
+                        gsize prefix_len,
+                        const gchar *after)
+{
+    BlconfCacheItem probe, *item = NULL;
+    GSequenceIter *iter;
+
+    probe.property = (gchar *)after;
+    iter = g_sequence_search(cache->index, &probe,
+                             blconf_cache_item_compare, NULL);
+    while(!g_sequence_iter_is_end(iter)) {
+        item = g_sequence_get(iter);
+        if(strcmp(item->property, after) > 0)
+            break;
+        item = NULL;
+        iter = g_sequence_iter_next(iter);
+    }
+
+    if(!item || strncmp(item->property, prefix, prefix_len))
+        return NULL;
+
+    return item->property;
+}
+
+/* likewise for the snapshot, skipping what was removed since it was
+ * made.  returns a copy, the names are only valid while their entry
+ * is referenced */
+static gchar *
+blconf_cache_snapshot_next(BlconfCache *cache,
+                           const gchar *prefix,
+                           gsize prefix_len,
+                           const gchar *after)
+{
+    gsize lo = 0, hi, n;
+    gchar *ret = NULL;
+
+    n = hi = g_variant_n_children(cache->snapshot);
+    while(lo < hi) {
+        gsize mid = lo + (hi - lo) / 2;
+        GVariant *entry = g_variant_get_child_value(cache->snapshot, mid);
+        const gchar *name;
+
+        g_variant_get_child(entry, 0, "&s", &name);
+        if(strcmp(name, after) > 0)
+            hi = mid;
+        else
+            lo = mid + 1;
+        g_variant_unref(entry);
+    }
+
+    for(; lo < n && !ret; ++lo) {
+        GVariant *entry = g_variant_get_child_value(cache->snapshot, lo);
+        const gchar *name;
+        gboolean under;
+
+        g_variant_get_child(entry, 0, "&s", &name);
+        under = !strncmp(name, prefix, prefix_len);
+        if(under && !g_hash_table_lookup(cache->removed, name))
+            ret = g_strdup(name);
+        g_variant_unref(entry);
+
+        if(!under)
+            break;
+    }
+
     return ret;
 }
 
 static gboolean
-blconf_cache_lookup_locked(BlconfCache *cache,
+blconf_cache_holds(BlconfCache *cache,
+                   const gchar *property)
+{
+    GValue value = { 0, };
+
+    if(g_hash_table_lookup(cache->properties, property))
+        return TRUE;
+
+    if(!cache->snapshot
+       || !blconf_cache_snapshot_lookup(cache, property, &value))
+    {
+        return FALSE;
+    }
+    g_value_unset(&value);
+
+    return TRUE;
+}
+
+/* For walking the properties under |property_base| a name at a time:
+ * sets |*next| to a copy of the name that sorts right after
+ * |property|, or of the first one if |property| is NULL, or to NULL
+ * past the last one.  Once the subtree has been prefetched, each step
+ * is only a search of the index and of the snapshot, both of which
+ * are sorted; no values are copied.  Everything under |property_base|
+ * other than itself starts with it and a slash, and the name with
+ * just the slash sorts before all of them, which is where the walk
+ * starts once |property_base| itself is done with.
+ * Returns FALSE if the cache can't hold the whole subtree, see
+ * blconf_cache_set_max_entries(). */
+gboolean
+blconf_cache_next_property(BlconfCache *cache,
+                           const gchar *property_base,
                            const gchar *property,
-                           GValue *value,
+                           gchar **next,
                            GError **error)
 {
-    BlconfCacheItem *item = NULL;
+    const gchar *after, *cached;
+    gchar *prefix, *from_snapshot = NULL;
+    gsize prefix_len;
+    gboolean ret = TRUE;
 
-    item = g_tree_lookup(cache->properties, property);
-    if(!item) {
-        DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
-        GValue tmpval = { 0, };
-        GError *tmp_error = NULL;
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && next
+                         && (!error || !*error), FALSE);
 
-        /* blocking, ugh */
-        if(blconf_client_get_property(proxy, cache->channel_name,
-                                      property, &tmpval, &tmp_error))
-        {
-            item = blconf_cache_item_new(&tmpval, FALSE);
-            g_tree_insert(cache->properties, g_strdup(property), item);
-            g_value_unset(&tmpval);
-            /* TODO: check tree for evictions */
-        } else
-            g_propagate_error(error, tmp_error);
+    *next = NULL;
+
+    if(!property_base || !property_base[0])
+        property_base = "/";
+
+    if(!blconf_cache_prefetch(cache, property_base, error))
+        return FALSE;
+
+    if(g_str_has_suffix(property_base, "/"))
+        prefix = g_strdup(property_base);
+    else
+        prefix = g_strconcat(property_base, "/", NULL);
+    prefix_len = strlen(prefix);
+
+    after = property && strcmp(property, prefix) > 0 ? property : prefix;
+
+    blconf_cache_mutex_lock(cache);
+
+    if(!cache->snapshot && !blconf_cache_is_complete(cache, property_base)) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                    "The cache of channel \"%s\" can't hold every property under \"%s\"",
+                    cache->channel_name, property_base);
+        ret = FALSE;
+    } else if(!property && prefix_len > strlen(property_base)
+              && blconf_cache_holds(cache, property_base))
+    {
+        *next = g_strdup(property_base);
+    } else {
+        cached = blconf_cache_index_next(cache, prefix, prefix_len, after);
+        if(cache->snapshot) {
+            from_snapshot = blconf_cache_snapshot_next(cache, prefix,
+                                                       prefix_len, after);
+        }
+
+        if(from_snapshot && (!cached || strcmp(from_snapshot, cached) < 0))
+            *next = from_snapshot;
+        else {
+            *next = g_strdup(cached);
+            g_free(from_snapshot);
+        }
     }
 
-    if(item) {
-        if(value) {
-            if(!G_VALUE_TYPE(value))
-                g_value_init(value, G_VALUE_TYPE(item->value));
-
-            if(G_VALUE_TYPE(value) == G_VALUE_TYPE(item->value))
-                g_value_copy(item->value, value);
-            else {
-                if(!g_value_transform(item->value, value))
-                    item = NULL;
-            }
+    blconf_cache_mutex_unlock(cache);
+
+    g_free(prefix);
+
+    return ret;
+}
+
+/* drops what the cache remembers of a set of |property| that hasn't
+ * been answered yet, or not even sent.  called with the lock held */
+static void
+blconf_cache_forget_old_item(BlconfCache *cache,
+                             const gchar *property)
+{
+    BlconfCacheOldItem *old_item;
+
+    old_item = g_hash_table_lookup(cache->old_properties, property);
+    if(!old_item)
+        return;
+
+    g_hash_table_remove(cache->old_properties, property);
+    g_hash_table_remove(cache->deferred, property);
+    if(old_item->call) {
+        g_hash_table_steal(cache->pending_calls,
+                           GUINT_TO_POINTER(old_item->call));
+        old_item->call = 0;
+    }
+    blconf_cache_old_item_free(old_item);
+}
+
+/* Sets all of |properties| with one blocking SetProperties call.
+ * Unlike blconf_cache_set() this waits for the reply: the daemon
+ * applies the batch all or nothing, so the cache is only updated
+ * once we know which it was. */
+gboolean
+blconf_cache_set_many(BlconfCache *cache,
+                      GHashTable *properties,
+                      GError **error)
+{
+    GHashTableIter iter;
+    gpointer property, value;
+    GSList *changed = NULL, *l;
+    GVariant *reply;
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache) && properties
+                         && (!error || !*error), FALSE);
+
+    blconf_cache_mutex_lock(cache);
+
+    reply = blconf_cache_call_sync(cache, "SetProperties",
+                                   g_variant_new("(s@a{sv})",
+                                                 cache->channel_name,
+                                                 _blconf_hash_to_gvariant(properties)),
+                                   NULL, error);
+    if(!reply) {
+        blconf_cache_mutex_unlock(cache);
+        return FALSE;
+    }
+    g_variant_unref(reply);
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        BlconfCacheItem *item;
+
+        /* a single set still in flight has been overtaken by this
+         * one; its reply no longer matters */
+        blconf_cache_forget_old_item(cache, property);
+
+        item = g_hash_table_lookup(cache->properties, property);
+        if(item) {
+            if(!blconf_cache_update_item(cache, item, value))
+                continue;
+        } else {
+            item = blconf_cache_item_new(value, FALSE);
+            blconf_cache_insert_item(cache, g_strdup(property), item);
         }
-#if 0
-        if(item)
-            blconf_cache_item_update(item, NULL);
-#endif
+
+        changed = g_slist_prepend(changed, property);
     }
 
-    return !!item;
+    blconf_cache_trim(cache);
+
+    blconf_cache_mutex_unlock(cache);
+
+    for(l = changed; l; l = l->next) {
+        blconf_cache_emit_property_changed(cache, l->data,
+                                           g_hash_table_lookup(properties,
+                                                               l->data));
+    }
+    g_slist_free(changed);
+
+    return TRUE;
 }
 
+/* Applies |splices| to the array in |property| with one blocking
+ * PatchArray call, so the daemon gets, stores and sends out just the
+ * changed elements.  The call is made against the generation of the
+ * cached copy, fetching the property along with it first if that's
+ * not known, so that on success the same splices can be applied to
+ * the copy.  If the property changed in the meantime the daemon
+ * refuses with BLCONF_ERROR_CONFLICT, and the copy is fetched again
+ * next time. */
 gboolean
-blconf_cache_lookup(BlconfCache *cache,
-                    const gchar *property,
-                    GValue *value,
-                    GError **error)
+blconf_cache_patch_array(BlconfCache *cache,
+                         const gchar *property,
+                         const BlconfArraySplice *splices,
+                         guint n_splices,
+                         GError **error)
 {
-    gboolean ret;
+    BlconfCacheItem *item;
+    GVariant *variant, *reply;
+    GValue value = { 0, };
+    guint64 generation;
+    GError *tmp_error = NULL;
+    gboolean changed = FALSE;
 
     g_return_val_if_fail(BLCONF_IS_CACHE(cache) && property
+                         && (splices || !n_splices)
                          && (!error || !*error), FALSE);
 
+    variant = _blconf_splices_to_gvariant(splices, n_splices);
+    if(G_UNLIKELY(!variant)) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                    "Some of the values can't be sent to the daemon");
+        return FALSE;
+    }
+    g_variant_ref_sink(variant);
+
     blconf_cache_mutex_lock(cache);
-    ret = blconf_cache_lookup_locked(cache, property, value, error);
+
+    /* the splices go on top of any write still waiting to go out */
+    if(g_hash_table_lookup(cache->deferred, property))
+        blconf_cache_flush_locked(cache);
+
+    item = g_hash_table_lookup(cache->properties, property);
+    if(!item || !item->generation) {
+        if(!blconf_cache_fetch_generation(cache, property, &value,
+                                          &generation, error))
+        {
+            blconf_cache_mutex_unlock(cache);
+            g_variant_unref(variant);
+            return FALSE;
+        }
+
+        /* that's after any set still in flight, whichever way it went */
+        blconf_cache_forget_old_item(cache, property);
+        blconf_cache_store_generation(cache, property, &value, generation);
+        g_value_unset(&value);
+        item = g_hash_table_lookup(cache->properties, property);
+    }
+
+    reply = blconf_cache_call_sync(cache, "PatchArray",
+                                   g_variant_new("(sst@a(uuav))",
+                                                 cache->channel_name,
+                                                 property, item->generation,
+                                                 variant),
+                                   G_VARIANT_TYPE("(t)"), &tmp_error);
+    g_variant_unref(variant);
+    if(!reply) {
+        if(g_error_matches(tmp_error, BLCONF_ERROR, BLCONF_ERROR_CONFLICT))
+            item->generation = 0;
+        blconf_cache_mutex_unlock(cache);
+        g_propagate_error(error, tmp_error);
+        return FALSE;
+    }
+    g_variant_get(reply, "(t)", &generation);
+    g_variant_unref(reply);
+
+    /* the daemon made the same splices to the same value */
+    g_value_init(&value, G_VALUE_TYPE(item->value));
+    g_value_copy(item->value, &value);
+    if(_blconf_gvalue_splice(&value, splices, n_splices)) {
+        changed = blconf_cache_update_item(cache, item, &value);
+        item->generation = generation;
+    } else
+        item->generation = 0;
+    blconf_cache_trim(cache);
+
     blconf_cache_mutex_unlock(cache);
 
-    return ret;
+    if(changed)
+        blconf_cache_emit_property_changed(cache, property, &value);
+    g_value_unset(&value);
+
+    return TRUE;
 }
 
+/* With an |interval| (in milliseconds), the write is held back, and
+ * sent with any others made in the meantime, in one SetProperties call
+ * once the interval is over; a property written again before that is
+ * only sent once, with the latest value.  The cache itself changes
+ * right away, either way. */
 gboolean
 blconf_cache_set(BlconfCache *cache,
                  const gchar *property,
                  const GValue *value,
+                 guint interval,
                  GError **error)
 {
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
     BlconfCacheItem *item = NULL;
     BlconfCacheOldItem *old_item = NULL;
+    BlconfCacheCallData *data;
+    GVariant *variant;
 
     blconf_cache_mutex_lock(cache);
 
-    item = g_tree_lookup(cache->properties, property);
+    item = g_hash_table_lookup(cache->properties, property);
     if(!item) {
         /* this is really quite the opposite of what we want here,
          * but i can't think of a better way yet. */
@@ -753,22 +3606,10 @@ blconf_cache_set(BlconfCache *cache,
         GError *tmp_error = NULL;
 
         if(!blconf_cache_lookup_locked(cache, property, &tmp_val, &tmp_error)) {
-            /* this is just another example of dbus-glib's brain-deadedness.
-             * instead of remapping the remote error back into the local
-             * domain and code, it uses DBUS_GERROR as the domain,
-             * DBUS_GERROR_REMOTE_EXCEPTION as the code, and then "hides"
-             * the full string ("org.blade.Blconf.Error.Whatever") in
-             * GError::message after a NUL byte.  so stupid. */
-            const gchar *dbus_error_name = NULL;
-
-            if(G_LIKELY(tmp_error->domain == DBUS_GERROR
-                        && tmp_error->code == DBUS_GERROR_REMOTE_EXCEPTION))
-            {
-                dbus_error_name = dbus_g_error_get_name(tmp_error);
-            }
-
-            if(g_strcmp0(dbus_error_name, "org.blade.Blconf.Error.PropertyNotFound") != 0
-               && g_strcmp0(dbus_error_name, "org.blade.Blconf.Error.ChannelNotFound") != 0)
+            if(!g_error_matches(tmp_error, BLCONF_ERROR,
+                                BLCONF_ERROR_PROPERTY_NOT_FOUND)
+               && !g_error_matches(tmp_error, BLCONF_ERROR,
+                                   BLCONF_ERROR_CHANNEL_NOT_FOUND))
             {
                 /* this is bad... */
                 g_propagate_error(error, tmp_error);
@@ -780,7 +3621,7 @@ blconf_cache_set(BlconfCache *cache,
             g_error_free(tmp_error);
         } else {
             g_value_unset(&tmp_val);
-            item = g_tree_lookup(cache->properties, property);
+            item = g_hash_table_lookup(cache->properties, property);
         }
     }
 
@@ -792,18 +3633,29 @@ blconf_cache_set(BlconfCache *cache,
         }
     }
 
+    variant = _blconf_gvalue_to_gvariant(value);
+    if(G_UNLIKELY(!variant)) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                        "Values of type \"%s\" can't be sent to the daemon",
+                        G_VALUE_TYPE_NAME(value));
+        }
+        blconf_cache_mutex_unlock(cache);
+        return FALSE;
+    }
+
     old_item = g_hash_table_lookup(cache->old_properties, property);
     if(old_item) {
         /* if we have an old item, it means that a previous set
-         * call hasn't returned yet.  let's cancel that call and
-         * throw away the current not-yet-committed value of
+         * call hasn't returned yet.  let's forget about that call
+         * and throw away the current not-yet-committed value of
          * the property.
          * we also steal the old_item from the pending_calls table
          * so there are no pending item left. */
         if(old_item->call) {
-            dbus_g_proxy_cancel_call(proxy, old_item->call);
-            g_hash_table_steal(cache->pending_calls, old_item->call);
-            old_item->call = NULL;
+            g_hash_table_steal(cache->pending_calls,
+                               GUINT_TO_POINTER(old_item->call));
+            old_item->call = 0;
         }
     } else {
         old_item = blconf_cache_old_item_new(property);
@@ -812,51 +3664,94 @@ blconf_cache_set(BlconfCache *cache,
         g_hash_table_insert(cache->old_properties, old_item->property, old_item);
     }
 
-    /* can't use the generated dbus-glib binding here cuz we won't
-     * get the pending call pointer in the callback */
-    old_item->call = dbus_g_proxy_begin_call(proxy, "SetProperty",
-                                             blconf_cache_set_property_reply_handler,
-                                             cache, NULL,
-                                             G_TYPE_STRING, cache->channel_name,
-                                             G_TYPE_STRING, property,
-                                             G_TYPE_VALUE, value,
-                                             G_TYPE_INVALID);
-    g_hash_table_insert(cache->pending_calls, old_item->call, old_item);
+    if(interval) {
+        g_variant_unref(g_variant_ref_sink(variant));
+        g_hash_table_insert(cache->deferred, old_item->property, old_item);
+
+        if(!cache->flush_source) {
+            GWeakRef *weak_ref = g_slice_new(GWeakRef);
+
+            g_weak_ref_init(weak_ref, cache);
+            cache->flush_source = g_timeout_source_new(interval);
+            g_source_set_callback(cache->flush_source,
+                                  blconf_cache_flush_timeout, weak_ref,
+                                  (GDestroyNotify)blconf_cache_weak_ref_free);
+            g_source_attach(cache->flush_source,
+                            g_main_context_get_thread_default());
+        }
+    } else {
+        g_hash_table_remove(cache->deferred, property);
+
+        /* 0 means "no call", so skip it when the counter wraps */
+        if(G_UNLIKELY(++cache->last_call == 0))
+            ++cache->last_call;
+        old_item->call = cache->last_call;
+        g_hash_table_insert(cache->pending_calls,
+                            GUINT_TO_POINTER(old_item->call), old_item);
+
+        data = g_slice_new0(BlconfCacheCallData);
+        data->cache = g_object_ref(cache);
+        data->call = old_item->call;
+        BLCONF_PROBE3(set__send, cache->channel_name, property, data->call);
+        g_dbus_connection_call(g_dbus_proxy_get_connection(cache->proxy),
+                               g_dbus_proxy_get_name(cache->proxy),
+                               g_dbus_proxy_get_object_path(cache->proxy),
+                               g_dbus_proxy_get_interface_name(cache->proxy),
+                               "SetProperty",
+                               g_variant_new("(ssv)", cache->channel_name,
+                                             property, variant),
+                               NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+                               blconf_cache_set_property_reply_handler, data);
+    }
 
     if(item)
-        blconf_cache_item_update(item, value);
+        blconf_cache_update_item(cache, item, value);
     else {
         item = blconf_cache_item_new(value, FALSE);
-        g_tree_insert(cache->properties, g_strdup(property), item);
+        blconf_cache_insert_item(cache, g_strdup(property), item);
     }
 
+    blconf_cache_trim(cache);
+
     blconf_cache_mutex_unlock(cache);
 
-    g_signal_emit(G_OBJECT(cache), signals[SIG_PROPERTY_CHANGED], 0,
-                  cache->channel_name, property, value);
+    blconf_cache_emit_property_changed(cache, property, value);
 
     return TRUE;
 }
 
-typedef struct
-{
-    gchar *property_base;
-    gsize property_base_len;
-    GSList *matches;
-} BlconfCacheRecurseData;
-
-static gboolean
-blconf_cache_collect_properties_recursive(gpointer key,
-                                          gpointer value,
-                                          gpointer user_data)
+/* drops every cached property below |property_base|.  those sort
+ * right after |property_base| followed by a slash, so this only visits
+ * the subtree, not the whole channel. */
+static void
+blconf_cache_remove_subtree(BlconfCache *cache,
+                            const gchar *property_base)
 {
-    gchar *property_name = key;
-    BlconfCacheRecurseData *rdata = user_data;
+    BlconfCacheItem probe;
+    GSequenceIter *iter;
+    gchar *prefix;
+    gsize prefix_len;
+
+    if(g_str_has_suffix(property_base, "/"))
+        prefix = g_strdup(property_base);
+    else
+        prefix = g_strconcat(property_base, "/", NULL);
+    prefix_len = strlen(prefix);
+
+    probe.property = prefix;
+    iter = g_sequence_search(cache->index, &probe,
+                             blconf_cache_item_compare, NULL);
+    while(!g_sequence_iter_is_end(iter)) {
+        BlconfCacheItem *item = g_sequence_get(iter);
+
+        if(strncmp(item->property, prefix, prefix_len))
+            break;
 
-    if(!g_ascii_strncasecmp(rdata->property_base, property_name, rdata->property_base_len))
-        rdata->matches = g_slist_prepend(rdata->matches, property_name);
+        iter = g_sequence_iter_next(iter);
+        blconf_cache_remove_item(cache, item->property);
+    }
 
-    return FALSE;
+    g_free(prefix);
 }
 
 gboolean
@@ -866,88 +3761,55 @@ blconf_cache_reset(BlconfCache *cache,
                    GError **error)
 {
     gboolean ret = FALSE;
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
-#if 0
-    BlconfCacheOldItem *old_item = NULL;
-#endif
+    GVariant *reply;
 
     blconf_cache_mutex_lock(cache);
 
-#if 0
-    /* it's not really feasible here to look up all the old/new values
-     * here, so we're just gonna rely on the normal signals from the
-     * daemon to notify us of changes */
-
-    /* can't use the generated dbus-glib binding here cuz we won't
-     * get the pending call pointer in the callback */
-    old_item = blconf_cache_old_item_new(property_base);
-    old_item->call = dbus_g_proxy_begin_call(proxy, "ResetProperty",
-                                             blconf_cache_reset_property_reply_handler,
-                                             cache, NULL,
-                                             G_TYPE_STRING, cache->channel_name,
-                                             G_TYPE_STRING, property_base,
-                                             G_TYPE_BOOLEAN, recursive,
-                                             G_TYPE_INVALID);
-    if(old_item->call) {
-        g_hash_table_insert(cache->pending_calls, old_item->call, old_item);
-        ret = TRUE;
-    } else {
-        if(error) {
-            g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
-                        _("Failed to make ResetProperty DBus call"));
-        }
-    }
-#else
-    /* unfortunately, doing the above asynchronously makes
+    /* unfortunately, doing this asynchronously makes
      * blconf_channel_has_property() break, because we have no idea at
      * this point if a reset is going to remove the property or reset
      * it to a default.  so, we have to do this sync.  sad. */
 
-    ret = blconf_client_reset_property(proxy, cache->channel_name,
-                                       property_base, recursive, error);
+    reply = blconf_cache_call_sync(cache, "ResetProperty",
+                                   g_variant_new("(ssb)", cache->channel_name,
+                                                 property_base, recursive),
+                                   NULL, error);
+    if(reply) {
+        g_variant_unref(reply);
+        ret = TRUE;
+    }
 
     if(ret) {
         /* here we just evict the entry from the cache if we have one.
-         * unfortunately i think it's the best we can do here.  this is
-         * pretty slow because we have to traverse the entire tree if
-         * recursive==TRUE. */
-
-        g_tree_remove(cache->properties, property_base);
-
-        if(recursive) {
-            BlconfCacheRecurseData rdata;
-            GSList *l;
-
-            rdata.property_base = g_strdup_printf("%s/", property_base);
-            rdata.property_base_len = strlen(rdata.property_base);
-            rdata.matches = NULL;
+         * unfortunately i think it's the best we can do here.  the
+         * snapshot still has the old values, and we don't know yet
+         * which of them have defaults, so it has to go too; the next
+         * miss maps a fresh one. */
+        blconf_cache_detach_snapshot(cache);
 
-            g_tree_foreach(cache->properties,
-                           blconf_cache_collect_properties_recursive,
-                           &rdata);
+        /* the same goes for properties that fell back to a default:
+         * until the daemon announces them, only it knows they exist */
+        blconf_cache_forget_complete(cache);
 
-            for(l = rdata.matches; l; l = l->next)
-                g_tree_remove(cache->properties, l->data);
+        cache->removals++;
+        blconf_cache_remove_item(cache, property_base);
 
-            g_free(rdata.property_base);
-            g_slist_free(rdata.matches);
-        }
+        if(recursive)
+            blconf_cache_remove_subtree(cache, property_base);
     }
-#endif
 
     blconf_cache_mutex_unlock(cache);
 
     return ret;
 }
 
-#if 0
 void
 blconf_cache_set_max_entries(BlconfCache *cache,
                              gint max_entries)
 {
     blconf_cache_mutex_lock(cache);
     cache->max_entries = max_entries;
-    /* TODO: check tree for eviction */
+    blconf_cache_trim(cache);
     blconf_cache_mutex_unlock(cache);
 }
 
@@ -957,13 +3819,38 @@ blconf_cache_get_max_entries(BlconfCache *cache)
     return cache->max_entries;
 }
 
+void
+blconf_cache_set_max_bytes(BlconfCache *cache,
+                           gint64 max_bytes)
+{
+    blconf_cache_mutex_lock(cache);
+    cache->max_bytes = max_bytes;
+    blconf_cache_trim(cache);
+    blconf_cache_mutex_unlock(cache);
+}
+
+gint64
+blconf_cache_get_max_bytes(BlconfCache *cache)
+{
+    return cache->max_bytes;
+}
+
 void
 blconf_cache_set_max_age(BlconfCache *cache,
                          gint max_age)
 {
     blconf_cache_mutex_lock(cache);
+
     cache->max_age = max_age;
-    /* TODO: check tree for eviction */
+
+    /* the timer is started again, at the new interval, if needed */
+    if(cache->expire_source) {
+        g_source_destroy(cache->expire_source);
+        g_source_unref(cache->expire_source);
+        cache->expire_source = NULL;
+    }
+    blconf_cache_trim(cache);
+
     blconf_cache_mutex_unlock(cache);
 }
 
@@ -972,4 +3859,56 @@ blconf_cache_get_max_age(BlconfCache *cache)
 {
     return cache->max_age;
 }
-#endif
+
+static void
+blconf_cache_add_stat(GHashTable *stats,
+                      const gchar *name,
+                      GType type,
+                      guint64 number)
+{
+    GValue *value = g_new0(GValue, 1);
+
+    g_value_init(value, type);
+    if(type == G_TYPE_BOOLEAN)
+        g_value_set_boolean(value, number != 0);
+    else
+        g_value_set_uint64(value, number);
+    g_hash_table_insert(stats, g_strdup(name), value);
+}
+
+/* see blconf_channel_get_cache_stats() */
+GHashTable *
+blconf_cache_get_stats(BlconfCache *cache)
+{
+    GHashTable *stats = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              (GDestroyNotify)g_free,
+                                              (GDestroyNotify)_blconf_gvalue_free);
+
+    g_return_val_if_fail(BLCONF_IS_CACHE(cache), stats);
+
+    blconf_cache_add_stat(stats, "hits", G_TYPE_UINT64,
+                          (guint)g_atomic_int_get(&cache->n_hits));
+    blconf_cache_add_stat(stats, "misses", G_TYPE_UINT64,
+                          (guint)g_atomic_int_get(&cache->n_misses));
+    blconf_cache_add_stat(stats, "round-trips", G_TYPE_UINT64,
+                          (guint)g_atomic_int_get(&cache->n_round_trips));
+    blconf_cache_add_stat(stats, "round-trip-usec", G_TYPE_UINT64,
+                          (gsize)g_atomic_pointer_get(&cache->round_trip_time));
+    blconf_cache_add_stat(stats, "prefetched", G_TYPE_UINT64,
+                          (guint)g_atomic_int_get(&cache->n_prefetched));
+    blconf_cache_add_stat(stats, "signals-received", G_TYPE_UINT64,
+                          (guint)g_atomic_int_get(&cache->n_signals));
+    blconf_cache_add_stat(stats, "signals-relevant", G_TYPE_UINT64,
+                          (guint)g_atomic_int_get(&cache->n_relevant_signals));
+
+    blconf_cache_mutex_lock(cache);
+    blconf_cache_add_stat(stats, "entries", G_TYPE_UINT64, cache->lru.length);
+    blconf_cache_add_stat(stats, "bytes", G_TYPE_UINT64, cache->n_bytes);
+    blconf_cache_add_stat(stats, "pending-writes", G_TYPE_UINT64,
+                          g_hash_table_size(cache->old_properties));
+    blconf_cache_add_stat(stats, "snapshot", G_TYPE_BOOLEAN,
+                          cache->snapshot != NULL);
+    blconf_cache_mutex_unlock(cache);
+
+    return stats;
+}
@@ -21,7 +21,9 @@
 #ifndef __BLCONF_CACHE_H__
 #define __BLCONF_CACHE_H__
 
-#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "common/blconf-gvaluefuncs.h"
 
 #define BLCONF_TYPE_CACHE             (blconf_cache_get_type())
 #define BLCONF_CACHE(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), BLCONF_TYPE_CACHE, BlconfCache))
@@ -34,47 +36,136 @@ G_BEGIN_DECLS
 
 typedef struct _BlconfCache         BlconfCache;
 
+typedef void (*BlconfCacheReadFunc)(const GValue *value,
+                                    gpointer user_data);
+
 G_GNUC_INTERNAL
 GType blconf_cache_get_type(void) G_GNUC_CONST;
 
 G_GNUC_INTERNAL
 BlconfCache *blconf_cache_new(const gchar *channel_name) G_GNUC_MALLOC;
 
+G_GNUC_INTERNAL
+BlconfCache *blconf_cache_acquire(const gchar *channel_name);
+
+G_GNUC_INTERNAL
+void blconf_cache_release(BlconfCache *cache);
+
+G_GNUC_INTERNAL
+void blconf_cache_watch(BlconfCache *cache,
+                        const gchar *property_base);
+
+G_GNUC_INTERNAL
+void blconf_cache_unwatch(BlconfCache *cache,
+                          const gchar *property_base);
+
 G_GNUC_INTERNAL
 gboolean blconf_cache_prefetch(BlconfCache *cache,
                                const gchar *property_base,
                                GError **error);
 
+G_GNUC_INTERNAL
+void blconf_cache_prefetch_async(BlconfCache *cache,
+                                 const gchar *property_base);
+
+G_GNUC_INTERNAL
+void blconf_cache_seed(BlconfCache *cache,
+                       const gchar *property_base,
+                       GHashTable *properties);
+
 G_GNUC_INTERNAL
 gboolean blconf_cache_lookup(BlconfCache *cache,
                              const gchar *property,
                              GValue *value,
                              GError **error);
 
+G_GNUC_INTERNAL
+gboolean blconf_cache_lookup_cached(BlconfCache *cache,
+                                    const gchar *property,
+                                    GType type,
+                                    gpointer dest);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_read_cached(BlconfCache *cache,
+                                  const gchar *property,
+                                  BlconfCacheReadFunc func,
+                                  gpointer user_data);
+
+G_GNUC_INTERNAL
+void blconf_cache_lookup_async(BlconfCache *cache,
+                               const gchar *property,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_lookup_finish(BlconfCache *cache,
+                                    GAsyncResult *result,
+                                    GValue *value,
+                                    GError **error);
+
 G_GNUC_INTERNAL
 gboolean blconf_cache_set(BlconfCache *cache,
                           const gchar *property,
                           const GValue *value,
+                          guint interval,
                           GError **error);
 
+G_GNUC_INTERNAL
+gboolean blconf_cache_patch_array(BlconfCache *cache,
+                                  const gchar *property,
+                                  const BlconfArraySplice *splices,
+                                  guint n_splices,
+                                  GError **error);
+
+G_GNUC_INTERNAL
+void blconf_cache_flush(BlconfCache *cache);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_get_many(BlconfCache *cache,
+                               const gchar * const *properties,
+                               GHashTable *values,
+                               GError **error);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_next_property(BlconfCache *cache,
+                                    const gchar *property_base,
+                                    const gchar *property,
+                                    gchar **next,
+                                    GError **error);
+
+G_GNUC_INTERNAL
+gboolean blconf_cache_set_many(BlconfCache *cache,
+                               GHashTable *properties,
+                               GError **error);
+
 G_GNUC_INTERNAL
 gboolean blconf_cache_reset(BlconfCache *cache,
                             const gchar *property_base,
                             gboolean recursive,
                             GError **error);
-#if 0
+
 G_GNUC_INTERNAL
 void blconf_cache_set_max_entries(BlconfCache *cache,
                                   gint max_entries);
 G_GNUC_INTERNAL
 gint blconf_cache_get_max_entries(BlconfCache *cache);
 
+G_GNUC_INTERNAL
+void blconf_cache_set_max_bytes(BlconfCache *cache,
+                                gint64 max_bytes);
+G_GNUC_INTERNAL
+gint64 blconf_cache_get_max_bytes(BlconfCache *cache);
+
 G_GNUC_INTERNAL
 void blconf_cache_set_max_age(BlconfCache *cache,
                               gint max_age);
 G_GNUC_INTERNAL
 gint blconf_cache_get_max_age(BlconfCache *cache);
-#endif
+
+G_GNUC_INTERNAL
+GHashTable *blconf_cache_get_stats(BlconfCache *cache);
+
 G_END_DECLS
 
 #endif  /* __BLCONF_CACHE_H__ */
@@ -28,7 +28,6 @@
 
 #include "blconf-channel.h"
 #include "blconf-cache.h"
-#include "blconf-dbus-bindings.h"
 #include "common/blconf-gvaluefuncs.h"
 #include "blconf-private.h"
 #include "common/blconf-marshal.h"
@@ -38,6 +37,8 @@
 #include "common/blconf-alias.h"
 
 #define IS_SINGLETON_DEFAULT  TRUE
+#define PREFETCH_DEFAULT      BLCONF_CHANNEL_PREFETCH_FULL
+#define WRITE_INTERVAL_MAX    60000
 
 #define ALIGN_VAL(val, align)  ( ((val) + ((align) -1)) & ~((align) - 1) )
 
@@ -46,6 +47,11 @@
                                                       (property), NULL) \
                                        : (gchar *)(property) )
 
+/* longest property name blconf_channel_get_cached() builds on the
+ * stack */
+#define REAL_PROP_BUF_SIZE  256
+#define STRUCT_MEMBERS_PREALLOC  16
+
 /**
  * BlconfChannel:
  *
@@ -60,8 +66,13 @@ struct _BlconfChannel
 
     gchar *channel_name;
     gchar *property_base;
+    BlconfChannelPrefetch prefetch;
+    guint write_interval;  /* ms, see blconf_channel_set_write_interval() */
 
     BlconfCache *cache;
+
+    /* property -> string, see blconf_channel_peek_string() */
+    GHashTable *peeked;
 };
 
 typedef struct _BlconfChannelClass
@@ -85,6 +96,8 @@ enum
     PROP_CHANNEL_NAME,
     PROP_PROPERTY_BASE,
     PROP_IS_SINGLETON,
+    PROP_PREFETCH,
+    PROP_WRITE_INTERVAL,
 };
 
 static GObject *blconf_channel_constructor(GType type,
@@ -109,8 +122,10 @@ static void blconf_channel_property_changed(BlconfCache *cache,
 
 
 G_LOCK_DEFINE_STATIC(__singletons);
+G_LOCK_DEFINE_STATIC(__peeked);
 static guint signals[N_SIGS] = { 0, };
 static GHashTable *__channel_singletons = NULL;
+static GSList *__prefetched_caches = NULL;  /* see blconf_prefetch_channels() */
 
 
 G_DEFINE_TYPE(BlconfChannel, blconf_channel, G_TYPE_OBJECT)
@@ -203,6 +218,47 @@ blconf_channel_class_init(BlconfChannelClass *klass)
                                                          | G_PARAM_STATIC_NAME
                                                          | G_PARAM_STATIC_NICK
                                                          | G_PARAM_STATIC_BLURB));
+
+    /**
+     * BlconfChannel::prefetch:
+     *
+     * How the properties of the channel (or, with a property base, of
+     * its subtree) are fetched when the channel is created.  Only the
+     * first channel object for a channel makes a difference, since
+     * all of them share one cache.  See #BlconfChannelPrefetch.
+     *
+     * Since: 4.14
+     **/
+    g_object_class_install_property(object_class, PROP_PREFETCH,
+                                    g_param_spec_enum("prefetch",
+                                                      "Prefetch",
+                                                      "How to fetch the properties up front",
+                                                      BLCONF_TYPE_CHANNEL_PREFETCH,
+                                                      PREFETCH_DEFAULT,
+                                                      G_PARAM_READWRITE
+                                                      | G_PARAM_CONSTRUCT_ONLY
+                                                      | G_PARAM_STATIC_NAME
+                                                      | G_PARAM_STATIC_NICK
+                                                      | G_PARAM_STATIC_BLURB));
+
+    /**
+     * BlconfChannel::write-interval:
+     *
+     * Milliseconds for which writes through the channel are held back
+     * and coalesced, or 0 to send each one right away.  See
+     * blconf_channel_set_write_interval().
+     *
+     * Since: 4.14
+     **/
+    g_object_class_install_property(object_class, PROP_WRITE_INTERVAL,
+                                    g_param_spec_uint("write-interval",
+                                                      "Write interval",
+                                                      "Milliseconds to coalesce writes for",
+                                                      0, WRITE_INTERVAL_MAX, 0,
+                                                      G_PARAM_READWRITE
+                                                      | G_PARAM_STATIC_NAME
+                                                      | G_PARAM_STATIC_NICK
+                                                      | G_PARAM_STATIC_BLURB));
 }
 
 static void
@@ -210,6 +266,41 @@ blconf_channel_init(BlconfChannel *instance)
 {
 }
 
+/**
+ * BlconfChannelPrefetch:
+ * @BLCONF_CHANNEL_PREFETCH_FULL: Fetch all properties before the
+ *                                channel is returned.
+ * @BLCONF_CHANNEL_PREFETCH_ASYNC: Fetch all properties in the
+ *                                 background; until they are in,
+ *                                 each property read is fetched on
+ *                                 its own.
+ * @BLCONF_CHANNEL_PREFETCH_NONE: Only fetch properties as they are
+ *                                read.
+ *
+ * How a #BlconfChannel fetches its properties when it is created.
+ *
+ * Since: 4.14
+ **/
+GType
+blconf_channel_prefetch_get_type(void)
+{
+    static gsize type = 0;
+
+    if(g_once_init_enter(&type)) {
+        static const GEnumValue values[] = {
+            { BLCONF_CHANNEL_PREFETCH_FULL, "BLCONF_CHANNEL_PREFETCH_FULL", "full" },
+            { BLCONF_CHANNEL_PREFETCH_ASYNC, "BLCONF_CHANNEL_PREFETCH_ASYNC", "async" },
+            { BLCONF_CHANNEL_PREFETCH_NONE, "BLCONF_CHANNEL_PREFETCH_NONE", "none" },
+            { 0, NULL, NULL }
+        };
+
+        g_once_init_leave(&type, g_enum_register_static("BlconfChannelPrefetch",
+                                                        values));
+    }
+
+    return type;
+}
+
 static GObject *
 blconf_channel_constructor(GType type,
                            guint n_construct_properties,
@@ -258,8 +349,22 @@ blconf_channel_constructor(GType type,
     }
 
     if(!channel->cache) {
-        channel->cache = blconf_cache_new(channel_name);
-        blconf_cache_prefetch(channel->cache, channel->property_base, NULL);
+        channel->cache = blconf_cache_acquire(channel_name);
+        blconf_cache_watch(channel->cache, channel->property_base);
+        switch(channel->prefetch) {
+            case BLCONF_CHANNEL_PREFETCH_FULL:
+                blconf_cache_prefetch(channel->cache, channel->property_base,
+                                      NULL);
+                break;
+
+            case BLCONF_CHANNEL_PREFETCH_ASYNC:
+                blconf_cache_prefetch_async(channel->cache,
+                                            channel->property_base);
+                break;
+
+            case BLCONF_CHANNEL_PREFETCH_NONE:
+                break;
+        }
         g_signal_connect(channel->cache, "property-changed",
                          G_CALLBACK(blconf_channel_property_changed), channel);
     }
@@ -290,6 +395,16 @@ blconf_channel_set_g_property(GObject *object,
             channel->is_singleton = g_value_get_boolean(value);
             break;
 
+        case PROP_PREFETCH:
+            channel->prefetch = g_value_get_enum(value);
+            break;
+
+        case PROP_WRITE_INTERVAL:
+            channel->write_interval = g_value_get_uint(value);
+            if(!channel->write_interval && channel->cache)
+                blconf_cache_flush(channel->cache);
+            break;
+
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
             break;
@@ -315,6 +430,15 @@ blconf_channel_get_g_property(GObject *object,
 
         case PROP_IS_SINGLETON:
             g_value_set_boolean(value, channel->is_singleton);
+            break;
+
+        case PROP_PREFETCH:
+            g_value_set_enum(value, channel->prefetch);
+            break;
+
+        case PROP_WRITE_INTERVAL:
+            g_value_set_uint(value, channel->write_interval);
+            break;
 
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -333,7 +457,8 @@ blconf_channel_dispose(GObject *obj)
         g_signal_handlers_disconnect_by_func(channel->cache,
                                              blconf_channel_property_changed,
                                              channel);
-        g_object_unref(G_OBJECT(channel->cache));
+        blconf_cache_unwatch(channel->cache, channel->property_base);
+        blconf_cache_release(channel->cache);
     }
 
     G_OBJECT_CLASS(blconf_channel_parent_class)->dispose(obj);
@@ -346,6 +471,8 @@ blconf_channel_finalize(GObject *obj)
 
     g_free(channel->channel_name);
     g_free(channel->property_base);
+    if(channel->peeked)
+        g_hash_table_destroy(channel->peeked);
 
     /* no need to remove the channel from the hash table if it's a
      * singleton, since the hash table owns the channel's only reference */
@@ -363,6 +490,9 @@ _blconf_channel_shutdown(void)
         g_hash_table_destroy(__channel_singletons);
         __channel_singletons = NULL;
     }
+    g_slist_free_full(__prefetched_caches,
+                      (GDestroyNotify)blconf_cache_release);
+    __prefetched_caches = NULL;
     G_UNLOCK(__singletons);
 }
 
@@ -376,21 +506,37 @@ blconf_channel_property_changed(BlconfCache *cache,
 {
     BlconfChannel *channel = BLCONF_CHANNEL(user_data);
 
-    if(strcmp(channel_name, channel->channel_name)
-       || (channel->property_base
-           && !g_str_has_prefix(property, channel->property_base)))
-    {
+    if(strcmp(channel_name, channel->channel_name))
         return;
-    }
 
     if(channel->property_base) {
-        property += strlen(channel->property_base);
+        gsize len = strlen(channel->property_base);
+
+        /* the cache may hear of "/a/bc" for another channel object,
+         * but "/a/b" only looks at "/a/b/..." */
+        if(strncmp(property, channel->property_base, len)
+           || (len && channel->property_base[len - 1] != '/'
+               && property[len] != '/' && property[len] != '\0'))
+        {
+            return;
+        }
+
+        property += len;
         if(!*property)
             property = "/";
     }
 
+    if(channel->peeked) {
+        G_LOCK(__peeked);
+        g_hash_table_remove(channel->peeked, property);
+        G_UNLOCK(__peeked);
+    }
+
+    /* connecting a detailed handler makes the detail's quark, so a
+     * property without one has no handler that could match; interning
+     * every property that ever changes would just leak quarks */
     g_signal_emit(G_OBJECT(channel), signals[SIG_PROPERTY_CHANGED],
-                  g_quark_from_string(property), property, value);
+                  g_quark_try_string(property), property, value);
 }
 
 
@@ -405,7 +551,8 @@ blconf_channel_set_internal(BlconfChannel *channel,
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, FALSE);
 
-    ret = blconf_cache_set(channel->cache, real_property, value, ERROR);
+    ret = blconf_cache_set(channel->cache, real_property, value,
+                           channel->write_interval, ERROR);
     if(!ret)
         ERROR_CHECK;
 
@@ -457,6 +604,126 @@ blconf_channel_get_internal(BlconfChannel *channel,
     return ret;
 }
 
+/* like REAL_PROP(), but builds the name in |buf| rather than
+ * allocating it.  returns NULL if it doesn't fit */
+static const gchar *
+blconf_channel_cached_property(BlconfChannel *channel,
+                               const gchar *property,
+                               gchar *buf,
+                               gsize buf_size)
+{
+    gsize base_len, len;
+
+    if(!channel->property_base)
+        return property;
+
+    base_len = strlen(channel->property_base);
+    len = strlen(property);
+    if(base_len + len >= buf_size)
+        return NULL;
+
+    memcpy(buf, channel->property_base, base_len);
+    memcpy(buf + base_len, property, len + 1);
+
+    return buf;
+}
+
+/* a shortcut for the typed getters, see blconf_cache_lookup_cached().
+ * returns FALSE if they need to take the long way */
+static gboolean
+blconf_channel_get_cached(BlconfChannel *channel,
+                          const gchar *property,
+                          GType type,
+                          gpointer dest)
+{
+    gchar buf[REAL_PROP_BUF_SIZE];
+
+    property = blconf_channel_cached_property(channel, property,
+                                              buf, sizeof(buf));
+    if(!property)
+        return FALSE;
+
+    return blconf_cache_lookup_cached(channel->cache, property, type, dest);
+}
+
+typedef struct
+{
+    const GVariantType *type;
+    GVariant *packed;
+} BlconfPackedRead;
+
+static void
+blconf_packed_read_func(const GValue *value,
+                        gpointer user_data)
+{
+    BlconfPackedRead *read = user_data;
+
+    if(G_VALUE_TYPE(value) == BLCONF_TYPE_PACKED_ARRAY
+       && g_variant_is_of_type(g_value_get_boxed(value), read->type))
+    {
+        read->packed = g_variant_ref(g_value_get_boxed(value));
+    }
+}
+
+/* for the typed array getters: a reference to the packed array of
+ * |type| the cache holds for |property|, or NULL if it holds anything
+ * else.  a cached array is only referenced, never copied */
+static GVariant *
+blconf_channel_get_packed(BlconfChannel *channel,
+                          const gchar *property,
+                          const GVariantType *type)
+{
+    BlconfPackedRead read = { type, NULL };
+    gchar buf[REAL_PROP_BUF_SIZE];
+    const gchar *cached_property;
+    GValue val = { 0, }, packed = { 0, };
+
+    cached_property = blconf_channel_cached_property(channel, property,
+                                                     buf, sizeof(buf));
+    if(cached_property
+       && blconf_cache_read_cached(channel->cache, cached_property,
+                                   blconf_packed_read_func, &read))
+    {
+        return read.packed;
+    }
+
+    /* not cached yet; fetching it caches it for next time */
+    if(!blconf_channel_get_internal(channel, property, &val))
+        return NULL;
+
+    _blconf_gvalue_copy_packed(&val, &packed);
+    blconf_packed_read_func(&packed, &read);
+    g_value_unset(&packed);
+    g_value_unset(&val);
+
+    return read.packed;
+}
+
+/* a copy of the packed array of fixed-size |type| for |property| */
+static gpointer
+blconf_channel_get_fixed_array(BlconfChannel *channel,
+                               const gchar *property,
+                               const GVariantType *type,
+                               gsize element_size,
+                               guint *n_values)
+{
+    GVariant *packed = blconf_channel_get_packed(channel, property, type);
+    gconstpointer elements;
+    gpointer values = NULL;
+    gsize n = 0;
+
+    if(packed) {
+        elements = g_variant_get_fixed_array(packed, &n, element_size);
+        values = g_memdup(elements, n * element_size);
+        g_variant_unref(packed);
+    }
+
+    if(n_values)
+        *n_values = n;
+
+    return values;
+}
+
 static GPtrArray *
 blconf_fixup_16bit_ints(GPtrArray *arr)
 {
@@ -575,9 +842,9 @@ blconf_channel_get(const gchar *channel_name)
  * lifetime (and thus the lifetime of connected signals and bound
  * #GObject properties) to the lifetime of another object.
  *
- * Also note that each channel has its own cache, so if you create
- * 2 new channels with the same name, it will double the dbus traffic,
- * so in this cases it is highly recommended to use blconf_channel_get().
+ * All channel objects for the same channel within a process share
+ * one cache, so creating several of them, with or without a property
+ * base, doesn't multiply the D-Bus traffic or the memory used.
  *
  * Returns: A new #BlconfChannel.  Release with g_object_unref()
  *          when no longer needed.
@@ -618,6 +885,37 @@ blconf_channel_new_with_property_base(const gchar *channel_name,
                         NULL);
 }
 
+/**
+ * blconf_channel_new_full:
+ * @channel_name: A channel name.
+ * @property_base: (allow-none): A property root name, or %NULL.
+ * @prefetch: How to fetch the channel's properties up front.
+ *
+ * Like blconf_channel_new_with_property_base(), but also chooses how
+ * the properties are fetched when the channel is created.  By default
+ * they are all fetched before the channel is returned
+ * (%BLCONF_CHANNEL_PREFETCH_FULL), which pays off for callers that read
+ * most of them.  Callers that only need a few are better off with
+ * %BLCONF_CHANNEL_PREFETCH_ASYNC or %BLCONF_CHANNEL_PREFETCH_NONE.
+ *
+ * Returns: A new #BlconfChannel.  Release with g_object_unref()
+ *          when no longer needed.
+ *
+ * Since: 4.14
+ **/
+BlconfChannel *
+blconf_channel_new_full(const gchar *channel_name,
+                        const gchar *property_base,
+                        BlconfChannelPrefetch prefetch)
+{
+    return g_object_new(BLCONF_TYPE_CHANNEL,
+                        "channel-name", channel_name,
+                        "property-base", property_base,
+                        "is-singleton", FALSE,
+                        "prefetch", prefetch,
+                        NULL);
+}
+
 /**
  * blconf_channel_has_property:
  * @channel: An #BlconfChannel.
@@ -645,6 +943,94 @@ blconf_channel_has_property(BlconfChannel *channel,
     return exists;
 }
 
+static void
+blconf_channel_has_property_ready(GObject *source_object,
+                                  GAsyncResult *res,
+                                  gpointer user_data)
+{
+    GTask *task = user_data;
+    GError *error = NULL;
+
+    if(blconf_cache_lookup_finish(BLCONF_CACHE(source_object), res,
+                                  NULL, &error))
+    {
+        g_task_return_boolean(task, TRUE);
+    } else if(g_error_matches(error, BLCONF_ERROR,
+                              BLCONF_ERROR_PROPERTY_NOT_FOUND)
+              || g_error_matches(error, BLCONF_ERROR,
+                                 BLCONF_ERROR_CHANNEL_NOT_FOUND))
+    {
+        g_error_free(error);
+        g_task_return_boolean(task, FALSE);
+    } else
+        g_task_return_error(task, error);
+
+    g_object_unref(task);
+}
+
+/**
+ * blconf_channel_has_property_async:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ * @cancellable: (allow-none): A #GCancellable, or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the answer is known.
+ * @user_data: Data to pass to @callback.
+ *
+ * Starts checking whether @property exists on @channel, without
+ * blocking.  @callback should call blconf_channel_has_property_finish()
+ * to get the answer.
+ *
+ * Since: 4.14
+ **/
+void
+blconf_channel_has_property_async(BlconfChannel *channel,
+                                  const gchar *property,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    GTask *task;
+    gchar *real_property;
+
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel) && property);
+
+    task = g_task_new(channel, cancellable, callback, user_data);
+    g_task_set_source_tag(task, blconf_channel_has_property_async);
+
+    real_property = REAL_PROP(channel, property);
+    blconf_cache_lookup_async(channel->cache, real_property, cancellable,
+                              blconf_channel_has_property_ready, task);
+    if(real_property != property)
+        g_free(real_property);
+}
+
+/**
+ * blconf_channel_has_property_finish:
+ * @channel: An #BlconfChannel.
+ * @result: The #GAsyncResult passed to the callback.
+ * @error: An error return, or %NULL.
+ *
+ * Finishes a check started with blconf_channel_has_property_async().
+ * A property or channel that doesn't exist is not an error.
+ *
+ * Returns: %TRUE if the property exists, %FALSE if it doesn't or if
+ *          the configuration store couldn't be asked, in which case
+ *          @error is set.
+ *
+ * Since: 4.14
+ **/
+gboolean
+blconf_channel_has_property_finish(BlconfChannel *channel,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, channel), FALSE);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result))
+                         == blconf_channel_has_property_async, FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
 /**
  * blconf_channel_is_property_locked:
  * @channel: An #BlconfChannel.
@@ -663,17 +1049,20 @@ gboolean
 blconf_channel_is_property_locked(BlconfChannel *channel,
                                   const gchar *property)
 {
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
+    GVariant *reply;
     gboolean locked = FALSE;
     gchar *real_property = REAL_PROP(channel, property);
     ERROR_DEFINE;
 
-    if(!blconf_client_is_property_locked(proxy, channel->channel_name,
-                                         property, &locked, ERROR))
-    {
+    reply = _blconf_dbus_call_sync("IsPropertyLocked",
+                                   g_variant_new("(ss)", channel->channel_name,
+                                                 property),
+                                   G_VARIANT_TYPE("(b)"), ERROR);
+    if(reply) {
+        g_variant_get(reply, "(b)", &locked);
+        g_variant_unref(reply);
+    } else
         ERROR_CHECK;
-        locked = FALSE;
-    }
 
     if(real_property != property)
         g_free(real_property);
@@ -723,6 +1112,142 @@ blconf_channel_reset_property(BlconfChannel *channel,
         g_free(real_property_base);
 }
 
+/**
+ * blconf_channel_set_cache_limits:
+ * @channel: An #BlconfChannel.
+ * @max_entries: The most properties to keep cached, or -1 for no limit.
+ * @max_bytes: Roughly, the most memory the cached values may take up,
+ *             or -1 for no limit.
+ * @max_age: Seconds after which a cached property that wasn't read
+ *           again is dropped, or 0 to keep properties until one of
+ *           the other limits is reached.
+ *
+ * Limits the memory libblconf uses to cache the properties of
+ * @channel.  The cache is shared by all channel objects for the same
+ * channel in the process, so the limits apply to all of them.  When
+ * the cache grows past @max_entries or @max_bytes, the least recently
+ * used properties are dropped from it; reading
+ * them again fetches them from the configuration store.  Properties
+ * with a change that wasn't confirmed by the configuration store yet
+ * are always kept.
+ *
+ * By default a channel's cache is not limited in size, and drops
+ * properties unused for an hour.  Lowering a limit drops whatever
+ * is over it right away.
+ *
+ * Since: 4.14
+ **/
+void
+blconf_channel_set_cache_limits(BlconfChannel *channel,
+                                gint max_entries,
+                                gint64 max_bytes,
+                                gint max_age)
+{
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel) && max_entries >= -1
+                     && max_bytes >= -1 && max_age >= 0);
+
+    g_object_set(G_OBJECT(channel->cache),
+                 "max-entries", max_entries,
+                 "max-bytes", max_bytes,
+                 "max-age", max_age,
+                 NULL);
+}
+
+/**
+ * blconf_channel_get_cache_stats:
+ * @channel: An #BlconfChannel.
+ *
+ * Reports how well the client-side cache of @channel is doing, to
+ * help find code that defeats it or prefetches far more than it
+ * reads.  Like the cache, the numbers are shared by all channel
+ * objects for the same channel in the process, and count from when
+ * the first of them was created.
+ *
+ * The returned #GHashTable maps names to #GValue<!-- -->s holding
+ * #guint64<!-- -->s: "hits" and "misses" for lookups, "round-trips"
+ * and "round-trip-usec" for the calls that blocked on the
+ * configuration store and the time spent in them, "prefetched" for
+ * properties brought in by a prefetch, "entries" and "bytes" for what
+ * the cache currently holds, "pending-writes" for writes the
+ * configuration store hasn't confirmed yet, and "signals-received"
+ * and "signals-relevant" for change notifications, and those that
+ * were about a property the cache held.  "snapshot" is a #gboolean,
+ * %TRUE if the cache maps the configuration store's copy of the
+ * channel.  More may be added later.
+ *
+ * Setting the environment variable BLCONF_STATS logs the same for
+ * every channel when blconf_shutdown() is called.
+ *
+ * Returns: A newly-allocated #GHashTable, which should be freed with
+ *          g_hash_table_destroy() when no longer needed.
+ *
+ * Since: 4.14
+ **/
+GHashTable *
+blconf_channel_get_cache_stats(BlconfChannel *channel)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel), NULL);
+
+    return blconf_cache_get_stats(channel->cache);
+}
+
+/**
+ * blconf_channel_set_write_interval:
+ * @channel: An #BlconfChannel.
+ * @interval: Milliseconds to hold back writes for, or 0 to send each
+ *            one right away.
+ *
+ * Makes @channel coalesce the writes made through it, for properties
+ * that are set many times in a row, e.g. from a slider.  A new value
+ * is still seen right away by readers of the channel in this process,
+ * and #BlconfChannel::property-changed is still emitted for it.  It
+ * only reaches the configuration store, along with any other
+ * properties written in the meantime, once @interval is over; a
+ * property written several times by then is only sent once, with the
+ * latest value.  See also blconf_channel_flush().
+ *
+ * Turning coalescing off sends whatever is held back.
+ *
+ * Since: 4.14
+ **/
+void
+blconf_channel_set_write_interval(BlconfChannel *channel,
+                                  guint interval)
+{
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel));
+
+    g_object_set(G_OBJECT(channel), "write-interval", interval, NULL);
+}
+
+/**
+ * blconf_channel_flush:
+ * @channel: An #BlconfChannel.
+ *
+ * Sends the writes held back because of
+ * blconf_channel_set_write_interval() to the configuration store
+ * right away.  This includes those made through other channel objects
+ * for the same channel.  Like other writes, this doesn't wait for the
+ * configuration store to answer.
+ *
+ * Since: 4.14
+ **/
+void
+blconf_channel_flush(BlconfChannel *channel)
+{
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel));
+
+    blconf_cache_flush(channel->cache);
+}
+
+static gboolean
+blconf_channel_get_properties_ht(gpointer key,
+                                 gpointer value,
+                                 gpointer user_data)
+{
+    g_hash_table_insert(user_data, key, value);
+    return TRUE;
+}
+
 /**
  * blconf_channel_get_properties:
  * @channel: An #BlconfChannel.
@@ -745,8 +1270,7 @@ GHashTable *
 blconf_channel_get_properties(BlconfChannel *channel,
                               const gchar *property_base)
 {
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
-    GHashTable *properties = NULL;
+    GHashTable *properties;
     gchar *real_property_base;
     ERROR_DEFINE;
 
@@ -755,12 +1279,18 @@ blconf_channel_get_properties(BlconfChannel *channel,
     else
         real_property_base = REAL_PROP(channel, property_base);
 
-    if(!blconf_client_get_all_properties(proxy, channel->channel_name,
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)_blconf_gvalue_free);
+    if(!_blconf_channel_fetch_properties(channel->channel_name,
                                          real_property_base
                                          ? real_property_base : "/",
-                                         &properties, ERROR))
+                                         FALSE,
+                                         blconf_channel_get_properties_ht,
+                                         properties, ERROR))
     {
         ERROR_CHECK;
+        g_hash_table_destroy(properties);
         properties = NULL;
     }
 
@@ -773,6 +1303,174 @@ blconf_channel_get_properties(BlconfChannel *channel,
     return properties;
 }
 
+/**
+ * blconf_channel_get_next_property:
+ * @channel: An #BlconfChannel.
+ * @property: A property name, or %NULL.
+ *
+ * Walks the properties of @channel in order, a name at a time:
+ * passing %NULL for @property returns the first property, and passing
+ * a property returns the one that follows it.  The names come from the
+ * client-side cache, which is filled with all of @channel on the first
+ * call, so after that no step talks to the configuration store, and
+ * unlike with blconf_channel_get_properties(), only the names are
+ * copied.  Properties changed during the walk may or may not be seen.
+ *
+ * If @channel was created with a property base, only the properties
+ * under it are walked, and their names are relative to it, the way
+ * they are passed to the other functions.  The property base itself,
+ * if it exists, comes first, as the empty string.
+ *
+ * Returns: The name of the next property, which should be freed with
+ *          g_free() when no longer needed, or %NULL after the last
+ *          one.  %NULL is also returned on error, for instance if the
+ *          limits set with blconf_channel_set_cache_limits() don't
+ *          leave room for all of @channel.
+ *
+ * Since: 4.14
+ **/
+gchar *
+blconf_channel_get_next_property(BlconfChannel *channel,
+                                 const gchar *property)
+{
+    gchar *real_property = NULL, *next = NULL;
+    ERROR_DEFINE;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel), NULL);
+
+    if(property)
+        real_property = REAL_PROP(channel, property);
+
+    if(!blconf_cache_next_property(channel->cache, channel->property_base,
+                                   real_property, &next, ERROR))
+    {
+        ERROR_CHECK;
+    }
+
+    if(real_property != property)
+        g_free(real_property);
+
+    if(next && channel->property_base) {
+        gsize len = strlen(channel->property_base);
+        gchar *relative = g_strdup(next + len);
+
+        g_free(next);
+        next = relative;
+    }
+
+    return next;
+}
+
+typedef struct
+{
+    gchar *channel_name;
+    gchar *property_base;
+} BlconfGetPropertiesData;
+
+static void
+blconf_get_properties_data_free(BlconfGetPropertiesData *data)
+{
+    g_free(data->channel_name);
+    g_free(data->property_base);
+    g_slice_free(BlconfGetPropertiesData, data);
+}
+
+static void
+blconf_channel_get_properties_thread(GTask *task,
+                                     gpointer source_object,
+                                     gpointer task_data,
+                                     GCancellable *cancellable)
+{
+    BlconfGetPropertiesData *data = task_data;
+    GHashTable *properties;
+    GError *error = NULL;
+
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)_blconf_gvalue_free);
+    if(_blconf_channel_fetch_properties(data->channel_name,
+                                        data->property_base, FALSE,
+                                        blconf_channel_get_properties_ht,
+                                        properties, &error))
+    {
+        g_task_return_pointer(task, properties,
+                              (GDestroyNotify)g_hash_table_destroy);
+    } else {
+        g_hash_table_destroy(properties);
+        g_task_return_error(task, error);
+    }
+}
+
+/**
+ * blconf_channel_get_properties_async:
+ * @channel: An #BlconfChannel.
+ * @property_base: The base property name of properties to retrieve.
+ * @cancellable: (allow-none): A #GCancellable, or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the properties are
+ *            fetched.
+ * @user_data: Data to pass to @callback.
+ *
+ * Like blconf_channel_get_properties(), without blocking the calling
+ * thread.  @callback should call blconf_channel_get_properties_finish()
+ * to get the properties.
+ *
+ * Since: 4.14
+ **/
+void
+blconf_channel_get_properties_async(BlconfChannel *channel,
+                                    const gchar *property_base,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+    BlconfGetPropertiesData *data;
+    GTask *task;
+
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel));
+
+    data = g_slice_new(BlconfGetPropertiesData);
+    data->channel_name = g_strdup(channel->channel_name);
+    if(!property_base || (property_base[0] == '/' && !property_base[1]))
+        data->property_base = g_strdup(channel->property_base
+                                       ? channel->property_base : "/");
+    else if(channel->property_base)
+        data->property_base = REAL_PROP(channel, property_base);
+    else
+        data->property_base = g_strdup(property_base);
+
+    task = g_task_new(channel, cancellable, callback, user_data);
+    g_task_set_source_tag(task, blconf_channel_get_properties_async);
+    g_task_set_task_data(task, data,
+                         (GDestroyNotify)blconf_get_properties_data_free);
+    g_task_run_in_thread(task, blconf_channel_get_properties_thread);
+    g_object_unref(task);
+}
+
+/**
+ * blconf_channel_get_properties_finish:
+ * @channel: An #BlconfChannel.
+ * @result: The #GAsyncResult passed to the callback.
+ * @error: An error return, or %NULL.
+ *
+ * Finishes a fetch started with blconf_channel_get_properties_async().
+ *
+ * Returns: A newly-allocated #GHashTable as returned by
+ *          blconf_channel_get_properties(), or %NULL if @error is set.
+ *
+ * Since: 4.14
+ **/
+GHashTable *
+blconf_channel_get_properties_finish(BlconfChannel *channel,
+                                     GAsyncResult *result,
+                                     GError **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, channel), NULL);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result))
+                         == blconf_channel_get_properties_async, NULL);
+
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
 /**
  * blconf_channel_get_string:
  * @channel: An #BlconfChannel.
@@ -795,7 +1493,9 @@ blconf_channel_get_string(BlconfChannel *channel,
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
 
-    if(blconf_channel_get_internal(channel, property, &val)) {
+    if(!blconf_channel_get_cached(channel, property, G_TYPE_STRING, &value)
+       && blconf_channel_get_internal(channel, property, &val))
+    {
         if(G_VALUE_TYPE(&val) == G_TYPE_STRING)
             value = g_value_dup_string(&val);
         g_value_unset(&val);
@@ -808,44 +1508,235 @@ blconf_channel_get_string(BlconfChannel *channel,
 }
 
 /**
- * blconf_channel_get_string_list:
+ * blconf_channel_peek_string:
  * @channel: An #BlconfChannel.
  * @property: A property name.
+ * @default_value: A fallback value.
  *
- * Retrieves the string list value associated with @property on @channel.
+ * Like blconf_channel_get_string(), but returns a string owned by
+ * @channel, so that reading the same property over and over doesn't
+ * copy it each time.  The string stays valid until @channel emits
+ * #BlconfChannel::property-changed for @property, or is destroyed.
+ * Since the signal is emitted from the main loop, only use the string
+ * from the thread running it.
  *
- * Returns: A newly-allocated string list which should be freed with
- *          g_strfreev() when no longer needed.  If @property is not in
- *          @channel, %NULL is returned.
+ * Returns: The string value, or, if @property is not in @channel,
+ *          @default_value.
+ *
+ * Since: 4.14
+ **/
+const gchar *
+blconf_channel_peek_string(BlconfChannel *channel,
+                           const gchar *property,
+                           const gchar *default_value)
+{
+    gchar *value = NULL;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
+
+    G_LOCK(__peeked);
+    if(channel->peeked)
+        value = g_hash_table_lookup(channel->peeked, property);
+    G_UNLOCK(__peeked);
+
+    if(value)
+        return value;
+
+    value = blconf_channel_get_string(channel, property, NULL);
+    if(!value)
+        return default_value;
+
+    G_LOCK(__peeked);
+    if(!channel->peeked) {
+        channel->peeked = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                (GDestroyNotify)g_free,
+                                                (GDestroyNotify)g_free);
+    }
+    g_hash_table_replace(channel->peeked, g_strdup(property), value);
+    G_UNLOCK(__peeked);
+
+    return value;
+}
+
+/**
+ * blconf_channel_get_string_list:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ *
+ * Retrieves the string list value associated with @property on @channel.
+ *
+ * Returns: A newly-allocated string list which should be freed with
+ *          g_strfreev() when no longer needed.  If @property is not in
+ *          @channel, %NULL is returned.
  **/
 gchar **
 blconf_channel_get_string_list(BlconfChannel *channel,
                                const gchar *property)
 {
-    gchar **values = NULL;
-    GPtrArray *arr;
-    guint i;
+    gchar **values;
+    GVariant *packed;
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
 
-    arr = blconf_channel_get_arrayv(channel, property);
-    if(!arr)
+    /* an array of strings only is always cached packed */
+    packed = blconf_channel_get_packed(channel, property,
+                                       G_VARIANT_TYPE_STRING_ARRAY);
+    if(!packed)
         return NULL;
 
-    values = g_new0(gchar *, arr->len + 1);
-    for(i = 0; i < arr->len; ++i) {
-        GValue *val = g_ptr_array_index(arr, i);
+    values = g_variant_dup_strv(packed, NULL);
+    g_variant_unref(packed);
 
-        if(G_VALUE_TYPE(val) != G_TYPE_STRING) {
-            blconf_array_free(arr);
-            g_strfreev(values);
-            return NULL;
-        }
+    return values;
+}
 
-        values[i] = g_value_dup_string(val);  /* FIXME: avoid copy */
-    }
+/**
+ * blconf_channel_get_int_array:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ * @n_values: (out) (allow-none): Return location for the number of
+ *            values, or %NULL.
+ *
+ * Retrieves an array property made up of 32-bit signed integers only,
+ * as a plain C array.  Unlike blconf_channel_get_arrayv(), this
+ * doesn't allocate a #GValue for each element.
+ *
+ * Returns: A newly-allocated array which should be freed with g_free()
+ *          when no longer needed.  If @property is not in @channel, or
+ *          isn't an array of only integers, %NULL is returned.
+ *
+ * Since: 4.14
+ **/
+gint32 *
+blconf_channel_get_int_array(BlconfChannel *channel,
+                             const gchar *property,
+                             guint *n_values)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
 
-    blconf_array_free(arr);
+    return blconf_channel_get_fixed_array(channel, property,
+                                          G_VARIANT_TYPE("ai"),
+                                          sizeof(gint32), n_values);
+}
+
+/**
+ * blconf_channel_get_uint_array:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ * @n_values: (out) (allow-none): Return location for the number of
+ *            values, or %NULL.
+ *
+ * Like blconf_channel_get_int_array(), for an array of 32-bit unsigned
+ * integers.
+ *
+ * Returns: A newly-allocated array which should be freed with g_free()
+ *          when no longer needed, or %NULL.
+ *
+ * Since: 4.14
+ **/
+guint32 *
+blconf_channel_get_uint_array(BlconfChannel *channel,
+                              const gchar *property,
+                              guint *n_values)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
+
+    return blconf_channel_get_fixed_array(channel, property,
+                                          G_VARIANT_TYPE("au"),
+                                          sizeof(guint32), n_values);
+}
+
+/**
+ * blconf_channel_get_uint64_array:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ * @n_values: (out) (allow-none): Return location for the number of
+ *            values, or %NULL.
+ *
+ * Like blconf_channel_get_int_array(), for an array of 64-bit unsigned
+ * integers.
+ *
+ * Returns: A newly-allocated array which should be freed with g_free()
+ *          when no longer needed, or %NULL.
+ *
+ * Since: 4.14
+ **/
+guint64 *
+blconf_channel_get_uint64_array(BlconfChannel *channel,
+                                const gchar *property,
+                                guint *n_values)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
+
+    return blconf_channel_get_fixed_array(channel, property,
+                                          G_VARIANT_TYPE("at"),
+                                          sizeof(guint64), n_values);
+}
+
+/**
+ * blconf_channel_get_double_array:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ * @n_values: (out) (allow-none): Return location for the number of
+ *            values, or %NULL.
+ *
+ * Like blconf_channel_get_int_array(), for an array of doubles.
+ *
+ * Returns: A newly-allocated array which should be freed with g_free()
+ *          when no longer needed, or %NULL.
+ *
+ * Since: 4.14
+ **/
+gdouble *
+blconf_channel_get_double_array(BlconfChannel *channel,
+                                const gchar *property,
+                                guint *n_values)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
+
+    return blconf_channel_get_fixed_array(channel, property,
+                                          G_VARIANT_TYPE("ad"),
+                                          sizeof(gdouble), n_values);
+}
+
+/**
+ * blconf_channel_get_bool_array:
+ * @channel: An #BlconfChannel.
+ * @property: A property name.
+ * @n_values: (out) (allow-none): Return location for the number of
+ *            values, or %NULL.
+ *
+ * Like blconf_channel_get_int_array(), for an array of booleans.
+ *
+ * Returns: A newly-allocated array which should be freed with g_free()
+ *          when no longer needed, or %NULL.
+ *
+ * Since: 4.14
+ **/
+gboolean *
+blconf_channel_get_bool_array(BlconfChannel *channel,
+                              const gchar *property,
+                              guint *n_values)
+{
+    guchar *bytes;
+    gboolean *values;
+    guint i, n = 0;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, NULL);
+
+    /* packed booleans are a byte each */
+    bytes = blconf_channel_get_fixed_array(channel, property,
+                                           G_VARIANT_TYPE("ab"),
+                                           sizeof(guchar), &n);
+    if(n_values)
+        *n_values = n;
+    if(!bytes)
+        return NULL;
+
+    values = g_new(gboolean, n);
+    for(i = 0; i < n; ++i)
+        values[i] = !!bytes[i];
+    g_free(bytes);
 
     return values;
 }
@@ -871,7 +1762,9 @@ blconf_channel_get_int(BlconfChannel *channel,
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, value);
 
-    if(blconf_channel_get_internal(channel, property, &val)) {
+    if(!blconf_channel_get_cached(channel, property, G_TYPE_INT, &value)
+       && blconf_channel_get_internal(channel, property, &val))
+    {
         if(G_VALUE_TYPE(&val) == G_TYPE_INT)
             value = g_value_get_int(&val);
         g_value_unset(&val);
@@ -896,12 +1789,14 @@ blconf_channel_get_uint(BlconfChannel *channel,
                         const gchar *property,
                         guint32 default_value)
 {
-    gint value = default_value;
+    guint32 value = default_value;
     GValue val = { 0, };
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, value);
 
-    if(blconf_channel_get_internal(channel, property, &val)) {
+    if(!blconf_channel_get_cached(channel, property, G_TYPE_UINT, &value)
+       && blconf_channel_get_internal(channel, property, &val))
+    {
         if(G_VALUE_TYPE(&val) == G_TYPE_UINT)
             value = g_value_get_uint(&val);
         g_value_unset(&val);
@@ -926,12 +1821,14 @@ blconf_channel_get_uint64(BlconfChannel *channel,
                           const gchar *property,
                           guint64 default_value)
 {
-    gint64 value = default_value;
+    guint64 value = default_value;
     GValue val = { 0, };
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, value);
 
-    if(blconf_channel_get_internal(channel, property, &val)) {
+    if(!blconf_channel_get_cached(channel, property, G_TYPE_UINT64, &value)
+       && blconf_channel_get_internal(channel, property, &val))
+    {
         if(G_VALUE_TYPE(&val) == G_TYPE_UINT64)
             value = g_value_get_uint64(&val);
         g_value_unset(&val);
@@ -961,7 +1858,9 @@ blconf_channel_get_double(BlconfChannel *channel,
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, value);
 
-    if(blconf_channel_get_internal(channel, property, &val)) {
+    if(!blconf_channel_get_cached(channel, property, G_TYPE_DOUBLE, &value)
+       && blconf_channel_get_internal(channel, property, &val))
+    {
         if(G_VALUE_TYPE(&val) == G_TYPE_DOUBLE)
             value = g_value_get_double(&val);
         g_value_unset(&val);
@@ -991,7 +1890,9 @@ blconf_channel_get_bool(BlconfChannel *channel,
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, value);
 
-    if(blconf_channel_get_internal(channel, property, &val)) {
+    if(!blconf_channel_get_cached(channel, property, G_TYPE_BOOLEAN, &value)
+       && blconf_channel_get_internal(channel, property, &val))
+    {
         if(G_VALUE_TYPE(&val) == G_TYPE_BOOLEAN)
             value = g_value_get_boolean(&val);
         g_value_unset(&val);
@@ -1046,29 +1947,20 @@ blconf_channel_set_string_list(BlconfChannel *channel,
                                const gchar *property,
                                const gchar * const *values)
 {
-    GPtrArray *arr;
-    GValue *val;
-    gint i;
+    GValue val = { 0, };
     gboolean ret;
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property && values
                          && values[0], FALSE);
 
-    /* count strings so we can prealloc */
-    for(i = 0; values[i]; ++i)
-        (void)0;
-    
-    arr = g_ptr_array_sized_new(i);
-    for(i = 0; values[i]; ++i) {
-        val = g_new0(GValue, 1);
-        g_value_init(val, G_TYPE_STRING);
-        g_value_set_static_string(val, values[i]);
-        g_ptr_array_add(arr, val);
-    }
+    /* straight into the packed form the cache keeps, without a GValue
+     * per string on the way */
+    g_value_init(&val, BLCONF_TYPE_PACKED_ARRAY);
+    g_value_take_boxed(&val, g_variant_ref_sink(g_variant_new_strv(values, -1)));
 
-    ret = blconf_channel_set_arrayv(channel, property, arr);
+    ret = blconf_channel_set_internal(channel, property, &val);
 
-    blconf_array_free(arr);
+    g_value_unset(&val);
 
     return ret;
 }
@@ -1223,6 +2115,52 @@ blconf_channel_set_bool(BlconfChannel *channel,
     return ret;
 }
 
+/* stores |native|, as fetched for |property|, in |value|, converting
+ * it to the type |value| is initialized to, if any.  see
+ * blconf_channel_get_property() */
+static gboolean
+blconf_channel_convert_property(const gchar *property,
+                                const GValue *native,
+                                GValue *value)
+{
+    gboolean ret = TRUE;
+
+    if(G_VALUE_TYPE(value) != G_TYPE_INVALID
+       && G_VALUE_TYPE(value) != G_VALUE_TYPE(native))
+    {
+        /* caller wants to convert the returned value into a diff type */
+
+        if(G_VALUE_TYPE(native) == BLCONF_TYPE_G_VALUE_ARRAY) {
+            /* we got an array back, so let's convert each item in
+             * the array to the target type */
+            GPtrArray *arr = blconf_transform_array(g_value_get_boxed(native),
+                                                    G_VALUE_TYPE(value));
+
+            if(arr) {
+                g_value_unset(value);
+                g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+                g_value_take_boxed(value, arr);
+            } else
+                ret = FALSE;
+        } else {
+            ret = g_value_transform(native, value);
+            if(!ret) {
+                g_warning("Unable to convert property \"%s\" from type \"%s\" to type \"%s\"",
+                          property, G_VALUE_TYPE_NAME(native),
+                          G_VALUE_TYPE_NAME(value));
+            }
+        }
+    } else {
+        /* either the caller wants the native type, or specified the
+         * native type to convert to */
+        if(G_VALUE_TYPE(value) == G_VALUE_TYPE(native))
+            g_value_unset(value);
+        g_value_copy(native, g_value_init(value, G_VALUE_TYPE(native)));
+    }
+
+    return ret;
+}
+
 /**
  * blconf_channel_get_property:
  * @channel: An #BlconfChannel.
@@ -1257,41 +2195,8 @@ blconf_channel_get_property(BlconfChannel *channel,
 
     ret = blconf_channel_get_internal(channel, property, &val1);
 
-    if(ret) {
-        if(G_VALUE_TYPE(value) != G_TYPE_INVALID
-           && G_VALUE_TYPE(value) != G_VALUE_TYPE(&val1))
-        {
-            /* caller wants to convert the returned value into a diff type */
-
-            if(G_VALUE_TYPE(&val1) == BLCONF_TYPE_G_VALUE_ARRAY) {
-                /* we got an array back, so let's convert each item in
-                 * the array to the target type */
-                GPtrArray *arr = blconf_transform_array(g_value_get_boxed(&val1),
-                                                        G_VALUE_TYPE(value));
-
-                if(arr) {
-                    g_value_unset(value);
-                    g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
-                    g_value_take_boxed(value, arr);
-                } else
-                    ret = FALSE;
-            } else {
-                ret = g_value_transform(&val1, value);
-                if(!ret) {
-                    g_warning("Unable to convert property \"%s\" from type \"%s\" to type \"%s\"",
-                              property, G_VALUE_TYPE_NAME(&val1),
-                              G_VALUE_TYPE_NAME(value));
-                }
-            }
-        } else {
-            /* either the caller wants the native type, or specified the
-             * native type to convert to */
-            if(G_VALUE_TYPE(value) == G_VALUE_TYPE(&val1))
-                g_value_unset(value);
-            g_value_copy(&val1, g_value_init(value, G_VALUE_TYPE(&val1)));
-            ret = TRUE;
-        }
-    }
+    if(ret)
+        ret = blconf_channel_convert_property(property, &val1, value);
 
     if(G_VALUE_TYPE(&val1))
         g_value_unset(&val1);
@@ -1299,6 +2204,112 @@ blconf_channel_get_property(BlconfChannel *channel,
     return ret;
 }
 
+static void
+blconf_channel_get_property_ready(GObject *source_object,
+                                  GAsyncResult *res,
+                                  gpointer user_data)
+{
+    GTask *task = user_data;
+    GValue *value = g_new0(GValue, 1);
+    GError *error = NULL;
+
+    if(blconf_cache_lookup_finish(BLCONF_CACHE(source_object), res,
+                                  value, &error))
+    {
+        g_task_return_pointer(task, value, (GDestroyNotify)_blconf_gvalue_free);
+    } else {
+        g_free(value);
+        g_task_return_error(task, error);
+    }
+
+    g_object_unref(task);
+}
+
+/**
+ * blconf_channel_get_property_async:
+ * @channel: An #BlconfChannel.
+ * @property: A string property name.
+ * @cancellable: (allow-none): A #GCancellable, or %NULL.
+ * @callback: A #GAsyncReadyCallback to call when the value is known.
+ * @user_data: Data to pass to @callback.
+ *
+ * Starts fetching a property on @channel, without blocking.  If the
+ * value is cached, @callback is still called from the thread-default
+ * main context, once control returns to it.  Any number of lookups of
+ * the same property that miss the cache at the same time share a
+ * single call to the configuration store.
+ *
+ * When the value is known, @callback is called, and should call
+ * blconf_channel_get_property_finish() to get it.
+ *
+ * Since: 4.14
+ **/
+void
+blconf_channel_get_property_async(BlconfChannel *channel,
+                                  const gchar *property,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+    GTask *task;
+    gchar *real_property;
+
+    g_return_if_fail(BLCONF_IS_CHANNEL(channel) && property);
+
+    task = g_task_new(channel, cancellable, callback, user_data);
+    g_task_set_source_tag(task, blconf_channel_get_property_async);
+    g_task_set_task_data(task, g_strdup(property), g_free);
+
+    real_property = REAL_PROP(channel, property);
+    blconf_cache_lookup_async(channel->cache, real_property, cancellable,
+                              blconf_channel_get_property_ready, task);
+    if(real_property != property)
+        g_free(real_property);
+}
+
+/**
+ * blconf_channel_get_property_finish:
+ * @channel: An #BlconfChannel.
+ * @result: The #GAsyncResult passed to the callback.
+ * @value: A #GValue.
+ * @error: An error return, or %NULL.
+ *
+ * Finishes a lookup started with blconf_channel_get_property_async(),
+ * and stores the property in @value.  @value is treated just as by
+ * blconf_channel_get_property(): if it is initialized, the property
+ * is converted to its type.  The caller is responsible for calling
+ * g_value_unset() when finished with @value.
+ *
+ * Returns: %TRUE if the property was retrieved successfully,
+ *          %FALSE otherwise.  If the property couldn't be fetched,
+ *          @error is set.
+ *
+ * Since: 4.14
+ **/
+gboolean
+blconf_channel_get_property_finish(BlconfChannel *channel,
+                                   GAsyncResult *result,
+                                   GValue *value,
+                                   GError **error)
+{
+    GValue *native;
+    gboolean ret;
+
+    g_return_val_if_fail(g_task_is_valid(result, channel) && value, FALSE);
+    g_return_val_if_fail(g_task_get_source_tag(G_TASK(result))
+                         == blconf_channel_get_property_async, FALSE);
+
+    native = g_task_propagate_pointer(G_TASK(result), error);
+    if(!native)
+        return FALSE;
+
+    ret = blconf_channel_convert_property(g_task_get_task_data(G_TASK(result)),
+                                          native, value);
+    _blconf_gvalue_free(native);
+
+    return ret;
+}
+
 /**
  * blconf_channel_set_property:
  * @channel: An #BlconfChannel.
@@ -1329,8 +2340,8 @@ blconf_channel_set_property(BlconfChannel *channel,
                          || g_utf8_validate(g_value_get_string(value), -1, NULL),
                          FALSE);
 
-    /* intercept uint16/int16 since dbus-glib doesn't know how to send
-     * them over the wire */
+    /* intercept uint16/int16: the daemon has always been sent (and has
+     * stored) them as 32-bit ints, so keep doing that */
     if(G_VALUE_TYPE(value) == BLCONF_TYPE_UINT16) {
         val = &tmp_val;
         g_value_init(&tmp_val, G_TYPE_UINT);
@@ -1360,6 +2371,172 @@ blconf_channel_set_property(BlconfChannel *channel,
     return ret;
 }
 
+/* converts |value| into what the daemon expects, which means
+ * replacing 16-bit integers with 32-bit ones */
+static void
+blconf_channel_value_for_wire(const GValue *value,
+                              GValue *dest)
+{
+    if(G_VALUE_TYPE(value) == BLCONF_TYPE_UINT16) {
+        g_value_init(dest, G_TYPE_UINT);
+        g_value_set_uint(dest, blconf_g_value_get_uint16(value));
+    } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_INT16) {
+        g_value_init(dest, G_TYPE_INT);
+        g_value_set_int(dest, blconf_g_value_get_int16(value));
+    } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY) {
+        GPtrArray *arr_new = blconf_fixup_16bit_ints(g_value_get_boxed(value));
+
+        g_value_init(dest, BLCONF_TYPE_G_VALUE_ARRAY);
+        if(arr_new)
+            g_value_take_boxed(dest, arr_new);
+        else
+            g_value_copy(value, dest);
+    } else
+        g_value_copy(value, g_value_init(dest, G_VALUE_TYPE(value)));
+}
+
+/**
+ * blconf_channel_set_properties:
+ * @channel: An #BlconfChannel.
+ * @properties: A #GHashTable of property names to #GValue<!-- -->s.
+ *
+ * Sets all of @properties on @channel at once.  The keys of
+ * @properties are string (gchar *) property names, and the values
+ * are variant (GValue *) values.  Either all of the properties are
+ * set, or, if any of them is locked, none of them is.
+ *
+ * This takes a single round trip to the configuration store, however
+ * many properties there are, so it is a lot cheaper than calling
+ * blconf_channel_set_property() for each of them.
+ *
+ * Returns: %TRUE if the properties were set successfully,
+ *          %FALSE otherwise.
+ *
+ * Since: 4.14
+ **/
+gboolean
+blconf_channel_set_properties(BlconfChannel *channel,
+                              GHashTable *properties)
+{
+    GHashTable *real_properties;
+    GHashTableIter iter;
+    gpointer property, value;
+    gboolean ret;
+    ERROR_DEFINE;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && properties, FALSE);
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        g_return_val_if_fail(property && G_IS_VALUE(value), FALSE);
+        g_return_val_if_fail(!G_VALUE_HOLDS_STRING(value)
+                             || g_value_get_string(value) == NULL
+                             || g_utf8_validate(g_value_get_string(value), -1, NULL),
+                             FALSE);
+    }
+
+    real_properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            (GDestroyNotify)g_free,
+                                            (GDestroyNotify)_blconf_gvalue_free);
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        GValue *real_value;
+
+        real_value = g_new0(GValue, 1);
+        blconf_channel_value_for_wire(value, real_value);
+        g_hash_table_insert(real_properties,
+                            channel->property_base
+                            ? g_strconcat(channel->property_base, property, NULL)
+                            : g_strdup(property),
+                            real_value);
+    }
+
+    ret = blconf_cache_set_many(channel->cache, real_properties, ERROR);
+    if(!ret)
+        ERROR_CHECK;
+
+    g_hash_table_destroy(real_properties);
+
+    return ret;
+}
+
+/**
+ * blconf_channel_get_many:
+ * @channel: An #BlconfChannel.
+ * @properties: A %NULL-terminated list of property names.
+ *
+ * Retrieves each of @properties from @channel, fetching any that
+ * aren't cached yet in a single round trip.  The returned #GHashTable
+ * maps the string (gchar *) property names to variant (GValue *)
+ * values; properties that don't exist are left out.
+ *
+ * Returns: A newly-allocated #GHashTable, which should be freed with
+ *          g_hash_table_destroy() when no longer needed, or %NULL
+ *          on error.
+ *
+ * Since: 4.14
+ **/
+GHashTable *
+blconf_channel_get_many(BlconfChannel *channel,
+                        const gchar * const *properties)
+{
+    GHashTable *values, *real_values;
+    gchar **real_properties;
+    gint i, n;
+    ERROR_DEFINE;
+
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && properties, NULL);
+
+    values = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                   (GDestroyNotify)g_free,
+                                   (GDestroyNotify)_blconf_gvalue_free);
+
+    if(!channel->property_base) {
+        if(!blconf_cache_get_many(channel->cache, properties, values, ERROR)) {
+            ERROR_CHECK;
+            g_hash_table_destroy(values);
+            return NULL;
+        }
+        return values;
+    }
+
+    n = g_strv_length((gchar **)properties);
+    real_properties = g_new0(gchar *, n + 1);
+    for(i = 0; i < n; ++i)
+        real_properties[i] = REAL_PROP(channel, properties[i]);
+
+    real_values = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        (GDestroyNotify)g_free,
+                                        (GDestroyNotify)_blconf_gvalue_free);
+    if(blconf_cache_get_many(channel->cache,
+                             (const gchar * const *)real_properties,
+                             real_values, ERROR))
+    {
+        /* hand the values back under the names the caller used */
+        for(i = 0; i < n; ++i) {
+            gpointer key, value;
+
+            if(g_hash_table_lookup_extended(real_values, real_properties[i],
+                                            &key, &value))
+            {
+                g_hash_table_steal(real_values, key);
+                g_free(key);
+                g_hash_table_insert(values, g_strdup(properties[i]), value);
+            }
+        }
+    } else {
+        ERROR_CHECK;
+        g_hash_table_destroy(values);
+        values = NULL;
+    }
+
+    g_hash_table_destroy(real_values);
+    g_strfreev(real_properties);
+
+    return values;
+}
+
 /**
  * blconf_channel_get_array:
  * @channel: An #BlconfChannel.
@@ -1741,18 +2918,562 @@ blconf_channel_set_arrayv(BlconfChannel *channel,
     return ret;
 }
 
-/**
- * blconf_channel_get_named_struct:
- * @channel: An #BlconfChannel.
- * @property: A string property name.
- * @struct_name: A string struct name.
- * @value_struct: A pointer to a struct.
- *
- * Gets a property from @channel and fills in @value_struct using
- * the retrieved values.  The @struct_name parameter is the same
- * name that must have been used to register the struct's layout
- * with blconf_named_struct_register().
- *
+/* one splice of the array in |property|, made in place by the daemon
+ * if it can.  takes |values| */
+static gboolean
+blconf_channel_patch_array(BlconfChannel *channel,
+                           const gchar *property,
+                           guint position,
+                           guint n_remove,
+                           GPtrArray *values)
+{
+    BlconfArraySplice splice;
+    GValue val = { 0, };
+    gchar *real_property = REAL_PROP(channel, property);
+    GError *error = NULL;
+    gboolean ret;
+
+    splice.position = position;
+    splice.n_remove = n_remove;
+    splice.values = values;
+
+    ret = blconf_cache_patch_array(channel->cache, real_property, &splice, 1,
+                                   &error);
+
+    /* a daemon from before PatchArray: the whole array it is */
+    if(!ret && g_error_matches(error, G_DBUS_ERROR,
+                               G_DBUS_ERROR_UNKNOWN_METHOD))
+    {
+        g_clear_error(&error);
+        ret = blconf_cache_lookup(channel->cache, real_property, &val, &error)
+              && _blconf_gvalue_splice(&val, &splice, 1)
+              && blconf_cache_set(channel->cache, real_property, &val,
+                                  channel->write_interval, &error);
+        if(G_IS_VALUE(&val))
+            g_value_unset(&val);
+    }
+
+#ifdef BLCONF_ENABLE_CHECKS
+    if(error) {
+        g_warning("Error check failed at %s():%d: %s", __FUNCTION__,
+                  __LINE__, error->message);
+    }
+#endif
+    if(error)
+        g_error_free(error);
+
+    _blconf_array_splice_clear(&splice);
+    if(real_property != property)
+        g_free(real_property);
+
+    return ret;
+}
+
+/* a one-element array of |value| as the daemon wants it */
+static GPtrArray *
+blconf_channel_splice_values(const GValue *value)
+{
+    GPtrArray *values = g_ptr_array_sized_new(1);
+    GValue *val = g_new0(GValue, 1);
+
+    blconf_channel_value_for_wire(value, val);
+    g_ptr_array_add(values, val);
+
+    return values;
+}
+
+/**
+ * blconf_channel_array_insert:
+ * @channel: An #BlconfChannel.
+ * @property: A property string.
+ * @index: Where in the array to insert @value.
+ * @value: The element to insert.
+ *
+ * Inserts @value into the array property @property on @channel, so
+ * that it becomes element @index; an @index equal to the length of
+ * the array appends it.  Only the change itself is sent to the
+ * configuration store, and on to the other clients that can take it,
+ * rather than the whole array, which makes this a lot cheaper than
+ * blconf_channel_set_arrayv() on a large array.
+ *
+ * The change is made to the array as the configuration store has it.
+ * If another client changed the array first, so that this client's
+ * idea of it was out of date, the change is not made.
+ *
+ * Returns: %TRUE if the element was inserted, %FALSE otherwise.
+ *
+ * Since: 4.14
+ **/
+gboolean
+blconf_channel_array_insert(BlconfChannel *channel,
+                            const gchar *property,
+                            guint index,
+                            const GValue *value)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property
+                         && G_IS_VALUE(value), FALSE);
+
+    return blconf_channel_patch_array(channel, property, index, 0,
+                                      blconf_channel_splice_values(value));
+}
+
+/**
+ * blconf_channel_array_remove:
+ * @channel: An #BlconfChannel.
+ * @property: A property string.
+ * @index: The element to remove.
+ *
+ * Removes element @index from the array property @property on
+ * @channel.  See blconf_channel_array_insert().
+ *
+ * Returns: %TRUE if the element was removed, %FALSE otherwise.
+ *
+ * Since: 4.14
+ **/
+gboolean
+blconf_channel_array_remove(BlconfChannel *channel,
+                            const gchar *property,
+                            guint index)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property, FALSE);
+
+    return blconf_channel_patch_array(channel, property, index, 1, NULL);
+}
+
+/**
+ * blconf_channel_array_replace:
+ * @channel: An #BlconfChannel.
+ * @property: A property string.
+ * @index: The element to replace.
+ * @value: The new element.
+ *
+ * Replaces element @index of the array property @property on
+ * @channel with @value.  See blconf_channel_array_insert().
+ *
+ * Returns: %TRUE if the element was replaced, %FALSE otherwise.
+ *
+ * Since: 4.14
+ **/
+gboolean
+blconf_channel_array_replace(BlconfChannel *channel,
+                             const gchar *property,
+                             guint index,
+                             const GValue *value)
+{
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property
+                         && G_IS_VALUE(value), FALSE);
+
+    return blconf_channel_patch_array(channel, property, index, 1,
+                                      blconf_channel_splice_values(value));
+}
+
+/* struct layouts: where each member lives in the struct, following the
+ * compiler's alignment rules.  named structs compile theirs once, in
+ * blconf_named_struct_register(); the others each time they're used,
+ * which is cheap next to everything else a get or set does */
+
+/* the size and alignment of a struct member of |type|.  returns FALSE
+ * if a struct can't hold one */
+static gboolean
+blconf_struct_member_type_info(GType type,
+                               gsize *size,
+                               gsize *alignment)
+{
+#define TYPE_INFO(ctype, ALIGNMENT)  G_STMT_START{ \
+    *size = sizeof(ctype); \
+    *alignment = ALIGNMENT; \
+}G_STMT_END
+
+    switch(type) {
+        case G_TYPE_STRING:
+            TYPE_INFO(gchar *, ALIGNOF_GPOINTER);
+            break;
+
+        case G_TYPE_UCHAR:
+            TYPE_INFO(guchar, ALIGNOF_GUCHAR);
+            break;
+
+        case G_TYPE_CHAR:
+            TYPE_INFO(gchar, ALIGNOF_GCHAR);
+            break;
+
+        case G_TYPE_UINT:
+            TYPE_INFO(guint32, ALIGNOF_GUINT32);
+            break;
+
+        case G_TYPE_INT:
+            TYPE_INFO(gint32, ALIGNOF_GINT32);
+            break;
+
+        case G_TYPE_UINT64:
+            TYPE_INFO(guint64, ALIGNOF_GUINT64);
+            break;
+
+        case G_TYPE_INT64:
+            TYPE_INFO(gint64, ALIGNOF_GINT64);
+            break;
+
+        case G_TYPE_FLOAT:
+            TYPE_INFO(gfloat, ALIGNOF_GFLOAT);
+            break;
+
+        case G_TYPE_DOUBLE:
+            TYPE_INFO(gdouble, ALIGNOF_GDOUBLE);
+            break;
+
+        case G_TYPE_BOOLEAN:
+            TYPE_INFO(gboolean, ALIGNOF_GBOOLEAN);
+            break;
+
+        default:
+            if(BLCONF_TYPE_UINT16 == type)
+                TYPE_INFO(guint16, ALIGNOF_GUINT16);
+            else if(BLCONF_TYPE_INT16 == type)
+                TYPE_INFO(gint16, ALIGNOF_GINT16);
+            else
+                return FALSE;
+            break;
+    }
+
+#undef TYPE_INFO
+
+    return TRUE;
+}
+
+/* works out |members| for a struct made up of |member_types|.
+ * returns FALSE if one of them can't be a struct member */
+gboolean
+_blconf_struct_layout_compile(guint n_members,
+                              const GType *member_types,
+                              BlconfStructMember *members)
+{
+    gsize cur_offset = 0, size, alignment;
+    guint i;
+
+    for(i = 0; i < n_members; ++i) {
+        if(!blconf_struct_member_type_info(member_types[i], &size,
+                                           &alignment))
+        {
+#ifdef BLCONF_ENABLE_CHECKS
+            g_warning("Unable to handle value type %ld (%s) as a struct " \
+                      "member", (long)member_types[i],
+                      g_type_name(member_types[i]));
+#endif
+            return FALSE;
+        }
+
+        cur_offset = ALIGN_VAL(cur_offset, alignment);
+        members[i].type = member_types[i];
+        members[i].offset = cur_offset;
+        cur_offset += size;
+    }
+
+    return TRUE;
+}
+
+/* whether |value| fits a struct member of |type|.  16-bit ints are
+ * mostly stored as 32-bit ones, see blconf_fixup_16bit_ints() */
+static gboolean
+blconf_struct_member_accepts(GType type,
+                             const GValue *value)
+{
+    if(BLCONF_TYPE_UINT16 == type)
+        return G_VALUE_TYPE(value) == G_TYPE_UINT
+               || G_VALUE_TYPE(value) == BLCONF_TYPE_UINT16;
+    else if(BLCONF_TYPE_INT16 == type)
+        return G_VALUE_TYPE(value) == G_TYPE_INT
+               || G_VALUE_TYPE(value) == BLCONF_TYPE_INT16;
+
+    return G_VALUE_TYPE(value) == type;
+}
+
+/* fills in |value_struct| from the values in |arr|, all or nothing */
+static gboolean
+blconf_struct_decode(const BlconfStructMember *members,
+                     guint n_members,
+                     const GPtrArray *arr,
+                     gpointer value_struct)
+{
+    guint i;
+
+    if(arr->len != n_members) {
+#ifdef BLCONF_ENABLE_CHECKS
+        g_warning("Returned value array does not match the number of struct " \
+                  "members (%d != %d)", arr->len, n_members);
+#endif
+        return FALSE;
+    }
+
+    for(i = 0; i < n_members; ++i) {
+        if(!blconf_struct_member_accepts(members[i].type,
+                                         g_ptr_array_index(arr, i)))
+        {
+#ifdef BLCONF_ENABLE_CHECKS
+            g_warning("Returned value type does not match specified struct member type");
+#endif
+            return FALSE;
+        }
+    }
+
+    for(i = 0; i < n_members; ++i) {
+        const GValue *val = g_ptr_array_index(arr, i);
+        gpointer member = (guchar *)value_struct + members[i].offset;
+
+#define SET_MEMBER(ctype, cvalgetter)  G_STMT_START{ \
+    *(ctype *)member = cvalgetter(val); \
+}G_STMT_END
+
+        switch(members[i].type) {
+            case G_TYPE_STRING:
+                SET_MEMBER(gchar *, g_value_dup_string);
+                break;
+
+            case G_TYPE_UCHAR:
+                SET_MEMBER(guchar, g_value_get_uchar);
+                break;
+
+            case G_TYPE_CHAR:
+#if GLIB_CHECK_VERSION (2, 32, 0)
+                SET_MEMBER(gchar, g_value_get_schar);
+#else
+                SET_MEMBER(gchar, g_value_get_char);
+#endif
+                break;
+
+            case G_TYPE_UINT:
+                SET_MEMBER(guint32, g_value_get_uint);
+                break;
+
+            case G_TYPE_INT:
+                SET_MEMBER(gint32, g_value_get_int);
+                break;
+
+            case G_TYPE_UINT64:
+                SET_MEMBER(guint64, g_value_get_uint64);
+                break;
+
+            case G_TYPE_INT64:
+                SET_MEMBER(gint64, g_value_get_int64);
+                break;
+
+            case G_TYPE_FLOAT:
+                SET_MEMBER(gfloat, g_value_get_float);
+                break;
+
+            case G_TYPE_DOUBLE:
+                SET_MEMBER(gdouble, g_value_get_double);
+                break;
+
+            case G_TYPE_BOOLEAN:
+                SET_MEMBER(gboolean, g_value_get_boolean);
+                break;
+
+            default:
+                if(BLCONF_TYPE_UINT16 == members[i].type) {
+                    if(G_VALUE_TYPE(val) == G_TYPE_UINT)
+                        SET_MEMBER(guint16, g_value_get_uint);
+                    else
+                        SET_MEMBER(guint16, blconf_g_value_get_uint16);
+                } else {
+                    if(G_VALUE_TYPE(val) == G_TYPE_INT)
+                        SET_MEMBER(gint16, g_value_get_int);
+                    else
+                        SET_MEMBER(gint16, blconf_g_value_get_int16);
+                }
+                break;
+        }
+
+#undef SET_MEMBER
+    }
+
+    return TRUE;
+}
+
+/* stores the members of |value_struct| in |values|, which must be
+ * zeroed.  strings aren't copied, and 16-bit ints become 32-bit ones,
+ * as blconf_channel_set_arrayv() would do */
+static void
+blconf_struct_encode(const BlconfStructMember *members,
+                     guint n_members,
+                     gconstpointer value_struct,
+                     GValue *values)
+{
+    guint i;
+
+    for(i = 0; i < n_members; ++i) {
+        GValue *val = &values[i];
+        gconstpointer member = (const guchar *)value_struct + members[i].offset;
+
+#define GET_MEMBER(ctype, GTYPE, cvalsetter)  G_STMT_START{ \
+    g_value_init(val, GTYPE); \
+    cvalsetter(val, *(const ctype *)member); \
+}G_STMT_END
+
+        switch(members[i].type) {
+            case G_TYPE_STRING:
+                GET_MEMBER(gchar *, G_TYPE_STRING, g_value_set_static_string);
+                break;
+
+            case G_TYPE_UCHAR:
+                GET_MEMBER(guchar, G_TYPE_UCHAR, g_value_set_uchar);
+                break;
+
+            case G_TYPE_CHAR:
+#if GLIB_CHECK_VERSION (2, 32, 0)
+                GET_MEMBER(gchar, G_TYPE_CHAR, g_value_set_schar);
+#else
+                GET_MEMBER(gchar, G_TYPE_CHAR, g_value_set_char);
+#endif
+                break;
+
+            case G_TYPE_UINT:
+                GET_MEMBER(guint32, G_TYPE_UINT, g_value_set_uint);
+                break;
+
+            case G_TYPE_INT:
+                GET_MEMBER(gint32, G_TYPE_INT, g_value_set_int);
+                break;
+
+            case G_TYPE_UINT64:
+                GET_MEMBER(guint64, G_TYPE_UINT64, g_value_set_uint64);
+                break;
+
+            case G_TYPE_INT64:
+                GET_MEMBER(gint64, G_TYPE_INT64, g_value_set_int64);
+                break;
+
+            case G_TYPE_FLOAT:
+                GET_MEMBER(gfloat, G_TYPE_FLOAT, g_value_set_float);
+                break;
+
+            case G_TYPE_DOUBLE:
+                GET_MEMBER(gdouble, G_TYPE_DOUBLE, g_value_set_double);
+                break;
+
+            case G_TYPE_BOOLEAN:
+                GET_MEMBER(gboolean, G_TYPE_BOOLEAN, g_value_set_boolean);
+                break;
+
+            default:
+                if(BLCONF_TYPE_UINT16 == members[i].type)
+                    GET_MEMBER(guint16, G_TYPE_UINT, g_value_set_uint);
+                else
+                    GET_MEMBER(gint16, G_TYPE_INT, g_value_set_int);
+                break;
+        }
+
+#undef GET_MEMBER
+    }
+}
+
+typedef struct
+{
+    const BlconfStructMember *members;
+    guint n_members;
+    gpointer value_struct;
+    gboolean ret;
+} BlconfStructDecode;
+
+static void
+blconf_struct_decode_func(const GValue *value,
+                          gpointer user_data)
+{
+    BlconfStructDecode *decode = user_data;
+    GValue unpacked = { 0, };
+
+    /* a struct of members of one type is cached packed */
+    if(BLCONF_TYPE_PACKED_ARRAY == G_VALUE_TYPE(value)) {
+        _blconf_gvalue_copy_unpacked(value, &unpacked);
+        value = &unpacked;
+    }
+
+    decode->ret = BLCONF_TYPE_G_VALUE_ARRAY == G_VALUE_TYPE(value)
+                  && blconf_struct_decode(decode->members, decode->n_members,
+                                          g_value_get_boxed(value),
+                                          decode->value_struct);
+
+    if(value == &unpacked)
+        g_value_unset(&unpacked);
+}
+
+/* a cached struct is decoded straight out of the cache, without
+ * copying the array first */
+static gboolean
+blconf_channel_get_struct_internal(BlconfChannel *channel,
+                                   const gchar *property,
+                                   gpointer value_struct,
+                                   const BlconfStructMember *members,
+                                   guint n_members)
+{
+    BlconfStructDecode decode = { members, n_members, value_struct, FALSE };
+    gchar buf[REAL_PROP_BUF_SIZE];
+    const gchar *cached_property;
+    GValue val = { 0, };
+
+    cached_property = blconf_channel_cached_property(channel, property,
+                                                     buf, sizeof(buf));
+    if(cached_property
+       && blconf_cache_read_cached(channel->cache, cached_property,
+                                   blconf_struct_decode_func, &decode))
+    {
+        return decode.ret;
+    }
+
+    /* not cached yet; fetching it caches it for next time */
+    if(!blconf_channel_get_internal(channel, property, &val))
+        return FALSE;
+
+    blconf_struct_decode_func(&val, &decode);
+    g_value_unset(&val);
+
+    return decode.ret;
+}
+
+static gboolean
+blconf_channel_set_struct_internal(BlconfChannel *channel,
+                                   const gchar *property,
+                                   gconstpointer value_struct,
+                                   const BlconfStructMember *members,
+                                   guint n_members)
+{
+    GValue *values, val = { 0, };
+    GPtrArray *arr;
+    guint i;
+    gboolean ret;
+
+    values = g_new0(GValue, n_members);
+    blconf_struct_encode(members, n_members, value_struct, values);
+
+    arr = g_ptr_array_sized_new(n_members);
+    for(i = 0; i < n_members; ++i)
+        g_ptr_array_add(arr, &values[i]);
+
+    g_value_init(&val, BLCONF_TYPE_G_VALUE_ARRAY);
+    g_value_set_static_boxed(&val, arr);
+
+    ret = blconf_channel_set_internal(channel, property, &val);
+
+    g_value_unset(&val);
+    g_ptr_array_free(arr, TRUE);
+    for(i = 0; i < n_members; ++i)
+        g_value_unset(&values[i]);
+    g_free(values);
+
+    return ret;
+}
+
+/**
+ * blconf_channel_get_named_struct:
+ * @channel: An #BlconfChannel.
+ * @property: A string property name.
+ * @struct_name: A string struct name.
+ * @value_struct: A pointer to a struct.
+ *
+ * Gets a property from @channel and fills in @value_struct using
+ * the retrieved values.  The @struct_name parameter is the same
+ * name that must have been used to register the struct's layout
+ * with blconf_named_struct_register().
+ *
  * Returns: %TRUE if the property was retrieved successfully,
  *          %FALSE otherwise.
  **/
@@ -1764,11 +3485,14 @@ blconf_channel_get_named_struct(BlconfChannel *channel,
 {
     BlconfNamedStruct *ns = _blconf_named_struct_lookup(struct_name);
 
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property && value_struct,
+                         FALSE);
+
     if(!ns)
         return FALSE;
 
-    return blconf_channel_get_structv(channel, property, value_struct,
-                                      ns->n_members, ns->member_types);
+    return blconf_channel_get_struct_internal(channel, property, value_struct,
+                                              ns->members, ns->n_members);
 }
 
 /**
@@ -1794,11 +3518,14 @@ blconf_channel_set_named_struct(BlconfChannel *channel,
 {
     BlconfNamedStruct *ns = _blconf_named_struct_lookup(struct_name);
 
+    g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property && value_struct,
+                         FALSE);
+
     if(!ns)
         return FALSE;
 
-    return blconf_channel_set_structv(channel, property, value_struct,
-                                      ns->n_members, ns->member_types);
+    return blconf_channel_set_struct_internal(channel, property, value_struct,
+                                              ns->members, ns->n_members);
 }
 
 
@@ -1926,134 +3653,25 @@ blconf_channel_get_structv(BlconfChannel *channel,
                            guint n_members,
                            GType *member_types)
 {
-    GPtrArray *arr;
-    guint i;
-    GValue *val;
+    BlconfStructMember members_buf[STRUCT_MEMBERS_PREALLOC], *members;
     gboolean ret = FALSE;
-    gsize cur_offset = 0;
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property && value_struct
                          && n_members && member_types, FALSE);
 
-    arr = blconf_channel_get_arrayv(channel, property);
-    if(!arr)
-        return FALSE;
-
-    if(arr->len != n_members) {
-#ifdef BLCONF_ENABLE_CHECKS
-        g_warning("Returned value array does not match the number of struct " \
-                  "members (%d != %d)", arr->len, n_members);
-#endif
-        goto out;
-    }
-
-    for(i = 0; i < n_members; ++i) {
-        typedef struct { guchar a; } DummyStruct;
-#ifdef BLCONF_ENABLE_CHECKS
-#define CHECK_VALUE_TYPES(val, GTYPE) G_STMT_START{ \
-    if(G_VALUE_TYPE((val)) != (GTYPE)) { \
-        g_warning("Returned value type does not match specified struct member type"); \
-        goto out; \
-    } \
-}G_STMT_END
-#else
-#define CHECK_VALUE_TYPES(val, GTYPE) G_STMT_START{ \
-    if(G_VALUE_TYPE((val)) != (GTYPE)) \
-        goto out; \
-}G_STMT_END
-#endif
-
-#define SET_STRUCT_VAL(ctype, GTYPE, alignment, cvalgetter)  G_STMT_START{ \
-    ctype *__val_p; \
-    val = g_ptr_array_index(arr, i); \
-    CHECK_VALUE_TYPES(val, GTYPE); \
-    cur_offset = ALIGN_VAL(cur_offset, alignment); \
-    __val_p = (ctype *)(((guchar *)(&(((DummyStruct *)value_struct)->a)))+cur_offset); \
-    *__val_p = cvalgetter(val); \
-    cur_offset += sizeof(ctype); \
-}G_STMT_END
-
-        switch(member_types[i]) {
-            case G_TYPE_STRING:
-                SET_STRUCT_VAL(gchar *, G_TYPE_STRING, ALIGNOF_GPOINTER,
-                               g_value_dup_string);
-                break;
-            
-            case G_TYPE_UCHAR:
-                SET_STRUCT_VAL(guchar, G_TYPE_UCHAR, ALIGNOF_GUCHAR,
-                               g_value_get_uchar);
-                break;
-
-            case G_TYPE_CHAR:
-#if GLIB_CHECK_VERSION (2, 32, 0)
-                SET_STRUCT_VAL(gchar, G_TYPE_CHAR, ALIGNOF_GCHAR,
-                               g_value_get_schar);
-#else
-                SET_STRUCT_VAL(gchar, G_TYPE_CHAR, ALIGNOF_GCHAR,
-                               g_value_get_char);
-#endif
-                break;
-
-            case G_TYPE_UINT:
-                SET_STRUCT_VAL(guint32, G_TYPE_UINT, ALIGNOF_GUINT32,
-                               g_value_get_uint);
-                break;
-
-            case G_TYPE_INT:
-                SET_STRUCT_VAL(gint32, G_TYPE_INT, ALIGNOF_GINT32,
-                               g_value_get_int);
-                break;
-
-            case G_TYPE_UINT64:
-                SET_STRUCT_VAL(guint64, G_TYPE_UINT64, ALIGNOF_GUINT64,
-                               g_value_get_uint64);
-                break;
-
-            case G_TYPE_INT64:
-                SET_STRUCT_VAL(gint64, G_TYPE_INT64, ALIGNOF_GINT64,
-                               g_value_get_int64);
-                break;
-
-            case G_TYPE_FLOAT:
-                SET_STRUCT_VAL(gfloat, G_TYPE_FLOAT, ALIGNOF_GFLOAT,
-                               g_value_get_float);
-                break;
-
-            case G_TYPE_DOUBLE:
-                SET_STRUCT_VAL(gdouble, G_TYPE_DOUBLE, ALIGNOF_GDOUBLE,
-                               g_value_get_double);
-                break;
-
-            case G_TYPE_BOOLEAN:
-                SET_STRUCT_VAL(gboolean, G_TYPE_BOOLEAN, ALIGNOF_GBOOLEAN,
-                               g_value_get_boolean);
-                break;
+    if(n_members <= G_N_ELEMENTS(members_buf))
+        members = members_buf;
+    else
+        members = g_new(BlconfStructMember, n_members);
 
-            default:
-                if(BLCONF_TYPE_UINT16 == member_types[i]) {
-                    /* uint16 is stored as uint */
-                    SET_STRUCT_VAL(guint16, G_TYPE_UINT,
-                                   ALIGNOF_GUINT16, g_value_get_uint);
-                } else if(BLCONF_TYPE_INT16 == member_types[i]) {
-                    /* int16 is stored as int */
-                    SET_STRUCT_VAL(gint16, G_TYPE_INT,
-                                   ALIGNOF_GINT16, g_value_get_int);
-                } else {
-#ifdef BLCONF_ENABLE_CHECKS
-                    g_warning("Unable to handle value type %ld (%s) when " \
-                              "setting a struct value", (long)member_types[i],
-                              g_type_name(member_types[i]));
-#endif
-                    goto out;
-                }
-                break;
-        }
+    if(_blconf_struct_layout_compile(n_members, member_types, members)) {
+        ret = blconf_channel_get_struct_internal(channel, property,
+                                                 value_struct, members,
+                                                 n_members);
     }
 
-    ret = TRUE;
-
-out:
-    blconf_array_free(arr);
+    if(members != members_buf)
+        g_free(members);
 
     return ret;
 }
@@ -2172,112 +3790,25 @@ blconf_channel_set_structv(BlconfChannel *channel,
                            guint n_members,
                            GType *member_types)
 {
-    GPtrArray *arr;
-    guint i;
-    GValue *val;
+    BlconfStructMember members_buf[STRUCT_MEMBERS_PREALLOC], *members;
     gboolean ret = FALSE;
-    gsize cur_offset = 0;
 
     g_return_val_if_fail(BLCONF_IS_CHANNEL(channel) && property && value_struct
                          && n_members && member_types, FALSE);
 
-    arr = g_ptr_array_sized_new(n_members);
-
-    for(i = 0; i < n_members; ++i) {
-        typedef struct { guchar a; } DummyStruct;
-
-#define GET_STRUCT_VAL(ctype, GTYPE, alignment, cvalsetter)  G_STMT_START{ \
-    ctype *__val_p; \
-    val = g_new0(GValue, 1); \
-    g_value_init(val, GTYPE); \
-    cur_offset = ALIGN_VAL(cur_offset, alignment); \
-    __val_p = (ctype *)(((guchar *)(&(((DummyStruct *)value_struct)->a)))+cur_offset); \
-    cvalsetter(val, *__val_p); \
-    g_ptr_array_add(arr, val); \
-    cur_offset += sizeof(ctype); \
-}G_STMT_END
-
-        switch(member_types[i]) {
-            case G_TYPE_STRING:
-                GET_STRUCT_VAL(gchar *, G_TYPE_STRING, ALIGNOF_GPOINTER,
-                               g_value_set_static_string);
-                break;
-            
-            case G_TYPE_UCHAR:
-                GET_STRUCT_VAL(guchar, G_TYPE_UCHAR, ALIGNOF_GUCHAR,
-                               g_value_set_uchar);
-                break;
-
-            case G_TYPE_CHAR:
-#if GLIB_CHECK_VERSION (2, 32, 0)
-                GET_STRUCT_VAL(gchar, G_TYPE_CHAR, ALIGNOF_GCHAR,
-                               g_value_set_schar);
-#else
-                GET_STRUCT_VAL(gchar, G_TYPE_CHAR, ALIGNOF_GCHAR,
-                               g_value_set_char);
-#endif
-                break;
-
-            case G_TYPE_UINT:
-                GET_STRUCT_VAL(guint32, G_TYPE_UINT, ALIGNOF_GUINT32,
-                               g_value_set_uint);
-                break;
-
-            case G_TYPE_INT:
-                GET_STRUCT_VAL(gint32, G_TYPE_INT, ALIGNOF_GINT32,
-                               g_value_set_int);
-                break;
-
-            case G_TYPE_UINT64:
-                GET_STRUCT_VAL(guint64, G_TYPE_UINT64, ALIGNOF_GUINT64,
-                               g_value_set_uint64);
-                break;
-
-            case G_TYPE_INT64:
-                GET_STRUCT_VAL(gint64, G_TYPE_INT64, ALIGNOF_GINT64,
-                               g_value_set_int64);
-                break;
-
-            case G_TYPE_FLOAT:
-                GET_STRUCT_VAL(gfloat, G_TYPE_FLOAT, ALIGNOF_GFLOAT,
-                               g_value_set_float);
-                break;
-
-            case G_TYPE_DOUBLE:
-                GET_STRUCT_VAL(gdouble, G_TYPE_DOUBLE, ALIGNOF_GDOUBLE,
-                               g_value_set_double);
-                break;
-
-            case G_TYPE_BOOLEAN:
-                GET_STRUCT_VAL(gboolean, G_TYPE_BOOLEAN, ALIGNOF_GBOOLEAN,
-                               g_value_set_boolean);
-                break;
+    if(n_members <= G_N_ELEMENTS(members_buf))
+        members = members_buf;
+    else
+        members = g_new(BlconfStructMember, n_members);
 
-            default:
-                if(BLCONF_TYPE_UINT16 == member_types[i]) {
-                    /* _set_arrayv() will convert these */
-                    GET_STRUCT_VAL(guint16, BLCONF_TYPE_UINT16,
-                                   ALIGNOF_GUINT16, blconf_g_value_set_uint16);
-                } else if(BLCONF_TYPE_INT16 == member_types[i]) {
-                    /* _set_arrayv() will convert these */
-                    GET_STRUCT_VAL(gint16, BLCONF_TYPE_INT16,
-                                   ALIGNOF_GINT16, blconf_g_value_set_int16);
-                } else {
-#ifdef BLCONF_ENABLE_CHECKS
-                    g_warning("Unable to handle value type %ld (%s) when " \
-                              "getting a struct value", (long)member_types[i],
-                              g_type_name(member_types[i]));
-#endif
-                    goto out;
-                }
-                break;
-        }
+    if(_blconf_struct_layout_compile(n_members, member_types, members)) {
+        ret = blconf_channel_set_struct_internal(channel, property,
+                                                 value_struct, members,
+                                                 n_members);
     }
 
-    ret = blconf_channel_set_arrayv(channel, property, arr);
-
-out:
-    blconf_array_free(arr);
+    if(members != members_buf)
+        g_free(members);
 
     return ret;
 }
@@ -2290,21 +3821,226 @@ out:
  * Returns: A newly-allocated array of strings.  Free with
  *          g_strfreev() when no longer needed.
  **/
-/* this really belongs in blconf.c, but i don't feel like including
- * blconf-dbus-bindings.h twice, or copying the ERROR macros */
+/* this really belongs in blconf.c, but i don't feel like copying the
+ * ERROR macros */
 gchar **
 blconf_list_channels(void)
 {
-    DBusGProxy *proxy = _blconf_get_dbus_g_proxy();
+    GVariant *reply;
     gchar **channels = NULL;
     ERROR_DEFINE;
 
-    if(!blconf_client_list_channels(proxy, &channels, ERROR))
+    reply = _blconf_dbus_call_sync("ListChannels", NULL,
+                                   G_VARIANT_TYPE("(as)"), ERROR);
+    if(reply) {
+        g_variant_get(reply, "(^as)", &channels);
+        g_variant_unref(reply);
+    } else
         ERROR_CHECK;
 
     return channels;
 }
 
+/**
+ * blconf_prefetch_channels:
+ * @channels: A %NULL-terminated array of channel names.
+ *
+ * Fetches the properties of all of @channels from the configuration
+ * store in a single round trip, so that channels created for them
+ * afterwards don't need to fetch their own.  An entry of the form
+ * "channel/property/base" only fetches the properties under
+ * "/property/base".  Applications that open several channels at
+ * startup should call this once, right after blconf_init().
+ *
+ * The fetched properties are kept until blconf_shutdown(), subject
+ * to the limits set with blconf_channel_set_cache_limits().
+ *
+ * Returns: %TRUE if the properties were fetched, %FALSE on error.
+ *
+ * Since: 4.14
+ **/
+gboolean
+blconf_prefetch_channels(const gchar * const *channels)
+{
+    GVariantBuilder builder;
+    GVariantIter *iter;
+    GVariant *reply, *dict;
+    BlconfCache **caches;
+    gchar **property_bases;
+    gboolean ret = FALSE, success;
+    guint i, n_channels;
+    GError *error = NULL;
+
+    g_return_val_if_fail(channels, FALSE);
+
+    n_channels = g_strv_length((gchar **)channels);
+    caches = g_new(BlconfCache *, n_channels);
+    property_bases = g_new0(gchar *, n_channels + 1);
+
+    /* the caches are there before the call goes out, so they also see
+     * every change made while it's on its way */
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ss)"));
+    for(i = 0; i < n_channels; ++i) {
+        const gchar *slash = strchr(channels[i], '/');
+        gchar *channel_name;
+
+        if(slash) {
+            channel_name = g_strndup(channels[i], slash - channels[i]);
+            property_bases[i] = g_strdup(slash);
+        } else {
+            channel_name = g_strdup(channels[i]);
+            property_bases[i] = g_strdup("/");
+        }
+
+        /* the watch lasts as long as the cache, like the prefetch */
+        caches[i] = blconf_cache_acquire(channel_name);
+        blconf_cache_watch(caches[i], property_bases[i]);
+        g_variant_builder_add(&builder, "(ss)", channel_name,
+                              property_bases[i]);
+        g_free(channel_name);
+    }
+
+    reply = _blconf_dbus_call_sync("GetAllPropertiesMany",
+                                   g_variant_new("(a(ss))", &builder),
+                                   G_VARIANT_TYPE("(a(ba{sv}))"), &error);
+    if(reply) {
+        g_variant_get(reply, "(a(ba{sv}))", &iter);
+        for(i = 0;
+            i < n_channels && g_variant_iter_next(iter, "(b@a{sv})",
+                                                  &success, &dict);
+            ++i)
+        {
+            if(success) {
+                GHashTable *properties = _blconf_gvariant_to_hash_packed(dict);
+
+                blconf_cache_seed(caches[i], property_bases[i], properties);
+                g_hash_table_destroy(properties);
+            }
+            g_variant_unref(dict);
+        }
+        g_variant_iter_free(iter);
+        g_variant_unref(reply);
+        ret = TRUE;
+    } else if(g_error_matches(error, G_DBUS_ERROR,
+                              G_DBUS_ERROR_UNKNOWN_METHOD))
+    {
+        /* an older daemon: one channel at a time is still better than
+         * fetching them again for each channel object */
+        g_clear_error(&error);
+        ret = TRUE;
+        for(i = 0; i < n_channels; ++i) {
+            if(!blconf_cache_prefetch(caches[i], property_bases[i], NULL))
+                ret = FALSE;
+        }
+    } else {
+#ifdef BLCONF_ENABLE_CHECKS
+        g_warning("Unable to prefetch channels: %s", error->message);
+#endif
+        g_error_free(error);
+    }
+
+    /* keep the caches around until blconf_shutdown(), even when no
+     * channel object uses them */
+    G_LOCK(__singletons);
+    for(i = 0; i < n_channels; ++i) {
+        if(g_slist_find(__prefetched_caches, caches[i]))
+            blconf_cache_release(caches[i]);
+        else
+            __prefetched_caches = g_slist_prepend(__prefetched_caches, caches[i]);
+    }
+    G_UNLOCK(__singletons);
+
+    g_strfreev(property_bases);
+    g_free(caches);
+
+    return ret;
+}
+
+#define FETCH_PAGE_SIZE  256
+
+/* Fetches the properties under |property_base| a page at a time,
+ * handing each page's entries to |func|, which should steal them;
+ * with |packed|, arrays come as the cache keeps them.
+ * Falls back to a single GetAllProperties call when the daemon is too
+ * old to know about paging, or when the property a cursor points at
+ * was removed between two pages. */
+gboolean
+_blconf_channel_fetch_properties(const gchar *channel_name,
+                                 const gchar *property_base,
+                                 gboolean packed,
+                                 GHRFunc func,
+                                 gpointer user_data,
+                                 GError **error)
+{
+    static gboolean no_paging = FALSE;
+    GVariant *reply, *dict;
+    GHashTable *props = NULL;
+    gchar *cursor = g_strdup(""), *next_cursor = NULL;
+    GError *tmp_error = NULL;
+
+    while(!no_paging) {
+        reply = _blconf_dbus_call_sync("GetAllPropertiesPaged",
+                                       g_variant_new("(sssu)", channel_name,
+                                                     property_base, cursor,
+                                                     FETCH_PAGE_SIZE),
+                                       G_VARIANT_TYPE("(a{sv}s)"),
+                                       &tmp_error);
+        if(!reply) {
+            if(g_error_matches(tmp_error, G_DBUS_ERROR,
+                               G_DBUS_ERROR_UNKNOWN_METHOD))
+            {
+                no_paging = TRUE;
+                g_clear_error(&tmp_error);
+                break;
+            } else if(*cursor) {
+                g_clear_error(&tmp_error);
+                break;
+            }
+
+            g_free(cursor);
+            g_propagate_error(error, tmp_error);
+            return FALSE;
+        }
+
+        g_variant_get(reply, "(@a{sv}s)", &dict, &next_cursor);
+        props = packed ? _blconf_gvariant_to_hash_packed(dict)
+                       : _blconf_gvariant_to_hash(dict);
+        g_variant_unref(dict);
+        g_variant_unref(reply);
+
+        g_hash_table_foreach_steal(props, func, user_data);
+        g_hash_table_destroy(props);
+        props = NULL;
+
+        g_free(cursor);
+        cursor = next_cursor;
+        if(!*cursor) {
+            g_free(cursor);
+            return TRUE;
+        }
+    }
+
+    g_free(cursor);
+
+    reply = _blconf_dbus_call_sync("GetAllProperties",
+                                   g_variant_new("(ss)", channel_name,
+                                                 property_base),
+                                   G_VARIANT_TYPE("(a{sv})"), error);
+    if(!reply)
+        return FALSE;
+
+    g_variant_get(reply, "(@a{sv})", &dict);
+    props = packed ? _blconf_gvariant_to_hash_packed(dict)
+                   : _blconf_gvariant_to_hash(dict);
+    g_variant_unref(dict);
+    g_variant_unref(reply);
+
+    g_hash_table_foreach_steal(props, func, user_data);
+    g_hash_table_destroy(props);
+
+    return TRUE;
+}
+
 
 
 #define __BLCONF_CHANNEL_C__
@@ -25,7 +25,7 @@
 #error "Do not include blconf-channel.h, as this file may change or disappear in the future.  Include <blconf/blconf.h> instead."
 #endif
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 #define BLCONF_TYPE_CHANNEL             (blconf_channel_get_type())
 #define BLCONF_CHANNEL(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), BLCONF_TYPE_CHANNEL, BlconfChannel))
@@ -34,11 +34,21 @@
 #define BLCONF_IS_CHANNEL_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), BLCONF_TYPE_CHANNEL))
 #define BLCONF_CHANNEL_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), BLCONF_TYPE_CHANNEL, BlconfChannelClass))
 
+#define BLCONF_TYPE_CHANNEL_PREFETCH    (blconf_channel_prefetch_get_type())
+
 G_BEGIN_DECLS
 
+typedef enum
+{
+    BLCONF_CHANNEL_PREFETCH_FULL = 0,
+    BLCONF_CHANNEL_PREFETCH_ASYNC,
+    BLCONF_CHANNEL_PREFETCH_NONE,
+} BlconfChannelPrefetch;
+
 typedef struct _BlconfChannel         BlconfChannel;
 
 GType blconf_channel_get_type(void) G_GNUC_CONST;
+GType blconf_channel_prefetch_get_type(void) G_GNUC_CONST;
 
 BlconfChannel *blconf_channel_get(const gchar *channel_name);
 
@@ -47,6 +57,10 @@ BlconfChannel *blconf_channel_new(const gchar *channel_name) G_GNUC_WARN_UNUSED_
 BlconfChannel *blconf_channel_new_with_property_base(const gchar *channel_name,
                                                      const gchar *property_base) G_GNUC_WARN_UNUSED_RESULT;
 
+BlconfChannel *blconf_channel_new_full(const gchar *channel_name,
+                                       const gchar *property_base,
+                                       BlconfChannelPrefetch prefetch) G_GNUC_WARN_UNUSED_RESULT;
+
 gboolean blconf_channel_has_property(BlconfChannel *channel,
                                      const gchar *property);
 
@@ -60,11 +74,17 @@ void blconf_channel_reset_property(BlconfChannel *channel,
 GHashTable *blconf_channel_get_properties(BlconfChannel *channel,
                                           const gchar *property_base) G_GNUC_WARN_UNUSED_RESULT;
 
+gchar *blconf_channel_get_next_property(BlconfChannel *channel,
+                                        const gchar *property) G_GNUC_WARN_UNUSED_RESULT;
+
 /* basic types */
 
 gchar *blconf_channel_get_string(BlconfChannel *channel,
                                  const gchar *property,
                                  const gchar *default_value) G_GNUC_WARN_UNUSED_RESULT;
+const gchar *blconf_channel_peek_string(BlconfChannel *channel,
+                                        const gchar *property,
+                                        const gchar *default_value);
 gboolean blconf_channel_set_string(BlconfChannel *channel,
                                    const gchar *property,
                                    const gchar *value);
@@ -112,6 +132,23 @@ gboolean blconf_channel_set_string_list(BlconfChannel *channel,
                                         const gchar *property,
                                         const gchar * const *values);
 
+/* likewise for arrays of a single numeric type, as plain C arrays */
+gint32 *blconf_channel_get_int_array(BlconfChannel *channel,
+                                     const gchar *property,
+                                     guint *n_values) G_GNUC_WARN_UNUSED_RESULT;
+guint32 *blconf_channel_get_uint_array(BlconfChannel *channel,
+                                       const gchar *property,
+                                       guint *n_values) G_GNUC_WARN_UNUSED_RESULT;
+guint64 *blconf_channel_get_uint64_array(BlconfChannel *channel,
+                                         const gchar *property,
+                                         guint *n_values) G_GNUC_WARN_UNUSED_RESULT;
+gdouble *blconf_channel_get_double_array(BlconfChannel *channel,
+                                         const gchar *property,
+                                         guint *n_values) G_GNUC_WARN_UNUSED_RESULT;
+gboolean *blconf_channel_get_bool_array(BlconfChannel *channel,
+                                        const gchar *property,
+                                        guint *n_values) G_GNUC_WARN_UNUSED_RESULT;
+
 /* really generic API - can set some value types that aren't
  * supported by the basic type API, e.g., char, signed short,
  * unsigned int, etc.  no, you can't set arbitrary GTypes. */
@@ -122,6 +159,52 @@ gboolean blconf_channel_set_property(BlconfChannel *channel,
                                      const gchar *property,
                                      const GValue *value);
 
+/* batched API - many properties in a single round trip */
+GHashTable *blconf_channel_get_many(BlconfChannel *channel,
+                                    const gchar * const *properties) G_GNUC_WARN_UNUSED_RESULT;
+gboolean blconf_channel_set_properties(BlconfChannel *channel,
+                                       GHashTable *properties);
+
+/* asynchronous reads - the callbacks run in the thread-default
+ * main context of the calling thread */
+void blconf_channel_get_property_async(BlconfChannel *channel,
+                                       const gchar *property,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+gboolean blconf_channel_get_property_finish(BlconfChannel *channel,
+                                            GAsyncResult *result,
+                                            GValue *value,
+                                            GError **error);
+void blconf_channel_has_property_async(BlconfChannel *channel,
+                                       const gchar *property,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+gboolean blconf_channel_has_property_finish(BlconfChannel *channel,
+                                            GAsyncResult *result,
+                                            GError **error);
+void blconf_channel_get_properties_async(BlconfChannel *channel,
+                                         const gchar *property_base,
+                                         GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data);
+GHashTable *blconf_channel_get_properties_finish(BlconfChannel *channel,
+                                                 GAsyncResult *result,
+                                                 GError **error) G_GNUC_WARN_UNUSED_RESULT;
+
+/* memory used by the client-side cache */
+void blconf_channel_set_cache_limits(BlconfChannel *channel,
+                                     gint max_entries,
+                                     gint64 max_bytes,
+                                     gint max_age);
+GHashTable *blconf_channel_get_cache_stats(BlconfChannel *channel) G_GNUC_WARN_UNUSED_RESULT;
+
+/* coalescing of frequent writes */
+void blconf_channel_set_write_interval(BlconfChannel *channel,
+                                       guint interval);
+void blconf_channel_flush(BlconfChannel *channel);
+
 /* array types - arrays can be made up of values of arbitrary
  * (and mixed) types, even some not supported by the basic
  * type API */
@@ -149,6 +232,18 @@ gboolean blconf_channel_set_arrayv(BlconfChannel *channel,
                                    const gchar *property,
                                    GPtrArray *values);
 
+gboolean blconf_channel_array_insert(BlconfChannel *channel,
+                                     const gchar *property,
+                                     guint index,
+                                     const GValue *value);
+gboolean blconf_channel_array_remove(BlconfChannel *channel,
+                                     const gchar *property,
+                                     guint index);
+gboolean blconf_channel_array_replace(BlconfChannel *channel,
+                                      const gchar *property,
+                                      guint index,
+                                      const GValue *value);
+
 /* struct types */
 
 gboolean blconf_channel_get_named_struct(BlconfChannel *channel,
@@ -44,6 +44,7 @@ typedef enum
     BLCONF_ERROR_NO_BACKEND,
     BLCONF_ERROR_INVALID_PROPERTY,
     BLCONF_ERROR_INVALID_CHANNEL,
+    BLCONF_ERROR_CONFLICT,
 } BlconfError;
 
 GType blconf_error_get_type(void) G_GNUC_CONST;
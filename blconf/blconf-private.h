@@ -21,7 +21,7 @@
 #ifndef __BLCONF_PRIVATE_H__
 #define __BLCONF_PRIVATE_H__
 
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 
 #ifdef BLCONF_ENABLE_CHECKS
 
@@ -43,20 +43,47 @@
 
 #endif
 
+/* where a struct member lives, see _blconf_struct_layout_compile() */
+typedef struct
+{
+    GType type;
+    gsize offset;
+} BlconfStructMember;
+
 typedef struct
 {
     guint n_members;
-    GType *member_types;
+    BlconfStructMember *members;  /* compiled at registration */
 } BlconfNamedStruct;
 
-DBusGConnection *_blconf_get_dbus_g_connection(void);
-DBusGProxy *_blconf_get_dbus_g_proxy(void);
+GDBusConnection *_blconf_get_gdbus_connection(void);
+GDBusProxy *_blconf_get_gdbus_proxy(void);
+GVariant *_blconf_dbus_call_sync(const gchar *method,
+                                 GVariant *parameters,
+                                 const GVariantType *reply_type,
+                                 GError **error);
+GVariant *_blconf_dbus_call_with_fds_sync(const gchar *method,
+                                          GVariant *parameters,
+                                          const GVariantType *reply_type,
+                                          GUnixFDList **out_fd_list,
+                                          GError **error);
 
 BlconfNamedStruct *_blconf_named_struct_lookup(const gchar *struct_name);
+gboolean _blconf_struct_layout_compile(guint n_members,
+                                       const GType *member_types,
+                                       BlconfStructMember *members);
 
 void _blconf_channel_shutdown(void);
+void _blconf_cache_shutdown(void);
+void _blconf_cache_reconnect(GDBusProxy *proxy);
 const gchar *_blconf_channel_get_name(BlconfChannel *channel);
 const gchar *_blconf_channel_get_property_base(BlconfChannel *channel);
+gboolean _blconf_channel_fetch_properties(const gchar *channel_name,
+                                          const gchar *property_base,
+                                          gboolean packed,
+                                          GHRFunc func,
+                                          gpointer user_data,
+                                          GError **error);
 
 void _blconf_g_bindings_shutdown(void);
 
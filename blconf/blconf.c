@@ -27,42 +27,99 @@
 #endif
 
 #include <glib-object.h>
-
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 
 #include "blconf.h"
-#include "common/blconf-marshal.h"
 #include "blconf-private.h"
 #include "common/blconf-alias.h"
 
 static guint blconf_refcnt = 0;
-static DBusGConnection *dbus_conn = NULL;
-static DBusGProxy *dbus_proxy = NULL;
+static GDBusConnection *dbus_conn = NULL;
+static GDBusProxy *bus_proxy = NULL;
+/* on the daemon's private socket, see blconf_open_peer() */
+static GDBusProxy *peer_proxy = NULL;
+/* whichever of the two the calls go to */
+static GDBusProxy *dbus_proxy = NULL;
+/* whether the name had an owner yet, see blconf_name_owner_changed() */
+static gboolean had_owner = FALSE;
 static GHashTable *named_structs = NULL;
 
 
 /* private api */
 
-DBusGConnection *
-_blconf_get_dbus_g_connection(void)
+GDBusConnection *
+_blconf_get_gdbus_connection(void)
+{
+    if(!blconf_refcnt) {
+        g_critical("blconf_init() must be called before attempting to use libblconf!");
+        return NULL;
+    }
+
+    return g_dbus_proxy_get_connection(g_atomic_pointer_get(&dbus_proxy));
+}
+
+GDBusProxy *
+_blconf_get_gdbus_proxy(void)
 {
     if(!blconf_refcnt) {
         g_critical("blconf_init() must be called before attempting to use libblconf!");
         return NULL;
     }
 
-    return dbus_conn;
+    return g_atomic_pointer_get(&dbus_proxy);
+}
+
+/* calls |method| on the daemon and waits for the reply, which is
+ * checked against |reply_type|.  errors sent by the daemon come back
+ * in their original domain (BLCONF_ERROR and friends). */
+GVariant *
+_blconf_dbus_call_sync(const gchar *method,
+                       GVariant *parameters,
+                       const GVariantType *reply_type,
+                       GError **error)
+{
+    return _blconf_dbus_call_with_fds_sync(method, parameters, reply_type,
+                                           NULL, error);
 }
 
-DBusGProxy *
-_blconf_get_dbus_g_proxy(void)
+/* like _blconf_dbus_call_sync(), for methods that hand out file
+ * descriptors; they end up in |*out_fd_list| */
+GVariant *
+_blconf_dbus_call_with_fds_sync(const gchar *method,
+                                GVariant *parameters,
+                                const GVariantType *reply_type,
+                                GUnixFDList **out_fd_list,
+                                GError **error)
 {
+    GDBusProxy *proxy;
+    GError *error1 = NULL;
+    GVariant *reply;
+
     if(!blconf_refcnt) {
         g_critical("blconf_init() must be called before attempting to use libblconf!");
+        if(parameters)
+            g_variant_unref(g_variant_ref_sink(parameters));
         return NULL;
     }
 
-    return dbus_proxy;
+    proxy = g_atomic_pointer_get(&dbus_proxy);
+    reply = g_dbus_connection_call_with_unix_fd_list_sync(g_dbus_proxy_get_connection(proxy),
+                                                          g_dbus_proxy_get_name(proxy),
+                                                          g_dbus_proxy_get_object_path(proxy),
+                                                          g_dbus_proxy_get_interface_name(proxy),
+                                                          method, parameters,
+                                                          reply_type,
+                                                          G_DBUS_CALL_FLAGS_NONE,
+                                                          -1, NULL,
+                                                          out_fd_list, NULL,
+                                                          &error1);
+    if(!reply) {
+        if(g_dbus_error_is_remote_error(error1))
+            g_dbus_error_strip_remote_error(error1);
+        g_propagate_error(error, error1);
+    }
+
+    return reply;
 }
 
 BlconfNamedStruct *
@@ -74,32 +131,115 @@ _blconf_named_struct_lookup(const gchar *struct_name)
 static void
 _blconf_named_struct_free(BlconfNamedStruct *ns)
 {
-    g_free(ns->member_types);
+    g_free(ns->members);
     g_slice_free(BlconfNamedStruct, ns);
 }
 
 
 
+/* the daemon went away, and the private connection with it.  the
+ * next call over the bus starts a new one, but then we just stay on
+ * the bus; the old proxy is kept until blconf_shutdown(), in case
+ * another thread is still using it. */
+static void
+blconf_peer_closed(GDBusConnection *connection,
+                   gboolean remote_peer_vanished,
+                   GError *error,
+                   gpointer user_data)
+{
+    g_signal_handlers_disconnect_by_func(connection,
+                                         G_CALLBACK(blconf_peer_closed),
+                                         NULL);
+
+    g_atomic_pointer_set(&dbus_proxy, bus_proxy);
+    _blconf_cache_reconnect(bus_proxy);
+}
+
+/* a new daemon took the name on the bus, because the old one exited
+ * or handed over to it: the caches have to catch up with what changed
+ * in between.  the first owner is just the daemon being started.  on
+ * a private connection, blconf_peer_closed() sees to it instead. */
+static void
+blconf_name_owner_changed(GObject *object,
+                          GParamSpec *pspec,
+                          gpointer user_data)
+{
+    gchar *owner = g_dbus_proxy_get_name_owner(G_DBUS_PROXY(object));
+
+    if(owner) {
+        if(had_owner && g_atomic_pointer_get(&dbus_proxy) == bus_proxy)
+            _blconf_cache_reconnect(bus_proxy);
+        had_owner = TRUE;
+        g_free(owner);
+    }
+}
+
+/* Talking to blconfd over its private socket skips the bus daemon,
+ * which halves the copies and context switches per call.  Any failure
+ * here just means staying on the bus; BLCONF_PEER=0 does that too,
+ * for when the traffic should show up in dbus-monitor. */
+static void
+blconf_open_peer(void)
+{
+    GDBusConnection *connection;
+    const gchar *address;
+    GVariant *reply;
+
+    if(g_getenv("BLCONF_PEER") && !strcmp(g_getenv("BLCONF_PEER"), "0"))
+        return;
+
+    /* this starts the daemon if it isn't running yet, a little ahead
+     * of the first real call */
+    reply = g_dbus_connection_call_sync(dbus_conn,
+                                        g_dbus_proxy_get_name(bus_proxy),
+                                        g_dbus_proxy_get_object_path(bus_proxy),
+                                        g_dbus_proxy_get_interface_name(bus_proxy),
+                                        "GetPeerAddress", NULL,
+                                        G_VARIANT_TYPE("(s)"),
+                                        G_DBUS_CALL_FLAGS_NONE, -1,
+                                        NULL, NULL);
+    if(!reply)
+        return;
+
+    g_variant_get(reply, "(&s)", &address);
+    connection = g_dbus_connection_new_for_address_sync(address,
+                                                        G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                        NULL, NULL, NULL);
+    g_variant_unref(reply);
+    if(!connection)
+        return;
+
+    /* no bus, so no name: calls go to, and signals come from, the
+     * daemon at the other end */
+    peer_proxy = g_dbus_proxy_new_sync(connection,
+                                       G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES
+                                       | G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS,
+                                       NULL,
+                                       NULL,
+                                       g_dbus_proxy_get_object_path(bus_proxy),
+                                       g_dbus_proxy_get_interface_name(bus_proxy),
+                                       NULL, NULL);
+    if(peer_proxy) {
+        g_signal_connect(connection, "closed",
+                         G_CALLBACK(blconf_peer_closed), NULL);
+        /* the cache knows what to do with PropertyPatched, so the
+         * daemon can send just the changed elements of an array.  an
+         * older daemon fails this, and keeps sending whole values */
+        g_dbus_proxy_call(peer_proxy, "EnablePatches", NULL,
+                          G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL, NULL);
+        g_atomic_pointer_set(&dbus_proxy, peer_proxy);
+    }
+    g_object_unref(connection);
+}
+
 static void
 blconf_static_dbus_init(void)
 {
     static gboolean static_dbus_inited = FALSE;
 
     if(!static_dbus_inited) {
-        dbus_g_error_domain_register(BLCONF_ERROR, "org.blade.Blconf.Error",
-                                     BLCONF_TYPE_ERROR);
-
-        dbus_g_object_register_marshaller(_blconf_marshal_VOID__STRING_STRING_BOXED,
-                                          G_TYPE_NONE,
-                                          G_TYPE_STRING,
-                                          G_TYPE_STRING,
-                                          G_TYPE_VALUE,
-                                          G_TYPE_INVALID);
-        dbus_g_object_register_marshaller(_blconf_marshal_VOID__STRING_STRING,
-                                          G_TYPE_NONE,
-                                          G_TYPE_STRING,
-                                          G_TYPE_STRING,
-                                          G_TYPE_INVALID);
+        /* maps the daemon's error names back onto BLCONF_ERROR */
+        blconf_get_error_quark();
 
         static_dbus_inited = TRUE;
     }
@@ -133,21 +273,36 @@ blconf_init(GError **error)
 
     blconf_static_dbus_init();
 
-    dbus_conn = dbus_g_bus_get(DBUS_BUS_SESSION, error);
+    dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, error);
     if(!dbus_conn)
         return FALSE;
 
-    dbus_proxy = dbus_g_proxy_new_for_name(dbus_conn,
-                                           "org.blade.Blconf",
-                                           "/org/blade/Blconf",
-                                           "org.blade.Blconf");
+    /* the daemon is started on demand by the first call, so the proxy
+     * mustn't try to talk to it up front.  signals are subscribed to
+     * per channel by each BlconfCache instead of for the whole
+     * interface, see blconf_cache_constructed() */
+    bus_proxy = g_dbus_proxy_new_sync(dbus_conn,
+                                      G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES
+                                      | G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS
+                                      | G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START,
+                                      NULL,
+                                      "org.blade.Blconf",
+                                      "/org/blade/Blconf",
+                                      "org.blade.Blconf",
+                                      NULL, error);
+    if(!bus_proxy) {
+        g_object_unref(dbus_conn);
+        dbus_conn = NULL;
+        return FALSE;
+    }
+    dbus_proxy = bus_proxy;
+
+    blconf_open_peer();
 
-    dbus_g_proxy_add_signal(dbus_proxy, "PropertyChanged",
-                            G_TYPE_STRING, G_TYPE_STRING, G_TYPE_VALUE,
-                            G_TYPE_INVALID);
-    dbus_g_proxy_add_signal(dbus_proxy, "PropertyRemoved",
-                            G_TYPE_STRING, G_TYPE_STRING,
-                            G_TYPE_INVALID);
+    had_owner = FALSE;
+    g_signal_connect(bus_proxy, "notify::g-name-owner",
+                     G_CALLBACK(blconf_name_owner_changed), NULL);
+    blconf_name_owner_changed(G_OBJECT(bus_proxy), NULL, NULL);
 
     ++blconf_refcnt;
     return TRUE;
@@ -173,6 +328,7 @@ blconf_shutdown(void)
     }
 
     _blconf_channel_shutdown();
+    _blconf_cache_shutdown();
     _blconf_g_bindings_shutdown();
 
     if(named_structs) {
@@ -180,10 +336,27 @@ blconf_shutdown(void)
         named_structs = NULL;
     }
 
-    g_object_unref(G_OBJECT(dbus_proxy));
+    /* make sure any outstanding SetProperty calls actually go out */
+    if(peer_proxy) {
+        GDBusConnection *connection = g_dbus_proxy_get_connection(peer_proxy);
+
+        g_signal_handlers_disconnect_by_func(connection,
+                                             G_CALLBACK(blconf_peer_closed),
+                                             NULL);
+        if(!g_dbus_connection_is_closed(connection))
+            g_dbus_connection_flush_sync(connection, NULL, NULL);
+        g_object_unref(G_OBJECT(peer_proxy));
+        peer_proxy = NULL;
+    }
+    g_signal_handlers_disconnect_by_func(bus_proxy,
+                                         G_CALLBACK(blconf_name_owner_changed),
+                                         NULL);
+    g_object_unref(G_OBJECT(bus_proxy));
+    bus_proxy = NULL;
     dbus_proxy = NULL;
 
-    dbus_g_connection_unref(dbus_conn);
+    g_dbus_connection_flush_sync(dbus_conn, NULL, NULL);
+    g_object_unref(G_OBJECT(dbus_conn));
     dbus_conn = NULL;
 
     --blconf_refcnt;
@@ -196,7 +369,8 @@ blconf_shutdown(void)
  * @member_types: An array of the #GType<!-- -->s of the struct members.
  *
  * Registers a named struct for use with blconf_channel_get_named_struct()
- * and blconf_channel_set_named_struct().
+ * and blconf_channel_set_named_struct().  The struct's layout is worked
+ * out once, here, rather than on every get and set.
  **/
 void
 blconf_named_struct_register(const gchar *struct_name,
@@ -204,6 +378,7 @@ blconf_named_struct_register(const gchar *struct_name,
                              const GType *member_types)
 {
     BlconfNamedStruct *ns;
+    BlconfStructMember *members;
 
     g_return_if_fail(struct_name && *struct_name && n_members && member_types);
 
@@ -213,16 +388,24 @@ blconf_named_struct_register(const gchar *struct_name,
                                               (GDestroyNotify)g_free,
                                               (GDestroyNotify)_blconf_named_struct_free);
 
-    if(G_UNLIKELY(g_hash_table_lookup(named_structs, struct_name)))
+    if(G_UNLIKELY(g_hash_table_lookup(named_structs, struct_name))) {
         g_critical("The struct '%s' is already registered", struct_name);
-    else {
-        ns = g_slice_new(BlconfNamedStruct);
-        ns->n_members = n_members;
-        ns->member_types = g_new(GType, n_members);
-        memcpy(ns->member_types, member_types, sizeof(GType) * n_members);
+        return;
+    }
 
-        g_hash_table_insert(named_structs, g_strdup(struct_name), ns);
+    members = g_new(BlconfStructMember, n_members);
+    if(!_blconf_struct_layout_compile(n_members, member_types, members)) {
+        g_critical("The struct '%s' has a member of a type that can't be stored",
+                   struct_name);
+        g_free(members);
+        return;
     }
+
+    ns = g_slice_new(BlconfNamedStruct);
+    ns->n_members = n_members;
+    ns->members = members;
+
+    g_hash_table_insert(named_structs, g_strdup(struct_name), ns);
 }
 
 #if 0
@@ -45,6 +45,8 @@ void blconf_array_free(GPtrArray *arr);
 
 gchar **blconf_list_channels(void) G_GNUC_WARN_UNUSED_RESULT;
 
+gboolean blconf_prefetch_channels(const gchar * const *channels);
+
 G_END_DECLS
 
 #endif  /* __BLCONF_H__ */
@@ -0,0 +1,167 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A simple bump allocator.  Memory is carved out of large blocks and
+ * is only returned to the system when the whole arena is destroyed.
+ * Freed pieces are kept on per-size free lists so that a long-lived
+ * channel that sees a lot of churn doesn't keep growing. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "blconf-arena.h"
+
+#define ARENA_BLOCK_SIZE  (8192)
+#define ARENA_ALIGN       (sizeof(gpointer))
+#define ARENA_N_CLASSES   (32)  /* sizes up to 32 * ARENA_ALIGN are recycled */
+
+#define ARENA_ROUND(size)  (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+typedef struct _ArenaFree ArenaFree;
+struct _ArenaFree
+{
+    ArenaFree *next;
+};
+
+struct _BlconfArena
+{
+    GSList *blocks;
+    guint8 *cur;
+    gsize left;
+    gsize size;  /* everything allocated from the heap */
+
+    ArenaFree *free_lists[ARENA_N_CLASSES];
+};
+
+
+BlconfArena *
+blconf_arena_new(void)
+{
+    return g_slice_new0(BlconfArena);
+}
+
+void
+blconf_arena_destroy(BlconfArena *arena)
+{
+    if(G_UNLIKELY(!arena))
+        return;
+
+    g_slist_foreach(arena->blocks, (GFunc)g_free, NULL);
+    g_slist_free(arena->blocks);
+    g_slice_free(BlconfArena, arena);
+}
+
+gpointer
+blconf_arena_alloc0(BlconfArena *arena,
+                    gsize size)
+{
+    guint size_class;
+    gpointer mem;
+
+    g_return_val_if_fail(arena, NULL);
+
+    size = ARENA_ROUND(MAX(size, sizeof(ArenaFree)));
+    size_class = size / ARENA_ALIGN - 1;
+
+    if(size_class < ARENA_N_CLASSES && arena->free_lists[size_class]) {
+        mem = arena->free_lists[size_class];
+        arena->free_lists[size_class] = arena->free_lists[size_class]->next;
+        memset(mem, 0, size);
+        return mem;
+    }
+
+    if(G_UNLIKELY(size > ARENA_BLOCK_SIZE / 4)) {
+        /* large pieces get a block of their own; we keep bumping
+         * from the current block afterwards */
+        mem = g_malloc0(size);
+        arena->size += size;
+        arena->blocks = g_slist_prepend(arena->blocks, mem);
+        return mem;
+    }
+
+    if(arena->left < size) {
+        arena->cur = g_malloc(ARENA_BLOCK_SIZE);
+        arena->left = ARENA_BLOCK_SIZE;
+        arena->size += ARENA_BLOCK_SIZE;
+        arena->blocks = g_slist_prepend(arena->blocks, arena->cur);
+    }
+
+    mem = arena->cur;
+    arena->cur += size;
+    arena->left -= size;
+
+    memset(mem, 0, size);
+
+    return mem;
+}
+
+void
+blconf_arena_free(BlconfArena *arena,
+                  gpointer mem,
+                  gsize size)
+{
+    ArenaFree *piece = mem;
+    guint size_class;
+
+    if(G_UNLIKELY(!arena || !mem))
+        return;
+
+    size = ARENA_ROUND(MAX(size, sizeof(ArenaFree)));
+    size_class = size / ARENA_ALIGN - 1;
+
+    /* oversized pieces are just left alone until the arena goes away */
+    if(size_class < ARENA_N_CLASSES) {
+        piece->next = arena->free_lists[size_class];
+        arena->free_lists[size_class] = piece;
+    }
+}
+
+gsize
+blconf_arena_get_size(BlconfArena *arena)
+{
+    return arena ? arena->size : 0;
+}
+
+gchar *
+blconf_arena_strdup(BlconfArena *arena,
+                    const gchar *str)
+{
+    gsize len;
+    gchar *copy;
+
+    if(G_UNLIKELY(!str))
+        return NULL;
+
+    len = strlen(str) + 1;
+    copy = blconf_arena_alloc0(arena, len);
+    memcpy(copy, str, len);
+
+    return copy;
+}
+
+void
+blconf_arena_free_string(BlconfArena *arena,
+                         gchar *str)
+{
+    if(G_LIKELY(str))
+        blconf_arena_free(arena, str, strlen(str) + 1);
+}
@@ -0,0 +1,48 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_ARENA_H__
+#define __BLCONF_ARENA_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BlconfArena BlconfArena;
+
+G_GNUC_INTERNAL BlconfArena *blconf_arena_new(void);
+G_GNUC_INTERNAL void blconf_arena_destroy(BlconfArena *arena);
+
+G_GNUC_INTERNAL gpointer blconf_arena_alloc0(BlconfArena *arena,
+                                             gsize size);
+G_GNUC_INTERNAL void blconf_arena_free(BlconfArena *arena,
+                                       gpointer mem,
+                                       gsize size);
+
+G_GNUC_INTERNAL gsize blconf_arena_get_size(BlconfArena *arena);
+
+G_GNUC_INTERNAL gchar *blconf_arena_strdup(BlconfArena *arena,
+                                           const gchar *str);
+G_GNUC_INTERNAL void blconf_arena_free_string(BlconfArena *arena,
+                                              gchar *str);
+
+#define blconf_arena_new0(arena, type)  ((type *)blconf_arena_alloc0((arena), sizeof(type)))
+#define blconf_arena_delete(arena, type, mem)  blconf_arena_free((arena), (mem), sizeof(type))
+
+G_END_DECLS
+
+#endif  /* __BLCONF_ARENA_H__ */
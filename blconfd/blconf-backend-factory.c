@@ -33,9 +33,13 @@
  * backend should be the one that gets written to all the time.
  */
 
+#include "blconf-backend-volatile.h"
 #ifdef BUILD_BLCONF_BACKEND_PERCHANNEL_XML
 #include "blconf-backend-perchannel-xml.h"
 #endif
+#ifdef BUILD_BLCONF_BACKEND_SQLITE
+#include "blconf-backend-sqlite.h"
+#endif
 
 static GHashTable *backends = NULL;
 
@@ -57,6 +61,23 @@ blconf_backend_factory_ensure_backends(void)
                             gtype);
     }
 #endif
+#ifdef BUILD_BLCONF_BACKEND_SQLITE
+    {
+        GType *gtype = g_new(GType, 1);
+        *gtype = BLCONF_TYPE_BACKEND_SQLITE;
+        g_hash_table_insert(backends,
+                            (gpointer)BLCONF_BACKEND_SQLITE_TYPE_ID,
+                            gtype);
+    }
+#endif
+    {
+        /* has no dependencies, so it's always there */
+        GType *gtype = g_new(GType, 1);
+        *gtype = BLCONF_TYPE_BACKEND_VOLATILE;
+        g_hash_table_insert(backends,
+                            (gpointer)BLCONF_BACKEND_VOLATILE_TYPE_ID,
+                            gtype);
+    }
 }
 
 
@@ -21,6 +21,11 @@
 #include <config.h>
 #endif
 
+/* for syncfs() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 
 #ifdef HAVE_SYS_TYPES_H
@@ -51,39 +56,153 @@
 #include <fcntl.h>
 #endif
 
+#include <gio/gio.h>
 #include <libbladeutil/libbladeutil.h>
-#include <dbus/dbus-glib.h>
 
 #include "blconf-backend-perchannel-xml.h"
 #include "blconf-backend.h"
 #include "blconf-locking-utils.h"
+#include "blconf-arena.h"
+#include "blconf-string-pool.h"
+#include "blconf-markup.h"
+#include "blconf-stats.h"
 #include "common/blconf-gvaluefuncs.h"
 #include "blconf/blconf-types.h"
 #include "common/blconf-common-private.h"
+#include "common/blconf-probes.h"
 
 #define FILE_VERSION_MAJOR  "1"
 #define FILE_VERSION_MINOR  "0"
 
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+#define STAT_MTIME_NSEC(st)  ((st)->st_mtim.tv_nsec)
+#else
+#define STAT_MTIME_NSEC(st)  (0)
+#endif
+
 #define PROP_NAME_IS_VALID(name) ( (name) && (name)[0] == '/' && (name)[1] != 0 && !strstr((name), "//") )
 
 #define CONFIG_DIR_STEM  "xfce4/blconf/" BLCONF_BACKEND_PERCHANNEL_XML_TYPE_ID "/"
 #define CONFIG_FILE_FMT  CONFIG_DIR_STEM "%s.xml"
 #define CACHE_TIMEOUT    (20*60*1000)  /* 20 minutes */
+#define EVICT_INTERVAL   (5*60)  /* 5 minutes */
+#define MISSING_TIMEOUT  (10)  /* 10 seconds */
+#define MISSING_MAX      (256)
+#define RELOAD_TIMEOUT   (1000)  /* 1 second */
 #define WRITE_TIMEOUT    (5)  /* 5 seconds */
+#define MAX_WRITE_DELAY  (30)  /* 30 seconds */
+#define GROUP_COMMIT_WINDOW  (1)  /* 1 second */
 #define MAX_PROP_PATH    (4096)
+#define PRELOAD_THREADS  (4)
+#define HOT_CHANNELS_MAX (64)
+#define HOT_CHANNELS_FILE  "hot-channels"
+
+#define WRITE_BUFFER_SIZE  (16*1024)
+#define WRITE_BUFFER_KEEP  (256*1024)
+
+#define SHARED_DEFAULTS_DIR       LOCALSTATEDIR "/cache/blconf"
+#define SHARED_DEFAULTS_FILE_FMT  "%s/%s.defaults"
+
+#define JOURNAL_FILE_FMT     "%s/%s.journal"
+#define JOURNAL_MAX_SIZE     (256*1024)  /* compact past 256kB ... */
+#define JOURNAL_MAX_RECORDS  (4096)      /* ... or that many changes */
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define writer_mutex_lock(xbpx)      g_mutex_lock(&(xbpx)->writer_lock)
+#define writer_mutex_unlock(xbpx)    g_mutex_unlock(&(xbpx)->writer_lock)
+#define writer_cond_wait(xbpx)       g_cond_wait(&(xbpx)->writer_cond, &(xbpx)->writer_lock)
+#define writer_cond_broadcast(xbpx)  g_cond_broadcast(&(xbpx)->writer_cond)
+#else
+#define writer_mutex_lock(xbpx)      g_mutex_lock((xbpx)->writer_lock)
+#define writer_mutex_unlock(xbpx)    g_mutex_unlock((xbpx)->writer_lock)
+#define writer_cond_wait(xbpx)       g_cond_wait((xbpx)->writer_cond, (xbpx)->writer_lock)
+#define writer_cond_broadcast(xbpx)  g_cond_broadcast((xbpx)->writer_cond)
+#endif
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define channels_mutex_lock(xbpx)    g_mutex_lock(&(xbpx)->channels_lock)
+#define channels_mutex_unlock(xbpx)  g_mutex_unlock(&(xbpx)->channels_lock)
+#define channels_cond_wait(xbpx)       g_cond_wait(&(xbpx)->channels_cond, &(xbpx)->channels_lock)
+#define channels_cond_broadcast(xbpx)  g_cond_broadcast(&(xbpx)->channels_cond)
+#define channel_read_lock(channel)     g_rw_lock_reader_lock(&(channel)->lock)
+#define channel_read_unlock(channel)   g_rw_lock_reader_unlock(&(channel)->lock)
+#define channel_write_lock(channel)    g_rw_lock_writer_lock(&(channel)->lock)
+#define channel_write_unlock(channel)  g_rw_lock_writer_unlock(&(channel)->lock)
+#else
+#define channels_mutex_lock(xbpx)    g_mutex_lock((xbpx)->channels_lock)
+#define channels_mutex_unlock(xbpx)  g_mutex_unlock((xbpx)->channels_lock)
+#define channels_cond_wait(xbpx)       g_cond_wait((xbpx)->channels_cond, (xbpx)->channels_lock)
+#define channels_cond_broadcast(xbpx)  g_cond_broadcast((xbpx)->channels_cond)
+#define channel_read_lock(channel)     g_static_rw_lock_reader_lock(&(channel)->lock)
+#define channel_read_unlock(channel)   g_static_rw_lock_reader_unlock(&(channel)->lock)
+#define channel_write_lock(channel)    g_static_rw_lock_writer_lock(&(channel)->lock)
+#define channel_write_unlock(channel)  g_static_rw_lock_writer_unlock(&(channel)->lock)
+#endif
 
 struct _BlconfBackendPerchannelXml
 {
     GObject parent;
 
     gchar *config_save_path;
-
+    gchar *cache_save_path;
+    gchar *shared_defaults_path;  /* NULL if there are none */
+
+    /* Reads may come from any thread; changes (sets, resets, reloads
+     * and saves) only from the one running the main loop.  The tables
+     * below are guarded by |channels_lock|, which is never held while
+     * waiting for a channel's lock, and each channel's properties by
+     * its own reader/writer lock. */
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex channels_lock;
+    GCond channels_cond;
+#else
+    GMutex *channels_lock;
+    GCond *channels_cond;
+#endif
     GHashTable *channels;
-
-    guint save_id;
+    GHashTable *missing_channels;  /* lower-case name -> expiry, see _channel_is_missing() */
+    GHashTable *loading_channels;  /* name -> stale flag, see _load_channel() */
+    GHashTable *hot_channels;  /* name -> order of first use, see _preload() */
+    GHashTable *handoff_channels;  /* name -> GBytes, see _restore_state() */
+
+    GThreadPool *preloader;
+
+    /* see blconf_backend_perchannel_xml_ensure_channel_index() */
+    GPtrArray *channel_dirs;
+    GHashTable *channel_index;  /* name -> number of dirs with a file */
+    gboolean channel_index_live;
+    guint channel_index_id;
+    GHashTable *own_writes;  /* filename -> FileStamp, under |writer_lock| */
+
+    gboolean use_journal;
+
+    guint evict_id;
+    gint cache_timeout;  /* ms, CACHE_TIMEOUT unless overridden */
+
+    /* filled in by the writer, see _get_stats() */
+    BlconfHistogram fsync_times;
+    BlconfHistogram write_times;
+
+    /* asynchronous writes, see blconf_backend_perchannel_xml_flush_channels() */
+    GThreadPool *writer;
+    GString *write_buffer;  /* only touched by the writer */
+    guint n_pending_writes;
+    GSList *write_results;
+    guint write_results_id;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex writer_lock;
+    GCond writer_cond;
+#else
+    GMutex *writer_lock;
+    GCond *writer_cond;
+#endif
 
     BlconfPropertyChangedFunc prop_changed_func;
     gpointer prop_changed_data;
+    BlconfPropertyChangedFullFunc prop_changed_full_func;
+    gpointer prop_changed_full_data;
+    BlconfPropertiesResetFunc props_reset_func;
+    gpointer props_reset_data;
 };
 
 typedef struct _BlconfBackendPerchannelXmlClass
@@ -93,17 +212,53 @@ typedef struct _BlconfBackendPerchannelXmlClass
 
 typedef struct
 {
+    BlconfBackendPerchannelXml *xbpx;
+    gchar *name;  /* same as the key in |xbpx->channels| */
+
+    /* one ref is held by |xbpx->channels|, one by every call using it */
+    gint ref_count;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GRWLock lock;
+#else
+    GStaticRWLock lock;
+#endif
+
+    BlconfArena *arena;  /* owns the properties and the index keys */
     GNode *properties;
+    GHashTable *prop_index;  /* full path -> BlconfProperty */
     gboolean locked;
+    GHashTable *locked_props;  /* locked paths, NULL if there are none */
     gboolean dirty;
+    gboolean write_failed;  /* the last write didn't make it to disk */
+
+    guint save_id;
+    gint64 save_due;  /* monotonic time |save_id| fires at */
+    gint64 dirty_since;  /* monotonic time of the first unsaved change */
+    gint64 last_access;  /* monotonic time, see _evict_timeout() */
+    guint reload_id;
+
+    guint64 hits;  /* calls that used it, under |xbpx->channels_lock| */
+    gint64 last_flush;  /* how long the last write took, -1 if never */
+
+    /* changes since the last full write, see the journal section */
+    GString *journal;  /* records not yet handed to the writer */
+    guint journal_records;
+    gsize journal_size;
+    gboolean journal_base;  /* the user file exists and can be appended to */
+
+    /* see the shared defaults section */
+    gboolean per_user_locks;  /* a system file locks for some users only */
+    GMappedFile *shared_defaults;  /* holds the system values' strings */
 } BlconfChannel;
 
 typedef struct
 {
-    gchar *name;
+    const gchar *name;  /* pooled, see blconf-string-pool.c */
     GValue value;
     GValue system_value;
     gboolean locked;
+    GHashTable *children;  /* child name -> GNode, NULL for leaves */
+    GVariant *wire;  /* the effective value as sent, built on first read */
 } BlconfProperty;
 
 typedef enum
@@ -128,6 +283,7 @@ typedef struct
     gchar cur_path[MAX_PROP_PATH];
     gchar *list_property;
     GValue *list_value;
+    GHashTable *lock_lists;  /* lock/unlock list -> whether it names us */
 } XmlParserState;
 
 static void blconf_backend_perchannel_xml_finalize(GObject *obj);
@@ -151,6 +307,14 @@ static gboolean blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
                                                       const gchar *property_base,
                                                       GHashTable *properties,
                                                       GError **error);
+static gboolean blconf_backend_perchannel_xml_get_all_paged(BlconfBackend *backend,
+                                                            const gchar *channel_name,
+                                                            const gchar *property_base,
+                                                            const gchar *cursor,
+                                                            guint page_size,
+                                                            GHashTable *properties,
+                                                            gchar **next_cursor,
+                                                            GError **error);
 static gboolean blconf_backend_perchannel_xml_exists(BlconfBackend *backend,
                                                      const gchar *channel_name,
                                                      const gchar *property,
@@ -174,37 +338,140 @@ static gboolean blconf_backend_perchannel_xml_flush(BlconfBackend *backend,
 static void blconf_backend_perchannel_xml_register_property_changed_func(BlconfBackend *backend,
                                                                          BlconfPropertyChangedFunc func,
                                                                          gpointer user_data);
+static void blconf_backend_perchannel_xml_register_properties_reset_func(BlconfBackend *backend,
+                                                                         BlconfPropertiesResetFunc func,
+                                                                         gpointer user_data);
+static gboolean blconf_backend_perchannel_xml_set_many(BlconfBackend *backend,
+                                                       const gchar *channel_name,
+                                                       GHashTable *properties,
+                                                       GError **error);
+static gboolean blconf_backend_perchannel_xml_get_many(BlconfBackend *backend,
+                                                       const gchar *channel_name,
+                                                       const gchar * const *properties,
+                                                       GHashTable *values,
+                                                       GError **error);
+static gboolean blconf_backend_perchannel_xml_reset_many(BlconfBackend *backend,
+                                                         const gchar *channel_name,
+                                                         const gchar * const *properties,
+                                                         GError **error);
+static void blconf_backend_perchannel_xml_preload(BlconfBackend *backend,
+                                                  const gchar * const *channels);
+static GVariant *blconf_backend_perchannel_xml_get_stats(BlconfBackend *backend);
+static GVariant *blconf_backend_perchannel_xml_save_state(BlconfBackend *backend);
+static void blconf_backend_perchannel_xml_restore_state(BlconfBackend *backend,
+                                                        GVariant *state);
+static gboolean blconf_backend_perchannel_xml_patch_array(BlconfBackend *backend,
+                                                          const gchar *channel_name,
+                                                          const gchar *property,
+                                                          const BlconfArraySplice *splices,
+                                                          guint n_splices,
+                                                          GError **error);
+static GVariant *blconf_backend_perchannel_xml_get_variant(BlconfBackend *backend,
+                                                           const gchar *channel_name,
+                                                           const gchar *property,
+                                                           GError **error);
+static gboolean blconf_backend_perchannel_xml_get_all_variants(BlconfBackend *backend,
+                                                               const gchar *channel_name,
+                                                               const gchar *property_base,
+                                                               GHashTable *variants,
+                                                               GError **error);
+static void blconf_backend_perchannel_xml_register_property_changed_full_func(BlconfBackend *backend,
+                                                                              BlconfPropertyChangedFullFunc func,
+                                                                              gpointer user_data);
+
+static void blconf_backend_perchannel_xml_notify(BlconfBackendPerchannelXml *xbpx,
+                                                 const gchar *channel_name,
+                                                 const gchar *property,
+                                                 const GValue *old_value,
+                                                 const GValue *new_value);
+static const GValue *blconf_property_get_effective_value(BlconfProperty *prop);
+static void blconf_property_drop_wire(BlconfProperty *prop);
 
 static void blconf_backend_perchannel_xml_schedule_save(BlconfBackendPerchannelXml *xbpx,
                                                         BlconfChannel *channel);
-
+static void blconf_backend_perchannel_xml_journal_record(BlconfBackendPerchannelXml *xbpx,
+                                                         BlconfChannel *channel,
+                                                         gchar op,
+                                                         const gchar *property,
+                                                         const GValue *value);
+static void blconf_backend_perchannel_xml_journal_record_splice(BlconfBackendPerchannelXml *xbpx,
+                                                                BlconfChannel *channel,
+                                                                const gchar *property,
+                                                                const BlconfArraySplice *splice);
+
+static BlconfChannel *blconf_backend_perchannel_xml_read_channel(BlconfBackendPerchannelXml *xbpx,
+                                                                 const gchar *channel_name,
+                                                                 GBytes *handoff,
+                                                                 GError **error);
+static gboolean blconf_backend_perchannel_xml_find_files(const gchar *channel_name,
+                                                         gchar ***filenames,
+                                                         gchar **user_file);
+static gchar *blconf_shared_defaults_get_dir(void);
+static void blconf_backend_perchannel_xml_file_changed(BlconfBackendPerchannelXml *xbpx,
+                                                       const gchar *filename,
+                                                       const gchar *channel_name);
+static void blconf_file_stamp_free(gpointer stamp);
+static void blconf_backend_perchannel_xml_index_user_channel(BlconfBackendPerchannelXml *xbpx,
+                                                             const gchar *channel_name,
+                                                             gboolean exists);
+static void blconf_backend_perchannel_xml_clear_channel_missing(BlconfBackendPerchannelXml *xbpx,
+                                                                const gchar *channel_name);
+static BlconfChannel *blconf_backend_perchannel_xml_lookup_channel(BlconfBackendPerchannelXml *xbpx,
+                                                                   const gchar *channel_name);
+static void blconf_backend_perchannel_xml_add_channel(BlconfBackendPerchannelXml *xbpx,
+                                                      const gchar *channel_name,
+                                                      BlconfChannel *channel);
 static BlconfChannel *blconf_backend_perchannel_xml_create_channel(BlconfBackendPerchannelXml *xbpx,
                                                                    const gchar *channel_name);
+static void blconf_backend_perchannel_xml_wait_loading(BlconfBackendPerchannelXml *xbpx,
+                                                      const gchar *channel_name);
+static void blconf_backend_perchannel_xml_invalidate_loading(BlconfBackendPerchannelXml *xbpx,
+                                                            const gchar *channel_name);
+static void blconf_backend_perchannel_xml_note_hot_channel(BlconfBackendPerchannelXml *xbpx,
+                                                           BlconfChannel *channel);
+static void blconf_backend_perchannel_xml_save_hot_channels(BlconfBackendPerchannelXml *xbpx);
 static BlconfChannel *blconf_backend_perchannel_xml_load_channel(BlconfBackendPerchannelXml *xbpx,
                                                                  const gchar *channel_name,
                                                                  GError **error);
-static gboolean blconf_backend_perchannel_xml_flush_channel(BlconfBackendPerchannelXml *xbpx,
-                                                            const gchar *channel_name,
-                                                            GError **error);
+static void blconf_backend_perchannel_xml_flush_channels(BlconfBackendPerchannelXml *xbpx,
+                                                         GSList *channel_names);
+static void blconf_backend_perchannel_xml_wait_writes(BlconfBackendPerchannelXml *xbpx);
+static void blconf_backend_perchannel_xml_report_writes(BlconfBackendPerchannelXml *xbpx,
+                                                        GError **error);
 
-static GNode *blconf_proptree_add_property(GNode *proptree,
+static GNode *blconf_proptree_add_property(BlconfChannel *channel,
                                            const gchar *name,
                                            const GValue *value,
                                            const GValue *system_value,
                                            gboolean locked);
-static BlconfProperty *blconf_proptree_lookup(GNode *proptree,
+static BlconfProperty *blconf_proptree_lookup(BlconfChannel *channel,
                                               const gchar *name);
 static GNode *blconf_proptree_lookup_node(GNode *proptree,
                                           const gchar *name);
-static gboolean blconf_proptree_reset(GNode *proptree,
+static GNode *blconf_proptree_new_child(BlconfChannel *channel,
+                                        GNode *parent,
+                                        const gchar *name,
+                                        gboolean locked);
+static GNode *blconf_proptree_append_child(GNode *parent,
+                                           BlconfProperty *prop);
+static void blconf_proptree_unlink_node(BlconfChannel *channel,
+                                        GNode *node);
+static gboolean blconf_proptree_reset(BlconfChannel *channel,
                                       const gchar *name);
-static void blconf_proptree_destroy(GNode *proptree);
+static void blconf_proptree_destroy(BlconfChannel *channel,
+                                    GNode *proptree);
 static gchar *blconf_proptree_build_propname(GNode *prop_node,
                                              gchar *buf,
                                              gsize buflen);
 
+static BlconfChannel *blconf_channel_new(void);
 static void blconf_channel_destroy(BlconfChannel *channel);
-static void blconf_property_free(BlconfProperty *property);
+static BlconfChannel *blconf_channel_ref(BlconfChannel *channel);
+static void blconf_channel_unref(BlconfChannel *channel);
+static void blconf_channel_release(BlconfChannel *channel);
+static void blconf_channel_clear(BlconfChannel *channel);
+static void blconf_property_free(BlconfArena *arena,
+                                 BlconfProperty *property);
 
 
 G_DEFINE_TYPE_WITH_CODE(BlconfBackendPerchannelXml, blconf_backend_perchannel_xml, G_TYPE_OBJECT,
@@ -225,7 +492,38 @@ blconf_backend_perchannel_xml_init(BlconfBackendPerchannelXml *instance)
 {
     instance->channels = g_hash_table_new_full(g_str_hash, g_str_equal,
                                                (GDestroyNotify)g_free,
-                                                (GDestroyNotify)blconf_channel_destroy);
+                                                (GDestroyNotify)blconf_channel_release);
+    instance->missing_channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       (GDestroyNotify)g_free,
+                                                       NULL);
+    instance->loading_channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       (GDestroyNotify)g_free,
+                                                       NULL);
+    instance->hot_channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                   (GDestroyNotify)g_free,
+                                                   NULL);
+    instance->handoff_channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       (GDestroyNotify)g_free,
+                                                       (GDestroyNotify)g_bytes_unref);
+    instance->channel_index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                    (GDestroyNotify)g_free,
+                                                    NULL);
+    instance->own_writes = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 (GDestroyNotify)g_free,
+                                                 (GDestroyNotify)blconf_file_stamp_free);
+
+    instance->write_buffer = g_string_sized_new(WRITE_BUFFER_SIZE);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_init(&instance->channels_lock);
+    g_cond_init(&instance->channels_cond);
+    g_mutex_init(&instance->writer_lock);
+    g_cond_init(&instance->writer_cond);
+#else
+    instance->channels_lock = g_mutex_new();
+    instance->channels_cond = g_cond_new();
+    instance->writer_lock = g_mutex_new();
+    instance->writer_cond = g_cond_new();
+#endif
 }
 
 static void
@@ -233,15 +531,52 @@ blconf_backend_perchannel_xml_finalize(GObject *obj)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(obj);
 
-    if(xbpx->save_id) {
-        g_source_remove(xbpx->save_id);
-        xbpx->save_id = 0;
-        blconf_backend_perchannel_xml_flush(BLCONF_BACKEND(xbpx), NULL);
-    }
+    /* channels that haven't started loading yet aren't needed now */
+    if(xbpx->preloader)
+        g_thread_pool_free(xbpx->preloader, TRUE, TRUE);
+
+    /* write out whatever is still pending; this also cancels all the
+     * scheduled saves and waits for the writer thread */
+    blconf_backend_perchannel_xml_flush(BLCONF_BACKEND(xbpx), NULL);
+    blconf_backend_perchannel_xml_save_hot_channels(xbpx);
+
+    if(xbpx->evict_id)
+        g_source_remove(xbpx->evict_id);
+    if(xbpx->channel_index_id)
+        g_source_remove(xbpx->channel_index_id);
+
+    if(xbpx->writer)
+        g_thread_pool_free(xbpx->writer, FALSE, TRUE);
+    if(xbpx->write_results_id)
+        g_source_remove(xbpx->write_results_id);
+    blconf_backend_perchannel_xml_report_writes(xbpx, NULL);
+    g_string_free(xbpx->write_buffer, TRUE);
 
     g_hash_table_destroy(xbpx->channels);
+    g_hash_table_destroy(xbpx->missing_channels);
+    g_hash_table_destroy(xbpx->loading_channels);
+    g_hash_table_destroy(xbpx->hot_channels);
+    g_hash_table_destroy(xbpx->handoff_channels);
+    if(xbpx->channel_dirs)
+        g_ptr_array_free(xbpx->channel_dirs, TRUE);
+    g_hash_table_destroy(xbpx->channel_index);
+    g_hash_table_destroy(xbpx->own_writes);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_clear(&xbpx->channels_lock);
+    g_cond_clear(&xbpx->channels_cond);
+    g_mutex_clear(&xbpx->writer_lock);
+    g_cond_clear(&xbpx->writer_cond);
+#else
+    g_mutex_free(xbpx->channels_lock);
+    g_cond_free(xbpx->channels_cond);
+    g_mutex_free(xbpx->writer_lock);
+    g_cond_free(xbpx->writer_cond);
+#endif
 
     g_free(xbpx->config_save_path);
+    g_free(xbpx->cache_save_path);
+    g_free(xbpx->shared_defaults_path);
 
     G_OBJECT_CLASS(blconf_backend_perchannel_xml_parent_class)->finalize(obj);
 }
@@ -253,12 +588,25 @@ blconf_backend_perchannel_xml_backend_init(BlconfBackendInterface *iface)
     iface->set = blconf_backend_perchannel_xml_set;
     iface->get = blconf_backend_perchannel_xml_get;
     iface->get_all = blconf_backend_perchannel_xml_get_all;
+    iface->get_all_paged = blconf_backend_perchannel_xml_get_all_paged;
     iface->exists = blconf_backend_perchannel_xml_exists;
     iface->reset = blconf_backend_perchannel_xml_reset;
     iface->list_channels = blconf_backend_perchannel_xml_list_channels;
     iface->is_property_locked = blconf_backend_perchannel_xml_is_property_locked;
     iface->flush = blconf_backend_perchannel_xml_flush;
     iface->register_property_changed_func = blconf_backend_perchannel_xml_register_property_changed_func;
+    iface->register_properties_reset_func = blconf_backend_perchannel_xml_register_properties_reset_func;
+    iface->set_many = blconf_backend_perchannel_xml_set_many;
+    iface->get_many = blconf_backend_perchannel_xml_get_many;
+    iface->reset_many = blconf_backend_perchannel_xml_reset_many;
+    iface->register_property_changed_full_func = blconf_backend_perchannel_xml_register_property_changed_full_func;
+    iface->preload = blconf_backend_perchannel_xml_preload;
+    iface->get_stats = blconf_backend_perchannel_xml_get_stats;
+    iface->save_state = blconf_backend_perchannel_xml_save_state;
+    iface->restore_state = blconf_backend_perchannel_xml_restore_state;
+    iface->patch_array = blconf_backend_perchannel_xml_patch_array;
+    iface->get_variant = blconf_backend_perchannel_xml_get_variant;
+    iface->get_all_variants = blconf_backend_perchannel_xml_get_all_variants;
 }
 
 static gboolean
@@ -283,21 +631,58 @@ blconf_backend_perchannel_xml_initialize(BlconfBackend *backend,
 
     backend_px->config_save_path = path;
 
+    /* the binary cache is optional; without a cache dir we just always
+     * parse the xml files */
+    path = xfce_resource_save_location(XFCE_RESOURCE_CACHE, CONFIG_DIR_STEM,
+                                       TRUE);
+    if(path && g_file_test(path, G_FILE_TEST_IS_DIR))
+        backend_px->cache_save_path = path;
+    else
+        g_free(path);
+
+    /* appending changes instead of rewriting whole channels is opt-in
+     * for now; an existing journal is replayed either way */
+    backend_px->use_journal = (g_getenv("BLCONFD_JOURNAL")
+                               && strcmp(g_getenv("BLCONFD_JOURNAL"), "0"));
+
+    /* in seconds, mostly so the tests don't have to wait 20 minutes */
+    backend_px->cache_timeout = CACHE_TIMEOUT;
+    if(g_getenv("BLCONFD_CACHE_TIMEOUT")) {
+        gint64 timeout = g_ascii_strtoll(g_getenv("BLCONFD_CACHE_TIMEOUT"),
+                                         NULL, 10);
+
+        if(timeout > 0 && timeout <= CACHE_TIMEOUT / 1000)
+            backend_px->cache_timeout = timeout * 1000;
+    }
+
+    backend_px->shared_defaults_path = blconf_shared_defaults_get_dir();
+
+    backend_px->channel_index_id = g_idle_add(blconf_backend_perchannel_xml_build_channel_index,
+                                              backend_px);
+
     return TRUE;
 }
 
-static gboolean
-blconf_backend_perchannel_xml_set(BlconfBackend *backend,
-                                  const gchar *channel_name,
-                                  const gchar *property,
-                                  const GValue *value,
-                                  GError **error)
+/* finds or loads the channel, creating it if |create| is set (for
+ * the channel a set goes to), and returns a new reference to it.  the
+ * caller still has to take the channel's lock. */
+static BlconfChannel *
+blconf_backend_perchannel_xml_ref_channel(BlconfBackendPerchannelXml *xbpx,
+                                          const gchar *channel_name,
+                                          gboolean create,
+                                          GError **error)
 {
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
-    BlconfProperty *cur_prop;
+    BlconfChannel *channel;
 
-    if(!channel) {
+    channels_mutex_lock(xbpx);
+
+    blconf_backend_perchannel_xml_wait_loading(xbpx, channel_name);
+
+    channel = blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name);
+    if(!channel && !create)
+        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
+                                                             error);
+    else if(!channel) {
         channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
 #ifdef BLCONF_ENABLE_CHECKS
                                                              error);
@@ -313,17 +698,67 @@ blconf_backend_perchannel_xml_set(BlconfBackend *backend,
         }
     }
 
-    cur_prop = blconf_proptree_lookup(channel->properties, property);
-    if(cur_prop) {
-        if(cur_prop->locked) {
-            if(error) {
-                g_set_error(error, BLCONF_ERROR,
-                            BLCONF_ERROR_PERMISSION_DENIED,
-                            _("Permission denied while modifying property \"%s\" on channel \"%s\""),
-                            property, channel_name);
-            }
-            return FALSE;
+    if(channel) {
+        blconf_channel_ref(channel);
+        channel->hits++;
+        blconf_backend_perchannel_xml_note_hot_channel(xbpx, channel);
+    }
+
+    channels_mutex_unlock(xbpx);
+
+    return channel;
+}
+
+static gboolean
+blconf_channel_check_unlocked(BlconfChannel *channel,
+                              const gchar *channel_name,
+                              const gchar *property,
+                              GError **error)
+{
+    if(channel->locked
+       || (channel->locked_props
+           && g_hash_table_lookup(channel->locked_props, property)))
+    {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_PERMISSION_DENIED,
+                        _("Permission denied while modifying property \"%s\" on channel \"%s\""),
+                        property, channel_name);
+        }
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* applies a single set to |channel| without scheduling a save;
+ * |*changed| is set to TRUE if the value was actually different */
+static gboolean
+blconf_backend_perchannel_xml_set_internal(BlconfBackendPerchannelXml *xbpx,
+                                           BlconfChannel *channel,
+                                           const gchar *channel_name,
+                                           const gchar *property,
+                                           const GValue *value,
+                                           gboolean *changed,
+                                           GError **error)
+{
+    BlconfProperty *cur_prop = blconf_proptree_lookup(channel, property);
+
+    if(!blconf_channel_check_unlocked(channel, channel_name, property, error))
+        return FALSE;
+
+    if(!cur_prop && strlen(property) >= MAX_PROP_PATH) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INVALID_PROPERTY,
+                        _("Property names can be at most %d characters long"),
+                        MAX_PROP_PATH - 1);
         }
+        return FALSE;
+    }
+
+    if(cur_prop) {
+        GValue old_value;
+        const GValue *old_effective;
 
         if(_blconf_gvalue_is_equal(G_VALUE_TYPE(&cur_prop->value)
                                    ? &cur_prop->value
@@ -332,25 +767,241 @@ blconf_backend_perchannel_xml_set(BlconfBackend *backend,
             return TRUE;
         }
 
-        if(G_VALUE_TYPE(&cur_prop->value))
-            g_value_unset(&cur_prop->value);
+        /* hang on to the old value until everyone has been told */
+        old_value = cur_prop->value;
+        memset(&cur_prop->value, 0, sizeof(cur_prop->value));
+        blconf_property_drop_wire(cur_prop);
+        old_effective = blconf_property_get_effective_value(cur_prop);
+        if(G_VALUE_TYPE(&old_value))
+            old_effective = &old_value;
+
         g_value_copy(value, g_value_init(&cur_prop->value,
                                          G_VALUE_TYPE(value)));
 
-        if(xbpx->prop_changed_func)
-            xbpx->prop_changed_func(backend, channel_name, property, xbpx->prop_changed_data);
+        blconf_backend_perchannel_xml_notify(xbpx, channel_name, property,
+                                             old_effective, &cur_prop->value);
+        if(G_VALUE_TYPE(&old_value))
+            g_value_unset(&old_value);
     } else {
-        blconf_proptree_add_property(channel->properties, property, value,
+        blconf_proptree_add_property(channel, property, value,
                                      NULL, FALSE);
-        if(xbpx->prop_changed_func)
-            xbpx->prop_changed_func(backend, channel_name, property, xbpx->prop_changed_data);
+        blconf_backend_perchannel_xml_notify(xbpx, channel_name, property,
+                                             NULL, value);
     }
 
-    blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+    blconf_backend_perchannel_xml_journal_record(xbpx, channel, 'S',
+                                                 property, value);
+    *changed = TRUE;
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_set(BlconfBackend *backend,
+                                  const gchar *channel_name,
+                                  const gchar *property,
+                                  const GValue *value,
+                                  GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    gboolean changed = FALSE, ret;
+
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        TRUE, error);
+    channel_write_lock(channel);
+
+    ret = blconf_backend_perchannel_xml_set_internal(xbpx, channel,
+                                                     channel_name, property,
+                                                     value, &changed, error);
+    if(changed)
+        blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+
+    channel_write_unlock(channel);
+    blconf_channel_unref(channel);
+
+    return ret;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_set_many(BlconfBackend *backend,
+                                       const gchar *channel_name,
+                                       GHashTable *properties,
+                                       GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    GHashTableIter iter;
+    gpointer property, value;
+    gboolean changed = FALSE;
+
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        TRUE, error);
+    channel_write_lock(channel);
+
+    /* all or nothing: check every lock before changing anything */
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, NULL)) {
+        if(!blconf_channel_check_unlocked(channel, channel_name, property,
+                                          error))
+        {
+            channel_write_unlock(channel);
+            blconf_channel_unref(channel);
+            return FALSE;
+        }
+    }
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        blconf_backend_perchannel_xml_set_internal(xbpx, channel, channel_name,
+                                                   property, value, &changed,
+                                                   NULL);
+    }
+
+    /* one save for the whole batch */
+    if(changed)
+        blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+
+    channel_write_unlock(channel);
+    blconf_channel_unref(channel);
 
     return TRUE;
 }
 
+/* the array is edited on a copy, so a failed splice leaves it alone
+ * and the old value is still there for the notification; what's saved
+ * is just the splices, if the journal is on */
+static gboolean
+blconf_backend_perchannel_xml_patch_array(BlconfBackend *backend,
+                                          const gchar *channel_name,
+                                          const gchar *property,
+                                          const BlconfArraySplice *splices,
+                                          guint n_splices,
+                                          GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    BlconfProperty *cur_prop;
+    const GValue *effective = NULL, *old_effective;
+    GValue new_value = { 0, }, old_value;
+    gboolean ret = FALSE;
+    guint i;
+
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
+    channel_write_lock(channel);
+
+    if(!blconf_channel_check_unlocked(channel, channel_name, property, error))
+        goto out;
+
+    cur_prop = blconf_proptree_lookup(channel, property);
+    if(cur_prop)
+        effective = blconf_property_get_effective_value(cur_prop);
+    if(!effective) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                        _("Property \"%s\" does not exist on channel \"%s\""),
+                        property, channel_name);
+        }
+        goto out;
+    }
+
+    g_value_copy(effective, g_value_init(&new_value, G_VALUE_TYPE(effective)));
+    if(!_blconf_gvalue_splice(&new_value, splices, n_splices)) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_CONFLICT,
+                        _("Property \"%s\" on channel \"%s\" is not an array that the change fits"),
+                        property, channel_name);
+        }
+        g_value_unset(&new_value);
+        goto out;
+    }
+
+    ret = TRUE;
+    if(_blconf_gvalue_is_equal(effective, &new_value)) {
+        g_value_unset(&new_value);
+        goto out;
+    }
+
+    old_value = cur_prop->value;
+    cur_prop->value = new_value;
+    blconf_property_drop_wire(cur_prop);
+    old_effective = G_VALUE_TYPE(&old_value) ? &old_value : &cur_prop->system_value;
+
+    blconf_backend_perchannel_xml_notify(xbpx, channel_name, property,
+                                         old_effective, &cur_prop->value);
+    if(G_VALUE_TYPE(&old_value))
+        g_value_unset(&old_value);
+
+    for(i = 0; i < n_splices; ++i) {
+        blconf_backend_perchannel_xml_journal_record_splice(xbpx, channel,
+                                                            property,
+                                                            &splices[i]);
+    }
+    blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+
+out:
+    channel_write_unlock(channel);
+    blconf_channel_unref(channel);
+
+    return ret;
+}
+
+/* The GValue reads hand out copies: a reader on another thread may
+ * still be using its value when the main thread replaces it.  The
+ * D-Bus reads go through blconf_property_ref_wire() instead. */
+static void
+blconf_value_snapshot(GValue *dest,
+                      const GValue *src)
+{
+    g_value_copy(src, g_value_init(dest, G_VALUE_TYPE(src)));
+}
+
+/* returns a ref to the property's value as it goes out over D-Bus.
+ * the variant is immutable, so it's built once and shared by every
+ * reader until the value changes; readers only hold the read lock,
+ * so two of them may build it at the same time and one loses. */
+static GVariant *
+blconf_property_ref_wire(BlconfProperty *prop)
+{
+    const GValue *value;
+    GVariant *wire;
+
+    wire = g_atomic_pointer_get(&prop->wire);
+    if(wire)
+        return g_variant_ref(wire);
+
+    value = blconf_property_get_effective_value(prop);
+    if(!value)
+        return NULL;
+
+    wire = _blconf_gvalue_to_gvariant(value);
+    if(!wire)
+        return NULL;
+    g_variant_ref_sink(wire);
+
+    if(!g_atomic_pointer_compare_and_exchange(&prop->wire, NULL, wire)) {
+        g_variant_unref(wire);
+        wire = g_atomic_pointer_get(&prop->wire);
+    }
+
+    return g_variant_ref(wire);
+}
+
+/* must be called with the write lock held whenever the effective
+ * value changes */
+static void
+blconf_property_drop_wire(BlconfProperty *prop)
+{
+    if(prop->wire) {
+        g_variant_unref(prop->wire);
+        prop->wire = NULL;
+    }
+}
+
 static gboolean
 blconf_backend_perchannel_xml_get(BlconfBackend *backend,
                                   const gchar *channel_name,
@@ -359,20 +1010,19 @@ blconf_backend_perchannel_xml_get(BlconfBackend *backend,
                                   GError **error)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    BlconfChannel *channel;
     BlconfProperty *cur_prop;
     GValue *value_to_get = NULL;
 
     TRACE("entering");
 
-    if(!channel) {
-        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
-                                                             error);
-        if(!channel)
-            return FALSE;
-    }
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
+    channel_read_lock(channel);
 
-    cur_prop = blconf_proptree_lookup(channel->properties, property);
+    cur_prop = blconf_proptree_lookup(channel, property);
     if(cur_prop) {
         if(G_VALUE_TYPE(&cur_prop->value))
             value_to_get = &cur_prop->value;
@@ -380,25 +1030,66 @@ blconf_backend_perchannel_xml_get(BlconfBackend *backend,
             value_to_get = &cur_prop->system_value;
     }
 
-    if(!value_to_get) {
-        if(error) {
-            g_set_error(error, BLCONF_ERROR,
-                        BLCONF_ERROR_PROPERTY_NOT_FOUND,
-                        _("Property \"%s\" does not exist on channel \"%s\""),
-                        property, channel_name);
+    if(value_to_get)
+        blconf_value_snapshot(value, value_to_get);
+    else if(error) {
+        g_set_error(error, BLCONF_ERROR,
+                    BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                    _("Property \"%s\" does not exist on channel \"%s\""),
+                    property, channel_name);
+    }
+
+    channel_read_unlock(channel);
+    blconf_channel_unref(channel);
+
+    return value_to_get != NULL;
+}
+
+static GVariant *
+blconf_backend_perchannel_xml_get_variant(BlconfBackend *backend,
+                                          const gchar *channel_name,
+                                          const gchar *property,
+                                          GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    BlconfProperty *cur_prop;
+    GVariant *variant = NULL;
+
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return NULL;
+    channel_read_lock(channel);
+
+    cur_prop = blconf_proptree_lookup(channel, property);
+    if(cur_prop && blconf_property_get_effective_value(cur_prop)) {
+        variant = blconf_property_ref_wire(cur_prop);
+        if(!variant && error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                        _("Values of type \"%s\" can't be sent over D-Bus"),
+                        G_VALUE_TYPE_NAME(blconf_property_get_effective_value(cur_prop)));
         }
-        return FALSE;
+    } else if(error) {
+        g_set_error(error, BLCONF_ERROR,
+                    BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                    _("Property \"%s\" does not exist on channel \"%s\""),
+                    property, channel_name);
     }
 
-    g_value_copy(value_to_get, g_value_init(value, G_VALUE_TYPE(value_to_get)));
+    channel_read_unlock(channel);
+    blconf_channel_unref(channel);
 
-    return TRUE;
+    return variant;
 }
 
+/* fills |props_hash| with GValue copies, or with refs to the wire
+ * variants if |wire| is set */
 static void
 blconf_proptree_node_to_hash_table(GNode *node,
                                    GHashTable *props_hash,
-                                   gchar cur_path[MAX_PROP_PATH])
+                                   gchar cur_path[MAX_PROP_PATH],
+                                   gboolean wire)
 {
     BlconfProperty *prop = node->data;
     GValue *value_to_get = NULL;
@@ -409,13 +1100,19 @@ blconf_proptree_node_to_hash_table(GNode *node,
         value_to_get = &prop->system_value;
 
     if(value_to_get) {
-        GValue *value = g_new0(GValue, 1);
-        gchar *fullprop;
+        gpointer value;
 
-        g_value_copy(value_to_get, g_value_init(value,
-                                                G_VALUE_TYPE(value_to_get)));
-        fullprop = g_strconcat(cur_path, "/", prop->name, NULL);
-        g_hash_table_insert(props_hash, fullprop, value);
+        if(wire)
+            value = blconf_property_ref_wire(prop);
+        else {
+            value = g_new0(GValue, 1);
+            blconf_value_snapshot(value, value_to_get);
+        }
+        if(value) {
+            g_hash_table_insert(props_hash,
+                                g_strconcat(cur_path, "/", prop->name, NULL),
+                                value);
+        }
     }
 
     if(node->children) {
@@ -431,7 +1128,8 @@ blconf_proptree_node_to_hash_table(GNode *node,
             cur;
             cur = g_node_next_sibling(cur))
         {
-            blconf_proptree_node_to_hash_table(cur, props_hash, cur_path);
+            blconf_proptree_node_to_hash_table(cur, props_hash, cur_path,
+                                               wire);
         }
 
         p = strrchr(cur_path, '/');
@@ -441,23 +1139,22 @@ blconf_proptree_node_to_hash_table(GNode *node,
 }
 
 static gboolean
-blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
+blconf_backend_perchannel_xml_collect(BlconfBackendPerchannelXml *xbpx,
                                       const gchar *channel_name,
                                       const gchar *property_base,
                                       GHashTable *properties,
+                                      gboolean wire,
                                       GError **error)
 {
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    BlconfChannel *channel;
     GNode *props_tree;
     gchar cur_path[MAX_PROP_PATH], *p;
 
-    if(!channel) {
-        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
-                                                             error);
-        if(!channel)
-            return FALSE;
-    }
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
+    channel_read_lock(channel);
 
     if(property_base[0] && property_base[1]) {
         /* it's not "" or "/" */
@@ -469,6 +1166,8 @@ blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
                              _("Property \"%s\" does not exist on channel \"%s\""),
                              property_base, channel_name);
             }
+            channel_read_unlock(channel);
+            blconf_channel_unref(channel);
             return FALSE;
         }
 
@@ -480,43 +1179,247 @@ blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
         cur_path[0] = 0;
     }
 
-    blconf_proptree_node_to_hash_table(props_tree, properties, cur_path);
+    blconf_proptree_node_to_hash_table(props_tree, properties, cur_path,
+                                       wire);
+
+    channel_read_unlock(channel);
+    blconf_channel_unref(channel);
 
     return TRUE;
 }
 
 static gboolean
-blconf_backend_perchannel_xml_exists(BlconfBackend *backend,
-                                     const gchar *channel_name,
-                                     const gchar *property,
-                                     gboolean *exists,
-                                     GError **error)
-{
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+blconf_backend_perchannel_xml_get_all(BlconfBackend *backend,
+                                      const gchar *channel_name,
+                                      const gchar *property_base,
+                                      GHashTable *properties,
+                                      GError **error)
+{
+    return blconf_backend_perchannel_xml_collect(BLCONF_BACKEND_PERCHANNEL_XML(backend),
+                                                 channel_name, property_base,
+                                                 properties, FALSE, error);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_get_all_variants(BlconfBackend *backend,
+                                               const gchar *channel_name,
+                                               const gchar *property_base,
+                                               GHashTable *variants,
+                                               GError **error)
+{
+    return blconf_backend_perchannel_xml_collect(BLCONF_BACKEND_PERCHANNEL_XML(backend),
+                                                 channel_name, property_base,
+                                                 variants, TRUE, error);
+}
+
+static void
+blconf_proptree_node_path(GNode *node,
+                          gchar path[MAX_PROP_PATH])
+{
+    BlconfProperty *prop = node->data;
+
+    if(!node->parent) {
+        path[0] = 0;
+        return;
+    }
+
+    blconf_proptree_node_path(node->parent, path);
+    g_strlcat(path, "/", MAX_PROP_PATH);
+    g_strlcat(path, prop->name, MAX_PROP_PATH);
+}
+
+/* pre-order successor of |node|, without leaving the subtree at |root| */
+static GNode *
+blconf_proptree_node_next(GNode *node,
+                          GNode *root)
+{
+    if(node->children)
+        return node->children;
+
+    for(; node != root; node = node->parent) {
+        if(node->next)
+            return node->next;
+    }
+
+    return NULL;
+}
+
+static gboolean
+blconf_channel_get_page(BlconfChannel *channel,
+                        const gchar *channel_name,
+                        const gchar *property_base,
+                        const gchar *cursor,
+                        guint page_size,
+                        GHashTable *properties,
+                        gchar **next_cursor,
+                        GError **error)
+{
+    GNode *props_tree, *node;
+    gchar cur_path[MAX_PROP_PATH];
+    guint n = 0;
+
+    if(property_base[0] && property_base[1]) {
+        props_tree = blconf_proptree_lookup_node(channel->properties,
+                                                 property_base);
+        if(!props_tree) {
+            if(error) {
+                g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                             _("Property \"%s\" does not exist on channel \"%s\""),
+                             property_base, channel_name);
+            }
+            return FALSE;
+        }
+    } else
+        props_tree = channel->properties;
+
+    if(*cursor) {
+        /* the cursor is the last property of the previous page; if it
+         * has gone away since, we can't tell where to pick up again */
+        node = blconf_proptree_lookup_node(channel->properties, cursor);
+        if(!node || (node != props_tree
+                     && !g_node_is_ancestor(props_tree, node)))
+        {
+            if(error) {
+                g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                            _("Property \"%s\" does not exist on channel \"%s\""),
+                            cursor, channel_name);
+            }
+            return FALSE;
+        }
+        node = blconf_proptree_node_next(node, props_tree);
+    } else
+        node = props_tree;
+
+    for(; node; node = blconf_proptree_node_next(node, props_tree)) {
+        BlconfProperty *prop = node->data;
+        GValue *value_to_get = NULL;
+        GValue *value;
+
+        if(G_VALUE_TYPE(&prop->value))
+            value_to_get = &prop->value;
+        else if(G_VALUE_TYPE(&prop->system_value))
+            value_to_get = &prop->system_value;
+        if(!value_to_get || !node->parent)
+            continue;
+
+        if(page_size && n == page_size) {
+            /* there's more: resume after the last one we returned */
+            *next_cursor = g_strdup(cur_path);
+            return TRUE;
+        }
+
+        blconf_proptree_node_path(node, cur_path);
+        value = g_new0(GValue, 1);
+        blconf_value_snapshot(value, value_to_get);
+        g_hash_table_insert(properties, g_strdup(cur_path), value);
+        ++n;
+    }
+
+    *next_cursor = g_strdup("");
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_get_all_paged(BlconfBackend *backend,
+                                            const gchar *channel_name,
+                                            const gchar *property_base,
+                                            const gchar *cursor,
+                                            guint page_size,
+                                            GHashTable *properties,
+                                            gchar **next_cursor,
+                                            GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    gboolean ret;
+
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
+
+    channel_read_lock(channel);
+    ret = blconf_channel_get_page(channel, channel_name, property_base,
+                                  cursor, page_size, properties,
+                                  next_cursor, error);
+    channel_read_unlock(channel);
+    blconf_channel_unref(channel);
+
+    return ret;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_get_many(BlconfBackend *backend,
+                                       const gchar *channel_name,
+                                       const gchar * const *properties,
+                                       GHashTable *values,
+                                       GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    gint i;
+
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
+    channel_read_lock(channel);
+
+    for(i = 0; properties[i]; ++i) {
+        const GValue *value_to_get;
+        GValue *value;
+
+        value_to_get = blconf_property_get_effective_value(blconf_proptree_lookup(channel,
+                                                                                  properties[i]));
+        if(!value_to_get)
+            continue;
+
+        value = g_new0(GValue, 1);
+        blconf_value_snapshot(value, value_to_get);
+        g_hash_table_insert(values, g_strdup(properties[i]), value);
+    }
+
+    channel_read_unlock(channel);
+    blconf_channel_unref(channel);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_exists(BlconfBackend *backend,
+                                     const gchar *channel_name,
+                                     const gchar *property,
+                                     gboolean *exists,
+                                     GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
     BlconfProperty *prop;
 
-    if(!channel) {
-        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE,
 #ifdef BLCONF_ENABLE_CHECKS
-                                                             error);
+                                                        error);
 #else
-                                                             NULL);
+                                                        NULL);
 #endif
-        if(!channel) {
+    if(!channel) {
 #ifdef BLCONF_ENABLE_CHECKS
-            g_clear_error(error);
+        g_clear_error(error);
 #endif
 
-            *exists = FALSE;
-            return TRUE;
-        }
+        *exists = FALSE;
+        return TRUE;
     }
 
-    prop = blconf_proptree_lookup(channel->properties, property);
+    channel_read_lock(channel);
+    prop = blconf_proptree_lookup(channel, property);
     *exists = (prop && (G_VALUE_TYPE(&prop->value)
                         || G_VALUE_TYPE(&prop->system_value))
                ? TRUE : FALSE);
+    channel_read_unlock(channel);
+    blconf_channel_unref(channel);
 
     return TRUE;
 }
@@ -525,8 +1428,43 @@ typedef struct
 {
     BlconfBackendPerchannelXml *xbpx;
     const gchar *channel_name;
+    GPtrArray *reset;  /* collected names, if we can report them at once */
 } PropChangeData;
 
+static void
+prop_change_data_init(PropChangeData *pdata,
+                      BlconfBackendPerchannelXml *xbpx,
+                      const gchar *channel_name)
+{
+    pdata->xbpx = xbpx;
+    pdata->channel_name = channel_name;
+    pdata->reset = xbpx->props_reset_func ? g_ptr_array_new() : NULL;
+}
+
+/* reports everything a recursive reset of |property_base| touched as a
+ * single event */
+static void
+prop_change_data_finish(PropChangeData *pdata,
+                        const gchar *property_base)
+{
+    BlconfBackendPerchannelXml *xbpx = pdata->xbpx;
+
+    if(!pdata->reset)
+        return;
+
+    if(pdata->reset->len && xbpx->props_reset_func) {
+        g_ptr_array_add(pdata->reset, NULL);
+        xbpx->props_reset_func(BLCONF_BACKEND(xbpx), pdata->channel_name,
+                               property_base, (gchar **)pdata->reset->pdata,
+                               xbpx->props_reset_data);
+        g_ptr_array_set_size(pdata->reset, pdata->reset->len - 1);
+    }
+
+    g_ptr_array_foreach(pdata->reset, (GFunc)g_free, NULL);
+    g_ptr_array_free(pdata->reset, TRUE);
+    pdata->reset = NULL;
+}
+
 static gboolean
 nodes_do_prop_reset(GNode *node,
                     gpointer data)
@@ -539,15 +1477,21 @@ nodes_do_prop_reset(GNode *node,
     /* we don't signal if |value| isn't set but |system_value| is,
      * because we're not actually changing anything by definition */
     if(G_VALUE_TYPE(&prop->value)) {
-        g_value_unset(&prop->value);
-        if(pdata->xbpx->prop_changed_func) {
-            pdata->xbpx->prop_changed_func(BLCONF_BACKEND(pdata->xbpx),
-                                           pdata->channel_name,
-                                           blconf_proptree_build_propname(node,
-                                                                          prop_fullname,
-                                                                          sizeof(prop_fullname)),
-                                           pdata->xbpx->prop_changed_data);
+        GValue old_value = prop->value;
+
+        memset(&prop->value, 0, sizeof(prop->value));
+        blconf_property_drop_wire(prop);
+        blconf_proptree_build_propname(node, prop_fullname,
+                                       sizeof(prop_fullname));
+        if(pdata->reset)
+            g_ptr_array_add(pdata->reset, g_strdup(prop_fullname));
+        else {
+            blconf_backend_perchannel_xml_notify(pdata->xbpx,
+                                                 pdata->channel_name,
+                                                 prop_fullname, &old_value,
+                                                 blconf_property_get_effective_value(prop));
         }
+        g_value_unset(&old_value);
     }
 
     return FALSE;
@@ -557,6 +1501,7 @@ static gboolean
 nodes_clean_up(GNode *node,
                gpointer data)
 {
+    BlconfChannel *channel = data;
     BlconfProperty *prop = node->data;
 
     /* clean up dangling nodes in tree without system defaults */
@@ -564,8 +1509,8 @@ nodes_clean_up(GNode *node,
        && !G_VALUE_TYPE(&prop->value)
        && !G_VALUE_TYPE(&prop->system_value)
        && !prop->locked) {
-        g_node_unlink(node);
-        blconf_proptree_destroy(node);
+        blconf_proptree_unlink_node(channel, node);
+        blconf_proptree_destroy(channel, node);
     }
 
     return FALSE;
@@ -581,18 +1526,31 @@ do_reset_channel(BlconfBackend *backend,
     gchar *filename;
     PropChangeData pdata;
 
-    pdata.xbpx = xbpx;
-    pdata.channel_name = channel_name;
+    prop_change_data_init(&pdata, xbpx, channel_name);
     g_node_traverse(properties, G_POST_ORDER, G_TRAVERSE_ALL, -1,
                     nodes_do_prop_reset, &pdata);
+    prop_change_data_finish(&pdata, "/");
 
     /* we could probably prune the existing proptree, or even just leave
      * it as-is, but it's easier to just kill it.  it'll get reloaded later
-     * from the system file (if any) if needed. */
+     * from the system file (if any) if needed.  the files have to be
+     * gone before anyone else can look the channel up again, or a read
+     * on another thread could load the old one right back. */
+    channels_mutex_lock(xbpx);
     g_hash_table_remove(xbpx->channels, channel_name);
+    blconf_backend_perchannel_xml_invalidate_loading(xbpx, channel_name);
 
     /* regardless of whether or not we have a system file, we don't need
-     * the user file anymore */
+     * the user file anymore; make sure a queued write doesn't bring it
+     * back afterwards */
+    blconf_backend_perchannel_xml_wait_writes(xbpx);
+
+    filename = g_strdup_printf(JOURNAL_FILE_FMT, xbpx->config_save_path,
+                               channel_name);
+    if(unlink(filename) && errno != ENOENT)
+        g_warning("Unable to remove journal \"%s\": %s", filename, strerror(errno));
+    g_free(filename);
+
     filename = g_strdup_printf("%s/%s.xml", xbpx->config_save_path, channel_name);
     if(unlink(filename)) {
         if(error) {
@@ -602,32 +1560,71 @@ do_reset_channel(BlconfBackend *backend,
                         channel_name, strerror(errno));
         }
         g_free(filename);
+        channels_mutex_unlock(xbpx);
         return FALSE;
     }
     g_free(filename);
 
+    blconf_backend_perchannel_xml_index_user_channel(xbpx, channel_name, FALSE);
+    channels_mutex_unlock(xbpx);
+
     return TRUE;
 }
 
+/* non-recursively resets |property| without scheduling a save;
+ * returns FALSE if it had no value to reset */
 static gboolean
-blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
-                                    const gchar *channel_name,
-                                    const gchar *property,
-                                    gboolean recursive,
-                                    GError **error)
+blconf_backend_perchannel_xml_reset_internal(BlconfBackendPerchannelXml *xbpx,
+                                             BlconfChannel *channel,
+                                             const gchar *channel_name,
+                                             const gchar *property)
 {
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    BlconfProperty *prop = blconf_proptree_lookup(channel, property);
+    GValue old_value = { 0, };
 
-    if(!channel) {
-        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
-                                                             error);
-        if(!channel)
-            return FALSE;
+    /* the node may not survive the reset */
+    if(prop && G_VALUE_TYPE(&prop->value))
+        g_value_copy(&prop->value, g_value_init(&old_value,
+                                                G_VALUE_TYPE(&prop->value)));
+
+    if(!blconf_proptree_reset(channel, property)) {
+        if(G_VALUE_TYPE(&old_value))
+            g_value_unset(&old_value);
+        return FALSE;
     }
 
+    blconf_backend_perchannel_xml_journal_record(xbpx, channel, 'R',
+                                                 property, NULL);
+
+    /* FIXME: this could fire spuriously if the value was the same
+     * as the system default */
+    prop = blconf_proptree_lookup(channel, property);
+    blconf_backend_perchannel_xml_notify(xbpx, channel_name, property,
+                                         G_VALUE_TYPE(&old_value)
+                                         ? &old_value : NULL,
+                                         blconf_property_get_effective_value(prop));
+    if(G_VALUE_TYPE(&old_value))
+        g_value_unset(&old_value);
+
+    return TRUE;
+}
+
+/* called with the channel's write lock held */
+static gboolean
+blconf_channel_reset(BlconfBackend *backend,
+                     BlconfChannel *channel,
+                     const gchar *channel_name,
+                     const gchar *property,
+                     gboolean recursive,
+                     GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+
     if(!recursive) {
-        if(!blconf_proptree_reset(channel->properties, property)) {
+        if(!blconf_backend_perchannel_xml_reset_internal(xbpx, channel,
+                                                         channel_name,
+                                                         property))
+        {
             if(error) {
                 g_set_error(error, BLCONF_ERROR,
                             BLCONF_ERROR_PROPERTY_NOT_FOUND,
@@ -636,9 +1633,6 @@ blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
             }
             return FALSE;
         }
-
-        if(xbpx->prop_changed_func)  /* FIXME: this could fire spuriously */
-            xbpx->prop_changed_func(backend, channel_name, property, xbpx->prop_changed_data);
     } else {
         GNode *top;
         
@@ -657,14 +1651,18 @@ blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
                 return FALSE;
             }
 
-            pdata.xbpx = xbpx;
-            pdata.channel_name = channel_name;
+            prop_change_data_init(&pdata, xbpx, channel_name);
             g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
                             nodes_do_prop_reset, &pdata);
 
             /* clean up dangling nodes in tree without system defaults */
             g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
-                            nodes_clean_up, NULL);
+                            nodes_clean_up, channel);
+
+            prop_change_data_finish(&pdata, property);
+
+            blconf_backend_perchannel_xml_journal_record(xbpx, channel, 'T',
+                                                         property, NULL);
         } else {
             /* remove the entire channel */
             return do_reset_channel(backend, channel_name,
@@ -678,105 +1676,475 @@ blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
 }
 
 static gboolean
-blconf_backend_perchannel_xml_list_channels(BlconfBackend *backend,
-                                            GSList **channels,
-                                            GError **error)
+blconf_backend_perchannel_xml_reset(BlconfBackend *backend,
+                                    const gchar *channel_name,
+                                    const gchar *property,
+                                    gboolean recursive,
+                                    GError **error)
 {
-    gchar **dirs;
-    gint i;
-    GDir *dir;
-    const gchar *name;
-
-    dirs = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG, CONFIG_DIR_STEM);
-    for(i = 0; dirs[i]; ++i) {
-        dir = g_dir_open(dirs[i], 0, 0);
-        if(!dir)
-            continue;
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+    gboolean ret;
 
-        while((name = g_dir_read_name(dir))) {
-            if(g_str_has_suffix(name, ".xml")) {
-                /* FIXME: maybe validate the files' contents a bit? */
-                /* FIXME: maybe temp use a hash table or gtree to avoid search */
-                gchar *channel_name = g_strndup(name, strlen(name) - 4);
-                if(!g_slist_find_custom(*channels, channel_name,
-                                        (GCompareFunc)strcmp))
-                {
-                    *channels = g_slist_prepend(*channels, channel_name);
-                } else
-                    g_free(channel_name);
-            }
-        }
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
 
-        g_dir_close(dir);
-    }
-    g_strfreev(dirs);
+    channel_write_lock(channel);
+    ret = blconf_channel_reset(backend, channel, channel_name, property,
+                               recursive, error);
+    channel_write_unlock(channel);
+    blconf_channel_unref(channel);
 
-    return TRUE;
+    return ret;
 }
 
 static gboolean
-blconf_backend_perchannel_xml_is_property_locked(BlconfBackend *backend,
-                                                 const gchar *channel_name,
-                                                 const gchar *property,
-                                                 gboolean *locked,
-                                                 GError **error)
+blconf_backend_perchannel_xml_reset_many(BlconfBackend *backend,
+                                         const gchar *channel_name,
+                                         const gchar * const *properties,
+                                         GError **error)
 {
     BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
-    BlconfProperty *prop = NULL;
+    BlconfChannel *channel;
+    gboolean changed = FALSE;
+    gint i;
 
-    if(!channel) {
-        channel = blconf_backend_perchannel_xml_load_channel(xbpx, channel_name,
-                                                             error);
-        if(!channel)
-            return FALSE;
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
+    channel_write_lock(channel);
+
+    for(i = 0; properties[i]; ++i) {
+        if(blconf_backend_perchannel_xml_reset_internal(xbpx, channel,
+                                                        channel_name,
+                                                        properties[i]))
+        {
+            changed = TRUE;
+        }
     }
 
-    if(!channel->locked)
-        prop = blconf_proptree_lookup(channel->properties, property);
-    *locked = (channel->locked || (prop ? prop->locked : FALSE));
+    if(changed)
+        blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+
+    channel_write_unlock(channel);
+    blconf_channel_unref(channel);
+
     return TRUE;
 }
 
+/* The channel index knows which channels have files in which config
+ * directories, so ListChannels doesn't have to read them all every
+ * time.  It is built from an idle callback once the main loop runs
+ * (never before blconfd forks, as the monitors may start a thread) and
+ * kept current by a GFileMonitor on each directory.  If a directory
+ * can't be monitored, the index is rescanned on every call instead. */
+
+typedef struct
+{
+    gchar *path;
+    GFileMonitor *monitor;
+    GHashTable *names;  /* channels with a file in |path| */
+} ChannelDir;
+
 static void
-blconf_backend_perchannel_xml_flush_get_dirty(gpointer key,
-                                              gpointer value,
-                                              gpointer user_data)
+blconf_channel_dir_set_name(BlconfBackendPerchannelXml *xbpx,
+                            ChannelDir *cdir,
+                            const gchar *channel_name,
+                            gboolean exists)
 {
-    BlconfChannel *channel = value;
-    GSList **dirty = user_data;
-    if(channel->dirty)
-        *dirty = g_slist_prepend(*dirty, key);
+    guint count;
+
+    if(exists == (g_hash_table_lookup(cdir->names, channel_name) != NULL))
+        return;
+
+    count = GPOINTER_TO_UINT(g_hash_table_lookup(xbpx->channel_index,
+                                                 channel_name));
+    if(exists) {
+        g_hash_table_insert(cdir->names, g_strdup(channel_name),
+                            GUINT_TO_POINTER(TRUE));
+        g_hash_table_insert(xbpx->channel_index, g_strdup(channel_name),
+                            GUINT_TO_POINTER(count + 1));
+
+        /* if somebody was waiting for it, it's there now */
+        blconf_backend_perchannel_xml_clear_channel_missing(xbpx, channel_name);
+    } else {
+        g_hash_table_remove(cdir->names, channel_name);
+        if(count > 1) {
+            g_hash_table_insert(xbpx->channel_index, g_strdup(channel_name),
+                                GUINT_TO_POINTER(count - 1));
+        } else
+            g_hash_table_remove(xbpx->channel_index, channel_name);
+    }
 }
 
-static gboolean
-blconf_backend_perchannel_xml_flush(BlconfBackend *backend,
-                                    GError **error)
+static void
+blconf_channel_dir_scan(BlconfBackendPerchannelXml *xbpx,
+                        ChannelDir *cdir)
 {
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
-    GSList *dirty = NULL, *l;
+    GHashTableIter iter;
+    gpointer key;
+    GSList *old_names = NULL, *l;
+    const gchar *name;
+    GDir *dir;
 
-    g_hash_table_foreach(xbpx->channels, blconf_backend_perchannel_xml_flush_get_dirty, &dirty);
+    g_hash_table_iter_init(&iter, cdir->names);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+        old_names = g_slist_prepend(old_names, g_strdup(key));
+    for(l = old_names; l; l = l->next) {
+        blconf_channel_dir_set_name(xbpx, cdir, l->data, FALSE);
+        g_free(l->data);
+    }
+    g_slist_free(old_names);
 
-    for(l = dirty; l; l = l->next)
-        blconf_backend_perchannel_xml_flush_channel(xbpx, l->data, error);
-    g_slist_free(dirty);
+    dir = g_dir_open(cdir->path, 0, 0);
+    if(!dir)
+        return;
 
-    TRACE("exiting, flushed all channels");
+    while((name = g_dir_read_name(dir))) {
+        if(g_str_has_suffix(name, ".xml")) {
+            /* FIXME: maybe validate the files' contents a bit? */
+            gchar *channel_name = g_strndup(name, strlen(name) - 4);
+            blconf_channel_dir_set_name(xbpx, cdir, channel_name, TRUE);
+            g_free(channel_name);
+        }
+    }
 
-    return TRUE;
+    g_dir_close(dir);
 }
 
 static void
-blconf_backend_perchannel_xml_register_property_changed_func(BlconfBackend *backend,
-                                                             BlconfPropertyChangedFunc func,
-                                                             gpointer user_data)
+blconf_channel_dir_changed(GFileMonitor *monitor,
+                           GFile *file,
+                           GFile *other_file,
+                           GFileMonitorEvent event,
+                           gpointer user_data)
 {
-    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfBackendPerchannelXml *xbpx = user_data;
+    ChannelDir *cdir = g_object_get_data(G_OBJECT(monitor), "blconf-channel-dir");
+    gchar *basename, *filename, *channel_name;
+
+    if(event != G_FILE_MONITOR_EVENT_CREATED
+       && event != G_FILE_MONITOR_EVENT_DELETED
+       && event != G_FILE_MONITOR_EVENT_MOVED
+       && event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+    {
+        return;
+    }
 
-    xbpx->prop_changed_func = func;
-    xbpx->prop_changed_data = user_data;
-}
+    basename = g_file_get_basename(file);
+    if(!g_str_has_suffix(basename, ".xml")) {
+        g_free(basename);
+        return;
+    }
+
+    /* the event may be stale by now; just look at what's there */
+    filename = g_build_filename(cdir->path, basename, NULL);
+    channel_name = g_strndup(basename, strlen(basename) - 4);
+    channels_mutex_lock(xbpx);
+    blconf_channel_dir_set_name(xbpx, cdir, channel_name,
+                                g_file_test(filename, G_FILE_TEST_EXISTS));
+    blconf_backend_perchannel_xml_file_changed(xbpx, filename, channel_name);
+    channels_mutex_unlock(xbpx);
+
+    g_free(channel_name);
+    g_free(filename);
+    g_free(basename);
+}
+
+static void
+blconf_channel_dir_free(ChannelDir *cdir)
+{
+    if(cdir->monitor) {
+        g_signal_handlers_disconnect_matched(cdir->monitor, G_SIGNAL_MATCH_FUNC,
+                                             0, 0, NULL,
+                                             blconf_channel_dir_changed, NULL);
+        g_file_monitor_cancel(cdir->monitor);
+        g_object_unref(cdir->monitor);
+    }
+    g_hash_table_destroy(cdir->names);
+    g_free(cdir->path);
+    g_slice_free(ChannelDir, cdir);
+}
+
+static void
+blconf_backend_perchannel_xml_add_channel_dir(BlconfBackendPerchannelXml *xbpx,
+                                              const gchar *path)
+{
+    ChannelDir *cdir;
+    GFile *file;
+    GError *error = NULL;
+    gchar *canonical;
+    guint i;
+
+    canonical = g_strdup(path);
+    while(strlen(canonical) > 1 && g_str_has_suffix(canonical, "/"))
+        canonical[strlen(canonical) - 1] = 0;
+
+    for(i = 0; i < xbpx->channel_dirs->len; ++i) {
+        cdir = g_ptr_array_index(xbpx->channel_dirs, i);
+        if(!strcmp(cdir->path, canonical)) {
+            g_free(canonical);
+            return;
+        }
+    }
+
+    cdir = g_slice_new0(ChannelDir);
+    cdir->path = canonical;
+    cdir->names = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        (GDestroyNotify)g_free, NULL);
+    g_ptr_array_add(xbpx->channel_dirs, cdir);
+
+    file = g_file_new_for_path(cdir->path);
+    cdir->monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE,
+                                             NULL, &error);
+    g_object_unref(file);
+
+    if(cdir->monitor) {
+        g_object_set_data(G_OBJECT(cdir->monitor), "blconf-channel-dir", cdir);
+        g_signal_connect(cdir->monitor, "changed",
+                         G_CALLBACK(blconf_channel_dir_changed), xbpx);
+    } else {
+        DBG("Unable to monitor \"%s\": %s", cdir->path, error->message);
+        g_error_free(error);
+        xbpx->channel_index_live = FALSE;
+    }
+
+    blconf_channel_dir_scan(xbpx, cdir);
+}
+
+static void
+blconf_backend_perchannel_xml_ensure_channel_index(BlconfBackendPerchannelXml *xbpx)
+{
+    gchar **dirs;
+    guint i;
+
+    if(xbpx->channel_dirs)
+        return;
+
+    if(xbpx->channel_index_id) {
+        g_source_remove(xbpx->channel_index_id);
+        xbpx->channel_index_id = 0;
+    }
+
+    xbpx->channel_dirs = g_ptr_array_new_with_free_func((GDestroyNotify)blconf_channel_dir_free);
+    xbpx->channel_index_live = TRUE;
+
+    /* the user's directory comes first, see _index_user_channel() */
+    blconf_backend_perchannel_xml_add_channel_dir(xbpx, xbpx->config_save_path);
+
+    dirs = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG, CONFIG_DIR_STEM);
+    for(i = 0; dirs && dirs[i]; ++i)
+        blconf_backend_perchannel_xml_add_channel_dir(xbpx, dirs[i]);
+    g_strfreev(dirs);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_build_channel_index(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+
+    channels_mutex_lock(xbpx);
+    xbpx->channel_index_id = 0;
+    blconf_backend_perchannel_xml_ensure_channel_index(xbpx);
+    channels_mutex_unlock(xbpx);
+
+    return FALSE;
+}
+
+/* we know about our own writes before the monitor does */
+static void
+blconf_backend_perchannel_xml_index_user_channel(BlconfBackendPerchannelXml *xbpx,
+                                                 const gchar *channel_name,
+                                                 gboolean exists)
+{
+    if(!xbpx->channel_dirs)
+        return;
+
+    blconf_channel_dir_set_name(xbpx, g_ptr_array_index(xbpx->channel_dirs, 0),
+                                channel_name, exists);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_list_channels(BlconfBackend *backend,
+                                            GSList **channels,
+                                            GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GHashTableIter iter;
+    gpointer key;
+
+    channels_mutex_lock(xbpx);
+
+    blconf_backend_perchannel_xml_ensure_channel_index(xbpx);
+
+    if(!xbpx->channel_index_live) {
+        guint i;
+
+        for(i = 0; i < xbpx->channel_dirs->len; ++i) {
+            blconf_channel_dir_scan(xbpx, g_ptr_array_index(xbpx->channel_dirs,
+                                                            i));
+        }
+    }
+
+    g_hash_table_iter_init(&iter, xbpx->channel_index);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+        *channels = g_slist_prepend(*channels, g_strdup(key));
+
+    channels_mutex_unlock(xbpx);
+
+    return TRUE;
+}
+
+/* Locks only ever come from system files, so they can only change
+ * when a channel is (re)read.  Collecting them then means checking a
+ * write against them is a flag test for channels with no locked
+ * properties, which is nearly all of them. */
+static void
+blconf_channel_update_lock_summary(BlconfChannel *channel)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    if(channel->locked_props) {
+        g_hash_table_destroy(channel->locked_props);
+        channel->locked_props = NULL;
+    }
+
+    if(channel->locked)
+        return;
+
+    g_hash_table_iter_init(&iter, channel->prop_index);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        BlconfProperty *prop = value;
+
+        if(!prop->locked)
+            continue;
+
+        if(!channel->locked_props) {
+            channel->locked_props = g_hash_table_new_full(g_str_hash,
+                                                          g_str_equal,
+                                                          (GDestroyNotify)g_free,
+                                                          NULL);
+        }
+        g_hash_table_insert(channel->locked_props, g_strdup(key),
+                            GINT_TO_POINTER(TRUE));
+    }
+}
+
+static gboolean
+blconf_backend_perchannel_xml_is_property_locked(BlconfBackend *backend,
+                                                 const gchar *channel_name,
+                                                 const gchar *property,
+                                                 gboolean *locked,
+                                                 GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    BlconfChannel *channel;
+
+    channel = blconf_backend_perchannel_xml_ref_channel(xbpx, channel_name,
+                                                        FALSE, error);
+    if(!channel)
+        return FALSE;
+
+    channel_read_lock(channel);
+    *locked = !blconf_channel_check_unlocked(channel, channel_name, property,
+                                             NULL);
+    channel_read_unlock(channel);
+    blconf_channel_unref(channel);
+
+    return TRUE;
+}
+
+static void
+blconf_backend_perchannel_xml_flush_get_dirty(gpointer key,
+                                              gpointer value,
+                                              gpointer user_data)
+{
+    BlconfChannel *channel = value;
+    GSList **dirty = user_data;
+    if(channel->dirty)
+        *dirty = g_slist_prepend(*dirty, key);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_flush(BlconfBackend *backend,
+                                    GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GSList *dirty = NULL;
+
+    channels_mutex_lock(xbpx);
+    g_hash_table_foreach(xbpx->channels, blconf_backend_perchannel_xml_flush_get_dirty, &dirty);
+    channels_mutex_unlock(xbpx);
+
+    /* all in one group, so this takes about one sync */
+    blconf_backend_perchannel_xml_flush_channels(xbpx, dirty);
+    g_slist_free(dirty);
+
+    /* callers rely on everything being on disk when we return */
+    blconf_backend_perchannel_xml_wait_writes(xbpx);
+    blconf_backend_perchannel_xml_report_writes(xbpx, error);
+
+    TRACE("exiting, flushed all channels");
+
+    return TRUE;
+}
+
+static void
+blconf_backend_perchannel_xml_register_property_changed_func(BlconfBackend *backend,
+                                                             BlconfPropertyChangedFunc func,
+                                                             gpointer user_data)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+
+    xbpx->prop_changed_func = func;
+    xbpx->prop_changed_data = user_data;
+}
+
+static void
+blconf_backend_perchannel_xml_register_properties_reset_func(BlconfBackend *backend,
+                                                             BlconfPropertiesResetFunc func,
+                                                             gpointer user_data)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+
+    xbpx->props_reset_func = func;
+    xbpx->props_reset_data = user_data;
+}
+
+static void
+blconf_backend_perchannel_xml_register_property_changed_full_func(BlconfBackend *backend,
+                                                                  BlconfPropertyChangedFullFunc func,
+                                                                  gpointer user_data)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+
+    xbpx->prop_changed_full_func = func;
+    xbpx->prop_changed_full_data = user_data;
+}
+
+/* tells both kinds of listeners that |property| went from |old_value|
+ * to |new_value|, either of which may be NULL */
+static void
+blconf_backend_perchannel_xml_notify(BlconfBackendPerchannelXml *xbpx,
+                                     const gchar *channel_name,
+                                     const gchar *property,
+                                     const GValue *old_value,
+                                     const GValue *new_value)
+{
+    if(xbpx->prop_changed_full_func) {
+        xbpx->prop_changed_full_func(BLCONF_BACKEND(xbpx), channel_name,
+                                     property, old_value, new_value,
+                                     xbpx->prop_changed_full_data);
+    }
+    if(xbpx->prop_changed_func) {
+        xbpx->prop_changed_func(BLCONF_BACKEND(xbpx), channel_name, property,
+                                xbpx->prop_changed_data);
+    }
+}
 
 
 
@@ -784,69 +2152,72 @@ static GNode *
 blconf_proptree_lookup_node(GNode *proptree,
                             const gchar *name)
 {
-    GNode *found_node = NULL;
-    gchar **parts;
-    GNode *parent, *node;
-    gint i;
+    GNode *node = proptree;
+    BlconfProperty *prop;
+    gchar tmp[MAX_PROP_PATH];
+    gchar *segment, *p;
+    gsize len;
 
     g_return_val_if_fail(PROP_NAME_IS_VALID(name), NULL);
 
-    parts = g_strsplit(name+1, "/", -1);
-    parent = proptree;
+    /* nothing that long can be in the tree, and a truncated copy
+     * would find some other property */
+    len = strlen(name);
+    if(len >= MAX_PROP_PATH)
+        return NULL;
 
-    for(i = 0; parts[i]; ++i) {
-        for(node = g_node_first_child(parent);
-            node;
-            node = g_node_next_sibling(node))
-        {
-            if(!strcmp(((BlconfProperty *)node->data)->name, parts[i])) {
-                if(!parts[i+1])
-                    found_node = node;
-                else
-                    parent = node;
-                break;
-            }
-        }
+    /* walk a stack copy of the path, terminating each segment in
+     * place so it can be used as a key without allocating.  this runs
+     * on the reader threads too, so it must not go near the string
+     * pool and its lock */
+    memcpy(tmp, name + 1, len);
 
-        if(found_node || !node)
-            break;
-    }
+    for(segment = tmp; node && segment; segment = p) {
+        p = strchr(segment, '/');
+        if(p)
+            *p++ = 0;
 
-    g_strfreev(parts);
+        prop = node->data;
+        if(!prop->children)
+            return NULL;
+
+        node = g_hash_table_lookup(prop->children, segment);
+    }
 
-    return found_node;
+    return node;
 }
 
 static BlconfProperty *
-blconf_proptree_lookup(GNode *proptree,
+blconf_proptree_lookup(BlconfChannel *channel,
                        const gchar *name)
 {
-    GNode *node;
-    BlconfProperty *prop = NULL;
-
-    node = blconf_proptree_lookup_node(proptree, name);
-    if(node)
-        prop = node->data;
+    g_return_val_if_fail(PROP_NAME_IS_VALID(name), NULL);
 
-    return prop;
+    return g_hash_table_lookup(channel->prop_index, name);
 }
 
 /* here we assume the entry does not already exist */
 static GNode *
-blconf_proptree_add_property(GNode *proptree,
+blconf_proptree_add_property(BlconfChannel *channel,
                              const gchar *name,
                              const GValue *value,
                              const GValue *system_value,
                              gboolean locked)
 {
-    GNode *parent = NULL;
+    GNode *proptree = channel->properties;
+    GNode *parent = NULL, *node;
     gchar tmp[MAX_PROP_PATH];
     gchar *p;
     BlconfProperty *prop;
+    gsize len;
 
     g_return_val_if_fail(PROP_NAME_IS_VALID(name), NULL);
 
-    g_strlcpy(tmp, name, MAX_PROP_PATH);
+    len = strlen(name);
+    if(len >= MAX_PROP_PATH)
+        return NULL;
+
+    memcpy(tmp, name, len + 1);
     p = g_strrstr(tmp, "/");
     if(p == tmp)
         parent = proptree;
@@ -854,25 +2225,100 @@ blconf_proptree_add_property(GNode *proptree,
         *p = 0;
         parent = blconf_proptree_lookup_node(proptree, tmp);
         if(!parent)
-            parent = blconf_proptree_add_property(proptree, tmp, NULL, NULL, FALSE);
+            parent = blconf_proptree_add_property(channel, tmp, NULL, NULL, FALSE);
     }
 
-    prop = g_slice_new0(BlconfProperty);
-    prop->name = g_strdup(strrchr(name, '/')+1);
+    node = blconf_proptree_new_child(channel, parent, name, locked);
     if(value) {
+        prop = node->data;
         g_value_init(&prop->value, G_VALUE_TYPE(value));
         g_value_copy(value, &prop->value);
     }
+
+    return node;
+}
+
+/* creates an empty property named |name| (its full path) under |parent| */
+static GNode *
+blconf_proptree_new_child(BlconfChannel *channel,
+                          GNode *parent,
+                          const gchar *name,
+                          gboolean locked)
+{
+    BlconfProperty *prop;
+
+    prop = blconf_arena_new0(channel->arena, BlconfProperty);
+    prop->name = blconf_string_pool_ref(strrchr(name, '/')+1);
     prop->locked = locked;
 
-    return g_node_append_data(parent, prop);
+    g_hash_table_insert(channel->prop_index,
+                        blconf_arena_strdup(channel->arena, name), prop);
+
+    return blconf_proptree_append_child(parent, prop);
+}
+
+static GNode *
+blconf_proptree_append_child(GNode *parent,
+                             BlconfProperty *prop)
+{
+    BlconfProperty *parent_prop = parent->data;
+    GNode *node = g_node_append_data(parent, prop);
+
+    /* the key is the child's pooled name, which stays referenced for
+     * as long as the child is in the index; it's compared by content,
+     * so looking a segment up doesn't need the pool */
+    if(!parent_prop->children)
+        parent_prop->children = g_hash_table_new(g_str_hash, g_str_equal);
+    g_hash_table_insert(parent_prop->children, (gpointer)prop->name, node);
+
+    return node;
+}
+
+static gboolean
+proptree_unindex_node(GNode *node,
+                      gpointer data)
+{
+    BlconfChannel *channel = data;
+    gchar prop_fullname[MAX_PROP_PATH];
+    gpointer key;
+
+    blconf_proptree_build_propname(node, prop_fullname, sizeof(prop_fullname));
+    if(g_hash_table_lookup_extended(channel->prop_index, prop_fullname,
+                                    &key, NULL))
+    {
+        g_hash_table_remove(channel->prop_index, prop_fullname);
+        blconf_arena_free_string(channel->arena, key);
+    }
+
+    return FALSE;
+}
+
+static void
+blconf_proptree_unlink_node(BlconfChannel *channel,
+                            GNode *node)
+{
+    /* this has to happen while the node is still attached, since the
+     * full names are built by walking up to the root */
+    g_node_traverse(node, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+                    proptree_unindex_node, channel);
+
+    if(node->parent) {
+        BlconfProperty *parent_prop = node->parent->data;
+
+        if(parent_prop->children) {
+            g_hash_table_remove(parent_prop->children,
+                                ((BlconfProperty *)node->data)->name);
+        }
+    }
+
+    g_node_unlink(node);
 }
 
 static gboolean
-blconf_proptree_reset(GNode *proptree,
+blconf_proptree_reset(BlconfChannel *channel,
                       const gchar *name)
 {
-    GNode *node = blconf_proptree_lookup_node(proptree, name);
+    GNode *node = blconf_proptree_lookup_node(channel->properties, name);
 
     if(node) {
         BlconfProperty *prop = node->data;
@@ -882,11 +2328,12 @@ blconf_proptree_reset(GNode *proptree,
                 /* don't remove the children; just blank out the value */
                 DBG("unsetting value at \"%s\"", prop->name);
                 g_value_unset(&prop->value);
+                blconf_property_drop_wire(prop);
             } else {
                 GNode *parent = node->parent;
 
-                g_node_unlink(node);
-                blconf_proptree_destroy(node);
+                blconf_proptree_unlink_node(channel, node);
+                blconf_proptree_destroy(channel, node);
 
                 /* remove parents without values until we find the root node or 
                  * a parent with a value or any children */
@@ -901,8 +2348,8 @@ blconf_proptree_reset(GNode *proptree,
 
                         DBG("unlinking node at \"%s\"", prop->name);
 
-                        g_node_unlink(tmp);
-                        blconf_proptree_destroy(tmp);
+                        blconf_proptree_unlink_node(channel, tmp);
+                        blconf_proptree_destroy(channel, tmp);
                     } else
                         parent = NULL;
                 }
@@ -919,16 +2366,17 @@ static gboolean
 proptree_free_node_data(GNode *node,
                         gpointer data)
 {
-    blconf_property_free((BlconfProperty *)node->data);
+    blconf_property_free(data, (BlconfProperty *)node->data);
     return FALSE;
 }
 
 static void
-blconf_proptree_destroy(GNode *proptree)
+blconf_proptree_destroy(BlconfChannel *channel,
+                        GNode *proptree)
 {
     if(G_LIKELY(proptree)) {
         g_node_traverse(proptree, G_IN_ORDER, G_TRAVERSE_ALL, -1,
-                        proptree_free_node_data, NULL);
+                        proptree_free_node_data, channel->arena);
         g_node_destroy(proptree);
     }
 }
@@ -945,7 +2393,7 @@ blconf_proptree_build_propname(GNode *prop_node,
         BlconfProperty *prop = cur->data;
         if(!prop->name[1])  /* we've hit "/" */
             break;
-        components = g_slist_prepend(components, prop->name);
+        components = g_slist_prepend(components, (gpointer)prop->name);
     }
 
     /* FIXME: optimise */
@@ -962,45 +2410,285 @@ blconf_proptree_build_propname(GNode *prop_node,
 
 
 
+static BlconfChannel *
+blconf_channel_new(void)
+{
+    BlconfChannel *channel;
+    BlconfProperty *prop;
+
+    channel = g_slice_new0(BlconfChannel);
+    channel->ref_count = 1;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_rw_lock_init(&channel->lock);
+#else
+    g_static_rw_lock_init(&channel->lock);
+#endif
+    channel->last_flush = -1;
+    channel->arena = blconf_arena_new();
+    /* keys live in the arena */
+    channel->prop_index = g_hash_table_new(g_str_hash, g_str_equal);
+
+    prop = blconf_arena_new0(channel->arena, BlconfProperty);
+    prop->name = blconf_string_pool_ref("/");
+    channel->properties = g_node_new(prop);
+
+    return channel;
+}
+
+/* drops all properties, leaving an empty root node behind */
+static void
+blconf_channel_clear(BlconfChannel *channel)
+{
+    BlconfProperty *prop;
+
+    g_hash_table_remove_all(channel->prop_index);
+    blconf_proptree_destroy(channel, channel->properties);
+
+    /* everything that was in the arena is gone now, so start over
+     * with a fresh one rather than keeping the free lists around */
+    blconf_arena_destroy(channel->arena);
+    channel->arena = blconf_arena_new();
+
+    prop = blconf_arena_new0(channel->arena, BlconfProperty);
+    prop->name = blconf_string_pool_ref("/");
+    channel->properties = g_node_new(prop);
+}
+
 static void
 blconf_channel_destroy(BlconfChannel *channel)
 {
-    blconf_proptree_destroy(channel->properties);
+    g_free(channel->name);
+    if(channel->journal)
+        g_string_free(channel->journal, TRUE);
+    if(channel->locked_props)
+        g_hash_table_destroy(channel->locked_props);
+
+    g_hash_table_destroy(channel->prop_index);
+    blconf_proptree_destroy(channel, channel->properties);
+    blconf_arena_destroy(channel->arena);
+    /* only now that nothing points into it any more */
+    if(channel->shared_defaults)
+        g_mapped_file_unref(channel->shared_defaults);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_rw_lock_clear(&channel->lock);
+#else
+    g_static_rw_lock_free(&channel->lock);
+#endif
     g_slice_free(BlconfChannel, channel);
 }
 
+static BlconfChannel *
+blconf_channel_ref(BlconfChannel *channel)
+{
+    g_atomic_int_inc(&channel->ref_count);
+    return channel;
+}
+
+/* the last ref may be dropped by a reader on another thread, after
+ * the channel was evicted or replaced by a reload */
+static void
+blconf_channel_unref(BlconfChannel *channel)
+{
+    if(g_atomic_int_dec_and_test(&channel->ref_count))
+        blconf_channel_destroy(channel);
+}
+
+/* drops the ref held by |xbpx->channels|, along with the main loop
+ * sources that point at the channel.  only called with the channel
+ * unpublished, on the main thread. */
 static void
-blconf_property_free(BlconfProperty *property)
+blconf_channel_release(BlconfChannel *channel)
 {
-    g_free(property->name);
+    if(channel->save_id) {
+        g_source_remove(channel->save_id);
+        channel->save_id = 0;
+    }
+    if(channel->reload_id) {
+        g_source_remove(channel->reload_id);
+        channel->reload_id = 0;
+    }
+
+    blconf_channel_unref(channel);
+}
+
+static void
+blconf_property_free(BlconfArena *arena,
+                     BlconfProperty *property)
+{
+    blconf_string_pool_unref(property->name);
+    if(property->children)
+        g_hash_table_destroy(property->children);
     if(G_VALUE_TYPE(&property->value))
         g_value_unset(&property->value);
     if(G_VALUE_TYPE(&property->system_value))
         g_value_unset(&property->system_value);
-    g_slice_free(BlconfProperty, property);
+    blconf_property_drop_wire(property);
+    blconf_arena_delete(arena, BlconfProperty, property);
 }
 
-static gboolean
-blconf_backend_perchannel_xml_save_timeout(gpointer data)
+typedef struct
 {
-    BLCONF_BACKEND_PERCHANNEL_XML(data)->save_id = 0;
-    blconf_backend_perchannel_xml_flush(BLCONF_BACKEND(data), NULL);
-
-    return FALSE;
-}
+    gint64 horizon;
+    GSList *channel_names;
+} DueSaves;
 
 static void
-blconf_backend_perchannel_xml_schedule_save(BlconfBackendPerchannelXml *xbpx,
-                                            BlconfChannel *channel)
+blconf_backend_perchannel_xml_get_due_saves(gpointer key,
+                                            gpointer value,
+                                            gpointer user_data)
 {
-    if(xbpx->save_id)
-        g_source_remove(xbpx->save_id);
+    BlconfChannel *channel = value;
+    DueSaves *due = user_data;
 
-    channel->dirty = TRUE;
+    if(channel->save_id && channel->save_due <= due->horizon)
+        due->channel_names = g_slist_prepend(due->channel_names, key);
+}
+
+/* channels whose own save would come up within GROUP_COMMIT_WINDOW
+ * anyway are written along with this one, in the same group commit */
+static gboolean
+blconf_backend_perchannel_xml_save_timeout(gpointer data)
+{
+    BlconfChannel *channel = data;
+    BlconfBackendPerchannelXml *xbpx = channel->xbpx;
+    DueSaves due;
+
+    channel->save_id = 0;
+
+    due.horizon = g_get_monotonic_time() + (gint64)GROUP_COMMIT_WINDOW * G_USEC_PER_SEC;
+    due.channel_names = g_slist_prepend(NULL, channel->name);
+
+    channels_mutex_lock(xbpx);
+    g_hash_table_foreach(xbpx->channels,
+                         blconf_backend_perchannel_xml_get_due_saves, &due);
+    channels_mutex_unlock(xbpx);
+
+    blconf_backend_perchannel_xml_flush_channels(xbpx, due.channel_names);
+    g_slist_free(due.channel_names);
+
+    return FALSE;
+}
+
+/* Every change pushes the channel's save back by WRITE_TIMEOUT, so a
+ * burst of changes ends up in a single write.  A channel that keeps
+ * changing is still written at most MAX_WRITE_DELAY after its first
+ * unsaved change.  Each channel is written on its own schedule, except
+ * that saves falling close together share a group commit. */
+static void
+blconf_backend_perchannel_xml_schedule_save(BlconfBackendPerchannelXml *xbpx,
+                                            BlconfChannel *channel)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 deadline;
+    guint timeout;
+
+    if(channel->save_id)
+        g_source_remove(channel->save_id);
+
+    if(!channel->dirty) {
+        channel->dirty = TRUE;
+        channel->dirty_since = now;
+    }
+
+    deadline = channel->dirty_since + (gint64)MAX_WRITE_DELAY * G_USEC_PER_SEC;
+    if(now + (gint64)WRITE_TIMEOUT * G_USEC_PER_SEC <= deadline)
+        timeout = WRITE_TIMEOUT * 1000;
+    else
+        timeout = deadline > now ? (deadline - now) / 1000 : 0;
+
+    channel->save_due = now + (gint64)timeout * 1000;
+    channel->save_id = g_timeout_add(timeout,
+                                     blconf_backend_perchannel_xml_save_timeout,
+                                     channel);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_channel_is_idle(gpointer key,
+                                              gpointer value,
+                                              gpointer data)
+{
+    BlconfChannel *channel = value;
+    gint64 now = *(gint64 *)data;
+
+    /* after a failed write, memory is the only place the changes are */
+    if(channel->dirty || channel->save_id || channel->write_failed)
+        return FALSE;
+
+    return channel->last_access
+           + (gint64)channel->xbpx->cache_timeout * 1000 <= now;
+}
+
+/* Channels nobody touched for CACHE_TIMEOUT are dropped from memory;
+ * the next access loads them again, usually from the binary snapshot.
+ * Only clean channels whose last write succeeded qualify, and nothing
+ * is evicted while writes are in flight, so a reload can't see a file
+ * older than what we had. */
+static gboolean
+blconf_backend_perchannel_xml_evict_timeout(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
+    gint64 now = g_get_monotonic_time();
+    guint n_pending;
+
+    gboolean keep = TRUE;
+
+    writer_mutex_lock(xbpx);
+    n_pending = xbpx->n_pending_writes;
+    writer_mutex_unlock(xbpx);
+
+    /* a reader still holding an evicted channel finishes with it and
+     * drops the last ref itself */
+    channels_mutex_lock(xbpx);
+
+    if(!n_pending) {
+        guint n_evicted;
+
+        n_evicted = g_hash_table_foreach_remove(xbpx->channels,
+                                                blconf_backend_perchannel_xml_channel_is_idle,
+                                                &now);
+        if(n_evicted)
+            DBG("Evicted %u idle channel(s)", n_evicted);
+    }
+
+    if(!g_hash_table_size(xbpx->channels)) {
+        xbpx->evict_id = 0;
+        keep = FALSE;
+    }
+
+    channels_mutex_unlock(xbpx);
+
+    return keep;
+}
+
+/* this and the two below are called with |channels_lock| held */
+static BlconfChannel *
+blconf_backend_perchannel_xml_lookup_channel(BlconfBackendPerchannelXml *xbpx,
+                                             const gchar *channel_name)
+{
+    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
+
+    if(channel)
+        channel->last_access = g_get_monotonic_time();
+
+    return channel;
+}
 
-    xbpx->save_id = g_timeout_add_seconds(WRITE_TIMEOUT,
-                                          blconf_backend_perchannel_xml_save_timeout,
-                                          xbpx);
+static void
+blconf_backend_perchannel_xml_add_channel(BlconfBackendPerchannelXml *xbpx,
+                                          const gchar *channel_name,
+                                          BlconfChannel *channel)
+{
+    channel->xbpx = xbpx;
+    channel->name = g_ascii_strdown(channel_name, -1);
+    channel->last_access = g_get_monotonic_time();
+    g_hash_table_insert(xbpx->channels, g_strdup(channel->name), channel);
+
+    if(!xbpx->evict_id) {
+        xbpx->evict_id = g_timeout_add_seconds(MIN(EVICT_INTERVAL,
+                                                   MAX(xbpx->cache_timeout / 1000, 1)),
+                                               blconf_backend_perchannel_xml_evict_timeout,
+                                               xbpx);
+    }
 }
 
 static BlconfChannel *
@@ -1008,7 +2696,6 @@ blconf_backend_perchannel_xml_create_channel(BlconfBackendPerchannelXml *xbpx,
                                              const gchar *channel_name)
 {
     BlconfChannel *channel;
-    BlconfProperty *prop;
 
     channel = g_hash_table_lookup(xbpx->channels, channel_name);
     if(channel) {
@@ -1016,37 +2703,83 @@ blconf_backend_perchannel_xml_create_channel(BlconfBackendPerchannelXml *xbpx,
         return channel;
     }
 
-    channel = g_slice_new0(BlconfChannel);
-    prop = g_slice_new0(BlconfProperty);
-    prop->name = g_strdup("/");
-    channel->properties = g_node_new(prop);
-    g_hash_table_insert(xbpx->channels, g_ascii_strdown(channel_name, -1), channel);
+    blconf_backend_perchannel_xml_clear_channel_missing(xbpx, channel_name);
+    blconf_backend_perchannel_xml_index_user_channel(xbpx, channel_name, TRUE);
+
+    channel = blconf_channel_new();
+    blconf_backend_perchannel_xml_add_channel(xbpx, channel_name, channel);
 
     return channel;
 }
 
 
+/* what a missing attribute reads as */
+static const BlconfMarkupSpan blconf_xml_no_value = { "", 0 };
+
+/* g_strlcat() with a span as the source */
+static void
+blconf_xml_append_span(gchar *dest,
+                       gsize dest_size,
+                       const BlconfMarkupSpan *span)
+{
+    gsize len = strlen(dest), n;
+
+    if(len + 1 >= dest_size)
+        return;
+
+    n = MIN(span->len, dest_size - len - 1);
+    memcpy(dest + len, span->str, n);
+    dest[len + n] = 0;
+}
+
+/* a file tends to repeat the same few lock lists, so each is only
+ * resolved once per file */
+static gboolean
+blconf_xml_user_is_in_list(XmlParserState *state,
+                           const BlconfMarkupSpan *span)
+{
+    gchar *list = g_strndup(span->str, span->len);
+    gpointer result;
+
+    if(!state->lock_lists) {
+        state->lock_lists = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  (GDestroyNotify)g_free,
+                                                  NULL);
+    }
+
+    /* so the result is no good for anyone else, see _shared_defaults_save() */
+    state->channel->per_user_locks = TRUE;
+
+    if(!g_hash_table_lookup_extended(state->lock_lists, list, NULL, &result)) {
+        result = GINT_TO_POINTER(blconf_user_is_in_list(list));
+        g_hash_table_insert(state->lock_lists, list, result);
+    } else
+        g_free(list);
+
+    return GPOINTER_TO_INT(result);
+}
+
 static gboolean
 blconf_xml_handle_channel(XmlParserState *state,
                           const gchar **attribute_names,
-                          const gchar **attribute_values,
+                          const BlconfMarkupSpan *attribute_values,
                           GError **error)
 {
-    const gchar *name = NULL, *version = NULL;
-    const gchar *locked = NULL, *unlocked = NULL;
+    const BlconfMarkupSpan *name = NULL, *version = NULL;
+    const BlconfMarkupSpan *locked = NULL, *unlocked = NULL;
     gsize maj_ver_len;
     gint i;
-    gchar *p;
+    const gchar *p;
 
     for(i = 0; attribute_names[i]; ++i) {
         if(!strcmp(attribute_names[i], "name"))
-            name = attribute_values[i];
+            name = &attribute_values[i];
         else if(!strcmp(attribute_names[i], "version"))
-            version = attribute_values[i];
+            version = &attribute_values[i];
         else if(!strcmp(attribute_names[i], "locked"))
-            locked = attribute_values[i];
+            locked = &attribute_values[i];
         else if(!strcmp(attribute_names[i], "unlocked"))
-            unlocked = attribute_values[i];
+            unlocked = &attribute_values[i];
         else {
             if(error) {
                 g_set_error(error, G_MARKUP_ERROR,
@@ -1058,7 +2791,7 @@ blconf_xml_handle_channel(XmlParserState *state,
         }
     }
 
-    if(!name || !*name || !version || !*version) {
+    if(!name || !name->len || !version || !version->len) {
         if(error) {
             g_set_error(error, G_MARKUP_ERROR,
                         G_MARKUP_ERROR_EMPTY,
@@ -1068,22 +2801,22 @@ blconf_xml_handle_channel(XmlParserState *state,
     }
 
     /* compare versions */
-    p = strstr(version, ".");
-    maj_ver_len = p ? (gsize)(p - version) : strlen(version);
+    p = memchr(version->str, '.', version->len);
+    maj_ver_len = p ? (gsize)(p - version->str) : version->len;
     if(maj_ver_len != strlen(FILE_VERSION_MAJOR)
-       || strncmp(version, FILE_VERSION_MAJOR, maj_ver_len))
+       || strncmp(version->str, FILE_VERSION_MAJOR, maj_ver_len))
     {
         if(error) {
             g_set_error(error, G_MARKUP_ERROR,
                         G_MARKUP_ERROR_INVALID_CONTENT,
-                        "On-disk file version %s is not compatible with our file version %s.%s",
-                        version, FILE_VERSION_MAJOR,
+                        "On-disk file version %.*s is not compatible with our file version %s.%s",
+                        (gint)version->len, version->str, FILE_VERSION_MAJOR,
                         FILE_VERSION_MINOR);
         }
         return FALSE;
     }
 
-    if((locked && *locked) || (unlocked && *unlocked)) {
+    if((locked && locked->len) || (unlocked && unlocked->len)) {
         gboolean locked_state = FALSE;
 
         if(!state->is_system_file) {
@@ -1095,10 +2828,10 @@ blconf_xml_handle_channel(XmlParserState *state,
             return FALSE;
         }
 
-        if(unlocked && *unlocked)
-            locked_state = !blconf_user_is_in_list(unlocked);
-        else if(locked && *locked)
-            locked_state = blconf_user_is_in_list(locked);
+        if(unlocked && unlocked->len)
+            locked_state = !blconf_xml_user_is_in_list(state, unlocked);
+        else if(locked && locked->len)
+            locked_state = blconf_xml_user_is_in_list(state, locked);
 
         /* Policy:
          *   + If the channel was locked by a previous file, and this file
@@ -1122,14 +2855,7 @@ blconf_xml_handle_channel(XmlParserState *state,
             }
             return FALSE;
         } else if(!state->channel->locked && locked_state) {
-            BlconfProperty *prop;
-
-            blconf_proptree_destroy(state->channel->properties);
-
-            prop = g_slice_new0(BlconfProperty);
-            prop->name = g_strdup("/");
-            state->channel->properties = g_node_new(prop);
-
+            blconf_channel_clear(state->channel);
             state->channel->locked = TRUE;
         }
     }
@@ -1142,28 +2868,33 @@ blconf_xml_handle_channel(XmlParserState *state,
 static gboolean
 blconf_xml_handle_property(XmlParserState *state,
                            const gchar **attribute_names,
-                           const gchar **attribute_values,
+                           const BlconfMarkupSpan *attribute_values,
                            GError **error)
 {
     gint i;
-    const gchar *name = NULL, *type = NULL, *value = NULL;
-    const gchar *locked = NULL, *unlocked = NULL;
+    const BlconfMarkupSpan *name = NULL, *type = NULL;
+    const BlconfMarkupSpan *value = &blconf_xml_no_value;
+    const BlconfMarkupSpan *locked = NULL, *unlocked = NULL;
     gchar fullpath[MAX_PROP_PATH];
     BlconfProperty *prop = NULL;
     GType value_type;
     GValue *value_to_set = NULL;
 
     for(i = 0; attribute_names[i]; ++i) {
-        if(!strcmp(attribute_names[i], "name"))
-            name = attribute_values[i];
-        else if(!strcmp(attribute_names[i], "type"))
-            type = attribute_values[i];
-        else if(!strcmp(attribute_names[i], "value"))
-            value = attribute_values[i];
-        else if(!strcmp(attribute_names[i], "locked"))
-            locked = attribute_values[i];
-        else if(!strcmp(attribute_names[i], "unlocked"))
-            unlocked = attribute_values[i];
+        /* this runs for every property in every file, so dispatch on
+         * the first character before comparing */
+        const gchar *attr = attribute_names[i];
+
+        if(attr[0] == 'n' && !strcmp(attr, "name"))
+            name = &attribute_values[i];
+        else if(attr[0] == 't' && !strcmp(attr, "type"))
+            type = &attribute_values[i];
+        else if(attr[0] == 'v' && !strcmp(attr, "value"))
+            value = &attribute_values[i];
+        else if(attr[0] == 'l' && !strcmp(attr, "locked"))
+            locked = &attribute_values[i];
+        else if(attr[0] == 'u' && !strcmp(attr, "unlocked"))
+            unlocked = &attribute_values[i];
         else {
             if(error) {
                 g_set_error(error, G_MARKUP_ERROR,
@@ -1175,7 +2906,7 @@ blconf_xml_handle_property(XmlParserState *state,
         }
     }
 
-    if(!name || !*name || !type || !*type) {
+    if(!name || !name->len || !type || !type->len) {
         if(error) {
             g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_EMPTY,
                         "Element <property> requires both name and type attributes");
@@ -1186,7 +2917,7 @@ blconf_xml_handle_property(XmlParserState *state,
     /* FIXME: name validation! */
     g_strlcpy(fullpath, state->cur_path, MAX_PROP_PATH);
     g_strlcat(fullpath, "/", MAX_PROP_PATH);
-    g_strlcat(fullpath, name, MAX_PROP_PATH);
+    blconf_xml_append_span(fullpath, MAX_PROP_PATH, name);
 
     /* Policy:
      *   + If the channel is already locked and we're here, we can
@@ -1210,7 +2941,7 @@ blconf_xml_handle_property(XmlParserState *state,
         g_assert_not_reached();
     }
 
-    prop = blconf_proptree_lookup(state->channel->properties, fullpath);
+    prop = blconf_proptree_lookup(state->channel, fullpath);
 
     if(state->channel->locked) {
         /* we must still be in a system file, otherwise we'd never get here */
@@ -1222,7 +2953,7 @@ blconf_xml_handle_property(XmlParserState *state,
             if(G_VALUE_TYPE(&prop->system_value))
                 g_value_unset(&prop->system_value);
         } else {
-            GNode *pnode = blconf_proptree_add_property(state->channel->properties,
+            GNode *pnode = blconf_proptree_add_property(state->channel,
                                                         fullpath, NULL, NULL,
                                                         TRUE);
             prop = pnode->data;
@@ -1247,7 +2978,7 @@ blconf_xml_handle_property(XmlParserState *state,
                     g_value_unset(&prop->system_value);
             }
         } else {
-            GNode *pnode = blconf_proptree_add_property(state->channel->properties,
+            GNode *pnode = blconf_proptree_add_property(state->channel,
                                                         fullpath, NULL, NULL,
                                                         FALSE);
             prop = pnode->data;
@@ -1259,7 +2990,7 @@ blconf_xml_handle_property(XmlParserState *state,
      *     an attribute on a <property> element.
      */
 
-    if((locked && *locked) || (unlocked && *unlocked)) {
+    if((locked && locked->len) || (unlocked && unlocked->len)) {
         if(!state->is_system_file) {
             /* can't lock properties from a non-locked channel */
             if(error) {
@@ -1268,7 +2999,7 @@ blconf_xml_handle_property(XmlParserState *state,
                             "Attribute \"locked\" not allowed in <property> for non-system files");
             }
 
-            blconf_proptree_reset(state->channel->properties, fullpath);
+            blconf_proptree_reset(state->channel, fullpath);
             return FALSE;
         }
 
@@ -1277,10 +3008,10 @@ blconf_xml_handle_property(XmlParserState *state,
             prop->locked = TRUE;
         } else {
             /* not locked already, but we have a lock/unlock directive */
-            if(unlocked && *unlocked)
-                prop->locked = !blconf_user_is_in_list(unlocked);
-            else if(locked && *locked)
-                prop->locked = blconf_user_is_in_list(locked);
+            if(unlocked && unlocked->len)
+                prop->locked = !blconf_xml_user_is_in_list(state, unlocked);
+            else if(locked && locked->len)
+                prop->locked = blconf_xml_user_is_in_list(state, locked);
         }
     }
 
@@ -1289,13 +3020,14 @@ blconf_xml_handle_property(XmlParserState *state,
      * This might not be the best design choice, but it makes the code
      * slightly simpler, and I don't think it matters in practice, anyway. */
 
-    /* parse types and values */
-    value_type = _blconf_gtype_from_string(type);
+    /* parse types and values, straight from the document */
+    value_type = _blconf_gtype_from_string_len(type->str, type->len);
     if(G_TYPE_INVALID == value_type) {
         if(error) {
             g_set_error(error, G_MARKUP_ERROR,
                         G_MARKUP_ERROR_INVALID_CONTENT,
-                        _("Invalid type for <property>: \"%s\""), type);
+                        _("Invalid type for <property>: \"%.*s\""),
+                        (gint)type->len, type->str);
         }
         return FALSE;
     }
@@ -1307,12 +3039,15 @@ blconf_xml_handle_property(XmlParserState *state,
 
     if(G_TYPE_NONE != value_type) {
         g_value_init(value_to_set, value_type);
-        if(!_blconf_gvalue_from_string(value_to_set, value)) {
+        if(!_blconf_gvalue_from_string_len(value_to_set, value->str,
+                                           value->len))
+        {
             if(error) {
                 g_set_error(error, G_MARKUP_ERROR,
                             G_MARKUP_ERROR_INVALID_CONTENT,
-                            _("Unable to parse value of type \"%s\" from \"%s\""),
-                            g_type_name(value_type), value);
+                            _("Unable to parse value of type \"%s\" from \"%.*s\""),
+                            g_type_name(value_type), (gint)value->len,
+                            value->str);
             }
             return FALSE;
         }
@@ -1337,20 +3072,23 @@ blconf_xml_handle_property(XmlParserState *state,
 static gboolean
 blconf_xml_handle_value(XmlParserState *state,
                         const gchar **attribute_names,
-                        const gchar **attribute_values,
+                        const BlconfMarkupSpan *attribute_values,
                         GError **error)
 {
     gint i;
-    const gchar *type = NULL, *value = NULL;
+    const BlconfMarkupSpan *type = &blconf_xml_no_value;
+    const BlconfMarkupSpan *value = &blconf_xml_no_value;
     GPtrArray *arr;
     GValue *val;
     GType value_type = G_TYPE_INVALID;
 
     for(i = 0; attribute_names[i]; ++i) {
-        if(!strcmp(attribute_names[i], "type"))
-            type = attribute_values[i];
-        else if(!strcmp(attribute_names[i], "value"))
-            value = attribute_values[i];
+        const gchar *attr = attribute_names[i];
+
+        if(attr[0] == 't' && !strcmp(attr, "type"))
+            type = &attribute_values[i];
+        else if(attr[0] == 'v' && !strcmp(attr, "value"))
+            value = &attribute_values[i];
         else {
             if(error) {
                 g_set_error(error, G_MARKUP_ERROR,
@@ -1362,7 +3100,7 @@ blconf_xml_handle_value(XmlParserState *state,
         }
     }
 
-    value_type = _blconf_gtype_from_string(type);
+    value_type = _blconf_gtype_from_string_len(type->str, type->len);
     if(BLCONF_TYPE_G_VALUE_ARRAY == value_type) {
         if(error) {
             g_set_error(error, G_MARKUP_ERROR,
@@ -1376,19 +3114,21 @@ blconf_xml_handle_value(XmlParserState *state,
         if(error) {
             g_set_error(error, G_MARKUP_ERROR,
                         G_MARKUP_ERROR_INVALID_CONTENT,
-                        _("Invalid type for <value>: \"%s\""), type);
+                        _("Invalid type for <value>: \"%.*s\""),
+                        (gint)type->len, type->str);
         }
         return FALSE;
     }
 
     val = g_new0(GValue, 1);
     g_value_init(val, value_type);
-    if(!_blconf_gvalue_from_string(val, value)) {
+    if(!_blconf_gvalue_from_string_len(val, value->str, value->len)) {
         if(error) {
             g_set_error(error, G_MARKUP_ERROR,
                         G_MARKUP_ERROR_INVALID_CONTENT,
-                        _("Unable to parse value of type \"%s\" from \"%s\""),
-                        g_type_name(value_type), value);
+                        _("Unable to parse value of type \"%s\" from \"%.*s\""),
+                        g_type_name(value_type), (gint)value->len,
+                        value->str);
         }
         g_value_unset(val);
         g_free(val);
@@ -1404,10 +3144,9 @@ blconf_xml_handle_value(XmlParserState *state,
 }
 
 static void
-blconf_backend_perchannel_xml_start_elem(GMarkupParseContext *context,
-                                         const gchar *element_name,
+blconf_backend_perchannel_xml_start_elem(const gchar *element_name,
                                          const gchar **attribute_names,
-                                         const gchar **attribute_values,
+                                         const BlconfMarkupSpan *attribute_values,
                                          gpointer user_data,
                                          GError **error)
 {
@@ -1465,8 +3204,7 @@ blconf_backend_perchannel_xml_start_elem(GMarkupParseContext *context,
 }
 
 static void
-blconf_backend_perchannel_xml_end_elem(GMarkupParseContext *context,
-                                       const gchar *element_name,
+blconf_backend_perchannel_xml_end_elem(const gchar *element_name,
                                        gpointer user_data,
                                        GError **error)
 {
@@ -1570,14 +3308,11 @@ blconf_backend_perchannel_xml_merge_file(BlconfBackendPerchannelXml *xbpx,
     GMappedFile *mmap_file;
     gchar *file_contents;
     gsize length;
-    GMarkupParseContext *context;
     XmlParserState *state;
     GError *error2 = NULL;
-    GMarkupParser parser = {
+    BlconfMarkupParser parser = {
         blconf_backend_perchannel_xml_start_elem,
         blconf_backend_perchannel_xml_end_elem,
-        /* blconf_backend_perchannel_xml_text_elem, */
-        NULL,
     };
 
     TRACE("entering (%s)", filename);
@@ -1602,9 +3337,7 @@ blconf_backend_perchannel_xml_merge_file(BlconfBackendPerchannelXml *xbpx,
 
     DBG("got file(size=%"G_GSIZE_FORMAT"): %s", length, file_contents);
 
-    context = g_markup_parse_context_new(&parser, 0, state, NULL);
-    if(g_markup_parse_context_parse(context, file_contents, length, &error2)
-       && g_markup_parse_context_end_parse(context, &error2)) {
+    if(blconf_markup_parse(&parser, state, file_contents, length, &error2)) {
         ret = TRUE;
     } else {
         g_warning("Error parsing blconf config file \"%s\": %s", filename,
@@ -1617,11 +3350,10 @@ blconf_backend_perchannel_xml_merge_file(BlconfBackendPerchannelXml *xbpx,
 
     TRACE("exiting");
 
+    if(state->lock_lists)
+        g_hash_table_destroy(state->lock_lists);
     g_slice_free(XmlParserState, state);
 
-    if(context)
-        g_markup_parse_context_free(context);
-
     if(mmap_file)
         g_mapped_file_unref(mmap_file);
     else
@@ -1630,78 +3362,2275 @@ blconf_backend_perchannel_xml_merge_file(BlconfBackendPerchannelXml *xbpx,
     return ret;
 }
 
+/* Binary channel cache.
+ *
+ * The result of merging all of a channel's XML files is dumped into
+ * a flat file in the user's cache directory: a header, the list of
+ * files (and their identity, nanosecond mtimes and sizes) the
+ * snapshot was built from, the node array in tree order, the value
+ * records, and finally a string table.  The cache is only used if
+ * every source file still matches; the XML files always remain the
+ * authoritative copy.
+ *
+ * Loading maps the file and turns it into the usual property tree in
+ * one pass over the node array, with no text to parse.  Reads aren't
+ * served from the mapping itself: the tree is what writes, locks and
+ * the journal work on.  Shared defaults do keep their strings in the
+ * mapping, see below. */
+
+#define BINARY_CACHE_MAGIC     (0x42434c42)  /* "BLCB" */
+#define BINARY_CACHE_VERSION   (2)
+#define BINARY_CACHE_FILE_FMT  "%s/%s.cache"
+#define BINARY_CACHE_NONE      (G_MAXUINT32)
+
+#define BINARY_CACHE_FLAG_LOCKED  (1 << 0)
+
+typedef enum
+{
+    BINARY_CACHE_TYPE_STRING = 1,
+    BINARY_CACHE_TYPE_UCHAR,
+    BINARY_CACHE_TYPE_CHAR,
+    BINARY_CACHE_TYPE_UINT16,
+    BINARY_CACHE_TYPE_INT16,
+    BINARY_CACHE_TYPE_UINT,
+    BINARY_CACHE_TYPE_INT,
+    BINARY_CACHE_TYPE_UINT64,
+    BINARY_CACHE_TYPE_INT64,
+    BINARY_CACHE_TYPE_FLOAT,
+    BINARY_CACHE_TYPE_DOUBLE,
+    BINARY_CACHE_TYPE_BOOLEAN,
+    BINARY_CACHE_TYPE_ARRAY,
+} BinaryCacheType;
+
+typedef struct
+{
+    guint32 magic;
+    guint32 version;
+    guint32 flags;
+    guint32 n_sources;
+    guint32 n_nodes;
+    guint32 n_values;
+    guint32 strtab_len;
+    guint32 reserved;
+} BinaryCacheHeader;
+
+typedef struct
+{
+    guint64 mtime;
+    guint64 size;
+    guint64 ino;
+    guint64 dev;
+    guint32 mtime_nsec;
+    guint32 path;      /* string table offset */
+    guint32 exists;
+    guint32 reserved;
+} BinaryCacheSource;
+
+typedef struct
+{
+    guint32 path;          /* string table offset of the full name */
+    guint32 parent;        /* node index, or NONE for the top level */
+    guint32 value;         /* value index, or NONE */
+    guint32 system_value;  /* value index, or NONE */
+    guint32 locked;
+    guint32 reserved;
+} BinaryCacheNode;
+
+typedef struct
+{
+    guint32 type;
+    guint32 n_elems;  /* arrays: the elements are the next n_elems records */
+    union {
+        guint64 u;
+        gint64 i;
+        gdouble d;
+    } data;           /* strings: string table offset */
+} BinaryCacheValue;
+
+typedef struct
+{
+    GArray *nodes;
+    GArray *values;
+    GString *strtab;
+} BinaryCacheWriter;
+
+/* returns the files a channel is built from, in merge order: the
+ * |n_system_files| system files come first, followed by the user file
+ * (if any) and /etc/group */
+static GPtrArray *
+blconf_binary_cache_get_sources(gchar **filenames,
+                                const gchar *user_file,
+                                guint *n_system_files)
+{
+    GPtrArray *sources = g_ptr_array_new();
+    gint i;
+
+    for(i = (filenames ? g_strv_length(filenames) : 0) - 1; i >= 0; --i) {
+        if(!g_strcmp0(user_file, filenames[i]))
+            continue;
+        g_ptr_array_add(sources, filenames[i]);
+    }
+    *n_system_files = sources->len;
+
+    if(user_file)
+        g_ptr_array_add(sources, (gpointer)user_file);
+
+    /* lock directives are resolved against group membership at load
+     * time, so a change there has to invalidate the snapshot too */
+    g_ptr_array_add(sources, "/etc/group");
+
+    return sources;
+}
+
+static void
+blconf_binary_cache_stat_sources(GPtrArray *sources,
+                                 BinaryCacheSource *stats)
+{
+    struct stat st;
+    guint i;
+
+    for(i = 0; i < sources->len; ++i) {
+        memset(&stats[i], 0, sizeof(BinaryCacheSource));
+        if(!stat(g_ptr_array_index(sources, i), &st)) {
+            stats[i].mtime = st.st_mtime;
+            stats[i].mtime_nsec = STAT_MTIME_NSEC(&st);
+            stats[i].size = st.st_size;
+            stats[i].ino = st.st_ino;
+            stats[i].dev = st.st_dev;
+            stats[i].exists = TRUE;
+        }
+    }
+}
+
+/* a file replaced within the same second by one of the same size
+ * still differs in its inode or its nanoseconds */
+static gboolean
+blconf_binary_cache_source_equal(const BinaryCacheSource *a,
+                                 const BinaryCacheSource *b)
+{
+    return a->exists == b->exists
+           && a->mtime == b->mtime
+           && a->mtime_nsec == b->mtime_nsec
+           && a->size == b->size
+           && a->ino == b->ino
+           && a->dev == b->dev;
+}
+
+static gboolean
+blconf_binary_cache_decode_value(const BinaryCacheValue *values,
+                                 guint32 n_values,
+                                 guint32 idx,
+                                 const gchar *strtab,
+                                 guint32 strtab_len,
+                                 gboolean is_array_value,
+                                 gboolean static_strings,
+                                 GValue *value)
+{
+    const BinaryCacheValue *rec;
+
+    if(idx >= n_values)
+        return FALSE;
+    rec = &values[idx];
+
+    switch(rec->type) {
+        case BINARY_CACHE_TYPE_STRING:
+            if(rec->data.u >= strtab_len)
+                return FALSE;
+            g_value_init(value, G_TYPE_STRING);
+            if(static_strings)
+                g_value_set_static_string(value, strtab + rec->data.u);
+            else
+                g_value_set_string(value, strtab + rec->data.u);
+            break;
+
+        case BINARY_CACHE_TYPE_UCHAR:
+            g_value_init(value, G_TYPE_UCHAR);
+            g_value_set_uchar(value, rec->data.u);
+            break;
+
+        case BINARY_CACHE_TYPE_CHAR:
+            g_value_init(value, G_TYPE_CHAR);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+            g_value_set_schar(value, rec->data.i);
+#else
+            g_value_set_char(value, rec->data.i);
+#endif
+            break;
+
+        case BINARY_CACHE_TYPE_UINT16:
+            g_value_init(value, BLCONF_TYPE_UINT16);
+            blconf_g_value_set_uint16(value, rec->data.u);
+            break;
+
+        case BINARY_CACHE_TYPE_INT16:
+            g_value_init(value, BLCONF_TYPE_INT16);
+            blconf_g_value_set_int16(value, rec->data.i);
+            break;
+
+        case BINARY_CACHE_TYPE_UINT:
+            g_value_init(value, G_TYPE_UINT);
+            g_value_set_uint(value, rec->data.u);
+            break;
+
+        case BINARY_CACHE_TYPE_INT:
+            g_value_init(value, G_TYPE_INT);
+            g_value_set_int(value, rec->data.i);
+            break;
+
+        case BINARY_CACHE_TYPE_UINT64:
+            g_value_init(value, G_TYPE_UINT64);
+            g_value_set_uint64(value, rec->data.u);
+            break;
+
+        case BINARY_CACHE_TYPE_INT64:
+            g_value_init(value, G_TYPE_INT64);
+            g_value_set_int64(value, rec->data.i);
+            break;
+
+        case BINARY_CACHE_TYPE_FLOAT:
+            g_value_init(value, G_TYPE_FLOAT);
+            g_value_set_float(value, rec->data.d);
+            break;
+
+        case BINARY_CACHE_TYPE_DOUBLE:
+            g_value_init(value, G_TYPE_DOUBLE);
+            g_value_set_double(value, rec->data.d);
+            break;
+
+        case BINARY_CACHE_TYPE_BOOLEAN:
+            g_value_init(value, G_TYPE_BOOLEAN);
+            g_value_set_boolean(value, rec->data.u != 0);
+            break;
+
+        case BINARY_CACHE_TYPE_ARRAY: {
+            GPtrArray *arr;
+            guint32 i;
+
+            if(is_array_value || rec->n_elems > n_values - idx - 1)
+                return FALSE;
+
+            arr = g_ptr_array_sized_new(rec->n_elems);
+            for(i = 0; i < rec->n_elems; ++i) {
+                GValue *elem = g_new0(GValue, 1);
+
+                if(!blconf_binary_cache_decode_value(values, n_values,
+                                                     idx + 1 + i, strtab,
+                                                     strtab_len, TRUE,
+                                                     static_strings, elem))
+                {
+                    g_free(elem);
+                    g_ptr_array_foreach(arr, (GFunc)_blconf_gvalue_free, NULL);
+                    g_ptr_array_free(arr, TRUE);
+                    return FALSE;
+                }
+                g_ptr_array_add(arr, elem);
+            }
+
+            g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+            g_value_take_boxed(value, arr);
+            break;
+        }
+
+        default:
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* builds the channel from a snapshot at |contents|, which has to be
+ * 8-byte aligned, if it was taken from the |sources| as they are now.
+ * with |static_strings|, the string values point into |contents|,
+ * which then has to outlive the channel */
 static BlconfChannel *
-blconf_backend_perchannel_xml_load_channel(BlconfBackendPerchannelXml *xbpx,
-                                           const gchar *channel_name,
-                                           GError **error)
+blconf_binary_cache_parse(const gchar *channel_name,
+                          const gchar *contents,
+                          gsize length,
+                          GPtrArray *sources,
+                          const BinaryCacheSource *stats,
+                          gboolean static_strings)
 {
     BlconfChannel *channel = NULL;
-    gchar *filename_stem, **filenames, *user_file;
-    gint i, length;
-    BlconfProperty *prop;
+    const gchar *strtab;
+    const BinaryCacheHeader *header;
+    const BinaryCacheSource *cached_sources;
+    const BinaryCacheNode *nodes;
+    const BinaryCacheValue *values;
+    GNode **gnodes = NULL;
+    gsize expected;
+    guint32 i;
+
+    header = (const BinaryCacheHeader *)contents;
+    if(length < sizeof(BinaryCacheHeader)
+       || header->magic != BINARY_CACHE_MAGIC
+       || header->version != BINARY_CACHE_VERSION
+       || header->n_sources != sources->len
+       || header->strtab_len == 0)
+    {
+        goto out;
+    }
 
-    TRACE("entering");
+    expected = sizeof(BinaryCacheHeader)
+               + (gsize)header->n_sources * sizeof(BinaryCacheSource)
+               + (gsize)header->n_nodes * sizeof(BinaryCacheNode)
+               + (gsize)header->n_values * sizeof(BinaryCacheValue)
+               + header->strtab_len;
+    if(length != expected)
+        goto out;
 
-    filename_stem = g_strdup_printf(CONFIG_FILE_FMT, channel_name);
-    filenames = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG, filename_stem);
-    user_file = xfce_resource_save_location(XFCE_RESOURCE_CONFIG,
-                                            filename_stem, FALSE);
-    g_free(filename_stem);
+    cached_sources = (const BinaryCacheSource *)(header + 1);
+    nodes = (const BinaryCacheNode *)(cached_sources + header->n_sources);
+    values = (const BinaryCacheValue *)(nodes + header->n_nodes);
+    strtab = (const gchar *)(values + header->n_values);
 
-    if((!filenames || !filenames[0]) && !user_file) {
-        if(error) {
-            g_set_error(error, BLCONF_ERROR,
-                        BLCONF_ERROR_CHANNEL_NOT_FOUND,
-                        _("Channel \"%s\" does not exist"), channel_name);
-        }
+    /* everything in the string table must be terminated within it */
+    if(strtab[header->strtab_len - 1] != 0)
         goto out;
+
+    for(i = 0; i < header->n_sources; ++i) {
+        if(cached_sources[i].path >= header->strtab_len
+           || strcmp(strtab + cached_sources[i].path,
+                     g_ptr_array_index(sources, i))
+           || !blconf_binary_cache_source_equal(&cached_sources[i],
+                                                &stats[i]))
+        {
+            DBG("binary cache for channel \"%s\" is stale", channel_name);
+            goto out;
+        }
+    }
+
+    channel = blconf_channel_new();
+    channel->locked = (header->flags & BINARY_CACHE_FLAG_LOCKED) != 0;
+
+    gnodes = g_new(GNode *, MAX(header->n_nodes, 1));
+    for(i = 0; i < header->n_nodes; ++i) {
+        const BinaryCacheNode *node = &nodes[i];
+        BlconfProperty *prop;
+        GNode *parent;
+
+        /* parents always come before their children */
+        if(node->path >= header->strtab_len
+           || !PROP_NAME_IS_VALID(strtab + node->path)
+           || (node->parent != BINARY_CACHE_NONE && node->parent >= i))
+        {
+            goto fail;
+        }
+
+        parent = node->parent == BINARY_CACHE_NONE
+                 ? channel->properties : gnodes[node->parent];
+        gnodes[i] = blconf_proptree_new_child(channel, parent,
+                                              strtab + node->path,
+                                              node->locked != 0);
+        prop = gnodes[i]->data;
+
+        if((node->value != BINARY_CACHE_NONE
+            && !blconf_binary_cache_decode_value(values, header->n_values,
+                                                 node->value, strtab,
+                                                 header->strtab_len, FALSE,
+                                                 static_strings, &prop->value))
+           || (node->system_value != BINARY_CACHE_NONE
+               && !blconf_binary_cache_decode_value(values, header->n_values,
+                                                    node->system_value, strtab,
+                                                    header->strtab_len, FALSE,
+                                                    static_strings,
+                                                    &prop->system_value)))
+        {
+            goto fail;
+        }
     }
 
-    channel = g_slice_new0(BlconfChannel);
-    prop = g_slice_new0(BlconfProperty);
-    prop->name = g_strdup("/");
-    channel->properties = g_node_new(prop);
+    goto out;
+
+fail:
+    g_warning("Binary cache for channel \"%s\" is corrupt, ignoring it",
+              channel_name);
+    blconf_channel_unref(channel);
+    channel = NULL;
+
+out:
+    g_free(gnodes);
+
+    return channel;
+}
+
+static BlconfChannel *
+blconf_binary_cache_load(BlconfBackendPerchannelXml *xbpx,
+                         const gchar *channel_name,
+                         GPtrArray *sources,
+                         const BinaryCacheSource *stats)
+{
+    BlconfChannel *channel;
+    GMappedFile *mmap_file;
+    gchar *filename;
+
+    if(!xbpx->cache_save_path)
+        return NULL;
+
+    filename = g_strdup_printf(BINARY_CACHE_FILE_FMT, xbpx->cache_save_path,
+                               channel_name);
+    mmap_file = g_mapped_file_new(filename, FALSE, NULL);
+    g_free(filename);
+    if(!mmap_file)
+        return NULL;
+
+    channel = blconf_binary_cache_parse(channel_name,
+                                        g_mapped_file_get_contents(mmap_file),
+                                        g_mapped_file_get_length(mmap_file),
+                                        sources, stats, FALSE);
+    if(channel)
+        DBG("loaded channel \"%s\" from binary cache", channel_name);
+
+    g_mapped_file_unref(mmap_file);
+
+    return channel;
+}
+
+static guint32
+blconf_binary_cache_add_string(BinaryCacheWriter *writer,
+                               const gchar *str)
+{
+    guint32 offset = writer->strtab->len;
+
+    g_string_append_len(writer->strtab, str, strlen(str) + 1);
+
+    return offset;
+}
+
+static gboolean
+blconf_binary_cache_add_value(BinaryCacheWriter *writer,
+                              const GValue *value,
+                              gboolean is_array_value,
+                              guint32 *idx)
+{
+    BinaryCacheValue rec;
+    GType type = G_VALUE_TYPE(value);
+
+    memset(&rec, 0, sizeof(rec));
+
+    switch(type) {
+        case G_TYPE_STRING:
+            rec.type = BINARY_CACHE_TYPE_STRING;
+            rec.data.u = blconf_binary_cache_add_string(writer,
+                                                        g_value_get_string(value)
+                                                        ? g_value_get_string(value)
+                                                        : "");
+            break;
+        case G_TYPE_UCHAR:
+            rec.type = BINARY_CACHE_TYPE_UCHAR;
+            rec.data.u = g_value_get_uchar(value);
+            break;
+        case G_TYPE_CHAR:
+            rec.type = BINARY_CACHE_TYPE_CHAR;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+            rec.data.i = g_value_get_schar(value);
+#else
+            rec.data.i = g_value_get_char(value);
+#endif
+            break;
+        case G_TYPE_UINT:
+            rec.type = BINARY_CACHE_TYPE_UINT;
+            rec.data.u = g_value_get_uint(value);
+            break;
+        case G_TYPE_INT:
+            rec.type = BINARY_CACHE_TYPE_INT;
+            rec.data.i = g_value_get_int(value);
+            break;
+        case G_TYPE_UINT64:
+            rec.type = BINARY_CACHE_TYPE_UINT64;
+            rec.data.u = g_value_get_uint64(value);
+            break;
+        case G_TYPE_INT64:
+            rec.type = BINARY_CACHE_TYPE_INT64;
+            rec.data.i = g_value_get_int64(value);
+            break;
+        case G_TYPE_FLOAT:
+            rec.type = BINARY_CACHE_TYPE_FLOAT;
+            rec.data.d = g_value_get_float(value);
+            break;
+        case G_TYPE_DOUBLE:
+            rec.type = BINARY_CACHE_TYPE_DOUBLE;
+            rec.data.d = g_value_get_double(value);
+            break;
+        case G_TYPE_BOOLEAN:
+            rec.type = BINARY_CACHE_TYPE_BOOLEAN;
+            rec.data.u = g_value_get_boolean(value);
+            break;
+        default:
+            if(type == BLCONF_TYPE_UINT16) {
+                rec.type = BINARY_CACHE_TYPE_UINT16;
+                rec.data.u = blconf_g_value_get_uint16(value);
+            } else if(type == BLCONF_TYPE_INT16) {
+                rec.type = BINARY_CACHE_TYPE_INT16;
+                rec.data.i = blconf_g_value_get_int16(value);
+            } else if(type == BLCONF_TYPE_G_VALUE_ARRAY && !is_array_value) {
+                GPtrArray *arr = g_value_get_boxed(value);
+                guint32 dummy;
+                guint i;
+
+                rec.type = BINARY_CACHE_TYPE_ARRAY;
+                rec.n_elems = arr ? arr->len : 0;
+
+                /* the elements have to directly follow the array record */
+                *idx = writer->values->len;
+                g_array_append_val(writer->values, rec);
+                for(i = 0; i < rec.n_elems; ++i) {
+                    if(!blconf_binary_cache_add_value(writer,
+                                                      g_ptr_array_index(arr, i),
+                                                      TRUE, &dummy))
+                    {
+                        return FALSE;
+                    }
+                }
+                return TRUE;
+            } else
+                return FALSE;
+            break;
+    }
+
+    *idx = writer->values->len;
+    g_array_append_val(writer->values, rec);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_binary_cache_add_node(BinaryCacheWriter *writer,
+                             GNode *node,
+                             guint32 parent,
+                             gchar cur_path[MAX_PROP_PATH])
+{
+    BlconfProperty *prop = node->data;
+    BinaryCacheNode rec;
+    guint32 idx;
+    gsize path_len = strlen(cur_path);
+    GNode *child;
+
+    g_strlcat(cur_path, "/", MAX_PROP_PATH);
+    g_strlcat(cur_path, prop->name, MAX_PROP_PATH);
+
+    memset(&rec, 0, sizeof(rec));
+    rec.path = blconf_binary_cache_add_string(writer, cur_path);
+    rec.parent = parent;
+    rec.value = rec.system_value = BINARY_CACHE_NONE;
+    rec.locked = prop->locked;
+
+    if((G_VALUE_TYPE(&prop->value)
+        && !blconf_binary_cache_add_value(writer, &prop->value, FALSE,
+                                          &rec.value))
+       || (G_VALUE_TYPE(&prop->system_value)
+           && !blconf_binary_cache_add_value(writer, &prop->system_value,
+                                             FALSE, &rec.system_value)))
+    {
+        return FALSE;
+    }
+
+    idx = writer->nodes->len;
+    g_array_append_val(writer->nodes, rec);
+
+    for(child = g_node_first_child(node);
+        child;
+        child = g_node_next_sibling(child))
+    {
+        if(!blconf_binary_cache_add_node(writer, child, idx, cur_path))
+            return FALSE;
+    }
+
+    cur_path[path_len] = 0;
+
+    return TRUE;
+}
+
+/* the snapshot of |channel|, or NULL if it has a value the format
+ * can't hold */
+static GByteArray *
+blconf_binary_cache_serialize(const gchar *channel_name,
+                              BlconfChannel *channel,
+                              GPtrArray *sources,
+                              const BinaryCacheSource *stats)
+{
+    BinaryCacheWriter writer;
+    BinaryCacheHeader header;
+    GByteArray *contents;
+    GNode *child;
+    gchar cur_path[MAX_PROP_PATH];
+    guint i;
+
+    writer.nodes = g_array_new(FALSE, FALSE, sizeof(BinaryCacheNode));
+    writer.values = g_array_new(FALSE, FALSE, sizeof(BinaryCacheValue));
+    writer.strtab = g_string_sized_new(1024);
+
+    contents = g_byte_array_new();
+
+    memset(&header, 0, sizeof(header));
+    header.magic = BINARY_CACHE_MAGIC;
+    header.version = BINARY_CACHE_VERSION;
+    header.flags = channel->locked ? BINARY_CACHE_FLAG_LOCKED : 0;
+    header.n_sources = sources->len;
+    g_byte_array_append(contents, (guint8 *)&header, sizeof(header));
+
+    for(i = 0; i < sources->len; ++i) {
+        BinaryCacheSource source = stats[i];
+
+        source.path = blconf_binary_cache_add_string(&writer,
+                                                     g_ptr_array_index(sources, i));
+        g_byte_array_append(contents, (guint8 *)&source, sizeof(source));
+    }
+
+    cur_path[0] = 0;
+    for(child = g_node_first_child(channel->properties);
+        child;
+        child = g_node_next_sibling(child))
+    {
+        if(!blconf_binary_cache_add_node(&writer, child, BINARY_CACHE_NONE,
+                                         cur_path))
+        {
+            DBG("not caching channel \"%s\": unsupported value", channel_name);
+            g_byte_array_free(contents, TRUE);
+            contents = NULL;
+            goto out;
+        }
+    }
+
+    /* now that everything is known, fix up the header */
+    header.n_nodes = writer.nodes->len;
+    header.n_values = writer.values->len;
+    header.strtab_len = writer.strtab->len;
+    memcpy(contents->data, &header, sizeof(header));
+
+    g_byte_array_append(contents, (guint8 *)writer.nodes->data,
+                        writer.nodes->len * sizeof(BinaryCacheNode));
+    g_byte_array_append(contents, (guint8 *)writer.values->data,
+                        writer.values->len * sizeof(BinaryCacheValue));
+    g_byte_array_append(contents, (guint8 *)writer.strtab->str,
+                        writer.strtab->len);
+
+out:
+    g_array_free(writer.nodes, TRUE);
+    g_array_free(writer.values, TRUE);
+    g_string_free(writer.strtab, TRUE);
+
+    return contents;
+}
+
+static void
+blconf_binary_cache_save(BlconfBackendPerchannelXml *xbpx,
+                         const gchar *channel_name,
+                         BlconfChannel *channel,
+                         GPtrArray *sources,
+                         const BinaryCacheSource *stats)
+{
+    GByteArray *contents;
+    gchar *filename;
+    GError *error = NULL;
+
+    if(!xbpx->cache_save_path)
+        return;
+
+    contents = blconf_binary_cache_serialize(channel_name, channel, sources,
+                                             stats);
+    if(!contents)
+        return;
+
+    filename = g_strdup_printf(BINARY_CACHE_FILE_FMT, xbpx->cache_save_path,
+                               channel_name);
+    if(!g_file_set_contents(filename, (gchar *)contents->data, contents->len,
+                            &error))
+    {
+        DBG("unable to write binary cache \"%s\": %s", filename,
+            error->message);
+        g_error_free(error);
+    }
+    g_free(filename);
+
+    g_byte_array_free(contents, TRUE);
+}
+
+/* Shared defaults.
+ *
+ * On a machine with many sessions, every blconfd would parse the same
+ * system files, and keep its own copy of what's in them.  If the
+ * shared defaults directory exists (LOCALSTATEDIR/cache/blconf, or
+ * wherever BLCONFD_SHARED_DEFAULTS points; an empty value turns this
+ * off), the merge of each channel's system files is kept there, as
+ * "<channel>.defaults" in the binary cache format.  A daemon that finds
+ * one matching the system files builds the channel from the mapped
+ * file, with the strings pointing right into the mapping, so they take
+ * one page cache copy for the whole machine; only the user's own file
+ * is parsed on top, and the per-user binary cache isn't used.
+ *
+ * The files are written by blconfd --build-shared-defaults, and by any
+ * daemon that finds one missing or stale and is allowed to write
+ * there.  A file is only trusted if it belongs to root or to the user
+ * the daemon runs as, and nobody else can write to it.  Lock lists
+ * are resolved per user, so a channel whose system files have any is
+ * never shared. */
+
+static gchar *
+blconf_shared_defaults_get_dir(void)
+{
+    const gchar *dir = g_getenv("BLCONFD_SHARED_DEFAULTS");
+
+    if(!dir)
+        dir = SHARED_DEFAULTS_DIR;
+    if(!*dir || !g_file_test(dir, G_FILE_TEST_IS_DIR))
+        return NULL;
+
+    return g_strdup(dir);
+}
+
+/* the system files at the start of |sources|, which is all the shared
+ * defaults are built from; the stats for them are the same */
+static GPtrArray *
+blconf_shared_defaults_get_sources(GPtrArray *sources,
+                                   guint n_system_files)
+{
+    GPtrArray *system_sources = g_ptr_array_sized_new(n_system_files);
+    guint i;
+
+    for(i = 0; i < n_system_files; ++i)
+        g_ptr_array_add(system_sources, g_ptr_array_index(sources, i));
+
+    return system_sources;
+}
+
+static BlconfChannel *
+blconf_shared_defaults_load(BlconfBackendPerchannelXml *xbpx,
+                            const gchar *channel_name,
+                            GPtrArray *sources,
+                            guint n_system_files,
+                            const BinaryCacheSource *stats)
+{
+    BlconfChannel *channel;
+    GPtrArray *system_sources;
+    GMappedFile *mmap_file;
+    struct stat st;
+    gchar *filename;
+    gint fd;
+
+    if(!xbpx->shared_defaults_path || !n_system_files)
+        return NULL;
+
+    filename = g_strdup_printf(SHARED_DEFAULTS_FILE_FMT,
+                               xbpx->shared_defaults_path, channel_name);
+    fd = open(filename, O_RDONLY);
+    g_free(filename);
+    if(fd < 0)
+        return NULL;
+
+    /* whatever is in it goes into every session */
+    if(fstat(fd, &st) || !S_ISREG(st.st_mode)
+       || (st.st_uid != 0 && st.st_uid != getuid())
+       || (st.st_mode & (S_IWGRP | S_IWOTH)))
+    {
+        DBG("not trusting the shared defaults of channel \"%s\"", channel_name);
+        close(fd);
+        return NULL;
+    }
+
+    mmap_file = g_mapped_file_new_from_fd(fd, FALSE, NULL);
+    close(fd);
+    if(!mmap_file)
+        return NULL;
+
+    system_sources = blconf_shared_defaults_get_sources(sources,
+                                                        n_system_files);
+    channel = blconf_binary_cache_parse(channel_name,
+                                        g_mapped_file_get_contents(mmap_file),
+                                        g_mapped_file_get_length(mmap_file),
+                                        system_sources, stats, TRUE);
+    g_ptr_array_free(system_sources, TRUE);
+
+    if(channel) {
+        DBG("loaded the defaults of channel \"%s\" from the shared copy",
+            channel_name);
+        channel->shared_defaults = mmap_file;
+    } else
+        g_mapped_file_unref(mmap_file);
+
+    return channel;
+}
+
+/* |channel| has just the system files merged in.  unless |force|, the
+ * file is only written if the directory lets us */
+static gboolean
+blconf_shared_defaults_save(BlconfBackendPerchannelXml *xbpx,
+                            const gchar *channel_name,
+                            BlconfChannel *channel,
+                            GPtrArray *sources,
+                            guint n_system_files,
+                            const BinaryCacheSource *stats,
+                            gboolean force,
+                            GError **error)
+{
+    GPtrArray *system_sources;
+    GByteArray *contents;
+    gchar *filename;
+    gboolean ret;
+
+    if(!xbpx->shared_defaults_path || !n_system_files
+       || channel->per_user_locks
+       || (!force && access(xbpx->shared_defaults_path, W_OK)))
+    {
+        return FALSE;
+    }
+
+    system_sources = blconf_shared_defaults_get_sources(sources,
+                                                        n_system_files);
+    contents = blconf_binary_cache_serialize(channel_name, channel,
+                                             system_sources, stats);
+    g_ptr_array_free(system_sources, TRUE);
+    if(!contents)
+        return FALSE;
+
+    filename = g_strdup_printf(SHARED_DEFAULTS_FILE_FMT,
+                               xbpx->shared_defaults_path, channel_name);
+    ret = g_file_set_contents(filename, (gchar *)contents->data,
+                              contents->len, error);
+    if(ret)
+        DBG("wrote the shared defaults of channel \"%s\"", channel_name);
+    g_free(filename);
+
+    g_byte_array_free(contents, TRUE);
+
+    return ret;
+}
+
+/**
+ * blconf_backend_perchannel_xml_build_shared_defaults:
+ * @error: Where to store an error, if any.
+ *
+ * Writes the shared defaults of every channel that has a system file
+ * and can be shared, replacing any that are there already.  This is
+ * what blconfd --build-shared-defaults does; it needs write access to
+ * the shared defaults directory, and doesn't need a running daemon.
+ *
+ * Returns: %TRUE on success, %FALSE if the directory doesn't exist or
+ *          a file couldn't be written.
+ **/
+gboolean
+blconf_backend_perchannel_xml_build_shared_defaults(GError **error)
+{
+    BlconfBackendPerchannelXml *xbpx;
+    GHashTable *names;
+    GHashTableIter iter;
+    gpointer key;
+    gchar **dirs;
+    gboolean ret = TRUE;
+    guint i;
+
+    xbpx = g_object_new(BLCONF_TYPE_BACKEND_PERCHANNEL_XML, NULL);
+    xbpx->shared_defaults_path = blconf_shared_defaults_get_dir();
+    if(!xbpx->shared_defaults_path) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_WRITE_FAILURE,
+                    _("There is no directory for the shared defaults"));
+        g_object_unref(xbpx);
+        return FALSE;
+    }
+
+    /* every channel any of the directories has a file for */
+    names = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                  (GDestroyNotify)g_free, NULL);
+    dirs = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG, CONFIG_DIR_STEM);
+    for(i = 0; dirs && dirs[i]; ++i) {
+        GDir *dir = g_dir_open(dirs[i], 0, NULL);
+        const gchar *name;
+
+        if(!dir)
+            continue;
+        while((name = g_dir_read_name(dir))) {
+            if(g_str_has_suffix(name, ".xml")) {
+                g_hash_table_replace(names,
+                                     g_strndup(name, strlen(name) - 4),
+                                     GINT_TO_POINTER(TRUE));
+            }
+        }
+        g_dir_close(dir);
+    }
+    g_strfreev(dirs);
+
+    g_hash_table_iter_init(&iter, names);
+    while(ret && g_hash_table_iter_next(&iter, &key, NULL)) {
+        const gchar *channel_name = key;
+        BlconfChannel *channel;
+        gchar **filenames = NULL, *user_file = NULL;
+        GPtrArray *sources;
+        BinaryCacheSource *stats;
+        guint n_system_files;
+
+        blconf_backend_perchannel_xml_find_files(channel_name, &filenames,
+                                                 &user_file);
+        sources = blconf_binary_cache_get_sources(filenames, user_file,
+                                                  &n_system_files);
+        stats = g_new(BinaryCacheSource, sources->len);
+        blconf_binary_cache_stat_sources(sources, stats);
+
+        channel = blconf_channel_new();
+        for(i = 0; i < n_system_files; ++i) {
+            blconf_backend_perchannel_xml_merge_file(xbpx,
+                                                     g_ptr_array_index(sources, i),
+                                                     TRUE, channel, NULL);
+        }
+
+        if(channel->per_user_locks) {
+            g_message("Channel \"%s\" locks properties per user or group, not sharing its defaults",
+                      channel_name);
+        } else if(n_system_files) {
+            ret = blconf_shared_defaults_save(xbpx, channel_name, channel,
+                                              sources, n_system_files, stats,
+                                              TRUE, error);
+        }
+
+        blconf_channel_unref(channel);
+        g_ptr_array_free(sources, TRUE);
+        g_free(stats);
+        g_strfreev(filenames);
+        g_free(user_file);
+    }
+
+    g_hash_table_destroy(names);
+    g_object_unref(xbpx);
+
+    return ret;
+}
+
+/* The journal is an optional log of the changes made to a channel
+ * since its user file was last written.  Each set or reset appends one
+ * line: an opcode ('S'et, 'R'eset, recursive 'T'ree reset or array
+ * 'P'atch), then tab-separated, g_strescape()d fields with the
+ * property name and, for sets, the type and value.  Arrays are written
+ * as "array", the number of elements and a type/value pair for each
+ * one.  A patch has the position and the number of elements removed
+ * before the array of the ones put in their place.  The journal is
+ * replayed on top of the user file when the channel is loaded, and
+ * dropped whenever the whole channel is written out again. */
+
+static void
+blconf_journal_append_field(GString *str,
+                            const gchar *field)
+{
+    gchar *escaped = g_strescape(field, NULL);
+
+    g_string_append_c(str, '\t');
+    g_string_append(str, escaped);
+    g_free(escaped);
+}
+
+static gboolean
+blconf_journal_append_scalar(GString *str,
+                             const GValue *value)
+{
+    const gchar *type = _blconf_string_from_gtype(G_VALUE_TYPE(value));
+    gchar *value_str;
+
+    if(!type || G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY)
+        return FALSE;
+
+    value_str = _blconf_string_from_gvalue((GValue *)value);
+    if(!value_str)
+        return FALSE;
+
+    blconf_journal_append_field(str, type);
+    blconf_journal_append_field(str, value_str);
+    g_free(value_str);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_journal_append_value(GString *str,
+                            const GValue *value)
+{
+    if(G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY) {
+        GPtrArray *arr = g_value_get_boxed(value);
+        guint i;
+
+        g_string_append_printf(str, "\tarray\t%u", arr ? arr->len : 0);
+        for(i = 0; arr && i < arr->len; ++i) {
+            if(!blconf_journal_append_scalar(str, g_ptr_array_index(arr, i)))
+                return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    return blconf_journal_append_scalar(str, value);
+}
+
+static void
+blconf_backend_perchannel_xml_journal_record(BlconfBackendPerchannelXml *xbpx,
+                                             BlconfChannel *channel,
+                                             gchar op,
+                                             const gchar *property,
+                                             const GValue *value)
+{
+    gsize start;
+
+    /* without a user file to base it on, the next save writes the
+     * whole channel anyway */
+    if(!xbpx->use_journal || !channel->journal_base)
+        return;
+
+    if(!channel->journal)
+        channel->journal = g_string_sized_new(128);
+    start = channel->journal->len;
+
+    g_string_append_c(channel->journal, op);
+    blconf_journal_append_field(channel->journal, property);
+    if(value && !blconf_journal_append_value(channel->journal, value)) {
+        /* can't be expressed as a record; fall back to a full write */
+        g_string_truncate(channel->journal, start);
+        channel->journal_base = FALSE;
+        return;
+    }
+    g_string_append_c(channel->journal, '\n');
+
+    channel->journal_records++;
+}
+
+static void
+blconf_backend_perchannel_xml_journal_record_splice(BlconfBackendPerchannelXml *xbpx,
+                                                    BlconfChannel *channel,
+                                                    const gchar *property,
+                                                    const BlconfArraySplice *splice)
+{
+    GValue values = { 0, };
+    gsize start;
+
+    if(!xbpx->use_journal || !channel->journal_base)
+        return;
+
+    if(!channel->journal)
+        channel->journal = g_string_sized_new(128);
+    start = channel->journal->len;
+
+    g_string_append_c(channel->journal, 'P');
+    blconf_journal_append_field(channel->journal, property);
+    g_string_append_printf(channel->journal, "\t%u\t%u", splice->position,
+                           splice->n_remove);
+
+    g_value_init(&values, BLCONF_TYPE_G_VALUE_ARRAY);
+    g_value_set_static_boxed(&values, splice->values);
+    if(!blconf_journal_append_value(channel->journal, &values)) {
+        g_string_truncate(channel->journal, start);
+        channel->journal_base = FALSE;
+        g_value_unset(&values);
+        return;
+    }
+    g_value_unset(&values);
+    g_string_append_c(channel->journal, '\n');
+
+    channel->journal_records++;
+}
+
+static gboolean
+blconf_journal_parse_scalar(const gchar *type,
+                            const gchar *value_str,
+                            GValue *value)
+{
+    GType value_type = _blconf_gtype_from_string(type);
+    gchar *str;
+    gboolean ret;
+
+    if(G_TYPE_INVALID == value_type || G_TYPE_NONE == value_type
+       || BLCONF_TYPE_G_VALUE_ARRAY == value_type)
+    {
+        return FALSE;
+    }
+
+    str = g_strcompress(value_str);
+    g_value_init(value, value_type);
+    ret = _blconf_gvalue_from_string(value, str);
+    g_free(str);
+
+    if(!ret)
+        g_value_unset(value);
+
+    return ret;
+}
+
+static gboolean
+blconf_journal_parse_value(gchar **fields,
+                           guint n_fields,
+                           GValue *value)
+{
+    GPtrArray *arr;
+    gchar *endptr = NULL;
+    gulong n_elems, i;
+
+    if(n_fields < 2)
+        return FALSE;
+
+    if(strcmp(fields[0], "array"))
+        return n_fields == 2 && blconf_journal_parse_scalar(fields[0], fields[1],
+                                                            value);
+
+    n_elems = strtoul(fields[1], &endptr, 10);
+    if(!*fields[1] || *endptr || n_fields != 2 + n_elems * 2)
+        return FALSE;
+
+    arr = g_ptr_array_sized_new(n_elems);
+    for(i = 0; i < n_elems; ++i) {
+        GValue *elem = g_new0(GValue, 1);
+
+        if(!blconf_journal_parse_scalar(fields[2 + i * 2], fields[3 + i * 2],
+                                        elem))
+        {
+            g_free(elem);
+            g_ptr_array_foreach(arr, (GFunc)_blconf_gvalue_free, NULL);
+            g_ptr_array_free(arr, TRUE);
+            return FALSE;
+        }
+        g_ptr_array_add(arr, elem);
+    }
+
+    g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+    g_value_take_boxed(value, arr);
+
+    return TRUE;
+}
+
+static gboolean
+nodes_unset_value(GNode *node,
+                  gpointer data)
+{
+    BlconfProperty *prop = node->data;
+
+    if(G_VALUE_TYPE(&prop->value))
+        g_value_unset(&prop->value);
+    blconf_property_drop_wire(prop);
+
+    return FALSE;
+}
+
+static gboolean
+blconf_journal_apply_record(BlconfChannel *channel,
+                            gchar *line)
+{
+    gchar **fields = g_strsplit(line, "\t", -1);
+    guint n_fields = g_strv_length(fields);
+    gboolean ret = FALSE;
+    gchar *property;
+
+    if(n_fields < 2 || fields[0][0] == 0 || fields[0][1] != 0) {
+        g_strfreev(fields);
+        return FALSE;
+    }
+
+    property = g_strcompress(fields[1]);
+    if(!PROP_NAME_IS_VALID(property))
+        goto out;
+
+    switch(fields[0][0]) {
+        case 'S': {
+            GValue value = { 0, };
+            BlconfProperty *prop;
+
+            if(!blconf_journal_parse_value(fields + 2, n_fields - 2, &value))
+                goto out;
+
+            prop = blconf_proptree_lookup(channel, property);
+            if(!prop)
+                blconf_proptree_add_property(channel, property, &value, NULL, FALSE);
+            else if(!prop->locked) {
+                if(G_VALUE_TYPE(&prop->value))
+                    g_value_unset(&prop->value);
+                blconf_property_drop_wire(prop);
+                g_value_copy(&value, g_value_init(&prop->value,
+                                                  G_VALUE_TYPE(&value)));
+            }
+            g_value_unset(&value);
+            break;
+        }
+
+        case 'R':
+            if(n_fields != 2)
+                goto out;
+            blconf_proptree_reset(channel, property);
+            break;
+
+        case 'P': {
+            GValue values = { 0, }, patched = { 0, };
+            BlconfArraySplice splice;
+            BlconfProperty *prop;
+            const GValue *effective;
+            gchar *endptr = NULL;
+            gulong position, n_remove;
+
+            if(n_fields < 4 || !*fields[2] || !*fields[3])
+                goto out;
+            position = strtoul(fields[2], &endptr, 10);
+            if(*endptr || position > G_MAXUINT)
+                goto out;
+            n_remove = strtoul(fields[3], &endptr, 10);
+            if(*endptr || n_remove > G_MAXUINT)
+                goto out;
+
+            if(!blconf_journal_parse_value(fields + 4, n_fields - 4, &values))
+                goto out;
+            if(G_VALUE_TYPE(&values) != BLCONF_TYPE_G_VALUE_ARRAY) {
+                g_value_unset(&values);
+                goto out;
+            }
+
+            prop = blconf_proptree_lookup(channel, property);
+            effective = prop ? blconf_property_get_effective_value(prop) : NULL;
+            if(!effective) {
+                g_value_unset(&values);
+                goto out;
+            }
+
+            if(!prop->locked) {
+                splice.position = position;
+                splice.n_remove = n_remove;
+                splice.values = g_value_get_boxed(&values);
+
+                g_value_copy(effective, g_value_init(&patched,
+                                                     G_VALUE_TYPE(effective)));
+                if(!_blconf_gvalue_splice(&patched, &splice, 1)) {
+                    g_value_unset(&patched);
+                    g_value_unset(&values);
+                    goto out;
+                }
+                if(G_VALUE_TYPE(&prop->value))
+                    g_value_unset(&prop->value);
+                blconf_property_drop_wire(prop);
+                prop->value = patched;
+            }
+            g_value_unset(&values);
+            break;
+        }
+
+        case 'T': {
+            GNode *top;
+
+            if(n_fields != 2)
+                goto out;
+
+            top = blconf_proptree_lookup_node(channel->properties, property);
+            if(top) {
+                g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
+                                nodes_unset_value, NULL);
+                g_node_traverse(top, G_POST_ORDER, G_TRAVERSE_ALL, -1,
+                                nodes_clean_up, channel);
+            }
+            break;
+        }
+
+        default:
+            goto out;
+    }
+
+    ret = TRUE;
+
+out:
+    g_free(property);
+    g_strfreev(fields);
+
+    return ret;
+}
+
+static void
+blconf_backend_perchannel_xml_replay_journal(BlconfBackendPerchannelXml *xbpx,
+                                             const gchar *channel_name,
+                                             BlconfChannel *channel)
+{
+    gchar *filename, *contents = NULL, *line, *end;
+    gsize length = 0;
+    GError *error = NULL;
+
+    filename = g_strdup_printf(JOURNAL_FILE_FMT, xbpx->config_save_path,
+                               channel_name);
+    if(!g_file_get_contents(filename, &contents, &length, &error)) {
+        if(!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning("Unable to read journal \"%s\": %s", filename, error->message);
+        g_error_free(error);
+        g_free(filename);
+        return;
+    }
+
+    for(line = contents; (end = memchr(line, '\n', contents + length - line));
+        line = end + 1)
+    {
+        *end = 0;
+        if(!blconf_journal_apply_record(channel, line)) {
+            g_warning("Skipping invalid record in journal \"%s\"", filename);
+            channel->journal_base = FALSE;
+        }
+        channel->journal_records++;
+    }
+
+    /* a record cut short by a crash never made it to disk as far as
+     * the client is concerned; don't append after it, though */
+    if(line != contents + length)
+        channel->journal_base = FALSE;
+
+    channel->journal_size = length;
+
+    g_free(contents);
+    g_free(filename);
+}
+
+/* Clients polling for a channel that doesn't exist would otherwise
+ * cost us a round of stat()s across all the config dirs every time.
+ * A miss is remembered for MISSING_TIMEOUT seconds, or until the
+ * channel is created through us.  Like |channels|, the table goes by
+ * the lower-case name. */
+static gboolean
+blconf_backend_perchannel_xml_channel_is_missing(BlconfBackendPerchannelXml *xbpx,
+                                                 const gchar *channel_name)
+{
+    gpointer expiry;
+    gchar *key = g_ascii_strdown(channel_name, -1);
+    gboolean missing = FALSE;
+
+    if(g_hash_table_lookup_extended(xbpx->missing_channels, key, NULL,
+                                    &expiry))
+    {
+        if(g_get_monotonic_time() / G_USEC_PER_SEC < GPOINTER_TO_UINT(expiry))
+            missing = TRUE;
+        else
+            g_hash_table_remove(xbpx->missing_channels, key);
+    }
+    g_free(key);
+
+    return missing;
+}
+
+static void
+blconf_backend_perchannel_xml_set_channel_missing(BlconfBackendPerchannelXml *xbpx,
+                                                  const gchar *channel_name)
+{
+    guint expiry = g_get_monotonic_time() / G_USEC_PER_SEC + MISSING_TIMEOUT;
+
+    /* keep a client making up names from growing this forever */
+    if(g_hash_table_size(xbpx->missing_channels) >= MISSING_MAX)
+        g_hash_table_remove_all(xbpx->missing_channels);
+
+    g_hash_table_insert(xbpx->missing_channels,
+                        g_ascii_strdown(channel_name, -1),
+                        GUINT_TO_POINTER(expiry));
+}
+
+static void
+blconf_backend_perchannel_xml_clear_channel_missing(BlconfBackendPerchannelXml *xbpx,
+                                                    const gchar *channel_name)
+{
+    gchar *key = g_ascii_strdown(channel_name, -1);
+
+    g_hash_table_remove(xbpx->missing_channels, key);
+    g_free(key);
+}
+
+/* all the files |channel_name| could be read from; FALSE if there's
+ * nowhere at all it could be */
+static gboolean
+blconf_backend_perchannel_xml_find_files(const gchar *channel_name,
+                                         gchar ***filenames,
+                                         gchar **user_file)
+{
+    gchar *filename_stem = g_strdup_printf(CONFIG_FILE_FMT, channel_name);
+
+    *filenames = xfce_resource_lookup_all(XFCE_RESOURCE_CONFIG, filename_stem);
+    *user_file = xfce_resource_save_location(XFCE_RESOURCE_CONFIG,
+                                             filename_stem, FALSE);
+    g_free(filename_stem);
+
+    return (*filenames && (*filenames)[0]) || *user_file;
+}
+
+/* builds the channel from its files, without adding it to the backend;
+ * |handoff| is the snapshot the previous daemon had, if any, which is
+ * used in place of the cache file */
+static BlconfChannel *
+blconf_backend_perchannel_xml_read_channel(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name,
+                                           GBytes *handoff,
+                                           GError **error)
+{
+    BlconfChannel *channel = NULL;
+    gchar **filenames = NULL, *user_file = NULL;
+    GPtrArray *sources;
+    BinaryCacheSource *stats;
+    guint i, n_system_files;
+
+    BLCONF_PROBE1(load__channel__start, channel_name);
+
+    if(!blconf_backend_perchannel_xml_find_files(channel_name, &filenames,
+                                                 &user_file))
+    {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_CHANNEL_NOT_FOUND,
+                        _("Channel \"%s\" does not exist"), channel_name);
+        }
+        goto out;
+    }
+
+    /* stat everything before parsing, so a file that changes while we
+     * read it invalidates the snapshot we write below */
+    sources = blconf_binary_cache_get_sources(filenames, user_file,
+                                              &n_system_files);
+    stats = g_new(BinaryCacheSource, sources->len);
+    blconf_binary_cache_stat_sources(sources, stats);
+
+    if(handoff) {
+        channel = blconf_binary_cache_parse(channel_name,
+                                            g_bytes_get_data(handoff, NULL),
+                                            g_bytes_get_size(handoff),
+                                            sources, stats, FALSE);
+        if(channel)
+            DBG("took over channel \"%s\" from the previous daemon", channel_name);
+    } else {
+        /* the defaults everyone shares, with just the user file parsed
+         * on top; see the shared defaults section */
+        channel = blconf_shared_defaults_load(xbpx, channel_name, sources,
+                                              n_system_files, stats);
+        if(channel) {
+            if(!channel->locked && user_file) {
+                blconf_backend_perchannel_xml_merge_file(xbpx, user_file,
+                                                         FALSE, channel,
+                                                         NULL);
+            }
+        } else
+            channel = blconf_binary_cache_load(xbpx, channel_name, sources,
+                                               stats);
+    }
+    if(!channel) {
+        channel = blconf_channel_new();
+
+        /* read in system files, we do this in reversed order to properly
+         * follow the xdg spec, see bug #6079 for more information; the
+         * source list is already in that order */
+        for(i = 0; i < n_system_files; ++i) {
+            blconf_backend_perchannel_xml_merge_file(xbpx,
+                                                     g_ptr_array_index(sources, i),
+                                                     TRUE, channel, NULL);
+        }
+
+        /* missing or stale; the next daemon can use it, if we may
+         * write it */
+        blconf_shared_defaults_save(xbpx, channel_name, channel, sources,
+                                    n_system_files, stats, FALSE, NULL);
+
+        if(!channel->locked && user_file) {
+            /* read in user file */
+            blconf_backend_perchannel_xml_merge_file(xbpx, user_file, FALSE,
+                                                     channel, NULL);
+        }
+
+        blconf_binary_cache_save(xbpx, channel_name, channel, sources, stats);
+    }
+
+    /* the snapshot only covers the xml files; changes logged since the
+     * user file was written are applied on top */
+    if(!channel->locked && user_file) {
+        channel->journal_base = stats[n_system_files].exists;
+        blconf_backend_perchannel_xml_replay_journal(xbpx, channel_name,
+                                                     channel);
+    }
+
+    blconf_channel_update_lock_summary(channel);
+
+    g_ptr_array_free(sources, TRUE);
+    g_free(stats);
+
+out:
+    g_strfreev(filenames);
+    g_free(user_file);
+
+    BLCONF_PROBE2(load__channel__done, channel_name, channel != NULL);
+
+    return channel;
+}
+
+/* Channels are read with |channels_lock| dropped, so that several of
+ * them can load at once, see _preload().  The names being read are
+ * kept in |loading_channels|, and anyone else wanting one of those
+ * waits for it on |channels_cond| instead of reading it a second time.
+ * A reset, or the files changing on disk, marks a load in progress as
+ * stale; its result is thrown away and the channel is read again. */
+
+/* called with |channels_lock| held, returns once nobody is loading
+ * |channel_name| */
+static void
+blconf_backend_perchannel_xml_wait_loading(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name)
+{
+    gchar *key;
+
+    if(G_LIKELY(!g_hash_table_size(xbpx->loading_channels)))
+        return;
+
+    key = g_ascii_strdown(channel_name, -1);
+    while(g_hash_table_lookup_extended(xbpx->loading_channels, key, NULL, NULL))
+        channels_cond_wait(xbpx);
+    g_free(key);
+}
+
+/* called with |channels_lock| held */
+static void
+blconf_backend_perchannel_xml_invalidate_loading(BlconfBackendPerchannelXml *xbpx,
+                                                 const gchar *channel_name)
+{
+    gchar *key = g_ascii_strdown(channel_name, -1);
+
+    if(g_hash_table_lookup_extended(xbpx->loading_channels, key, NULL, NULL))
+        g_hash_table_replace(xbpx->loading_channels, key, GINT_TO_POINTER(TRUE));
+    else
+        g_free(key);
+}
+
+/* called with |channels_lock| held, which is dropped while the files
+ * are read; nobody else may be loading |channel_name| */
+static BlconfChannel *
+blconf_backend_perchannel_xml_load_channel(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *channel_name,
+                                           GError **error)
+{
+    BlconfChannel *channel;
+    GBytes *handoff;
+    gchar *key;
+    gboolean stale;
+
+    TRACE("entering");
+
+    if(blconf_backend_perchannel_xml_channel_is_missing(xbpx, channel_name)) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_CHANNEL_NOT_FOUND,
+                        _("Channel \"%s\" does not exist"), channel_name);
+        }
+        return NULL;
+    }
+
+    key = g_ascii_strdown(channel_name, -1);
+
+    do {
+        /* only good for the first try; a stale load means it changed */
+        handoff = g_hash_table_lookup(xbpx->handoff_channels, key);
+        if(handoff) {
+            g_bytes_ref(handoff);
+            g_hash_table_remove(xbpx->handoff_channels, key);
+        }
+
+        g_hash_table_insert(xbpx->loading_channels, g_strdup(key),
+                            GINT_TO_POINTER(FALSE));
+        channels_mutex_unlock(xbpx);
+
+        channel = blconf_backend_perchannel_xml_read_channel(xbpx, channel_name,
+                                                             handoff, error);
+        if(handoff)
+            g_bytes_unref(handoff);
+
+        channels_mutex_lock(xbpx);
+        stale = GPOINTER_TO_INT(g_hash_table_lookup(xbpx->loading_channels, key));
+        g_hash_table_remove(xbpx->loading_channels, key);
+        channels_cond_broadcast(xbpx);
+
+        if(stale) {
+            DBG("Channel \"%s\" changed while loading, reading it again",
+                channel_name);
+            if(channel)
+                blconf_channel_unref(channel);
+            else if(error)
+                g_clear_error(error);
+        }
+    } while(stale);
+
+    g_free(key);
+
+    if(!channel) {
+        blconf_backend_perchannel_xml_set_channel_missing(xbpx, channel_name);
+        return NULL;
+    }
+
+    blconf_backend_perchannel_xml_add_channel(xbpx, channel_name, channel);
+
+    return channel;
+}
+
+/* Loading a channel is mostly parsing, so the ones a session is going
+ * to ask for anyway are read on a few threads as soon as the daemon
+ * starts.  Besides the channels given on the command line, that's the
+ * ones the last session used, which are remembered in the cache dir
+ * when the backend goes away. */
+
+/* called with |channels_lock| held, from ref_channel() only, so
+ * channels nobody asked for don't stay on the list just because they
+ * were preloaded */
+static void
+blconf_backend_perchannel_xml_note_hot_channel(BlconfBackendPerchannelXml *xbpx,
+                                               BlconfChannel *channel)
+{
+    guint n_hot = g_hash_table_size(xbpx->hot_channels);
+
+    if(n_hot >= HOT_CHANNELS_MAX
+       || g_hash_table_lookup_extended(xbpx->hot_channels, channel->name,
+                                       NULL, NULL))
+    {
+        return;
+    }
+
+    g_hash_table_insert(xbpx->hot_channels, g_strdup(channel->name),
+                        GUINT_TO_POINTER(n_hot));
+}
+
+static gint
+blconf_hot_channel_compare(gconstpointer a,
+                           gconstpointer b,
+                           gpointer user_data)
+{
+    GHashTable *hot_channels = user_data;
+    guint order_a = GPOINTER_TO_UINT(g_hash_table_lookup(hot_channels,
+                                                         *(const gchar **)a));
+    guint order_b = GPOINTER_TO_UINT(g_hash_table_lookup(hot_channels,
+                                                         *(const gchar **)b));
+
+    return order_a < order_b ? -1 : (order_a > order_b ? 1 : 0);
+}
+
+/* writes the channels used this session, in the order they were
+ * first used */
+static void
+blconf_backend_perchannel_xml_save_hot_channels(BlconfBackendPerchannelXml *xbpx)
+{
+    GPtrArray *names;
+    GHashTableIter iter;
+    gpointer key;
+    GString *contents;
+    gchar *filename;
+    GError *error = NULL;
+    guint i;
+
+    if(!xbpx->cache_save_path || !g_hash_table_size(xbpx->hot_channels))
+        return;
+
+    names = g_ptr_array_sized_new(g_hash_table_size(xbpx->hot_channels));
+    g_hash_table_iter_init(&iter, xbpx->hot_channels);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+        g_ptr_array_add(names, key);
+    g_ptr_array_sort_with_data(names, blconf_hot_channel_compare,
+                               xbpx->hot_channels);
+
+    contents = g_string_new(NULL);
+    for(i = 0; i < names->len; ++i) {
+        g_string_append(contents, g_ptr_array_index(names, i));
+        g_string_append_c(contents, '\n');
+    }
+
+    filename = g_build_filename(xbpx->cache_save_path, HOT_CHANNELS_FILE, NULL);
+    if(!g_file_set_contents(filename, contents->str, contents->len, &error)) {
+        DBG("unable to write \"%s\": %s", filename, error->message);
+        g_error_free(error);
+    }
+
+    g_free(filename);
+    g_string_free(contents, TRUE);
+    g_ptr_array_free(names, TRUE);
+}
+
+/* runs in one of the preloader threads */
+static void
+blconf_backend_perchannel_xml_preload_channel(gpointer data,
+                                              gpointer user_data)
+{
+    BlconfBackendPerchannelXml *xbpx = user_data;
+    gchar *channel_name = data;
+
+    channels_mutex_lock(xbpx);
+    blconf_backend_perchannel_xml_wait_loading(xbpx, channel_name);
+    if(!blconf_backend_perchannel_xml_lookup_channel(xbpx, channel_name))
+        blconf_backend_perchannel_xml_load_channel(xbpx, channel_name, NULL);
+    channels_mutex_unlock(xbpx);
+
+    g_free(channel_name);
+}
+
+static void
+blconf_backend_perchannel_xml_preload_add(BlconfBackendPerchannelXml *xbpx,
+                                          GHashTable *seen,
+                                          const gchar *channel_name)
+{
+    gchar *name;
+
+    /* the list in the cache dir is only as trustworthy as the dir */
+    if(!*channel_name || strchr(channel_name, '/') || *channel_name == '.')
+        return;
+
+    name = g_ascii_strdown(channel_name, -1);
+    if(g_hash_table_lookup_extended(seen, name, NULL, NULL)) {
+        g_free(name);
+        return;
+    }
+
+    g_hash_table_insert(seen, name, NULL);
+    g_thread_pool_push(xbpx->preloader, g_strdup(name), NULL);
+}
+
+static void
+blconf_backend_perchannel_xml_preload(BlconfBackend *backend,
+                                      const gchar * const *channels)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GHashTable *seen;
+    GPtrArray *handoff;
+    GHashTableIter iter;
+    gpointer key;
+    gchar *filename, *contents = NULL, **hot = NULL;
+    guint i;
+
+    if(!xbpx->preloader) {
+        xbpx->preloader = g_thread_pool_new(blconf_backend_perchannel_xml_preload_channel,
+                                            xbpx, PRELOAD_THREADS, FALSE,
+                                            NULL);
+    }
+
+    seen = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                 (GDestroyNotify)g_free, NULL);
+
+    /* the ones asked for explicitly go first */
+    for(i = 0; channels && channels[i]; ++i)
+        blconf_backend_perchannel_xml_preload_add(xbpx, seen, channels[i]);
+
+    /* then the ones the previous daemon handed over, which are quick;
+     * the preloader takes them out of the table as they're read */
+    handoff = g_ptr_array_new_with_free_func((GDestroyNotify)g_free);
+    channels_mutex_lock(xbpx);
+    g_hash_table_iter_init(&iter, xbpx->handoff_channels);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+        g_ptr_array_add(handoff, g_strdup(key));
+    channels_mutex_unlock(xbpx);
+    for(i = 0; i < handoff->len; ++i)
+        blconf_backend_perchannel_xml_preload_add(xbpx, seen,
+                                                  g_ptr_array_index(handoff, i));
+    g_ptr_array_free(handoff, TRUE);
+
+    if(xbpx->cache_save_path) {
+        filename = g_build_filename(xbpx->cache_save_path, HOT_CHANNELS_FILE,
+                                    NULL);
+        if(g_file_get_contents(filename, &contents, NULL, NULL))
+            hot = g_strsplit(contents, "\n", HOT_CHANNELS_MAX + 1);
+        g_free(filename);
+    }
+
+    for(i = 0; hot && hot[i] && i < HOT_CHANNELS_MAX; ++i)
+        blconf_backend_perchannel_xml_preload_add(xbpx, seen, g_strstrip(hot[i]));
+
+    DBG("preloading %u channel(s)", g_hash_table_size(seen));
+
+    g_strfreev(hot);
+    g_free(contents);
+    g_hash_table_destroy(seen);
+}
+
+/* What a replacement daemon gets from us, see blconfd --replace: an
+ * a{sv} with "channels", a(say) holding each loaded channel in the
+ * binary cache layout, and "missing", a(su) with the names known not
+ * to exist and the seconds that still holds for.  The snapshots are
+ * taken against the files as they are after the final flush, and the
+ * successor checks them like it would a cache file, so a channel that
+ * changed on disk in between is just read again.  The hot list is
+ * written out here too, so the new preloader sees the same one. */
+static GVariant *
+blconf_backend_perchannel_xml_save_state(BlconfBackend *backend)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GVariantBuilder builder, channels, missing;
+    GPtrArray *resident;
+    GHashTableIter iter;
+    gpointer key, value;
+    guint now = g_get_monotonic_time() / G_USEC_PER_SEC;
+    guint i;
+
+    resident = g_ptr_array_new_with_free_func((GDestroyNotify)blconf_channel_unref);
+    g_variant_builder_init(&missing, G_VARIANT_TYPE("a(su)"));
+
+    channels_mutex_lock(xbpx);
+    g_hash_table_iter_init(&iter, xbpx->channels);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        BlconfChannel *channel = value;
+
+        /* still dirty means the write failed; what's on disk is what
+         * the successor has to start from */
+        if(!channel->dirty)
+            g_ptr_array_add(resident, blconf_channel_ref(channel));
+    }
+    g_hash_table_iter_init(&iter, xbpx->missing_channels);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        if(GPOINTER_TO_UINT(value) > now) {
+            g_variant_builder_add(&missing, "(su)", key,
+                                  GPOINTER_TO_UINT(value) - now);
+        }
+    }
+    blconf_backend_perchannel_xml_save_hot_channels(xbpx);
+    channels_mutex_unlock(xbpx);
+
+    g_variant_builder_init(&channels, G_VARIANT_TYPE("a(say)"));
+    for(i = 0; i < resident->len; ++i) {
+        BlconfChannel *channel = g_ptr_array_index(resident, i);
+        gchar **filenames, *user_file;
+        GPtrArray *sources;
+        BinaryCacheSource *stats;
+        GByteArray *contents = NULL;
+        guint n_system_files;
+
+        if(blconf_backend_perchannel_xml_find_files(channel->name, &filenames,
+                                                    &user_file))
+        {
+            sources = blconf_binary_cache_get_sources(filenames, user_file,
+                                                      &n_system_files);
+            stats = g_new(BinaryCacheSource, sources->len);
+            blconf_binary_cache_stat_sources(sources, stats);
+
+            channel_read_lock(channel);
+            contents = blconf_binary_cache_serialize(channel->name, channel,
+                                                     sources, stats);
+            channel_read_unlock(channel);
+
+            g_ptr_array_free(sources, TRUE);
+            g_free(stats);
+        }
+        g_strfreev(filenames);
+        g_free(user_file);
+
+        if(contents) {
+            g_variant_builder_add(&channels, "(s@ay)", channel->name,
+                                  g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                            contents->data,
+                                                            contents->len, 1));
+            g_byte_array_free(contents, TRUE);
+        }
+    }
+    g_ptr_array_free(resident, TRUE);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "channels",
+                          g_variant_builder_end(&channels));
+    g_variant_builder_add(&builder, "{sv}", "missing",
+                          g_variant_builder_end(&missing));
+
+    return g_variant_builder_end(&builder);
+}
+
+/* runs before the preloader starts, so the snapshots are only parsed
+ * on its threads, or when the channel is first asked for */
+static void
+blconf_backend_perchannel_xml_restore_state(BlconfBackend *backend,
+                                            GVariant *state)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GVariant *channels, *missing, *data;
+    GVariantIter iter;
+    const gchar *name;
+    gconstpointer contents;
+    gsize length;
+    guint32 remaining;
+    guint now = g_get_monotonic_time() / G_USEC_PER_SEC;
+
+    if(!g_variant_is_of_type(state, G_VARIANT_TYPE_VARDICT))
+        return;
+
+    channels = g_variant_lookup_value(state, "channels",
+                                      G_VARIANT_TYPE("a(say)"));
+    missing = g_variant_lookup_value(state, "missing",
+                                     G_VARIANT_TYPE("a(su)"));
+
+    channels_mutex_lock(xbpx);
+
+    if(channels) {
+        g_variant_iter_init(&iter, channels);
+        while(g_variant_iter_next(&iter, "(&s@ay)", &name, &data)) {
+            /* copied, since the cache layout wants 8-byte alignment */
+            contents = g_variant_get_fixed_array(data, &length, 1);
+            if(*name && !strchr(name, '/') && *name != '.') {
+                g_hash_table_replace(xbpx->handoff_channels,
+                                     g_ascii_strdown(name, -1),
+                                     g_bytes_new(contents, length));
+            }
+            g_variant_unref(data);
+        }
+        g_variant_unref(channels);
+    }
+
+    if(missing) {
+        g_variant_iter_init(&iter, missing);
+        while(g_variant_iter_next(&iter, "(&su)", &name, &remaining)
+              && g_hash_table_size(xbpx->missing_channels) < MISSING_MAX)
+        {
+            g_hash_table_replace(xbpx->missing_channels,
+                                 g_ascii_strdown(name, -1),
+                                 GUINT_TO_POINTER(now + MIN(remaining,
+                                                            MISSING_TIMEOUT)));
+        }
+        g_variant_unref(missing);
+    }
+
+    DBG("took over %u channel(s) and %u missing one(s)",
+        g_hash_table_size(xbpx->handoff_channels),
+        g_hash_table_size(xbpx->missing_channels));
+
+    channels_mutex_unlock(xbpx);
+}
+
+/* "channels" has an a{sv} for each loaded channel, with its "size"
+ * (the bytes its properties take), "properties", "hits", "dirty" and
+ * "last-flush-usec"; "fsync" and "writes" are histograms of how long
+ * syncing and whole group commits took.  the channels' fields other
+ * than |hits| only change on the main thread, which is where this
+ * runs. */
+static GVariant *
+blconf_backend_perchannel_xml_get_stats(BlconfBackend *backend)
+{
+    BlconfBackendPerchannelXml *xbpx = BLCONF_BACKEND_PERCHANNEL_XML(backend);
+    GVariantBuilder builder, channels;
+    GHashTableIter iter;
+    gpointer value;
+    guint n_pending_writes;
+
+    g_variant_builder_init(&channels, G_VARIANT_TYPE("a{sa{sv}}"));
+
+    channels_mutex_lock(xbpx);
+    g_hash_table_iter_init(&iter, xbpx->channels);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) {
+        BlconfChannel *channel = value;
+
+        g_variant_builder_open(&channels, G_VARIANT_TYPE("{sa{sv}}"));
+        g_variant_builder_add(&channels, "s", channel->name);
+        g_variant_builder_open(&channels, G_VARIANT_TYPE_VARDICT);
+        g_variant_builder_add(&channels, "{sv}", "size",
+                              g_variant_new_uint64(blconf_arena_get_size(channel->arena)));
+        g_variant_builder_add(&channels, "{sv}", "properties",
+                              g_variant_new_uint32(channel->prop_index
+                                                   ? g_hash_table_size(channel->prop_index)
+                                                   : 0));
+        g_variant_builder_add(&channels, "{sv}", "hits",
+                              g_variant_new_uint64(channel->hits));
+        g_variant_builder_add(&channels, "{sv}", "dirty",
+                              g_variant_new_boolean(channel->dirty));
+        g_variant_builder_add(&channels, "{sv}", "last-flush-usec",
+                              g_variant_new_int64(channel->last_flush));
+        g_variant_builder_add(&channels, "{sv}", "shared-defaults",
+                              g_variant_new_boolean(channel->shared_defaults != NULL));
+        g_variant_builder_close(&channels);
+        g_variant_builder_close(&channels);
+    }
+    channels_mutex_unlock(xbpx);
+
+    writer_mutex_lock(xbpx);
+    n_pending_writes = xbpx->n_pending_writes;
+    writer_mutex_unlock(xbpx);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "channels",
+                          g_variant_builder_end(&channels));
+    g_variant_builder_add(&builder, "{sv}", "fsync",
+                          blconf_histogram_to_variant(&xbpx->fsync_times));
+    g_variant_builder_add(&builder, "{sv}", "writes",
+                          blconf_histogram_to_variant(&xbpx->write_times));
+    g_variant_builder_add(&builder, "{sv}", "pending-writes",
+                          g_variant_new_uint32(n_pending_writes));
+
+    return g_variant_builder_end(&builder);
+}
+
+/* Files edited behind our back (by provisioning tools, say) are picked
+ * up through the directory monitors of the channel index.  A loaded
+ * channel is read again shortly after the last event for any of its
+ * files, and only properties whose value actually differs are
+ * signalled.  Our own writes are recognized by the identity of the
+ * file we renamed into place, see _note_own_write(). */
+
+typedef struct
+{
+    guint64 ino;
+    guint64 dev;
+    guint64 size;
+    guint64 mtime;
+    guint32 mtime_nsec;
+} FileStamp;
+
+/* runs in the writer thread, with |fd| referring to the file that is
+ * about to become |filename| */
+static void
+blconf_backend_perchannel_xml_note_own_write(BlconfBackendPerchannelXml *xbpx,
+                                             const gchar *filename,
+                                             gint fd)
+{
+    struct stat st;
+    FileStamp *stamp;
+
+    if(fstat(fd, &st))
+        return;
+
+    stamp = g_slice_new(FileStamp);
+    stamp->ino = st.st_ino;
+    stamp->dev = st.st_dev;
+    stamp->size = st.st_size;
+    stamp->mtime = st.st_mtime;
+    stamp->mtime_nsec = STAT_MTIME_NSEC(&st);
+
+    writer_mutex_lock(xbpx);
+    g_hash_table_insert(xbpx->own_writes, g_strdup(filename), stamp);
+    writer_mutex_unlock(xbpx);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_is_own_write(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *filename)
+{
+    struct stat st;
+    FileStamp *stamp;
+    gboolean ret = FALSE;
+
+    if(stat(filename, &st))
+        return FALSE;
+
+    writer_mutex_lock(xbpx);
+    stamp = g_hash_table_lookup(xbpx->own_writes, filename);
+    if(stamp) {
+        ret = (stamp->ino == (guint64)st.st_ino
+               && stamp->dev == (guint64)st.st_dev
+               && stamp->size == (guint64)st.st_size
+               && stamp->mtime == (guint64)st.st_mtime
+               && stamp->mtime_nsec == (guint32)STAT_MTIME_NSEC(&st));
+    }
+    writer_mutex_unlock(xbpx);
+
+    return ret;
+}
+
+static void
+blconf_file_stamp_free(gpointer stamp)
+{
+    g_slice_free(FileStamp, stamp);
+}
+
+static const GValue *
+blconf_property_get_effective_value(BlconfProperty *prop)
+{
+    if(!prop)
+        return NULL;
+    if(G_VALUE_TYPE(&prop->value))
+        return &prop->value;
+    if(G_VALUE_TYPE(&prop->system_value))
+        return &prop->system_value;
+    return NULL;
+}
+
+/* returns the names of all properties whose value differs between the
+ * two channels; |new_channel| may be NULL if the channel is gone */
+static GSList *
+blconf_channel_diff(BlconfChannel *old_channel,
+                    BlconfChannel *new_channel)
+{
+    GSList *changed = NULL;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, old_channel->prop_index);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        const GValue *old_value = blconf_property_get_effective_value(value);
+        const GValue *new_value = NULL;
+
+        if(new_channel) {
+            new_value = blconf_property_get_effective_value(g_hash_table_lookup(new_channel->prop_index,
+                                                                                key));
+        }
+
+        if(!old_value && !new_value)
+            continue;
+        if(!old_value || !new_value
+           || G_VALUE_TYPE(old_value) != G_VALUE_TYPE(new_value)
+           || !_blconf_gvalue_is_equal(old_value, new_value))
+        {
+            changed = g_slist_prepend(changed, g_strdup(key));
+        }
+    }
+
+    if(!new_channel)
+        return changed;
+
+    g_hash_table_iter_init(&iter, new_channel->prop_index);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        if(blconf_property_get_effective_value(value)
+           && !blconf_property_get_effective_value(g_hash_table_lookup(old_channel->prop_index,
+                                                                       key)))
+        {
+            changed = g_slist_prepend(changed, g_strdup(key));
+        }
+    }
+
+    return changed;
+}
+
+static gboolean
+blconf_backend_perchannel_xml_reload_timeout(gpointer data)
+{
+    BlconfChannel *channel = data;
+    BlconfBackendPerchannelXml *xbpx = channel->xbpx;
+    BlconfChannel *new_channel;
+    gchar *channel_name;
+    GSList *changed, *l;
+    gpointer key;
+    guint n_pending;
+
+    writer_mutex_lock(xbpx);
+    n_pending = xbpx->n_pending_writes;
+    writer_mutex_unlock(xbpx);
+
+    /* unsaved changes go to disk first, and get merged with whatever
+     * changed there when we read it back afterwards */
+    if(channel->dirty || n_pending)
+        return TRUE;
+
+    channel->reload_id = 0;
+    channel_name = g_strdup(channel->name);
+
+    new_channel = blconf_backend_perchannel_xml_read_channel(xbpx, channel_name,
+                                                             NULL, NULL);
+    changed = blconf_channel_diff(channel, new_channel);
+
+    DBG("Reloaded channel \"%s\", %u properties changed", channel_name,
+        g_slist_length(changed));
+
+    /* the new channel is published whole, never patched in place, so
+     * a reader sees either the old tree or the new one.  keep the old
+     * one around so listeners can be told what the values used to be;
+     * readers still using it drop their refs when they're done. */
+    channels_mutex_lock(xbpx);
+    if(g_hash_table_lookup_extended(xbpx->channels, channel_name, &key, NULL)) {
+        g_hash_table_steal(xbpx->channels, channel_name);
+        g_free(key);
+    }
+    if(new_channel)
+        blconf_backend_perchannel_xml_add_channel(xbpx, channel_name, new_channel);
+    channels_mutex_unlock(xbpx);
+
+    for(l = changed; l; l = l->next) {
+        blconf_backend_perchannel_xml_notify(xbpx, channel_name, l->data,
+                                             blconf_property_get_effective_value(g_hash_table_lookup(channel->prop_index,
+                                                                                                     l->data)),
+                                             new_channel
+                                             ? blconf_property_get_effective_value(g_hash_table_lookup(new_channel->prop_index,
+                                                                                                       l->data))
+                                             : NULL);
+        g_free(l->data);
+    }
+    g_slist_free(changed);
+    g_free(channel_name);
+
+    blconf_channel_release(channel);
+
+    return FALSE;
+}
+
+static void
+blconf_backend_perchannel_xml_file_changed(BlconfBackendPerchannelXml *xbpx,
+                                           const gchar *filename,
+                                           const gchar *channel_name)
+{
+    BlconfChannel *channel;
+    gchar *key;
+
+    key = g_ascii_strdown(channel_name, -1);
+    channel = g_hash_table_lookup(xbpx->channels, key);
+    g_free(key);
+
+    if(!channel) {
+        /* a load that's reading the files right now may have seen
+         * the old contents */
+        blconf_backend_perchannel_xml_invalidate_loading(xbpx, channel_name);
+        return;
+    }
+
+    if(blconf_backend_perchannel_xml_is_own_write(xbpx, filename))
+        return;
+
+    /* editors and package managers tend to write in several steps */
+    if(channel->reload_id)
+        g_source_remove(channel->reload_id);
+    channel->reload_id = g_timeout_add(RELOAD_TIMEOUT,
+                                       blconf_backend_perchannel_xml_reload_timeout,
+                                       channel);
+}
+
+/* appends |text| escaped the way g_markup_escape_text() does it, but
+ * without going through a temporary string */
+static void
+blconf_xml_append_escaped(GString *str,
+                          const gchar *text)
+{
+    const guchar *p, *run;
+
+    for(p = run = (const guchar *)text; *p; ++p) {
+        const gchar *entity = NULL;
+        gchar charref[8];
+        guint c = *p, len = 1;
 
-    /* read in system files, we do this in reversed order to properly 
-     * follow the xdg spec, see bug #6079 for more information */
-    length = g_strv_length(filenames);
-    for(i = length - 1; i >= 0; --i) {
-        if(!g_strcmp0(user_file, filenames[i]))
-            continue;
-        blconf_backend_perchannel_xml_merge_file(xbpx, filenames[i], TRUE,
-                                                 channel, NULL);
-    }
+        switch(c) {
+            case '&':
+                entity = "&amp;";
+                break;
+            case '<':
+                entity = "&lt;";
+                break;
+            case '>':
+                entity = "&gt;";
+                break;
+            case '\'':
+                entity = "&apos;";
+                break;
+            case '"':
+                entity = "&quot;";
+                break;
+            default:
+                /* control characters, including the C1 ones (which
+                 * are two bytes in UTF-8), except for NEL */
+                if(c == 0xc2 && p[1] >= 0x80 && p[1] <= 0x9f && p[1] != 0x85) {
+                    c = p[1];
+                    len = 2;
+                } else if(!((c >= 0x1 && c <= 0x8) || c == 0xb || c == 0xc
+                            || (c >= 0xe && c <= 0x1f) || c == 0x7f))
+                {
+                    continue;
+                }
+                g_snprintf(charref, sizeof(charref), "&#x%x;", c);
+                entity = charref;
+                break;
+        }
 
-    if(!channel->locked && user_file) {
-        /* read in user file */
-        blconf_backend_perchannel_xml_merge_file(xbpx, user_file, FALSE,
-                                                 channel, NULL);
+        g_string_append_len(str, (const gchar *)run, p - run);
+        g_string_append(str, entity);
+        p += len - 1;
+        run = p + 1;
     }
 
-    g_hash_table_insert(xbpx->channels, g_ascii_strdown(channel_name, -1), channel);
+    g_string_append_len(str, (const gchar *)run, p - run);
+}
 
-out:
-    g_strfreev(filenames);
-    g_free(user_file);
+static void
+blconf_xml_append_indent(GString *str,
+                         gint depth)
+{
+    if(depth * 2 > MAX_PROP_PATH - 1)
+        depth = MAX_PROP_PATH / 2 - 1;
 
-    return channel;
+    for(; depth > 0; --depth)
+        g_string_append_len(str, "  ", 2);
 }
 
 static gboolean
 blconf_format_xml_tag(GString *elem_str,
                       GValue *value,
                       gboolean is_array_value,
-                      gchar spaces[MAX_PROP_PATH],
+                      gint depth,
                       gboolean *is_array)
 {
-    gchar *tmp;
-
     switch(G_VALUE_TYPE(value)) {
         case G_TYPE_STRING:
-            tmp = g_markup_escape_text(g_value_get_string(value), -1);
-            g_string_append_printf(elem_str, " type=\"string\" value=\"%s\"",
-                                   tmp);
-            g_free(tmp);
+            g_string_append(elem_str, " type=\"string\" value=\"");
+            blconf_xml_append_escaped(elem_str, g_value_get_string(value));
+            g_string_append_c(elem_str, '"');
             break;
 
         case G_TYPE_UCHAR:
@@ -1745,8 +5674,9 @@ blconf_format_xml_tag(GString *elem_str,
             break;
 
         case G_TYPE_BOOLEAN:
-            g_string_append_printf(elem_str, " type=\"bool\" value=\"%s\"",
-                                   g_value_get_boolean(value) ? "true" : "false");
+            g_string_append(elem_str, g_value_get_boolean(value)
+                                      ? " type=\"bool\" value=\"true\""
+                                      : " type=\"bool\" value=\"false\"");
             break;
 
         default:
@@ -1764,11 +5694,10 @@ blconf_format_xml_tag(GString *elem_str,
 
                 strlist = g_value_get_boxed(value);
                 for(i = 0; strlist[i]; ++i) {
-                    gchar *value_str = g_markup_escape_text(strlist[i], -1);
-                    g_string_append_printf(elem_str,
-                                           "%s  <value type=\"string\" value=\"%s\"/>\n",
-                                           spaces, value_str);
-                    g_free(value_str);
+                    blconf_xml_append_indent(elem_str, depth + 1);
+                    g_string_append(elem_str, "<value type=\"string\" value=\"");
+                    blconf_xml_append_escaped(elem_str, strlist[i]);
+                    g_string_append(elem_str, "\"/>\n");
                 }
 
                 *is_array = TRUE;
@@ -1786,8 +5715,9 @@ blconf_format_xml_tag(GString *elem_str,
                     GValue *value1 = g_ptr_array_index(arr, i);
                     gboolean dummy;
 
-                    g_string_append_printf(elem_str, "%s  <value", spaces);
-                    if(!blconf_format_xml_tag(elem_str, value1, TRUE, spaces,
+                    blconf_xml_append_indent(elem_str, depth + 1);
+                    g_string_append(elem_str, "<value");
+                    if(!blconf_format_xml_tag(elem_str, value1, TRUE, depth,
                                               &dummy))
                     {
                         return FALSE;
@@ -1806,7 +5736,6 @@ blconf_format_xml_tag(GString *elem_str,
                     g_value_unset(value);
                 }
 
-                is_array = FALSE;
                 g_string_append(elem_str, " type=\"empty\"");
             }
             break;
@@ -1815,161 +5744,647 @@ blconf_format_xml_tag(GString *elem_str,
     return TRUE;
 }
 
-static gboolean
-blconf_backend_perchannel_xml_write_node(BlconfBackendPerchannelXml *xbpx,
-                                         FILE *fp,
-                                         GNode *node,
-                                         gint depth,
-                                         GError **error)
+/* Channels are written out by a dedicated writer thread, so slow disks
+ * don't stall D-Bus requests.  The main thread takes a snapshot of the
+ * channel (names plus copies of the user values, in tree order) and
+ * queues it; the writer formats the file, syncs it and renames it into
+ * place, then hands the result back to the main loop. */
+
+typedef struct
 {
-    BlconfProperty *prop = node->data;
-    GValue *value = &prop->value;
-    GString *elem_str;
-    gchar spaces[MAX_PROP_PATH];
-    GNode *child;
-    gchar *escaped_name;
-    gboolean is_array = FALSE;
-    
-    if(depth * 2 > (gint) sizeof(spaces) + 1)
-        depth = sizeof(spaces) / 2 - 1;
+    const gchar *name;  /* pooled */
+    gint depth;
+    gboolean has_children;
+    GValue value;
+} SnapshotNode;
 
-    memset(spaces, ' ', depth * 2);
-    spaces[depth * 2] = 0;
+typedef struct
+{
+    gchar *channel_name;
+    gboolean journal;
+    gint64 duration;  /* of the whole group commit */
+    GError *error;
+} WriteResult;
+
+typedef struct _WriteJob WriteJob;
+struct _WriteJob
+{
+    gchar *channel_name;
+    gchar *filename;
+    gchar *journal_filename;
+    GArray *nodes;     /* full write: the snapshot, or NULL */
+    GString *journal;  /* journal append: the records, or NULL */
 
-    escaped_name = g_markup_escape_text(prop->name, strlen(prop->name));
+    WriteJob *next;  /* the rest of a group commit */
 
-    elem_str = g_string_sized_new(128);
-    g_string_append_printf(elem_str, "%s<property name=\"%s\"", spaces,
-                           escaped_name);
+    /* only used by the writer */
+    gint fd;
+    gchar *filename_tmp;
+    WriteResult *result;
+};
 
-    g_free (escaped_name);
+static void
+blconf_backend_perchannel_xml_snapshot_node(GArray *nodes,
+                                            GNode *node,
+                                            gint depth)
+{
+    BlconfProperty *prop = node->data;
+    SnapshotNode *snode;
+    GNode *child;
 
-    if(!blconf_format_xml_tag(elem_str, value, FALSE, spaces, &is_array)) {
-        /* _flush_channel() will handle |error| */
-        g_string_free(elem_str, TRUE);
-        return FALSE;
+    g_array_set_size(nodes, nodes->len + 1);
+    snode = &g_array_index(nodes, SnapshotNode, nodes->len - 1);
+    snode->name = blconf_string_pool_ref(prop->name);
+    snode->depth = depth;
+    snode->has_children = (node->children != NULL);
+    if(G_VALUE_TYPE(&prop->value)) {
+        g_value_copy(&prop->value, g_value_init(&snode->value,
+                                                G_VALUE_TYPE(&prop->value)));
     }
 
-    child = g_node_first_child(node);
-    if(!is_array) {
-        if(child)
-            g_string_append(elem_str, ">\n");
-        else
-            g_string_append(elem_str, "/>\n");
+    for(child = g_node_first_child(node);
+        child;
+        child = g_node_next_sibling(child))
+    {
+        blconf_backend_perchannel_xml_snapshot_node(nodes, child, depth + 1);
     }
+}
 
-    if(fputs(elem_str->str, fp) == EOF) {
-        /* _flush_channel() will handle |error| */
-        g_string_free(elem_str, TRUE);
-        return FALSE;
+static void
+blconf_backend_perchannel_xml_write_job_free(WriteJob *job)
+{
+    guint i;
+
+    for(i = 0; job->nodes && i < job->nodes->len; ++i) {
+        SnapshotNode *snode = &g_array_index(job->nodes, SnapshotNode, i);
+
+        blconf_string_pool_unref(snode->name);
+        if(G_VALUE_TYPE(&snode->value))
+            g_value_unset(&snode->value);
     }
-    g_string_free(elem_str, TRUE);
+    if(job->nodes)
+        g_array_free(job->nodes, TRUE);
+    if(job->journal)
+        g_string_free(job->journal, TRUE);
+
+    g_free(job->channel_name);
+    g_free(job->filename);
+    g_free(job->journal_filename);
+    g_free(job->filename_tmp);
+    g_slice_free(WriteJob, job);
+}
+
+/* renders the whole file into |buf| */
+static gboolean
+blconf_backend_perchannel_xml_render_channel(GString *buf,
+                                             const gchar *channel_name,
+                                             GArray *nodes)
+{
+    GArray *open_elems = g_array_new(FALSE, FALSE, sizeof(gint));
+    gboolean ret = FALSE;
+    guint i;
+
+    g_string_append(buf, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n"
+                         "<channel name=\"");
+    blconf_xml_append_escaped(buf, channel_name);
+    g_string_append(buf, "\" version=\"" FILE_VERSION_MAJOR "." FILE_VERSION_MINOR "\">\n");
 
-    for(; child; child = g_node_next_sibling(child)) {
-        if(!blconf_backend_perchannel_xml_write_node(xbpx, fp, child,
-                                                     depth + 1, error))
+    for(i = 0; i < nodes->len; ++i) {
+        SnapshotNode *snode = &g_array_index(nodes, SnapshotNode, i);
+        gboolean is_array = FALSE;
+
+        /* close everything that isn't an ancestor of this node */
+        while(open_elems->len
+              && g_array_index(open_elems, gint, open_elems->len - 1) >= snode->depth)
         {
-            /* _flush_channel() will handle |error| */
-            return FALSE;
+            blconf_xml_append_indent(buf, g_array_index(open_elems, gint,
+                                                        open_elems->len - 1));
+            g_string_append(buf, "</property>\n");
+            g_array_set_size(open_elems, open_elems->len - 1);
+        }
+
+        blconf_xml_append_indent(buf, snode->depth);
+        g_string_append(buf, "<property name=\"");
+        blconf_xml_append_escaped(buf, snode->name);
+        g_string_append_c(buf, '"');
+
+        if(!blconf_format_xml_tag(buf, &snode->value, FALSE, snode->depth,
+                                  &is_array))
+        {
+            goto out;
         }
+
+        if(!is_array)
+            g_string_append(buf, snode->has_children ? ">\n" : "/>\n");
+
+        if(is_array || snode->has_children)
+            g_array_append_val(open_elems, snode->depth);
+    }
+
+    while(open_elems->len) {
+        blconf_xml_append_indent(buf, g_array_index(open_elems, gint,
+                                                    open_elems->len - 1));
+        g_string_append(buf, "</property>\n");
+        g_array_set_size(open_elems, open_elems->len - 1);
     }
 
-    if(is_array || g_node_first_child(node)) {
-        if(fputs(spaces, fp) == EOF || fputs("</property>\n", fp) == EOF) {
-            /* _flush_channel() will handle |error| */
+    g_string_append(buf, "</channel>\n");
+
+    ret = TRUE;
+
+out:
+    g_array_free(open_elems, TRUE);
+
+    return ret;
+}
+
+static gboolean
+blconf_write_all(gint fd,
+                 const gchar *data,
+                 gsize len)
+{
+    while(len) {
+        gssize n = write(fd, data, len);
+
+        if(n < 0) {
+            if(errno == EINTR)
+                continue;
             return FALSE;
         }
+
+        data += n;
+        len -= n;
     }
 
     return TRUE;
 }
 
+/* Jobs queued together are chained through |next| and committed as a
+ * group: every file is written first, then they're all synced (with a
+ * single syncfs() if there is more than one), and only then are the
+ * new files renamed into place, followed by one fsync() of the config
+ * dir.  Flushing many channels thus costs about as much as flushing
+ * one, and no file is replaced before all of them are on disk. */
+
+static void
+blconf_write_job_fail(WriteJob *job)
+{
+    if(!job->result->error) {
+        g_set_error(&job->result->error, BLCONF_ERROR,
+                    BLCONF_ERROR_WRITE_FAILURE,
+                    _("Unable to write channel \"%s\": %s"),
+                    job->channel_name, strerror(errno));
+    }
+
+    if(job->fd >= 0) {
+        close(job->fd);
+        job->fd = -1;
+    }
+}
+
 static gboolean
-blconf_backend_perchannel_xml_flush_channel(BlconfBackendPerchannelXml *xbpx,
-                                            const gchar *channel_name,
-                                            GError **error)
+blconf_sync_fd(gint fd)
 {
-    gboolean ret = FALSE;
-    BlconfChannel *channel = g_hash_table_lookup(xbpx->channels, channel_name);
-    GNode *child;
-    gchar *filename = NULL, *filename_tmp = NULL;
-    FILE *fp = NULL;
+#if defined(HAVE_FDATASYNC)
+    return !fdatasync(fd);
+#elif defined(HAVE_FSYNC)
+    return !fsync(fd);
+#else
+    sync();
+    return TRUE;
+#endif
+}
+
+static gboolean
+blconf_backend_perchannel_xml_sync_fd(BlconfBackendPerchannelXml *xbpx,
+                                      gint fd)
+{
+    gint64 start = g_get_monotonic_time();
+    gboolean ret = blconf_sync_fd(fd);
 
-    DBG("Flushed dirty channel \"%s\"", channel_name);
+    blconf_histogram_record(&xbpx->fsync_times, g_get_monotonic_time() - start);
 
-    if(!channel) {
-        if(error) {
-            g_set_error(error, BLCONF_ERROR,
-                        BLCONF_ERROR_CHANNEL_NOT_FOUND,
-                        _("Channel \"%s\" does not exist"), channel_name);
+    return ret;
+}
+
+/* runs in the writer thread; must not touch the backend's channels.
+ * writes the job's data without syncing it, leaving |job->fd| open.
+ * |buf| is the writer's scratch buffer, reused from job to job. */
+static gboolean
+blconf_backend_perchannel_xml_write_job_data(BlconfBackendPerchannelXml *xbpx,
+                                             WriteJob *job,
+                                             GString *buf)
+{
+    if(job->journal) {
+        job->fd = open(job->journal_filename, O_WRONLY | O_CREAT | O_APPEND,
+                       0666);
+        if(job->fd < 0 || !blconf_write_all(job->fd, job->journal->str,
+                                            job->journal->len))
+        {
+            blconf_write_job_fail(job);
+            return FALSE;
         }
+
+        return TRUE;
+    }
+
+    job->filename_tmp = g_strconcat(job->filename, ".new", NULL);
+
+    g_string_truncate(buf, 0);
+    if(!blconf_backend_perchannel_xml_render_channel(buf, job->channel_name,
+                                                     job->nodes))
+    {
+        errno = EINVAL;
+        blconf_write_job_fail(job);
         return FALSE;
     }
 
-    filename = g_strdup_printf("%s/%s.xml", xbpx->config_save_path, channel_name);
-    filename_tmp = g_strconcat(filename, ".new", NULL);
+    job->fd = open(job->filename_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(job->fd < 0 || !blconf_write_all(job->fd, buf->str, buf->len)) {
+        blconf_write_job_fail(job);
+        return FALSE;
+    }
 
-    fp = fopen(filename_tmp, "w");
-    if(!fp)
-        goto out;
+    blconf_backend_perchannel_xml_note_own_write(xbpx, job->filename, job->fd);
 
-    if(fputs("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n", fp) == EOF
-       || fprintf(fp, "<channel name=\"%s\" version=\"%s.%s\">\n", channel_name,
-                  FILE_VERSION_MAJOR, FILE_VERSION_MINOR) < 0)
-    {
-        goto out;
+    /* don't hold on to the memory a single huge channel needed */
+    if(buf->allocated_len > WRITE_BUFFER_KEEP) {
+        g_string_free(buf, TRUE);
+        xbpx->write_buffer = g_string_sized_new(WRITE_BUFFER_SIZE);
     }
 
-    for(child = g_node_first_child(channel->properties);
-        child;
-        child = g_node_next_sibling(child))
-    {
-        if(!blconf_backend_perchannel_xml_write_node(xbpx, fp, child, 1, error))
-            goto out;
+    return TRUE;
+}
+
+/* one call for the whole filesystem beats one per file once there are
+ * several; returns FALSE if the files still have to be synced one by
+ * one */
+static gboolean
+blconf_write_jobs_syncfs(BlconfBackendPerchannelXml *xbpx,
+                         WriteJob *jobs)
+{
+#if defined(HAVE_SYNCFS)
+    WriteJob *job, *first = NULL;
+    guint n_open = 0;
+    gint64 start;
+    gboolean ret;
+
+    for(job = jobs; job; job = job->next) {
+        if(job->fd >= 0) {
+            if(!first)
+                first = job;
+            n_open++;
+        }
     }
 
-    if(fputs("</channel>\n", fp) == EOF)
-        goto out;
+    if(n_open > 1) {
+        start = g_get_monotonic_time();
+        ret = !syncfs(first->fd);
+        blconf_histogram_record(&xbpx->fsync_times,
+                                g_get_monotonic_time() - start);
+        return ret;
+    }
+#endif
 
-    if(fflush(fp))
-        goto out;
+    return FALSE;
+}
 
-#if defined(HAVE_FDATASYNC)
-    if(fdatasync(fileno(fp)))
-        goto out;
-#elif defined(HAVE_FSYNC)
-    if(fsync(fileno(fp)))
-        goto out;
-#else
-    sync();
+/* runs in the writer thread, once the job's data is on disk */
+static void
+blconf_backend_perchannel_xml_commit_job(WriteJob *job,
+                                         gboolean *renamed)
+{
+    if(close(job->fd)) {
+        job->fd = -1;
+        blconf_write_job_fail(job);
+        return;
+    }
+    job->fd = -1;
+
+    if(job->journal)
+        return;
+
+    if(rename(job->filename_tmp, job->filename)) {
+        blconf_write_job_fail(job);
+        return;
+    }
+    *renamed = TRUE;
+
+    /* the new file has everything the journal had; if we crash
+     * before this, replaying it again is harmless */
+    if(unlink(job->journal_filename) && errno != ENOENT) {
+        g_warning("Unable to remove journal \"%s\": %s",
+                  job->journal_filename, strerror(errno));
+    }
+}
+
+/* runs in the writer thread, makes the renames themselves durable */
+static void
+blconf_backend_perchannel_xml_sync_dir(BlconfBackendPerchannelXml *xbpx)
+{
+#if defined(HAVE_FSYNC)
+    gint fd = open(xbpx->config_save_path, O_RDONLY);
+    gint64 start;
+
+    if(fd < 0)
+        return;
+
+    start = g_get_monotonic_time();
+    if(fsync(fd))
+        DBG("unable to sync \"%s\": %s", xbpx->config_save_path, strerror(errno));
+    blconf_histogram_record(&xbpx->fsync_times, g_get_monotonic_time() - start);
+    close(fd);
 #endif
+}
+
+/* a full write leaves the snapshot of |channel| stale; as long as
+ * nothing changed since the write was prepared and the user file is
+ * still the one we renamed into place, the tree is exactly what
+ * parsing the files would give, so the snapshot is written from it.
+ * appends don't touch the xml files, so they don't need this */
+static void
+blconf_backend_perchannel_xml_refresh_snapshot(BlconfBackendPerchannelXml *xbpx,
+                                               BlconfChannel *channel)
+{
+    gchar **filenames = NULL, *user_file = NULL;
+    GPtrArray *sources;
+    BinaryCacheSource *stats;
+    guint n_system_files;
 
-    if(fclose(fp)) {
-        fp = NULL;
+    if(!xbpx->cache_save_path || channel->dirty || channel->locked)
         goto out;
-    }
-    fp = NULL;
 
-    if(rename(filename_tmp, filename))
+    if(!blconf_backend_perchannel_xml_find_files(channel->name, &filenames,
+                                                 &user_file)
+       || !user_file
+       || !blconf_backend_perchannel_xml_is_own_write(xbpx, user_file))
+    {
         goto out;
+    }
 
-    ret = TRUE;
+    sources = blconf_binary_cache_get_sources(filenames, user_file,
+                                              &n_system_files);
+    stats = g_new(BinaryCacheSource, sources->len);
+    blconf_binary_cache_stat_sources(sources, stats);
+
+    channel_read_lock(channel);
+    blconf_binary_cache_save(xbpx, channel->name, channel, sources, stats);
+    channel_read_unlock(channel);
+
+    g_ptr_array_free(sources, TRUE);
+    g_free(stats);
 
 out:
-    if(!ret && error && !*error) {
-        g_set_error(error, BLCONF_ERROR,
-                    BLCONF_ERROR_WRITE_FAILURE,
-                    _("Unable to write channel \"%s\": %s"),
-                    channel_name, strerror(errno));
+    g_strfreev(filenames);
+    g_free(user_file);
+}
+
+/* hands the results of finished writes to the main thread; if |error|
+ * is given, the first failure is returned there instead of logged */
+static void
+blconf_backend_perchannel_xml_report_writes(BlconfBackendPerchannelXml *xbpx,
+                                            GError **error)
+{
+    GSList *results, *l;
+
+    writer_mutex_lock(xbpx);
+    results = g_slist_reverse(xbpx->write_results);
+    xbpx->write_results = NULL;
+    writer_mutex_unlock(xbpx);
+
+    for(l = results; l; l = l->next) {
+        WriteResult *result = l->data;
+        BlconfChannel *channel;
+
+        channels_mutex_lock(xbpx);
+        channel = g_hash_table_lookup(xbpx->channels, result->channel_name);
+        channels_mutex_unlock(xbpx);
+
+        if(channel) {
+            channel->last_flush = result->duration;
+            channel->write_failed = (result->error != NULL);
+        }
+
+        if(result->error && channel) {
+            /* the changes are only in memory now, so keep trying.  for
+             * an append, we don't know how much of it made it, so stop
+             * trusting the journal and write the whole channel */
+            if(result->journal)
+                channel->journal_base = FALSE;
+            blconf_backend_perchannel_xml_schedule_save(xbpx, channel);
+        } else if(channel && !result->journal)
+            blconf_backend_perchannel_xml_refresh_snapshot(xbpx, channel);
+
+        if(result->error) {
+            if(error && !*error)
+                g_propagate_error(error, result->error);
+            else {
+                g_warning("%s", result->error->message);
+                g_error_free(result->error);
+            }
+        } else
+            DBG("Flushed dirty channel \"%s\"", result->channel_name);
+
+        g_free(result->channel_name);
+        g_slice_free(WriteResult, result);
     }
+    g_slist_free(results);
+}
+
+static gboolean
+blconf_backend_perchannel_xml_report_writes_idled(gpointer data)
+{
+    BlconfBackendPerchannelXml *xbpx = data;
 
-    if(fp)
-        fclose(fp);
+    writer_mutex_lock(xbpx);
+    xbpx->write_results_id = 0;
+    writer_mutex_unlock(xbpx);
 
-    g_free(filename);
-    g_free(filename_tmp);
+    blconf_backend_perchannel_xml_report_writes(xbpx, NULL);
+
+    return FALSE;
+}
+
+static void
+blconf_backend_perchannel_xml_writer_func(gpointer data,
+                                          gpointer user_data)
+{
+    BlconfBackendPerchannelXml *xbpx = user_data;
+    WriteJob *jobs = data, *job, *next;
+    gboolean synced, renamed = FALSE, ok = TRUE;
+    WriteResult *result;
+    gint64 start = g_get_monotonic_time(), duration;
+    guint n_files = 0;
+
+    for(job = jobs; job; job = job->next) {
+        gboolean written;
+
+        job->result = g_slice_new0(WriteResult);
+        job->result->channel_name = g_strdup(job->channel_name);
+        job->result->journal = (job->journal != NULL);
+
+        BLCONF_PROBE1(flush__write__start, job->channel_name);
+        written = blconf_backend_perchannel_xml_write_job_data(xbpx, job,
+                                                               xbpx->write_buffer);
+        BLCONF_PROBE2(flush__write__done, job->channel_name, written);
+        if(written)
+            n_files++;
+    }
+
+    BLCONF_PROBE1(flush__sync__start, n_files);
+    synced = blconf_write_jobs_syncfs(xbpx, jobs);
+    for(job = jobs; job; job = job->next) {
+        if(job->fd < 0)
+            continue;
+
+        if(!synced && !blconf_backend_perchannel_xml_sync_fd(xbpx, job->fd)) {
+            blconf_write_job_fail(job);
+            ok = FALSE;
+        } else
+            blconf_backend_perchannel_xml_commit_job(job, &renamed);
+    }
+
+    if(renamed)
+        blconf_backend_perchannel_xml_sync_dir(xbpx);
+    BLCONF_PROBE1(flush__sync__done, ok);
+
+    duration = g_get_monotonic_time() - start;
+    blconf_histogram_record(&xbpx->write_times, duration);
+
+    writer_mutex_lock(xbpx);
+
+    for(job = jobs; job; job = next) {
+        next = job->next;
+        result = job->result;
+        result->duration = duration;
+        job->result = NULL;
+        xbpx->write_results = g_slist_prepend(xbpx->write_results, result);
+        blconf_backend_perchannel_xml_write_job_free(job);
+    }
+
+    if(!xbpx->write_results_id) {
+        xbpx->write_results_id = g_idle_add(blconf_backend_perchannel_xml_report_writes_idled,
+                                            xbpx);
+    }
+
+    xbpx->n_pending_writes--;
+    writer_cond_broadcast(xbpx);
+
+    writer_mutex_unlock(xbpx);
+}
 
+/* blocks until everything queued so far is on disk */
+static void
+blconf_backend_perchannel_xml_wait_writes(BlconfBackendPerchannelXml *xbpx)
+{
+    writer_mutex_lock(xbpx);
+    while(xbpx->n_pending_writes)
+        writer_cond_wait(xbpx);
+    writer_mutex_unlock(xbpx);
+}
+
+/* only ever runs on the main thread, which is the only one changing
+ * channels or dropping them from |xbpx->channels|, so the channel
+ * stays valid and its tree can be read without taking its lock */
+static WriteJob *
+blconf_backend_perchannel_xml_prepare_write(BlconfBackendPerchannelXml *xbpx,
+                                            const gchar *channel_name)
+{
+    BlconfChannel *channel;
+    WriteJob *job;
+    GNode *child;
+
+    channels_mutex_lock(xbpx);
+    channel = g_hash_table_lookup(xbpx->channels, channel_name);
+    channels_mutex_unlock(xbpx);
+
+    if(!channel)
+        return NULL;
+
+    job = g_slice_new0(WriteJob);
+    job->channel_name = g_strdup(channel_name);
+    job->filename = g_strdup_printf("%s/%s.xml", xbpx->config_save_path,
+                                    channel_name);
+    job->journal_filename = g_strdup_printf(JOURNAL_FILE_FMT,
+                                            xbpx->config_save_path,
+                                            channel_name);
+    job->fd = -1;
+
+    if(xbpx->use_journal && channel->journal_base
+       && channel->journal && channel->journal->len
+       && channel->journal_size + channel->journal->len <= JOURNAL_MAX_SIZE
+       && channel->journal_records <= JOURNAL_MAX_RECORDS)
+    {
+        /* just append what changed */
+        channel->journal_size += channel->journal->len;
+        job->journal = channel->journal;
+        channel->journal = NULL;
+    } else {
+        /* write everything out; this is also how the journal gets
+         * compacted once it grows too large */
+        job->nodes = g_array_new(FALSE, TRUE, sizeof(SnapshotNode));
+        for(child = g_node_first_child(channel->properties);
+            child;
+            child = g_node_next_sibling(child))
+        {
+            blconf_backend_perchannel_xml_snapshot_node(job->nodes, child, 1);
+        }
+
+        if(channel->journal)
+            g_string_truncate(channel->journal, 0);
+        channel->journal_records = 0;
+        channel->journal_size = 0;
+        channel->journal_base = TRUE;
+    }
+
+    if(channel->save_id) {
+        g_source_remove(channel->save_id);
+        channel->save_id = 0;
+    }
     channel->dirty = FALSE;
 
-    return ret;
+    return job;
+}
+
+/* queues one write of all of |channel_names| that still exist */
+static void
+blconf_backend_perchannel_xml_flush_channels(BlconfBackendPerchannelXml *xbpx,
+                                             GSList *channel_names)
+{
+    WriteJob *jobs = NULL, *job;
+    GSList *l;
+
+    for(l = channel_names; l; l = l->next) {
+        job = blconf_backend_perchannel_xml_prepare_write(xbpx, l->data);
+        if(job) {
+            job->next = jobs;
+            jobs = job;
+        }
+    }
+
+    if(!jobs)
+        return;
+
+    /* the pool is created on demand, so no thread exists before
+     * blconfd had a chance to fork into the background */
+    if(!xbpx->writer) {
+        GError *error2 = NULL;
+
+        xbpx->writer = g_thread_pool_new(blconf_backend_perchannel_xml_writer_func,
+                                         xbpx, 1, FALSE, &error2);
+        if(!xbpx->writer) {
+            g_warning("Unable to start writer thread, writing synchronously: %s",
+                      error2->message);
+            g_error_free(error2);
+        }
+    }
+
+    writer_mutex_lock(xbpx);
+    xbpx->n_pending_writes++;
+    writer_mutex_unlock(xbpx);
+
+    if(xbpx->writer)
+        g_thread_pool_push(xbpx->writer, jobs, NULL);
+    else
+        blconf_backend_perchannel_xml_writer_func(jobs, xbpx);
 }
@@ -37,6 +37,8 @@ typedef struct _BlconfBackendPerchannelXml         BlconfBackendPerchannelXml;
 
 GType blconf_backend_perchannel_xml_get_type(void) G_GNUC_CONST;
 
+gboolean blconf_backend_perchannel_xml_build_shared_defaults(GError **error);
+
 G_END_DECLS
 
 #endif  /* __BLCONF_BACKEND_PERCHANNEL_XML_H__ */
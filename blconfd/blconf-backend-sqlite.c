@@ -0,0 +1,1432 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A backend for channels too big for xfce-perchannel-xml, which holds
+ * every channel it has read in memory and rewrites a whole file for
+ * each change.  Here every property is a row in an SQLite table keyed
+ * by (channel, name), so nothing is read before it's asked for, a
+ * subtree is a range of the index, and a change only writes the pages
+ * it touches.
+ *
+ * Writes are grouped: the first one opens a transaction, which is
+ * committed COMMIT_DELAY later, or by a flush.  Reads share the
+ * connection, so they see the writes still in the transaction.  A
+ * commit that fails is tried again RETRY_DELAY later; the writes are
+ * kept until then, in case sqlite has rolled the transaction back.
+ *
+ * Channel names are stored in lower case, so, as with the XML files,
+ * "Foo" and "foo" are the same channel.
+ *
+ * It has no system defaults and no locks of its own; for those, layer
+ * it over the XML backend, e.g. --backends=sqlite,xfce-perchannel-xml,
+ * which sends all writes here and falls back to the XML files for the
+ * rest. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <sqlite3.h>
+
+#include <gio/gio.h>
+#include <libbladeutil/libbladeutil.h>
+
+#include "blconf-backend-sqlite.h"
+#include "blconf-backend.h"
+#include "blconf-stats.h"
+#include "common/blconf-gvaluefuncs.h"
+#include "blconf/blconf-types.h"
+#include "common/blconf-common-private.h"
+
+#define CONFIG_DIR_STEM  "xfce4/blconf/" BLCONF_BACKEND_SQLITE_TYPE_ID "/"
+#define DATABASE_FILE    "properties.db"
+
+/* how long a transaction stays open for more writes, in ms */
+#define COMMIT_DELAY     200
+/* and how long after a failed commit it's tried again */
+#define RETRY_DELAY      2000
+
+enum
+{
+    STMT_GET = 0,
+    STMT_SET,
+    STMT_DELETE,
+    STMT_RANGE,
+    STMT_DELETE_RANGE,
+    STMT_HAS_CHANNEL,
+    STMT_LIST_CHANNELS,
+    N_STMTS,
+};
+
+static const gchar *statements[N_STMTS] = {
+    /* STMT_GET */
+    "SELECT type, value FROM properties WHERE channel = ?1 AND name = ?2",
+    /* STMT_SET */
+    "INSERT OR REPLACE INTO properties (channel, name, type, value)"
+    " VALUES (?1, ?2, ?3, ?4)",
+    /* STMT_DELETE */
+    "DELETE FROM properties WHERE channel = ?1 AND name = ?2",
+    /* STMT_RANGE: ?2 is the base itself, everything below it sorts
+     * between ?3 (the base and a slash) and ?4 (the base and the
+     * character after the slash); ?5 is a cursor, ?6 a limit */
+    "SELECT name, type, value FROM properties"
+    " WHERE channel = ?1 AND (name = ?2 OR (name > ?3 AND name < ?4))"
+    " AND name > ?5 ORDER BY name LIMIT ?6",
+    /* STMT_DELETE_RANGE */
+    "DELETE FROM properties"
+    " WHERE channel = ?1 AND (name = ?2 OR (name > ?3 AND name < ?4))",
+    /* STMT_HAS_CHANNEL */
+    "SELECT 1 FROM properties WHERE channel = ?1 LIMIT 1",
+    /* STMT_LIST_CHANNELS */
+    "SELECT DISTINCT channel FROM properties",
+};
+
+struct _BlconfBackendSqlite
+{
+    GObject parent;
+
+    gchar *filename;
+    sqlite3 *db;
+    sqlite3_stmt *stmts[N_STMTS];
+
+    /* the connection and everything below, for reads coming from the
+     * daemon's worker threads */
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex db_lock;
+#else
+    GMutex *db_lock;
+#endif
+
+    gboolean in_transaction;
+    guint n_pending;  /* changes in the open transaction */
+    GPtrArray *writes;  /* BlconfSqliteWrite, not committed yet */
+    guint commit_id;
+    BlconfHistogram commit_times;
+
+    BlconfPropertyChangedFunc prop_changed_func;
+    gpointer prop_changed_data;
+    BlconfPropertyChangedFullFunc prop_changed_full_func;
+    gpointer prop_changed_full_data;
+    BlconfPropertiesResetFunc props_reset_func;
+    gpointer props_reset_data;
+};
+
+typedef struct _BlconfBackendSqliteClass
+{
+    GObjectClass parent;
+} BlconfBackendSqliteClass;
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define db_lock(bsql)    g_mutex_lock(&(bsql)->db_lock)
+#define db_unlock(bsql)  g_mutex_unlock(&(bsql)->db_lock)
+#else
+#define db_lock(bsql)    g_mutex_lock((bsql)->db_lock)
+#define db_unlock(bsql)  g_mutex_unlock((bsql)->db_lock)
+#endif
+
+/* a change made with the lock held, reported once it's dropped */
+typedef struct
+{
+    gchar *property;
+    GValue *old_value;
+    GValue *new_value;
+} BlconfSqliteChange;
+
+/* a write to make again if sqlite rolls back the transaction it
+ * was in */
+typedef struct
+{
+    gint stmt;  /* STMT_SET, STMT_DELETE or STMT_DELETE_RANGE */
+    gchar *channel;
+    gchar *property;
+    GVariant *value;  /* for STMT_SET */
+} BlconfSqliteWrite;
+
+static void blconf_backend_sqlite_finalize(GObject *obj);
+
+static void blconf_backend_sqlite_backend_init(BlconfBackendInterface *iface);
+static void blconf_sqlite_write_free(BlconfSqliteWrite *write);
+
+static gboolean blconf_backend_sqlite_flush(BlconfBackend *backend,
+                                            GError **error);
+
+
+G_DEFINE_TYPE_WITH_CODE(BlconfBackendSqlite, blconf_backend_sqlite, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(BLCONF_TYPE_BACKEND,
+                                              blconf_backend_sqlite_backend_init))
+
+
+static void
+blconf_backend_sqlite_class_init(BlconfBackendSqliteClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->finalize = blconf_backend_sqlite_finalize;
+}
+
+static void
+blconf_backend_sqlite_init(BlconfBackendSqlite *instance)
+{
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_init(&instance->db_lock);
+#else
+    instance->db_lock = g_mutex_new();
+#endif
+    instance->writes = g_ptr_array_new_with_free_func((GDestroyNotify)blconf_sqlite_write_free);
+}
+
+static void
+blconf_backend_sqlite_finalize(GObject *obj)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(obj);
+    gint i;
+
+    if(bsql->db) {
+        blconf_backend_sqlite_flush(BLCONF_BACKEND(bsql), NULL);
+        /* there's no later to try again */
+        if(bsql->commit_id)
+            g_source_remove(bsql->commit_id);
+
+        for(i = 0; i < N_STMTS; ++i)
+            sqlite3_finalize(bsql->stmts[i]);
+        sqlite3_close(bsql->db);
+    }
+
+    if(bsql->writes->len) {
+        g_warning("Unable to save %u changes to "%s"", bsql->writes->len,
+                  bsql->filename);
+    }
+    g_ptr_array_free(bsql->writes, TRUE);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_clear(&bsql->db_lock);
+#else
+    g_mutex_free(bsql->db_lock);
+#endif
+
+    g_free(bsql->filename);
+
+    G_OBJECT_CLASS(blconf_backend_sqlite_parent_class)->finalize(obj);
+}
+
+
+static void
+blconf_backend_sqlite_set_error(BlconfBackendSqlite *bsql,
+                                gint code,
+                                GError **error)
+{
+    if(error) {
+        g_set_error(error, BLCONF_ERROR, code, _("Database \"%s\": %s"),
+                    bsql->filename, sqlite3_errmsg(bsql->db));
+    }
+}
+
+static void
+blconf_backend_sqlite_set_not_found(const gchar *channel,
+                                    const gchar *property,
+                                    gboolean have_channel,
+                                    GError **error)
+{
+    if(!error)
+        return;
+
+    if(have_channel) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                    _("Property \"%s\" does not exist on channel \"%s\""),
+                    property, channel);
+    } else {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_CHANNEL_NOT_FOUND,
+                    _("Channel \"%s\" does not exist"), channel);
+    }
+}
+
+static gboolean
+blconf_backend_sqlite_exec(BlconfBackendSqlite *bsql,
+                           const gchar *sql,
+                           gint code,
+                           GError **error)
+{
+    if(sqlite3_exec(bsql->db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+        blconf_backend_sqlite_set_error(bsql, code, error);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_sqlite_initialize(BlconfBackend *backend,
+                                 GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    gchar *path;
+    gint i;
+
+    path = xfce_resource_save_location(XFCE_RESOURCE_CONFIG, CONFIG_DIR_STEM,
+                                       TRUE);
+    if(!path) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_WRITE_FAILURE,
+                        _("Unable to create configuration directory \"%s\""),
+                        CONFIG_DIR_STEM);
+        }
+        return FALSE;
+    }
+    bsql->filename = g_build_filename(path, DATABASE_FILE, NULL);
+    g_free(path);
+
+    /* our own lock covers the connection, sqlite's isn't needed */
+    if(sqlite3_open_v2(bsql->filename, &bsql->db,
+                       SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE
+                       | SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK)
+    {
+        blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_READ_FAILURE,
+                                        error);
+        return FALSE;
+    }
+
+    /* with a write-ahead log a commit is a single append, and readers
+     * of other connections (blconf-query --backend, say) don't block
+     * writes.  losing the last commits on a power cut is the same risk
+     * the XML backend takes between its saves. */
+    sqlite3_busy_timeout(bsql->db, 1000);
+    if(!blconf_backend_sqlite_exec(bsql, "PRAGMA journal_mode = WAL",
+                                   BLCONF_ERROR_READ_FAILURE, error)
+       || !blconf_backend_sqlite_exec(bsql, "PRAGMA synchronous = NORMAL",
+                                      BLCONF_ERROR_READ_FAILURE, error)
+       || !blconf_backend_sqlite_exec(bsql,
+                                      "CREATE TABLE IF NOT EXISTS properties ("
+                                      " channel TEXT NOT NULL,"
+                                      " name TEXT NOT NULL,"
+                                      " type TEXT NOT NULL,"
+                                      " value BLOB NOT NULL,"
+                                      " PRIMARY KEY (channel, name)"
+                                      ") WITHOUT ROWID",
+                                      BLCONF_ERROR_WRITE_FAILURE, error)
+       /* from before the names were folded; channel names are
+        * ASCII, so lower() does what g_ascii_strdown() does */
+       || !blconf_backend_sqlite_exec(bsql,
+                                      "UPDATE OR REPLACE properties"
+                                      " SET channel = lower(channel)"
+                                      " WHERE channel <> lower(channel)",
+                                      BLCONF_ERROR_WRITE_FAILURE, error))
+    {
+        return FALSE;
+    }
+
+    for(i = 0; i < N_STMTS; ++i) {
+        if(sqlite3_prepare_v2(bsql->db, statements[i], -1, &bsql->stmts[i],
+                              NULL) != SQLITE_OK)
+        {
+            blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_INTERNAL_ERROR,
+                                            error);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+/* values are stored as serialised GVariants, with their type string */
+static gboolean
+blconf_backend_sqlite_column_value(sqlite3_stmt *stmt,
+                                   gint type_column,
+                                   GValue *value)
+{
+    const gchar *type = (const gchar *)sqlite3_column_text(stmt, type_column);
+    gconstpointer data = sqlite3_column_blob(stmt, type_column + 1);
+    gsize size = sqlite3_column_bytes(stmt, type_column + 1);
+    GVariant *variant;
+    GBytes *bytes;
+    gboolean ret;
+
+    if(!type || !g_variant_type_string_is_valid(type))
+        return FALSE;
+
+    /* not trusted: GVariant checks the data as it's read */
+    bytes = g_bytes_new(data ? data : "", size);
+    variant = g_variant_ref_sink(g_variant_new_from_bytes(G_VARIANT_TYPE(type),
+                                                          bytes, FALSE));
+    g_bytes_unref(bytes);
+
+    ret = _blconf_gvariant_to_gvalue(variant, value);
+    g_variant_unref(variant);
+
+    return ret;
+}
+
+static void
+blconf_backend_sqlite_bind_variant(sqlite3_stmt *stmt,
+                                   gint type_column,
+                                   GVariant *variant)
+{
+    sqlite3_bind_text(stmt, type_column, g_variant_get_type_string(variant),
+                      -1, SQLITE_STATIC);
+    if(g_variant_get_size(variant)) {
+        sqlite3_bind_blob(stmt, type_column + 1, g_variant_get_data(variant),
+                          g_variant_get_size(variant), SQLITE_STATIC);
+    } else
+        sqlite3_bind_zeroblob(stmt, type_column + 1, 0);
+}
+
+static gboolean
+blconf_backend_sqlite_bind_value(sqlite3_stmt *stmt,
+                                 gint type_column,
+                                 const GValue *value,
+                                 GVariant **variant)
+{
+    *variant = _blconf_gvalue_to_gvariant(value);
+    if(!*variant)
+        return FALSE;
+    g_variant_ref_sink(*variant);
+
+    blconf_backend_sqlite_bind_variant(stmt, type_column, *variant);
+
+    return TRUE;
+}
+
+/* called with the lock held; leaves |value| unset if there's none */
+static gboolean
+blconf_backend_sqlite_lookup(BlconfBackendSqlite *bsql,
+                             const gchar *channel,
+                             const gchar *property,
+                             GValue *value,
+                             GError **error)
+{
+    sqlite3_stmt *stmt = bsql->stmts[STMT_GET];
+    gboolean ret = TRUE;
+    gint rc;
+
+    sqlite3_bind_text(stmt, 1, channel, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, property, -1, SQLITE_STATIC);
+
+    rc = sqlite3_step(stmt);
+    if(rc == SQLITE_ROW) {
+        if(!blconf_backend_sqlite_column_value(stmt, 0, value)) {
+            if(error) {
+                g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_READ_FAILURE,
+                            _("Property \"%s\" on channel \"%s\" has an invalid value"),
+                            property, channel);
+            }
+            ret = FALSE;
+        }
+    } else if(rc != SQLITE_DONE) {
+        blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_READ_FAILURE, error);
+        ret = FALSE;
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    return ret;
+}
+
+/* called with the lock held */
+static gboolean
+blconf_backend_sqlite_has_channel(BlconfBackendSqlite *bsql,
+                                  const gchar *channel)
+{
+    sqlite3_stmt *stmt = bsql->stmts[STMT_HAS_CHANNEL];
+    gboolean ret;
+
+    sqlite3_bind_text(stmt, 1, channel, -1, SQLITE_STATIC);
+    ret = (sqlite3_step(stmt) == SQLITE_ROW);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    return ret;
+}
+
+/* binds the subtree at |property_base| to |stmt|'s parameters 1-4 */
+static void
+blconf_backend_sqlite_bind_range(sqlite3_stmt *stmt,
+                                 const gchar *channel,
+                                 const gchar *property_base,
+                                 gchar **lower,
+                                 gchar **upper)
+{
+    if(!property_base[0] || !property_base[1])
+        property_base = "";
+
+    /* '0' comes right after '/' */
+    *lower = g_strconcat(property_base, "/", NULL);
+    *upper = g_strconcat(property_base, "0", NULL);
+
+    sqlite3_bind_text(stmt, 1, channel, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, property_base, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, *lower, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, *upper, -1, SQLITE_STATIC);
+}
+
+typedef void (*BlconfSqliteRowFunc)(const gchar *property,
+                                    GValue *value,
+                                    gpointer user_data);
+
+/* calls |func| for every property under |property_base| after
+ * |cursor|, in order, at most |limit| times (-1 for no limit).
+ * called with the lock held; returns the number of rows, or -1 */
+static gint
+blconf_backend_sqlite_scan(BlconfBackendSqlite *bsql,
+                           const gchar *channel,
+                           const gchar *property_base,
+                           const gchar *cursor,
+                           gint limit,
+                           BlconfSqliteRowFunc func,
+                           gpointer user_data,
+                           GError **error)
+{
+    sqlite3_stmt *stmt = bsql->stmts[STMT_RANGE];
+    gchar *lower, *upper;
+    gint n = 0, rc;
+
+    blconf_backend_sqlite_bind_range(stmt, channel, property_base,
+                                     &lower, &upper);
+    sqlite3_bind_text(stmt, 5, cursor, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 6, limit);
+
+    while((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        GValue *value = g_new0(GValue, 1);
+
+        if(blconf_backend_sqlite_column_value(stmt, 1, value)) {
+            func((const gchar *)sqlite3_column_text(stmt, 0), value,
+                 user_data);
+        } else
+            g_free(value);
+        ++n;
+    }
+
+    if(rc != SQLITE_DONE) {
+        blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_READ_FAILURE, error);
+        n = -1;
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    g_free(lower);
+    g_free(upper);
+
+    return n;
+}
+
+
+static gboolean
+blconf_backend_sqlite_commit_timeout(gpointer data)
+{
+    BlconfBackendSqlite *bsql = data;
+
+    bsql->commit_id = 0;
+    blconf_backend_sqlite_flush(BLCONF_BACKEND(bsql), NULL);
+
+    return FALSE;
+}
+
+static void
+blconf_sqlite_write_free(BlconfSqliteWrite *write)
+{
+    g_free(write->channel);
+    g_free(write->property);
+    if(write->value)
+        g_variant_unref(write->value);
+    g_slice_free(BlconfSqliteWrite, write);
+}
+
+/* called with the lock held, after each change */
+static void
+blconf_backend_sqlite_add_write(BlconfBackendSqlite *bsql,
+                                gint stmt,
+                                const gchar *channel,
+                                const gchar *property,
+                                GVariant *value)
+{
+    BlconfSqliteWrite *write = g_slice_new(BlconfSqliteWrite);
+
+    write->stmt = stmt;
+    write->channel = g_strdup(channel);
+    write->property = g_strdup(property);
+    write->value = value ? g_variant_ref(value) : NULL;
+    g_ptr_array_add(bsql->writes, write);
+}
+
+/* called with the lock held, in a new transaction: makes the writes
+ * of one that sqlite rolled back again */
+static gboolean
+blconf_backend_sqlite_replay(BlconfBackendSqlite *bsql,
+                             GError **error)
+{
+    guint i;
+
+    for(i = 0; i < bsql->writes->len; ++i) {
+        BlconfSqliteWrite *write = g_ptr_array_index(bsql->writes, i);
+        sqlite3_stmt *stmt = bsql->stmts[write->stmt];
+        gchar *lower = NULL, *upper = NULL;
+        gint rc;
+
+        if(write->stmt == STMT_DELETE_RANGE) {
+            blconf_backend_sqlite_bind_range(stmt, write->channel,
+                                             write->property, &lower, &upper);
+        } else {
+            sqlite3_bind_text(stmt, 1, write->channel, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, write->property, -1, SQLITE_STATIC);
+            if(write->value)
+                blconf_backend_sqlite_bind_variant(stmt, 3, write->value);
+        }
+
+        rc = sqlite3_step(stmt);
+        if(rc != SQLITE_DONE)
+            blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_WRITE_FAILURE, error);
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        g_free(lower);
+        g_free(upper);
+
+        if(rc != SQLITE_DONE)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* called with the lock held, before each change */
+static gboolean
+blconf_backend_sqlite_begin(BlconfBackendSqlite *bsql,
+                            GError **error)
+{
+    if(bsql->in_transaction)
+        return TRUE;
+
+    if(!blconf_backend_sqlite_exec(bsql, "BEGIN", BLCONF_ERROR_WRITE_FAILURE,
+                                   error))
+    {
+        return FALSE;
+    }
+    if(!blconf_backend_sqlite_replay(bsql, error)) {
+        blconf_backend_sqlite_exec(bsql, "ROLLBACK",
+                                   BLCONF_ERROR_WRITE_FAILURE, NULL);
+        return FALSE;
+    }
+    bsql->in_transaction = TRUE;
+
+    if(!bsql->commit_id) {
+        bsql->commit_id = g_timeout_add(COMMIT_DELAY,
+                                        blconf_backend_sqlite_commit_timeout,
+                                        bsql);
+    }
+
+    return TRUE;
+}
+
+static BlconfSqliteChange *
+blconf_sqlite_change_new(const gchar *property,
+                         GValue *old_value,
+                         const GValue *new_value)
+{
+    BlconfSqliteChange *change = g_slice_new0(BlconfSqliteChange);
+
+    change->property = g_strdup(property);
+    change->old_value = old_value;
+    if(new_value) {
+        change->new_value = g_new0(GValue, 1);
+        g_value_copy(new_value, g_value_init(change->new_value,
+                                             G_VALUE_TYPE(new_value)));
+    }
+
+    return change;
+}
+
+static void
+blconf_sqlite_change_free(BlconfSqliteChange *change)
+{
+    g_free(change->property);
+    if(change->old_value)
+        _blconf_gvalue_free(change->old_value);
+    if(change->new_value)
+        _blconf_gvalue_free(change->new_value);
+    g_slice_free(BlconfSqliteChange, change);
+}
+
+/* reports |changes| (the last one first), with the lock dropped so
+ * the handlers may read the backend again; frees the list */
+static void
+blconf_backend_sqlite_notify(BlconfBackendSqlite *bsql,
+                             const gchar *channel,
+                             GSList *changes)
+{
+    GSList *l;
+
+    changes = g_slist_reverse(changes);
+    for(l = changes; l; l = l->next) {
+        BlconfSqliteChange *change = l->data;
+
+        if(bsql->prop_changed_full_func) {
+            bsql->prop_changed_full_func(BLCONF_BACKEND(bsql), channel,
+                                         change->property, change->old_value,
+                                         change->new_value,
+                                         bsql->prop_changed_full_data);
+        }
+        if(bsql->prop_changed_func) {
+            bsql->prop_changed_func(BLCONF_BACKEND(bsql), channel,
+                                    change->property,
+                                    bsql->prop_changed_data);
+        }
+    }
+
+    g_slist_foreach(changes, (GFunc)blconf_sqlite_change_free, NULL);
+    g_slist_free(changes);
+}
+
+/* called with the lock held; prepends what changed to |*changes| */
+static gboolean
+blconf_backend_sqlite_set_internal(BlconfBackendSqlite *bsql,
+                                   const gchar *channel,
+                                   const gchar *property,
+                                   const GValue *value,
+                                   GSList **changes,
+                                   GError **error)
+{
+    sqlite3_stmt *stmt = bsql->stmts[STMT_SET];
+    GValue *old_value = g_new0(GValue, 1);
+    GVariant *variant;
+    gint rc;
+
+    if(!blconf_backend_sqlite_lookup(bsql, channel, property, old_value,
+                                     error))
+    {
+        g_free(old_value);
+        return FALSE;
+    }
+
+    if(G_VALUE_TYPE(old_value) && _blconf_gvalue_is_equal(old_value, value)) {
+        _blconf_gvalue_free(old_value);
+        return TRUE;
+    }
+
+    if(!blconf_backend_sqlite_begin(bsql, error)) {
+        _blconf_gvalue_free(old_value);
+        return FALSE;
+    }
+
+    sqlite3_bind_text(stmt, 1, channel, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, property, -1, SQLITE_STATIC);
+    if(!blconf_backend_sqlite_bind_value(stmt, 3, value, &variant)) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                        _("Values of type \"%s\" can't be stored"),
+                        G_VALUE_TYPE_NAME(value));
+        }
+        sqlite3_clear_bindings(stmt);
+        _blconf_gvalue_free(old_value);
+        return FALSE;
+    }
+
+    rc = sqlite3_step(stmt);
+    if(rc != SQLITE_DONE)
+        blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_WRITE_FAILURE, error);
+    else {
+        blconf_backend_sqlite_add_write(bsql, STMT_SET, channel, property,
+                                        variant);
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    g_variant_unref(variant);
+
+    if(rc != SQLITE_DONE) {
+        _blconf_gvalue_free(old_value);
+        return FALSE;
+    }
+
+    bsql->n_pending++;
+    if(!G_VALUE_TYPE(old_value)) {
+        g_free(old_value);
+        old_value = NULL;
+    }
+    *changes = g_slist_prepend(*changes,
+                               blconf_sqlite_change_new(property, old_value,
+                                                        value));
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_sqlite_set(BlconfBackend *backend,
+                          const gchar *channel,
+                          const gchar *property,
+                          const GValue *value,
+                          GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    GSList *changes = NULL;
+    gchar *key = g_ascii_strdown(channel, -1);
+    gboolean ret;
+
+    db_lock(bsql);
+    ret = blconf_backend_sqlite_set_internal(bsql, key, property, value,
+                                             &changes, error);
+    db_unlock(bsql);
+    g_free(key);
+
+    blconf_backend_sqlite_notify(bsql, channel, changes);
+
+    return ret;
+}
+
+static gboolean
+blconf_backend_sqlite_set_many(BlconfBackend *backend,
+                               const gchar *channel,
+                               GHashTable *properties,
+                               GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    GSList *changes = NULL;
+    GHashTableIter iter;
+    gpointer property, value;
+    gboolean ret = TRUE;
+    guint n_writes;
+    gchar *key;
+
+    db_lock(bsql);
+
+    /* all or nothing: on a failure, take back this call's changes by
+     * rolling back to the savepoint, but keep the earlier ones */
+    if(!blconf_backend_sqlite_begin(bsql, error)
+       || !blconf_backend_sqlite_exec(bsql, "SAVEPOINT set_many",
+                                      BLCONF_ERROR_WRITE_FAILURE, error))
+    {
+        db_unlock(bsql);
+        return FALSE;
+    }
+    n_writes = bsql->writes->len;
+
+    key = g_ascii_strdown(channel, -1);
+    g_hash_table_iter_init(&iter, properties);
+    while(ret && g_hash_table_iter_next(&iter, &property, &value)) {
+        ret = blconf_backend_sqlite_set_internal(bsql, key, property,
+                                                 value, &changes, error);
+    }
+    g_free(key);
+
+    if(ret) {
+        blconf_backend_sqlite_exec(bsql, "RELEASE set_many",
+                                   BLCONF_ERROR_WRITE_FAILURE, NULL);
+    } else {
+        blconf_backend_sqlite_exec(bsql,
+                                   "ROLLBACK TO set_many; RELEASE set_many",
+                                   BLCONF_ERROR_WRITE_FAILURE, NULL);
+        bsql->n_pending -= g_slist_length(changes);
+        g_ptr_array_set_size(bsql->writes, n_writes);
+        g_slist_foreach(changes, (GFunc)blconf_sqlite_change_free, NULL);
+        g_slist_free(changes);
+        changes = NULL;
+    }
+
+    db_unlock(bsql);
+
+    blconf_backend_sqlite_notify(bsql, channel, changes);
+
+    return ret;
+}
+
+static gboolean
+blconf_backend_sqlite_get(BlconfBackend *backend,
+                          const gchar *channel,
+                          const gchar *property,
+                          GValue *value,
+                          GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    gchar *key = g_ascii_strdown(channel, -1);
+    gboolean ret;
+
+    db_lock(bsql);
+
+    ret = blconf_backend_sqlite_lookup(bsql, key, property, value, error);
+    if(ret && !G_VALUE_TYPE(value)) {
+        blconf_backend_sqlite_set_not_found(channel, property,
+                                            blconf_backend_sqlite_has_channel(bsql,
+                                                                              key),
+                                            error);
+        ret = FALSE;
+    }
+
+    db_unlock(bsql);
+    g_free(key);
+
+    return ret;
+}
+
+static void
+blconf_backend_sqlite_insert_row(const gchar *property,
+                                 GValue *value,
+                                 gpointer user_data)
+{
+    g_hash_table_insert(user_data, g_strdup(property), value);
+}
+
+static gboolean
+blconf_backend_sqlite_get_all(BlconfBackend *backend,
+                              const gchar *channel,
+                              const gchar *property_base,
+                              GHashTable *properties,
+                              GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    gchar *key = g_ascii_strdown(channel, -1);
+    gint n;
+
+    db_lock(bsql);
+
+    n = blconf_backend_sqlite_scan(bsql, key, property_base, "", -1,
+                                   blconf_backend_sqlite_insert_row,
+                                   properties, error);
+    if(n == 0) {
+        blconf_backend_sqlite_set_not_found(channel, property_base,
+                                            property_base[0] && property_base[1]
+                                            && blconf_backend_sqlite_has_channel(bsql,
+                                                                                 key),
+                                            error);
+    }
+
+    db_unlock(bsql);
+    g_free(key);
+
+    return n > 0;
+}
+
+typedef struct
+{
+    GHashTable *properties;
+    guint page_size;
+    guint n;
+    gchar *last;
+} BlconfSqlitePage;
+
+static void
+blconf_backend_sqlite_insert_page_row(const gchar *property,
+                                      GValue *value,
+                                      gpointer user_data)
+{
+    BlconfSqlitePage *page = user_data;
+
+    /* the row past the end only tells us there's more */
+    if(page->n++ == page->page_size) {
+        _blconf_gvalue_free(value);
+        return;
+    }
+
+    g_hash_table_insert(page->properties, g_strdup(property), value);
+    g_free(page->last);
+    page->last = g_strdup(property);
+}
+
+static gboolean
+blconf_backend_sqlite_get_all_paged(BlconfBackend *backend,
+                                    const gchar *channel,
+                                    const gchar *property_base,
+                                    const gchar *cursor,
+                                    guint page_size,
+                                    GHashTable *properties,
+                                    gchar **next_cursor,
+                                    GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    BlconfSqlitePage page = { properties, page_size, 0, NULL };
+    gchar *key;
+    gint n;
+
+    if(!page_size || page_size >= G_MAXINT)
+        page.page_size = G_MAXINT - 1;
+
+    key = g_ascii_strdown(channel, -1);
+    db_lock(bsql);
+
+    /* the cursor is the last property of the previous page; unlike the
+     * XML backend we can pick up after it even if it's gone since */
+    n = blconf_backend_sqlite_scan(bsql, key, property_base, cursor,
+                                   page.page_size + 1,
+                                   blconf_backend_sqlite_insert_page_row,
+                                   &page, error);
+    if(n == 0 && !*cursor) {
+        blconf_backend_sqlite_set_not_found(channel, property_base,
+                                            property_base[0] && property_base[1]
+                                            && blconf_backend_sqlite_has_channel(bsql,
+                                                                                 key),
+                                            error);
+        n = -1;
+    }
+
+    db_unlock(bsql);
+    g_free(key);
+
+    if(n < 0) {
+        g_free(page.last);
+        return FALSE;
+    }
+
+    if((guint)n > page.page_size)
+        *next_cursor = page.last;
+    else {
+        *next_cursor = g_strdup("");
+        g_free(page.last);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_sqlite_get_many(BlconfBackend *backend,
+                               const gchar *channel,
+                               const gchar * const *properties,
+                               GHashTable *values,
+                               GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    gchar *key = g_ascii_strdown(channel, -1);
+    gint i;
+
+    db_lock(bsql);
+
+    for(i = 0; properties[i]; ++i) {
+        GValue *value = g_new0(GValue, 1);
+
+        if(blconf_backend_sqlite_lookup(bsql, key, properties[i], value,
+                                        NULL)
+           && G_VALUE_TYPE(value))
+        {
+            g_hash_table_insert(values, g_strdup(properties[i]), value);
+        } else
+            g_free(value);
+    }
+
+    db_unlock(bsql);
+    g_free(key);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_sqlite_exists(BlconfBackend *backend,
+                             const gchar *channel,
+                             const gchar *property,
+                             gboolean *exists,
+                             GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    GValue value = { 0, };
+    gchar *key = g_ascii_strdown(channel, -1);
+    gboolean ret;
+
+    /* like the other backends, a missing channel is just FALSE; see
+     * blconf_backend_exists() */
+    db_lock(bsql);
+    ret = blconf_backend_sqlite_lookup(bsql, key, property, &value, error);
+    db_unlock(bsql);
+    g_free(key);
+
+    *exists = (ret && G_VALUE_TYPE(&value));
+    if(G_VALUE_TYPE(&value))
+        g_value_unset(&value);
+
+    return ret;
+}
+
+static void
+blconf_backend_sqlite_collect_name(const gchar *property,
+                                   GValue *value,
+                                   gpointer user_data)
+{
+    g_ptr_array_add(user_data, g_strdup(property));
+    _blconf_gvalue_free(value);
+}
+
+/* called with the lock held; gives back the names that went away in
+ * |*removed|, NULL-terminated, or NULL if there were none */
+static gboolean
+blconf_backend_sqlite_reset_range(BlconfBackendSqlite *bsql,
+                                  const gchar *channel,
+                                  const gchar *property_base,
+                                  gchar ***removed,
+                                  GError **error)
+{
+    sqlite3_stmt *stmt = bsql->stmts[STMT_DELETE_RANGE];
+    GPtrArray *names = g_ptr_array_new();
+    gchar *lower, *upper;
+    gint rc;
+
+    *removed = NULL;
+
+    if(blconf_backend_sqlite_scan(bsql, channel, property_base, "", -1,
+                                  blconf_backend_sqlite_collect_name,
+                                  names, error) < 0
+       || (names->len && !blconf_backend_sqlite_begin(bsql, error)))
+    {
+        g_ptr_array_foreach(names, (GFunc)g_free, NULL);
+        g_ptr_array_free(names, TRUE);
+        return FALSE;
+    }
+
+    if(!names->len) {
+        g_ptr_array_free(names, TRUE);
+        return TRUE;
+    }
+
+    blconf_backend_sqlite_bind_range(stmt, channel, property_base,
+                                     &lower, &upper);
+    rc = sqlite3_step(stmt);
+    if(rc != SQLITE_DONE)
+        blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_WRITE_FAILURE, error);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    g_free(lower);
+    g_free(upper);
+
+    if(rc != SQLITE_DONE) {
+        g_ptr_array_foreach(names, (GFunc)g_free, NULL);
+        g_ptr_array_free(names, TRUE);
+        return FALSE;
+    }
+
+    blconf_backend_sqlite_add_write(bsql, STMT_DELETE_RANGE, channel,
+                                    property_base, NULL);
+    bsql->n_pending += names->len;
+    g_ptr_array_add(names, NULL);
+    *removed = (gchar **)g_ptr_array_free(names, FALSE);
+
+    return TRUE;
+}
+
+/* called with the lock held; prepends what changed to |*changes| */
+static gboolean
+blconf_backend_sqlite_reset_internal(BlconfBackendSqlite *bsql,
+                                     const gchar *channel,
+                                     const gchar *property,
+                                     GSList **changes,
+                                     GError **error)
+{
+    sqlite3_stmt *stmt = bsql->stmts[STMT_DELETE];
+    GValue *old_value = g_new0(GValue, 1);
+    gint rc;
+
+    if(!blconf_backend_sqlite_lookup(bsql, channel, property, old_value,
+                                     error))
+    {
+        g_free(old_value);
+        return FALSE;
+    }
+
+    if(!G_VALUE_TYPE(old_value)) {
+        g_free(old_value);
+        blconf_backend_sqlite_set_not_found(channel, property, TRUE, error);
+        return FALSE;
+    }
+
+    if(!blconf_backend_sqlite_begin(bsql, error)) {
+        _blconf_gvalue_free(old_value);
+        return FALSE;
+    }
+
+    sqlite3_bind_text(stmt, 1, channel, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, property, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    if(rc != SQLITE_DONE)
+        blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_WRITE_FAILURE, error);
+    else {
+        blconf_backend_sqlite_add_write(bsql, STMT_DELETE, channel, property,
+                                        NULL);
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if(rc != SQLITE_DONE) {
+        _blconf_gvalue_free(old_value);
+        return FALSE;
+    }
+
+    bsql->n_pending++;
+    *changes = g_slist_prepend(*changes,
+                               blconf_sqlite_change_new(property, old_value,
+                                                        NULL));
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_sqlite_reset(BlconfBackend *backend,
+                            const gchar *channel,
+                            const gchar *property,
+                            gboolean recursive,
+                            GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    GSList *changes = NULL;
+    gchar **removed = NULL;
+    gchar *key = g_ascii_strdown(channel, -1);
+    gboolean ret;
+
+    db_lock(bsql);
+
+    if(recursive) {
+        ret = blconf_backend_sqlite_reset_range(bsql, key, property,
+                                                &removed, error);
+        if(ret && !removed) {
+            blconf_backend_sqlite_set_not_found(channel, property,
+                                                property[0] && property[1]
+                                                && blconf_backend_sqlite_has_channel(bsql,
+                                                                                     key),
+                                                error);
+            ret = FALSE;
+        }
+    } else {
+        ret = blconf_backend_sqlite_reset_internal(bsql, key, property,
+                                                   &changes, error);
+    }
+
+    db_unlock(bsql);
+    g_free(key);
+
+    /* a subtree goes out as one event, like in the XML backend; there
+     * are no defaults to fall back to, so that's all there is to say */
+    if(removed) {
+        if(bsql->props_reset_func) {
+            bsql->props_reset_func(backend, channel, property, removed,
+                                   bsql->props_reset_data);
+        } else {
+            gint i;
+
+            for(i = 0; removed[i]; ++i) {
+                changes = g_slist_prepend(changes,
+                                          blconf_sqlite_change_new(removed[i],
+                                                                   NULL, NULL));
+            }
+        }
+        g_strfreev(removed);
+    }
+
+    blconf_backend_sqlite_notify(bsql, channel, changes);
+
+    return ret;
+}
+
+static gboolean
+blconf_backend_sqlite_reset_many(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 const gchar * const *properties,
+                                 GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    GSList *changes = NULL;
+    gchar *key = g_ascii_strdown(channel, -1);
+    gint i;
+
+    db_lock(bsql);
+
+    for(i = 0; properties[i]; ++i) {
+        GError *tmp_error = NULL;
+
+        if(!blconf_backend_sqlite_reset_internal(bsql, key, properties[i],
+                                                 &changes, &tmp_error))
+        {
+            if(!g_error_matches(tmp_error, BLCONF_ERROR,
+                                BLCONF_ERROR_PROPERTY_NOT_FOUND))
+            {
+                g_propagate_error(error, tmp_error);
+                db_unlock(bsql);
+                g_free(key);
+                blconf_backend_sqlite_notify(bsql, channel, changes);
+                return FALSE;
+            }
+            g_error_free(tmp_error);
+        }
+    }
+
+    db_unlock(bsql);
+    g_free(key);
+
+    blconf_backend_sqlite_notify(bsql, channel, changes);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_sqlite_list_channels(BlconfBackend *backend,
+                                    GSList **channels,
+                                    GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    sqlite3_stmt *stmt = bsql->stmts[STMT_LIST_CHANNELS];
+    gint rc;
+
+    db_lock(bsql);
+
+    while((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        *channels = g_slist_prepend(*channels,
+                                    g_strdup((const gchar *)sqlite3_column_text(stmt, 0)));
+    }
+    if(rc != SQLITE_DONE)
+        blconf_backend_sqlite_set_error(bsql, BLCONF_ERROR_READ_FAILURE, error);
+    sqlite3_reset(stmt);
+
+    db_unlock(bsql);
+
+    return rc == SQLITE_DONE;
+}
+
+static gboolean
+blconf_backend_sqlite_is_property_locked(BlconfBackend *backend,
+                                         const gchar *channel,
+                                         const gchar *property,
+                                         gboolean *locked,
+                                         GError **error)
+{
+    /* locks come from the system files of the backends below */
+    *locked = FALSE;
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_sqlite_flush(BlconfBackend *backend,
+                            GError **error)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    gboolean ret = TRUE;
+    gint64 start;
+
+    db_lock(bsql);
+
+    /* the writes of a transaction sqlite threw away, see below */
+    if(!bsql->in_transaction && bsql->writes->len)
+        ret = blconf_backend_sqlite_begin(bsql, error);
+
+    if(bsql->commit_id) {
+        g_source_remove(bsql->commit_id);
+        bsql->commit_id = 0;
+    }
+
+    if(ret && bsql->in_transaction) {
+        start = g_get_monotonic_time();
+        ret = blconf_backend_sqlite_exec(bsql, "COMMIT",
+                                         BLCONF_ERROR_WRITE_FAILURE, error);
+        blconf_histogram_record(&bsql->commit_times,
+                                g_get_monotonic_time() - start);
+
+        if(ret) {
+            bsql->in_transaction = FALSE;
+            bsql->n_pending = 0;
+            g_ptr_array_set_size(bsql->writes, 0);
+        } else if(sqlite3_get_autocommit(bsql->db)) {
+            /* on some errors, like SQLITE_FULL, sqlite may roll back
+             * the whole transaction; make the writes again in a new
+             * one, so reads still see them */
+            bsql->in_transaction = FALSE;
+            blconf_backend_sqlite_begin(bsql, NULL);
+        }
+        /* otherwise, as on SQLITE_BUSY, it's still open and the
+         * changes are still in it */
+    }
+
+    if(!ret) {
+        g_warning("Unable to save %u changes to \"%s\", trying again later: %s",
+                  bsql->n_pending, bsql->filename, sqlite3_errmsg(bsql->db));
+        if(bsql->commit_id)
+            g_source_remove(bsql->commit_id);
+        bsql->commit_id = g_timeout_add(RETRY_DELAY,
+                                        blconf_backend_sqlite_commit_timeout,
+                                        bsql);
+    }
+
+    db_unlock(bsql);
+
+    return ret;
+}
+
+static void
+blconf_backend_sqlite_register_property_changed_func(BlconfBackend *backend,
+                                                     BlconfPropertyChangedFunc func,
+                                                     gpointer user_data)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+
+    bsql->prop_changed_func = func;
+    bsql->prop_changed_data = user_data;
+}
+
+static void
+blconf_backend_sqlite_register_properties_reset_func(BlconfBackend *backend,
+                                                     BlconfPropertiesResetFunc func,
+                                                     gpointer user_data)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+
+    bsql->props_reset_func = func;
+    bsql->props_reset_data = user_data;
+}
+
+static void
+blconf_backend_sqlite_register_property_changed_full_func(BlconfBackend *backend,
+                                                          BlconfPropertyChangedFullFunc func,
+                                                          gpointer user_data)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+
+    bsql->prop_changed_full_func = func;
+    bsql->prop_changed_full_data = user_data;
+}
+
+/* "commits" latencies and "pending-writes", see blconf_daemon_get_stats() */
+static GVariant *
+blconf_backend_sqlite_get_stats(BlconfBackend *backend)
+{
+    BlconfBackendSqlite *bsql = BLCONF_BACKEND_SQLITE(backend);
+    GVariantBuilder builder;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "commits",
+                          blconf_histogram_to_variant(&bsql->commit_times));
+
+    db_lock(bsql);
+    g_variant_builder_add(&builder, "{sv}", "pending-writes",
+                          g_variant_new_uint32(bsql->n_pending));
+    db_unlock(bsql);
+
+    return g_variant_builder_end(&builder);
+}
+
+static void
+blconf_backend_sqlite_backend_init(BlconfBackendInterface *iface)
+{
+    iface->initialize = blconf_backend_sqlite_initialize;
+    iface->set = blconf_backend_sqlite_set;
+    iface->get = blconf_backend_sqlite_get;
+    iface->get_all = blconf_backend_sqlite_get_all;
+    iface->get_all_paged = blconf_backend_sqlite_get_all_paged;
+    iface->exists = blconf_backend_sqlite_exists;
+    iface->reset = blconf_backend_sqlite_reset;
+    iface->list_channels = blconf_backend_sqlite_list_channels;
+    iface->is_property_locked = blconf_backend_sqlite_is_property_locked;
+    iface->flush = blconf_backend_sqlite_flush;
+    iface->register_property_changed_func = blconf_backend_sqlite_register_property_changed_func;
+    iface->register_properties_reset_func = blconf_backend_sqlite_register_properties_reset_func;
+    iface->set_many = blconf_backend_sqlite_set_many;
+    iface->get_many = blconf_backend_sqlite_get_many;
+    iface->reset_many = blconf_backend_sqlite_reset_many;
+    iface->register_property_changed_full_func = blconf_backend_sqlite_register_property_changed_full_func;
+    iface->get_stats = blconf_backend_sqlite_get_stats;
+}
@@ -0,0 +1,40 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_BACKEND_SQLITE_H__
+#define __BLCONF_BACKEND_SQLITE_H__
+
+#include <glib-object.h>
+
+#define BLCONF_TYPE_BACKEND_SQLITE             (blconf_backend_sqlite_get_type())
+#define BLCONF_BACKEND_SQLITE(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), BLCONF_TYPE_BACKEND_SQLITE, BlconfBackendSqlite))
+#define BLCONF_IS_BACKEND_SQLITE(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), BLCONF_TYPE_BACKEND_SQLITE))
+#define BLCONF_BACKEND_SQLITE_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), BLCONF_TYPE_BACKEND_SQLITE, BlconfBackendSqliteClass))
+#define BLCONF_IS_BACKEND_SQLITE_CLASS(klass)  (G_TYPE_CHECK_CLASS_TYPE((klass), BLCONF_TYPE_BACKEND_SQLITE))
+#define BLCONF_BACKEND_SQLITE_GET_CLASS(obj)   (G_TYPE_INSTANCE_GET_CLASS((obj), BLCONF_TYPE_BACKEND_SQLITE, BlconfBackendSqliteClass))
+
+#define BLCONF_BACKEND_SQLITE_TYPE_ID          "sqlite"
+
+G_BEGIN_DECLS
+
+typedef struct _BlconfBackendSqlite         BlconfBackendSqlite;
+
+GType blconf_backend_sqlite_get_type(void) G_GNUC_CONST;
+
+G_END_DECLS
+
+#endif  /* __BLCONF_BACKEND_SQLITE_H__ */
@@ -0,0 +1,950 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A backend that only keeps things in memory, for kiosks and test
+ * runs that start from the same settings every time and shouldn't
+ * wear out their storage.  Nothing it's given survives blconfd.
+ *
+ * It has no defaults or locks of its own: layered over the XML backend
+ * (--backends=volatile,xfce-perchannel-xml) it takes all the writes
+ * while reads fall back to the user's and the system's files, which
+ * are never written to.
+ *
+ * If BLCONFD_VOLATILE_DIR names a directory, the channels are seeded
+ * from the CHANNEL.snapshot files there, and SIGUSR2 makes blconfd
+ * write what it holds now back to them.  The files have the layout of
+ * the snapshots in common/blconf-snapshot.h.  That's the only time
+ * this backend touches the disk. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <libbladeutil/libbladeutil.h>
+
+#include "blconf-backend-volatile.h"
+#include "blconf-backend.h"
+#include "common/blconf-gvaluefuncs.h"
+#include "common/blconf-snapshot.h"
+#include "blconf/blconf-types.h"
+#include "common/blconf-common-private.h"
+
+#define SNAPSHOT_SUFFIX  ".snapshot"
+
+struct _BlconfBackendVolatile
+{
+    GObject parent;
+
+    gchar *dump_dir;
+
+    /* channel name -> GHashTable of property name -> GValue; a channel
+     * that's been reset entirely stays, empty, so the next dump clears
+     * its file */
+    GHashTable *channels;
+
+    /* for reads coming from the daemon's worker threads; writes are
+     * only made on the main thread */
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex lock;
+#else
+    GMutex *lock;
+#endif
+
+    BlconfPropertyChangedFunc prop_changed_func;
+    gpointer prop_changed_data;
+    BlconfPropertyChangedFullFunc prop_changed_full_func;
+    gpointer prop_changed_full_data;
+    BlconfPropertiesResetFunc props_reset_func;
+    gpointer props_reset_data;
+};
+
+typedef struct _BlconfBackendVolatileClass
+{
+    GObjectClass parent;
+} BlconfBackendVolatileClass;
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define volatile_lock(bvol)    g_mutex_lock(&(bvol)->lock)
+#define volatile_unlock(bvol)  g_mutex_unlock(&(bvol)->lock)
+#else
+#define volatile_lock(bvol)    g_mutex_lock((bvol)->lock)
+#define volatile_unlock(bvol)  g_mutex_unlock((bvol)->lock)
+#endif
+
+/* a change made with the lock held, reported once it's dropped */
+typedef struct
+{
+    gchar *property;
+    GValue *old_value;
+    GValue *new_value;
+} BlconfVolatileChange;
+
+static void blconf_backend_volatile_finalize(GObject *obj);
+
+static void blconf_backend_volatile_backend_init(BlconfBackendInterface *iface);
+
+
+G_DEFINE_TYPE_WITH_CODE(BlconfBackendVolatile, blconf_backend_volatile, G_TYPE_OBJECT,
+                        G_IMPLEMENT_INTERFACE(BLCONF_TYPE_BACKEND,
+                                              blconf_backend_volatile_backend_init))
+
+
+static void
+blconf_backend_volatile_class_init(BlconfBackendVolatileClass *klass)
+{
+    GObjectClass *object_class = (GObjectClass *)klass;
+
+    object_class->finalize = blconf_backend_volatile_finalize;
+}
+
+static void
+blconf_backend_volatile_init(BlconfBackendVolatile *instance)
+{
+    instance->channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               (GDestroyNotify)g_free,
+                                               (GDestroyNotify)g_hash_table_destroy);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_init(&instance->lock);
+#else
+    instance->lock = g_mutex_new();
+#endif
+}
+
+static void
+blconf_backend_volatile_finalize(GObject *obj)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(obj);
+
+    g_hash_table_destroy(bvol->channels);
+    g_free(bvol->dump_dir);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_clear(&bvol->lock);
+#else
+    g_mutex_free(bvol->lock);
+#endif
+
+    G_OBJECT_CLASS(blconf_backend_volatile_parent_class)->finalize(obj);
+}
+
+
+static GHashTable *
+blconf_backend_volatile_new_properties(void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal,
+                                 (GDestroyNotify)g_free,
+                                 (GDestroyNotify)_blconf_gvalue_free);
+}
+
+/* called with the lock held; NULL if the channel has no properties */
+static GHashTable *
+blconf_backend_volatile_lookup_channel(BlconfBackendVolatile *bvol,
+                                       const gchar *channel)
+{
+    GHashTable *properties = g_hash_table_lookup(bvol->channels, channel);
+
+    return properties && g_hash_table_size(properties) ? properties : NULL;
+}
+
+static gboolean
+blconf_backend_volatile_is_below(const gchar *property,
+                                 const gchar *property_base,
+                                 gsize base_len)
+{
+    /* everything is below the root */
+    if(base_len <= 1)
+        return TRUE;
+
+    return !strncmp(property, property_base, base_len)
+           && (property[base_len] == '\0' || property[base_len] == '/');
+}
+
+static void
+blconf_backend_volatile_set_not_found(const gchar *channel,
+                                      const gchar *property,
+                                      gboolean have_channel,
+                                      GError **error)
+{
+    if(!error)
+        return;
+
+    if(have_channel) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_PROPERTY_NOT_FOUND,
+                    _("Property \"%s\" does not exist on channel \"%s\""),
+                    property, channel);
+    } else {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_CHANNEL_NOT_FOUND,
+                    _("Channel \"%s\" does not exist"), channel);
+    }
+}
+
+
+static gboolean
+blconf_backend_volatile_load_snapshot(const gchar *filename,
+                                      GHashTable **properties,
+                                      GError **error)
+{
+    const BlconfSnapshotHeader *header;
+    GMappedFile *mfile;
+    const gchar *contents;
+    gsize length;
+    GVariant *dict;
+
+    mfile = g_mapped_file_new(filename, FALSE, error);
+    if(!mfile)
+        return FALSE;
+
+    contents = g_mapped_file_get_contents(mfile);
+    length = g_mapped_file_get_length(mfile);
+    header = (const BlconfSnapshotHeader *)contents;
+
+    if(length < BLCONF_SNAPSHOT_DATA_OFFSET
+       || header->magic != BLCONF_SNAPSHOT_MAGIC
+       || header->format != BLCONF_SNAPSHOT_FORMAT
+       || header->data_size > length - BLCONF_SNAPSHOT_DATA_OFFSET)
+    {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_READ_FAILURE,
+                    _("\"%s\" is not a channel snapshot"), filename);
+        g_mapped_file_unref(mfile);
+        return FALSE;
+    }
+
+    /* not trusted: GVariant checks the data as it's read */
+    dict = g_variant_ref_sink(g_variant_new_from_data(G_VARIANT_TYPE("a{sv}"),
+                                                      contents + BLCONF_SNAPSHOT_DATA_OFFSET,
+                                                      header->data_size, FALSE,
+                                                      (GDestroyNotify)g_mapped_file_unref,
+                                                      mfile));
+    *properties = _blconf_gvariant_to_hash(dict);
+    g_variant_unref(dict);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_initialize(BlconfBackend *backend,
+                                   GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    const gchar *dump_dir = g_getenv("BLCONFD_VOLATILE_DIR");
+    const gchar *name;
+    GDir *dir;
+
+    if(!dump_dir || !*dump_dir)
+        return TRUE;
+
+    bvol->dump_dir = g_strdup(dump_dir);
+
+    /* nothing to seed from yet is fine, the first dump creates it */
+    dir = g_dir_open(bvol->dump_dir, 0, NULL);
+    if(!dir)
+        return TRUE;
+
+    while((name = g_dir_read_name(dir))) {
+        GHashTable *properties = NULL;
+        GError *error1 = NULL;
+        gchar *filename;
+
+        if(!g_str_has_suffix(name, SNAPSHOT_SUFFIX)
+           || strlen(name) == strlen(SNAPSHOT_SUFFIX))
+        {
+            continue;
+        }
+
+        filename = g_build_filename(bvol->dump_dir, name, NULL);
+        if(blconf_backend_volatile_load_snapshot(filename, &properties,
+                                                 &error1))
+        {
+            g_hash_table_insert(bvol->channels,
+                                g_strndup(name, strlen(name)
+                                          - strlen(SNAPSHOT_SUFFIX)),
+                                properties);
+        } else {
+            /* carry on with the others, a bad file shouldn't keep
+             * the kiosk from starting */
+            g_warning("Unable to seed from \"%s\": %s", filename,
+                      error1->message);
+            g_error_free(error1);
+        }
+        g_free(filename);
+    }
+
+    g_dir_close(dir);
+
+    return TRUE;
+}
+
+
+static BlconfVolatileChange *
+blconf_volatile_change_new(const gchar *property,
+                           GValue *old_value,
+                           const GValue *new_value)
+{
+    BlconfVolatileChange *change = g_slice_new0(BlconfVolatileChange);
+
+    change->property = g_strdup(property);
+    change->old_value = old_value;
+    if(new_value) {
+        change->new_value = g_new0(GValue, 1);
+        g_value_copy(new_value, g_value_init(change->new_value,
+                                             G_VALUE_TYPE(new_value)));
+    }
+
+    return change;
+}
+
+static void
+blconf_volatile_change_free(BlconfVolatileChange *change)
+{
+    g_free(change->property);
+    if(change->old_value)
+        _blconf_gvalue_free(change->old_value);
+    if(change->new_value)
+        _blconf_gvalue_free(change->new_value);
+    g_slice_free(BlconfVolatileChange, change);
+}
+
+/* reports |changes| (the last one first) with the lock dropped, so
+ * the handlers may read the backend again; frees the list */
+static void
+blconf_backend_volatile_notify(BlconfBackendVolatile *bvol,
+                               const gchar *channel,
+                               GSList *changes)
+{
+    GSList *l;
+
+    changes = g_slist_reverse(changes);
+    for(l = changes; l; l = l->next) {
+        BlconfVolatileChange *change = l->data;
+
+        if(bvol->prop_changed_full_func) {
+            bvol->prop_changed_full_func(BLCONF_BACKEND(bvol), channel,
+                                         change->property, change->old_value,
+                                         change->new_value,
+                                         bvol->prop_changed_full_data);
+        }
+        if(bvol->prop_changed_func) {
+            bvol->prop_changed_func(BLCONF_BACKEND(bvol), channel,
+                                    change->property,
+                                    bvol->prop_changed_data);
+        }
+    }
+
+    g_slist_foreach(changes, (GFunc)blconf_volatile_change_free, NULL);
+    g_slist_free(changes);
+}
+
+/* called with the lock held; prepends what changed to |*changes| */
+static void
+blconf_backend_volatile_set_internal(BlconfBackendVolatile *bvol,
+                                     const gchar *channel,
+                                     const gchar *property,
+                                     const GValue *value,
+                                     GSList **changes)
+{
+    GHashTable *properties = g_hash_table_lookup(bvol->channels, channel);
+    GValue *old_value = NULL, *new_value;
+    gpointer key;
+
+    if(!properties) {
+        properties = blconf_backend_volatile_new_properties();
+        g_hash_table_insert(bvol->channels, g_strdup(channel), properties);
+    }
+
+    if(g_hash_table_lookup_extended(properties, property, &key,
+                                    (gpointer *)&old_value))
+    {
+        if(_blconf_gvalue_is_equal(old_value, value))
+            return;
+        g_hash_table_steal(properties, property);
+        g_free(key);
+    }
+
+    new_value = g_new0(GValue, 1);
+    g_value_copy(value, g_value_init(new_value, G_VALUE_TYPE(value)));
+    g_hash_table_insert(properties, g_strdup(property), new_value);
+
+    *changes = g_slist_prepend(*changes,
+                               blconf_volatile_change_new(property, old_value,
+                                                          value));
+}
+
+static gboolean
+blconf_backend_volatile_set(BlconfBackend *backend,
+                            const gchar *channel,
+                            const gchar *property,
+                            const GValue *value,
+                            GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GSList *changes = NULL;
+
+    volatile_lock(bvol);
+    blconf_backend_volatile_set_internal(bvol, channel, property, value,
+                                         &changes);
+    volatile_unlock(bvol);
+
+    blconf_backend_volatile_notify(bvol, channel, changes);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_set_many(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 GHashTable *properties,
+                                 GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GSList *changes = NULL;
+    GHashTableIter iter;
+    gpointer property, value;
+
+    /* can't fail halfway, so all or nothing comes for free */
+    volatile_lock(bvol);
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        blconf_backend_volatile_set_internal(bvol, channel, property, value,
+                                             &changes);
+    }
+    volatile_unlock(bvol);
+
+    blconf_backend_volatile_notify(bvol, channel, changes);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_get(BlconfBackend *backend,
+                            const gchar *channel,
+                            const gchar *property,
+                            GValue *value,
+                            GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTable *properties;
+    GValue *cur_value = NULL;
+
+    volatile_lock(bvol);
+
+    properties = blconf_backend_volatile_lookup_channel(bvol, channel);
+    if(properties)
+        cur_value = g_hash_table_lookup(properties, property);
+    if(cur_value) {
+        g_value_copy(cur_value, g_value_init(value, G_VALUE_TYPE(cur_value)));
+    } else {
+        blconf_backend_volatile_set_not_found(channel, property,
+                                              properties != NULL, error);
+    }
+
+    volatile_unlock(bvol);
+
+    return cur_value != NULL;
+}
+
+static gint
+blconf_backend_volatile_compare_names(gconstpointer a,
+                                      gconstpointer b)
+{
+    return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+/* called with the lock held; the names under |property_base|, sorted */
+static GPtrArray *
+blconf_backend_volatile_collect(GHashTable *properties,
+                                const gchar *property_base)
+{
+    GPtrArray *names = g_ptr_array_new();
+    gsize base_len = strlen(property_base);
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &key, NULL)) {
+        if(blconf_backend_volatile_is_below(key, property_base, base_len))
+            g_ptr_array_add(names, key);
+    }
+    g_ptr_array_sort(names, blconf_backend_volatile_compare_names);
+
+    return names;
+}
+
+static void
+blconf_backend_volatile_copy_value(GHashTable *dest,
+                                   const gchar *property,
+                                   const GValue *value)
+{
+    GValue *copy = g_new0(GValue, 1);
+
+    g_value_copy(value, g_value_init(copy, G_VALUE_TYPE(value)));
+    g_hash_table_insert(dest, g_strdup(property), copy);
+}
+
+static gboolean
+blconf_backend_volatile_get_all(BlconfBackend *backend,
+                                const gchar *channel,
+                                const gchar *property_base,
+                                GHashTable *properties,
+                                GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTable *channel_props;
+    gsize base_len = strlen(property_base);
+    GHashTableIter iter;
+    gpointer key, value;
+    guint n = 0;
+
+    volatile_lock(bvol);
+
+    channel_props = blconf_backend_volatile_lookup_channel(bvol, channel);
+    if(channel_props) {
+        g_hash_table_iter_init(&iter, channel_props);
+        while(g_hash_table_iter_next(&iter, &key, &value)) {
+            if(blconf_backend_volatile_is_below(key, property_base, base_len)) {
+                blconf_backend_volatile_copy_value(properties, key, value);
+                ++n;
+            }
+        }
+    }
+
+    if(!n) {
+        blconf_backend_volatile_set_not_found(channel, property_base,
+                                              channel_props && base_len > 1,
+                                              error);
+    }
+
+    volatile_unlock(bvol);
+
+    return n > 0;
+}
+
+static gboolean
+blconf_backend_volatile_get_all_paged(BlconfBackend *backend,
+                                      const gchar *channel,
+                                      const gchar *property_base,
+                                      const gchar *cursor,
+                                      guint page_size,
+                                      GHashTable *properties,
+                                      gchar **next_cursor,
+                                      GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTable *channel_props;
+    GPtrArray *names = NULL;
+    guint i = 0, end;
+
+    volatile_lock(bvol);
+
+    channel_props = blconf_backend_volatile_lookup_channel(bvol, channel);
+    if(channel_props)
+        names = blconf_backend_volatile_collect(channel_props, property_base);
+
+    if(!names || !names->len) {
+        blconf_backend_volatile_set_not_found(channel, property_base,
+                                              channel_props
+                                              && strlen(property_base) > 1,
+                                              error);
+        volatile_unlock(bvol);
+        if(names)
+            g_ptr_array_free(names, TRUE);
+        return FALSE;
+    }
+
+    /* the cursor is the last property of the previous page; pick up
+     * after where it would be, even if it's gone since */
+    if(*cursor) {
+        while(i < names->len
+              && strcmp(g_ptr_array_index(names, i), cursor) <= 0)
+        {
+            ++i;
+        }
+    }
+
+    end = (page_size && names->len - i > page_size) ? i + page_size : names->len;
+    for(; i < end; ++i) {
+        const gchar *name = g_ptr_array_index(names, i);
+
+        blconf_backend_volatile_copy_value(properties, name,
+                                           g_hash_table_lookup(channel_props,
+                                                               name));
+    }
+
+    *next_cursor = g_strdup(end < names->len
+                            ? g_ptr_array_index(names, end - 1) : "");
+
+    volatile_unlock(bvol);
+
+    g_ptr_array_free(names, TRUE);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_get_many(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 const gchar * const *properties,
+                                 GHashTable *values,
+                                 GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTable *channel_props;
+    gint i;
+
+    volatile_lock(bvol);
+
+    channel_props = blconf_backend_volatile_lookup_channel(bvol, channel);
+    for(i = 0; channel_props && properties[i]; ++i) {
+        GValue *value = g_hash_table_lookup(channel_props, properties[i]);
+
+        if(value)
+            blconf_backend_volatile_copy_value(values, properties[i], value);
+    }
+
+    volatile_unlock(bvol);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_exists(BlconfBackend *backend,
+                               const gchar *channel,
+                               const gchar *property,
+                               gboolean *exists,
+                               GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTable *channel_props;
+
+    volatile_lock(bvol);
+    channel_props = blconf_backend_volatile_lookup_channel(bvol, channel);
+    *exists = (channel_props
+               && g_hash_table_lookup(channel_props, property) != NULL);
+    volatile_unlock(bvol);
+
+    return TRUE;
+}
+
+/* called with the lock held; prepends what changed to |*changes| */
+static gboolean
+blconf_backend_volatile_reset_internal(GHashTable *channel_props,
+                                       const gchar *property,
+                                       GSList **changes)
+{
+    gpointer key, old_value;
+
+    if(!channel_props
+       || !g_hash_table_lookup_extended(channel_props, property, &key,
+                                        &old_value))
+    {
+        return FALSE;
+    }
+
+    g_hash_table_steal(channel_props, property);
+    *changes = g_slist_prepend(*changes,
+                               blconf_volatile_change_new(key, old_value, NULL));
+    g_free(key);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_reset(BlconfBackend *backend,
+                              const gchar *channel,
+                              const gchar *property,
+                              gboolean recursive,
+                              GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTable *channel_props;
+    GSList *changes = NULL;
+    gchar **removed = NULL;
+    gboolean ret;
+
+    volatile_lock(bvol);
+
+    channel_props = blconf_backend_volatile_lookup_channel(bvol, channel);
+    if(recursive && channel_props) {
+        GPtrArray *names = blconf_backend_volatile_collect(channel_props,
+                                                           property);
+        guint i;
+
+        if(names->len) {
+            removed = g_new(gchar *, names->len + 1);
+            for(i = 0; i < names->len; ++i) {
+                removed[i] = g_strdup(g_ptr_array_index(names, i));
+                g_hash_table_remove(channel_props, removed[i]);
+            }
+            removed[i] = NULL;
+        }
+        g_ptr_array_free(names, TRUE);
+        ret = (removed != NULL);
+    } else {
+        ret = blconf_backend_volatile_reset_internal(channel_props, property,
+                                                     &changes);
+    }
+
+    if(!ret) {
+        blconf_backend_volatile_set_not_found(channel, property,
+                                              channel_props
+                                              && (!recursive
+                                                  || strlen(property) > 1),
+                                              error);
+    }
+
+    volatile_unlock(bvol);
+
+    /* a subtree goes out as one event, like in the XML backend */
+    if(removed) {
+        if(bvol->props_reset_func) {
+            bvol->props_reset_func(backend, channel, property, removed,
+                                   bvol->props_reset_data);
+        } else {
+            gint i;
+
+            for(i = 0; removed[i]; ++i) {
+                changes = g_slist_prepend(changes,
+                                          blconf_volatile_change_new(removed[i],
+                                                                     NULL, NULL));
+            }
+        }
+        g_strfreev(removed);
+    }
+
+    blconf_backend_volatile_notify(bvol, channel, changes);
+
+    return ret;
+}
+
+static gboolean
+blconf_backend_volatile_reset_many(BlconfBackend *backend,
+                                   const gchar *channel,
+                                   const gchar * const *properties,
+                                   GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTable *channel_props;
+    GSList *changes = NULL;
+    gint i;
+
+    volatile_lock(bvol);
+    channel_props = blconf_backend_volatile_lookup_channel(bvol, channel);
+    for(i = 0; channel_props && properties[i]; ++i) {
+        blconf_backend_volatile_reset_internal(channel_props, properties[i],
+                                               &changes);
+    }
+    volatile_unlock(bvol);
+
+    blconf_backend_volatile_notify(bvol, channel, changes);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_list_channels(BlconfBackend *backend,
+                                      GSList **channels,
+                                      GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    volatile_lock(bvol);
+    g_hash_table_iter_init(&iter, bvol->channels);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        if(g_hash_table_size(value))
+            *channels = g_slist_prepend(*channels, g_strdup(key));
+    }
+    volatile_unlock(bvol);
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_is_property_locked(BlconfBackend *backend,
+                                           const gchar *channel,
+                                           const gchar *property,
+                                           gboolean *locked,
+                                           GError **error)
+{
+    /* locks come from the system files of the backends below */
+    *locked = FALSE;
+
+    return TRUE;
+}
+
+static gboolean
+blconf_backend_volatile_flush(BlconfBackend *backend,
+                              GError **error)
+{
+    /* that's the point */
+    return TRUE;
+}
+
+static gchar *
+blconf_backend_volatile_serialize(GHashTable *properties,
+                                  gsize *length)
+{
+    BlconfSnapshotHeader header;
+    GVariantBuilder builder;
+    GPtrArray *names;
+    GVariant *dict;
+    gchar *contents;
+    guint i;
+
+    /* sorted, like the snapshots blconfd hands out */
+    names = blconf_backend_volatile_collect(properties, "/");
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    for(i = 0; i < names->len; ++i) {
+        const gchar *name = g_ptr_array_index(names, i);
+        GVariant *variant = _blconf_gvalue_to_gvariant(g_hash_table_lookup(properties,
+                                                                           name));
+
+        if(variant)
+            g_variant_builder_add(&builder, "{sv}", name, variant);
+    }
+    dict = g_variant_ref_sink(g_variant_builder_end(&builder));
+    g_ptr_array_free(names, TRUE);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = BLCONF_SNAPSHOT_MAGIC;
+    header.format = BLCONF_SNAPSHOT_FORMAT;
+    header.data_size = g_variant_get_size(dict);
+
+    *length = BLCONF_SNAPSHOT_DATA_OFFSET + header.data_size;
+    contents = g_malloc0(*length);
+    memcpy(contents, &header, sizeof(header));
+    g_variant_store(dict, contents + BLCONF_SNAPSHOT_DATA_OFFSET);
+    g_variant_unref(dict);
+
+    return contents;
+}
+
+static gboolean
+blconf_backend_volatile_dump(BlconfBackend *backend,
+                             GError **error)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean ret = TRUE;
+
+    if(!bvol->dump_dir) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_WRITE_FAILURE,
+                    _("Set BLCONFD_VOLATILE_DIR to dump the volatile backend"));
+        return FALSE;
+    }
+
+    if(g_mkdir_with_parents(bvol->dump_dir, 0700) < 0) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_WRITE_FAILURE,
+                    _("Unable to create directory \"%s\": %s"),
+                    bvol->dump_dir, g_strerror(errno));
+        return FALSE;
+    }
+
+    /* only ever called on the main thread, which makes all the
+     * changes, so the lock is only for the readers' sake */
+    volatile_lock(bvol);
+
+    g_hash_table_iter_init(&iter, bvol->channels);
+    while(ret && g_hash_table_iter_next(&iter, &key, &value)) {
+        gchar *basename = g_strconcat(key, SNAPSHOT_SUFFIX, NULL);
+        gchar *filename = g_build_filename(bvol->dump_dir, basename, NULL);
+
+        if(g_hash_table_size(value)) {
+            gchar *contents;
+            gsize length;
+
+            /* g_file_set_contents() replaces the file atomically */
+            contents = blconf_backend_volatile_serialize(value, &length);
+            ret = g_file_set_contents(filename, contents, length, error);
+            g_free(contents);
+        } else
+            g_unlink(filename);
+
+        g_free(basename);
+        g_free(filename);
+    }
+
+    volatile_unlock(bvol);
+
+    return ret;
+}
+
+static void
+blconf_backend_volatile_register_property_changed_func(BlconfBackend *backend,
+                                                       BlconfPropertyChangedFunc func,
+                                                       gpointer user_data)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+
+    bvol->prop_changed_func = func;
+    bvol->prop_changed_data = user_data;
+}
+
+static void
+blconf_backend_volatile_register_properties_reset_func(BlconfBackend *backend,
+                                                       BlconfPropertiesResetFunc func,
+                                                       gpointer user_data)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+
+    bvol->props_reset_func = func;
+    bvol->props_reset_data = user_data;
+}
+
+static void
+blconf_backend_volatile_register_property_changed_full_func(BlconfBackend *backend,
+                                                            BlconfPropertyChangedFullFunc func,
+                                                            gpointer user_data)
+{
+    BlconfBackendVolatile *bvol = BLCONF_BACKEND_VOLATILE(backend);
+
+    bvol->prop_changed_full_func = func;
+    bvol->prop_changed_full_data = user_data;
+}
+
+static void
+blconf_backend_volatile_backend_init(BlconfBackendInterface *iface)
+{
+    iface->initialize = blconf_backend_volatile_initialize;
+    iface->set = blconf_backend_volatile_set;
+    iface->get = blconf_backend_volatile_get;
+    iface->get_all = blconf_backend_volatile_get_all;
+    iface->get_all_paged = blconf_backend_volatile_get_all_paged;
+    iface->exists = blconf_backend_volatile_exists;
+    iface->reset = blconf_backend_volatile_reset;
+    iface->list_channels = blconf_backend_volatile_list_channels;
+    iface->is_property_locked = blconf_backend_volatile_is_property_locked;
+    iface->flush = blconf_backend_volatile_flush;
+    iface->register_property_changed_func = blconf_backend_volatile_register_property_changed_func;
+    iface->register_properties_reset_func = blconf_backend_volatile_register_properties_reset_func;
+    iface->set_many = blconf_backend_volatile_set_many;
+    iface->get_many = blconf_backend_volatile_get_many;
+    iface->reset_many = blconf_backend_volatile_reset_many;
+    iface->register_property_changed_full_func = blconf_backend_volatile_register_property_changed_full_func;
+    iface->dump = blconf_backend_volatile_dump;
+}
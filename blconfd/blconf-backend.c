@@ -21,9 +21,8 @@
 #include <config.h>
 #endif
 
-#include <dbus/dbus-glib.h>
-
 #include "blconf-backend.h"
+#include "common/blconf-gvaluefuncs.h"
 
 
 static void blconf_backend_base_init(gpointer g_class);
@@ -41,6 +40,13 @@ static gboolean blconf_channel_is_valid(const gchar *channel,
  *
  * See the #BlconfBackend function documentation for a description of what
  * each virtual function in #BlconfBackendInterface should do.
+ *
+ * The daemon answers reads from a pool of threads, so the functions that
+ * only read (get, get_all, exists, list_channels and so on) may be
+ * called from any thread, concurrently.  Everything that changes the
+ * store, including flush, is only called from the thread running the
+ * main loop.  Values handed back by reads must be copies the caller can
+ * keep.
  **/
 
 
@@ -255,6 +261,12 @@ blconf_backend_set(BlconfBackend *backend,
  *
  * Gets the value of @property on @channel and stores it in @value.
  *
+ * @value is filled with a copy that belongs to the caller, who
+ * unsets it when done.  Backends may be called from several threads
+ * at once, so they can't hand out anything that a later change to
+ * @channel would free.  Callers that only pass the value on over
+ * D-Bus should use blconf_backend_get_variant(), which doesn't copy.
+ *
  * Return value: The backend should return %TRUE if the operation
  *               was successful, or %FALSE otherwise.  On %FALSE,
  *               @error should be set to a description of the failure.
@@ -295,6 +307,9 @@ blconf_backend_get(BlconfBackend *backend,
  * A value of the empty string ("") or forward slash ("/") for
  * @property_base indicates the entire channel.
  *
+ * As with blconf_backend_get(), the values are copies that belong to
+ * the caller.
+ *
  * Return value: The backend should return %TRUE if the operation
  *               was successful, or %FALSE otherwise.  On %FALSE,
  *               @error should be set to a description of the failure.
@@ -323,6 +338,446 @@ blconf_backend_get_all(BlconfBackend *backend,
     return iface->get_all(backend, channel, property_base, properties, error);
 }
 
+/**
+ * blconf_backend_get_variant:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @property: A property name.
+ * @error: An error return.
+ *
+ * Gets the value of @property on @channel in the form it is sent over
+ * D-Bus.  Backends that keep their values in that form hand out a
+ * reference to what they store instead of copying it; for the others,
+ * the value from blconf_backend_get() is converted.
+ *
+ * Return value: A new, non-floating reference to an immutable
+ *               #GVariant, or %NULL on failure, with @error set.
+ **/
+GVariant *
+blconf_backend_get_variant(BlconfBackend *backend,
+                           const gchar *channel,
+                           const gchar *property,
+                           GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    GValue value = { 0, };
+    GVariant *variant;
+
+    blconf_backend_return_val_if_fail(iface && iface->get && channel && *channel
+                                      && property && *property
+                                      && (!error || !*error), NULL);
+    if(!blconf_channel_is_valid(channel, error))
+        return NULL;
+    if(!blconf_property_is_valid(property, error))
+        return NULL;
+
+    if(iface->get_variant)
+        return iface->get_variant(backend, channel, property, error);
+
+    if(!iface->get(backend, channel, property, &value, error))
+        return NULL;
+
+    variant = _blconf_gvalue_to_gvariant(&value);
+    if(variant)
+        g_variant_ref_sink(variant);
+    else if(error) {
+        g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                    _("Values of type \"%s\" can't be sent over D-Bus"),
+                    G_VALUE_TYPE_NAME(&value));
+    }
+    g_value_unset(&value);
+
+    return variant;
+}
+
+/**
+ * blconf_backend_get_all_variants:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @property_base: The base of properties to return.
+ * @variants: A #GHashTable.
+ * @error: An error return.
+ *
+ * Like blconf_backend_get_all(), but @variants holds #gchar* keys and
+ * #GVariant<!-- -->* values, references to the values in the form
+ * blconf_backend_get_variant() returns them.  Values that can't be
+ * sent over D-Bus are left out.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_get_all_variants(BlconfBackend *backend,
+                                const gchar *channel,
+                                const gchar *property_base,
+                                GHashTable *variants,
+                                GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    GHashTable *properties;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    blconf_backend_return_val_if_fail(iface && iface->get_all && channel
+                                      && *channel && property_base
+                                      && variants
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+    if(*property_base && !(property_base[0] == '/' && !property_base[1])
+       && !blconf_property_is_valid(property_base, error))
+    {
+        return FALSE;
+    }
+
+    if(iface->get_all_variants) {
+        return iface->get_all_variants(backend, channel, property_base,
+                                       variants, error);
+    }
+
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)_blconf_gvalue_free);
+    if(!iface->get_all(backend, channel, property_base, properties, error)) {
+        g_hash_table_destroy(properties);
+        return FALSE;
+    }
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        GVariant *variant = _blconf_gvalue_to_gvariant(value);
+
+        if(variant) {
+            g_hash_table_insert(variants, g_strdup(key),
+                                g_variant_ref_sink(variant));
+        }
+    }
+    g_hash_table_destroy(properties);
+
+    return TRUE;
+}
+
+/**
+ * blconf_backend_get_all_paged:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @property_base: The base of properties to return.
+ * @cursor: Where to resume, or the empty string to start at the top.
+ * @page_size: The maximum number of properties to return, or 0 for
+ *             no limit.
+ * @properties: A #GHashTable.
+ * @next_cursor: A string return.
+ * @error: An error return.
+ *
+ * Like blconf_backend_get_all(), but returns at most @page_size
+ * properties at a time.  On success, @next_cursor is set to a
+ * newly-allocated string to pass as @cursor to fetch the following
+ * page, or to the empty string if there are no more properties.
+ *
+ * Backends that do not implement paging return everything in the
+ * first page.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_get_all_paged(BlconfBackend *backend,
+                             const gchar *channel,
+                             const gchar *property_base,
+                             const gchar *cursor,
+                             guint page_size,
+                             GHashTable *properties,
+                             gchar **next_cursor,
+                             GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    blconf_backend_return_val_if_fail(iface && (iface->get_all_paged
+                                                || iface->get_all)
+                                      && channel && *channel && property_base
+                                      && cursor && properties && next_cursor
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+    if(*property_base && !(property_base[0] == '/' && !property_base[1])
+       && !blconf_property_is_valid(property_base, error))
+    {
+        return FALSE;
+    }
+    if(*cursor && !blconf_property_is_valid(cursor, error))
+        return FALSE;
+
+    if(!iface->get_all_paged) {
+        if(*cursor) {
+            /* we handed out everything in the first page */
+            *next_cursor = g_strdup("");
+            return TRUE;
+        }
+
+        if(!iface->get_all(backend, channel, property_base, properties, error))
+            return FALSE;
+        *next_cursor = g_strdup("");
+        return TRUE;
+    }
+
+    return iface->get_all_paged(backend, channel, property_base, cursor,
+                                page_size, properties, next_cursor, error);
+}
+
+static gboolean
+blconf_backend_properties_are_valid(const gchar * const *properties,
+                                    GError **error)
+{
+    gint i;
+
+    for(i = 0; properties[i]; ++i) {
+        if(!blconf_property_is_valid(properties[i], error))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * blconf_backend_set_many:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @properties: A #GHashTable of property names to #GValue<!-- -->s.
+ * @error: An error return.
+ *
+ * Sets all of @properties on @channel.  If any of them is locked,
+ * nothing is changed.  Backends that implement this apply the whole
+ * batch at once, and save the channel once for all of it.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_set_many(BlconfBackend *backend,
+                        const gchar *channel,
+                        GHashTable *properties,
+                        GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    GHashTableIter iter;
+    gpointer property, value;
+
+    blconf_backend_return_val_if_fail(iface && iface->set && channel
+                                      && *channel && properties
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        if(!blconf_property_is_valid(property, error))
+            return FALSE;
+        if(!iface->set_many && iface->is_property_locked) {
+            gboolean locked = FALSE;
+
+            /* best we can do: at least don't stop half-way through
+             * because of a lock */
+            if(!iface->is_property_locked(backend, channel, property,
+                                          &locked, error))
+            {
+                return FALSE;
+            }
+            if(locked) {
+                if(error) {
+                    g_set_error(error, BLCONF_ERROR,
+                                BLCONF_ERROR_PERMISSION_DENIED,
+                                _("Permission denied while modifying property \"%s\" on channel \"%s\""),
+                                (const gchar *)property, channel);
+                }
+                return FALSE;
+            }
+        }
+    }
+
+    if(iface->set_many)
+        return iface->set_many(backend, channel, properties, error);
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, &value)) {
+        if(!iface->set(backend, channel, property, value, error))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * blconf_backend_get_many:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @properties: A %NULL-terminated list of property names.
+ * @values: A #GHashTable.
+ * @error: An error return.
+ *
+ * Gets the values of @properties on @channel and stores them in
+ * @values, which is already initialized to hold #gchar* keys and
+ * #GValue<!-- -->* values.  Properties that don't exist are left out.
+ * As with blconf_backend_get(), the values are copies that belong to
+ * the caller.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_get_many(BlconfBackend *backend,
+                        const gchar *channel,
+                        const gchar * const *properties,
+                        GHashTable *values,
+                        GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    gint i;
+
+    blconf_backend_return_val_if_fail(iface && iface->get && channel
+                                      && *channel && properties && values
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+    if(!blconf_backend_properties_are_valid(properties, error))
+        return FALSE;
+
+    if(iface->get_many)
+        return iface->get_many(backend, channel, properties, values, error);
+
+    for(i = 0; properties[i]; ++i) {
+        GValue *value = g_new0(GValue, 1);
+
+        if(iface->get(backend, channel, properties[i], value, NULL))
+            g_hash_table_insert(values, g_strdup(properties[i]), value);
+        else
+            g_free(value);
+    }
+
+    return TRUE;
+}
+
+/**
+ * blconf_backend_reset_many:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @properties: A %NULL-terminated list of property names.
+ * @error: An error return.
+ *
+ * Resets each of @properties on @channel, non-recursively.  Properties
+ * that don't exist are skipped.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure.
+ **/
+gboolean
+blconf_backend_reset_many(BlconfBackend *backend,
+                          const gchar *channel,
+                          const gchar * const *properties,
+                          GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    GError *tmp_error = NULL;
+    gint i;
+
+    blconf_backend_return_val_if_fail(iface && iface->reset && channel
+                                      && *channel && properties
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+    if(!blconf_backend_properties_are_valid(properties, error))
+        return FALSE;
+
+    if(iface->reset_many)
+        return iface->reset_many(backend, channel, properties, error);
+
+    for(i = 0; properties[i]; ++i) {
+        if(!iface->reset(backend, channel, properties[i], FALSE, &tmp_error)) {
+            if(tmp_error->domain == BLCONF_ERROR
+               && tmp_error->code == BLCONF_ERROR_PROPERTY_NOT_FOUND)
+            {
+                g_clear_error(&tmp_error);
+                continue;
+            }
+
+            g_propagate_error(error, tmp_error);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * blconf_backend_patch_array:
+ * @backend: The #BlconfBackend.
+ * @channel: A channel name.
+ * @property: A property name.
+ * @splices: The edits to make, in order.
+ * @n_splices: The number of @splices.
+ * @error: An error return.
+ *
+ * Edits the array stored in @property on @channel in place: each of
+ * @splices removes some elements and puts others in their place, and
+ * is applied to the result of the ones before it.  Either all of them
+ * are applied or none is.  Backends that don't implement this get the
+ * whole array, edit it and set it again.
+ *
+ * Return value: The backend should return %TRUE if the operation
+ *               was successful, or %FALSE otherwise.  On %FALSE,
+ *               @error should be set to a description of the failure,
+ *               with %BLCONF_ERROR_CONFLICT if @property isn't an
+ *               array or a splice doesn't fit it.
+ **/
+gboolean
+blconf_backend_patch_array(BlconfBackend *backend,
+                           const gchar *channel,
+                           const gchar *property,
+                           const BlconfArraySplice *splices,
+                           guint n_splices,
+                           GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+    GValue value = { 0, };
+    gboolean ret;
+
+    blconf_backend_return_val_if_fail(iface && iface->get && iface->set
+                                      && channel && *channel && property
+                                      && (splices || !n_splices)
+                                      && (!error || !*error), FALSE);
+    if(!blconf_channel_is_valid(channel, error))
+        return FALSE;
+    if(!blconf_property_is_valid(property, error))
+        return FALSE;
+
+    if(iface->patch_array) {
+        return iface->patch_array(backend, channel, property, splices,
+                                  n_splices, error);
+    }
+
+    if(!iface->get(backend, channel, property, &value, error))
+        return FALSE;
+
+    if(!_blconf_gvalue_splice(&value, splices, n_splices)) {
+        if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_CONFLICT,
+                        _("Property \"%s\" on channel \"%s\" is not an array that the change fits"),
+                        property, channel);
+        }
+        g_value_unset(&value);
+        return FALSE;
+    }
+
+    ret = iface->set(backend, channel, property, &value, error);
+    g_value_unset(&value);
+
+    return ret;
+}
+
 /**
  * blconf_backend_exists:
  * @backend: The #BlconfBackend.
@@ -334,6 +789,10 @@ blconf_backend_get_all(BlconfBackend *backend,
  * Checks to see if @property exists on @channel, and stores %TRUE or
  * %FALSE in @exists.
  *
+ * A channel that doesn't exist is not an error: like a missing
+ * property, it's %FALSE in @exists, and the call succeeds.  Only a
+ * failure to look, such as a read error, returns %FALSE.
+ *
  * Return value: The backend should return %TRUE if the operation
  *               was successful, or %FALSE otherwise.  On %FALSE,
  *               @error should be set to a description of the failure.
@@ -504,6 +963,10 @@ blconf_backend_flush(BlconfBackend *backend,
  * Registers a function to be called when a property changes.  The
  * backend implementation should keep a pointer to @func and @user_data
  * and call @func when a property in the configuration store changes.
+ *
+ * @func is called on the main loop thread, and may be called while the
+ * backend holds internal locks on the channel; it must not call back
+ * into @backend for the same channel.
  **/
 void
 blconf_backend_register_property_changed_func(BlconfBackend *backend,
@@ -518,3 +981,193 @@ blconf_backend_register_property_changed_func(BlconfBackend *backend,
 
     iface->register_property_changed_func(backend, func, user_data);
 }
+
+/**
+ * blconf_backend_register_properties_reset_func:
+ * @backend: The #BlconfBackend.
+ * @func: A function of type #BlconfPropertiesResetFunc.
+ * @user_data: Arbitrary caller-supplied data.
+ *
+ * Registers a function to be called when a recursive reset changes
+ * several properties at once.  Backends that support this call @func
+ * once with the reset's base property and the list of properties it
+ * touched, instead of calling the #BlconfPropertyChangedFunc for each
+ * of them.  Backends that don't keep calling the latter.
+ **/
+void
+blconf_backend_register_properties_reset_func(BlconfBackend *backend,
+                                              BlconfPropertiesResetFunc func,
+                                              gpointer user_data)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    g_return_if_fail(iface);
+    if(!iface->register_properties_reset_func)
+        return;
+
+    iface->register_properties_reset_func(backend, func, user_data);
+}
+
+/**
+ * blconf_backend_register_property_changed_full_func:
+ * @backend: The #BlconfBackend.
+ * @func: A function of type #BlconfPropertyChangedFullFunc.
+ * @user_data: Arbitrary caller-supplied data.
+ *
+ * Like blconf_backend_register_property_changed_func(), but @func
+ * also gets the property's old and new values, either of which is
+ * %NULL if the property didn't exist before or doesn't any more.
+ * The values belong to the backend and are only valid during the
+ * call.
+ *
+ * Return value: %TRUE if the backend supports this kind of callback,
+ *               %FALSE if the caller should fall back to a
+ *               #BlconfPropertyChangedFunc.
+ **/
+gboolean
+blconf_backend_register_property_changed_full_func(BlconfBackend *backend,
+                                                   BlconfPropertyChangedFullFunc func,
+                                                   gpointer user_data)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    g_return_val_if_fail(iface, FALSE);
+    if(!iface->register_property_changed_full_func)
+        return FALSE;
+
+    iface->register_property_changed_full_func(backend, func, user_data);
+
+    return TRUE;
+}
+
+/**
+ * blconf_backend_preload:
+ * @backend: The #BlconfBackend.
+ * @channels: A %NULL-terminated list of channel names, or %NULL.
+ *
+ * Asks the backend to start loading @channels, along with any channels
+ * it thinks are likely to be used soon, so that the first clients don't
+ * have to wait for them.  This is only a hint and returns without
+ * waiting; loading happens in the background, and errors are not
+ * reported, since a channel that fails to load here will simply be
+ * loaded (or fail) again when it's first used.
+ *
+ * Backends that keep everything in memory anyway don't need to
+ * implement this.
+ **/
+void
+blconf_backend_preload(BlconfBackend *backend,
+                       const gchar * const *channels)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    g_return_if_fail(iface);
+    if(!iface->preload)
+        return;
+
+    iface->preload(backend, channels);
+}
+
+/**
+ * blconf_backend_get_stats:
+ * @backend: The #BlconfBackend.
+ *
+ * Asks the backend for statistics about itself, for blconfd's
+ * org.blade.Blconf.Stats interface.  Only called from the main thread.
+ *
+ * Backends that don't keep any statistics don't need to implement
+ * this.
+ *
+ * Return value: A floating #GVariant of type a{sv}, or %NULL.
+ **/
+GVariant *
+blconf_backend_get_stats(BlconfBackend *backend)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    g_return_val_if_fail(iface, NULL);
+    if(!iface->get_stats)
+        return NULL;
+
+    return iface->get_stats(backend);
+}
+
+/**
+ * blconf_backend_dump:
+ * @backend: The #BlconfBackend.
+ * @error: An error return.
+ *
+ * Asks a backend that never writes to disk by itself to save what it
+ * holds now, somewhere it can be seeded from the next time.  blconfd
+ * does this when it gets SIGUSR2.
+ *
+ * Backends that store their data anyway don't need to implement
+ * this; for them, blconf_backend_flush() is enough.
+ *
+ * Return value: %FALSE if the backend tried and failed, %TRUE
+ *               otherwise.
+ **/
+gboolean
+blconf_backend_dump(BlconfBackend *backend,
+                    GError **error)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    g_return_val_if_fail(iface, FALSE);
+    if(!iface->dump)
+        return TRUE;
+
+    return iface->dump(backend, error);
+}
+
+/**
+ * blconf_backend_save_state:
+ * @backend: The #BlconfBackend.
+ *
+ * Asks the backend for whatever it has in memory that would be worth
+ * keeping across a restart, such as channels already parsed, to be
+ * handed to the blconfd replacing this one (see blconfd --replace).
+ * Only called from the main thread, after blconf_backend_flush(),
+ * with no more changes coming.
+ *
+ * Backends that have nothing costly to rebuild don't need to
+ * implement this.
+ *
+ * Return value: A floating #GVariant, or %NULL.
+ **/
+GVariant *
+blconf_backend_save_state(BlconfBackend *backend)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    g_return_val_if_fail(iface, NULL);
+    if(!iface->save_state)
+        return NULL;
+
+    return iface->save_state(backend);
+}
+
+/**
+ * blconf_backend_restore_state:
+ * @backend: The #BlconfBackend.
+ * @state: What blconf_backend_save_state() returned in the previous
+ *         daemon.
+ *
+ * Gives the backend the state its predecessor saved, right after it
+ * was initialized and before any other call.  @state comes from
+ * another process, possibly another version, so the backend has to
+ * check whatever it uses and ignore what it doesn't understand; its
+ * files remain the authoritative copy.
+ **/
+void
+blconf_backend_restore_state(BlconfBackend *backend,
+                             GVariant *state)
+{
+    BlconfBackendInterface *iface = BLCONF_BACKEND_GET_INTERFACE(backend);
+
+    g_return_if_fail(iface && state);
+    if(!iface->restore_state)
+        return;
+
+    iface->restore_state(backend, state);
+}
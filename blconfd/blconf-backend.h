@@ -29,6 +29,7 @@
 #endif
 
 #include <blconf/blconf-errors.h>
+#include "common/blconf-gvaluefuncs.h"
 
 #define BLCONF_TYPE_BACKEND                (blconf_backend_get_type())
 #define BLCONF_BACKEND(obj)                (G_TYPE_CHECK_INSTANCE_CAST((obj), BLCONF_TYPE_BACKEND, BlconfBackend))
@@ -57,6 +58,19 @@ typedef void (*BlconfPropertyChangedFunc)(BlconfBackend *backend,
                                           const gchar *property,
                                           gpointer user_data);
 
+typedef void (*BlconfPropertyChangedFullFunc)(BlconfBackend *backend,
+                                              const gchar *channel,
+                                              const gchar *property,
+                                              const GValue *old_value,
+                                              const GValue *new_value,
+                                              gpointer user_data);
+
+typedef void (*BlconfPropertiesResetFunc)(BlconfBackend *backend,
+                                          const gchar *channel,
+                                          const gchar *property_base,
+                                          gchar **properties,
+                                          gpointer user_data);
+
 struct _BlconfBackendInterface
 {
     GTypeInterface parent;
@@ -111,11 +125,67 @@ struct _BlconfBackendInterface
                                            BlconfPropertyChangedFunc func,
                                            gpointer user_data);
     
-    /*< reserved for future expansion >*/
-    void (*_xb_reserved0)();
-    void (*_xb_reserved1)();
-    void (*_xb_reserved2)();
-    void (*_xb_reserved3)();
+    void (*register_properties_reset_func)(BlconfBackend *backend,
+                                           BlconfPropertiesResetFunc func,
+                                           gpointer user_data);
+
+    gboolean (*get_all_paged)(BlconfBackend *backend,
+                              const gchar *channel,
+                              const gchar *property_base,
+                              const gchar *cursor,
+                              guint page_size,
+                              GHashTable *properties,
+                              gchar **next_cursor,
+                              GError **error);
+
+    gboolean (*set_many)(BlconfBackend *backend,
+                         const gchar *channel,
+                         GHashTable *properties,
+                         GError **error);
+
+    gboolean (*get_many)(BlconfBackend *backend,
+                         const gchar *channel,
+                         const gchar * const *properties,
+                         GHashTable *values,
+                         GError **error);
+
+    gboolean (*reset_many)(BlconfBackend *backend,
+                           const gchar *channel,
+                           const gchar * const *properties,
+                           GError **error);
+
+    void (*register_property_changed_full_func)(BlconfBackend *backend,
+                                                BlconfPropertyChangedFullFunc func,
+                                                gpointer user_data);
+
+    void (*preload)(BlconfBackend *backend,
+                    const gchar * const *channels);
+
+    GVariant *(*get_stats)(BlconfBackend *backend);
+
+    gboolean (*dump)(BlconfBackend *backend,
+                     GError **error);
+
+    GVariant *(*save_state)(BlconfBackend *backend);
+    void (*restore_state)(BlconfBackend *backend,
+                          GVariant *state);
+
+    gboolean (*patch_array)(BlconfBackend *backend,
+                            const gchar *channel,
+                            const gchar *property,
+                            const BlconfArraySplice *splices,
+                            guint n_splices,
+                            GError **error);
+
+    GVariant *(*get_variant)(BlconfBackend *backend,
+                             const gchar *channel,
+                             const gchar *property,
+                             GError **error);
+    gboolean (*get_all_variants)(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 const gchar *property_base,
+                                 GHashTable *variants,
+                                 GError **error);
 };
 
 GType blconf_backend_get_type(void) G_GNUC_CONST;
@@ -141,6 +211,49 @@ gboolean blconf_backend_get_all(BlconfBackend *backend,
                                 GHashTable *properties,
                                 GError **error);
 
+GVariant *blconf_backend_get_variant(BlconfBackend *backend,
+                                     const gchar *channel,
+                                     const gchar *property,
+                                     GError **error);
+
+gboolean blconf_backend_get_all_variants(BlconfBackend *backend,
+                                         const gchar *channel,
+                                         const gchar *property_base,
+                                         GHashTable *variants,
+                                         GError **error);
+
+gboolean blconf_backend_get_all_paged(BlconfBackend *backend,
+                                      const gchar *channel,
+                                      const gchar *property_base,
+                                      const gchar *cursor,
+                                      guint page_size,
+                                      GHashTable *properties,
+                                      gchar **next_cursor,
+                                      GError **error);
+
+gboolean blconf_backend_set_many(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 GHashTable *properties,
+                                 GError **error);
+
+gboolean blconf_backend_get_many(BlconfBackend *backend,
+                                 const gchar *channel,
+                                 const gchar * const *properties,
+                                 GHashTable *values,
+                                 GError **error);
+
+gboolean blconf_backend_reset_many(BlconfBackend *backend,
+                                   const gchar *channel,
+                                   const gchar * const *properties,
+                                   GError **error);
+
+gboolean blconf_backend_patch_array(BlconfBackend *backend,
+                                    const gchar *channel,
+                                    const gchar *property,
+                                    const BlconfArraySplice *splices,
+                                    guint n_splices,
+                                    GError **error);
+
 gboolean blconf_backend_exists(BlconfBackend *backend,
                                const gchar *channel,
                                const gchar *property,
@@ -170,6 +283,26 @@ void blconf_backend_register_property_changed_func(BlconfBackend *backend,
                                                    BlconfPropertyChangedFunc func,
                                                    gpointer user_data);
 
+void blconf_backend_register_properties_reset_func(BlconfBackend *backend,
+                                                   BlconfPropertiesResetFunc func,
+                                                   gpointer user_data);
+
+gboolean blconf_backend_register_property_changed_full_func(BlconfBackend *backend,
+                                                            BlconfPropertyChangedFullFunc func,
+                                                            gpointer user_data);
+
+void blconf_backend_preload(BlconfBackend *backend,
+                            const gchar * const *channels);
+
+GVariant *blconf_backend_get_stats(BlconfBackend *backend);
+
+gboolean blconf_backend_dump(BlconfBackend *backend,
+                             GError **error);
+
+GVariant *blconf_backend_save_state(BlconfBackend *backend);
+void blconf_backend_restore_state(BlconfBackend *backend,
+                                  GVariant *state);
+
 G_END_DECLS
 
 #endif  /* __BLCONF_BACKEND_H__ */
@@ -0,0 +1,382 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Change generations, for GetChangesSince.  Every change the daemon
+ * hears about from a backend gets the next number from one counter,
+ * and each channel remembers the number of the last change to each of
+ * its properties.  A client that knows the generation its cache was
+ * filled at can then ask for just the properties changed after it.
+ *
+ * Only so much is remembered: a channel that piles up more than
+ * MAX_CHANGES changed properties forgets them all, and moves its
+ * horizon up to the current generation.  Anything asked for from
+ * before a horizon is "too old", and the client has to fetch the
+ * channel again.  The counter starts at the wall clock time in
+ * microseconds, so a generation handed out by an earlier daemon is
+ * always below the horizon of a fresh one, unless the state came over
+ * in a handoff, in which case the numbers just carry on.
+ *
+ * The generation handed to clients is the last one announced: the
+ * signals for changes are sent from an idle, and one that hasn't gone
+ * out yet would be lost along with the connection if the client took
+ * a later number.  Asking from an older generation than needed is
+ * harmless, the changes in between are just sent again.
+ *
+ * Recording happens on the main thread, lookups on the workers. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <glib.h>
+
+#include "blconf-changelog.h"
+
+#define MAX_CHANGES  (4096)  /* per channel */
+
+typedef struct
+{
+    guint64 horizon;
+    guint64 generation;
+    GHashTable *properties;  /* name -> generation, as a guint64 * */
+} ChannelChanges;
+
+struct _BlconfChangelog
+{
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex lock;
+#else
+    GMutex *lock;
+#endif
+    guint64 horizon;
+    guint64 generation;
+    guint64 announced;  /* every change up to this one has been signalled */
+    GHashTable *channels;  /* lowercased channel name -> ChannelChanges */
+};
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define changelog_lock(changelog)    g_mutex_lock(&(changelog)->lock)
+#define changelog_unlock(changelog)  g_mutex_unlock(&(changelog)->lock)
+#else
+#define changelog_lock(changelog)    g_mutex_lock((changelog)->lock)
+#define changelog_unlock(changelog)  g_mutex_unlock((changelog)->lock)
+#endif
+
+
+static void
+channel_changes_free(ChannelChanges *changes)
+{
+    g_hash_table_destroy(changes->properties);
+    g_slice_free(ChannelChanges, changes);
+}
+
+static ChannelChanges *
+channel_changes_new(guint64 horizon)
+{
+    ChannelChanges *changes = g_slice_new0(ChannelChanges);
+
+    changes->horizon = changes->generation = horizon;
+    changes->properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                (GDestroyNotify)g_free,
+                                                (GDestroyNotify)g_free);
+
+    return changes;
+}
+
+static void
+channel_changes_set(ChannelChanges *changes,
+                    const gchar *property,
+                    guint64 generation)
+{
+    guint64 *gen = g_hash_table_lookup(changes->properties, property);
+
+    if(!gen) {
+        gen = g_new(guint64, 1);
+        g_hash_table_insert(changes->properties, g_strdup(property), gen);
+    }
+    *gen = generation;
+
+    if(changes->generation < generation)
+        changes->generation = generation;
+}
+
+
+BlconfChangelog *
+blconf_changelog_new(void)
+{
+    BlconfChangelog *changelog = g_slice_new0(BlconfChangelog);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_init(&changelog->lock);
+#else
+    changelog->lock = g_mutex_new();
+#endif
+    changelog->horizon = changelog->generation = g_get_real_time();
+    changelog->announced = changelog->generation;
+    changelog->channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                (GDestroyNotify)g_free,
+                                                (GDestroyNotify)channel_changes_free);
+
+    return changelog;
+}
+
+void
+blconf_changelog_free(BlconfChangelog *changelog)
+{
+    if(!changelog)
+        return;
+
+    g_hash_table_destroy(changelog->channels);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_clear(&changelog->lock);
+#else
+    g_mutex_free(changelog->lock);
+#endif
+    g_slice_free(BlconfChangelog, changelog);
+}
+
+/* removals count as changes too */
+void
+blconf_changelog_record(BlconfChangelog *changelog,
+                        const gchar *channel,
+                        const gchar *property)
+{
+    ChannelChanges *changes;
+    gchar *key = g_ascii_strdown(channel, -1);
+
+    changelog_lock(changelog);
+
+    changes = g_hash_table_lookup(changelog->channels, key);
+    if(!changes) {
+        changes = channel_changes_new(changelog->horizon);
+        g_hash_table_insert(changelog->channels, key, changes);
+    } else {
+        g_free(key);
+
+        if(g_hash_table_size(changes->properties) >= MAX_CHANGES
+           && !g_hash_table_lookup(changes->properties, property))
+        {
+            g_hash_table_remove_all(changes->properties);
+            changes->horizon = changelog->generation;
+        }
+    }
+
+    channel_changes_set(changes, property, ++changelog->generation);
+
+    changelog_unlock(changelog);
+}
+
+/* called once the signals for every change recorded so far are out */
+void
+blconf_changelog_announce(BlconfChangelog *changelog)
+{
+    changelog_lock(changelog);
+    changelog->announced = changelog->generation;
+    changelog_unlock(changelog);
+}
+
+/* adds the names of the properties of |channel| changed after
+ * generation |since| to |properties|, which should free them with
+ * g_free(), and returns TRUE; or returns FALSE if |since| is from
+ * before what's remembered.  either way, |generation| is set to the
+ * generation to ask from next time.  a |since| of
+ * 0 is always too old, and so just asks for the generation. */
+gboolean
+blconf_changelog_get_changes(BlconfChangelog *changelog,
+                             const gchar *channel,
+                             guint64 since,
+                             guint64 *generation,
+                             GPtrArray *properties)
+{
+    ChannelChanges *changes;
+    GHashTableIter iter;
+    gpointer key, value;
+    gchar *name = g_ascii_strdown(channel, -1);
+    guint64 horizon;
+    gboolean ret = FALSE;
+
+    changelog_lock(changelog);
+
+    changes = g_hash_table_lookup(changelog->channels, name);
+    horizon = changes ? changes->horizon : changelog->horizon;
+
+    /* the whole counter, rather than the channel's own last change, so
+     * the number keeps working if the channel is later forgotten */
+    *generation = changelog->announced;
+
+    /* past the current generation, it's from some other daemon */
+    if(since >= horizon && since <= changelog->generation) {
+        if(changes) {
+            g_hash_table_iter_init(&iter, changes->properties);
+            while(g_hash_table_iter_next(&iter, &key, &value)) {
+                if(*(guint64 *)value > since)
+                    g_ptr_array_add(properties, g_strdup(key));
+            }
+        }
+        ret = TRUE;
+    }
+
+    changelog_unlock(changelog);
+
+    g_free(name);
+
+    return ret;
+}
+
+/* the generation |property| last changed at, as far as anyone can
+ * tell: one that isn't remembered changed before the horizon, so that
+ * stands in for it.  for PatchArray's precondition, where a number
+ * that comes out too high only makes for a needless conflict. */
+guint64
+blconf_changelog_get_last_change(BlconfChangelog *changelog,
+                                 const gchar *channel,
+                                 const gchar *property)
+{
+    ChannelChanges *changes;
+    guint64 *gen = NULL, ret;
+    gchar *name = g_ascii_strdown(channel, -1);
+
+    changelog_lock(changelog);
+
+    changes = g_hash_table_lookup(changelog->channels, name);
+    if(changes)
+        gen = g_hash_table_lookup(changes->properties, property);
+    ret = gen ? *gen : (changes ? changes->horizon : changelog->horizon);
+
+    changelog_unlock(changelog);
+
+    g_free(name);
+
+    return ret;
+}
+
+/* for a handoff: a{sv} with "horizon" and "generation" (t), and
+ * "channels" (a(stta{st}): name, horizon, generation, and when each
+ * property last changed) */
+GVariant *
+blconf_changelog_save(BlconfChangelog *changelog)
+{
+    GVariantBuilder builder, channels, properties;
+    GHashTableIter iter, piter;
+    gpointer key, value;
+
+    g_variant_builder_init(&channels, G_VARIANT_TYPE("a(stta{st})"));
+
+    changelog_lock(changelog);
+
+    g_hash_table_iter_init(&iter, changelog->channels);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        ChannelChanges *changes = value;
+        gpointer pkey, pvalue;
+
+        g_variant_builder_init(&properties, G_VARIANT_TYPE("a{st}"));
+        g_hash_table_iter_init(&piter, changes->properties);
+        while(g_hash_table_iter_next(&piter, &pkey, &pvalue)) {
+            g_variant_builder_add(&properties, "{st}", pkey,
+                                  *(guint64 *)pvalue);
+        }
+
+        g_variant_builder_add(&channels, "(stt@a{st})", key,
+                              changes->horizon, changes->generation,
+                              g_variant_builder_end(&properties));
+    }
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "horizon",
+                          g_variant_new_uint64(changelog->horizon));
+    g_variant_builder_add(&builder, "{sv}", "generation",
+                          g_variant_new_uint64(changelog->generation));
+
+    changelog_unlock(changelog);
+
+    g_variant_builder_add(&builder, "{sv}", "channels",
+                          g_variant_builder_end(&channels));
+
+    return g_variant_builder_end(&builder);
+}
+
+/* takes over what blconf_changelog_save() gave the old daemon.  the
+ * state comes from another process, so nothing in it is trusted to
+ * be consistent: a channel whose numbers don't add up is dropped, or
+ * made too old for anything from before the handoff.  its own
+ * generation is worked out again from its properties. */
+void
+blconf_changelog_restore(BlconfChangelog *changelog,
+                         GVariant *state)
+{
+    GVariant *channels;
+    GVariantIter iter;
+    const gchar *name;
+    guint64 horizon, generation, chan_horizon;
+    GVariant *properties;
+
+    if(!g_variant_lookup(state, "horizon", "t", &horizon)
+       || !g_variant_lookup(state, "generation", "t", &generation)
+       || horizon > generation)
+    {
+        return;
+    }
+
+    channels = g_variant_lookup_value(state, "channels",
+                                      G_VARIANT_TYPE("a(stta{st})"));
+    if(!channels)
+        return;
+
+    changelog_lock(changelog);
+
+    g_hash_table_remove_all(changelog->channels);
+    changelog->horizon = horizon;
+    /* the old daemon only hands off once everything is announced */
+    changelog->generation = changelog->announced = generation;
+
+    g_variant_iter_init(&iter, channels);
+    while(g_variant_iter_next(&iter, "(&stt@a{st})", &name, &chan_horizon,
+                              NULL, &properties))
+    {
+        ChannelChanges *changes;
+        GVariantIter piter;
+        const gchar *property;
+        guint64 gen;
+
+        if(chan_horizon < horizon || chan_horizon > generation) {
+            g_variant_unref(properties);
+            continue;
+        }
+
+        changes = channel_changes_new(chan_horizon);
+        g_variant_iter_init(&piter, properties);
+        while(g_variant_iter_next(&piter, "{&st}", &property, &gen)) {
+            if(gen <= chan_horizon || gen > generation
+               || g_hash_table_size(changes->properties) >= MAX_CHANGES)
+            {
+                /* a change we can't place: forget the lot */
+                g_hash_table_remove_all(changes->properties);
+                changes->horizon = changes->generation = generation;
+                break;
+            }
+            channel_changes_set(changes, property, gen);
+        }
+        g_variant_unref(properties);
+
+        g_hash_table_replace(changelog->channels, g_ascii_strdown(name, -1),
+                             changes);
+    }
+
+    changelog_unlock(changelog);
+
+    g_variant_unref(channels);
+}
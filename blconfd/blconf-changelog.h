@@ -0,0 +1,50 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_CHANGELOG_H__
+#define __BLCONF_CHANGELOG_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BlconfChangelog  BlconfChangelog;
+
+G_GNUC_INTERNAL BlconfChangelog *blconf_changelog_new(void);
+G_GNUC_INTERNAL void blconf_changelog_free(BlconfChangelog *changelog);
+
+G_GNUC_INTERNAL void blconf_changelog_record(BlconfChangelog *changelog,
+                                             const gchar *channel,
+                                             const gchar *property);
+G_GNUC_INTERNAL void blconf_changelog_announce(BlconfChangelog *changelog);
+
+G_GNUC_INTERNAL gboolean blconf_changelog_get_changes(BlconfChangelog *changelog,
+                                                      const gchar *channel,
+                                                      guint64 since,
+                                                      guint64 *generation,
+                                                      GPtrArray *properties);
+G_GNUC_INTERNAL guint64 blconf_changelog_get_last_change(BlconfChangelog *changelog,
+                                                         const gchar *channel,
+                                                         const gchar *property);
+
+G_GNUC_INTERNAL GVariant *blconf_changelog_save(BlconfChangelog *changelog);
+G_GNUC_INTERNAL void blconf_changelog_restore(BlconfChangelog *changelog,
+                                              GVariant *state);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_CHANGELOG_H__ */
@@ -23,55 +23,111 @@
 
 #include <string.h>
 
-#include <dbus/dbus-glib-lowlevel.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+#include <gio/gio.h>
+#include <gio/gunixfdlist.h>
 #include <libbladeutil/libbladeutil.h>
 
 #include "blconf-daemon.h"
 #include "blconf-backend-factory.h"
 #include "blconf-backend.h"
-#include "common/blconf-marshal.h"
+#include "blconf-changelog.h"
+#include "blconf-handoff.h"
+#include "blconf-overlay.h"
+#include "blconf-snapshots.h"
+#include "blconf-stats.h"
+#include "blconf-throttle.h"
+#include "blconf-dbus-introspection.h"
 #include "common/blconf-gvaluefuncs.h"
 #include "blconf/blconf-errors.h"
 #include "common/blconf-common-private.h"
-
-static void blconf_set_property(BlconfDaemon *blconfd,
-                                const gchar *channel,
-                                const gchar *property,
-                                const GValue *value,
-                                DBusGMethodInvocation *context);
-static void blconf_get_property(BlconfDaemon *blconfd,
-                                const gchar *channel,
-                                const gchar *property,
-                                DBusGMethodInvocation *context);
-static void blconf_get_all_properties(BlconfDaemon *blconfd,
-                                      const gchar *channel,
-                                      const gchar *property_base,
-                                      DBusGMethodInvocation *context);
-static void blconf_property_exists(BlconfDaemon *blconfd,
-                                   const gchar *channel,
-                                   const gchar *property,
-                                   DBusGMethodInvocation *context);
-static void blconf_reset_property(BlconfDaemon *blconfd,
-                                  const gchar *channel,
-                                  const gchar *property,
-                                  gboolean recursive,
-                                  DBusGMethodInvocation *context);
-static void blconf_list_channels(BlconfDaemon *blconfd,
-                                 DBusGMethodInvocation *context);
-static void blconf_is_property_locked(BlconfDaemon *blconfd,
-                                      const gchar *channel,
-                                      const gchar *property,
-                                      DBusGMethodInvocation *context);
-
-#include "blconf-dbus-server.h"
+#include "common/blconf-probes.h"
+
+#define BLCONF_DBUS_NAME       "org.blade.Blconf"
+#define BLCONF_DBUS_PATH       "/org/blade/Blconf"
+#define BLCONF_DBUS_INTERFACE  "org.blade.Blconf"
+#define BLCONF_DBUS_STATS_INTERFACE  "org.blade.Blconf.Stats"
+
+/* threads handling the read-only methods */
+#define N_WORKERS  4
+
+/* what a peer connection goes by, in place of a unique name */
+#define PEER_NAME_KEY  "blconf-peer-name"
+
+/* seconds an old daemon keeps forwarding calls after a handoff */
+#define HANDOFF_LINGER  (5)
+
+/* who a signal goes to: the bus, and the peers that didn't or did ask
+ * for PropertyPatched; of those, the ones that didn't or did ask for
+ * PropertiesChanged.  a peer has to be in both */
+#define EMIT_BUS            (1 << 0)
+#define EMIT_PEERS          (1 << 1)
+#define EMIT_PATCH_PEERS    (1 << 2)
+#define EMIT_SINGLE_PEERS   (1 << 3)
+#define EMIT_BATCH_PEERS    (1 << 4)
+#define EMIT_ALL            (EMIT_BUS | EMIT_PEERS | EMIT_PATCH_PEERS \
+                             | EMIT_SINGLE_PEERS | EMIT_BATCH_PEERS)
+/* the per-property signals that PropertiesChanged repeats, and it */
+#define EMIT_SINGLE         (EMIT_ALL & ~EMIT_BATCH_PEERS)
+#define EMIT_BATCH          (EMIT_ALL & ~EMIT_SINGLE_PEERS)
 
 struct _BlconfDaemon
 {
     GObject parent;
 
-    DBusGConnection *dbus_conn;
+    GDBusConnection *connection;
+    guint registration_id;
+    guint stats_registration_id;
+    GDBusNodeInfo *node_info;
+
+    /* private connections from clients, see GetPeerAddress: the
+     * GDBusConnection -> BlconfDaemonPeer */
+    GDBusServer *peer_server;
+    GHashTable *peers;
+    guint n_peers_seen;
 
     GList *backends;
+    /* merged view of all backends, NULL if there's only one */
+    BlconfOverlay *overlay;
+    /* sealed copies of channels, shared with the clients */
+    BlconfSnapshots *snapshots;
+
+    GThreadPool *workers;
+    /* per-client rate limits, see blconf-throttle.c */
+    BlconfThrottle *throttle;
+
+    /* channel name -> (property name -> new value) for changes that
+     * have yet to be announced; removed properties have an unset
+     * value */
+    GHashTable *pending_changes;
+    guint pending_changes_id;
+    /* channel name -> (property name -> BlconfDaemonPatch) for those
+     * of the pending changes that were only ever PatchArray calls */
+    GHashTable *pending_patches;
+    /* the PatchArray call being applied, if any */
+    const struct _BlconfDaemonPatching *patching;
+    /* PropertiesReset emissions waiting in an idle */
+    guint pending_resets;
+    /* when each property last changed, for GetChangesSince */
+    BlconfChangelog *changelog;
+
+    BlconfStats *stats;
+    /* one per blconf_daemon_methods[] entry: how long they ran */
+    BlconfHistogram *method_times;
+
+    /* see blconf_daemon_handoff() */
+    GDBusMethodInvocation *handoff_invocation;
+    gboolean handed_off;
+    guint handoff_id;
+    /* backend type name -> state, from the daemon we replaced */
+    GVariant *handoff_state;
 };
 
 typedef struct _BlconfDaemonClass
@@ -79,20 +135,53 @@ typedef struct _BlconfDaemonClass
     GObjectClass parent;
 } BlconfDaemonClass;
 
-enum
+typedef struct
 {
-    SIG_PROPERTY_CHANGED = 0,
-    SIG_PROPERTY_REMOVED,
-    N_SIGS,
-};
+    guint registration_id;
+    guint stats_registration_id;
+
+    /* channel -> GPtrArray of property bases, see Subscribe; NULL
+     * until the first one, so the peer gets every signal */
+    GHashTable *subscriptions;
+    /* see EnablePatches */
+    gboolean patches;
+    /* see EnableBatchedChanges */
+    gboolean batched;
+} BlconfDaemonPeer;
+
+typedef struct _BlconfDaemonPatching
+{
+    const gchar *channel;
+    const gchar *property;
+    const BlconfArraySplice *splices;
+    guint n_splices;
+} BlconfDaemonPatching;
+
+/* the splices made to a property since the last announcement, sent to
+ * the peers that asked in place of the whole new value */
+typedef struct
+{
+    guint64 base;  /* the generation they apply to */
+    guint64 generation;  /* and the one after the last of them */
+    GArray *splices;  /* of BlconfArraySplice */
+} BlconfDaemonPatch;
 
 static void blconf_daemon_finalize(GObject *obj);
-
-static DBusHandlerResult blconf_daemon_handle_dbus_disconnect(DBusConnection *conn,
-                                                              DBusMessage *message,
-                                                              void *user_data);
-
-static guint signals[N_SIGS] = { 0, };
+static void blconf_daemon_peer_free(BlconfDaemonPeer *peer);
+
+static void blconf_daemon_worker(gpointer data,
+                                 gpointer user_data);
+static void blconf_daemon_run_method(GDBusMethodInvocation *invocation,
+                                     gpointer call_data,
+                                     gpointer user_data);
+static void blconf_daemon_connection_closed(GDBusConnection *connection,
+                                            gboolean remote_peer_vanished,
+                                            GError *error,
+                                            gpointer user_data);
+static void blconf_daemon_peer_closed(GDBusConnection *connection,
+                                      gboolean remote_peer_vanished,
+                                      GError *error,
+                                      gpointer user_data);
 
 
 G_DEFINE_TYPE(BlconfDaemon, blconf_daemon, G_TYPE_OBJECT)
@@ -104,387 +193,2301 @@ blconf_daemon_class_init(BlconfDaemonClass *klass)
     GObjectClass *object_class = (GObjectClass *)klass;
 
     object_class->finalize = blconf_daemon_finalize;
-
-    signals[SIG_PROPERTY_CHANGED] = g_signal_new(I_("property-changed"),
-                                                 BLCONF_TYPE_DAEMON,
-                                                 G_SIGNAL_RUN_LAST,
-                                                 0,
-                                                 NULL, NULL,
-                                                 _blconf_marshal_VOID__STRING_STRING_BOXED,
-                                                 G_TYPE_NONE,
-                                                 3, G_TYPE_STRING,
-                                                 G_TYPE_STRING,
-                                                 G_TYPE_VALUE);
-
-    signals[SIG_PROPERTY_REMOVED] = g_signal_new(I_("property-removed"),
-                                                 BLCONF_TYPE_DAEMON,
-                                                 G_SIGNAL_RUN_LAST,
-                                                 0,
-                                                 NULL, NULL,
-                                                 _blconf_marshal_VOID__STRING_STRING,
-                                                 G_TYPE_NONE,
-                                                 2, G_TYPE_STRING,
-                                                 G_TYPE_STRING);
-
-    dbus_g_object_type_install_info(G_TYPE_FROM_CLASS(klass),
-                                    &dbus_glib_blconf_object_info);
-    dbus_g_error_domain_register(BLCONF_ERROR, "org.blade.Blconf.Error",
-                                 BLCONF_TYPE_ERROR);
 }
 
 static void
 blconf_daemon_init(BlconfDaemon *instance)
 {
+    instance->stats = blconf_stats_new();
+
+    instance->pending_changes = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                      (GDestroyNotify)g_free,
+                                                      (GDestroyNotify)g_hash_table_destroy);
+    instance->pending_patches = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                      (GDestroyNotify)g_free,
+                                                      (GDestroyNotify)g_hash_table_destroy);
+
+    instance->snapshots = blconf_snapshots_new();
+    instance->changelog = blconf_changelog_new();
 
+    instance->peers = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                            (GDestroyNotify)g_object_unref,
+                                            NULL);
+
+    /* backends take reads from any thread, see BlconfBackendInterface */
+    instance->workers = g_thread_pool_new(blconf_daemon_worker, instance,
+                                          N_WORKERS, FALSE, NULL);
+
+    instance->throttle = blconf_throttle_new(blconf_daemon_run_method,
+                                             instance);
 }
 
 static void
 blconf_daemon_finalize(GObject *obj)
 {
     BlconfDaemon *blconfd = BLCONF_DAEMON(obj);
+    GHashTableIter iter;
+    gpointer connection, peer;
     GList *l;
 
+    if(blconfd->handoff_id)
+        g_source_remove(blconfd->handoff_id);
+    if(blconfd->handoff_invocation) {
+        g_dbus_method_invocation_return_error(blconfd->handoff_invocation,
+                                              G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
+                                              _("The daemon is shutting down"));
+    }
+    if(blconfd->handoff_state)
+        g_variant_unref(blconfd->handoff_state);
+
+    if(blconfd->peer_server) {
+        g_dbus_server_stop(blconfd->peer_server);
+        g_object_unref(blconfd->peer_server);
+    }
+
+    g_hash_table_iter_init(&iter, blconfd->peers);
+    while(g_hash_table_iter_next(&iter, &connection, &peer)) {
+        g_signal_handlers_disconnect_by_func(connection,
+                                             G_CALLBACK(blconf_daemon_peer_closed),
+                                             blconfd);
+        g_dbus_connection_unregister_object(connection,
+                                            ((BlconfDaemonPeer *)peer)->registration_id);
+        g_dbus_connection_unregister_object(connection,
+                                            ((BlconfDaemonPeer *)peer)->stats_registration_id);
+        g_dbus_connection_close(connection, NULL, NULL, NULL);
+        blconf_daemon_peer_free(peer);
+    }
+    g_hash_table_destroy(blconfd->peers);
+
+    if(blconfd->node_info)
+        g_dbus_node_info_unref(blconfd->node_info);
+
+    if(blconfd->connection) {
+        if(blconfd->registration_id) {
+            g_dbus_connection_unregister_object(blconfd->connection,
+                                                blconfd->registration_id);
+        }
+        if(blconfd->stats_registration_id) {
+            g_dbus_connection_unregister_object(blconfd->connection,
+                                                blconfd->stats_registration_id);
+        }
+        g_signal_handlers_disconnect_by_func(blconfd->connection,
+                                             G_CALLBACK(blconf_daemon_connection_closed),
+                                             blconfd);
+    }
+
+    /* let queued calls finish before the backends go away */
+    blconf_throttle_free(blconfd->throttle);
+    g_thread_pool_free(blconfd->workers, FALSE, TRUE);
+
+    if(blconfd->pending_changes_id)
+        g_source_remove(blconfd->pending_changes_id);
+    g_hash_table_destroy(blconfd->pending_changes);
+    g_hash_table_destroy(blconfd->pending_patches);
+
+    blconf_overlay_free(blconfd->overlay);
+    blconf_snapshots_free(blconfd->snapshots);
+    blconf_changelog_free(blconfd->changelog);
+
     for(l = blconfd->backends; l; l = l->next) {
         blconf_backend_register_property_changed_func(l->data, NULL, NULL);
+        blconf_backend_register_property_changed_full_func(l->data, NULL, NULL);
+        blconf_backend_register_properties_reset_func(l->data, NULL, NULL);
         blconf_backend_flush(l->data, NULL);
         g_object_unref(l->data);
     }
     g_list_free(blconfd->backends);
 
-    if(blconfd->dbus_conn) {
-        dbus_connection_remove_filter(dbus_g_connection_get_connection(blconfd->dbus_conn),
-                                      blconf_daemon_handle_dbus_disconnect,
-                                      blconfd);
-        dbus_g_connection_unref(blconfd->dbus_conn);
-    }
+    if(blconfd->connection)
+        g_object_unref(blconfd->connection);
+
+    blconf_stats_free(blconfd->stats);
+    g_free(blconfd->method_times);
 
     G_OBJECT_CLASS(blconf_daemon_parent_class)->finalize(obj);
 }
 
-typedef struct
+/* whether |property| is |property_base| or below it */
+static gboolean
+blconf_daemon_property_is_under(const gchar *property,
+                                const gchar *property_base)
 {
-    BlconfDaemon *blconfd;
-    BlconfBackend *backend;
-    gchar *channel;
-    gchar *property;
-} BlconfPropChangedData;
+    gsize len = strlen(property_base);
+
+    if(!strcmp(property_base, "/"))
+        return TRUE;
 
+    return !strncmp(property, property_base, len)
+           && (property[len] == '/' || !property[len]);
+}
+
+/* the filtering for a peer's Subscribe calls: the per-property
+ * signals need a matching property base, PropertiesReset just the
+ * channel, and the whole batch in PropertiesChanged the whole
+ * channel */
 static gboolean
-blconf_daemon_emit_property_changed_idled(gpointer data)
+blconf_daemon_peer_wants(BlconfDaemonPeer *peer,
+                         const gchar *signal_name,
+                         GVariant *parameters)
 {
-    BlconfPropChangedData *pdata = data;
-    GValue value = { 0, };
+    GPtrArray *bases;
+    const gchar *channel, *property;
+    guint i;
 
-    blconf_backend_get(pdata->backend, pdata->channel, pdata->property,
-                       &value, NULL);
+    if(!peer->subscriptions)
+        return TRUE;
 
-    if(G_VALUE_TYPE(&value)) {
-        g_signal_emit(G_OBJECT(pdata->blconfd), signals[SIG_PROPERTY_CHANGED],
-                      0, pdata->channel, pdata->property, &value);
-        g_value_unset(&value);
-    } else {
-        g_signal_emit(G_OBJECT(pdata->blconfd), signals[SIG_PROPERTY_REMOVED],
-                      0, pdata->channel, pdata->property);
-    }
+    g_variant_get_child(parameters, 0, "&s", &channel);
+    bases = g_hash_table_lookup(peer->subscriptions, channel);
+    if(!bases)
+        return FALSE;
 
-    g_object_unref(G_OBJECT(pdata->backend));
-    g_free(pdata->channel);
-    g_free(pdata->property);
-    g_object_unref(G_OBJECT(pdata->blconfd));
-    g_slice_free(BlconfPropChangedData, pdata);
+    if(!strcmp(signal_name, "PropertiesReset"))
+        return TRUE;
+
+    if(!strcmp(signal_name, "PropertiesChanged"))
+        property = "/";
+    else
+        g_variant_get_child(parameters, 1, "&s", &property);
+
+    for(i = 0; i < bases->len; ++i) {
+        if(blconf_daemon_property_is_under(property,
+                                           g_ptr_array_index(bases, i)))
+        {
+            return TRUE;
+        }
+    }
 
     return FALSE;
 }
 
+/* |targets| is some of the EMIT_* flags */
 static void
-blconf_daemon_backend_property_changed(BlconfBackend *backend,
-                                       const gchar *channel,
-                                       const gchar *property,
-                                       gpointer user_data)
+blconf_daemon_emit_signal_to(BlconfDaemon *blconfd,
+                             guint targets,
+                             const gchar *signal_name,
+                             GVariant *parameters)
 {
-    BlconfPropChangedData *pdata = g_slice_new0(BlconfPropChangedData);
+    GError *error = NULL;
+    GHashTableIter iter;
+    gpointer connection, peer;
 
-    pdata->blconfd = g_object_ref(G_OBJECT(user_data));
-    pdata->backend = g_object_ref(G_OBJECT(backend));
-    pdata->channel = g_strdup(channel);
-    pdata->property = g_strdup(property);
+    g_variant_ref_sink(parameters);
+
+    if(!(targets & EMIT_BUS))
+        blconf_stats_record_signal(blconfd->stats, signal_name, parameters);
+    else if(!g_dbus_connection_emit_signal(blconfd->connection, NULL,
+                                           BLCONF_DBUS_PATH, BLCONF_DBUS_INTERFACE,
+                                           signal_name, parameters, &error))
+    {
+        g_warning("Failed to emit signal %s: %s", signal_name,
+                  error->message);
+        g_error_free(error);
+    } else
+        blconf_stats_record_signal(blconfd->stats, signal_name, parameters);
+
+    /* there's no bus to pick out who wants what on the private
+     * connections, so we do: peers that never subscribed get
+     * everything and sort it out themselves */
+    g_hash_table_iter_init(&iter, blconfd->peers);
+    while(g_hash_table_iter_next(&iter, &connection, &peer)) {
+        BlconfDaemonPeer *p = peer;
+
+        if(!(targets & (p->patches ? EMIT_PATCH_PEERS : EMIT_PEERS))
+           || !(targets & (p->batched ? EMIT_BATCH_PEERS : EMIT_SINGLE_PEERS))
+           || !blconf_daemon_peer_wants(peer, signal_name, parameters))
+        {
+            continue;
+        }
+        g_dbus_connection_emit_signal(connection, NULL, BLCONF_DBUS_PATH,
+                                      BLCONF_DBUS_INTERFACE, signal_name,
+                                      parameters, NULL);
+    }
 
-    g_idle_add(blconf_daemon_emit_property_changed_idled, pdata);
+    g_variant_unref(parameters);
 }
 
 static void
-blconf_set_property(BlconfDaemon *blconfd,
-                    const gchar *channel,
-                    const gchar *property,
-                    const GValue *value,
-                    DBusGMethodInvocation *context)
+blconf_daemon_emit_signal(BlconfDaemon *blconfd,
+                          const gchar *signal_name,
+                          GVariant *parameters)
 {
-    GList *l;
-    GError *error = NULL;
+    blconf_daemon_emit_signal_to(blconfd, EMIT_ALL, signal_name, parameters);
+}
 
-    /* if there's more than one backend, we need to make sure the
-     * property isn't locked on ANY of them */
-    if(G_UNLIKELY(blconfd->backends->next)) {
-        for(l = blconfd->backends; l; l = l->next) {
-            gboolean locked = FALSE;
+static void
+blconf_daemon_emit_property_changed(BlconfDaemon *blconfd,
+                                    guint targets,
+                                    const gchar *channel,
+                                    const gchar *property,
+                                    const GValue *value)
+{
+    GVariant *variant = _blconf_gvalue_to_gvariant(value);
 
-            if(!blconf_backend_is_property_locked(l->data, channel, property,
-                                                  &locked, &error))
-                break;
+    if(variant) {
+        blconf_daemon_emit_signal_to(blconfd, targets, "PropertyChanged",
+                                     g_variant_new("(ssv)", channel, property,
+                                                   variant));
+    }
+}
 
-            if(locked) {
-                g_set_error(&error, BLCONF_ERROR,
-                            BLCONF_ERROR_PERMISSION_DENIED,
-                            _("Permission denied while modifying property \"%s\" on channel \"%s\""),
-                            property, channel);
-                break;
+/* to the peers that asked for it, with the whole value going
+ * everywhere else; FALSE if the splices can't be sent */
+static gboolean
+blconf_daemon_emit_property_patched(BlconfDaemon *blconfd,
+                                    const gchar *channel,
+                                    const gchar *property,
+                                    const BlconfDaemonPatch *patch)
+{
+    GVariant *splices;
+
+    splices = _blconf_splices_to_gvariant((const BlconfArraySplice *)patch->splices->data,
+                                          patch->splices->len);
+    if(!splices)
+        return FALSE;
+
+    blconf_daemon_emit_signal_to(blconfd,
+                                 EMIT_PATCH_PEERS | EMIT_SINGLE_PEERS | EMIT_BATCH_PEERS,
+                                 "PropertyPatched",
+                                 g_variant_new("(sstt@a(uuav))", channel,
+                                               property, patch->base,
+                                               patch->generation, splices));
+
+    return TRUE;
+}
+
+static void
+blconf_daemon_patch_free(BlconfDaemonPatch *patch)
+{
+    g_array_free(patch->splices, TRUE);
+    g_slice_free(BlconfDaemonPatch, patch);
+}
+
+/* Changes are announced once per main loop iteration, however many
+ * times a property was set in between, and with the latest value.
+ * Each channel's changes go out together as PropertiesChanged, to
+ * the peers that asked for it; the others, like older clients, get
+ * PropertyChanged and PropertyRemoved instead.  The bus gets both and
+ * passes each on to those with a match rule for it.  Arrays only
+ * changed by PatchArray go to the peers that asked for it as
+ * PropertyPatched instead, and are left out of their
+ * PropertiesChanged. */
+static gboolean
+blconf_daemon_emit_pending_changes(gpointer data)
+{
+    BlconfDaemon *blconfd = data;
+    GHashTable *pending = blconfd->pending_changes;
+    GHashTable *pending_patches = blconfd->pending_patches;
+    GHashTableIter iter, piter;
+    gpointer channel, props, property, value;
+
+    /* anything changed by a signal handler makes the next batch */
+    blconfd->pending_changes = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                     (GDestroyNotify)g_free,
+                                                     (GDestroyNotify)g_hash_table_destroy);
+    blconfd->pending_patches = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                     (GDestroyNotify)g_free,
+                                                     (GDestroyNotify)g_hash_table_destroy);
+    blconfd->pending_changes_id = 0;
+
+    g_hash_table_iter_init(&iter, pending);
+    while(g_hash_table_iter_next(&iter, &channel, &props)) {
+        GHashTable *changed = g_hash_table_new(g_str_hash, g_str_equal);
+        GHashTable *patches = g_hash_table_lookup(pending_patches, channel);
+        GHashTable *unpatched = NULL;
+        GPtrArray *removed = g_ptr_array_new();
+
+        if(patches)
+            unpatched = g_hash_table_new(g_str_hash, g_str_equal);
+
+        g_hash_table_iter_init(&piter, props);
+        while(g_hash_table_iter_next(&piter, &property, &value)) {
+            if(G_VALUE_TYPE(value)) {
+                BlconfDaemonPatch *patch = NULL;
+
+                if(patches)
+                    patch = g_hash_table_lookup(patches, property);
+
+                if(patch
+                   && blconf_daemon_emit_property_patched(blconfd, channel,
+                                                          property, patch))
+                {
+                    blconf_daemon_emit_property_changed(blconfd,
+                                                        EMIT_SINGLE & ~EMIT_PATCH_PEERS,
+                                                        channel, property,
+                                                        value);
+                } else {
+                    blconf_daemon_emit_property_changed(blconfd, EMIT_SINGLE,
+                                                        channel, property,
+                                                        value);
+                    if(unpatched)
+                        g_hash_table_insert(unpatched, property, value);
+                }
+                g_hash_table_insert(changed, property, value);
+            } else {
+                blconf_daemon_emit_signal_to(blconfd, EMIT_SINGLE,
+                                             "PropertyRemoved",
+                                             g_variant_new("(ss)", channel,
+                                                           property));
+                g_ptr_array_add(removed, property);
             }
         }
-
-        /* there is always an error set if something failed or the
-         * property is locked */
-        if(error) {
-            dbus_g_method_return_error(context, error);
-            g_error_free(error);
-            return;
+        g_ptr_array_add(removed, NULL);
+
+        blconf_daemon_emit_signal_to(blconfd,
+                                     unpatched ? EMIT_BATCH & ~EMIT_PATCH_PEERS
+                                               : EMIT_BATCH,
+                                     "PropertiesChanged",
+                                     g_variant_new("(s@a{sv}^as)", channel,
+                                                   _blconf_hash_to_gvariant(changed),
+                                                   removed->pdata));
+        if(unpatched) {
+            blconf_daemon_emit_signal_to(blconfd,
+                                         EMIT_PATCH_PEERS | EMIT_BATCH_PEERS,
+                                         "PropertiesChanged",
+                                         g_variant_new("(s@a{sv}^as)", channel,
+                                                       _blconf_hash_to_gvariant(unpatched),
+                                                       removed->pdata));
+            g_hash_table_destroy(unpatched);
         }
+
+        g_ptr_array_free(removed, TRUE);
+        g_hash_table_destroy(changed);
     }
 
-    /* only write to first backend */
-    if(blconf_backend_set(blconfd->backends->data, channel, property,
-                          value, &error))
+    g_hash_table_destroy(pending);
+    g_hash_table_destroy(pending_patches);
+
+    if(!blconfd->pending_changes_id && !blconfd->pending_resets)
+        blconf_changelog_announce(blconfd->changelog);
+
+    return FALSE;
+}
+
+static void
+blconf_daemon_backend_property_changed_full(BlconfBackend *backend,
+                                            const gchar *channel,
+                                            const gchar *property,
+                                            const GValue *old_value,
+                                            const GValue *new_value,
+                                            gpointer user_data)
+{
+    BlconfDaemon *blconfd = user_data;
+    const BlconfDaemonPatching *patching = blconfd->patching;
+    GHashTable *props, *patches;
+    BlconfDaemonPatch *patch = NULL;
+    GValue *value = g_new0(GValue, 1);
+    gboolean had_change;
+    guint64 base = 0;
+    guint i;
+
+    /* is this the property PatchArray is working on? */
+    if(patching && (!new_value
+                    || g_ascii_strcasecmp(patching->channel, channel)
+                    || strcmp(patching->property, property)))
     {
-        dbus_g_method_return(context);
-    } else {
-        dbus_g_method_return_error(context, error);
-        g_error_free(error);
+        patching = NULL;
+    }
+
+    if(blconfd->overlay)
+        blconf_overlay_invalidate(blconfd->overlay, channel);
+    blconf_snapshots_invalidate(blconfd->snapshots, channel);
+    if(patching) {
+        base = blconf_changelog_get_last_change(blconfd->changelog, channel,
+                                                property);
+    }
+    blconf_changelog_record(blconfd->changelog, channel, property);
+
+    props = g_hash_table_lookup(blconfd->pending_changes, channel);
+    if(!props) {
+        props = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                      (GDestroyNotify)g_free,
+                                      (GDestroyNotify)_blconf_gvalue_free);
+        g_hash_table_insert(blconfd->pending_changes, g_strdup(channel), props);
+    }
+    had_change = g_hash_table_lookup(props, property) != NULL;
+
+    if(new_value)
+        g_value_copy(new_value, g_value_init(value, G_VALUE_TYPE(new_value)));
+    g_hash_table_replace(props, g_strdup(property), value);
+
+    /* the splices can go out in place of the value for as long as
+     * nothing else has changed the property in this batch */
+    patches = g_hash_table_lookup(blconfd->pending_patches, channel);
+    if(patches)
+        patch = g_hash_table_lookup(patches, property);
+    if(patching && (patch || !had_change)) {
+        if(!patches) {
+            patches = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            (GDestroyNotify)g_free,
+                                            (GDestroyNotify)blconf_daemon_patch_free);
+            g_hash_table_insert(blconfd->pending_patches, g_strdup(channel),
+                                patches);
+        }
+        if(!patch) {
+            patch = g_slice_new0(BlconfDaemonPatch);
+            patch->base = base;
+            patch->splices = g_array_new(FALSE, FALSE, sizeof(BlconfArraySplice));
+            g_array_set_clear_func(patch->splices,
+                                   (GDestroyNotify)_blconf_array_splice_clear);
+            g_hash_table_insert(patches, g_strdup(property), patch);
+        }
+
+        for(i = 0; i < patching->n_splices; ++i) {
+            BlconfArraySplice splice = patching->splices[i];
+
+            if(splice.values) {
+                splice.values = g_boxed_copy(BLCONF_TYPE_G_VALUE_ARRAY,
+                                             splice.values);
+            }
+            g_array_append_val(patch->splices, splice);
+        }
+        patch->generation = blconf_changelog_get_last_change(blconfd->changelog,
+                                                             channel, property);
+    } else if(patch)
+        g_hash_table_remove(patches, property);
+
+    if(!blconfd->pending_changes_id) {
+        blconfd->pending_changes_id = g_idle_add(blconf_daemon_emit_pending_changes,
+                                                 blconfd);
     }
 }
 
+/* for backends that can't tell us the new value themselves */
 static void
-blconf_get_property(BlconfDaemon *blconfd,
-                    const gchar *channel,
-                    const gchar *property,
-                    DBusGMethodInvocation *context)
+blconf_daemon_backend_property_changed(BlconfBackend *backend,
+                                       const gchar *channel,
+                                       const gchar *property,
+                                       gpointer user_data)
 {
-    GList *l;
     GValue value = { 0, };
-    GError *error = NULL;
 
-    /* check each backend until we find a value */
-    for(l = blconfd->backends; l; l = l->next) {
-        if(blconf_backend_get(l->data, channel, property, &value, &error)) {
-            dbus_g_method_return (context, &value);
-            g_value_unset(&value);
-            return;
-        } else if(l->next)
-            g_clear_error(&error);
+    blconf_backend_get(backend, channel, property, &value, NULL);
+    blconf_daemon_backend_property_changed_full(backend, channel, property,
+                                                NULL,
+                                                G_VALUE_TYPE(&value)
+                                                ? &value : NULL,
+                                                user_data);
+    if(G_VALUE_TYPE(&value))
+        g_value_unset(&value);
+}
+
+typedef struct
+{
+    BlconfDaemon *blconfd;
+    BlconfBackend *backend;
+    gchar *channel;
+    gchar *property_base;
+    gchar **properties;
+} BlconfPropsResetData;
+
+/* A recursive reset goes out as one PropertiesReset signal listing
+ * the properties that are gone; the ones that fell back to a system
+ * default still get a PropertyChanged, as they have a value to carry.
+ * Emitting the batch first lets clients drop their cached entries
+ * before the new defaults arrive. */
+static gboolean
+blconf_daemon_emit_properties_reset_idled(gpointer data)
+{
+    BlconfPropsResetData *rdata = data;
+    GPtrArray *removed = g_ptr_array_sized_new(g_strv_length(rdata->properties) + 1);
+    GPtrArray *changed = g_ptr_array_new();
+    guint i;
+
+    for(i = 0; rdata->properties[i]; ++i) {
+        GValue *value = g_new0(GValue, 1);
+
+        blconf_backend_get(rdata->backend, rdata->channel,
+                           rdata->properties[i], value, NULL);
+        if(G_VALUE_TYPE(value)) {
+            g_ptr_array_add(changed, rdata->properties[i]);
+            g_ptr_array_add(changed, value);
+        } else {
+            g_ptr_array_add(removed, rdata->properties[i]);
+            g_free(value);
+        }
     }
+    g_ptr_array_add(removed, NULL);
 
-    dbus_g_method_return_error(context, error);
-    g_error_free(error);
+    if(removed->len > 1) {
+        blconf_daemon_emit_signal(rdata->blconfd, "PropertiesReset",
+                                  g_variant_new("(ss^as)", rdata->channel,
+                                                rdata->property_base,
+                                                removed->pdata));
+    }
+
+    for(i = 0; i < changed->len; i += 2) {
+        GValue *value = g_ptr_array_index(changed, i + 1);
+
+        blconf_daemon_emit_property_changed(rdata->blconfd, EMIT_ALL,
+                                            rdata->channel,
+                                            g_ptr_array_index(changed, i),
+                                            value);
+        _blconf_gvalue_free(value);
+    }
+
+    g_ptr_array_free(changed, TRUE);
+    g_ptr_array_free(removed, TRUE);
+
+    g_object_unref(G_OBJECT(rdata->backend));
+    g_free(rdata->channel);
+    g_free(rdata->property_base);
+    g_strfreev(rdata->properties);
+    if(!--rdata->blconfd->pending_resets && !rdata->blconfd->pending_changes_id)
+        blconf_changelog_announce(rdata->blconfd->changelog);
+    g_object_unref(G_OBJECT(rdata->blconfd));
+    g_slice_free(BlconfPropsResetData, rdata);
+
+    return FALSE;
 }
 
 static void
-blconf_get_all_properties(BlconfDaemon *blconfd,
-                          const gchar *channel,
-                          const gchar *property_base,
-                          DBusGMethodInvocation *context)
+blconf_daemon_backend_properties_reset(BlconfBackend *backend,
+                                       const gchar *channel,
+                                       const gchar *property_base,
+                                       gchar **properties,
+                                       gpointer user_data)
+{
+    BlconfPropsResetData *rdata = g_slice_new0(BlconfPropsResetData);
+    guint i;
+
+    if(BLCONF_DAEMON(user_data)->overlay)
+        blconf_overlay_invalidate(BLCONF_DAEMON(user_data)->overlay, channel);
+    blconf_snapshots_invalidate(BLCONF_DAEMON(user_data)->snapshots, channel);
+    for(i = 0; properties[i]; ++i) {
+        blconf_changelog_record(BLCONF_DAEMON(user_data)->changelog, channel,
+                                properties[i]);
+    }
+
+    rdata->blconfd = g_object_ref(G_OBJECT(user_data));
+    rdata->backend = g_object_ref(G_OBJECT(backend));
+    rdata->channel = g_strdup(channel);
+    rdata->property_base = g_strdup(property_base);
+    rdata->properties = g_strdupv(properties);
+
+    rdata->blconfd->pending_resets++;
+    g_idle_add(blconf_daemon_emit_properties_reset_idled, rdata);
+}
+
+/* if there's more than one backend, we need to make sure the
+ * property isn't locked on ANY of them; the first backend checks
+ * for itself when it's written to */
+static gboolean
+blconf_daemon_check_unlocked(BlconfDaemon *blconfd,
+                             const gchar *channel,
+                             const gchar *property,
+                             GError **error)
 {
     GList *l;
-    GHashTable *properties;
-    GError *error = NULL;
-    gboolean succeed = FALSE;
 
-    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                        (GDestroyNotify)g_free,
-                                        (GDestroyNotify)_blconf_gvalue_free);
+    if(G_LIKELY(!blconfd->backends->next))
+        return TRUE;
 
-    /* get all properties from all backends.  if they all fail, return FALSE */
     for(l = blconfd->backends; l; l = l->next) {
-        if(blconf_backend_get_all(l->data, channel, property_base,
-                                  properties, &error))
-            succeed = TRUE;
-        else if(l->next) {
-            g_clear_error(&error);
+        gboolean locked = FALSE;
+
+        if(!blconf_backend_is_property_locked(l->data, channel, property,
+                                              &locked, error))
+        {
+            return FALSE;
+        }
+
+        if(locked) {
+            g_set_error(error, BLCONF_ERROR,
+                        BLCONF_ERROR_PERMISSION_DENIED,
+                        _("Permission denied while modifying property \"%s\" on channel \"%s\""),
+                        property, channel);
+            return FALSE;
         }
     }
 
-    if(succeed)
-        dbus_g_method_return (context, properties);
+    return TRUE;
+}
+
+/* answers |invocation|, and the calls it replaced in the throttle,
+ * with an empty reply or |error| */
+static void
+blconf_daemon_return_all(GDBusMethodInvocation *invocation,
+                         GSList *superseded,
+                         const GError *error)
+{
+    GSList *l;
+
+    for(l = superseded; l; l = l->next) {
+        if(error)
+            g_dbus_method_invocation_return_gerror(l->data, error);
+        else
+            g_dbus_method_invocation_return_value(l->data, NULL);
+    }
+
+    if(error)
+        g_dbus_method_invocation_return_gerror(invocation, error);
     else
-        dbus_g_method_return_error(context, error);
+        g_dbus_method_invocation_return_value(invocation, NULL);
+}
+
+static gboolean
+blconf_daemon_set_property(BlconfDaemon *blconfd,
+                           GVariant *parameters,
+                           GError **error)
+{
+    const gchar *channel, *property;
+    GVariant *variant;
+    GValue value = { 0, };
+    gboolean ret;
+
+    g_variant_get(parameters, "(&s&sv)", &channel, &property, &variant);
+    if(!_blconf_gvariant_to_gvalue(variant, &value)) {
+        g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS,
+                    _("Values of type \"%s\" can't be stored"),
+                    g_variant_get_type_string(variant));
+        g_variant_unref(variant);
+        return FALSE;
+    }
+    g_variant_unref(variant);
+
+    /* only write to first backend */
+    ret = (blconf_daemon_check_unlocked(blconfd, channel, property, error)
+           && blconf_backend_set(blconfd->backends->data, channel, property,
+                                 &value, error));
+
+    g_value_unset(&value);
+
+    return ret;
+}
 
+static void
+blconf_set_property(BlconfDaemon *blconfd,
+                    GVariant *parameters,
+                    GDBusMethodInvocation *invocation)
+{
+    GError *error = NULL;
+
+    blconf_daemon_set_property(blconfd, parameters, &error);
+    blconf_daemon_return_all(invocation, NULL, error);
     if(error)
         g_error_free(error);
-    g_hash_table_destroy(properties);
 }
 
 static void
-blconf_property_exists(BlconfDaemon *blconfd,
-                       const gchar *channel,
-                       const gchar *property,
-                       DBusGMethodInvocation *context)
+blconf_set_properties(BlconfDaemon *blconfd,
+                      GVariant *parameters,
+                      GDBusMethodInvocation *invocation)
 {
-    gboolean exists = FALSE;
-    gboolean succeed = FALSE;
-    GList *l;
+    const gchar *channel;
+    GVariant *dict;
+    GHashTable *properties;
+    GHashTableIter iter;
+    gpointer property;
     GError *error = NULL;
 
-    /* if at least one backend returns TRUE (regardles if |*exists| gets set
-     * to TRUE or FALSE), we'll return TRUE from this function */
+    g_variant_get(parameters, "(&s@a{sv})", &channel, &dict);
+    properties = _blconf_gvariant_to_hash(dict);
+    g_variant_unref(dict);
 
-    for(l = blconfd->backends; !exists && l; l = l->next) {
-        if(blconf_backend_exists(l->data, channel, property, &exists, &error))
-            succeed = TRUE;
-        else if(l->next)
-            g_clear_error(&error);
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &property, NULL)) {
+        if(!blconf_daemon_check_unlocked(blconfd, channel, property, &error)) {
+            g_dbus_method_invocation_return_gerror(invocation, error);
+            g_error_free(error);
+            g_hash_table_destroy(properties);
+            return;
+        }
     }
 
-    if(succeed)
-        dbus_g_method_return(context, exists);
-    else {
-        dbus_g_method_return_error(context, error);
+    /* only write to first backend */
+    if(blconf_backend_set_many(blconfd->backends->data, channel, properties,
+                               &error))
+    {
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    } else {
+        g_dbus_method_invocation_return_gerror(invocation, error);
         g_error_free(error);
     }
+
+    g_hash_table_destroy(properties);
 }
 
 static void
-blconf_reset_property(BlconfDaemon *blconfd,
-                      const gchar *channel,
-                      const gchar *property,
-                      gboolean recursive,
-                      DBusGMethodInvocation *context)
+blconf_get_properties(BlconfDaemon *blconfd,
+                      GVariant *parameters,
+                      GDBusMethodInvocation *invocation)
 {
-    gboolean succeed = FALSE;
+    const gchar *channel, **properties;
     GList *l;
+    GHashTable *values;
+    GPtrArray *missing = NULL;
     GError *error = NULL;
+    gboolean succeed = FALSE;
+    guint i;
 
-    /* while technically all backends but the first should be opened read-only,
-     * we need to reset in all backends so the property doesn't reappear
-     * later */
+    g_variant_get(parameters, "(&s^a&s)", &channel, &properties);
+
+    values = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                   (GDestroyNotify)g_free,
+                                   (GDestroyNotify)_blconf_gvalue_free);
 
+    /* as with GetProperty, the first backend that has a value wins;
+     * later backends are only asked for what's still missing */
     for(l = blconfd->backends; l; l = l->next) {
-        if(blconf_backend_reset(l->data, channel, property, recursive, &error))
+        const gchar **names = properties;
+
+        if(missing) {
+            g_ptr_array_set_size(missing, 0);
+            for(i = 0; properties[i]; ++i) {
+                if(!g_hash_table_lookup(values, properties[i]))
+                    g_ptr_array_add(missing, (gpointer)properties[i]);
+            }
+            if(!missing->len)
+                break;
+            g_ptr_array_add(missing, NULL);
+            names = (const gchar **)missing->pdata;
+        } else if(l->next)
+            missing = g_ptr_array_new();
+
+        if(blconf_backend_get_many(l->data, channel,
+                                   (const gchar * const *)names, values,
+                                   &error))
+        {
             succeed = TRUE;
-        else if(l->next)
+        } else if(l->next)
             g_clear_error(&error);
     }
 
-    if(succeed)
-        dbus_g_method_return(context);
-    else
-        dbus_g_method_return_error(context, error);
+    if(succeed) {
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(@a{sv})",
+                                                            _blconf_hash_to_gvariant(values)));
+    } else
+        g_dbus_method_invocation_return_gerror(invocation, error);
 
     if(error)
         g_error_free(error);
+    if(missing)
+        g_ptr_array_free(missing, TRUE);
+    g_hash_table_destroy(values);
+    g_free(properties);
 }
 
 static void
-blconf_list_channels(BlconfDaemon *blconfd,
-                     DBusGMethodInvocation *context)
+blconf_reset_properties(BlconfDaemon *blconfd,
+                        GVariant *parameters,
+                        GDBusMethodInvocation *invocation)
 {
-    GSList *lchannels = NULL, *chans_tmp, *lc;
+    const gchar *channel, **properties;
+    gboolean succeed = FALSE;
     GList *l;
-    guint i;
-    gchar **channels;
     GError *error = NULL;
 
-    /* FIXME: with multiple backends, this can cause duplicates */
+    g_variant_get(parameters, "(&s^a&s)", &channel, &properties);
+
+    /* reset in all backends, as blconf_reset_property() does */
     for(l = blconfd->backends; l; l = l->next) {
-        chans_tmp = NULL;
-        if(blconf_backend_list_channels(l->data, &chans_tmp, &error))
-            lchannels = g_slist_concat(lchannels, chans_tmp);
+        if(blconf_backend_reset_many(l->data, channel,
+                                     (const gchar * const *)properties,
+                                     &error))
+        {
+            succeed = TRUE;
+        } else if(l->next)
+            g_clear_error(&error);
+    }
+
+    if(succeed)
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    else
+        g_dbus_method_invocation_return_gerror(invocation, error);
+
+    if(error)
+        g_error_free(error);
+    g_free(properties);
+}
+
+/* returns a ref to the value as it goes out over D-Bus; the backends
+ * share theirs between readers instead of copying the value */
+static GVariant *
+blconf_daemon_get_variant(BlconfDaemon *blconfd,
+                          const gchar *channel,
+                          const gchar *property,
+                          GError **error)
+{
+    GValue value = { 0, };
+    GVariant *variant;
+    GList *l;
+
+    if(blconfd->overlay
+       && blconf_overlay_lookup(blconfd->overlay, channel, property, &value))
+    {
+        variant = _blconf_gvalue_to_gvariant(&value);
+        if(G_LIKELY(variant))
+            g_variant_ref_sink(variant);
+        else if(error) {
+            g_set_error(error, BLCONF_ERROR, BLCONF_ERROR_INTERNAL_ERROR,
+                        _("Values of type \"%s\" can't be sent over D-Bus"),
+                        G_VALUE_TYPE_NAME(&value));
+        }
+        g_value_unset(&value);
+        return variant;
+    }
+
+    /* not in the overlay: the channel may not exist at all, so let the
+     * backends say which error it is.  check each backend until we
+     * find a value */
+    for(l = blconfd->backends; l; l = l->next) {
+        variant = blconf_backend_get_variant(l->data, channel, property,
+                                             error);
+        if(variant)
+            return variant;
+        else if(l->next)
+            g_clear_error(error);
+    }
+
+    return NULL;
+}
+
+static void
+blconf_get_property(BlconfDaemon *blconfd,
+                    GVariant *parameters,
+                    GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property;
+    GVariant *variant;
+    GError *error = NULL;
+
+    g_variant_get(parameters, "(&s&s)", &channel, &property);
+
+    variant = blconf_daemon_get_variant(blconfd, channel, property, &error);
+    if(variant) {
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(v)", variant));
+        g_variant_unref(variant);
+    } else {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+    }
+}
+
+/* runs on the main thread, unlike GetProperty: nothing can change
+ * between reading the value and the generation, and the signals for
+ * later changes are only sent after the reply */
+static void
+blconf_get_property_with_generation(BlconfDaemon *blconfd,
+                                    GVariant *parameters,
+                                    GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property;
+    GVariant *variant;
+    GError *error = NULL;
+    guint64 generation;
+
+    g_variant_get(parameters, "(&s&s)", &channel, &property);
+
+    variant = blconf_daemon_get_variant(blconfd, channel, property, &error);
+    if(!variant) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+        return;
+    }
+
+    generation = blconf_changelog_get_last_change(blconfd->changelog,
+                                                  channel, property);
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(tv)", generation,
+                                                        variant));
+    g_variant_unref(variant);
+}
+
+/* the generation is checked against the changelog, which knows when
+ * the property last changed, if not always exactly.  the backend
+ * tells blconf_daemon_backend_property_changed_full() about the
+ * change while |blconfd->patching| is set, so the splices can go out
+ * in place of the new value. */
+static void
+blconf_patch_array(BlconfDaemon *blconfd,
+                   GVariant *parameters,
+                   GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property;
+    guint64 generation;
+    GVariant *variant;
+    GArray *splices;
+    BlconfDaemonPatching patching;
+    GList *l;
+    GValue value = { 0, };
+    GError *error = NULL;
+    gboolean ret = FALSE;
+
+    g_variant_get(parameters, "(&s&st@a(uuav))", &channel, &property,
+                  &generation, &variant);
+    splices = _blconf_gvariant_to_splices(variant);
+    g_variant_unref(variant);
+    if(!splices) {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_INVALID_ARGS,
+                                              _("Some of the values can't be stored"));
+        return;
+    }
+
+    if(!blconf_daemon_check_unlocked(blconfd, channel, property, &error))
+        goto out;
+
+    if(generation
+       && blconf_changelog_get_last_change(blconfd->changelog, channel,
+                                           property) > generation)
+    {
+        g_set_error(&error, BLCONF_ERROR, BLCONF_ERROR_CONFLICT,
+                    _("Property \"%s\" on channel \"%s\" has changed since generation %" G_GUINT64_FORMAT),
+                    property, channel, generation);
+        goto out;
+    }
+
+    patching.channel = channel;
+    patching.property = property;
+    patching.splices = (const BlconfArraySplice *)splices->data;
+    patching.n_splices = splices->len;
+    blconfd->patching = &patching;
+
+    /* only write to first backend */
+    ret = blconf_backend_patch_array(blconfd->backends->data, channel,
+                                     property, patching.splices,
+                                     patching.n_splices, &error);
+
+    /* a default from one of the others: the first backend gets the
+     * patched copy */
+    if(!ret && g_error_matches(error, BLCONF_ERROR,
+                               BLCONF_ERROR_PROPERTY_NOT_FOUND))
+    {
+        for(l = blconfd->backends->next; l; l = l->next) {
+            if(blconf_backend_get(l->data, channel, property, &value, NULL))
+                break;
+        }
+
+        if(l) {
+            g_clear_error(&error);
+            if(_blconf_gvalue_splice(&value, patching.splices,
+                                     patching.n_splices))
+            {
+                ret = blconf_backend_set(blconfd->backends->data, channel,
+                                         property, &value, &error);
+            } else {
+                g_set_error(&error, BLCONF_ERROR, BLCONF_ERROR_CONFLICT,
+                            _("Property \"%s\" on channel \"%s\" is not an array that the change fits"),
+                            property, channel);
+            }
+            g_value_unset(&value);
+        }
+    }
+
+    blconfd->patching = NULL;
+
+out:
+    if(ret) {
+        generation = blconf_changelog_get_last_change(blconfd->changelog,
+                                                      channel, property);
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(t)", generation));
+    } else {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+    }
+
+    g_array_free(splices, TRUE);
+}
+
+/* the deltas are read back from the backends, as GetProperty would:
+ * a property that has a value now has changed, one that doesn't has
+ * been removed.  if a value can't be sent, the client is told to start
+ * over instead. */
+static void
+blconf_get_changes_since(BlconfDaemon *blconfd,
+                         GVariant *parameters,
+                         GDBusMethodInvocation *invocation)
+{
+    const gchar *channel;
+    guint64 since, generation = 0;
+    GPtrArray *properties = g_ptr_array_new_with_free_func(g_free);
+    GVariantBuilder changed, removed;
+    gboolean too_old;
+    guint i;
+
+    g_variant_get(parameters, "(&st)", &channel, &since);
+
+    g_variant_builder_init(&changed, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_init(&removed, G_VARIANT_TYPE_STRING_ARRAY);
+
+    too_old = !blconf_changelog_get_changes(blconfd->changelog, channel,
+                                            since, &generation, properties);
+
+    for(i = 0; !too_old && i < properties->len; ++i) {
+        const gchar *property = g_ptr_array_index(properties, i);
+        GValue value = { 0, };
+        gboolean found = FALSE;
+        GList *l;
+
+        if(blconfd->overlay)
+            found = blconf_overlay_lookup(blconfd->overlay, channel,
+                                          property, &value);
+        for(l = blconfd->backends; !found && l; l = l->next)
+            found = blconf_backend_get(l->data, channel, property, &value, NULL);
+
+        if(found) {
+            GVariant *variant = _blconf_gvalue_to_gvariant(&value);
+
+            if(variant)
+                g_variant_builder_add(&changed, "{sv}", property, variant);
+            else
+                too_old = TRUE;
+            g_value_unset(&value);
+        } else
+            g_variant_builder_add(&removed, "s", property);
+    }
+
+    if(too_old) {
+        /* nobody wants half a list */
+        g_variant_builder_clear(&changed);
+        g_variant_builder_clear(&removed);
+        g_variant_builder_init(&changed, G_VARIANT_TYPE_VARDICT);
+        g_variant_builder_init(&removed, G_VARIANT_TYPE_STRING_ARRAY);
+    }
+
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(tba{sv}as)",
+                                                        generation, too_old,
+                                                        &changed, &removed));
+
+    g_ptr_array_free(properties, TRUE);
+}
+
+/* fills |variants| (property name -> GVariant) with everything under
+ * |property_base|, for GetAllProperties and GetAllPropertiesMany */
+static gboolean
+blconf_daemon_get_all(BlconfDaemon *blconfd,
+                      const gchar *channel,
+                      const gchar *property_base,
+                      GHashTable *variants,
+                      GError **error)
+{
+    GList *l;
+    GError *tmp_error = NULL;
+    gboolean succeed = FALSE;
+
+    if(blconfd->overlay) {
+        GHashTable *properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       (GDestroyNotify)g_free,
+                                                       (GDestroyNotify)_blconf_gvalue_free);
+        GHashTableIter iter;
+        gpointer key, value;
+
+        /* an empty result for a subtree falls through, so the backends
+         * can report why */
+        if(blconf_overlay_get_all(blconfd->overlay, channel, property_base,
+                                  properties)
+           && (g_hash_table_size(properties) > 0
+               || !property_base[0] || !strcmp(property_base, "/")))
+        {
+            succeed = TRUE;
+            g_hash_table_iter_init(&iter, properties);
+            while(g_hash_table_iter_next(&iter, &key, &value)) {
+                GVariant *variant = _blconf_gvalue_to_gvariant(value);
+
+                if(variant) {
+                    g_hash_table_insert(variants, g_strdup(key),
+                                        g_variant_ref_sink(variant));
+                }
+            }
+        }
+
+        g_hash_table_destroy(properties);
+        if(succeed)
+            return TRUE;
+    }
+
+    /* get all properties from all backends.  if they all fail, return FALSE */
+    for(l = blconfd->backends; l; l = l->next) {
+        if(blconf_backend_get_all_variants(l->data, channel, property_base,
+                                           variants, &tmp_error))
+            succeed = TRUE;
+        else if(l->next) {
+            g_clear_error(&tmp_error);
+        }
+    }
+
+    if(succeed) {
+        if(tmp_error)
+            g_error_free(tmp_error);
+    } else
+        g_propagate_error(error, tmp_error);
+
+    return succeed;
+}
+
+static GVariant *
+blconf_daemon_variants_to_dict(GHashTable *variants)
+{
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer key, variant;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    g_hash_table_iter_init(&iter, variants);
+    while(g_hash_table_iter_next(&iter, &key, &variant))
+        g_variant_builder_add(&builder, "{sv}", key, variant);
+
+    return g_variant_builder_end(&builder);
+}
+
+static void
+blconf_get_all_properties(BlconfDaemon *blconfd,
+                          GVariant *parameters,
+                          GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property_base;
+    GHashTable *properties;
+    GError *error = NULL;
+
+    g_variant_get(parameters, "(&s&s)", &channel, &property_base);
+
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        (GDestroyNotify)g_free,
+                                        (GDestroyNotify)g_variant_unref);
+
+    if(blconf_daemon_get_all(blconfd, channel, property_base, properties,
+                             &error))
+    {
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(@a{sv})",
+                                                            blconf_daemon_variants_to_dict(properties)));
+    } else {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+    }
+
+    g_hash_table_destroy(properties);
+}
+
+/* lets a client that opens several channels at startup fetch them
+ * all in one round trip; see blconf_prefetch_channels() */
+static void
+blconf_get_all_properties_many(BlconfDaemon *blconfd,
+                               GVariant *parameters,
+                               GDBusMethodInvocation *invocation)
+{
+    GVariantIter *iter;
+    GVariantBuilder builder;
+    const gchar *channel, *property_base;
+
+    g_variant_get(parameters, "(a(ss))", &iter);
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(ba{sv})"));
+
+    while(g_variant_iter_next(iter, "(&s&s)", &channel, &property_base)) {
+        GHashTable *properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                       (GDestroyNotify)g_free,
+                                                       (GDestroyNotify)g_variant_unref);
+
+        if(blconf_daemon_get_all(blconfd, channel, property_base,
+                                 properties, NULL))
+        {
+            g_variant_builder_add(&builder, "(b@a{sv})", TRUE,
+                                  blconf_daemon_variants_to_dict(properties));
+        } else {
+            g_variant_builder_add(&builder, "(b@a{sv})", FALSE,
+                                  g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+                                                      NULL, 0));
+        }
+
+        g_hash_table_destroy(properties);
+    }
+
+    g_variant_iter_free(iter);
+
+    g_dbus_method_invocation_return_value(invocation,
+                                          g_variant_new("(a(ba{sv}))",
+                                                        &builder));
+}
+
+/* a cursor only makes sense within one backend's ordering, so unlike
+ * GetAllProperties the pages come from the first backend that knows
+ * the channel */
+static void
+blconf_get_all_properties_paged(BlconfDaemon *blconfd,
+                                GVariant *parameters,
+                                GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property_base, *cursor;
+    guint page_size;
+    GList *l;
+    GHashTable *properties;
+    gchar *next_cursor = NULL;
+    GError *error = NULL;
+
+    g_variant_get(parameters, "(&s&s&su)", &channel, &property_base,
+                  &cursor, &page_size);
+
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        (GDestroyNotify)g_free,
+                                        (GDestroyNotify)_blconf_gvalue_free);
+
+    for(l = blconfd->backends; l; l = l->next) {
+        if(blconf_backend_get_all_paged(l->data, channel, property_base,
+                                        cursor, page_size, properties,
+                                        &next_cursor, &error))
+        {
+            g_dbus_method_invocation_return_value(invocation,
+                                                  g_variant_new("(@a{sv}s)",
+                                                                _blconf_hash_to_gvariant(properties),
+                                                                next_cursor));
+            g_free(next_cursor);
+            g_hash_table_destroy(properties);
+            return;
+        } else if(l->next)
+            g_clear_error(&error);
+    }
+
+    g_dbus_method_invocation_return_gerror(invocation, error);
+    g_error_free(error);
+    g_hash_table_destroy(properties);
+}
+
+static void
+blconf_get_channel_snapshot(BlconfDaemon *blconfd,
+                            GVariant *parameters,
+                            GDBusMethodInvocation *invocation)
+{
+    const gchar *channel;
+    guint64 serial;
+    gint fd;
+    GError *error = NULL;
+
+    g_variant_get(parameters, "(&s)", &channel);
+
+    fd = blconf_snapshots_get(blconfd->snapshots, channel, &serial);
+    if(fd < 0) {
+        GHashTable *properties;
+        gboolean succeed = FALSE;
+        GList *l;
+
+        properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free,
+                                           (GDestroyNotify)_blconf_gvalue_free);
+
+        if(blconfd->overlay)
+            succeed = blconf_overlay_get_all(blconfd->overlay, channel, "/",
+                                             properties);
+        for(l = blconfd->backends; !succeed && l; l = l->next) {
+            if(blconf_backend_get_all(l->data, channel, "/", properties,
+                                      &error))
+            {
+                succeed = TRUE;
+            } else if(l->next)
+                g_clear_error(&error);
+        }
+
+        if(succeed) {
+            g_clear_error(&error);
+            fd = blconf_snapshots_publish(blconfd->snapshots, channel, serial,
+                                          properties, &error);
+        } else
+            blconf_snapshots_discard(blconfd->snapshots, channel, serial);
+
+        g_hash_table_destroy(properties);
+    }
+
+    if(fd >= 0) {
+        GUnixFDList *fd_list = g_unix_fd_list_new_from_array(&fd, 1);
+
+        /* the list owns |fd| now */
+        g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+                                                                g_variant_new("(ht)",
+                                                                              0,
+                                                                              serial),
+                                                                fd_list);
+        g_object_unref(fd_list);
+    } else {
+        if(!error) {
+            g_set_error(&error, BLCONF_ERROR, BLCONF_ERROR_CHANNEL_NOT_FOUND,
+                        _("Channel \"%s\" does not exist"), channel);
+        }
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+    }
+}
+
+static void
+blconf_property_exists(BlconfDaemon *blconfd,
+                       GVariant *parameters,
+                       GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property;
+    gboolean exists = FALSE;
+    gboolean succeed = FALSE;
+    GList *l;
+    GValue value = { 0, };
+    GError *error = NULL;
+
+    g_variant_get(parameters, "(&s&s)", &channel, &property);
+
+    if(blconfd->overlay
+       && blconf_overlay_lookup(blconfd->overlay, channel, property, &value))
+    {
+        g_value_unset(&value);
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(b)", TRUE));
+        return;
+    }
+
+    /* if at least one backend returns TRUE (regardles if |*exists| gets set
+     * to TRUE or FALSE), we'll return TRUE from this function */
+
+    for(l = blconfd->backends; !exists && l; l = l->next) {
+        if(blconf_backend_exists(l->data, channel, property, &exists, &error))
+            succeed = TRUE;
         else if(l->next)
             g_clear_error(&error);
     }
 
-    if(error && !lchannels) {
-        /* no channels and an error, something went wrong */
-        dbus_g_method_return_error(context, error);
-    } else {
-        channels = g_new (gchar *, g_slist_length(lchannels) + 1);
-        for(lc = lchannels, i = 0; lc; lc = lc->next, ++i)
-            channels[i] = lc->data;
-        channels[i] = NULL;
+    if(succeed) {
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(b)", exists));
+    } else {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+    }
+}
+
+static void
+blconf_reset_property(BlconfDaemon *blconfd,
+                      GVariant *parameters,
+                      GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property;
+    gboolean recursive;
+    gboolean succeed = FALSE;
+    GList *l;
+    GError *error = NULL;
+
+    g_variant_get(parameters, "(&s&sb)", &channel, &property, &recursive);
+
+    /* while technically all backends but the first should be opened read-only,
+     * we need to reset in all backends so the property doesn't reappear
+     * later */
+
+    for(l = blconfd->backends; l; l = l->next) {
+        if(blconf_backend_reset(l->data, channel, property, recursive, &error))
+            succeed = TRUE;
+        else if(l->next)
+            g_clear_error(&error);
+    }
+
+    if(succeed)
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    else
+        g_dbus_method_invocation_return_gerror(invocation, error);
+
+    if(error)
+        g_error_free(error);
+}
+
+static void
+blconf_list_channels(BlconfDaemon *blconfd,
+                     GVariant *parameters,
+                     GDBusMethodInvocation *invocation)
+{
+    GSList *lchannels = NULL, *chans_tmp, *lc;
+    GList *l;
+    guint i;
+    gchar **channels;
+    GError *error = NULL;
+
+    /* FIXME: with multiple backends, this can cause duplicates */
+    for(l = blconfd->backends; l; l = l->next) {
+        chans_tmp = NULL;
+        if(blconf_backend_list_channels(l->data, &chans_tmp, &error))
+            lchannels = g_slist_concat(lchannels, chans_tmp);
+        else if(l->next)
+            g_clear_error(&error);
+    }
+
+    if(error && !lchannels) {
+        /* no channels and an error, something went wrong */
+        g_dbus_method_invocation_return_gerror(invocation, error);
+    } else {
+        channels = g_new (gchar *, g_slist_length(lchannels) + 1);
+        for(lc = lchannels, i = 0; lc; lc = lc->next, ++i)
+            channels[i] = lc->data;
+        channels[i] = NULL;
+
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(^as)", channels));
+
+        g_strfreev(channels);
+        g_slist_free(lchannels);
+    }
+
+    if(error)
+        g_error_free(error);
+}
+
+static void
+blconf_is_property_locked(BlconfDaemon *blconfd,
+                          GVariant *parameters,
+                          GDBusMethodInvocation *invocation)
+{
+    const gchar *channel, *property;
+    GList *l;
+    gboolean locked = FALSE;
+    GError *error = NULL;
+    gboolean succeed = FALSE;
+
+    g_variant_get(parameters, "(&s&s)", &channel, &property);
+
+    for(l = blconfd->backends; !locked && l; l = l->next) {
+        if(blconf_backend_is_property_locked(l->data, channel, property,
+                                             &locked, &error))
+            succeed = TRUE;
+        else if(l->next)
+            g_clear_error(&error);
+    }
+
+    if(succeed) {
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(b)", locked));
+    } else
+        g_dbus_method_invocation_return_gerror(invocation, error);
+
+    if(error)
+        g_error_free(error);
+}
+
+
+
+static void
+blconf_get_peer_address(BlconfDaemon *blconfd,
+                        GVariant *parameters,
+                        GDBusMethodInvocation *invocation)
+{
+    if(blconfd->peer_server) {
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(s)",
+                                                            g_dbus_server_get_client_address(blconfd->peer_server)));
+    } else {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_NOT_SUPPORTED,
+                                              _("Private connections are not available"));
+    }
+}
+
+/* Handing over to a new daemon, see Handoff in blconf-dbus.xml.  The
+ * name moves atomically: the successor is already queued for it, so
+ * the bus gives it the name the moment we release it, and holds the
+ * calls for it until it's ready.  From then on nothing runs here any
+ * more.  Whatever still reaches us is forwarded to the successor:
+ * calls that were already waiting, the throttle's queues, the private
+ * connections, and clients that haven't noticed the new owner yet.
+ * So the state can't change while the backends are flushed and it is
+ * taken. */
+
+/* the forwarded call, followed by the ones it replaced in the
+ * throttle, which get the same answer */
+static void
+blconf_daemon_forward_done(GObject *source,
+                           GAsyncResult *res,
+                           gpointer user_data)
+{
+    GSList *invocations = user_data, *l;
+    GUnixFDList *fd_list = NULL;
+    GError *error = NULL;
+    GVariant *reply;
+    gchar *error_name = NULL;
+
+    reply = g_dbus_connection_call_with_unix_fd_list_finish(G_DBUS_CONNECTION(source),
+                                                            &fd_list, res,
+                                                            &error);
+    if(!reply) {
+        /* pass on the successor's error as it was sent */
+        error_name = g_dbus_error_get_remote_error(error);
+        if(error_name)
+            g_dbus_error_strip_remote_error(error);
+    }
+
+    for(l = invocations; l; l = l->next) {
+        if(reply) {
+            g_dbus_method_invocation_return_value_with_unix_fd_list(l->data,
+                                                                    reply,
+                                                                    fd_list);
+        } else if(error_name) {
+            g_dbus_method_invocation_return_dbus_error(l->data, error_name,
+                                                       error->message);
+        } else
+            g_dbus_method_invocation_return_gerror(l->data, error);
+    }
+    g_slist_free(invocations);
+
+    if(reply) {
+        g_variant_unref(reply);
+        if(fd_list)
+            g_object_unref(fd_list);
+    } else {
+        g_free(error_name);
+        g_error_free(error);
+    }
+}
+
+static void
+blconf_daemon_forward(BlconfDaemon *blconfd,
+                      GDBusMethodInvocation *invocation,
+                      GSList *superseded)
+{
+    GSList *invocations = g_slist_prepend(g_slist_copy(superseded),
+                                          invocation);
+
+    g_dbus_connection_call_with_unix_fd_list(blconfd->connection,
+                                             BLCONF_DBUS_NAME,
+                                             BLCONF_DBUS_PATH,
+                                             BLCONF_DBUS_INTERFACE,
+                                             g_dbus_method_invocation_get_method_name(invocation),
+                                             g_dbus_method_invocation_get_parameters(invocation),
+                                             NULL,
+                                             G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                             -1, NULL, NULL,
+                                             blconf_daemon_forward_done,
+                                             invocations);
+}
+
+static gboolean
+blconf_daemon_handoff_done(gpointer data)
+{
+    BlconfDaemon *blconfd = data;
+
+    blconfd->handoff_id = 0;
+
+    DBG("handoff done, exiting");
+
+    /* main() turns this into a clean shutdown */
+    raise(SIGTERM);
+
+    return FALSE;
+}
+
+/* backend type name -> state, for every backend that has some, and
+ * the daemon's own under "changelog" */
+static GVariant *
+blconf_daemon_save_state(BlconfDaemon *blconfd)
+{
+    GVariantBuilder builder;
+    GList *l;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+    for(l = blconfd->backends; l; l = l->next) {
+        GError *error = NULL;
+        GVariant *state;
+
+        if(!blconf_backend_flush(BLCONF_BACKEND(l->data), &error)) {
+            /* the successor reads what did make it to disk */
+            g_warning("Failed to flush backend before handoff: %s",
+                      error->message);
+            g_error_free(error);
+        }
+
+        state = blconf_backend_save_state(BLCONF_BACKEND(l->data));
+        if(state) {
+            g_variant_builder_add(&builder, "{sv}",
+                                  G_OBJECT_TYPE_NAME(l->data), state);
+        }
+    }
+
+    /* after the flush, as that may still report changes */
+    g_variant_builder_add(&builder, "{sv}", "changelog",
+                          blconf_changelog_save(blconfd->changelog));
 
-        dbus_g_method_return(context, channels);
+    return g_variant_builder_end(&builder);
+}
 
-        g_strfreev(channels);
-        g_slist_free(lchannels);
+static gboolean
+blconf_daemon_handoff_idled(gpointer data)
+{
+    BlconfDaemon *blconfd = data;
+    GDBusMethodInvocation *invocation = blconfd->handoff_invocation;
+    GUnixFDList *fd_list;
+    GHashTableIter iter;
+    gpointer connection;
+    GVariant *reply;
+    GError *error = NULL;
+    gint fd;
+
+    /* the signals for changes already made have to go out while the
+     * name is still ours, or the clients would ignore them */
+    if(blconfd->pending_changes_id || blconfd->pending_resets)
+        return TRUE;
+
+    blconfd->handoff_id = 0;
+    blconfd->handoff_invocation = NULL;
+
+    reply = g_dbus_connection_call_sync(blconfd->connection,
+                                        "org.freedesktop.DBus",
+                                        "/org/freedesktop/DBus",
+                                        "org.freedesktop.DBus",
+                                        "ReleaseName",
+                                        g_variant_new("(s)", BLCONF_DBUS_NAME),
+                                        G_VARIANT_TYPE("(u)"),
+                                        G_DBUS_CALL_FLAGS_NONE, -1,
+                                        NULL, &error);
+    if(!reply) {
+        g_dbus_method_invocation_return_gerror(invocation, error);
+        g_error_free(error);
+        return FALSE;
     }
+    g_variant_unref(reply);
 
-    if(error)
+    blconfd->handed_off = TRUE;
+
+    /* the peers come back through the bus, and find the successor */
+    if(blconfd->peer_server) {
+        g_dbus_server_stop(blconfd->peer_server);
+        g_object_unref(blconfd->peer_server);
+        blconfd->peer_server = NULL;
+    }
+
+    fd = blconf_handoff_write(blconf_daemon_save_state(blconfd), &error);
+    if(fd >= 0) {
+        fd_list = g_unix_fd_list_new_from_array(&fd, 1);
+        g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+                                                                g_variant_new("(h)", 0),
+                                                                fd_list);
+        g_object_unref(fd_list);
+    } else {
+        g_dbus_method_invocation_return_gerror(invocation, error);
         g_error_free(error);
+    }
+
+    g_hash_table_iter_init(&iter, blconfd->peers);
+    while(g_hash_table_iter_next(&iter, &connection, NULL))
+        g_dbus_connection_close(connection, NULL, NULL, NULL);
+
+    blconfd->handoff_id = g_timeout_add_seconds(HANDOFF_LINGER,
+                                                blconf_daemon_handoff_done,
+                                                blconfd);
+
+    return FALSE;
 }
 
-static void blconf_is_property_locked(BlconfDaemon *blconfd,
-                          const gchar *channel,
-                          const gchar *property,
-                          DBusGMethodInvocation *context)
+/* Subscribe and Unsubscribe are handled right away on the main
+ * thread, where the signals go out, so a call made after them already
+ * sees the signals they asked for.  on the bus they do nothing: there
+ * the clients use match rules, and the bus daemon does the filtering. */
+static void
+blconf_daemon_subscribe(BlconfDaemon *blconfd,
+                        GDBusConnection *connection,
+                        gboolean subscribe,
+                        GVariant *parameters,
+                        GDBusMethodInvocation *invocation)
 {
-    GList *l;
-    gboolean locked = FALSE;
-    GError *error = NULL;
-    gboolean succeed = FALSE;
+    BlconfDaemonPeer *peer = g_hash_table_lookup(blconfd->peers, connection);
+    const gchar *channel;
+    gchar *property_base;
+    GPtrArray *bases;
+    gsize len;
+    guint i;
 
-    for(l = blconfd->backends; !locked && l; l = l->next) {
-        if(blconf_backend_is_property_locked(l->data, channel, property,
-                                             &locked, &error))
-            succeed = TRUE;
-        else if(l->next)
-            g_clear_error(&error);
+    g_variant_get(parameters, "(&ss)", &channel, &property_base);
+
+    /* "/a/b/" and "/a/b" are the same subtree */
+    len = strlen(property_base);
+    while(len > 1 && property_base[len - 1] == '/')
+        property_base[--len] = '\0';
+
+    if(property_base[0] != '/') {
+        g_dbus_method_invocation_return_error(invocation, BLCONF_ERROR,
+                                              BLCONF_ERROR_INVALID_PROPERTY,
+                                              _("Property base \"%s\" doesn't start with a '/'"),
+                                              property_base);
+        g_free(property_base);
+        return;
     }
 
-    if(succeed)
-        dbus_g_method_return(context, locked);
-    else
-        dbus_g_method_return_error(context, error);
+    if(peer && subscribe) {
+        if(!peer->subscriptions) {
+            peer->subscriptions = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                        (GDestroyNotify)g_free,
+                                                        (GDestroyNotify)g_ptr_array_unref);
+        }
 
-    if(error)
+        bases = g_hash_table_lookup(peer->subscriptions, channel);
+        if(!bases) {
+            bases = g_ptr_array_new_with_free_func(g_free);
+            g_hash_table_insert(peer->subscriptions, g_strdup(channel), bases);
+        }
+        g_ptr_array_add(bases, property_base);
+        property_base = NULL;
+    } else if(peer && peer->subscriptions) {
+        /* one subscription at a time, like RemoveMatch */
+        bases = g_hash_table_lookup(peer->subscriptions, channel);
+        for(i = 0; bases && i < bases->len; ++i) {
+            if(!strcmp(g_ptr_array_index(bases, i), property_base)) {
+                g_ptr_array_remove_index_fast(bases, i);
+                if(!bases->len)
+                    g_hash_table_remove(peer->subscriptions, channel);
+                break;
+            }
+        }
+    }
+
+    g_dbus_method_invocation_return_value(invocation, NULL);
+    g_free(property_base);
+}
+
+static void
+blconf_daemon_handoff(BlconfDaemon *blconfd,
+                      GDBusConnection *connection,
+                      GDBusMethodInvocation *invocation)
+{
+    const gchar *sender = g_dbus_method_invocation_get_sender(invocation);
+    const gchar **owners = NULL;
+    GVariant *reply = NULL;
+    gboolean next_in_line = FALSE;
+
+    /* whoever gets the name next */
+    if(connection == blconfd->connection
+       && !blconfd->handed_off && !blconfd->handoff_invocation)
+    {
+        reply = g_dbus_connection_call_sync(connection,
+                                            "org.freedesktop.DBus",
+                                            "/org/freedesktop/DBus",
+                                            "org.freedesktop.DBus",
+                                            "ListQueuedOwners",
+                                            g_variant_new("(s)", BLCONF_DBUS_NAME),
+                                            G_VARIANT_TYPE("(as)"),
+                                            G_DBUS_CALL_FLAGS_NONE, -1,
+                                            NULL, NULL);
+    }
+    if(reply) {
+        g_variant_get(reply, "(^a&s)", &owners);
+        next_in_line = (owners[0] && owners[1] && !strcmp(owners[1], sender));
+        g_free(owners);
+        g_variant_unref(reply);
+    }
+
+    if(!next_in_line) {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_ACCESS_DENIED,
+                                              _("Only the next owner of the name may take over"));
+        return;
+    }
+
+    DBG("handing off to %s", sender);
+
+    /* after everything that's already waiting, including the idles
+     * announcing changes */
+    blconfd->handoff_invocation = invocation;
+    blconfd->handoff_id = g_idle_add_full(G_PRIORITY_LOW,
+                                          blconf_daemon_handoff_idled,
+                                          blconfd, NULL);
+}
+
+typedef void (*BlconfDaemonMethodFunc)(BlconfDaemon *blconfd,
+                                       GVariant *parameters,
+                                       GDBusMethodInvocation *invocation);
+
+static const struct
+{
+    const gchar *name;
+    BlconfDaemonMethodFunc func;
+    gboolean read_only;
+} blconf_daemon_methods[] = {
+    { "SetProperty", blconf_set_property, FALSE },
+    { "SetProperties", blconf_set_properties, FALSE },
+    { "GetProperty", blconf_get_property, TRUE },
+    { "GetPropertyWithGeneration", blconf_get_property_with_generation, FALSE },
+    { "PatchArray", blconf_patch_array, FALSE },
+    { "GetProperties", blconf_get_properties, TRUE },
+    { "GetAllProperties", blconf_get_all_properties, TRUE },
+    { "GetAllPropertiesPaged", blconf_get_all_properties_paged, TRUE },
+    { "GetAllPropertiesMany", blconf_get_all_properties_many, TRUE },
+    { "GetChannelSnapshot", blconf_get_channel_snapshot, TRUE },
+    { "GetChangesSince", blconf_get_changes_since, TRUE },
+    { "PropertyExists", blconf_property_exists, TRUE },
+    { "ResetProperty", blconf_reset_property, FALSE },
+    { "ResetProperties", blconf_reset_properties, FALSE },
+    { "ListChannels", blconf_list_channels, TRUE },
+    { "IsPropertyLocked", blconf_is_property_locked, TRUE },
+    { "GetPeerAddress", blconf_get_peer_address, TRUE },
+};
+
+typedef struct
+{
+    guint method;
+    GDBusMethodInvocation *invocation;
+} BlconfDaemonCall;
+
+/* the time recorded is how long the method ran, not counting the
+ * wait in the throttle or for a worker */
+static void
+blconf_daemon_call_method(BlconfDaemon *blconfd,
+                          guint i,
+                          GDBusMethodInvocation *invocation,
+                          GSList *superseded)
+{
+    gint64 start;
+
+    BLCONF_PROBE2(method__entry, blconf_daemon_methods[i].name,
+                  g_dbus_method_invocation_get_sender(invocation));
+    start = g_get_monotonic_time();
+
+    if(superseded) {
+        GError *error = NULL;
+
+        /* only SetProperty calls are collapsed, see _method_call();
+         * the ones replaced get told whether this write worked */
+        g_assert(blconf_daemon_methods[i].func == blconf_set_property);
+        blconf_daemon_set_property(blconfd,
+                                   g_dbus_method_invocation_get_parameters(invocation),
+                                   &error);
+        blconf_daemon_return_all(invocation, superseded, error);
+        if(error)
+            g_error_free(error);
+    } else {
+        blconf_daemon_methods[i].func(blconfd,
+                                      g_dbus_method_invocation_get_parameters(invocation),
+                                      invocation);
+    }
+
+    blconf_histogram_record(&blconfd->method_times[i],
+                            g_get_monotonic_time() - start);
+    /* the invocation is gone by now, match up on the thread */
+    BLCONF_PROBE1(method__return, blconf_daemon_methods[i].name);
+}
+
+static void
+blconf_daemon_worker(gpointer data,
+                     gpointer user_data)
+{
+    BlconfDaemonCall *call = data;
+
+    blconf_daemon_call_method(BLCONF_DAEMON(user_data), call->method,
+                              call->invocation, NULL);
+
+    g_slice_free(BlconfDaemonCall, call);
+}
+
+/* called by the throttle, with |call_data| the index of the method;
+ * only writes ever come with |superseded| calls */
+static void
+blconf_daemon_run_method(GDBusMethodInvocation *invocation,
+                         GSList *superseded,
+                         gpointer call_data,
+                         gpointer user_data)
+{
+    BlconfDaemon *blconfd = user_data;
+    guint i = GPOINTER_TO_UINT(call_data);
+
+    if(G_UNLIKELY(blconfd->handed_off)) {
+        blconf_daemon_forward(blconfd, invocation, superseded);
+        return;
+    }
+
+    /* writes stay on the main thread so that change notifications
+     * go out in the order the writes arrived */
+    if(blconf_daemon_methods[i].read_only) {
+        BlconfDaemonCall *call = g_slice_new(BlconfDaemonCall);
+
+        call->method = i;
+        call->invocation = invocation;
+        g_thread_pool_push(blconfd->workers, call, NULL);
+    } else
+        blconf_daemon_call_method(blconfd, i, invocation, superseded);
+}
+
+static void
+blconf_daemon_method_call(GDBusConnection *connection,
+                          const gchar *sender,
+                          const gchar *object_path,
+                          const gchar *interface_name,
+                          const gchar *method_name,
+                          GVariant *parameters,
+                          GDBusMethodInvocation *invocation,
+                          gpointer user_data)
+{
+    BlconfDaemon *blconfd = user_data;
+    guint i;
+
+    if(!sender)
+        sender = g_object_get_data(G_OBJECT(connection), PEER_NAME_KEY);
+
+    blconf_stats_record_sender(blconfd->stats, sender);
+
+    /* not a method like the others: it must not wait in the throttle,
+     * and is never forwarded */
+    if(!strcmp(method_name, "Handoff")) {
+        blconf_daemon_handoff(blconfd, connection, invocation);
+        return;
+    }
+    if(!strcmp(method_name, "Subscribe")
+       || !strcmp(method_name, "Unsubscribe"))
+    {
+        blconf_daemon_subscribe(blconfd, connection,
+                                !strcmp(method_name, "Subscribe"),
+                                parameters, invocation);
+        return;
+    }
+    if(!strcmp(method_name, "EnablePatches")) {
+        BlconfDaemonPeer *peer = g_hash_table_lookup(blconfd->peers,
+                                                     connection);
+
+        /* like Subscribe, this counts from the next signal on */
+        if(peer)
+            peer->patches = TRUE;
+        g_dbus_method_invocation_return_value(invocation, NULL);
+        return;
+    }
+    if(!strcmp(method_name, "EnableBatchedChanges")) {
+        BlconfDaemonPeer *peer = g_hash_table_lookup(blconfd->peers,
+                                                     connection);
+
+        if(peer)
+            peer->batched = TRUE;
+        g_dbus_method_invocation_return_value(invocation, NULL);
+        return;
+    }
+
+    for(i = 0; i < G_N_ELEMENTS(blconf_daemon_methods); ++i) {
+        gchar *collapse_key = NULL;
+
+        if(strcmp(method_name, blconf_daemon_methods[i].name))
+            continue;
+
+        /* a waiting SetProperty can be replaced by a later one for
+         * the same property */
+        if(blconf_daemon_methods[i].func == blconf_set_property) {
+            const gchar *channel, *property;
+
+            g_variant_get(parameters, "(&s&s@v)", &channel, &property, NULL);
+            collapse_key = g_strconcat(channel, "\n", property, NULL);
+        }
+
+        /* reads only wait for the sender's earlier writes */
+        blconf_throttle_submit(blconfd->throttle, invocation, sender,
+                               GUINT_TO_POINTER(i),
+                               blconf_daemon_methods[i].read_only ? 0 : 1,
+                               collapse_key);
+
+        return;
+    }
+
+    g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                          G_DBUS_ERROR_UNKNOWN_METHOD,
+                                          _("No such method \"%s\""),
+                                          method_name);
+}
+
+static const GDBusInterfaceVTable blconf_daemon_vtable = {
+    blconf_daemon_method_call,
+    NULL,
+    NULL,
+};
+
+static void
+blconf_daemon_stats_method_call(GDBusConnection *connection,
+                                const gchar *sender,
+                                const gchar *object_path,
+                                const gchar *interface_name,
+                                const gchar *method_name,
+                                GVariant *parameters,
+                                GDBusMethodInvocation *invocation,
+                                gpointer user_data)
+{
+    if(!strcmp(method_name, "GetStats")) {
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(@a{sv})",
+                                                            blconf_daemon_get_stats(user_data)));
+    } else {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              _("No such method \"%s\""),
+                                              method_name);
+    }
+}
+
+static const GDBusInterfaceVTable blconf_daemon_stats_vtable = {
+    blconf_daemon_stats_method_call,
+    NULL,
+    NULL,
+};
+
+/* exports both interfaces on |connection|, the bus or a peer */
+static gboolean
+blconf_daemon_register_objects(BlconfDaemon *blconfd,
+                               GDBusConnection *connection,
+                               guint *registration_id,
+                               guint *stats_registration_id,
+                               GError **error)
+{
+    GDBusInterfaceInfo *interface_info;
+
+    interface_info = g_dbus_node_info_lookup_interface(blconfd->node_info,
+                                                       BLCONF_DBUS_INTERFACE);
+    *registration_id = g_dbus_connection_register_object(connection,
+                                                         BLCONF_DBUS_PATH,
+                                                         interface_info,
+                                                         &blconf_daemon_vtable,
+                                                         blconfd, NULL,
+                                                         error);
+    if(G_UNLIKELY(!*registration_id))
+        return FALSE;
+
+    interface_info = g_dbus_node_info_lookup_interface(blconfd->node_info,
+                                                       BLCONF_DBUS_STATS_INTERFACE);
+    *stats_registration_id = g_dbus_connection_register_object(connection,
+                                                               BLCONF_DBUS_PATH,
+                                                               interface_info,
+                                                               &blconf_daemon_stats_vtable,
+                                                               blconfd, NULL,
+                                                               error);
+    if(G_UNLIKELY(!*stats_registration_id)) {
+        g_dbus_connection_unregister_object(connection, *registration_id);
+        *registration_id = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+blconf_daemon_peer_closed(GDBusConnection *connection,
+                          gboolean remote_peer_vanished,
+                          GError *error,
+                          gpointer user_data)
+{
+    BlconfDaemon *blconfd = user_data;
+    BlconfDaemonPeer *peer = g_hash_table_lookup(blconfd->peers, connection);
+
+    if(!peer)
+        return;
+
+    DBG("peer %s went away",
+        (const gchar *)g_object_get_data(G_OBJECT(connection), PEER_NAME_KEY));
+
+    g_signal_handlers_disconnect_by_func(connection,
+                                         G_CALLBACK(blconf_daemon_peer_closed),
+                                         blconfd);
+    g_dbus_connection_unregister_object(connection, peer->registration_id);
+    g_dbus_connection_unregister_object(connection,
+                                        peer->stats_registration_id);
+    blconf_daemon_peer_free(peer);
+    g_hash_table_remove(blconfd->peers, connection);
+}
+
+static void
+blconf_daemon_peer_free(BlconfDaemonPeer *peer)
+{
+    if(peer->subscriptions)
+        g_hash_table_destroy(peer->subscriptions);
+    g_slice_free(BlconfDaemonPeer, peer);
+}
+
+static gboolean
+blconf_daemon_peer_new_connection(GDBusServer *server,
+                                  GDBusConnection *connection,
+                                  gpointer user_data)
+{
+    BlconfDaemon *blconfd = user_data;
+    BlconfDaemonPeer *peer = g_slice_new0(BlconfDaemonPeer);
+    GError *error = NULL;
+
+    if(!blconf_daemon_register_objects(blconfd, connection,
+                                       &peer->registration_id,
+                                       &peer->stats_registration_id,
+                                       &error))
+    {
+        g_warning("Unable to set up private connection: %s", error->message);
         g_error_free(error);
+        g_slice_free(BlconfDaemonPeer, peer);
+        return FALSE;
+    }
+
+    /* the throttle and the stats tell clients apart by their unique
+     * names, which only the bus hands out; make one up that won't
+     * clash with those */
+    g_object_set_data_full(G_OBJECT(connection), PEER_NAME_KEY,
+                           g_strdup_printf(":peer.%u", ++blconfd->n_peers_seen),
+                           g_free);
+
+    g_hash_table_insert(blconfd->peers, g_object_ref(connection), peer);
+    g_signal_connect(connection, "closed",
+                     G_CALLBACK(blconf_daemon_peer_closed), blconfd);
+
+    return TRUE;
+}
+
+/* only the user the daemon runs as may connect, same as on the
+ * session bus */
+static gboolean
+blconf_daemon_peer_authorize(GDBusAuthObserver *observer,
+                             GIOStream *stream,
+                             GCredentials *credentials,
+                             gpointer user_data)
+{
+    return credentials
+           && g_credentials_get_unix_user(credentials, NULL) == getuid();
 }
 
+/* The private socket lets clients skip the bus daemon: half the
+ * copies and context switches per call, and a queue of their own.
+ * Clients find it through GetPeerAddress.  Not having one is fine,
+ * everyone just stays on the bus. */
+static void
+blconf_daemon_start_peer_server(BlconfDaemon *blconfd)
+{
+    GDBusAuthObserver *observer;
+    gchar *address, *guid;
+    GError *error = NULL;
+
+    address = g_strdup_printf("unix:tmpdir=%s", g_get_user_runtime_dir());
+    guid = g_dbus_generate_guid();
+    observer = g_dbus_auth_observer_new();
+    g_signal_connect(observer, "authorize-authenticated-peer",
+                     G_CALLBACK(blconf_daemon_peer_authorize), NULL);
+
+    blconfd->peer_server = g_dbus_server_new_sync(address,
+                                                  G_DBUS_SERVER_FLAGS_NONE,
+                                                  guid, observer, NULL,
+                                                  &error);
+    g_object_unref(observer);
+    g_free(guid);
+    g_free(address);
+
+    if(!blconfd->peer_server) {
+        g_message("No private connections: %s", error->message);
+        g_error_free(error);
+        return;
+    }
+
+    g_signal_connect(blconfd->peer_server, "new-connection",
+                     G_CALLBACK(blconf_daemon_peer_new_connection), blconfd);
+    g_dbus_server_start(blconfd->peer_server);
+}
 
+/* asks the daemon we're queued behind for its state; it gives up the
+ * name before answering, successful or not */
+static void
+blconf_daemon_take_over(BlconfDaemon *blconfd)
+{
+    GUnixFDList *fd_list = NULL;
+    GVariant *reply;
+    GError *error = NULL;
+    gint32 handle;
+    gint fd;
+
+    reply = g_dbus_connection_call_with_unix_fd_list_sync(blconfd->connection,
+                                                          BLCONF_DBUS_NAME,
+                                                          BLCONF_DBUS_PATH,
+                                                          BLCONF_DBUS_INTERFACE,
+                                                          "Handoff", NULL,
+                                                          G_VARIANT_TYPE("(h)"),
+                                                          G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                          -1, NULL, &fd_list,
+                                                          NULL, &error);
+    if(reply) {
+        g_variant_get(reply, "(h)", &handle);
+        g_variant_unref(reply);
+
+        fd = g_unix_fd_list_get(fd_list, handle, &error);
+        if(fd >= 0) {
+            blconfd->handoff_state = blconf_handoff_read(fd, &error);
+            close(fd);
+        }
+        g_object_unref(fd_list);
+    }
 
+    if(!blconfd->handoff_state) {
+        g_message("Not taking over the running daemon's state: %s",
+                  error->message);
+        g_error_free(error);
+    }
+}
 
 static gboolean
 blconf_daemon_start(BlconfDaemon *blconfd,
+                    gboolean replace,
                     GError **error)
 {
-    int ret;
-    DBusError derror;
+    GVariant *reply;
+    guint32 ret;
+
+    blconfd->connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, error);
+    if(G_UNLIKELY(!blconfd->connection))
+        return FALSE;
+
+    blconfd->node_info = g_dbus_node_info_new_for_xml(blconf_dbus_introspection_xml,
+                                                      error);
+    if(G_UNLIKELY(!blconfd->node_info))
+        return FALSE;
+
+    blconfd->method_times = g_new0(BlconfHistogram,
+                                   G_N_ELEMENTS(blconf_daemon_methods));
+
+    if(!blconf_daemon_register_objects(blconfd, blconfd->connection,
+                                       &blconfd->registration_id,
+                                       &blconfd->stats_registration_id,
+                                       error))
+    {
+        return FALSE;
+    }
 
-    blconfd->dbus_conn = dbus_g_bus_get(DBUS_BUS_SESSION, error);
-    if(G_UNLIKELY(!blconfd->dbus_conn))
+    g_signal_connect(blconfd->connection, "closed",
+                     G_CALLBACK(blconf_daemon_connection_closed), blconfd);
+
+    reply = g_dbus_connection_call_sync(blconfd->connection,
+                                        "org.freedesktop.DBus",
+                                        "/org/freedesktop/DBus",
+                                        "org.freedesktop.DBus",
+                                        "RequestName",
+                                        g_variant_new("(su)", BLCONF_DBUS_NAME,
+                                                      replace ? 0
+                                                      : 0x4 /* DO_NOT_QUEUE */),
+                                        G_VARIANT_TYPE("(u)"),
+                                        G_DBUS_CALL_FLAGS_NONE, -1,
+                                        NULL, error);
+    if(G_UNLIKELY(!reply))
         return FALSE;
 
-    dbus_g_connection_register_g_object(blconfd->dbus_conn,
-                                        "/org/blade/Blconf",
-                                        G_OBJECT(blconfd));
-
-    dbus_connection_add_filter(dbus_g_connection_get_connection(blconfd->dbus_conn),
-                               blconf_daemon_handle_dbus_disconnect,
-                               blconfd, NULL);
-
-    dbus_error_init(&derror);
-    ret = dbus_bus_request_name(dbus_g_connection_get_connection(blconfd->dbus_conn),
-                                "org.blade.Blconf",
-                                DBUS_NAME_FLAG_DO_NOT_QUEUE,
-                                &derror);
-    if(DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER != ret) {
-        if(dbus_error_is_set(&derror)) {
-            if(error)
-                dbus_set_g_error(error, &derror);
-            dbus_error_free(&derror);
-        } else if(error) {
-            g_set_error(error, DBUS_GERROR, DBUS_GERROR_FAILED,
+    g_variant_get(reply, "(u)", &ret);
+    g_variant_unref(reply);
+
+    /* 2 == DBUS_REQUEST_NAME_REPLY_IN_QUEUE: another daemon has it,
+     * and we're next */
+    if(ret == 2) {
+        blconf_daemon_take_over(blconfd);
+
+        reply = g_dbus_connection_call_sync(blconfd->connection,
+                                            "org.freedesktop.DBus",
+                                            "/org/freedesktop/DBus",
+                                            "org.freedesktop.DBus",
+                                            "GetNameOwner",
+                                            g_variant_new("(s)", BLCONF_DBUS_NAME),
+                                            G_VARIANT_TYPE("(s)"),
+                                            G_DBUS_CALL_FLAGS_NONE, -1,
+                                            NULL, NULL);
+        if(reply) {
+            const gchar *owner;
+
+            g_variant_get(reply, "(&s)", &owner);
+            if(!g_strcmp0(owner, g_dbus_connection_get_unique_name(blconfd->connection)))
+                ret = 1;
+            g_variant_unref(reply);
+        }
+    }
+
+    /* 1 == DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER */
+    if(ret != 1) {
+        if(error) {
+            g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_FAILED,
                         _("Another Blconf daemon is already running"));
         }
 
         return FALSE;
     }
 
+    blconf_daemon_start_peer_server(blconfd);
+
     return TRUE;
 }
 
@@ -505,8 +2508,16 @@ blconf_daemon_load_config(BlconfDaemon *blconfd,
             g_clear_error(&error1);
         } else {
             blconfd->backends = g_list_prepend(blconfd->backends, backend);
-            blconf_backend_register_property_changed_func(backend,
-                                                          blconf_daemon_backend_property_changed,
+            if(!blconf_backend_register_property_changed_full_func(backend,
+                                                                   blconf_daemon_backend_property_changed_full,
+                                                                   blconfd))
+            {
+                blconf_backend_register_property_changed_func(backend,
+                                                              blconf_daemon_backend_property_changed,
+                                                              blconfd);
+            }
+            blconf_backend_register_properties_reset_func(backend,
+                                                          blconf_daemon_backend_properties_reset,
                                                           blconfd);
         }
     }
@@ -520,39 +2531,74 @@ blconf_daemon_load_config(BlconfDaemon *blconfd,
     }
 
     blconfd->backends = g_list_reverse(blconfd->backends);
+    if(blconfd->backends->next)
+        blconfd->overlay = blconf_overlay_new(blconfd->backends);
 
     return TRUE;
 }
 
-static DBusHandlerResult
-blconf_daemon_handle_dbus_disconnect(DBusConnection *conn,
-                                     DBusMessage *message,
-                                     void *user_data)
+static void
+blconf_daemon_connection_closed(GDBusConnection *connection,
+                                gboolean remote_peer_vanished,
+                                GError *error,
+                                gpointer user_data)
 {
-    if(dbus_message_is_signal(message, DBUS_INTERFACE_LOCAL, "Disconnected")) {
-        BlconfDaemon *blconfd = user_data;
-        GList *l;
+    BlconfDaemon *blconfd = user_data;
+    GList *l;
 
-        DBG("got dbus disconnect; flushing all channels");
+    DBG("got dbus disconnect; flushing all channels");
 
-        for(l = blconfd->backends; l; l = l->next) {
-            GError *error = NULL;
-            if(!blconf_backend_flush(BLCONF_BACKEND(l->data), &error)) {
-                g_critical("Failed to flush backend on disconnect: %s",
-                           error->message);
-                g_error_free(error);
-            }
+    /* GDBus raises SIGTERM after this, which main() turns into a clean
+     * shutdown; flush now in case that doesn't get that far */
+    for(l = blconfd->backends; l; l = l->next) {
+        GError *error1 = NULL;
+        if(!blconf_backend_flush(BLCONF_BACKEND(l->data), &error1)) {
+            g_critical("Failed to flush backend on disconnect: %s",
+                       error1->message);
+            g_error_free(error1);
         }
     }
-
-    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 }
 
 
 
 
+/* hands each backend what its counterpart in the old daemon saved;
+ * nothing else calls into them before this */
+static void
+blconf_daemon_restore_state(BlconfDaemon *blconfd)
+{
+    GVariant *changelog;
+    GList *l;
+
+    for(l = blconfd->backends; l; l = l->next) {
+        GVariant *state = g_variant_lookup_value(blconfd->handoff_state,
+                                                 G_OBJECT_TYPE_NAME(l->data),
+                                                 NULL);
+
+        if(state) {
+            blconf_backend_restore_state(BLCONF_BACKEND(l->data), state);
+            g_variant_unref(state);
+        }
+    }
+
+    /* so the clients' generations stay good across the handoff */
+    changelog = g_variant_lookup_value(blconfd->handoff_state, "changelog",
+                                       G_VARIANT_TYPE_VARDICT);
+    if(changelog) {
+        blconf_changelog_restore(blconfd->changelog, changelog);
+        g_variant_unref(changelog);
+    }
+
+    g_variant_unref(blconfd->handoff_state);
+    blconfd->handoff_state = NULL;
+}
+
+/* with |replace|, a daemon that's already running hands over its name
+ * and what it has loaded, instead of this failing */
 BlconfDaemon *
 blconf_daemon_new_unique(gchar * const *backend_ids,
+                         gboolean replace,
                          GError **error)
 {
     BlconfDaemon *blconfd;
@@ -561,12 +2607,115 @@ blconf_daemon_new_unique(gchar * const *backend_ids,
 
     blconfd = g_object_new(BLCONF_TYPE_DAEMON, NULL);
 
-    if(!blconf_daemon_start(blconfd, error)
+    if(!blconf_daemon_start(blconfd, replace, error)
        || !blconf_daemon_load_config(blconfd, backend_ids, error))
     {
         g_object_unref(G_OBJECT(blconfd));
         return NULL;
     }
 
+    if(blconfd->handoff_state)
+        blconf_daemon_restore_state(blconfd);
+
     return blconfd;
 }
+
+/* asks each backend to start loading @channels, and whatever else it
+ * expects to be needed soon, in the background.  backends may start
+ * threads for this, so it has to wait until after any fork(). */
+void
+blconf_daemon_preload(BlconfDaemon *blconfd,
+                      gchar * const *channels)
+{
+    GList *l;
+
+    g_return_if_fail(BLCONF_IS_DAEMON(blconfd));
+
+    for(l = blconfd->backends; l; l = l->next)
+        blconf_backend_preload(BLCONF_BACKEND(l->data),
+                               (const gchar * const *)channels);
+}
+
+/* a{sv} of everything worth knowing about how the daemon is doing;
+ * the keys are listed with org.blade.Blconf.Stats.GetStats */
+GVariant *
+blconf_daemon_get_stats(BlconfDaemon *blconfd)
+{
+    GVariantBuilder builder, methods, backends;
+    GHashTableIter iter;
+    gpointer props;
+    guint n_pending = 0;
+    GList *l;
+    guint i;
+
+    g_return_val_if_fail(BLCONF_IS_DAEMON(blconfd), NULL);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+
+    g_variant_builder_init(&methods, G_VARIANT_TYPE_VARDICT);
+    for(i = 0; blconfd->method_times && i < G_N_ELEMENTS(blconf_daemon_methods); ++i) {
+        g_variant_builder_add(&methods, "{sv}", blconf_daemon_methods[i].name,
+                              blconf_histogram_to_variant(&blconfd->method_times[i]));
+    }
+    g_variant_builder_add(&builder, "{sv}", "methods",
+                          g_variant_builder_end(&methods));
+
+    blconf_stats_collect(blconfd->stats, &builder);
+
+    g_hash_table_iter_init(&iter, blconfd->pending_changes);
+    while(g_hash_table_iter_next(&iter, NULL, &props))
+        n_pending += g_hash_table_size(props);
+    g_variant_builder_add(&builder, "{sv}", "pending-changes",
+                          g_variant_new_uint32(n_pending));
+    g_variant_builder_add(&builder, "{sv}", "pending-resets",
+                          g_variant_new_uint32(blconfd->pending_resets));
+
+    g_variant_builder_init(&backends, G_VARIANT_TYPE("a(sa{sv})"));
+    for(l = blconfd->backends; l; l = l->next) {
+        GVariant *stats = blconf_backend_get_stats(l->data);
+
+        if(stats) {
+            g_variant_builder_add(&backends, "(s@a{sv})",
+                                  G_OBJECT_TYPE_NAME(l->data), stats);
+        }
+    }
+    g_variant_builder_add(&builder, "{sv}", "backends",
+                          g_variant_builder_end(&backends));
+
+    return g_variant_builder_end(&builder);
+}
+
+/* for SIGUSR1 */
+void
+blconf_daemon_dump_stats(BlconfDaemon *blconfd)
+{
+    GVariant *stats;
+    gchar *text;
+
+    g_return_if_fail(BLCONF_IS_DAEMON(blconfd));
+
+    stats = g_variant_ref_sink(blconf_daemon_get_stats(blconfd));
+    text = g_variant_print(stats, FALSE);
+    g_message("Stats: %s", text);
+    g_free(text);
+    g_variant_unref(stats);
+}
+
+/* for SIGUSR2: has the backends that only keep things in memory save
+ * them, see blconf_backend_dump() */
+void
+blconf_daemon_dump_backends(BlconfDaemon *blconfd)
+{
+    GList *l;
+
+    g_return_if_fail(BLCONF_IS_DAEMON(blconfd));
+
+    for(l = blconfd->backends; l; l = l->next) {
+        GError *error = NULL;
+
+        if(!blconf_backend_dump(BLCONF_BACKEND(l->data), &error)) {
+            g_warning("Failed to dump backend: %s", error->message);
+            g_error_free(error);
+        }
+    }
+}
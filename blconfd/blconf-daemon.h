@@ -36,8 +36,17 @@ typedef struct _BlconfDaemon         BlconfDaemon;
 GType blconf_daemon_get_type(void) G_GNUC_CONST;
 
 BlconfDaemon *blconf_daemon_new_unique(gchar * const *backend_ids,
+                                       gboolean replace,
                                        GError **error);
 
+void blconf_daemon_preload(BlconfDaemon *blconfd,
+                           gchar * const *channels);
+
+GVariant *blconf_daemon_get_stats(BlconfDaemon *blconfd);
+void blconf_daemon_dump_stats(BlconfDaemon *blconfd);
+
+void blconf_daemon_dump_backends(BlconfDaemon *blconfd);
+
 G_END_DECLS
 
 #endif  /* __BLCONF_DAEMON_H__ */
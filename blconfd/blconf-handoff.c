@@ -0,0 +1,203 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* The state one blconfd hands to the one replacing it, see
+ * blconf_daemon_handoff().  It travels as a sealed memfd holding a
+ * small header and the serialized a{sv}, so however big it gets it's
+ * written once and mapped by the successor, and can't change under it
+ * while it's being read.  The contents come from another process, so
+ * the GVariant is loaded as untrusted. */
+
+/* for memfd_create() and the sealing fcntl()s */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <gio/gio.h>
+
+#include "blconf-handoff.h"
+
+#if defined(HAVE_MEMFD_CREATE) && defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+#define HAVE_SEALED_MEMFD 1
+#endif
+
+#define HANDOFF_MAGIC   (0x48434c42)  /* "BLCH" */
+#define HANDOFF_FORMAT  (1)
+
+#define HANDOFF_SEALS   (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+/* the data follows right after, which keeps it 8-byte aligned */
+typedef struct
+{
+    guint32 magic;
+    guint32 format;
+    guint64 data_size;
+} HandoffHeader;
+
+#ifdef HAVE_SEALED_MEMFD
+static gboolean
+blconf_handoff_write_all(gint fd,
+                         const guint8 *data,
+                         gsize len)
+{
+    while(len) {
+        gssize ret = write(fd, data, len);
+
+        if(ret < 0) {
+            if(errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        data += ret;
+        len -= ret;
+    }
+
+    return TRUE;
+}
+#endif
+
+/* returns a sealed memfd with |state|, an a{sv}, or -1 */
+gint
+blconf_handoff_write(GVariant *state,
+                     GError **error)
+{
+#ifdef HAVE_SEALED_MEMFD
+    HandoffHeader header;
+    gint fd;
+
+    g_return_val_if_fail(g_variant_is_of_type(state, G_VARIANT_TYPE_VARDICT),
+                         -1);
+
+    g_variant_ref_sink(state);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = HANDOFF_MAGIC;
+    header.format = HANDOFF_FORMAT;
+    header.data_size = g_variant_get_size(state);
+
+    fd = memfd_create("blconfd-handoff", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd < 0
+       || !blconf_handoff_write_all(fd, (const guint8 *)&header,
+                                    sizeof(header))
+       || !blconf_handoff_write_all(fd, g_variant_get_data(state),
+                                    g_variant_get_size(state))
+       || fcntl(fd, F_ADD_SEALS, HANDOFF_SEALS | F_SEAL_SEAL) < 0)
+    {
+        gint errsv = errno;
+
+        if(fd >= 0)
+            close(fd);
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errsv),
+                    "Unable to save the daemon's state: %s",
+                    g_strerror(errsv));
+        fd = -1;
+    }
+
+    g_variant_unref(state);
+
+    return fd;
+#else
+    if(state)
+        g_variant_unref(g_variant_ref_sink(state));
+    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                "Handing over state is not supported on this system");
+    return -1;
+#endif
+}
+
+/* maps the state in |fd|, which stays the caller's; the a{sv} keeps
+ * the mapping alive for as long as it's around */
+GVariant *
+blconf_handoff_read(gint fd,
+                    GError **error)
+{
+#ifdef HAVE_SEALED_MEMFD
+    const HandoffHeader *header;
+    GMappedFile *mmap_file;
+    GBytes *bytes, *data;
+    GVariant *state;
+    gint seals;
+
+    /* without these, the sender could pull the pages out from under
+     * us while we read them */
+    seals = fcntl(fd, F_GET_SEALS);
+    if(seals < 0 || (seals & HANDOFF_SEALS) != HANDOFF_SEALS) {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "The state handed over is not sealed");
+        return NULL;
+    }
+
+    mmap_file = g_mapped_file_new_from_fd(fd, FALSE, error);
+    if(!mmap_file)
+        return NULL;
+
+    bytes = g_mapped_file_get_bytes(mmap_file);
+    g_mapped_file_unref(mmap_file);
+
+    header = g_bytes_get_data(bytes, NULL);
+    if(g_bytes_get_size(bytes) < sizeof(HandoffHeader)
+       || header->magic != HANDOFF_MAGIC
+       || header->format != HANDOFF_FORMAT
+       || header->data_size != g_bytes_get_size(bytes) - sizeof(HandoffHeader))
+    {
+        g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                    "The state handed over is not in a known format");
+        g_bytes_unref(bytes);
+        return NULL;
+    }
+
+    data = g_bytes_new_from_bytes(bytes, sizeof(HandoffHeader),
+                                  header->data_size);
+    state = g_variant_new_from_bytes(G_VARIANT_TYPE_VARDICT, data, FALSE);
+    g_bytes_unref(data);
+    g_bytes_unref(bytes);
+
+    return g_variant_ref_sink(state);
+#else
+    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                "Handing over state is not supported on this system");
+    return NULL;
+#endif
+}
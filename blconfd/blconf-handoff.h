@@ -0,0 +1,32 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_HANDOFF_H__
+#define __BLCONF_HANDOFF_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL gint blconf_handoff_write(GVariant *state,
+                                          GError **error);
+G_GNUC_INTERNAL GVariant *blconf_handoff_read(gint fd,
+                                              GError **error);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_HANDOFF_H__ */
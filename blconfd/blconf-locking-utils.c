@@ -37,97 +37,132 @@
 #include <string.h>
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
 #include "blconf-locking-utils.h"
 
-/* group cache stuff */
+/* group cache stuff: the names of the groups the user is in.  only
+ * the user's own groups are looked up, which on directory-backed
+ * systems is far cheaper than walking every group there is */
 
 static time_t etc_group_mtime = 0;
-static GHashTable *group_cache = NULL;
+static GHashTable *user_groups = NULL;
 
 static void
-blconf_ensure_group_cache(void)
+blconf_ensure_user_groups(const gchar *user)
 {
     gboolean needs_rebuild = FALSE;
     struct stat st;
+#ifdef HAVE_GETGROUPLIST
+    gid_t *groups;
+    gint n_groups = 32, n_alloced, i;
+#else
     struct group *gr;
-    GHashTable *members;
-        
+#endif
+
     if(!stat("/etc/group", &st)) {
         if(st.st_mtime > etc_group_mtime) {
             etc_group_mtime = st.st_mtime;
             needs_rebuild = TRUE;
         }
     } else
-        needs_rebuild = TRUE;        
-    
-    if(!needs_rebuild && group_cache)
+        needs_rebuild = TRUE;
+
+    if(!needs_rebuild && user_groups)
         return;
-    
-    if(group_cache)
-        g_hash_table_destroy(group_cache);
-    
-    group_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                        (GDestroyNotify)g_free,
-                                        (GDestroyNotify)g_hash_table_destroy);
-    
+
+    if(user_groups)
+        g_hash_table_destroy(user_groups);
+
+    user_groups = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        (GDestroyNotify)g_free, NULL);
+
+#ifdef HAVE_GETGROUPLIST
+    groups = g_new(gid_t, n_groups);
+    n_alloced = n_groups;
+    while(getgrouplist(user, getgid(), groups, &n_groups) < 0) {
+        /* |n_groups| now says how many there are, but not everywhere */
+        n_alloced = MAX(n_groups, n_alloced * 2);
+        n_groups = n_alloced;
+        groups = g_renew(gid_t, groups, n_alloced);
+    }
+
+    for(i = 0; i < n_groups; ++i) {
+        struct group *gr = getgrgid(groups[i]);
+
+        if(gr)
+            g_hash_table_replace(user_groups, g_strdup(gr->gr_name),
+                                 GINT_TO_POINTER(1));
+    }
+    g_free(groups);
+#else
     for(setgrent(), gr = getgrent(); gr; gr = getgrent()) {
         gint i;
-        
-        members = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                        (GDestroyNotify)g_free, NULL);
-        
+
         for(i = 0; gr->gr_mem[i]; ++i) {
-            g_hash_table_replace(members, g_strdup(gr->gr_mem[i]),
-                                 GINT_TO_POINTER(1));
+            if(!strcmp(gr->gr_mem[i], user)) {
+                g_hash_table_replace(user_groups, g_strdup(gr->gr_name),
+                                     GINT_TO_POINTER(1));
+                break;
+            }
         }
-        
-        g_hash_table_replace(group_cache, g_strdup(gr->gr_name), members);
     }
+    endgrent();
+#endif
 }
 
 static gboolean
 blconf_user_is_in_group(const gchar *user,
-                        const gchar *group)
+                        const gchar *group,
+                        gsize group_len)
 {
-    GHashTable *members;
-    
-    blconf_ensure_group_cache();
-    
-    members = g_hash_table_lookup(group_cache, group);
-    
-    if(G_UNLIKELY(!members))
-        return FALSE;
-    
-    return g_hash_table_lookup(members, user) ? TRUE : FALSE;
+    gchar buf[256];
+    gchar *group_name;
+    gboolean ret;
+
+    blconf_ensure_user_groups(user);
+
+    if(group_len < sizeof(buf)) {
+        memcpy(buf, group, group_len);
+        buf[group_len] = 0;
+        group_name = buf;
+    } else
+        group_name = g_strndup(group, group_len);
+
+    ret = g_hash_table_lookup(user_groups, group_name) ? TRUE : FALSE;
+
+    if(group_name != buf)
+        g_free(group_name);
+
+    return ret;
 }
 
 gboolean
 blconf_user_is_in_list(const gchar *list)
 {
-    gboolean ret = FALSE;
     const gchar *user_name = g_get_user_name();
-    gchar **tokens;
-    gint i;
-    
-    tokens = g_strsplit(list, ";", -1);
-    
-    for(i = 0; tokens[i]; ++i) {
-        if(!*tokens[i])
+    gsize user_len = strlen(user_name);
+    const gchar *token, *end;
+
+    /* walk the ';'-separated tokens in place */
+    for(token = list; *token; token = *end ? end + 1 : end) {
+        gsize len;
+
+        end = strchr(token, ';');
+        if(!end)
+            end = token + strlen(token);
+        len = end - token;
+
+        if(!len)
             continue;
-        else if(*tokens[i] == '@') {
-            if(blconf_user_is_in_group(user_name, tokens[i]+1)) {
-                ret = TRUE;
-                break;
-            }
-        } else {
-            if(!strcmp(user_name, tokens[i])) {
-                ret = TRUE;
-                break;
-            }
-        }
+        else if(*token == '@') {
+            if(blconf_user_is_in_group(user_name, token + 1, len - 1))
+                return TRUE;
+        } else if(len == user_len && !memcmp(token, user_name, len))
+            return TRUE;
     }
-    
-    g_strfreev(tokens);
-    
-    return ret;
+
+    return FALSE;
 }
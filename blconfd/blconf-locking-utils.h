@@ -24,8 +24,6 @@
 
 G_BEGIN_DECLS
 
-#define  BLCONF_DBUS_TYPE_G_DOUBLE_ARRAY  (dbus_g_type_get_collection("GArray", G_TYPE_DOUBLE))
-
 G_GNUC_INTERNAL gboolean blconf_user_is_in_list(const gchar *list);
 
 G_END_DECLS
@@ -0,0 +1,595 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A small streaming tokenizer for the subset of XML our config files
+ * use: elements with quoted attributes, the standard entities and
+ * character references, comments, processing instructions and a
+ * DOCTYPE we skip.  Text content is ignored, the same way a
+ * GMarkupParser without a text handler ignores it.
+ *
+ * It works directly on the (usually mapped) file buffer.  Element
+ * and attribute names are copied into one scratch buffer that is
+ * reused for every element, so parsing a file doesn't allocate per
+ * element.  Attribute values are handed out as spans: one without
+ * entities points right into the document, only the others are
+ * unescaped into the scratch buffer.  The callbacks look like the
+ * GMarkupParser ones, minus the context, and errors use the
+ * G_MARKUP_ERROR domain. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "blconf-markup.h"
+
+#define IS_SPACE(c)  ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+#define IS_NAME_CHAR(c)  (g_ascii_isalnum(c) || (c) == '-' || (c) == '_' \
+                          || (c) == ':' || (c) == '.' || ((guchar)(c)) >= 0x80)
+
+typedef struct
+{
+    const gchar *name;
+    gsize len;
+} MarkupOpenElem;
+
+/* where an attribute value ended up while the element is read */
+typedef struct
+{
+    const gchar *str;  /* NULL if it's at |offset| in the scratch buffer */
+    guint offset;
+    gsize len;
+} MarkupValue;
+
+typedef struct
+{
+    const BlconfMarkupParser *parser;
+    gpointer user_data;
+
+    const gchar *start;
+    const gchar *p;
+    const gchar *end;
+
+    GString *scratch;
+    GArray *offsets;         /* of the attribute names */
+    GArray *values;          /* MarkupValue */
+    GPtrArray *attr_names;
+    GArray *attr_values;     /* BlconfMarkupSpan */
+    GArray *open_elems;
+    gboolean seen_root;
+} MarkupState;
+
+
+static void G_GNUC_PRINTF(4, 5)
+markup_set_error(MarkupState *state,
+                 GError **error,
+                 GMarkupError code,
+                 const gchar *format,
+                 ...)
+{
+    const gchar *s;
+    gint line = 1, col = 1;
+    gchar *msg;
+    va_list args;
+
+    for(s = state->start; s < state->p && s < state->end; ++s) {
+        if(*s == '\n') {
+            ++line;
+            col = 1;
+        } else
+            ++col;
+    }
+
+    va_start(args, format);
+    msg = g_strdup_vprintf(format, args);
+    va_end(args);
+
+    g_set_error(error, G_MARKUP_ERROR, code, "Error on line %d char %d: %s",
+                line, col, msg);
+    g_free(msg);
+}
+
+static inline void
+markup_skip_space(MarkupState *state)
+{
+    while(state->p < state->end && IS_SPACE(*state->p))
+        ++state->p;
+}
+
+static gboolean
+markup_skip_past(MarkupState *state,
+                 const gchar *terminator,
+                 GError **error)
+{
+    gsize tlen = strlen(terminator);
+
+    while(state->p + tlen <= state->end) {
+        if(*state->p == *terminator && !memcmp(state->p, terminator, tlen)) {
+            state->p += tlen;
+            return TRUE;
+        }
+        ++state->p;
+    }
+
+    markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                     "Document ended unexpectedly, expected \"%s\"",
+                     terminator);
+    return FALSE;
+}
+
+/* reads the name at the current position; |name| points into the
+ * document and is not terminated */
+static gboolean
+markup_read_name(MarkupState *state,
+                 const gchar **name,
+                 gsize *len,
+                 GError **error)
+{
+    const gchar *s = state->p;
+
+    while(state->p < state->end && IS_NAME_CHAR(*state->p))
+        ++state->p;
+
+    if(state->p == s) {
+        markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                         "Expected an element or attribute name");
+        return FALSE;
+    }
+
+    *name = s;
+    *len = state->p - s;
+
+    return TRUE;
+}
+
+static gboolean
+markup_append_unescaped(MarkupState *state,
+                        const gchar *s,
+                        const gchar *stop,
+                        GError **error)
+{
+    const gchar *run = s;
+
+    while(s < stop) {
+        if(*s == '<') {
+            state->p = s;
+            markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                             "'<' is not allowed inside an attribute value");
+            return FALSE;
+        } else if(*s != '&') {
+            ++s;
+            continue;
+        }
+
+        g_string_append_len(state->scratch, run, s - run);
+
+        {
+            const gchar *semi = memchr(s, ';', stop - s);
+            gsize elen;
+
+            if(!semi) {
+                state->p = s;
+                markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                                 "Entity not terminated with ';'");
+                return FALSE;
+            }
+
+            elen = semi - s - 1;
+            if(elen == 3 && !strncmp(s + 1, "amp", 3))
+                g_string_append_c(state->scratch, '&');
+            else if(elen == 2 && !strncmp(s + 1, "lt", 2))
+                g_string_append_c(state->scratch, '<');
+            else if(elen == 2 && !strncmp(s + 1, "gt", 2))
+                g_string_append_c(state->scratch, '>');
+            else if(elen == 4 && !strncmp(s + 1, "quot", 4))
+                g_string_append_c(state->scratch, '"');
+            else if(elen == 4 && !strncmp(s + 1, "apos", 4))
+                g_string_append_c(state->scratch, '\'');
+            else if(elen >= 2 && s[1] == '#') {
+                gunichar ch = 0;
+                const gchar *d = s + 2;
+                gboolean hex = (*d == 'x');
+
+                if(hex)
+                    ++d;
+
+                if(d == semi)
+                    ch = (gunichar)-1;
+                for(; d < semi; ++d) {
+                    gint digit = hex ? g_ascii_xdigit_value(*d)
+                                     : g_ascii_digit_value(*d);
+                    if(digit < 0 || ch > 0x10ffff) {
+                        ch = (gunichar)-1;
+                        break;
+                    }
+                    ch = ch * (hex ? 16 : 10) + digit;
+                }
+
+                if(ch == 0 || !g_unichar_validate(ch)) {
+                    state->p = s;
+                    markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                                     "Invalid character reference");
+                    return FALSE;
+                }
+
+                g_string_append_unichar(state->scratch, ch);
+            } else {
+                state->p = s;
+                markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                                 "Unknown entity \"%.*s\"", (gint)elen, s + 1);
+                return FALSE;
+            }
+
+            s = run = semi + 1;
+        }
+    }
+
+    g_string_append_len(state->scratch, run, stop - run);
+
+    return TRUE;
+}
+
+static gboolean
+markup_handle_end_tag(MarkupState *state,
+                      GError **error)
+{
+    const gchar *name;
+    gsize len;
+    MarkupOpenElem *open_elem;
+    GError *error2 = NULL;
+
+    state->p += 2;  /* "</" */
+    if(!markup_read_name(state, &name, &len, error))
+        return FALSE;
+
+    markup_skip_space(state);
+    if(state->p >= state->end || *state->p != '>') {
+        markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                         "Expected '>' to close element \"%.*s\"",
+                         (gint)len, name);
+        return FALSE;
+    }
+    ++state->p;
+
+    if(!state->open_elems->len) {
+        markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                         "Element \"%.*s\" was closed, but no element is open",
+                         (gint)len, name);
+        return FALSE;
+    }
+
+    open_elem = &g_array_index(state->open_elems, MarkupOpenElem,
+                               state->open_elems->len - 1);
+    if(open_elem->len != len || memcmp(open_elem->name, name, len)) {
+        markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                         "Element \"%.*s\" was closed, but the open element is \"%.*s\"",
+                         (gint)len, name, (gint)open_elem->len, open_elem->name);
+        return FALSE;
+    }
+    g_array_set_size(state->open_elems, state->open_elems->len - 1);
+
+    if(state->parser->end_element) {
+        g_string_truncate(state->scratch, 0);
+        g_string_append_len(state->scratch, name, len);
+
+        state->parser->end_element(state->scratch->str,
+                                   state->user_data, &error2);
+        if(error2) {
+            g_propagate_error(error, error2);
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+markup_handle_start_tag(MarkupState *state,
+                        GError **error)
+{
+    const gchar *name, *attr_name;
+    gsize len, attr_len, elem_name_len;
+    gboolean self_closing = FALSE;
+    MarkupOpenElem open_elem;
+    GError *error2 = NULL;
+    guint i;
+
+    ++state->p;  /* "<" */
+    if(!markup_read_name(state, &name, &len, error))
+        return FALSE;
+
+    if(state->seen_root && !state->open_elems->len) {
+        markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                         "Extra element \"%.*s\" after the document element",
+                         (gint)len, name);
+        return FALSE;
+    }
+
+    g_string_truncate(state->scratch, 0);
+    g_string_append_len(state->scratch, name, len);
+    g_string_append_c(state->scratch, 0);
+    elem_name_len = state->scratch->len;
+    g_array_set_size(state->offsets, 0);
+    g_array_set_size(state->values, 0);
+
+    for(;;) {
+        const gchar *value;
+        gchar quote;
+        guint offset;
+        gboolean plain = TRUE;
+        MarkupValue mvalue;
+
+        markup_skip_space(state);
+        if(state->p >= state->end) {
+            markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                             "Document ended unexpectedly inside element \"%.*s\"",
+                             (gint)len, name);
+            return FALSE;
+        }
+
+        if(*state->p == '>') {
+            ++state->p;
+            break;
+        } else if(*state->p == '/') {
+            if(state->p + 1 >= state->end || state->p[1] != '>') {
+                ++state->p;
+                markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                                 "Expected '>' after '/' in element \"%.*s\"",
+                                 (gint)len, name);
+                return FALSE;
+            }
+            state->p += 2;
+            self_closing = TRUE;
+            break;
+        }
+
+        if(!markup_read_name(state, &attr_name, &attr_len, error))
+            return FALSE;
+
+        markup_skip_space(state);
+        if(state->p >= state->end || *state->p != '=') {
+            markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                             "Expected '=' after attribute \"%.*s\"",
+                             (gint)attr_len, attr_name);
+            return FALSE;
+        }
+        ++state->p;
+
+        markup_skip_space(state);
+        if(state->p >= state->end || (*state->p != '"' && *state->p != '\'')) {
+            markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                             "Expected a quoted value for attribute \"%.*s\"",
+                             (gint)attr_len, attr_name);
+            return FALSE;
+        }
+        quote = *state->p++;
+
+        value = state->p;
+        while(state->p < state->end && *state->p != quote) {
+            if(*state->p == '&' || *state->p == '<')
+                plain = FALSE;
+            ++state->p;
+        }
+        if(state->p >= state->end) {
+            markup_set_error(state, error, G_MARKUP_ERROR_PARSE,
+                             "Document ended unexpectedly in the value of attribute \"%.*s\"",
+                             (gint)attr_len, attr_name);
+            return FALSE;
+        }
+
+        offset = state->scratch->len;
+        g_array_append_val(state->offsets, offset);
+        g_string_append_len(state->scratch, attr_name, attr_len);
+        g_string_append_c(state->scratch, 0);
+
+        if(plain) {
+            mvalue.str = value;
+            mvalue.offset = 0;
+            mvalue.len = state->p - value;
+        } else {
+            mvalue.str = NULL;
+            mvalue.offset = state->scratch->len;
+            if(!markup_append_unescaped(state, value, state->p, error))
+                return FALSE;
+            mvalue.len = state->scratch->len - mvalue.offset;
+        }
+        if(!g_utf8_validate(plain ? value : state->scratch->str + mvalue.offset,
+                            mvalue.len, NULL))
+        {
+            markup_set_error(state, error, G_MARKUP_ERROR_BAD_UTF8,
+                             "Invalid UTF-8 in the value of attribute \"%.*s\"",
+                             (gint)attr_len, attr_name);
+            return FALSE;
+        }
+        g_array_append_val(state->values, mvalue);
+
+        ++state->p;  /* closing quote */
+    }
+
+    /* the scratch buffer doesn't move anymore, so the pointers can be
+     * resolved now */
+    g_ptr_array_set_size(state->attr_names, 0);
+    g_array_set_size(state->attr_values, state->values->len + 1);
+    for(i = 0; i < state->offsets->len; ++i) {
+        MarkupValue *mvalue = &g_array_index(state->values, MarkupValue, i);
+        BlconfMarkupSpan *span = &g_array_index(state->attr_values,
+                                                BlconfMarkupSpan, i);
+
+        g_ptr_array_add(state->attr_names,
+                        state->scratch->str + g_array_index(state->offsets, guint, i));
+        span->str = mvalue->str ? mvalue->str
+                                : state->scratch->str + mvalue->offset;
+        span->len = mvalue->len;
+    }
+    g_ptr_array_add(state->attr_names, NULL);
+    g_array_index(state->attr_values, BlconfMarkupSpan, i).str = NULL;
+    g_array_index(state->attr_values, BlconfMarkupSpan, i).len = 0;
+
+    state->seen_root = TRUE;
+
+    if(state->parser->start_element) {
+        state->parser->start_element(state->scratch->str,
+                                     (const gchar **)state->attr_names->pdata,
+                                     (const BlconfMarkupSpan *)state->attr_values->data,
+                                     state->user_data, &error2);
+        if(error2) {
+            g_propagate_error(error, error2);
+            return FALSE;
+        }
+    }
+
+    if(self_closing) {
+        if(state->parser->end_element) {
+            /* the element name is still at the start of the buffer */
+            g_string_truncate(state->scratch, elem_name_len - 1);
+            state->parser->end_element(state->scratch->str,
+                                       state->user_data, &error2);
+            if(error2) {
+                g_propagate_error(error, error2);
+                return FALSE;
+            }
+        }
+    } else {
+        open_elem.name = name;
+        open_elem.len = len;
+        g_array_append_val(state->open_elems, open_elem);
+    }
+
+    return TRUE;
+}
+
+/**
+ * blconf_markup_parse:
+ * @parser: Callbacks.
+ * @user_data: Passed to the callbacks.
+ * @text: The document.
+ * @text_len: Length of @text in bytes.
+ * @error: Return location for a #GError.
+ *
+ * Parses the complete document in @text, calling the callbacks in
+ * @parser as elements are opened and closed.  Parsing stops at the
+ * first syntax error or at the first error reported by a callback.
+ *
+ * Returns: %TRUE on success, %FALSE if an error occurred.
+ **/
+gboolean
+blconf_markup_parse(const BlconfMarkupParser *parser,
+                    gpointer user_data,
+                    const gchar *text,
+                    gsize text_len,
+                    GError **error)
+{
+    MarkupState state;
+    gboolean ret = FALSE;
+
+    g_return_val_if_fail(parser && text, FALSE);
+
+    memset(&state, 0, sizeof(state));
+    state.parser = parser;
+    state.user_data = user_data;
+    state.start = state.p = text;
+    state.end = text + text_len;
+    state.scratch = g_string_sized_new(256);
+    state.offsets = g_array_sized_new(FALSE, FALSE, sizeof(guint), 8);
+    state.values = g_array_sized_new(FALSE, FALSE, sizeof(MarkupValue), 8);
+    state.attr_names = g_ptr_array_sized_new(9);
+    state.attr_values = g_array_sized_new(FALSE, FALSE,
+                                          sizeof(BlconfMarkupSpan), 9);
+    state.open_elems = g_array_sized_new(FALSE, FALSE,
+                                         sizeof(MarkupOpenElem), 16);
+
+    /* skip a byte order mark */
+    if(text_len >= 3 && !memcmp(text, "\xef\xbb\xbf", 3))
+        state.p += 3;
+
+    while(state.p < state.end) {
+        if(*state.p != '<') {
+            const gchar *s = state.p;
+
+            while(state.p < state.end && *state.p != '<') {
+                if(!IS_SPACE(*state.p) && !state.open_elems->len) {
+                    markup_set_error(&state, error, G_MARKUP_ERROR_PARSE,
+                                     "Text is only allowed inside elements");
+                    goto out;
+                }
+                ++state.p;
+            }
+
+            if(state.open_elems->len && !g_utf8_validate(s, state.p - s, NULL)) {
+                markup_set_error(&state, error, G_MARKUP_ERROR_BAD_UTF8,
+                                 "Invalid UTF-8 in text content");
+                goto out;
+            }
+        } else if(state.end - state.p >= 2 && state.p[1] == '?') {
+            if(!markup_skip_past(&state, "?>", error))
+                goto out;
+        } else if(state.end - state.p >= 4 && !memcmp(state.p, "<!--", 4)) {
+            state.p += 4;
+            if(!markup_skip_past(&state, "-->", error))
+                goto out;
+        } else if(state.end - state.p >= 9 && !memcmp(state.p, "<![CDATA[", 9)) {
+            if(!state.open_elems->len) {
+                markup_set_error(&state, error, G_MARKUP_ERROR_PARSE,
+                                 "CDATA is only allowed inside elements");
+                goto out;
+            }
+            if(!markup_skip_past(&state, "]]>", error))
+                goto out;
+        } else if(state.end - state.p >= 2 && state.p[1] == '!') {
+            /* DOCTYPE and friends */
+            if(!markup_skip_past(&state, ">", error))
+                goto out;
+        } else if(state.end - state.p >= 2 && state.p[1] == '/') {
+            if(!markup_handle_end_tag(&state, error))
+                goto out;
+        } else {
+            if(!markup_handle_start_tag(&state, error))
+                goto out;
+        }
+    }
+
+    if(state.open_elems->len) {
+        MarkupOpenElem *open_elem = &g_array_index(state.open_elems,
+                                                   MarkupOpenElem,
+                                                   state.open_elems->len - 1);
+        markup_set_error(&state, error, G_MARKUP_ERROR_PARSE,
+                         "Document ended unexpectedly with element \"%.*s\" still open",
+                         (gint)open_elem->len, open_elem->name);
+        goto out;
+    } else if(!state.seen_root) {
+        markup_set_error(&state, error, G_MARKUP_ERROR_EMPTY,
+                         "Document was empty or contained only whitespace");
+        goto out;
+    }
+
+    ret = TRUE;
+
+out:
+    g_string_free(state.scratch, TRUE);
+    g_array_free(state.offsets, TRUE);
+    g_array_free(state.values, TRUE);
+    g_ptr_array_free(state.attr_names, TRUE);
+    g_array_free(state.attr_values, TRUE);
+    g_array_free(state.open_elems, TRUE);
+
+    return ret;
+}
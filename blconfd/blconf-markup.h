@@ -0,0 +1,52 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_MARKUP_H__
+#define __BLCONF_MARKUP_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* an attribute value; it is not nul-terminated */
+typedef struct
+{
+    const gchar *str;
+    gsize len;
+} BlconfMarkupSpan;
+
+typedef struct
+{
+    void (*start_element)(const gchar *element_name,
+                          const gchar **attribute_names,
+                          const BlconfMarkupSpan *attribute_values,
+                          gpointer user_data,
+                          GError **error);
+    void (*end_element)(const gchar *element_name,
+                        gpointer user_data,
+                        GError **error);
+} BlconfMarkupParser;
+
+G_GNUC_INTERNAL gboolean blconf_markup_parse(const BlconfMarkupParser *parser,
+                                             gpointer user_data,
+                                             const gchar *text,
+                                             gsize text_len,
+                                             GError **error);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_MARKUP_H__ */
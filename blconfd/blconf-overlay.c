@@ -0,0 +1,296 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A merged view of each channel across all backends.  With more than
+ * one backend, a read used to walk the list, asking each backend in
+ * turn and throwing away a GError for every one that didn't have the
+ * property.  The overlay flattens the layers once (earlier backends
+ * win) and keeps the result until a backend reports a change on the
+ * channel, so a read is a single hash lookup.  Views are only kept
+ * for channels some backend knows about; anything else goes the slow
+ * way so that random channel names can't grow the table.
+ *
+ * Reads come from the daemon's worker threads, so the table is guarded
+ * by a mutex.  It is never held while calling into a backend: a change
+ * callback invalidating a view runs with the backend's channel lock
+ * held, and would otherwise deadlock against a build.  A view built
+ * while the channel changed is simply thrown away. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "blconf-overlay.h"
+#include "blconf-backend.h"
+#include "common/blconf-gvaluefuncs.h"
+
+typedef struct
+{
+    GHashTable *properties;  /* property name -> GValue, NULL if stale */
+    guint64 version;
+} OverlayView;
+
+struct _BlconfOverlay
+{
+    GList *backends;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex lock;
+#else
+    GMutex *lock;
+#endif
+    GHashTable *views;  /* channel name -> OverlayView */
+    guint64 serial;  /* source of view versions, never reused */
+};
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define overlay_lock(overlay)    g_mutex_lock(&(overlay)->lock)
+#define overlay_unlock(overlay)  g_mutex_unlock(&(overlay)->lock)
+#else
+#define overlay_lock(overlay)    g_mutex_lock((overlay)->lock)
+#define overlay_unlock(overlay)  g_mutex_unlock((overlay)->lock)
+#endif
+
+
+static void
+overlay_view_free(OverlayView *view)
+{
+    if(view->properties)
+        g_hash_table_destroy(view->properties);
+    g_slice_free(OverlayView, view);
+}
+
+static GHashTable *
+blconf_overlay_build(BlconfOverlay *overlay,
+                     const gchar *channel)
+{
+    GHashTable *merged = NULL;
+    GList *l;
+
+    /* lowest layer first, so higher ones overwrite it */
+    for(l = g_list_last(overlay->backends); l; l = l->prev) {
+        GHashTable *props = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                  (GDestroyNotify)g_free,
+                                                  (GDestroyNotify)_blconf_gvalue_free);
+        GHashTableIter iter;
+        gpointer key, value;
+
+        if(blconf_backend_get_all(l->data, channel, "", props, NULL)) {
+            if(!merged) {
+                merged = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               (GDestroyNotify)g_free,
+                                               (GDestroyNotify)_blconf_gvalue_free);
+            }
+
+            /* backends hand out copies, so just take them over */
+            g_hash_table_iter_init(&iter, props);
+            while(g_hash_table_iter_next(&iter, &key, &value)) {
+                g_hash_table_iter_steal(&iter);
+                g_hash_table_replace(merged, key, value);
+            }
+        }
+
+        g_hash_table_destroy(props);
+    }
+
+    return merged;
+}
+
+/* returns the channel's view with the lock held, or NULL with it
+ * released if no backend knows the channel */
+static GHashTable *
+blconf_overlay_lock_view(BlconfOverlay *overlay,
+                         const gchar *channel)
+{
+    OverlayView *view;
+    GHashTable *properties;
+    guint64 version;
+
+    overlay_lock(overlay);
+
+    for(;;) {
+        view = g_hash_table_lookup(overlay->views, channel);
+        if(G_LIKELY(view && view->properties))
+            return view->properties;
+
+        /* an empty view catches invalidations while we build */
+        if(!view) {
+            view = g_slice_new0(OverlayView);
+            view->version = ++overlay->serial;
+            g_hash_table_insert(overlay->views, g_strdup(channel), view);
+        }
+        version = view->version;
+        overlay_unlock(overlay);
+
+        properties = blconf_overlay_build(overlay, channel);
+
+        overlay_lock(overlay);
+        view = g_hash_table_lookup(overlay->views, channel);
+
+        if(!properties) {
+            if(view && !view->properties)
+                g_hash_table_remove(overlay->views, channel);
+            overlay_unlock(overlay);
+            return NULL;
+        }
+
+        if(view && view->version == version && !view->properties)
+            view->properties = properties;
+        else {
+            /* changed while we were building; try again */
+            g_hash_table_destroy(properties);
+        }
+    }
+}
+
+
+
+BlconfOverlay *
+blconf_overlay_new(GList *backends)
+{
+    BlconfOverlay *overlay = g_slice_new0(BlconfOverlay);
+
+    overlay->backends = backends;
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_init(&overlay->lock);
+#else
+    overlay->lock = g_mutex_new();
+#endif
+    overlay->views = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free,
+                                           (GDestroyNotify)overlay_view_free);
+
+    return overlay;
+}
+
+void
+blconf_overlay_free(BlconfOverlay *overlay)
+{
+    if(!overlay)
+        return;
+
+    g_hash_table_destroy(overlay->views);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_clear(&overlay->lock);
+#else
+    g_mutex_free(overlay->lock);
+#endif
+    g_slice_free(BlconfOverlay, overlay);
+}
+
+/* copies the property's value into the unset |value|.  returns FALSE
+ * both for a missing property and for a channel no backend knows
+ * about; use blconf_overlay_get_all() to tell them apart. */
+gboolean
+blconf_overlay_lookup(BlconfOverlay *overlay,
+                      const gchar *channel,
+                      const gchar *property,
+                      GValue *value)
+{
+    GHashTable *properties = blconf_overlay_lock_view(overlay, channel);
+    const GValue *found;
+
+    if(!properties)
+        return FALSE;
+
+    found = g_hash_table_lookup(properties, property);
+    if(found)
+        g_value_copy(found, g_value_init(value, G_VALUE_TYPE(found)));
+
+    overlay_unlock(overlay);
+
+    return found != NULL;
+}
+
+/* stores copies of everything under |property_base| in |properties|.
+ * returns FALSE only if no backend has the channel. */
+gboolean
+blconf_overlay_get_all(BlconfOverlay *overlay,
+                       const gchar *channel,
+                       const gchar *property_base,
+                       GHashTable *properties)
+{
+    GHashTable *view = blconf_overlay_lock_view(overlay, channel);
+    GHashTableIter iter;
+    gpointer key, value;
+    gsize base_len;
+
+    if(!view)
+        return FALSE;
+
+    if(property_base[0] == '/' && !property_base[1])
+        property_base = "";
+    base_len = strlen(property_base);
+
+    g_hash_table_iter_init(&iter, view);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        const gchar *name = key;
+        GValue *copy;
+
+        if(base_len && (strncmp(name, property_base, base_len)
+                        || (name[base_len] && name[base_len] != '/')))
+        {
+            continue;
+        }
+
+        copy = g_new0(GValue, 1);
+        g_value_copy(value, g_value_init(copy, G_VALUE_TYPE(value)));
+        g_hash_table_insert(properties, g_strdup(name), copy);
+    }
+
+    overlay_unlock(overlay);
+
+    return TRUE;
+}
+
+void
+blconf_overlay_invalidate(BlconfOverlay *overlay,
+                          const gchar *channel)
+{
+    OverlayView *view;
+    GHashTable *stale = NULL;
+
+    overlay_lock(overlay);
+    view = g_hash_table_lookup(overlay->views, channel);
+    if(view) {
+        stale = view->properties;
+        view->properties = NULL;
+        view->version = ++overlay->serial;
+    }
+    overlay_unlock(overlay);
+
+    if(stale)
+        g_hash_table_destroy(stale);
+}
+
+guint64
+blconf_overlay_get_version(BlconfOverlay *overlay,
+                           const gchar *channel)
+{
+    OverlayView *view;
+    guint64 version;
+
+    overlay_lock(overlay);
+    view = g_hash_table_lookup(overlay->views, channel);
+    version = view ? view->version : 0;
+    overlay_unlock(overlay);
+
+    return version;
+}
@@ -0,0 +1,46 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_OVERLAY_H__
+#define __BLCONF_OVERLAY_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BlconfOverlay  BlconfOverlay;
+
+G_GNUC_INTERNAL BlconfOverlay *blconf_overlay_new(GList *backends);
+G_GNUC_INTERNAL void blconf_overlay_free(BlconfOverlay *overlay);
+
+G_GNUC_INTERNAL gboolean blconf_overlay_lookup(BlconfOverlay *overlay,
+                                               const gchar *channel,
+                                               const gchar *property,
+                                               GValue *value);
+G_GNUC_INTERNAL gboolean blconf_overlay_get_all(BlconfOverlay *overlay,
+                                                const gchar *channel,
+                                                const gchar *property_base,
+                                                GHashTable *properties);
+
+G_GNUC_INTERNAL void blconf_overlay_invalidate(BlconfOverlay *overlay,
+                                               const gchar *channel);
+G_GNUC_INTERNAL guint64 blconf_overlay_get_version(BlconfOverlay *overlay,
+                                                   const gchar *channel);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_OVERLAY_H__ */
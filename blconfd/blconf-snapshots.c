@@ -0,0 +1,377 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Read-only channel snapshots shared with the clients.  Rather than
+ * every process on the desktop pulling the same theme and font
+ * settings over the bus at startup, the daemon serializes a channel
+ * once into a sealed memfd and passes the fd along; clients map it
+ * and read from the shared pages.  Snapshots are immutable: a change
+ * to the channel just drops the current one, and the next request
+ * builds a new one with a higher serial.  Clients never need to see
+ * the serial go up, since they get the change signals anyway and
+ * apply them on top of the snapshot they have.
+ *
+ * Like the overlay, the table's lock is never held while building a
+ * snapshot.  One built while the channel changed is still handed to
+ * the client that asked for it (the signals for the change follow the
+ * reply), but isn't kept for anyone else. */
+
+/* for memfd_create() and the sealing fcntl()s */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ERRNO_H
+#include <errno.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <gio/gio.h>
+
+#include "blconf-snapshots.h"
+#include "common/blconf-gvaluefuncs.h"
+#include "common/blconf-snapshot.h"
+
+#if defined(HAVE_MEMFD_CREATE) && defined(MFD_ALLOW_SEALING) && defined(F_ADD_SEALS)
+#define HAVE_SEALED_MEMFD 1
+#endif
+
+typedef struct
+{
+    gint fd;  /* -1 if there is no current snapshot */
+    guint64 serial;
+} ChannelSnapshot;
+
+struct _BlconfSnapshots
+{
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    GMutex lock;
+#else
+    GMutex *lock;
+#endif
+    GHashTable *channels;  /* lowercased channel name -> ChannelSnapshot */
+    guint64 serial;
+};
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+#define snapshots_lock(snapshots)    g_mutex_lock(&(snapshots)->lock)
+#define snapshots_unlock(snapshots)  g_mutex_unlock(&(snapshots)->lock)
+#else
+#define snapshots_lock(snapshots)    g_mutex_lock((snapshots)->lock)
+#define snapshots_unlock(snapshots)  g_mutex_unlock((snapshots)->lock)
+#endif
+
+
+static void
+channel_snapshot_free(ChannelSnapshot *snapshot)
+{
+    if(snapshot->fd >= 0)
+        close(snapshot->fd);
+    g_slice_free(ChannelSnapshot, snapshot);
+}
+
+#ifdef HAVE_SEALED_MEMFD
+static gint
+blconf_snapshots_compare_names(gconstpointer a,
+                               gconstpointer b)
+{
+    return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+static gboolean
+blconf_snapshots_write_all(gint fd,
+                           const guint8 *data,
+                           gsize len)
+{
+    while(len) {
+        gssize ret = write(fd, data, len);
+
+        if(ret < 0) {
+            if(errno == EINTR)
+                continue;
+            return FALSE;
+        }
+        data += ret;
+        len -= ret;
+    }
+
+    return TRUE;
+}
+#endif
+
+static gint
+blconf_snapshots_create(const gchar *channel,
+                        guint64 serial,
+                        GHashTable *properties,
+                        GError **error)
+{
+#ifdef HAVE_SEALED_MEMFD
+    static const guint8 padding[8] = { 0, };
+    BlconfSnapshotHeader header;
+    GVariantBuilder builder;
+    GVariant *dict;
+    GPtrArray *names;
+    GHashTableIter iter;
+    gpointer key;
+    gchar *memfd_name;
+    gint fd;
+    guint i;
+
+    /* sorted, so that clients can binary search the array */
+    names = g_ptr_array_sized_new(g_hash_table_size(properties));
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &key, NULL))
+        g_ptr_array_add(names, key);
+    g_ptr_array_sort(names, blconf_snapshots_compare_names);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+    for(i = 0; i < names->len; ++i) {
+        const gchar *name = g_ptr_array_index(names, i);
+        GVariant *variant = _blconf_gvalue_to_gvariant(g_hash_table_lookup(properties,
+                                                                           name));
+
+        if(variant)
+            g_variant_builder_add(&builder, "{sv}", name, variant);
+    }
+    dict = g_variant_ref_sink(g_variant_builder_end(&builder));
+    g_ptr_array_free(names, TRUE);
+
+    memset(&header, 0, sizeof(header));
+    header.magic = BLCONF_SNAPSHOT_MAGIC;
+    header.format = BLCONF_SNAPSHOT_FORMAT;
+    header.serial = serial;
+    header.data_size = g_variant_get_size(dict);
+
+    memfd_name = g_strdup_printf("blconf-%s", channel);
+    fd = memfd_create(memfd_name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    g_free(memfd_name);
+
+    if(fd < 0
+       || !blconf_snapshots_write_all(fd, (const guint8 *)&header,
+                                      sizeof(header))
+       || !blconf_snapshots_write_all(fd, padding,
+                                      BLCONF_SNAPSHOT_DATA_OFFSET - sizeof(header))
+       || !blconf_snapshots_write_all(fd, g_variant_get_data(dict),
+                                      g_variant_get_size(dict))
+       || fcntl(fd, F_ADD_SEALS,
+                F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0)
+    {
+        gint errsv = errno;
+
+        if(fd >= 0)
+            close(fd);
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errsv),
+                    "Unable to create snapshot of channel \"%s\": %s",
+                    channel, g_strerror(errsv));
+        fd = -1;
+    }
+
+    g_variant_unref(dict);
+
+    return fd;
+#else
+    g_set_error(error, G_DBUS_ERROR, G_DBUS_ERROR_NOT_SUPPORTED,
+                "Channel snapshots are not supported on this system");
+    return -1;
+#endif
+}
+
+
+
+BlconfSnapshots *
+blconf_snapshots_new(void)
+{
+    BlconfSnapshots *snapshots = g_slice_new0(BlconfSnapshots);
+
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_init(&snapshots->lock);
+#else
+    snapshots->lock = g_mutex_new();
+#endif
+    snapshots->channels = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                (GDestroyNotify)g_free,
+                                                (GDestroyNotify)channel_snapshot_free);
+
+    return snapshots;
+}
+
+void
+blconf_snapshots_free(BlconfSnapshots *snapshots)
+{
+    if(!snapshots)
+        return;
+
+    g_hash_table_destroy(snapshots->channels);
+#if GLIB_CHECK_VERSION (2, 32, 0)
+    g_mutex_clear(&snapshots->lock);
+#else
+    g_mutex_free(snapshots->lock);
+#endif
+    g_slice_free(BlconfSnapshots, snapshots);
+}
+
+/* returns a new fd for the channel's current snapshot, or -1 if there
+ * is none.  either way, |*serial| is set to the serial of the current
+ * snapshot, or of the one blconf_snapshots_publish() should build, and
+ * is to be passed on to it or blconf_snapshots_discard(). */
+gint
+blconf_snapshots_get(BlconfSnapshots *snapshots,
+                     const gchar *channel,
+                     guint64 *serial)
+{
+    ChannelSnapshot *snapshot;
+    gchar *key = g_ascii_strdown(channel, -1);
+    gint fd = -1;
+
+    snapshots_lock(snapshots);
+
+    snapshot = g_hash_table_lookup(snapshots->channels, key);
+    if(!snapshot) {
+        /* an empty entry, so that changes made while the snapshot is
+         * being built are noticed */
+        snapshot = g_slice_new(ChannelSnapshot);
+        snapshot->fd = -1;
+        snapshot->serial = ++snapshots->serial;
+        g_hash_table_insert(snapshots->channels, key, snapshot);
+        key = NULL;
+    } else if(snapshot->fd >= 0)
+        fd = dup(snapshot->fd);
+    *serial = snapshot->serial;
+
+    snapshots_unlock(snapshots);
+
+    g_free(key);
+
+    return fd;
+}
+
+/* builds a snapshot of |properties| and returns a new fd for it.  it
+ * is kept for later callers only if the channel hasn't changed since
+ * blconf_snapshots_get() returned |serial|. */
+gint
+blconf_snapshots_publish(BlconfSnapshots *snapshots,
+                         const gchar *channel,
+                         guint64 serial,
+                         GHashTable *properties,
+                         GError **error)
+{
+    ChannelSnapshot *snapshot;
+    gchar *key;
+    gint fd;
+
+    fd = blconf_snapshots_create(channel, serial, properties, error);
+    if(fd < 0) {
+        blconf_snapshots_discard(snapshots, channel, serial);
+        return -1;
+    }
+
+    key = g_ascii_strdown(channel, -1);
+    snapshots_lock(snapshots);
+
+    snapshot = g_hash_table_lookup(snapshots->channels, key);
+    if(snapshot && snapshot->serial == serial) {
+        if(snapshot->fd < 0) {
+            snapshot->fd = fd;
+            fd = dup(fd);
+        } else {
+            /* somebody else was quicker */
+            close(fd);
+            fd = dup(snapshot->fd);
+        }
+    }
+
+    snapshots_unlock(snapshots);
+    g_free(key);
+
+    if(fd < 0) {
+        g_set_error(error, G_IO_ERROR, g_io_error_from_errno(errno),
+                    "Unable to create snapshot of channel \"%s\": %s",
+                    channel, g_strerror(errno));
+    }
+
+    return fd;
+}
+
+/* drops the empty entry blconf_snapshots_get() made for a channel that
+ * turned out not to exist, so random names can't grow the table */
+void
+blconf_snapshots_discard(BlconfSnapshots *snapshots,
+                         const gchar *channel,
+                         guint64 serial)
+{
+    ChannelSnapshot *snapshot;
+    gchar *key = g_ascii_strdown(channel, -1);
+
+    snapshots_lock(snapshots);
+
+    snapshot = g_hash_table_lookup(snapshots->channels, key);
+    if(snapshot && snapshot->serial == serial && snapshot->fd < 0)
+        g_hash_table_remove(snapshots->channels, key);
+
+    snapshots_unlock(snapshots);
+
+    g_free(key);
+}
+
+void
+blconf_snapshots_invalidate(BlconfSnapshots *snapshots,
+                            const gchar *channel)
+{
+    ChannelSnapshot *snapshot;
+    gchar *key = g_ascii_strdown(channel, -1);
+    gint fd = -1;
+
+    snapshots_lock(snapshots);
+
+    snapshot = g_hash_table_lookup(snapshots->channels, key);
+    if(snapshot) {
+        fd = snapshot->fd;
+        snapshot->fd = -1;
+        snapshot->serial = ++snapshots->serial;
+    }
+
+    snapshots_unlock(snapshots);
+
+    /* clients that mapped it keep their copy */
+    if(fd >= 0)
+        close(fd);
+
+    g_free(key);
+}
@@ -0,0 +1,47 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_SNAPSHOTS_H__
+#define __BLCONF_SNAPSHOTS_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BlconfSnapshots  BlconfSnapshots;
+
+G_GNUC_INTERNAL BlconfSnapshots *blconf_snapshots_new(void);
+G_GNUC_INTERNAL void blconf_snapshots_free(BlconfSnapshots *snapshots);
+
+G_GNUC_INTERNAL gint blconf_snapshots_get(BlconfSnapshots *snapshots,
+                                          const gchar *channel,
+                                          guint64 *serial);
+G_GNUC_INTERNAL gint blconf_snapshots_publish(BlconfSnapshots *snapshots,
+                                              const gchar *channel,
+                                              guint64 serial,
+                                              GHashTable *properties,
+                                              GError **error);
+G_GNUC_INTERNAL void blconf_snapshots_discard(BlconfSnapshots *snapshots,
+                                              const gchar *channel,
+                                              guint64 serial);
+
+G_GNUC_INTERNAL void blconf_snapshots_invalidate(BlconfSnapshots *snapshots,
+                                                 const gchar *channel);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_SNAPSHOTS_H__ */
@@ -0,0 +1,257 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/* Runtime statistics, for org.blade.Blconf.Stats and the dump on
+ * SIGUSR1.  Recording has to stay cheap, since it happens whether or
+ * not anyone ever looks: histograms are a few additions under a lock
+ * of their own, and signals are counted in a small table.  Keeping a table of all the
+ * clients, and measuring the size of every signal, is dearer, so that
+ * only starts the first time the stats are collected, or right away if
+ * BLCONFD_STATS is set in the environment.
+ *
+ * Everything but the histograms is only used on the main thread. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include <gio/gio.h>
+
+#include "blconf-stats.h"
+
+#define MAX_SENDERS  (1024)  /* the table starts over past this many */
+#define TOP_SENDERS  (10)
+
+typedef struct
+{
+    guint64 calls;
+    gint64 first_seen;
+} SenderStats;
+
+typedef struct
+{
+    guint64 count;
+    guint64 bytes;
+} SignalStats;
+
+/* for all the histograms: a 64-bit total can't be added to atomically
+ * everywhere, and recording is never held up by anything else */
+G_LOCK_DEFINE_STATIC(__histograms);
+
+struct _BlconfStats
+{
+    gint64 started;
+
+    gboolean detailed;
+    GHashTable *senders;  /* unique name -> SenderStats */
+
+    GHashTable *signals;  /* name -> SignalStats */
+};
+
+
+void
+blconf_histogram_record(BlconfHistogram *histogram,
+                        gint64 usec)
+{
+    guint bucket = usec > 0 ? g_bit_storage((gulong)usec) : 1;
+
+    if(bucket >= BLCONF_HISTOGRAM_BUCKETS)
+        bucket = BLCONF_HISTOGRAM_BUCKETS - 1;
+
+    G_LOCK(__histograms);
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->total += usec > 0 ? usec : 0;
+    G_UNLOCK(__histograms);
+}
+
+/* a{sv} with "count" (u), "total-usec" (t) and "buckets" (au) */
+GVariant *
+blconf_histogram_to_variant(BlconfHistogram *histogram)
+{
+    GVariantBuilder builder, buckets;
+    BlconfHistogram copy;
+    guint i;
+
+    G_LOCK(__histograms);
+    copy = *histogram;
+    G_UNLOCK(__histograms);
+
+    g_variant_builder_init(&buckets, G_VARIANT_TYPE("au"));
+    for(i = 0; i < BLCONF_HISTOGRAM_BUCKETS; ++i)
+        g_variant_builder_add(&buckets, "u", copy.buckets[i]);
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+    g_variant_builder_add(&builder, "{sv}", "count",
+                          g_variant_new_uint32(copy.count));
+    g_variant_builder_add(&builder, "{sv}", "total-usec",
+                          g_variant_new_uint64(copy.total));
+    g_variant_builder_add(&builder, "{sv}", "buckets",
+                          g_variant_builder_end(&buckets));
+
+    return g_variant_builder_end(&builder);
+}
+
+
+BlconfStats *
+blconf_stats_new(void)
+{
+    BlconfStats *stats = g_slice_new0(BlconfStats);
+
+    stats->started = g_get_monotonic_time();
+    stats->detailed = (g_getenv("BLCONFD_STATS")
+                       && strcmp(g_getenv("BLCONFD_STATS"), "0"));
+    stats->senders = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           (GDestroyNotify)g_free,
+                                           (GDestroyNotify)g_free);
+    stats->signals = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                           NULL, (GDestroyNotify)g_free);
+
+    return stats;
+}
+
+void
+blconf_stats_free(BlconfStats *stats)
+{
+    if(!stats)
+        return;
+
+    g_hash_table_destroy(stats->senders);
+    g_hash_table_destroy(stats->signals);
+    g_slice_free(BlconfStats, stats);
+}
+
+void
+blconf_stats_record_sender(BlconfStats *stats,
+                           const gchar *sender)
+{
+    SenderStats *sstats;
+
+    if(G_LIKELY(!stats->detailed) || !sender)
+        return;
+
+    sstats = g_hash_table_lookup(stats->senders, sender);
+    if(G_UNLIKELY(!sstats)) {
+        /* unique names are never reused, so clients that went away
+         * pile up; rather than aging them, just start over */
+        if(g_hash_table_size(stats->senders) >= MAX_SENDERS)
+            g_hash_table_remove_all(stats->senders);
+
+        sstats = g_new0(SenderStats, 1);
+        sstats->first_seen = g_get_monotonic_time();
+        g_hash_table_insert(stats->senders, g_strdup(sender), sstats);
+    }
+
+    sstats->calls++;
+}
+
+/* |signal_name| has to be a static string */
+void
+blconf_stats_record_signal(BlconfStats *stats,
+                           const gchar *signal_name,
+                           GVariant *parameters)
+{
+    SignalStats *sstats = g_hash_table_lookup(stats->signals, signal_name);
+
+    if(G_UNLIKELY(!sstats)) {
+        sstats = g_new0(SignalStats, 1);
+        g_hash_table_insert(stats->signals, (gpointer)signal_name, sstats);
+    }
+
+    sstats->count++;
+    if(stats->detailed && parameters)
+        sstats->bytes += g_variant_get_size(parameters);
+}
+
+typedef struct
+{
+    const gchar *name;
+    guint64 calls;
+    gdouble rate;
+} SenderRate;
+
+static gint
+blconf_stats_compare_rates(gconstpointer a,
+                           gconstpointer b)
+{
+    const SenderRate *ra = a, *rb = b;
+
+    return ra->rate > rb->rate ? -1 : (ra->rate < rb->rate ? 1 : 0);
+}
+
+/* adds "uptime-usec", "senders" (a(std): name, calls, calls per second,
+ * busiest first) and "signals" (a{s(tt)}: count, bytes) to |builder|,
+ * an a{sv} */
+void
+blconf_stats_collect(BlconfStats *stats,
+                     GVariantBuilder *builder)
+{
+    GVariantBuilder senders, signals;
+    GHashTableIter iter;
+    gpointer key, value;
+    GArray *rates;
+    gint64 now = g_get_monotonic_time();
+    guint i;
+
+    g_variant_builder_add(builder, "{sv}", "uptime-usec",
+                          g_variant_new_uint64(now - stats->started));
+
+    rates = g_array_sized_new(FALSE, FALSE, sizeof(SenderRate),
+                              g_hash_table_size(stats->senders));
+    g_hash_table_iter_init(&iter, stats->senders);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        SenderStats *sstats = value;
+        SenderRate rate;
+        gint64 elapsed = MAX(now - sstats->first_seen, G_USEC_PER_SEC);
+
+        rate.name = key;
+        rate.calls = sstats->calls;
+        rate.rate = (gdouble)sstats->calls * G_USEC_PER_SEC / elapsed;
+        g_array_append_val(rates, rate);
+    }
+    g_array_sort(rates, blconf_stats_compare_rates);
+
+    g_variant_builder_init(&senders, G_VARIANT_TYPE("a(std)"));
+    for(i = 0; i < rates->len && i < TOP_SENDERS; ++i) {
+        SenderRate *rate = &g_array_index(rates, SenderRate, i);
+
+        g_variant_builder_add(&senders, "(std)", rate->name, rate->calls,
+                              rate->rate);
+    }
+    g_array_free(rates, TRUE);
+    g_variant_builder_add(builder, "{sv}", "senders",
+                          g_variant_builder_end(&senders));
+
+    g_variant_builder_init(&signals, G_VARIANT_TYPE("a{s(tt)}"));
+    g_hash_table_iter_init(&iter, stats->signals);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        SignalStats *sstats = value;
+
+        g_variant_builder_add(&signals, "{s(tt)}", key, sstats->count,
+                              sstats->bytes);
+    }
+    g_variant_builder_add(builder, "{sv}", "signals",
+                          g_variant_builder_end(&signals));
+
+    /* from now on, somebody is interested */
+    stats->detailed = TRUE;
+}
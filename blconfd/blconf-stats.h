@@ -0,0 +1,59 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_STATS_H__
+#define __BLCONF_STATS_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define BLCONF_HISTOGRAM_BUCKETS  (24)
+
+/* durations in microseconds; bucket i counts those that need i bits,
+ * so everything from 2^(i-1) up to 2^i - 1 (and 0 goes with 1).  the
+ * last bucket takes whatever is longer.  may be updated from any
+ * thread, but only through the functions below; the all-zero struct
+ * is an empty histogram. */
+typedef struct
+{
+    guint32 count;
+    guint64 total;
+    guint32 buckets[BLCONF_HISTOGRAM_BUCKETS];
+} BlconfHistogram;
+
+G_GNUC_INTERNAL void blconf_histogram_record(BlconfHistogram *histogram,
+                                             gint64 usec);
+G_GNUC_INTERNAL GVariant *blconf_histogram_to_variant(BlconfHistogram *histogram);
+
+typedef struct _BlconfStats  BlconfStats;
+
+G_GNUC_INTERNAL BlconfStats *blconf_stats_new(void);
+G_GNUC_INTERNAL void blconf_stats_free(BlconfStats *stats);
+
+G_GNUC_INTERNAL void blconf_stats_record_sender(BlconfStats *stats,
+                                                const gchar *sender);
+G_GNUC_INTERNAL void blconf_stats_record_signal(BlconfStats *stats,
+                                                const gchar *signal_name,
+                                                GVariant *parameters);
+
+G_GNUC_INTERNAL void blconf_stats_collect(BlconfStats *stats,
+                                          GVariantBuilder *builder);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_STATS_H__ */
@@ -0,0 +1,99 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* A daemon-wide pool of refcounted strings.  Property name segments
+ * repeat a lot across channels ("enabled", "type", "size", ...), so
+ * backends keep only one copy of each.  Unlike quarks, strings go
+ * away again once the last user drops them.  The pool has one lock,
+ * so it's meant for building and tearing down trees, not for lookups
+ * on every read. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#include "blconf-string-pool.h"
+
+typedef struct
+{
+    guint refcount;
+    gchar str[1];  /* allocated to fit */
+} PoolEntry;
+
+G_LOCK_DEFINE_STATIC(__string_pool);
+static GHashTable *__string_pool = NULL;  /* string -> PoolEntry */
+
+
+/* returns the pooled copy of @str, adding a reference to it */
+const gchar *
+blconf_string_pool_ref(const gchar *str)
+{
+    PoolEntry *entry;
+    gsize len;
+
+    g_return_val_if_fail(str, NULL);
+
+    G_LOCK(__string_pool);
+
+    if(G_UNLIKELY(!__string_pool)) {
+        /* keys point into the entries, so only the values are freed */
+        __string_pool = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              NULL, g_free);
+    }
+
+    entry = g_hash_table_lookup(__string_pool, str);
+    if(entry)
+        entry->refcount++;
+    else {
+        len = strlen(str);
+        entry = g_malloc(G_STRUCT_OFFSET(PoolEntry, str) + len + 1);
+        entry->refcount = 1;
+        memcpy(entry->str, str, len + 1);
+        g_hash_table_insert(__string_pool, entry->str, entry);
+    }
+
+    G_UNLOCK(__string_pool);
+
+    return entry->str;
+}
+
+/* drops a reference taken with blconf_string_pool_ref() */
+void
+blconf_string_pool_unref(const gchar *str)
+{
+    PoolEntry *entry = NULL;
+
+    if(G_UNLIKELY(!str))
+        return;
+
+    G_LOCK(__string_pool);
+
+    if(G_LIKELY(__string_pool))
+        entry = g_hash_table_lookup(__string_pool, str);
+
+    if(G_LIKELY(entry)) {
+        if(--entry->refcount == 0)
+            g_hash_table_remove(__string_pool, entry->str);
+    } else
+        g_warning("Unreferencing string \"%s\" that isn't in the pool", str);
+
+    G_UNLOCK(__string_pool);
+}
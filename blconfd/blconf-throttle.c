@@ -0,0 +1,346 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+/* Fair scheduling of the calls coming in from different clients.  A
+ * single client writing in a tight loop would otherwise keep the
+ * daemon busy with change signals and saves, and every other client
+ * would wait behind it.
+ *
+ * Each sender gets a token bucket that refills at WRITE_RATE, holding
+ * at most WRITE_BURST tokens; a write costs one token.  A call from a
+ * sender that has run out, or that still has calls waiting, is queued
+ * on that sender, and the queues are drained round-robin as the
+ * buckets refill, a bounded number of calls per turn of the main
+ * loop.  A queued write that merely sets a property again replaces
+ * the one that was waiting, so a throttled sender only ever costs the
+ * latest value; the superseded calls are handed to the func along
+ * with the write that replaced them, and get the same answer.  Reads
+ * are queued too while a sender has writes waiting, so it never sees
+ * an older value than it wrote, but they are free.
+ *
+ * Everything here happens on the main thread. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <gio/gio.h>
+#include <libbladeutil/libbladeutil.h>
+
+#include "blconf-throttle.h"
+
+#define WRITE_RATE         (200)   /* writes per second */
+#define WRITE_BURST        (1000)
+#define MAX_QUEUED         (4096)  /* calls waiting per sender */
+#define DISPATCH_INTERVAL  (1000 / WRITE_RATE)  /* ms */
+#define DISPATCH_MAX       (64)    /* calls per dispatch */
+#define SWEEP_INTERVAL     (1024)  /* submits between sweeps */
+
+typedef struct
+{
+    GDBusMethodInvocation *invocation;
+    gpointer call_data;
+    guint cost;
+    gchar *collapse_key;  /* NULL if the call can't be collapsed */
+    GSList *superseded;  /* invocations this one replaced */
+} QueuedCall;
+
+typedef struct
+{
+    gchar *name;
+    gdouble tokens;
+    gint64 refilled;  /* monotonic time |tokens| was last updated */
+
+    GQueue calls;
+    /* collapse key -> QueuedCall; only has calls queued after the last
+     * one that couldn't be collapsed */
+    GHashTable *collapsible;
+} Sender;
+
+struct _BlconfThrottle
+{
+    BlconfThrottleFunc func;
+    gpointer user_data;
+
+    GHashTable *senders;  /* unique name -> Sender */
+    GQueue waiting;  /* Senders with calls queued, in round-robin order */
+    guint dispatch_id;
+    guint n_submits;
+};
+
+
+static void
+queued_call_free(QueuedCall *call)
+{
+    g_free(call->collapse_key);
+    g_slist_free(call->superseded);
+    g_slice_free(QueuedCall, call);
+}
+
+static Sender *
+sender_new(const gchar *name)
+{
+    Sender *sender = g_slice_new0(Sender);
+
+    sender->name = g_strdup(name);
+    sender->tokens = WRITE_BURST;
+    sender->refilled = g_get_monotonic_time();
+    g_queue_init(&sender->calls);
+    sender->collapsible = g_hash_table_new(g_str_hash, g_str_equal);
+
+    return sender;
+}
+
+static void
+sender_free(Sender *sender)
+{
+    /* the queue is always drained first, see blconf_throttle_free() */
+    g_hash_table_destroy(sender->collapsible);
+    g_free(sender->name);
+    g_slice_free(Sender, sender);
+}
+
+static void
+sender_refill(Sender *sender,
+              gint64 now)
+{
+    sender->tokens += (gdouble)(now - sender->refilled) * WRITE_RATE / G_USEC_PER_SEC;
+    if(sender->tokens > WRITE_BURST)
+        sender->tokens = WRITE_BURST;
+    sender->refilled = now;
+}
+
+static void
+blconf_throttle_run(BlconfThrottle *throttle,
+                    QueuedCall *call)
+{
+    throttle->func(call->invocation, call->superseded, call->call_data,
+                   throttle->user_data);
+
+    queued_call_free(call);
+}
+
+/* runs the next call queued on |sender|, if it can afford it */
+static gboolean
+blconf_throttle_run_next(BlconfThrottle *throttle,
+                         Sender *sender)
+{
+    QueuedCall *call = g_queue_peek_head(&sender->calls);
+
+    if(call->cost > sender->tokens)
+        return FALSE;
+
+    g_queue_pop_head(&sender->calls);
+    sender->tokens -= call->cost;
+    if(call->collapse_key
+       && g_hash_table_lookup(sender->collapsible, call->collapse_key) == call)
+    {
+        g_hash_table_remove(sender->collapsible, call->collapse_key);
+    }
+
+    blconf_throttle_run(throttle, call);
+
+    return TRUE;
+}
+
+/* a sender with a full bucket and nothing queued is the same as one
+ * we've never heard of */
+static gboolean
+blconf_throttle_sender_is_idle(gpointer key,
+                               gpointer value,
+                               gpointer data)
+{
+    Sender *sender = value;
+
+    if(!g_queue_is_empty(&sender->calls))
+        return FALSE;
+
+    sender_refill(sender, *(gint64 *)data);
+
+    return sender->tokens >= WRITE_BURST;
+}
+
+static gboolean
+blconf_throttle_dispatch(gpointer data)
+{
+    BlconfThrottle *throttle = data;
+    gint64 now = g_get_monotonic_time();
+    guint n_run = 0, n_stalled = 0;
+
+    /* one call per sender per round, until everyone left is out of
+     * tokens or this turn's share is used up.  a sender that can't
+     * run still has calls, so it always goes back in line. */
+    while(n_run < DISPATCH_MAX
+          && n_stalled < g_queue_get_length(&throttle->waiting))
+    {
+        Sender *sender = g_queue_pop_head(&throttle->waiting);
+
+        sender_refill(sender, now);
+        if(blconf_throttle_run_next(throttle, sender)) {
+            n_run++;
+            n_stalled = 0;
+        } else
+            n_stalled++;
+
+        if(!g_queue_is_empty(&sender->calls))
+            g_queue_push_tail(&throttle->waiting, sender);
+    }
+
+    if(g_queue_is_empty(&throttle->waiting)) {
+        throttle->dispatch_id = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BlconfThrottle *
+blconf_throttle_new(BlconfThrottleFunc func,
+                    gpointer user_data)
+{
+    BlconfThrottle *throttle = g_slice_new0(BlconfThrottle);
+
+    throttle->func = func;
+    throttle->user_data = user_data;
+    throttle->senders = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                              NULL,
+                                              (GDestroyNotify)sender_free);
+    g_queue_init(&throttle->waiting);
+
+    return throttle;
+}
+
+/* whatever is still queued is run right away; nothing a client sent
+ * gets lost */
+void
+blconf_throttle_free(BlconfThrottle *throttle)
+{
+    Sender *sender;
+
+    if(!throttle)
+        return;
+
+    if(throttle->dispatch_id)
+        g_source_remove(throttle->dispatch_id);
+
+    while((sender = g_queue_pop_head(&throttle->waiting))) {
+        QueuedCall *call;
+
+        while((call = g_queue_pop_head(&sender->calls)))
+            blconf_throttle_run(throttle, call);
+    }
+
+    g_hash_table_destroy(throttle->senders);
+    g_slice_free(BlconfThrottle, throttle);
+}
+
+/* runs the call now, or queues it if its sender is over its rate.
+ * |sender_name| is the caller's unique name, or for a private
+ * connection, one made up for it.  |cost| is the number of tokens the
+ * call takes; zero means it only has to wait for the sender's earlier
+ * calls.  calls with the same |collapse_key| set the same thing, so a
+ * waiting one can be replaced by a newer one; the func then gets the
+ * replaced invocations, which it has to answer as it answers the
+ * newer one, and which the throttle frees the list of afterwards.
+ * takes ownership of |collapse_key|. */
+void
+blconf_throttle_submit(BlconfThrottle *throttle,
+                       GDBusMethodInvocation *invocation,
+                       const gchar *sender_name,
+                       gpointer call_data,
+                       guint cost,
+                       gchar *collapse_key)
+{
+    const gchar *name = sender_name;
+    gint64 now = g_get_monotonic_time();
+    Sender *sender;
+    QueuedCall *call;
+
+    if(!name)
+        name = "";
+
+    if(++throttle->n_submits % SWEEP_INTERVAL == 0) {
+        g_hash_table_foreach_remove(throttle->senders,
+                                    blconf_throttle_sender_is_idle, &now);
+    }
+
+    sender = g_hash_table_lookup(throttle->senders, name);
+    if(!sender) {
+        /* a sender we'd drop right away anyway doesn't need adding */
+        if(cost == 0) {
+            throttle->func(invocation, NULL, call_data, throttle->user_data);
+            g_free(collapse_key);
+            return;
+        }
+
+        sender = sender_new(name);
+        g_hash_table_insert(throttle->senders, sender->name, sender);
+    }
+
+    sender_refill(sender, now);
+
+    if(g_queue_is_empty(&sender->calls) && cost <= sender->tokens) {
+        sender->tokens -= cost;
+        throttle->func(invocation, NULL, call_data, throttle->user_data);
+        g_free(collapse_key);
+        return;
+    }
+
+    if(collapse_key) {
+        call = g_hash_table_lookup(sender->collapsible, collapse_key);
+        if(call) {
+            call->superseded = g_slist_prepend(call->superseded,
+                                               call->invocation);
+            call->invocation = invocation;
+            call->call_data = call_data;
+            g_free(collapse_key);
+            return;
+        }
+    }
+
+    if(g_queue_get_length(&sender->calls) >= MAX_QUEUED) {
+        g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                              G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                              _("Too many requests"));
+        g_free(collapse_key);
+        return;
+    }
+
+    call = g_slice_new0(QueuedCall);
+    call->invocation = invocation;
+    call->call_data = call_data;
+    call->cost = cost;
+    call->collapse_key = collapse_key;
+
+    /* nothing queued before this may be collapsed into anything queued
+     * after it */
+    if(collapse_key)
+        g_hash_table_insert(sender->collapsible, collapse_key, call);
+    else
+        g_hash_table_remove_all(sender->collapsible);
+
+    if(g_queue_is_empty(&sender->calls))
+        g_queue_push_tail(&throttle->waiting, sender);
+    g_queue_push_tail(&sender->calls, call);
+
+    if(!throttle->dispatch_id) {
+        throttle->dispatch_id = g_timeout_add(DISPATCH_INTERVAL,
+                                              blconf_throttle_dispatch,
+                                              throttle);
+    }
+}
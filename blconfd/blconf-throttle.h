@@ -0,0 +1,46 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#ifndef __BLCONF_THROTTLE_H__
+#define __BLCONF_THROTTLE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _BlconfThrottle  BlconfThrottle;
+
+typedef void (*BlconfThrottleFunc)(GDBusMethodInvocation *invocation,
+                                   GSList *superseded,
+                                   gpointer call_data,
+                                   gpointer user_data);
+
+G_GNUC_INTERNAL BlconfThrottle *blconf_throttle_new(BlconfThrottleFunc func,
+                                                    gpointer user_data);
+G_GNUC_INTERNAL void blconf_throttle_free(BlconfThrottle *throttle);
+
+G_GNUC_INTERNAL void blconf_throttle_submit(BlconfThrottle *throttle,
+                                            GDBusMethodInvocation *invocation,
+                                            const gchar *sender_name,
+                                            gpointer call_data,
+                                            guint cost,
+                                            gchar *collapse_key);
+
+G_END_DECLS
+
+#endif  /* __BLCONF_THROTTLE_H__ */
@@ -51,17 +51,22 @@
 
 #include "blconf-daemon.h"
 #include "blconf-backend-factory.h"
+#ifdef BUILD_BLCONF_BACKEND_PERCHANNEL_XML
+#include "blconf-backend-perchannel-xml.h"
+#endif
 
 #define DEFAULT_BACKEND  "xfce-perchannel-xml"
 
 enum
 {
     SIGNAL_NONE = 0,
-    SIGNAL_RESTART,
+    SIGNAL_DUMP_STATS,
+    SIGNAL_DUMP_BACKENDS,
     SIGNAL_QUIT,
 };
 
 static int signal_pipe[2] = { -1, -1 };
+static BlconfDaemon *blconfd = NULL;
 
 static void
 sighandler(int sig)
@@ -71,7 +76,11 @@ sighandler(int sig)
     
     switch(sig) {
         case SIGUSR1:
-            sigstate = SIGNAL_RESTART;
+            sigstate = SIGNAL_DUMP_STATS;
+            break;
+
+        case SIGUSR2:
+            sigstate = SIGNAL_DUMP_BACKENDS;
             break;
         
         default:
@@ -97,8 +106,14 @@ signal_pipe_io(GIOChannel *source,
     {
         switch(sigstate)
         {
-            case SIGNAL_RESTART:
-                /* FIXME: implement */
+            case SIGNAL_DUMP_STATS:
+                if(blconfd)
+                    blconf_daemon_dump_stats(blconfd);
+                break;
+
+            case SIGNAL_DUMP_BACKENDS:
+                if(blconfd)
+                    blconf_daemon_dump_backends(blconfd);
                 break;
             
             case SIGNAL_QUIT:
@@ -119,7 +134,6 @@ main(int argc,
      char **argv)
 {
     GMainLoop *mloop;
-    BlconfDaemon *blconfd;
     GError *error = NULL;
     struct sigaction act;
     GIOChannel *signal_io;
@@ -127,17 +141,32 @@ main(int argc,
     
     GOptionContext *opt_ctx;
     gchar **backends = NULL;
+    gchar **preload = NULL;
     gboolean print_version = FALSE;
     gboolean do_daemon = FALSE;
+    gboolean replace = FALSE;
+    gboolean build_shared_defaults = FALSE;
     GOptionEntry options[] = {
         { "version", 'V', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &print_version,
             N_("Prints the blconfd version."), NULL },
         { "backends", 'b', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING_ARRAY, &backends,
             N_("Configuration backends to use.  The first backend specified " \
                "is opened read/write; the others, read-only."), NULL },
+        { "preload", 'p', G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_STRING_ARRAY, &preload,
+            N_("Channels to load in the background at startup, in addition " \
+               "to the ones the previous session used."), NULL },
+        { "replace", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &replace,
+            N_("Take over from a blconfd that is already running, along " \
+               "with the channels it has loaded."), NULL },
         { "daemon", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE, &do_daemon,
             N_("Fork into background after starting; only useful for " \
                 "testing purposes"), NULL },
+#ifdef BUILD_BLCONF_BACKEND_PERCHANNEL_XML
+        { "build-shared-defaults", 0, G_OPTION_FLAG_IN_MAIN, G_OPTION_ARG_NONE,
+            &build_shared_defaults,
+            N_("Write the system defaults every session on this machine " \
+               "shares, and exit."), NULL },
+#endif
         { NULL, 0, 0, 0, 0, NULL, NULL },
     };
 
@@ -150,6 +179,7 @@ main(int argc,
     sigaction(SIGTERM, &act, NULL);
     sigaction(SIGQUIT, &act, NULL);
     sigaction(SIGUSR1, &act, NULL);
+    sigaction(SIGUSR2, &act, NULL);
     
     act.sa_handler = SIG_IGN;
     sigaction(SIGPIPE, &act, NULL);
@@ -159,6 +189,10 @@ main(int argc,
     g_set_application_name(_("Xfce Configuration Daemon"));
     g_set_prgname(G_LOG_DOMAIN);
 
+#if !GLIB_CHECK_VERSION(2,32,0)
+    if(!g_thread_supported())
+        g_thread_init(NULL);
+#endif
 #if !GLIB_CHECK_VERSION(2,36,0)
     g_type_init();
 #endif
@@ -181,6 +215,18 @@ main(int argc,
         g_print("Blconfd " VERSION "\n");
         return EXIT_SUCCESS;
     }
+
+#ifdef BUILD_BLCONF_BACKEND_PERCHANNEL_XML
+    if(build_shared_defaults) {
+        if(!blconf_backend_perchannel_xml_build_shared_defaults(&error)) {
+            g_printerr(_("Unable to write the shared defaults: %s\n"),
+                       error->message);
+            g_error_free(error);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+#endif
     
     mloop = g_main_loop_new(NULL, FALSE);
     
@@ -209,7 +255,7 @@ main(int argc,
         backends[0] = g_strdup(DEFAULT_BACKEND);
     }
     
-    blconfd = blconf_daemon_new_unique(backends, &error);
+    blconfd = blconf_daemon_new_unique(backends, replace, &error);
     if(!blconfd) {
         g_critical("Blconfd failed to start: %s\n", error->message);
         g_error_free(error);
@@ -231,10 +277,16 @@ main(int argc,
 
         close(fileno(stdout));
     }
+
+    /* after the fork, since this may start threads; it doesn't wait
+     * for them, so the first calls are answered right away */
+    blconf_daemon_preload(blconfd, preload);
+    g_strfreev(preload);
     
     g_main_loop_run(mloop);
     
     g_object_unref(G_OBJECT(blconfd));
+    blconfd = NULL;
 
     blconf_backend_factory_cleanup();
     
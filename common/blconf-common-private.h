@@ -21,9 +21,13 @@
 #ifndef __BLCONF_COMMON_PRIVATE_H__
 #define __BLCONF_COMMON_PRIVATE_H__
 
-#include <dbus/dbus-glib.h>
+#include <glib-object.h>
 
-#define BLCONF_TYPE_G_VALUE_ARRAY  (dbus_g_type_get_collection("GPtrArray", G_TYPE_VALUE))
+#define BLCONF_TYPE_G_VALUE_ARRAY  (_blconf_value_array_get_type())
+#define BLCONF_TYPE_PACKED_ARRAY   (_blconf_packed_array_get_type())
+
+G_GNUC_INTERNAL GType _blconf_value_array_get_type(void) G_GNUC_CONST;
+G_GNUC_INTERNAL GType _blconf_packed_array_get_type(void) G_GNUC_CONST;
 
 #define I_(string) (g_intern_static_string((string)))
 
@@ -22,10 +22,24 @@
 #include <config.h>
 #endif
 
+#include <gio/gio.h>
+
 #include "blconf/blconf-errors.h"
 #include "blconf-alias.h"
 
-static GQuark blconf_error_quark = 0;
+static const GDBusErrorEntry blconf_error_entries[] = {
+    { BLCONF_ERROR_UNKNOWN, "org.blade.Blconf.Error.Unknown" },
+    { BLCONF_ERROR_CHANNEL_NOT_FOUND, "org.blade.Blconf.Error.ChannelNotFound" },
+    { BLCONF_ERROR_PROPERTY_NOT_FOUND, "org.blade.Blconf.Error.PropertyNotFound" },
+    { BLCONF_ERROR_READ_FAILURE, "org.blade.Blconf.Error.ReadFailure" },
+    { BLCONF_ERROR_WRITE_FAILURE, "org.blade.Blconf.Error.WriteFailure" },
+    { BLCONF_ERROR_PERMISSION_DENIED, "org.blade.Blconf.Error.PermissionDenied" },
+    { BLCONF_ERROR_INTERNAL_ERROR, "org.blade.Blconf.Error.InternalError" },
+    { BLCONF_ERROR_NO_BACKEND, "org.blade.Blconf.Error.NoBackend" },
+    { BLCONF_ERROR_INVALID_PROPERTY, "org.blade.Blconf.Error.InvalidProperty" },
+    { BLCONF_ERROR_INVALID_CHANNEL, "org.blade.Blconf.Error.InvalidChannel" },
+    { BLCONF_ERROR_CONFLICT, "org.blade.Blconf.Error.Conflict" },
+};
 
 /**
  * BLCONF_ERROR:
@@ -48,13 +62,19 @@ static GQuark blconf_error_quark = 0;
  * BLCONF_ERROR domain.
  **/
 
+/* registering the domain with GDBus lets errors cross the bus in both
+ * directions as BLCONF_ERROR, named after the enum nicks below */
 GQuark
 blconf_get_error_quark(void)
 {
-    if(!blconf_error_quark)
-        blconf_error_quark = g_quark_from_static_string("blconf-error-quark");
-    
-    return blconf_error_quark;
+    static volatile gsize blconf_error_quark = 0;
+
+    g_dbus_error_register_error_domain("blconf-error-quark",
+                                       &blconf_error_quark,
+                                       blconf_error_entries,
+                                       G_N_ELEMENTS(blconf_error_entries));
+
+    return (GQuark)blconf_error_quark;
 }
 
 /* unfortunately glib-mkenums can't generate types that are compatible with
@@ -77,6 +97,7 @@ blconf_error_get_type(void)
             { BLCONF_ERROR_NO_BACKEND, "BLCONF_ERROR_NO_BACKEND", "NoBackend" },
             { BLCONF_ERROR_INVALID_PROPERTY, "BLCONF_ERROR_INVALID_PROPERTY", "InvalidProperty" },
             { BLCONF_ERROR_INVALID_CHANNEL, "BLCONF_ERROR_INVALID_CHANNEL", "InvalidChannel" },
+            { BLCONF_ERROR_CONFLICT, "BLCONF_ERROR_CONFLICT", "Conflict" },
             { 0, NULL, NULL }
         };
         
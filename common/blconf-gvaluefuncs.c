@@ -40,7 +40,7 @@
 #include <glib/gi18n.h>
 #endif
 
-#include <dbus/dbus-glib.h>
+#include <gio/gio.h>
 
 #include "blconf-gvaluefuncs.h"
 #include "blconf/blconf-types.h"
@@ -64,42 +64,99 @@
 #define BLCONF_MAXUCHAR  (255)
 #endif
 
+/* the type names are told apart by their length and first character,
+ * so at most one comparison is needed for any name */
 GType
-_blconf_gtype_from_string(const gchar *type)
+_blconf_gtype_from_string_len(const gchar *type,
+                              gsize len)
 {
-    /* note: move the most frequently used types to the top */
-    if(!strcmp(type, "empty"))
-        return G_TYPE_NONE;
-    else if(!strcmp(type, "string"))
-        return G_TYPE_STRING;
-    else if(!strcmp(type, "int"))
-        return G_TYPE_INT;
-    else if(!strcmp(type, "double"))
-        return G_TYPE_DOUBLE;
-    else if(!strcmp(type, "bool"))
-        return G_TYPE_BOOLEAN;
-    else if(!strcmp(type, "array"))
-        return BLCONF_TYPE_G_VALUE_ARRAY;
-    else if(!strcmp(type, "uint"))
-        return G_TYPE_UINT;
-    else if(!strcmp(type, "uchar"))
-        return G_TYPE_UCHAR;
-    else if(!strcmp(type, "char"))
-        return G_TYPE_CHAR;
-    else if(!strcmp(type, "uint16"))
-        return BLCONF_TYPE_UINT16;
-    else if(!strcmp(type, "int16"))
-        return BLCONF_TYPE_INT16;
-    else if(!strcmp(type, "uint64"))
-        return G_TYPE_UINT64;
-    else if(!strcmp(type, "int64"))
-        return G_TYPE_INT64;
-    else if(!strcmp(type, "float"))
-        return G_TYPE_FLOAT;
+#define TYPE_NAME_IS(name)  (len == sizeof(name) - 1 \
+                             && !memcmp(type, name, sizeof(name) - 1))
+
+    if(G_UNLIKELY(!len))
+        return G_TYPE_INVALID;
+
+    switch(len) {
+        case 3:
+            if(TYPE_NAME_IS("int"))
+                return G_TYPE_INT;
+            break;
+
+        case 4:
+            switch(type[0]) {
+                case 'b':
+                    if(TYPE_NAME_IS("bool"))
+                        return G_TYPE_BOOLEAN;
+                    break;
+                case 'c':
+                    if(TYPE_NAME_IS("char"))
+                        return G_TYPE_CHAR;
+                    break;
+                case 'u':
+                    if(TYPE_NAME_IS("uint"))
+                        return G_TYPE_UINT;
+                    break;
+            }
+            break;
+
+        case 5:
+            switch(type[0]) {
+                case 'e':
+                    if(TYPE_NAME_IS("empty"))
+                        return G_TYPE_NONE;
+                    break;
+                case 'a':
+                    if(TYPE_NAME_IS("array"))
+                        return BLCONF_TYPE_G_VALUE_ARRAY;
+                    break;
+                case 'u':
+                    if(TYPE_NAME_IS("uchar"))
+                        return G_TYPE_UCHAR;
+                    break;
+                case 'f':
+                    if(TYPE_NAME_IS("float"))
+                        return G_TYPE_FLOAT;
+                    break;
+                case 'i':
+                    if(TYPE_NAME_IS("int16"))
+                        return BLCONF_TYPE_INT16;
+                    else if(TYPE_NAME_IS("int64"))
+                        return G_TYPE_INT64;
+                    break;
+            }
+            break;
+
+        case 6:
+            switch(type[0]) {
+                case 's':
+                    if(TYPE_NAME_IS("string"))
+                        return G_TYPE_STRING;
+                    break;
+                case 'd':
+                    if(TYPE_NAME_IS("double"))
+                        return G_TYPE_DOUBLE;
+                    break;
+                case 'u':
+                    if(TYPE_NAME_IS("uint16"))
+                        return BLCONF_TYPE_UINT16;
+                    else if(TYPE_NAME_IS("uint64"))
+                        return G_TYPE_UINT64;
+                    break;
+            }
+            break;
+    }
+
+#undef TYPE_NAME_IS
 
     return G_TYPE_INVALID;
 }
 
+GType
+_blconf_gtype_from_string(const gchar *type)
+{
+    return _blconf_gtype_from_string_len(type, strlen(type));
+}
+
 const gchar *
 _blconf_string_from_gtype(GType gtype)
 {
@@ -139,109 +196,270 @@ _blconf_string_from_gtype(GType gtype)
     return NULL;
 }
 
+/* The number parsers below work on a span rather than a nul-terminated
+ * string, never allocate, and don't look at the locale.  They accept
+ * what strtol() and friends would with base 0, except that the whole
+ * span has to be used up and out-of-range values are always refused. */
+
+/* [space][sign](0x<hex> | 0<octal> | <decimal>) */
+static gboolean
+blconf_parse_integer(const gchar *str,
+                     gsize len,
+                     gboolean *negative,
+                     guint64 *magnitude)
+{
+    const gchar *p = str, *end = str + len;
+    guint64 val = 0;
+    guint base = 10;
+
+    while(p < end && g_ascii_isspace(*p))
+        ++p;
+
+    *negative = FALSE;
+    if(p < end && (*p == '+' || *p == '-')) {
+        *negative = (*p == '-');
+        ++p;
+    }
+
+    if(end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')
+       && g_ascii_isxdigit(p[2]))
+    {
+        base = 16;
+        p += 2;
+    } else if(end - p > 1 && p[0] == '0')
+        base = 8;
+
+    if(p == end)
+        return FALSE;
+
+    for(; p < end; ++p) {
+        gint digit = g_ascii_xdigit_value(*p);
+
+        if(digit < 0 || (guint)digit >= base)
+            return FALSE;
+        if(val > (G_MAXUINT64 - digit) / base)
+            return FALSE;
+        val = val * base + digit;
+    }
+
+    *magnitude = val;
+
+    return TRUE;
+}
+
+static gboolean
+blconf_parse_int64(const gchar *str,
+                   gsize len,
+                   gint64 minval,
+                   gint64 maxval,
+                   gint64 *val)
+{
+    gboolean negative;
+    guint64 magnitude;
+
+    if(!blconf_parse_integer(str, len, &negative, &magnitude))
+        return FALSE;
+
+    if(negative) {
+        if(magnitude > (guint64)G_MAXINT64 + 1)
+            return FALSE;
+        *val = magnitude == (guint64)G_MAXINT64 + 1
+               ? G_MININT64 : -(gint64)magnitude;
+    } else {
+        if(magnitude > (guint64)G_MAXINT64)
+            return FALSE;
+        *val = magnitude;
+    }
+
+    return *val >= minval && *val <= maxval;
+}
+
+static gboolean
+blconf_parse_uint64(const gchar *str,
+                    gsize len,
+                    guint64 maxval,
+                    guint64 *val)
+{
+    gboolean negative;
+
+    if(!blconf_parse_integer(str, len, &negative, val))
+        return FALSE;
+
+    return (!negative || !*val) && *val <= maxval;
+}
+
+/* every power of ten up to here is exact as a double */
+#define BLCONF_MAX_EXACT_POW10  22
+/* and so is any integer with this many digits */
+#define BLCONF_MAX_EXACT_DIGITS  15
+
+static gboolean
+blconf_parse_double(const gchar *str,
+                    gsize len,
+                    gdouble *val)
+{
+    static const gdouble pow10[BLCONF_MAX_EXACT_POW10 + 1] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const gchar *p = str, *end = str + len;
+    guint64 mantissa = 0;
+    gint n_digits = 0, n_frac_digits = 0;
+    gboolean negative = FALSE, in_frac = FALSE, seen_digit = FALSE, ret;
+    gchar buf[64], *copy, *endptr;
+
+    while(p < end && g_ascii_isspace(*p))
+        ++p;
+    if(p < end && (*p == '+' || *p == '-')) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    /* the common case, a plain decimal with few enough digits, divides
+     * out exactly and so rounds just like strtod() would */
+    for(; p < end; ++p) {
+        if(g_ascii_isdigit(*p)) {
+            seen_digit = TRUE;
+            mantissa = mantissa * 10 + (*p - '0');
+            if(mantissa)
+                ++n_digits;
+            if(in_frac)
+                ++n_frac_digits;
+            if(n_digits > BLCONF_MAX_EXACT_DIGITS
+               || n_frac_digits > BLCONF_MAX_EXACT_POW10)
+            {
+                break;
+            }
+        } else if(*p == '.' && !in_frac)
+            in_frac = TRUE;
+        else
+            break;
+    }
+
+    if(p == end) {
+        if(!seen_digit)
+            return FALSE;
+        *val = (gdouble)mantissa / pow10[n_frac_digits];
+        if(negative)
+            *val = -*val;
+        return TRUE;
+    }
+
+    /* anything else (exponents, long mantissas, inf and nan) is left
+     * to g_ascii_strtod(), which needs a terminated copy */
+    if(len < sizeof(buf)) {
+        memcpy(buf, str, len);
+        buf[len] = 0;
+        copy = buf;
+    } else
+        copy = g_strndup(str, len);
+
+    errno = 0;
+    *val = g_ascii_strtod(copy, &endptr);
+    ret = *copy && !*endptr && !(0.0 == *val && ERANGE == errno);
+
+    if(copy != buf)
+        g_free(copy);
+
+    return ret;
+}
+
 gboolean
-_blconf_gvalue_from_string(GValue *value,
-                           const gchar *str)
+_blconf_gvalue_from_string_len(GValue *value,
+                               const gchar *str,
+                               gsize len)
 {
-#define CHECK_CONVERT_STATUS() \
-    if(*str == 0 || *endptr != 0) \
-        return FALSE
-#define CHECK_CONVERT_VALUE(val, minval, maxval) \
-    if((val) < (minval) || (val) > (maxval)) \
-        return FALSE
-    
-#define REAL_HANDLE_INT(minval, maxval, convertfunc, setfunc) \
-    G_STMT_START{ \
-        errno = 0; \
-        intval = convertfunc(str, &endptr, 0); \
-        if(0 == intval && ERANGE == errno) \
-            return FALSE; \
-        CHECK_CONVERT_STATUS(); \
-        CHECK_CONVERT_VALUE(intval, minval, maxval); \
-        setfunc(value, intval); \
-        return TRUE; \
-    }G_STMT_END
-
-#define HANDLE_UINT(minval, maxval, setfunc)  REAL_HANDLE_INT(minval, maxval, strtoul, setfunc)
-#define HANDLE_INT(minval, maxval, setfunc)  REAL_HANDLE_INT(minval, maxval, strtol, setfunc)
-    
     guint64 uintval;
     gint64 intval;
     gdouble dval;
-    gchar *endptr = NULL;
-    
+
     switch(G_VALUE_TYPE(value)) {
         case G_TYPE_STRING:
-            g_value_set_string(value, str);
+            g_value_take_string(value, g_strndup(str, len));
             return TRUE;
-        
+
         case G_TYPE_UCHAR:
-            HANDLE_UINT(0, BLCONF_MAXUCHAR, g_value_set_uchar);
+            if(!blconf_parse_uint64(str, len, BLCONF_MAXUCHAR, &uintval))
+                return FALSE;
+            g_value_set_uchar(value, uintval);
+            return TRUE;
+
         case G_TYPE_CHAR:
 #if GLIB_CHECK_VERSION (2, 32, 0)
-            HANDLE_INT(G_MININT8, G_MAXINT8, g_value_set_schar);
+            if(!blconf_parse_int64(str, len, G_MININT8, G_MAXINT8, &intval))
+                return FALSE;
+            g_value_set_schar(value, intval);
 #else
-            HANDLE_INT(BLCONF_MINCHAR, BLCONF_MAXCHAR, g_value_set_char);
+            if(!blconf_parse_int64(str, len, BLCONF_MINCHAR, BLCONF_MAXCHAR,
+                                   &intval))
+            {
+                return FALSE;
+            }
+            g_value_set_char(value, intval);
 #endif
+            return TRUE;
+
         case G_TYPE_UINT:
-            HANDLE_UINT(0, G_MAXUINT, g_value_set_uint);
+            if(!blconf_parse_uint64(str, len, G_MAXUINT, &uintval))
+                return FALSE;
+            g_value_set_uint(value, uintval);
+            return TRUE;
+
         case G_TYPE_INT:
-            HANDLE_INT(G_MININT, G_MAXINT, g_value_set_int);
-        
+            if(!blconf_parse_int64(str, len, G_MININT, G_MAXINT, &intval))
+                return FALSE;
+            g_value_set_int(value, intval);
+            return TRUE;
+
         case G_TYPE_UINT64:
-            errno = 0;
-            uintval = g_ascii_strtoull(str, &endptr, 0);
-            if(0 == uintval && ERANGE == errno)
+            if(!blconf_parse_uint64(str, len, G_MAXUINT64, &uintval))
                 return FALSE;
-            CHECK_CONVERT_STATUS();
             g_value_set_uint64(value, uintval);
             return TRUE;
-        
+
         case G_TYPE_INT64:
-            errno = 0;
-            intval = g_ascii_strtoll(str, &endptr, 0);
-            if(0 == intval && ERANGE == errno)
+            if(!blconf_parse_int64(str, len, G_MININT64, G_MAXINT64, &intval))
                 return FALSE;
-            CHECK_CONVERT_STATUS();
             g_value_set_int64(value, intval);
             return TRUE;
-        
+
         case G_TYPE_FLOAT:
-            errno = 0;
-            dval = g_ascii_strtod(str, &endptr);
-            if(0.0 == dval && ERANGE == errno)
+            if(!blconf_parse_double(str, len, &dval))
                 return FALSE;
-            CHECK_CONVERT_STATUS();
-            if(dval < G_MINFLOAT || dval > G_MAXFLOAT)
+            if(dval < -G_MAXFLOAT || dval > G_MAXFLOAT)
                 return FALSE;
             g_value_set_float(value, (gfloat)dval);
             return TRUE;
-        
+
         case G_TYPE_DOUBLE:
-            errno = 0;
-            dval = g_ascii_strtod(str, &endptr);
-            if(0.0 == dval && ERANGE == errno)
+            if(!blconf_parse_double(str, len, &dval))
                 return FALSE;
-            CHECK_CONVERT_STATUS();
             g_value_set_double(value, dval);
             return TRUE;
-        
+
         case G_TYPE_BOOLEAN:
-            if(!strcmp(str, "true")) {
+            if(len == 4 && !memcmp(str, "true", 4)) {
                 g_value_set_boolean(value, TRUE);
                 return TRUE;
-            } else if(!strcmp(str, "false")) {
+            } else if(len == 5 && !memcmp(str, "false", 5)) {
                 g_value_set_boolean(value, FALSE);
                 return TRUE;
             } else
                 return FALSE;
-        
+
         default:
             if(BLCONF_TYPE_UINT16 == G_VALUE_TYPE(value)) {
-                HANDLE_INT(0, G_MAXUSHORT, blconf_g_value_set_uint16);
+                if(!blconf_parse_uint64(str, len, G_MAXUSHORT, &uintval))
+                    return FALSE;
+                blconf_g_value_set_uint16(value, uintval);
                 return TRUE;
             } else if(BLCONF_TYPE_INT16 == G_VALUE_TYPE(value)) {
-                HANDLE_INT(G_MINSHORT, G_MAXSHORT, blconf_g_value_set_int16);
+                if(!blconf_parse_int64(str, len, G_MINSHORT, G_MAXSHORT,
+                                       &intval))
+                {
+                    return FALSE;
+                }
+                blconf_g_value_set_int16(value, intval);
                 return TRUE;
             } else if(BLCONF_TYPE_G_VALUE_ARRAY == G_VALUE_TYPE(value)) {
                 GPtrArray *arr = g_ptr_array_sized_new(1);
@@ -250,12 +468,13 @@ _blconf_gvalue_from_string(GValue *value,
             }
             return FALSE;
     }
+}
 
-#undef CHECK_CONVERT_STATUS
-#undef CHECK_CONVERT_VALUE
-#undef REAL_HANDLE_INT
-#undef HANDLE_INT
-#undef HANDLE_UINT
+gboolean
+_blconf_gvalue_from_string(GValue *value,
+                           const gchar *str)
+{
+    return _blconf_gvalue_from_string_len(value, str, strlen(str));
 }
 
 gchar *
@@ -305,6 +524,204 @@ _blconf_string_from_gvalue(GValue *val)
     return NULL;
 }
 
+/* Packed arrays.  An array whose values all have the same basic type
+ * can be kept as a typed GVariant array ("as", "ai" and so on) rather
+ * than as a GPtrArray of GValues: the strings then sit in one blob
+ * with their offsets, and numbers in a native array, so a 500-element
+ * list is one allocation instead of a thousand, and a copy is just a
+ * reference.  libblconf's cache keeps its arrays this way; anything
+ * handed to an application or a backend is still a GPtrArray.
+ *
+ * Only types that come back exactly are packed: chars and floats
+ * would return as bytes and doubles, and neither is worth it. */
+
+/* the type of a packed array of |type|, or NULL if there's none */
+static const gchar *
+blconf_packed_array_type(GType type)
+{
+    switch(type) {
+        case G_TYPE_STRING:
+            return "as";
+        case G_TYPE_INT:
+            return "ai";
+        case G_TYPE_UINT:
+            return "au";
+        case G_TYPE_BOOLEAN:
+            return "ab";
+        case G_TYPE_DOUBLE:
+            return "ad";
+        case G_TYPE_INT64:
+            return "ax";
+        case G_TYPE_UINT64:
+            return "at";
+        case G_TYPE_UCHAR:
+            return "ay";
+
+        default:
+            if(type == BLCONF_TYPE_INT16)
+                return "an";
+            else if(type == BLCONF_TYPE_UINT16)
+                return "aq";
+            break;
+    }
+
+    return NULL;
+}
+
+/* whether |variant| is something _blconf_gvariant_to_gvalue_packed()
+ * keeps packed */
+static gboolean
+blconf_variant_is_packable(GVariant *variant)
+{
+    const gchar *type = g_variant_get_type_string(variant);
+
+    if(type[0] != 'a' || !type[1] || type[2] || !strchr("siubdxtynq", type[1]))
+        return FALSE;
+
+    return g_variant_n_children(variant) > 0;
+}
+
+/* the type |arr| packs into, or NULL if it's empty, mixes types, or
+ * holds NULL strings, which a packed array can't */
+static const gchar *
+blconf_value_array_packed_type(const GPtrArray *arr)
+{
+    GType type;
+    guint i;
+
+    if(!arr || !arr->len)
+        return NULL;
+
+    type = G_VALUE_TYPE((GValue *)g_ptr_array_index(arr, 0));
+    for(i = 0; i < arr->len; ++i) {
+        const GValue *value = g_ptr_array_index(arr, i);
+
+        if(G_VALUE_TYPE(value) != type
+           || (type == G_TYPE_STRING && !g_value_get_string(value)))
+        {
+            return NULL;
+        }
+    }
+
+    return blconf_packed_array_type(type);
+}
+
+/* a floating typed array of |arr|'s values; |type| is from
+ * blconf_value_array_packed_type() */
+static GVariant *
+blconf_value_array_pack(const GPtrArray *arr,
+                        const gchar *type)
+{
+    GVariantBuilder builder;
+    guint i;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE(type));
+    for(i = 0; i < arr->len; ++i) {
+        g_variant_builder_add_value(&builder,
+                                    _blconf_gvalue_to_gvariant(g_ptr_array_index(arr, i)));
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+/* a reference to |variant| in its serialised form, as one blob.  a
+ * child of a D-Bus message or a mapped snapshot is copied out, or it
+ * would keep the whole of its parent alive for as long as it's
+ * cached. */
+static GVariant *
+blconf_variant_detach(GVariant *variant)
+{
+    GBytes *bytes;
+    GVariant *copy;
+
+    if(g_variant_is_floating(variant)) {
+        /* built here, so it's nobody else's */
+        g_variant_ref_sink(variant);
+        g_variant_get_data(variant);
+        return variant;
+    }
+
+    bytes = g_bytes_new(g_variant_get_data(variant), g_variant_get_size(variant));
+    copy = g_variant_new_from_bytes(g_variant_get_type(variant), bytes, FALSE);
+    g_bytes_unref(bytes);
+
+    return g_variant_ref_sink(copy);
+}
+
+static gboolean
+blconf_packed_array_is_equal(GVariant *packed,
+                             const GPtrArray *arr)
+{
+    const gchar *type = blconf_value_array_packed_type(arr);
+    GVariant *variant;
+    gboolean ret;
+
+    if(!type || strcmp(type, g_variant_get_type_string(packed))
+       || g_variant_n_children(packed) != arr->len)
+    {
+        return FALSE;
+    }
+
+    variant = g_variant_ref_sink(blconf_value_array_pack(arr, type));
+    ret = g_variant_equal(variant, packed);
+    g_variant_unref(variant);
+
+    return ret;
+}
+
+/* arrays are equal if they hold equal values in the same order.  the
+ * cheap checks come first: the lengths, then the types of each pair,
+ * and only then the contents, without a type switch per element for
+ * the common all-strings case */
+static gboolean
+blconf_value_array_is_equal(const GPtrArray *arr1,
+                            const GPtrArray *arr2)
+{
+    GType type;
+    guint i;
+
+    if(arr1 == arr2)
+        return TRUE;
+    if(!arr1 || !arr2)
+        return (!arr1 || !arr1->len) && (!arr2 || !arr2->len);
+    if(arr1->len != arr2->len)
+        return FALSE;
+    if(!arr1->len)
+        return TRUE;
+
+    type = G_VALUE_TYPE((GValue *)g_ptr_array_index(arr1, 0));
+    for(i = 0; i < arr1->len; ++i) {
+        GType type1 = G_VALUE_TYPE((GValue *)g_ptr_array_index(arr1, i));
+
+        if(type1 != G_VALUE_TYPE((GValue *)g_ptr_array_index(arr2, i)))
+            return FALSE;
+        if(type1 != type)
+            type = G_TYPE_INVALID;
+    }
+
+    if(type == G_TYPE_STRING) {
+        for(i = 0; i < arr1->len; ++i) {
+            const gchar *str1 = g_value_get_string(g_ptr_array_index(arr1, i));
+            const gchar *str2 = g_value_get_string(g_ptr_array_index(arr2, i));
+
+            if(str1 != str2 && g_strcmp0(str1, str2))
+                return FALSE;
+        }
+
+        return TRUE;
+    }
+
+    for(i = 0; i < arr1->len; ++i) {
+        if(!_blconf_gvalue_is_equal(g_ptr_array_index(arr1, i),
+                                    g_ptr_array_index(arr2, i)))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
 gboolean
 _blconf_gvalue_is_equal(const GValue *value1,
                         const GValue *value2)
@@ -313,8 +730,21 @@ _blconf_gvalue_is_equal(const GValue *value1,
         return TRUE;
     if(G_UNLIKELY(!value1 || !value2))
         return FALSE;
-    if(G_VALUE_TYPE(value1) != G_VALUE_TYPE(value2))
+    if(G_VALUE_TYPE(value1) != G_VALUE_TYPE(value2)) {
+        /* a packed array still equals the array it was packed from */
+        if(G_VALUE_TYPE(value1) == BLCONF_TYPE_PACKED_ARRAY
+           && G_VALUE_TYPE(value2) == BLCONF_TYPE_G_VALUE_ARRAY)
+        {
+            return blconf_packed_array_is_equal(g_value_get_boxed(value1),
+                                                g_value_get_boxed(value2));
+        } else if(G_VALUE_TYPE(value1) == BLCONF_TYPE_G_VALUE_ARRAY
+                  && G_VALUE_TYPE(value2) == BLCONF_TYPE_PACKED_ARRAY)
+        {
+            return blconf_packed_array_is_equal(g_value_get_boxed(value2),
+                                                g_value_get_boxed(value1));
+        }
         return FALSE;
+    }
     if(G_VALUE_TYPE(value1) == G_TYPE_INVALID
        || G_VALUE_TYPE(value1) == G_TYPE_NONE)
     {
@@ -341,13 +771,27 @@ _blconf_gvalue_is_equal(const GValue *value1,
         HANDLE_CMP_GV(DOUBLE, double);
 
         case G_TYPE_STRING:
+            /* borrowed values share their string with the original */
+            if(g_value_get_string(value1) == g_value_get_string(value2))
+                return TRUE;
             return !g_strcmp0(g_value_get_string(value1), g_value_get_string(value2));
 
         default:
             if(G_VALUE_TYPE(value1) == BLCONF_TYPE_INT16)
-                return blconf_g_value_get_int16(value1) == blconf_g_value_get_uint16(value2);
+                return blconf_g_value_get_int16(value1) == blconf_g_value_get_int16(value2);
             else if(G_VALUE_TYPE(value1) == BLCONF_TYPE_UINT16)
                 return blconf_g_value_get_uint16(value1) == blconf_g_value_get_uint16(value2);
+            else if(G_VALUE_TYPE(value1) == BLCONF_TYPE_G_VALUE_ARRAY) {
+                return blconf_value_array_is_equal(g_value_get_boxed(value1),
+                                                   g_value_get_boxed(value2));
+            } else if(G_VALUE_TYPE(value1) == BLCONF_TYPE_PACKED_ARRAY) {
+                return g_variant_equal(g_value_get_boxed(value1),
+                                       g_value_get_boxed(value2));
+            } else if(G_VALUE_HOLDS_BOXED(value1)
+                    && g_value_get_boxed(value1) == g_value_get_boxed(value2))
+            {
+                return TRUE;
+            }
             break;
 #undef HANDLE_CMP_GV
     }
@@ -360,6 +804,559 @@ _blconf_gvalue_free(GValue *value)
 {
     if(!value)
         return;
-    g_value_unset(value);
+    if(G_VALUE_TYPE(value))
+        g_value_unset(value);
     g_free(value);
 }
+
+
+
+static gpointer
+blconf_value_array_copy(gpointer boxed)
+{
+    GPtrArray *arr = boxed, *copy;
+    guint i;
+
+    copy = g_ptr_array_sized_new(arr->len);
+    for(i = 0; i < arr->len; ++i) {
+        GValue *src = g_ptr_array_index(arr, i), *dest = g_new0(GValue, 1);
+
+        g_value_init(dest, G_VALUE_TYPE(src));
+        g_value_copy(src, dest);
+        g_ptr_array_add(copy, dest);
+    }
+
+    return copy;
+}
+
+static void
+blconf_value_array_free(gpointer boxed)
+{
+    GPtrArray *arr = boxed;
+    guint i;
+
+    for(i = 0; i < arr->len; ++i)
+        _blconf_gvalue_free(g_ptr_array_index(arr, i));
+    g_ptr_array_free(arr, TRUE);
+}
+
+/* a GPtrArray of GValues, copied and freed deeply.  this file gets
+ * linked into more than one module of the same process (libblconf
+ * and blconf-query, say), so the type may already be there. */
+GType
+_blconf_value_array_get_type(void)
+{
+    static GType type = 0;
+
+    if(G_UNLIKELY(!type)) {
+        type = g_type_from_name("BlconfValueArray");
+        if(!type) {
+            type = g_boxed_type_register_static("BlconfValueArray",
+                                                blconf_value_array_copy,
+                                                blconf_value_array_free);
+        }
+    }
+
+    return type;
+}
+
+static GPtrArray *blconf_gvariant_to_value_array(GVariant *variant);
+
+static gpointer
+blconf_packed_array_copy(gpointer boxed)
+{
+    return g_variant_ref(boxed);
+}
+
+static void
+blconf_packed_array_free(gpointer boxed)
+{
+    g_variant_unref(boxed);
+}
+
+static void
+blconf_packed_array_transform(const GValue *src_value,
+                              GValue *dest_value)
+{
+    g_value_take_boxed(dest_value,
+                       blconf_gvariant_to_value_array(g_value_get_boxed(src_value)));
+}
+
+/* a typed GVariant array, see blconf_packed_array_type().  it
+ * transforms into a BlconfValueArray, so code that asks for one gets
+ * one. */
+GType
+_blconf_packed_array_get_type(void)
+{
+    static GType type = 0;
+
+    if(G_UNLIKELY(!type)) {
+        type = g_type_from_name("BlconfPackedArray");
+        if(!type) {
+            type = g_boxed_type_register_static("BlconfPackedArray",
+                                                blconf_packed_array_copy,
+                                                blconf_packed_array_free);
+            g_value_register_transform_func(type, BLCONF_TYPE_G_VALUE_ARRAY,
+                                            blconf_packed_array_transform);
+        }
+    }
+
+    return type;
+}
+
+/* copies |src| into the unset |dest|, packing it if it's an array
+ * that can be */
+void
+_blconf_gvalue_copy_packed(const GValue *src,
+                           GValue *dest)
+{
+    const gchar *type = NULL;
+
+    if(G_VALUE_TYPE(src) == BLCONF_TYPE_G_VALUE_ARRAY)
+        type = blconf_value_array_packed_type(g_value_get_boxed(src));
+
+    if(type) {
+        g_value_init(dest, BLCONF_TYPE_PACKED_ARRAY);
+        g_value_take_boxed(dest,
+                           blconf_variant_detach(blconf_value_array_pack(g_value_get_boxed(src),
+                                                                         type)));
+    } else
+        g_value_copy(src, g_value_init(dest, G_VALUE_TYPE(src)));
+}
+
+/* the reverse: copies |src| into the unset |dest|, with a packed array
+ * turned back into a GPtrArray */
+void
+_blconf_gvalue_copy_unpacked(const GValue *src,
+                             GValue *dest)
+{
+    if(G_VALUE_TYPE(src) == BLCONF_TYPE_PACKED_ARRAY) {
+        g_value_init(dest, BLCONF_TYPE_G_VALUE_ARRAY);
+        g_value_take_boxed(dest,
+                           blconf_gvariant_to_value_array(g_value_get_boxed(src)));
+    } else
+        g_value_copy(src, g_value_init(dest, G_VALUE_TYPE(src)));
+}
+
+/* Wire conversions.  Values travel as variants; 16-bit integers use
+ * the D-Bus 16-bit types.  Arrays whose values all have one basic type
+ * go as a typed array, which is what they get packed into at the other
+ * end; anything else as "av".  Returns a floating reference, or NULL
+ * if |value| has no D-Bus equivalent. */
+GVariant *
+_blconf_gvalue_to_gvariant(const GValue *value)
+{
+    switch(G_VALUE_TYPE(value)) {
+        case G_TYPE_STRING:
+            return g_variant_new_string(g_value_get_string(value)
+                                        ? g_value_get_string(value) : "");
+        case G_TYPE_INT:
+            return g_variant_new_int32(g_value_get_int(value));
+        case G_TYPE_UINT:
+            return g_variant_new_uint32(g_value_get_uint(value));
+        case G_TYPE_BOOLEAN:
+            return g_variant_new_boolean(g_value_get_boolean(value));
+        case G_TYPE_DOUBLE:
+            return g_variant_new_double(g_value_get_double(value));
+        case G_TYPE_FLOAT:
+            return g_variant_new_double(g_value_get_float(value));
+        case G_TYPE_INT64:
+            return g_variant_new_int64(g_value_get_int64(value));
+        case G_TYPE_UINT64:
+            return g_variant_new_uint64(g_value_get_uint64(value));
+        case G_TYPE_UCHAR:
+            return g_variant_new_byte(g_value_get_uchar(value));
+        case G_TYPE_CHAR:
+#if GLIB_CHECK_VERSION (2, 32, 0)
+            return g_variant_new_byte(g_value_get_schar(value));
+#else
+            return g_variant_new_byte(g_value_get_char(value));
+#endif
+
+        default:
+            if(G_VALUE_TYPE(value) == BLCONF_TYPE_UINT16)
+                return g_variant_new_uint16(blconf_g_value_get_uint16(value));
+            else if(G_VALUE_TYPE(value) == BLCONF_TYPE_INT16)
+                return g_variant_new_int16(blconf_g_value_get_int16(value));
+            else if(G_VALUE_TYPE(value) == BLCONF_TYPE_PACKED_ARRAY) {
+                GVariant *packed = g_value_get_boxed(value);
+
+                /* shares the blob rather than copying it */
+                return g_variant_new_from_data(g_variant_get_type(packed),
+                                               g_variant_get_data(packed),
+                                               g_variant_get_size(packed),
+                                               FALSE,
+                                               (GDestroyNotify)g_variant_unref,
+                                               g_variant_ref(packed));
+            } else if(G_VALUE_TYPE(value) == BLCONF_TYPE_G_VALUE_ARRAY) {
+                GPtrArray *arr = g_value_get_boxed(value);
+                const gchar *type = blconf_value_array_packed_type(arr);
+                GVariantBuilder builder;
+                guint i;
+
+                if(type)
+                    return blconf_value_array_pack(arr, type);
+
+                g_variant_builder_init(&builder, G_VARIANT_TYPE("av"));
+                for(i = 0; arr && i < arr->len; ++i) {
+                    GVariant *v = _blconf_gvalue_to_gvariant(g_ptr_array_index(arr, i));
+
+                    if(!v) {
+                        g_variant_builder_clear(&builder);
+                        return NULL;
+                    }
+                    g_variant_builder_add(&builder, "v", v);
+                }
+
+                return g_variant_builder_end(&builder);
+            } else if(G_VALUE_TYPE(value) == G_TYPE_STRV) {
+                const gchar * const *strv = g_value_get_boxed(value);
+
+                return g_variant_new_strv(strv, -1);
+            }
+            break;
+    }
+
+    g_warning("Unable to send values of type \"%s\" over D-Bus",
+              G_VALUE_TYPE_NAME(value));
+
+    return NULL;
+}
+
+/* the reverse; |value| must be unset.  variants are unwrapped, and
+ * arrays of any element type become arrays of GValues */
+gboolean
+_blconf_gvariant_to_gvalue(GVariant *variant,
+                           GValue *value)
+{
+    switch(g_variant_classify(variant)) {
+        case G_VARIANT_CLASS_VARIANT: {
+            GVariant *inner = g_variant_get_variant(variant);
+            gboolean ret = _blconf_gvariant_to_gvalue(inner, value);
+
+            g_variant_unref(inner);
+            return ret;
+        }
+        case G_VARIANT_CLASS_STRING:
+            g_value_init(value, G_TYPE_STRING);
+            g_value_set_string(value, g_variant_get_string(variant, NULL));
+            return TRUE;
+        case G_VARIANT_CLASS_INT32:
+            g_value_init(value, G_TYPE_INT);
+            g_value_set_int(value, g_variant_get_int32(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_UINT32:
+            g_value_init(value, G_TYPE_UINT);
+            g_value_set_uint(value, g_variant_get_uint32(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_BOOLEAN:
+            g_value_init(value, G_TYPE_BOOLEAN);
+            g_value_set_boolean(value, g_variant_get_boolean(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_DOUBLE:
+            g_value_init(value, G_TYPE_DOUBLE);
+            g_value_set_double(value, g_variant_get_double(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_INT64:
+            g_value_init(value, G_TYPE_INT64);
+            g_value_set_int64(value, g_variant_get_int64(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_UINT64:
+            g_value_init(value, G_TYPE_UINT64);
+            g_value_set_uint64(value, g_variant_get_uint64(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_BYTE:
+            g_value_init(value, G_TYPE_UCHAR);
+            g_value_set_uchar(value, g_variant_get_byte(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_UINT16:
+            g_value_init(value, BLCONF_TYPE_UINT16);
+            blconf_g_value_set_uint16(value, g_variant_get_uint16(variant));
+            return TRUE;
+        case G_VARIANT_CLASS_INT16:
+            g_value_init(value, BLCONF_TYPE_INT16);
+            blconf_g_value_set_int16(value, g_variant_get_int16(variant));
+            return TRUE;
+
+        case G_VARIANT_CLASS_ARRAY:
+            if(!g_variant_is_of_type(variant, G_VARIANT_TYPE_DICTIONARY)) {
+                GPtrArray *arr = blconf_gvariant_to_value_array(variant);
+
+                if(!arr)
+                    return FALSE;
+
+                g_value_init(value, BLCONF_TYPE_G_VALUE_ARRAY);
+                g_value_take_boxed(value, arr);
+                return TRUE;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return FALSE;
+}
+
+/* an array of GValues from an array variant of any element type, or
+ * NULL if one of them won't convert */
+static GPtrArray *
+blconf_gvariant_to_value_array(GVariant *variant)
+{
+    gsize i, n = g_variant_n_children(variant);
+    GPtrArray *arr = g_ptr_array_sized_new(n);
+
+    for(i = 0; i < n; ++i) {
+        GVariant *child = g_variant_get_child_value(variant, i);
+        GValue *v = g_new0(GValue, 1);
+
+        if(!_blconf_gvariant_to_gvalue(child, v)) {
+            g_variant_unref(child);
+            g_free(v);
+            blconf_value_array_free(arr);
+            return NULL;
+        }
+        g_variant_unref(child);
+        g_ptr_array_add(arr, v);
+    }
+
+    return arr;
+}
+
+/* applies |splice| to |arr| in place, or returns FALSE, changing
+ * nothing, if it reaches past the end */
+gboolean
+_blconf_value_array_splice(GPtrArray *arr,
+                           const BlconfArraySplice *splice)
+{
+    guint i, len = arr->len, n_values = splice->values ? splice->values->len : 0;
+
+    if(splice->position > len || splice->n_remove > len - splice->position)
+        return FALSE;
+
+    for(i = 0; i < splice->n_remove; ++i)
+        _blconf_gvalue_free(g_ptr_array_index(arr, splice->position + i));
+    /* the elements are freed by hand, these arrays never have a
+     * free function */
+    g_ptr_array_remove_range(arr, splice->position, splice->n_remove);
+
+    if(!n_values)
+        return TRUE;
+
+    len = arr->len;
+    g_ptr_array_set_size(arr, len + n_values);
+    memmove(arr->pdata + splice->position + n_values,
+            arr->pdata + splice->position,
+            (len - splice->position) * sizeof(gpointer));
+    for(i = 0; i < n_values; ++i) {
+        const GValue *src = g_ptr_array_index(splice->values, i);
+        GValue *dest = g_new0(GValue, 1);
+
+        g_value_copy(src, g_value_init(dest, G_VALUE_TYPE(src)));
+        arr->pdata[splice->position + i] = dest;
+    }
+
+    return TRUE;
+}
+
+/* applies |splices| in turn to the array in |value|, which stays
+ * packed if it was and still can be.  if |value| doesn't hold an
+ * array, or one of the splices doesn't fit, it's left as it was and
+ * FALSE is returned. */
+gboolean
+_blconf_gvalue_splice(GValue *value,
+                      const BlconfArraySplice *splices,
+                      guint n_splices)
+{
+    GValue copy = { 0, };
+    GPtrArray *arr;
+    gboolean packed = G_VALUE_TYPE(value) == BLCONF_TYPE_PACKED_ARRAY;
+    guint i;
+
+    if(!packed && G_VALUE_TYPE(value) != BLCONF_TYPE_G_VALUE_ARRAY)
+        return FALSE;
+
+    _blconf_gvalue_copy_unpacked(value, &copy);
+    arr = g_value_get_boxed(&copy);
+    if(!arr) {
+        arr = g_ptr_array_new();
+        g_value_take_boxed(&copy, arr);
+    }
+
+    for(i = 0; i < n_splices; ++i) {
+        if(!_blconf_value_array_splice(arr, &splices[i])) {
+            g_value_unset(&copy);
+            return FALSE;
+        }
+    }
+
+    g_value_unset(value);
+    if(packed) {
+        _blconf_gvalue_copy_packed(&copy, value);
+        g_value_unset(&copy);
+    } else
+        *value = copy;
+
+    return TRUE;
+}
+
+/* frees the values of |splice|, e.g. as a GArray's clear function */
+void
+_blconf_array_splice_clear(BlconfArraySplice *splice)
+{
+    if(splice->values)
+        blconf_value_array_free(splice->values);
+}
+
+/* an "a(uuav)" of |splices|: position, number removed and the values
+ * put in their place; or NULL if one of the values can't be sent */
+GVariant *
+_blconf_splices_to_gvariant(const BlconfArraySplice *splices,
+                            guint n_splices)
+{
+    GVariantBuilder builder, values;
+    guint i, j;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a(uuav)"));
+
+    for(i = 0; i < n_splices; ++i) {
+        const GPtrArray *arr = splices[i].values;
+
+        g_variant_builder_init(&values, G_VARIANT_TYPE("av"));
+        for(j = 0; arr && j < arr->len; ++j) {
+            GVariant *v = _blconf_gvalue_to_gvariant(g_ptr_array_index(arr, j));
+
+            if(!v) {
+                g_variant_builder_clear(&values);
+                g_variant_builder_clear(&builder);
+                return NULL;
+            }
+            g_variant_builder_add(&values, "v", v);
+        }
+
+        g_variant_builder_add(&builder, "(uu@av)", splices[i].position,
+                              splices[i].n_remove,
+                              g_variant_builder_end(&values));
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+/* the other way round: a GArray of BlconfArraySplice that frees their
+ * values along with it, or NULL if a value won't convert */
+GArray *
+_blconf_gvariant_to_splices(GVariant *variant)
+{
+    GArray *splices;
+    GVariantIter iter;
+    GVariant *values;
+    BlconfArraySplice splice;
+
+    splices = g_array_sized_new(FALSE, FALSE, sizeof(BlconfArraySplice),
+                                g_variant_n_children(variant));
+    g_array_set_clear_func(splices, (GDestroyNotify)_blconf_array_splice_clear);
+
+    g_variant_iter_init(&iter, variant);
+    while(g_variant_iter_next(&iter, "(uu@av)", &splice.position,
+                              &splice.n_remove, &values))
+    {
+        splice.values = blconf_gvariant_to_value_array(values);
+        g_variant_unref(values);
+        if(!splice.values) {
+            g_array_free(splices, TRUE);
+            return NULL;
+        }
+        g_array_append_val(splices, splice);
+    }
+
+    return splices;
+}
+
+/* like _blconf_gvariant_to_gvalue(), but an array that can be packed
+ * is kept as it came, as a BLCONF_TYPE_PACKED_ARRAY */
+gboolean
+_blconf_gvariant_to_gvalue_packed(GVariant *variant,
+                                  GValue *value)
+{
+    GVariant *inner = NULL;
+    gboolean ret = TRUE;
+
+    if(g_variant_is_of_type(variant, G_VARIANT_TYPE_VARIANT))
+        variant = inner = g_variant_get_variant(variant);
+
+    if(blconf_variant_is_packable(variant)) {
+        g_value_init(value, BLCONF_TYPE_PACKED_ARRAY);
+        g_value_take_boxed(value, blconf_variant_detach(variant));
+    } else
+        ret = _blconf_gvariant_to_gvalue(variant, value);
+
+    if(inner)
+        g_variant_unref(inner);
+
+    return ret;
+}
+
+/* an "a{sv}" from a table of property name -> GValue*.  values that
+ * can't be sent are left out. */
+GVariant *
+_blconf_hash_to_gvariant(GHashTable *properties)
+{
+    GVariantBuilder builder;
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
+
+    g_hash_table_iter_init(&iter, properties);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        GVariant *v = _blconf_gvalue_to_gvariant(value);
+
+        if(v)
+            g_variant_builder_add(&builder, "{sv}", key, v);
+    }
+
+    return g_variant_builder_end(&builder);
+}
+
+static GHashTable *
+blconf_gvariant_to_hash_real(GVariant *variant,
+                             gboolean packed)
+{
+    GHashTable *properties;
+    GVariantIter iter;
+    const gchar *key;
+    GVariant *v;
+
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)_blconf_gvalue_free);
+
+    g_variant_iter_init(&iter, variant);
+    while(g_variant_iter_next(&iter, "{&sv}", &key, &v)) {
+        GValue *value = g_new0(GValue, 1);
+
+        if(packed ? _blconf_gvariant_to_gvalue_packed(v, value)
+                  : _blconf_gvariant_to_gvalue(v, value))
+        {
+            g_hash_table_insert(properties, g_strdup(key), value);
+        } else
+            g_free(value);
+        g_variant_unref(v);
+    }
+
+    return properties;
+}
+
+/* a new table of property name -> GValue* from an "a{sv}" */
+GHashTable *
+_blconf_gvariant_to_hash(GVariant *variant)
+{
+    return blconf_gvariant_to_hash_real(variant, FALSE);
+}
+
+/* the same, with the arrays that can be packed kept packed */
+GHashTable *
+_blconf_gvariant_to_hash_packed(GVariant *variant)
+{
+    return blconf_gvariant_to_hash_real(variant, TRUE);
+}
@@ -21,15 +21,29 @@
 #ifndef __BLCONF_GVALUEFUNCS_H__
 #define __BLCONF_GVALUEFUNCS_H__
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
+/* one edit to an array property: |n_remove| elements from |position|
+ * on are replaced with copies of |values| */
+typedef struct
+{
+    guint position;
+    guint n_remove;
+    GPtrArray *values;  /* of GValue *, may be NULL */
+} BlconfArraySplice;
+
 G_GNUC_INTERNAL GType _blconf_gtype_from_string(const gchar *type);
+G_GNUC_INTERNAL GType _blconf_gtype_from_string_len(const gchar *type,
+                                                    gsize len);
 G_GNUC_INTERNAL const gchar *_blconf_string_from_gtype(GType gtype);
 
 G_GNUC_INTERNAL gboolean _blconf_gvalue_from_string(GValue *value,
                                                     const gchar *str);
+G_GNUC_INTERNAL gboolean _blconf_gvalue_from_string_len(GValue *value,
+                                                        const gchar *str,
+                                                        gsize len);
 
 G_GNUC_INTERNAL gchar *_blconf_string_from_gvalue(GValue *value);
 
@@ -38,6 +52,31 @@ G_GNUC_INTERNAL gboolean _blconf_gvalue_is_equal(const GValue *value1,
 
 G_GNUC_INTERNAL void _blconf_gvalue_free(GValue *value);
 
+G_GNUC_INTERNAL void _blconf_gvalue_copy_packed(const GValue *src,
+                                                GValue *dest);
+G_GNUC_INTERNAL void _blconf_gvalue_copy_unpacked(const GValue *src,
+                                                  GValue *dest);
+
+G_GNUC_INTERNAL GVariant *_blconf_gvalue_to_gvariant(const GValue *value);
+G_GNUC_INTERNAL gboolean _blconf_gvariant_to_gvalue(GVariant *variant,
+                                                    GValue *value);
+G_GNUC_INTERNAL gboolean _blconf_gvariant_to_gvalue_packed(GVariant *variant,
+                                                           GValue *value);
+
+G_GNUC_INTERNAL gboolean _blconf_value_array_splice(GPtrArray *arr,
+                                                    const BlconfArraySplice *splice);
+G_GNUC_INTERNAL gboolean _blconf_gvalue_splice(GValue *value,
+                                               const BlconfArraySplice *splices,
+                                               guint n_splices);
+G_GNUC_INTERNAL void _blconf_array_splice_clear(BlconfArraySplice *splice);
+G_GNUC_INTERNAL GVariant *_blconf_splices_to_gvariant(const BlconfArraySplice *splices,
+                                                      guint n_splices);
+G_GNUC_INTERNAL GArray *_blconf_gvariant_to_splices(GVariant *variant);
+
+G_GNUC_INTERNAL GVariant *_blconf_hash_to_gvariant(GHashTable *properties);
+G_GNUC_INTERNAL GHashTable *_blconf_gvariant_to_hash(GVariant *variant);
+G_GNUC_INTERNAL GHashTable *_blconf_gvariant_to_hash_packed(GVariant *variant);
+
 G_END_DECLS
 
 #endif  /* __BLCONF_GVALUEFUNCS_H__ */
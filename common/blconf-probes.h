@@ -0,0 +1,75 @@
+/*
+ *  blconf
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; version 2
+ *  of the License ONLY.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_PROBES_H__
+#define __BLCONF_PROBES_H__
+
+/* Static trace points, built in with --enable-probes.  They're
+ * SystemTap SDT probes under the "blconf" provider, so perf, bpftrace
+ * and stap can all attach to them, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/lib/libblconf-0.so:blconf:dbus__call__start
+ *                { printf("%s %s\n", str(arg0), str(arg1)); }'
+ *
+ * When nobody is attached a probe costs a nop, but its arguments are
+ * still computed, so only pass ones that are already at hand.  Times
+ * are left to the tools: every slow step has a __start and a __done
+ * probe.
+ *
+ * libblconf:
+ *   cache__hit (channel, property)
+ *   cache__miss (channel, property)
+ *   dbus__call__start (channel, property, method)
+ *   dbus__call__done (channel, property, ok)
+ *   prefetch__start (channel, property_base)
+ *   prefetch__done (channel, property_base, ok)
+ *   set__send (channel, property, call)
+ *   set__reply (channel, call, ok)
+ *
+ * blconfd:
+ *   method__entry (method, sender)
+ *   method__return (method)
+ *   load__channel__start (channel)
+ *   load__channel__done (channel, ok)
+ *   flush__write__start (channel)
+ *   flush__write__done (channel, ok)
+ *   flush__sync__start (n_files)
+ *   flush__sync__done (ok)
+ */
+
+#ifdef BLCONF_ENABLE_PROBES
+
+#include <sys/sdt.h>
+
+#define BLCONF_PROBE1(name, a)        DTRACE_PROBE1(blconf, name, a)
+#define BLCONF_PROBE2(name, a, b)     DTRACE_PROBE2(blconf, name, a, b)
+#define BLCONF_PROBE3(name, a, b, c)  DTRACE_PROBE3(blconf, name, a, b, c)
+
+#else  /* !BLCONF_ENABLE_PROBES */
+
+/* the arguments still count as used, but are never evaluated */
+#define BLCONF_PROBE1(name, a) \
+    G_STMT_START{ if(0) { (void)(a); } }G_STMT_END
+#define BLCONF_PROBE2(name, a, b) \
+    G_STMT_START{ if(0) { (void)(a); (void)(b); } }G_STMT_END
+#define BLCONF_PROBE3(name, a, b, c) \
+    G_STMT_START{ if(0) { (void)(a); (void)(b); (void)(c); } }G_STMT_END
+
+#endif  /* BLCONF_ENABLE_PROBES */
+
+#endif  /* __BLCONF_PROBES_H__ */
@@ -0,0 +1,50 @@
+/*
+ *  blconf
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; version 2
+ *  of the License ONLY.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BLCONF_SNAPSHOT_H__
+#define __BLCONF_SNAPSHOT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Layout of the channel snapshots blconfd hands out through
+ * GetChannelSnapshot.  A snapshot is a sealed memfd holding this
+ * header, followed at BLCONF_SNAPSHOT_DATA_OFFSET by a serialized
+ * a{sv} of every property in the channel, sorted by name (in strcmp()
+ * order) so that clients can binary search it in place.  A snapshot
+ * never changes once published; a change to the channel makes the
+ * daemon publish a new one with a higher serial. */
+
+#define BLCONF_SNAPSHOT_MAGIC   0x504e5342  /* "BSNP" */
+#define BLCONF_SNAPSHOT_FORMAT  1
+
+typedef struct
+{
+    guint32 magic;
+    guint32 format;
+    guint64 serial;
+    guint64 data_size;
+} BlconfSnapshotHeader;
+
+/* GVariant wants its data 8-byte aligned */
+#define BLCONF_SNAPSHOT_DATA_OFFSET  ((sizeof(BlconfSnapshotHeader) + 7) & ~(gsize)7)
+
+G_END_DECLS
+
+#endif  /* __BLCONF_SNAPSHOT_H__ */
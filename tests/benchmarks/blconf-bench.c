@@ -0,0 +1,819 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* Runs a set of benchmarks against a private blconfd, started on its
+ * own session bus with its own, empty, configuration directories, and
+ * prints the results as one JSON object per line:
+ *
+ *   {"benchmark":"get-cached","unit":"us","n":200000,"min":...,"p50":...,"p90":...,"p99":...,"max":...}
+ *   {"benchmark":"get-all","properties":1000,"unit":"properties/s","value":...}
+ *
+ * Latencies are in microseconds.  Pass benchmark names on the command
+ * line to run only those.  The blconfd to start is taken from $BLCONFD,
+ * or looked up in $PATH. */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+#ifdef HAVE_SYS_TYPES_H
+#include <sys/types.h>
+#endif
+
+#ifdef HAVE_SIGNAL_H
+#include <signal.h>
+#endif
+
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <blconf/blconf.h>
+
+#define BENCH_START_TIMEOUT     15  /* seconds */
+#define BENCH_FANOUT_TIMEOUT    5   /* seconds */
+
+#define BENCH_GET_CACHED_ROUNDS     2000
+#define BENCH_GET_CACHED_BATCH      100  /* calls timed together */
+#define BENCH_GET_UNCACHED_ROUNDS   2000
+#define BENCH_SET_ROUNDS            2000
+#define BENCH_GET_ALL_ROUNDS        20
+#define BENCH_COLD_PROPERTIES       10000
+#define BENCH_FLUSH_CHANNELS        20
+#define BENCH_FLUSH_PROPERTIES      1000
+#define BENCH_FANOUT_ROUNDS         200
+#define BENCH_RSS_CHANNELS          50
+#define BENCH_RSS_PROPERTIES        200
+
+static const guint bench_get_all_sizes[] = { 10, 100, 1000, 10000 };
+static const guint bench_fanout_clients[] = { 1, 10, 50 };
+
+static GTestDBus *bench_bus = NULL;
+static GDBusConnection *bench_conn = NULL;
+static gchar *bench_dir = NULL;
+static GPid bench_daemon_pid = 0;
+static guint bench_daemon_starts = 0;
+
+/* results */
+
+static gint
+bench_compare_samples(gconstpointer a,
+                      gconstpointer b)
+{
+    gdouble da = *(const gdouble *)a, db = *(const gdouble *)b;
+
+    return da < db ? -1 : (da > db ? 1 : 0);
+}
+
+static gdouble
+bench_percentile(GArray *samples,
+                 guint percent)
+{
+    return g_array_index(samples, gdouble, (samples->len - 1) * percent / 100);
+}
+
+/* @params is either NULL or a JSON fragment like "\"properties\":10"
+ * that tells apart the results of one benchmark */
+static void
+bench_report_samples(const gchar *benchmark,
+                     const gchar *params,
+                     GArray *samples)
+{
+    if(!samples->len)
+        return;
+
+    g_array_sort(samples, bench_compare_samples);
+
+    g_print("{\"benchmark\":\"%s\",%s%s\"unit\":\"us\",\"n\":%u,"
+            "\"min\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}\n",
+            benchmark, params ? params : "", params ? "," : "",
+            samples->len,
+            g_array_index(samples, gdouble, 0),
+            bench_percentile(samples, 50),
+            bench_percentile(samples, 90),
+            bench_percentile(samples, 99),
+            g_array_index(samples, gdouble, samples->len - 1));
+}
+
+static void
+bench_report_value(const gchar *benchmark,
+                   const gchar *params,
+                   const gchar *unit,
+                   gdouble value)
+{
+    g_print("{\"benchmark\":\"%s\",%s%s\"unit\":\"%s\",\"value\":%.3f}\n",
+            benchmark, params ? params : "", params ? "," : "",
+            unit, value);
+}
+
+/* the private daemon */
+
+static gboolean
+bench_daemon_wait(void)
+{
+    gint64 deadline = g_get_monotonic_time() + BENCH_START_TIMEOUT * G_USEC_PER_SEC;
+    GVariant *ret;
+
+    while(!(ret = g_dbus_connection_call_sync(bench_conn,
+                                              "org.blade.Blconf",
+                                              "/org/blade/Blconf",
+                                              "org.freedesktop.DBus.Peer",
+                                              "Ping", NULL, NULL,
+                                              G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                              -1, NULL, NULL)))
+    {
+        if(g_get_monotonic_time() > deadline) {
+            g_critical("blconfd failed to start after %d seconds",
+                       BENCH_START_TIMEOUT);
+            return FALSE;
+        }
+        g_usleep(10 * 1000);
+    }
+    g_variant_unref(ret);
+
+    return TRUE;
+}
+
+static gboolean
+bench_daemon_start(void)
+{
+    const gchar *blconfd = g_getenv("BLCONFD");
+    gchar *argv[] = { (gchar *)(blconfd ? blconfd : "blconfd"), NULL };
+    gchar *cache_dir;
+    GError *error = NULL;
+
+    /* a fresh cache directory each time, so the daemon has no list of
+     * channels from a previous run to preload */
+    cache_dir = g_strdup_printf("%s/cache-%u", bench_dir, ++bench_daemon_starts);
+    g_setenv("XDG_CACHE_HOME", cache_dir, TRUE);
+    g_free(cache_dir);
+
+    if(!g_spawn_async(NULL, argv, NULL,
+                      G_SPAWN_DO_NOT_REAP_CHILD | G_SPAWN_SEARCH_PATH,
+                      NULL, NULL, &bench_daemon_pid, &error))
+    {
+        g_critical("Failed to start %s: %s", argv[0], error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    return bench_daemon_wait();
+}
+
+/* returns how long the daemon took to exit, in microseconds; it
+ * writes out every channel with unsaved changes before it does */
+static gdouble
+bench_daemon_stop(void)
+{
+    gint64 start;
+    int status;
+
+    if(!bench_daemon_pid)
+        return 0;
+
+    start = g_get_monotonic_time();
+    kill(bench_daemon_pid, SIGTERM);
+    waitpid(bench_daemon_pid, &status, 0);
+    g_spawn_close_pid(bench_daemon_pid);
+    bench_daemon_pid = 0;
+
+    return g_get_monotonic_time() - start;
+}
+
+static void
+bench_value_free(GValue *value)
+{
+    g_value_unset(value);
+    g_free(value);
+}
+
+/* fills @channel_name with @n_properties properties, half strings
+ * and half ints, in one call */
+static gboolean
+bench_populate(const gchar *channel_name,
+               guint n_properties)
+{
+    BlconfChannel *channel;
+    GHashTable *properties;
+    gboolean ret;
+    guint i;
+
+    properties = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                       (GDestroyNotify)g_free,
+                                       (GDestroyNotify)bench_value_free);
+    for(i = 0; i < n_properties; ++i) {
+        GValue *value = g_new0(GValue, 1);
+
+        if(i % 2) {
+            g_value_init(value, G_TYPE_INT);
+            g_value_set_int(value, i);
+        } else {
+            g_value_init(value, G_TYPE_STRING);
+            g_value_take_string(value, g_strdup_printf("bench value %u", i));
+        }
+
+        g_hash_table_insert(properties,
+                            g_strdup_printf("/bench/group%u/property%u", i / 100, i),
+                            value);
+    }
+
+    channel = blconf_channel_new_full(channel_name, NULL, BLCONF_CHANNEL_PREFETCH_NONE);
+    ret = blconf_channel_set_properties(channel, properties);
+    g_object_unref(channel);
+
+    g_hash_table_destroy(properties);
+
+    if(!ret)
+        g_critical("Failed to fill channel \"%s\"", channel_name);
+
+    return ret;
+}
+
+/* benchmarks */
+
+static gboolean
+bench_get_cached(void)
+{
+    BlconfChannel *channel;
+    GArray *samples = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                        BENCH_GET_CACHED_ROUNDS);
+    guint i, j;
+
+    if(!bench_populate("bench-get-cached", 100))
+        return FALSE;
+
+    channel = blconf_channel_new_full("bench-get-cached", NULL, BLCONF_CHANNEL_PREFETCH_FULL);
+
+    /* a cached read is well below the clock's resolution, so calls are
+     * timed in batches, and each sample is the batch's average */
+    for(i = 0; i < BENCH_GET_CACHED_ROUNDS; ++i) {
+        gint64 start = g_get_monotonic_time();
+        gdouble sample;
+
+        for(j = 0; j < BENCH_GET_CACHED_BATCH; ++j)
+            blconf_channel_get_int(channel, "/bench/group0/property1", 0);
+
+        sample = (gdouble)(g_get_monotonic_time() - start) / BENCH_GET_CACHED_BATCH;
+        g_array_append_val(samples, sample);
+    }
+
+    g_object_unref(channel);
+
+    bench_report_samples("get-cached", NULL, samples);
+    g_array_free(samples, TRUE);
+
+    return TRUE;
+}
+
+static gboolean
+bench_get_uncached(void)
+{
+    BlconfChannel *channel;
+    GArray *samples = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                        BENCH_GET_UNCACHED_ROUNDS);
+    guint i;
+
+    if(!bench_populate("bench-get-uncached", BENCH_GET_UNCACHED_ROUNDS * 2))
+        return FALSE;
+
+    /* every read is of a property the client hasn't seen yet */
+    channel = blconf_channel_new_full("bench-get-uncached", NULL, BLCONF_CHANNEL_PREFETCH_NONE);
+
+    for(i = 0; i < BENCH_GET_UNCACHED_ROUNDS; ++i) {
+        gchar property[64];
+        gint64 start;
+        gdouble sample;
+
+        g_snprintf(property, sizeof(property), "/bench/group%u/property%u",
+                   (i * 2 + 1) / 100, i * 2 + 1);
+
+        start = g_get_monotonic_time();
+        blconf_channel_get_int(channel, property, 0);
+        sample = g_get_monotonic_time() - start;
+        g_array_append_val(samples, sample);
+    }
+
+    g_object_unref(channel);
+
+    bench_report_samples("get-uncached", NULL, samples);
+    g_array_free(samples, TRUE);
+
+    return TRUE;
+}
+
+static gboolean
+bench_set(void)
+{
+    BlconfChannel *channel;
+    GArray *samples = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                        BENCH_SET_ROUNDS);
+    guint i;
+
+    channel = blconf_channel_new_full("bench-set", NULL, BLCONF_CHANNEL_PREFETCH_NONE);
+
+    for(i = 0; i < BENCH_SET_ROUNDS; ++i) {
+        gint64 start = g_get_monotonic_time();
+        gdouble sample;
+
+        if(!blconf_channel_set_int(channel, "/bench/counter", i)) {
+            g_critical("Failed to set \"/bench/counter\"");
+            break;
+        }
+
+        sample = g_get_monotonic_time() - start;
+        g_array_append_val(samples, sample);
+    }
+
+    g_object_unref(channel);
+
+    bench_report_samples("set", NULL, samples);
+    g_array_free(samples, TRUE);
+
+    return i == BENCH_SET_ROUNDS;
+}
+
+static gboolean
+bench_get_all(void)
+{
+    guint s;
+
+    for(s = 0; s < G_N_ELEMENTS(bench_get_all_sizes); ++s) {
+        guint size = bench_get_all_sizes[s];
+        GArray *samples = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                            BENCH_GET_ALL_ROUNDS);
+        gchar channel_name[64], params[64];
+        BlconfChannel *channel;
+        gdouble total = 0;
+        guint i;
+
+        g_snprintf(channel_name, sizeof(channel_name), "bench-get-all-%u", size);
+        if(!bench_populate(channel_name, size)) {
+            g_array_free(samples, TRUE);
+            return FALSE;
+        }
+
+        channel = blconf_channel_new_full(channel_name, NULL, BLCONF_CHANNEL_PREFETCH_NONE);
+
+        for(i = 0; i < BENCH_GET_ALL_ROUNDS; ++i) {
+            GHashTable *properties;
+            gint64 start = g_get_monotonic_time();
+            gdouble sample;
+
+            properties = blconf_channel_get_properties(channel, NULL);
+            sample = g_get_monotonic_time() - start;
+
+            if(!properties || g_hash_table_size(properties) != size) {
+                g_critical("GetAllProperties on \"%s\" returned the wrong properties",
+                           channel_name);
+                if(properties)
+                    g_hash_table_destroy(properties);
+                g_object_unref(channel);
+                g_array_free(samples, TRUE);
+                return FALSE;
+            }
+            g_hash_table_destroy(properties);
+
+            g_array_append_val(samples, sample);
+            total += sample;
+        }
+
+        g_object_unref(channel);
+
+        g_snprintf(params, sizeof(params), "\"properties\":%u", size);
+        bench_report_samples("get-all", params, samples);
+        bench_report_value("get-all", params, "properties/s",
+                           size * BENCH_GET_ALL_ROUNDS * G_USEC_PER_SEC / total);
+        g_array_free(samples, TRUE);
+    }
+
+    return TRUE;
+}
+
+static gboolean
+bench_flush(void)
+{
+    gchar params[64];
+    guint i;
+
+    for(i = 0; i < BENCH_FLUSH_CHANNELS; ++i) {
+        gchar channel_name[64];
+
+        g_snprintf(channel_name, sizeof(channel_name), "bench-flush-%u", i);
+        if(!bench_populate(channel_name, BENCH_FLUSH_PROPERTIES))
+            return FALSE;
+    }
+
+    /* the daemon saves everything that is still dirty, and syncs it
+     * to disk, before it exits */
+    g_snprintf(params, sizeof(params), "\"channels\":%u,\"properties\":%u",
+               BENCH_FLUSH_CHANNELS, BENCH_FLUSH_PROPERTIES);
+    bench_report_value("flush", params, "us", bench_daemon_stop());
+
+    return bench_daemon_start();
+}
+
+static gdouble
+bench_time_get_all(const gchar *channel_name)
+{
+    GVariant *ret;
+    gint64 start = g_get_monotonic_time();
+
+    /* straight to the daemon, so it isn't answered by the client's
+     * cache */
+    ret = g_dbus_connection_call_sync(bench_conn,
+                                      "org.blade.Blconf",
+                                      "/org/blade/Blconf",
+                                      "org.blade.Blconf",
+                                      "GetAllProperties",
+                                      g_variant_new("(ss)", channel_name, "/"),
+                                      G_VARIANT_TYPE("(a{sv})"),
+                                      G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                      -1, NULL, NULL);
+    if(!ret)
+        return -1;
+    g_variant_unref(ret);
+
+    return g_get_monotonic_time() - start;
+}
+
+static gboolean
+bench_cold_load(void)
+{
+    gchar params[64];
+    gdouble cold, warm;
+
+    if(!bench_populate("bench-cold", BENCH_COLD_PROPERTIES))
+        return FALSE;
+
+    bench_daemon_stop();
+    if(!bench_daemon_start())
+        return FALSE;
+
+    cold = bench_time_get_all("bench-cold");
+    warm = bench_time_get_all("bench-cold");
+    if(cold < 0 || warm < 0) {
+        g_critical("GetAllProperties on \"bench-cold\" failed");
+        return FALSE;
+    }
+
+    g_snprintf(params, sizeof(params), "\"properties\":%u", BENCH_COLD_PROPERTIES);
+    bench_report_value("load-cold", params, "us", cold);
+    bench_report_value("load-warm", params, "us", warm);
+
+    return TRUE;
+}
+
+typedef struct
+{
+    GMainLoop *loop;
+    GArray *samples;
+    guint pending;
+} BenchFanout;
+
+static void
+bench_fanout_signal(GDBusConnection *connection,
+                    const gchar *sender_name,
+                    const gchar *object_path,
+                    const gchar *interface_name,
+                    const gchar *signal_name,
+                    GVariant *parameters,
+                    gpointer user_data)
+{
+    BenchFanout *fanout = user_data;
+    GVariant *changed, *stamp;
+    gint64 now = g_get_monotonic_time();
+
+    changed = g_variant_get_child_value(parameters, 1);
+    stamp = g_variant_lookup_value(changed, "/bench/stamp", G_VARIANT_TYPE_UINT64);
+    if(stamp) {
+        gdouble sample = now - (gint64)g_variant_get_uint64(stamp);
+
+        g_array_append_val(fanout->samples, sample);
+        if(--fanout->pending == 0)
+            g_main_loop_quit(fanout->loop);
+        g_variant_unref(stamp);
+    }
+    g_variant_unref(changed);
+}
+
+static gboolean
+bench_fanout_timeout(gpointer data)
+{
+    BenchFanout *fanout = data;
+
+    g_critical("Only %u clients were left waiting for a change", fanout->pending);
+    g_main_loop_quit(fanout->loop);
+
+    return FALSE;
+}
+
+static gboolean
+bench_fanout(void)
+{
+    gchar *address;
+    GError *error = NULL;
+    gboolean ret = TRUE;
+    guint c;
+
+    address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if(!address) {
+        g_critical("Failed to get the bus address: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    for(c = 0; ret && c < G_N_ELEMENTS(bench_fanout_clients); ++c) {
+        guint n_clients = bench_fanout_clients[c];
+        GDBusConnection **clients = g_new0(GDBusConnection *, n_clients);
+        guint *subscriptions = g_new0(guint, n_clients);
+        BlconfChannel *channel;
+        BenchFanout fanout;
+        gchar params[64];
+        guint i;
+
+        fanout.loop = g_main_loop_new(NULL, FALSE);
+        fanout.samples = g_array_sized_new(FALSE, FALSE, sizeof(gdouble),
+                                           n_clients * BENCH_FANOUT_ROUNDS);
+
+        /* every client is a connection of its own, the way separate
+         * processes would be */
+        for(i = 0; i < n_clients; ++i) {
+            clients[i] = g_dbus_connection_new_for_address_sync(address,
+                                                                G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                                                                | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                                NULL, NULL, &error);
+            if(!clients[i]) {
+                g_critical("Failed to connect client %u: %s", i, error->message);
+                g_clear_error(&error);
+                ret = FALSE;
+                break;
+            }
+
+            subscriptions[i] = g_dbus_connection_signal_subscribe(clients[i],
+                                                                  "org.blade.Blconf",
+                                                                  "org.blade.Blconf",
+                                                                  "PropertiesChanged",
+                                                                  "/org/blade/Blconf",
+                                                                  "bench-fanout",
+                                                                  G_DBUS_SIGNAL_FLAGS_NONE,
+                                                                  bench_fanout_signal,
+                                                                  &fanout, NULL);
+        }
+
+        channel = blconf_channel_new_full("bench-fanout", NULL, BLCONF_CHANNEL_PREFETCH_NONE);
+
+        for(i = 0; ret && i < BENCH_FANOUT_ROUNDS; ++i) {
+            guint timeout_id;
+
+            fanout.pending = n_clients;
+            if(!blconf_channel_set_uint64(channel, "/bench/stamp", g_get_monotonic_time())) {
+                g_critical("Failed to set \"/bench/stamp\"");
+                ret = FALSE;
+                break;
+            }
+
+            timeout_id = g_timeout_add_seconds(BENCH_FANOUT_TIMEOUT,
+                                               bench_fanout_timeout, &fanout);
+            g_main_loop_run(fanout.loop);
+            g_source_remove(timeout_id);
+
+            if(fanout.pending)
+                ret = FALSE;
+        }
+
+        g_object_unref(channel);
+
+        for(i = 0; i < n_clients && clients[i]; ++i) {
+            g_dbus_connection_signal_unsubscribe(clients[i], subscriptions[i]);
+            g_dbus_connection_close_sync(clients[i], NULL, NULL);
+            g_object_unref(clients[i]);
+        }
+        g_free(subscriptions);
+        g_free(clients);
+
+        if(ret) {
+            g_snprintf(params, sizeof(params), "\"clients\":%u", n_clients);
+            bench_report_samples("fanout", params, fanout.samples);
+        }
+
+        g_array_free(fanout.samples, TRUE);
+        g_main_loop_unref(fanout.loop);
+    }
+
+    g_free(address);
+
+    return ret;
+}
+
+/* in bytes, or -1 where there's no /proc */
+static gint64
+bench_resident_size(void)
+{
+    gchar *contents = NULL;
+    gint64 pages = -1;
+
+    if(g_file_get_contents("/proc/self/statm", &contents, NULL, NULL)) {
+        gchar *p = strchr(contents, ' ');
+
+        if(p)
+            pages = g_ascii_strtoll(p + 1, NULL, 10);
+        g_free(contents);
+    }
+
+    return pages < 0 ? -1 : pages * sysconf(_SC_PAGESIZE);
+}
+
+static gboolean
+bench_rss(void)
+{
+    BlconfChannel *channels[BENCH_RSS_CHANNELS];
+    gchar channel_name[64], params[64];
+    gint64 before, after;
+    guint i;
+
+    if(bench_resident_size() < 0) {
+        g_message("Skipping the rss benchmark: no /proc/self/statm");
+        return TRUE;
+    }
+
+    for(i = 0; i < BENCH_RSS_CHANNELS; ++i) {
+        g_snprintf(channel_name, sizeof(channel_name), "bench-rss-%u", i);
+        if(!bench_populate(channel_name, BENCH_RSS_PROPERTIES))
+            return FALSE;
+    }
+
+    before = bench_resident_size();
+    for(i = 0; i < BENCH_RSS_CHANNELS; ++i) {
+        g_snprintf(channel_name, sizeof(channel_name), "bench-rss-%u", i);
+        channels[i] = blconf_channel_new_full(channel_name, NULL, BLCONF_CHANNEL_PREFETCH_FULL);
+    }
+    after = bench_resident_size();
+
+    for(i = 0; i < BENCH_RSS_CHANNELS; ++i)
+        g_object_unref(channels[i]);
+
+    g_snprintf(params, sizeof(params), "\"properties\":%u", BENCH_RSS_PROPERTIES);
+    bench_report_value("rss-per-channel", params, "bytes",
+                       (gdouble)(after - before) / BENCH_RSS_CHANNELS);
+
+    return TRUE;
+}
+
+static const struct
+{
+    const gchar *name;
+    gboolean (*run)(void);
+} benchmarks[] = {
+    { "get-cached", bench_get_cached },
+    { "get-uncached", bench_get_uncached },
+    { "set", bench_set },
+    { "get-all", bench_get_all },
+    { "flush", bench_flush },
+    { "load-cold", bench_cold_load },
+    { "fanout", bench_fanout },
+    { "rss", bench_rss },
+};
+
+static gboolean
+bench_selected(const gchar *name,
+               int argc,
+               char **argv)
+{
+    int i;
+
+    if(argc < 2)
+        return TRUE;
+
+    for(i = 1; i < argc; ++i) {
+        if(!strcmp(argv[i], name))
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+bench_remove_dir(const gchar *path)
+{
+    GDir *dir = g_dir_open(path, 0, NULL);
+    const gchar *name;
+
+    if(dir) {
+        while((name = g_dir_read_name(dir))) {
+            gchar *child = g_build_filename(path, name, NULL);
+
+            if(g_file_test(child, G_FILE_TEST_IS_DIR))
+                bench_remove_dir(child);
+            else
+                g_unlink(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+
+    g_rmdir(path);
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    GError *error = NULL;
+    gchar *config_dir;
+    int ret = EXIT_SUCCESS;
+    guint i;
+
+#if !GLIB_CHECK_VERSION(2,36,0)
+    g_type_init();
+#endif
+
+    bench_dir = g_dir_make_tmp("blconf-bench-XXXXXX", &error);
+    if(!bench_dir) {
+        g_critical("Failed to create a temporary directory: %s", error->message);
+        g_error_free(error);
+        return EXIT_FAILURE;
+    }
+
+    config_dir = g_build_filename(bench_dir, "config", NULL);
+    g_setenv("XDG_CONFIG_HOME", config_dir, TRUE);
+    g_free(config_dir);
+
+    /* a bus of our own; this also points DBUS_SESSION_BUS_ADDRESS at it */
+    bench_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bench_bus);
+
+    bench_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if(!bench_conn) {
+        g_critical("Failed to connect to D-Bus: %s", error->message);
+        g_error_free(error);
+        ret = EXIT_FAILURE;
+        goto out;
+    }
+
+    if(!bench_daemon_start()) {
+        ret = EXIT_FAILURE;
+        goto out;
+    }
+
+    if(!blconf_init(&error)) {
+        g_critical("Failed to init libblconf: %s", error->message);
+        g_error_free(error);
+        ret = EXIT_FAILURE;
+        goto out;
+    }
+
+    for(i = 0; i < G_N_ELEMENTS(benchmarks); ++i) {
+        if(bench_selected(benchmarks[i].name, argc, argv)
+           && !benchmarks[i].run())
+        {
+            g_critical("Benchmark \"%s\" failed", benchmarks[i].name);
+            ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    blconf_shutdown();
+
+out:
+    bench_daemon_stop();
+    if(bench_conn)
+        g_object_unref(bench_conn);
+    g_test_dbus_down(bench_bus);
+    g_object_unref(bench_bus);
+
+    bench_remove_dir(bench_dir);
+    g_free(bench_dir);
+
+    return ret;
+}
@@ -0,0 +1,116 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define HANDOFF_CHANNEL_NAME  "test-handoff-channel"
+
+static gchar *
+get_owner(GDBusConnection *dbus_conn)
+{
+    GVariant *ret;
+    gchar *owner = NULL;
+
+    ret = g_dbus_connection_call_sync(dbus_conn,
+                                      "org.freedesktop.DBus",
+                                      "/org/freedesktop/DBus",
+                                      "org.freedesktop.DBus",
+                                      "GetNameOwner",
+                                      g_variant_new("(s)", "org.blade.Blconf"),
+                                      G_VARIANT_TYPE("(s)"),
+                                      G_DBUS_CALL_FLAGS_NONE, -1,
+                                      NULL, NULL);
+    if(ret) {
+        g_variant_get(ret, "(s)", &owner);
+        g_variant_unref(ret);
+    }
+
+    return owner;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GDBusConnection *dbus_conn;
+    GVariant *ret, *value;
+    gchar *argv_replace[3] = { NULL, "--replace", NULL };
+    gchar *old_owner, *new_owner = NULL;
+    GTimeVal start, now;
+
+    /* needs a daemon binary to start */
+    if(!g_getenv("BLCONFD"))
+        return 77;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(HANDOFF_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_string(channel, test_string_property,
+                                             test_string));
+    g_object_unref(G_OBJECT(channel));
+
+    dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    TEST_OPERATION(dbus_conn != NULL);
+    old_owner = get_owner(dbus_conn);
+    TEST_OPERATION(old_owner != NULL);
+
+    argv_replace[0] = (gchar *)g_getenv("BLCONFD");
+    TEST_OPERATION(g_spawn_async(NULL, argv_replace, NULL, 0, NULL, NULL,
+                                 NULL, NULL));
+
+    /* the name changes hands without ever being unowned */
+    g_get_current_time(&start);
+    do {
+        g_free(new_owner);
+        new_owner = get_owner(dbus_conn);
+        TEST_OPERATION(new_owner != NULL);
+        g_get_current_time(&now);
+        TEST_OPERATION(now.tv_sec - start.tv_sec <= WAIT_TIMEOUT);
+    } while(!g_strcmp0(old_owner, new_owner));
+
+    /* straight from the new daemon, not our cache */
+    ret = g_dbus_connection_call_sync(dbus_conn, new_owner,
+                                      "/org/blade/Blconf",
+                                      "org.blade.Blconf",
+                                      "GetProperty",
+                                      g_variant_new("(ss)",
+                                                    HANDOFF_CHANNEL_NAME,
+                                                    test_string_property),
+                                      G_VARIANT_TYPE("(v)"),
+                                      G_DBUS_CALL_FLAGS_NONE, -1,
+                                      NULL, NULL);
+    TEST_OPERATION(ret != NULL);
+    g_variant_get(ret, "(v)", &value);
+    TEST_OPERATION(g_variant_is_of_type(value, G_VARIANT_TYPE_STRING));
+    TEST_OPERATION(!g_strcmp0(g_variant_get_string(value, NULL), test_string));
+    g_variant_unref(value);
+    g_variant_unref(ret);
+
+    g_free(old_owner);
+    g_free(new_owner);
+    g_object_unref(dbus_conn);
+
+    channel = blconf_channel_new(HANDOFF_CHANNEL_NAME);
+    blconf_channel_reset_property(channel, "/", TRUE);
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
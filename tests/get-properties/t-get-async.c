@@ -0,0 +1,141 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "tests-common.h"
+
+#define ASYNC_CHANNEL_NAME  "test-async-channel"
+
+static GMainLoop *loop = NULL;
+static gint pending = 0;
+
+static void
+done(void)
+{
+    if(--pending == 0)
+        g_main_loop_quit(loop);
+}
+
+static void
+got_string(GObject *source_object,
+           GAsyncResult *res,
+           gpointer user_data)
+{
+    GValue value = { 0, };
+
+    TEST_OPERATION(blconf_channel_get_property_finish(BLCONF_CHANNEL(source_object),
+                                                      res, &value, NULL));
+    TEST_OPERATION(G_VALUE_HOLDS_STRING(&value)
+                   && !strcmp(g_value_get_string(&value), "one"));
+    g_value_unset(&value);
+
+    done();
+}
+
+static void
+got_int_as_string(GObject *source_object,
+                  GAsyncResult *res,
+                  gpointer user_data)
+{
+    GValue value = { 0, };
+
+    g_value_init(&value, G_TYPE_STRING);
+    TEST_OPERATION(blconf_channel_get_property_finish(BLCONF_CHANNEL(source_object),
+                                                      res, &value, NULL));
+    TEST_OPERATION(!strcmp(g_value_get_string(&value), "2"));
+    g_value_unset(&value);
+
+    done();
+}
+
+static void
+got_missing(GObject *source_object,
+            GAsyncResult *res,
+            gpointer user_data)
+{
+    GError *error = NULL;
+
+    TEST_OPERATION(!blconf_channel_has_property_finish(BLCONF_CHANNEL(source_object),
+                                                       res, &error));
+    TEST_OPERATION(error == NULL);
+
+    done();
+}
+
+static void
+got_properties(GObject *source_object,
+               GAsyncResult *res,
+               gpointer user_data)
+{
+    GHashTable *properties;
+
+    properties = blconf_channel_get_properties_finish(BLCONF_CHANNEL(source_object),
+                                                      res, NULL);
+    TEST_OPERATION(properties && g_hash_table_size(properties) == 2);
+    g_hash_table_destroy(properties);
+
+    done();
+}
+
+/* the reader starts with an empty cache, so both lookups of
+ * /async/a miss at the same time and share one call */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *writer, *reader;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    writer = blconf_channel_new(ASYNC_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_string(writer, "/async/a", "one"));
+    TEST_OPERATION(blconf_channel_set_int(writer, "/async/b", 2));
+    g_object_unref(G_OBJECT(writer));
+
+    reader = blconf_channel_new(ASYNC_CHANNEL_NAME);
+    loop = g_main_loop_new(NULL, FALSE);
+
+    pending = 5;
+    blconf_channel_get_property_async(reader, "/async/a", NULL,
+                                      got_string, NULL);
+    blconf_channel_get_property_async(reader, "/async/a", NULL,
+                                      got_string, NULL);
+    blconf_channel_get_property_async(reader, "/async/b", NULL,
+                                      got_int_as_string, NULL);
+    blconf_channel_has_property_async(reader, "/async/nonexistent", NULL,
+                                      got_missing, NULL);
+    blconf_channel_get_properties_async(reader, "/async", NULL,
+                                        got_properties, NULL);
+    g_main_loop_run(loop);
+
+    /* now served from the cache, still through the main loop */
+    pending = 1;
+    blconf_channel_get_property_async(reader, "/async/a", NULL,
+                                      got_string, NULL);
+    g_main_loop_run(loop);
+
+    g_main_loop_unref(loop);
+
+    blconf_channel_reset_property(reader, "/", TRUE);
+    g_object_unref(G_OBJECT(reader));
+
+    blconf_tests_end();
+
+    return 0;
+}
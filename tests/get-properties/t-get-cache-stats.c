@@ -0,0 +1,76 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define STATS_CHANNEL_NAME  "test-stats-channel"
+
+static guint64
+get_stat(BlconfChannel *channel,
+         const gchar *name)
+{
+    GHashTable *stats = blconf_channel_get_cache_stats(channel);
+    GValue *value = g_hash_table_lookup(stats, name);
+    guint64 ret = G_MAXUINT64;
+
+    if(value && G_VALUE_HOLDS_UINT64(value))
+        ret = g_value_get_uint64(value);
+    g_hash_table_destroy(stats);
+
+    return ret;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *writer, *reader;
+    guint64 trips;
+    gint i;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    writer = blconf_channel_new(STATS_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_int(writer, "/stats/a", 1));
+    TEST_OPERATION(blconf_channel_set_int(writer, "/stats/b", 2));
+    g_object_unref(G_OBJECT(writer));
+
+    reader = blconf_channel_new(STATS_CHANNEL_NAME);
+
+    /* the first read may go to the daemon, the rest never */
+    TEST_OPERATION(blconf_channel_get_int(reader, "/stats/a", -1) == 1);
+    trips = get_stat(reader, "round-trips");
+    TEST_OPERATION(trips != G_MAXUINT64);
+    for(i = 0; i < 10; ++i)
+        TEST_OPERATION(blconf_channel_get_int(reader, "/stats/a", -1) == 1);
+    TEST_OPERATION(get_stat(reader, "round-trips") == trips);
+    TEST_OPERATION(get_stat(reader, "hits") >= 10);
+    TEST_OPERATION(get_stat(reader, "entries") >= 1);
+    TEST_OPERATION(get_stat(reader, "bytes") > 0);
+
+    /* a property that isn't there is a miss */
+    TEST_OPERATION(blconf_channel_get_int(reader, "/stats/none", -1) == -1);
+    TEST_OPERATION(get_stat(reader, "misses") >= 1);
+
+    blconf_channel_reset_property(reader, "/", TRUE);
+    g_object_unref(G_OBJECT(reader));
+
+    blconf_tests_end();
+
+    return 0;
+}
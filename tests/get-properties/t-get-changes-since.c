@@ -0,0 +1,138 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define CHANGES_CHANNEL_NAME  "test-changes-channel"
+
+static GVariant *
+get_changes_since(GDBusConnection *dbus_conn,
+                  guint64 since)
+{
+    return g_dbus_connection_call_sync(dbus_conn,
+                                       "org.blade.Blconf",
+                                       "/org/blade/Blconf",
+                                       "org.blade.Blconf",
+                                       "GetChangesSince",
+                                       g_variant_new("(st)",
+                                                     CHANGES_CHANNEL_NAME,
+                                                     since),
+                                       G_VARIANT_TYPE("(tba{sv}as)"),
+                                       G_DBUS_CALL_FLAGS_NONE, -1,
+                                       NULL, NULL);
+}
+
+static gboolean
+call_sync(GDBusConnection *dbus_conn,
+          const gchar *method,
+          GVariant *parameters)
+{
+    GVariant *ret = g_dbus_connection_call_sync(dbus_conn,
+                                                "org.blade.Blconf",
+                                                "/org/blade/Blconf",
+                                                "org.blade.Blconf",
+                                                method, parameters, NULL,
+                                                G_DBUS_CALL_FLAGS_NONE, -1,
+                                                NULL, NULL);
+
+    if(!ret)
+        return FALSE;
+    g_variant_unref(ret);
+
+    return TRUE;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    GDBusConnection *dbus_conn;
+    GVariant *ret, *changed, *value;
+    const gchar **removed;
+    guint64 generation, generation2;
+    gboolean too_old;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    TEST_OPERATION(dbus_conn != NULL);
+
+    /* 0 only asks for the generation */
+    ret = get_changes_since(dbus_conn, 0);
+    TEST_OPERATION(ret != NULL);
+    g_variant_get(ret, "(tb@a{sv}^a&s)", &generation, &too_old, &changed,
+                  &removed);
+    TEST_OPERATION(too_old);
+    TEST_OPERATION(generation != 0);
+    g_variant_unref(changed);
+    g_free(removed);
+    g_variant_unref(ret);
+
+    /* a change shows up with its value */
+    TEST_OPERATION(call_sync(dbus_conn, "SetProperty",
+                             g_variant_new("(ssv)", CHANGES_CHANNEL_NAME,
+                                           test_string_property,
+                                           g_variant_new_string(test_string))));
+    ret = get_changes_since(dbus_conn, generation);
+    TEST_OPERATION(ret != NULL);
+    g_variant_get(ret, "(tb@a{sv}^a&s)", &generation2, &too_old, &changed,
+                  &removed);
+    TEST_OPERATION(!too_old);
+    TEST_OPERATION(generation2 >= generation);
+    TEST_OPERATION(removed[0] == NULL);
+    value = g_variant_lookup_value(changed, test_string_property,
+                                   G_VARIANT_TYPE_STRING);
+    TEST_OPERATION(value != NULL);
+    TEST_OPERATION(!g_strcmp0(g_variant_get_string(value, NULL), test_string));
+    g_variant_unref(value);
+    g_variant_unref(changed);
+    g_free(removed);
+    g_variant_unref(ret);
+
+    /* and a removal as such */
+    TEST_OPERATION(call_sync(dbus_conn, "ResetProperty",
+                             g_variant_new("(ssb)", CHANGES_CHANNEL_NAME,
+                                           test_string_property, FALSE)));
+    ret = get_changes_since(dbus_conn, generation);
+    TEST_OPERATION(ret != NULL);
+    g_variant_get(ret, "(tb@a{sv}^a&s)", &generation2, &too_old, &changed,
+                  &removed);
+    TEST_OPERATION(!too_old);
+    TEST_OPERATION(g_variant_n_children(changed) == 0);
+    TEST_OPERATION(!g_strcmp0(removed[0], test_string_property));
+    TEST_OPERATION(removed[1] == NULL);
+    g_variant_unref(changed);
+    g_free(removed);
+    g_variant_unref(ret);
+
+    /* nor does it take numbers from some other daemon */
+    ret = get_changes_since(dbus_conn, G_MAXUINT64);
+    TEST_OPERATION(ret != NULL);
+    g_variant_get(ret, "(tb@a{sv}^a&s)", &generation2, &too_old, &changed,
+                  &removed);
+    TEST_OPERATION(too_old);
+    g_variant_unref(changed);
+    g_free(removed);
+    g_variant_unref(ret);
+
+    g_object_unref(dbus_conn);
+
+    blconf_tests_end();
+
+    return 0;
+}
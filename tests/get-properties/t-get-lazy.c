@@ -0,0 +1,71 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define LAZY_CHANNEL_NAME  "test-lazy-channel"
+
+static gboolean
+quit_loop(gpointer data)
+{
+    g_main_loop_quit(data);
+    return FALSE;
+}
+
+/* channels that don't prefetch everything up front still answer
+ * each read correctly, both before and after a background prefetch
+ * has come in */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GMainLoop *loop;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new_full(LAZY_CHANNEL_NAME, NULL,
+                                      BLCONF_CHANNEL_PREFETCH_NONE);
+    TEST_OPERATION(blconf_channel_set_int(channel, "/lazy/a", 1));
+    TEST_OPERATION(blconf_channel_set_string(channel, "/lazy/b", "b"));
+    TEST_OPERATION(blconf_channel_get_int(channel, "/lazy/a", -1) == 1);
+    g_object_unref(G_OBJECT(channel));
+
+    /* the last channel object took the cache with it, so this one
+     * starts from scratch */
+    channel = blconf_channel_new_full(LAZY_CHANNEL_NAME, "/lazy",
+                                      BLCONF_CHANNEL_PREFETCH_ASYNC);
+    TEST_OPERATION(blconf_channel_get_int(channel, "/a", -1) == 1);
+
+    loop = g_main_loop_new(NULL, FALSE);
+    g_timeout_add_seconds(1, quit_loop, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+
+    TEST_OPERATION(blconf_channel_get_int(channel, "/a", -1) == 1);
+    TEST_OPERATION(!blconf_channel_has_property(channel, "/c"));
+    TEST_OPERATION(blconf_channel_set_int(channel, "/c", 3));
+    TEST_OPERATION(blconf_channel_get_int(channel, "/c", -1) == 3);
+
+    blconf_channel_reset_property(channel, "/", TRUE);
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define LIMITED_CHANNEL_NAME  "test-limited-channel"
+#define N_PROPERTIES          8
+/* enough locked hits for the lock-free view to be published */
+#define N_VIEW_HITS           64
+
+static guint64
+get_cached_bytes(BlconfChannel *channel)
+{
+    GHashTable *stats = blconf_channel_get_cache_stats(channel);
+    GValue *value = g_hash_table_lookup(stats, "bytes");
+    guint64 bytes = value ? g_value_get_uint64(value) : 0;
+
+    g_hash_table_destroy(stats);
+
+    return bytes;
+}
+
+static gboolean
+read_many(BlconfChannel *channel,
+          gint n_reads)
+{
+    GValue value = { 0, };
+    gint i;
+
+    for(i = 0; i < n_reads; ++i) {
+        if(!blconf_channel_get_property(channel, "/limited/p1", &value))
+            return FALSE;
+        if(!G_VALUE_HOLDS_INT(&value) || g_value_get_int(&value) != 1) {
+            g_value_unset(&value);
+            return FALSE;
+        }
+        g_value_unset(&value);
+    }
+
+    return TRUE;
+}
+
+/* a cache that holds two entries has to drop and fetch properties
+ * again all the time; none of that may show in the values read */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *writer, *reader;
+    gchar property[32];
+    gint i, pass;
+    guint64 bytes;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    writer = blconf_channel_new(LIMITED_CHANNEL_NAME);
+    for(i = 0; i < N_PROPERTIES; ++i) {
+        g_snprintf(property, sizeof(property), "/limited/p%d", i);
+        TEST_OPERATION(blconf_channel_set_int(writer, property, i));
+    }
+    g_object_unref(G_OBJECT(writer));
+
+    reader = blconf_channel_new(LIMITED_CHANNEL_NAME);
+    blconf_channel_set_cache_limits(reader, 2, -1, 0);
+
+    for(pass = 0; pass < 2; ++pass) {
+        for(i = 0; i < N_PROPERTIES; ++i) {
+            g_snprintf(property, sizeof(property), "/limited/p%d", i);
+            TEST_OPERATION(blconf_channel_get_int(reader, property, -1) == i);
+        }
+    }
+
+    /* a write must survive its own eviction pressure */
+    TEST_OPERATION(blconf_channel_set_int(reader, "/limited/p0", 100));
+    for(i = 1; i < N_PROPERTIES; ++i) {
+        g_snprintf(property, sizeof(property), "/limited/p%d", i);
+        TEST_OPERATION(blconf_channel_get_int(reader, property, -1) == i);
+    }
+    TEST_OPERATION(blconf_channel_get_int(reader, "/limited/p0", -1) == 100);
+
+    /* a tiny byte limit works the same way */
+    blconf_channel_set_cache_limits(reader, -1, 1, 0);
+    for(i = 1; i < N_PROPERTIES; ++i) {
+        g_snprintf(property, sizeof(property), "/limited/p%d", i);
+        TEST_OPERATION(blconf_channel_get_int(reader, property, -1) == i);
+    }
+
+    /* the lock-free view's copies count towards the limits, and are
+     * the first thing to go when the cache is over them */
+    blconf_channel_set_cache_limits(reader, -1, -1, 0);
+    for(i = 1; i < N_PROPERTIES; ++i) {
+        g_snprintf(property, sizeof(property), "/limited/p%d", i);
+        TEST_OPERATION(blconf_channel_get_int(reader, property, -1) == i);
+    }
+    bytes = get_cached_bytes(reader);
+    TEST_OPERATION(read_many(reader, N_VIEW_HITS));
+    TEST_OPERATION(get_cached_bytes(reader) > bytes);
+
+    blconf_channel_set_cache_limits(reader, -1, bytes, 0);
+    TEST_OPERATION(get_cached_bytes(reader) <= bytes);
+    TEST_OPERATION(read_many(reader, N_VIEW_HITS));
+    TEST_OPERATION(get_cached_bytes(reader) <= bytes);
+
+    blconf_channel_reset_property(reader, "/", TRUE);
+    g_object_unref(G_OBJECT(reader));
+
+    blconf_tests_end();
+
+    return 0;
+}
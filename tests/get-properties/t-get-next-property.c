@@ -0,0 +1,83 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define N_WALKED_PROPS  5
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel, *based;
+    gchar prop[64], *name, *next;
+    gint i;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    /* "/test/walk-other" sorts between "/test/walk" and what's under
+     * it, but isn't part of the subtree */
+    TEST_OPERATION(blconf_channel_set_int(channel, "/test/walk", -1));
+    TEST_OPERATION(blconf_channel_set_int(channel, "/test/walk-other", -1));
+    for(i = 0; i < N_WALKED_PROPS; ++i) {
+        g_snprintf(prop, sizeof(prop), "/test/walk/prop%d", i);
+        TEST_OPERATION(blconf_channel_set_int(channel, prop, i));
+    }
+
+    based = blconf_channel_new_with_property_base(TEST_CHANNEL_NAME,
+                                                  "/test/walk");
+
+    /* the base itself comes first, then the rest in order */
+    name = blconf_channel_get_next_property(based, NULL);
+    TEST_OPERATION(!g_strcmp0(name, ""));
+    for(i = 0; i < N_WALKED_PROPS; ++i) {
+        next = blconf_channel_get_next_property(based, name);
+        g_free(name);
+        name = next;
+
+        g_snprintf(prop, sizeof(prop), "/prop%d", i);
+        TEST_OPERATION(!g_strcmp0(name, prop));
+    }
+    next = blconf_channel_get_next_property(based, name);
+    g_free(name);
+    TEST_OPERATION(next == NULL);
+
+    /* the whole channel sees both, and changes made since */
+    TEST_OPERATION(blconf_channel_set_int(channel, "/test/walk/prop00", 0));
+    name = blconf_channel_get_next_property(channel, "/test/walk");
+    TEST_OPERATION(!g_strcmp0(name, "/test/walk-other"));
+    g_free(name);
+    name = blconf_channel_get_next_property(channel, "/test/walk/prop0");
+    TEST_OPERATION(!g_strcmp0(name, "/test/walk/prop00"));
+    g_free(name);
+
+    g_object_unref(G_OBJECT(based));
+
+    blconf_channel_reset_property(channel, "/test/walk", TRUE);
+    blconf_channel_reset_property(channel, "/test/walk-other", FALSE);
+
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+/* a peeked string is kept by the channel until the property changes */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    const gchar *peeked;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    peeked = blconf_channel_peek_string(channel, test_string_property, NULL);
+    TEST_OPERATION(!g_strcmp0(peeked, test_string));
+    TEST_OPERATION(blconf_channel_peek_string(channel, test_string_property,
+                                              NULL) == peeked);
+
+    TEST_OPERATION(blconf_channel_set_string(channel, test_string_property,
+                                             "peeked"));
+    peeked = blconf_channel_peek_string(channel, test_string_property, NULL);
+    TEST_OPERATION(!g_strcmp0(peeked, "peeked"));
+
+    TEST_OPERATION(!g_strcmp0(blconf_channel_peek_string(channel,
+                                                         "/test/missing",
+                                                         "default"),
+                              "default"));
+
+    TEST_OPERATION(blconf_channel_set_string(channel, test_string_property,
+                                             test_string));
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
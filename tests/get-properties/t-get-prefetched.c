@@ -0,0 +1,71 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define FIRST_CHANNEL_NAME   "test-prefetch-first"
+#define SECOND_CHANNEL_NAME  "test-prefetch-second"
+
+/* several channels can be fetched at once, before any channel object
+ * exists for them */
+int
+main(int argc,
+     char **argv)
+{
+    const gchar *channels[] = {
+        FIRST_CHANNEL_NAME,
+        SECOND_CHANNEL_NAME "/sub",
+        NULL
+    };
+    BlconfChannel *first, *second;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    first = blconf_channel_new(FIRST_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_int(first, "/a", 1));
+    g_object_unref(G_OBJECT(first));
+
+    second = blconf_channel_new(SECOND_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_string(second, "/sub/b", "b"));
+    TEST_OPERATION(blconf_channel_set_string(second, "/other", "c"));
+    g_object_unref(G_OBJECT(second));
+
+    TEST_OPERATION(blconf_prefetch_channels(channels));
+
+    first = blconf_channel_new(FIRST_CHANNEL_NAME);
+    second = blconf_channel_new_with_property_base(SECOND_CHANNEL_NAME,
+                                                   "/sub");
+    TEST_OPERATION(blconf_channel_get_int(first, "/a", -1) == 1);
+    TEST_OPERATION(!blconf_channel_has_property(first, "/missing"));
+    TEST_OPERATION(blconf_channel_has_property(second, "/b"));
+    TEST_OPERATION(!blconf_channel_has_property(second, "/c"));
+    g_object_unref(G_OBJECT(second));
+
+    /* outside the prefetched subtree, it's fetched as usual */
+    second = blconf_channel_new(SECOND_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_has_property(second, "/other"));
+
+    blconf_channel_reset_property(first, "/", TRUE);
+    blconf_channel_reset_property(second, "/", TRUE);
+    g_object_unref(G_OBJECT(first));
+    g_object_unref(G_OBJECT(second));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+/* more than one page's worth */
+#define N_PAGED_PROPS  1000
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GHashTable *props;
+    gchar prop[64];
+    gint i;
+    
+    if(!blconf_tests_start())
+        return 1;
+    
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+    
+    for(i = 0; i < N_PAGED_PROPS; ++i) {
+        g_snprintf(prop, sizeof(prop), "/test/paged/prop%d", i);
+        TEST_OPERATION(blconf_channel_set_int(channel, prop, i));
+    }
+    
+    props = blconf_channel_get_properties(channel, "/test/paged");
+    TEST_OPERATION(props != NULL);
+    TEST_OPERATION(g_hash_table_size(props) == N_PAGED_PROPS);
+    for(i = 0; i < N_PAGED_PROPS; ++i) {
+        GValue *value;
+        
+        g_snprintf(prop, sizeof(prop), "/test/paged/prop%d", i);
+        value = g_hash_table_lookup(props, prop);
+        TEST_OPERATION(value && G_VALUE_HOLDS_INT(value)
+                       && g_value_get_int(value) == i);
+    }
+    g_hash_table_destroy(props);
+    
+    blconf_channel_reset_property(channel, "/test/paged", TRUE);
+    
+    g_object_unref(G_OBJECT(channel));
+    
+    blconf_tests_end();
+    
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define SHARED_CHANNEL_NAME  "test-shared-channel"
+
+static gint n_changes = 0;
+
+static void
+property_changed(BlconfChannel *channel,
+                 const gchar *property,
+                 const GValue *value,
+                 gpointer user_data)
+{
+    if(!g_strcmp0(property, user_data))
+        n_changes++;
+}
+
+/* channel objects for the same channel share one cache, so a write
+ * through one is seen by the others right away, without waiting for
+ * the daemon's signal */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *whole, *view;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    whole = blconf_channel_new(SHARED_CHANNEL_NAME);
+    view = blconf_channel_new_with_property_base(SHARED_CHANNEL_NAME,
+                                                 "/shared");
+    g_signal_connect(whole, "property-changed",
+                     G_CALLBACK(property_changed), "/shared/x");
+
+    TEST_OPERATION(blconf_channel_set_int(whole, "/shared/x", 1));
+    TEST_OPERATION(blconf_channel_get_int(view, "/x", -1) == 1);
+
+    TEST_OPERATION(blconf_channel_set_int(view, "/x", 2));
+    TEST_OPERATION(blconf_channel_get_int(whole, "/shared/x", -1) == 2);
+    TEST_OPERATION(n_changes == 2);
+
+    /* the cache outlives the first channel object */
+    g_object_unref(G_OBJECT(view));
+    TEST_OPERATION(blconf_channel_get_int(whole, "/shared/x", -1) == 2);
+
+    blconf_channel_reset_property(whole, "/", TRUE);
+    g_object_unref(G_OBJECT(whole));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "tests-common.h"
+
+#define SNAPSHOT_CHANNEL_NAME  "test-snapshot-channel"
+
+/* the second channel object starts with an empty cache, so its reads
+ * are served from the daemon's shared snapshot, if there is one; the
+ * results have to be the same either way */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *writer, *reader;
+    gchar *str;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    writer = blconf_channel_new(SNAPSHOT_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_string(writer, "/snapshot/a", "one"));
+    TEST_OPERATION(blconf_channel_set_int(writer, "/snapshot/b", 2));
+    TEST_OPERATION(blconf_channel_set_int(writer, "/snapshot/c", 3));
+    g_object_unref(G_OBJECT(writer));
+
+    reader = blconf_channel_new(SNAPSHOT_CHANNEL_NAME);
+
+    str = blconf_channel_get_string(reader, "/snapshot/a", NULL);
+    TEST_OPERATION(str && !strcmp(str, "one"));
+    g_free(str);
+    TEST_OPERATION(blconf_channel_get_int(reader, "/snapshot/b", -1) == 2);
+    TEST_OPERATION(!blconf_channel_has_property(reader, "/snapshot/nonexistent"));
+
+    /* a reset must hide the old value */
+    blconf_channel_reset_property(reader, "/snapshot/c", FALSE);
+    TEST_OPERATION(!blconf_channel_has_property(reader, "/snapshot/c"));
+
+    /* and new values win over it */
+    TEST_OPERATION(blconf_channel_set_int(reader, "/snapshot/b", 20));
+    TEST_OPERATION(blconf_channel_get_int(reader, "/snapshot/b", -1) == 20);
+
+    blconf_channel_reset_property(reader, "/", TRUE);
+    g_object_unref(G_OBJECT(reader));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+typedef struct
+{
+    guint16 red;
+    guint16 green;
+    guint16 blue;
+    gboolean visible;
+    gdouble alpha;
+} TestColor;
+
+/* structs read back member for member, both straight from the cache
+ * and after a fresh fetch */
+int
+main(int argc,
+     char **argv)
+{
+    const gchar *property = "/test/structtest/color";
+    GType member_types[] = {
+        BLCONF_TYPE_UINT16, BLCONF_TYPE_UINT16, BLCONF_TYPE_UINT16,
+        G_TYPE_BOOLEAN, G_TYPE_DOUBLE
+    };
+    TestColor color = { 0xffff, 0x8000, 0x0001, TRUE, 0.5 };
+    TestColor empty = { 0, }, read;
+    BlconfChannel *channel;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    blconf_named_struct_register("TestColor", G_N_ELEMENTS(member_types),
+                                 member_types);
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    TEST_OPERATION(blconf_channel_set_named_struct(channel, property,
+                                                   "TestColor", &color));
+
+    read = empty;
+    TEST_OPERATION(blconf_channel_get_named_struct(channel, property,
+                                                   "TestColor", &read));
+    TEST_OPERATION(read.red == color.red && read.green == color.green
+                   && read.blue == color.blue && read.visible == color.visible
+                   && read.alpha == color.alpha);
+
+    read = empty;
+    TEST_OPERATION(blconf_channel_get_struct(channel, property, &read,
+                                             BLCONF_TYPE_UINT16,
+                                             BLCONF_TYPE_UINT16,
+                                             BLCONF_TYPE_UINT16,
+                                             G_TYPE_BOOLEAN, G_TYPE_DOUBLE,
+                                             G_TYPE_INVALID));
+    TEST_OPERATION(read.green == color.green && read.alpha == color.alpha);
+
+    /* the layout has to match */
+    TEST_OPERATION(!blconf_channel_get_struct(channel, property, &read,
+                                              G_TYPE_STRING, G_TYPE_INVALID));
+
+    g_object_unref(G_OBJECT(channel));
+
+    /* a new channel has to ask the daemon */
+    channel = blconf_channel_new_full(TEST_CHANNEL_NAME, NULL,
+                                      BLCONF_CHANNEL_PREFETCH_NONE);
+    read = empty;
+    TEST_OPERATION(blconf_channel_get_named_struct(channel, property,
+                                                   "TestColor", &read));
+    TEST_OPERATION(read.red == color.red && read.blue == color.blue
+                   && read.alpha == color.alpha);
+
+    blconf_channel_reset_property(channel, "/test/structtest", TRUE);
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
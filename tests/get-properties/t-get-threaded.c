@@ -0,0 +1,84 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define N_THREADS  4
+#define N_READS    10000
+
+static gint expected = 0;
+
+static gpointer
+read_thread(gpointer data)
+{
+    BlconfChannel *channel = data;
+    gint i;
+
+    for(i = 0; i < N_READS; ++i) {
+        if(blconf_channel_get_int(channel, test_int_property, -1) != expected)
+            return GINT_TO_POINTER(FALSE);
+    }
+
+    return GINT_TO_POINTER(TRUE);
+}
+
+static gboolean
+read_from_threads(BlconfChannel *channel)
+{
+    GThread *threads[N_THREADS];
+    gboolean ret = TRUE;
+    gint i;
+
+    for(i = 0; i < N_THREADS; ++i)
+        threads[i] = g_thread_new("reader", read_thread, channel);
+    for(i = 0; i < N_THREADS; ++i) {
+        if(!GPOINTER_TO_INT(g_thread_join(threads[i])))
+            ret = FALSE;
+    }
+
+    return ret;
+}
+
+/* cache hits from several threads at once, on either side of a
+ * write */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    expected = test_int;
+    TEST_OPERATION(read_from_threads(channel));
+
+    expected = test_int + 1;
+    TEST_OPERATION(blconf_channel_set_int(channel, test_int_property,
+                                          expected));
+    TEST_OPERATION(read_from_threads(channel));
+
+    TEST_OPERATION(blconf_channel_set_int(channel, test_int_property,
+                                          test_int));
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define INT_ARRAY_PROPERTY    "/test/typedarrays/ints"
+#define MIXED_ARRAY_PROPERTY  "/test/typedarrays/mixed"
+#define N_INTS                (500)
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel, *other;
+    GPtrArray *arr;
+    gint32 *ints;
+    guint32 *uints;
+    gchar **strlist;
+    guint i, n_values;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    arr = g_ptr_array_sized_new(N_INTS);
+    for(i = 0; i < N_INTS; ++i) {
+        GValue *val = g_new0(GValue, 1);
+
+        g_value_init(val, G_TYPE_INT);
+        g_value_set_int(val, (gint)i - N_INTS / 2);
+        g_ptr_array_add(arr, val);
+    }
+    TEST_OPERATION(blconf_channel_set_arrayv(channel, INT_ARRAY_PROPERTY, arr));
+    blconf_array_free(arr);
+
+    /* straight from the cache */
+    ints = blconf_channel_get_int_array(channel, INT_ARRAY_PROPERTY, &n_values);
+    TEST_OPERATION(ints != NULL && n_values == N_INTS);
+    for(i = 0; i < N_INTS; ++i)
+        TEST_OPERATION(ints[i] == (gint32)i - N_INTS / 2);
+    g_free(ints);
+
+    /* and through a property base */
+    other = blconf_channel_new_with_property_base(TEST_CHANNEL_NAME,
+                                                  "/test/typedarrays");
+    ints = blconf_channel_get_int_array(other, "/ints", &n_values);
+    TEST_OPERATION(ints != NULL && n_values == N_INTS);
+    TEST_OPERATION(ints[0] == -N_INTS / 2 && ints[N_INTS - 1] == N_INTS / 2 - 1);
+    g_free(ints);
+
+    /* the old API still sees an array of GValues */
+    arr = blconf_channel_get_arrayv(other, "/ints");
+    TEST_OPERATION(arr != NULL && arr->len == N_INTS);
+    TEST_OPERATION(G_VALUE_TYPE(g_ptr_array_index(arr, 1)) == G_TYPE_INT);
+    TEST_OPERATION(g_value_get_int(g_ptr_array_index(arr, 1)) == 1 - N_INTS / 2);
+    blconf_array_free(arr);
+    g_object_unref(G_OBJECT(other));
+
+    /* the wrong element type is no array at all */
+    uints = blconf_channel_get_uint_array(channel, INT_ARRAY_PROPERTY, &n_values);
+    TEST_OPERATION(uints == NULL && n_values == 0);
+    strlist = blconf_channel_get_string_list(channel, INT_ARRAY_PROPERTY);
+    TEST_OPERATION(strlist == NULL);
+
+    /* nor is one that mixes types */
+    TEST_OPERATION(blconf_channel_set_array(channel, MIXED_ARRAY_PROPERTY,
+                                            G_TYPE_STRING, test_string,
+                                            G_TYPE_INT, test_int,
+                                            G_TYPE_INVALID));
+    strlist = blconf_channel_get_string_list(channel, MIXED_ARRAY_PROPERTY);
+    TEST_OPERATION(strlist == NULL);
+    ints = blconf_channel_get_int_array(channel, MIXED_ARRAY_PROPERTY, NULL);
+    TEST_OPERATION(ints == NULL);
+
+    blconf_channel_reset_property(channel, "/test/typedarrays", TRUE);
+
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define MISSING_CHANNEL_NAME  "test-missing-channel"
+
+/* misses are remembered, so everything here past the first probe is
+ * answered by the cache; it must still notice properties that appear */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *reader, *writer;
+    GTimer *timer;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    writer = blconf_channel_new(MISSING_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_int(writer, "/missing/present", 1));
+
+    reader = blconf_channel_new(MISSING_CHANNEL_NAME);
+    TEST_OPERATION(!blconf_channel_has_property(reader, "/missing/absent"));
+    TEST_OPERATION(!blconf_channel_has_property(reader, "/missing/absent"));
+    TEST_OPERATION(blconf_channel_get_int(reader, "/missing/absent", 7) == 7);
+
+    /* our own write */
+    TEST_OPERATION(blconf_channel_set_int(reader, "/missing/absent", 2));
+    TEST_OPERATION(blconf_channel_get_int(reader, "/missing/absent", 7) == 2);
+    blconf_channel_reset_property(reader, "/missing/absent", FALSE);
+    TEST_OPERATION(!blconf_channel_has_property(reader, "/missing/absent"));
+
+    /* somebody else's, seen once the signal arrives */
+    TEST_OPERATION(!blconf_channel_has_property(reader, "/missing/later"));
+    TEST_OPERATION(blconf_channel_set_int(writer, "/missing/later", 3));
+    timer = g_timer_new();
+    while(!blconf_channel_has_property(reader, "/missing/later")
+          && g_timer_elapsed(timer, NULL) < WAIT_TIMEOUT)
+    {
+        g_main_context_iteration(NULL, FALSE);
+    }
+    g_timer_destroy(timer);
+    TEST_OPERATION(blconf_channel_get_int(reader, "/missing/later", 7) == 3);
+
+    blconf_channel_reset_property(writer, "/", TRUE);
+    g_object_unref(G_OBJECT(writer));
+    g_object_unref(G_OBJECT(reader));
+
+    blconf_tests_end();
+
+    return 0;
+}
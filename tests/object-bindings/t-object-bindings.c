@@ -199,6 +199,49 @@ main(int argc,
         g_object_unref(G_OBJECT(object));
     }
 
+    {
+        GObject *objects[2];
+        BlconfGPropertyBinding entries[3];
+        gulong ids[3];
+
+        TEST_OPERATION(blconf_channel_set_bool(channel, "/bindings/many1", TRUE));
+        TEST_OPERATION(blconf_channel_set_bool(channel, "/bindings/many2", TRUE));
+
+        objects[0] = g_object_new(test_object_get_type(), NULL);
+        objects[1] = g_object_new(test_object_get_type(), NULL);
+
+        entries[0].blconf_property = "/bindings/many1";
+        entries[0].blconf_property_type = G_TYPE_BOOLEAN;
+        entries[0].object = objects[0];
+        entries[0].object_property = "test";
+        entries[1] = entries[0];
+        entries[1].blconf_property = "/bindings/many2";
+        entries[1].object = objects[1];
+        entries[2] = entries[0];
+        entries[2].object_property = "no-such-property";
+
+        /* both objects pick up the current values, the bogus entry is
+         * skipped */
+        TEST_OPERATION(blconf_g_property_bind_many(channel, entries,
+                                                   G_N_ELEMENTS(entries),
+                                                   ids) == 2);
+        TEST_OPERATION(ids[0] && ids[1] && !ids[2]);
+        TEST_OPERATION(((TestObject *)objects[0])->test
+                       && ((TestObject *)objects[1])->test);
+
+        /* and follow changes like any other binding */
+        blconf_channel_set_bool(channel, "/bindings/many2", FALSE);
+        TEST_OPERATION(((TestObject *)objects[0])->test
+                       && !((TestObject *)objects[1])->test);
+
+        blconf_g_property_unbind(ids[1]);
+        blconf_channel_set_bool(channel, "/bindings/many2", TRUE);
+        TEST_OPERATION(!((TestObject *)objects[1])->test);
+
+        g_object_unref(objects[0]);
+        g_object_unref(objects[1]);
+    }
+
     g_object_unref(G_OBJECT(channel));
 
     blconf_tests_end();
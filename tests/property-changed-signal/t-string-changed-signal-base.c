@@ -0,0 +1,157 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#include <string.h>
+
+#define BASE_CHANNEL_NAME  "test-base-channel"
+#define OTHER_PROPERTY     "/test/other/string"
+
+typedef struct
+{
+    GMainLoop *mloop;
+    gboolean got_signal;
+    gboolean got_other;
+} SignalTestData;
+
+static void
+test_signal_changed(BlconfChannel *channel,
+                    const gchar *property,
+                    const GValue *value,
+                    gpointer user_data)
+{
+    SignalTestData *std = user_data;
+
+    if(!strcmp(property, "/string"))
+        std->got_signal = TRUE;
+    else
+        std->got_other = TRUE;
+    g_main_loop_quit(std->mloop);
+}
+
+static gboolean
+test_watchdog(gpointer data)
+{
+    SignalTestData *std = data;
+    g_main_loop_quit(std->mloop);
+    return FALSE;
+}
+
+/* from a connection of its own, so the change comes back to us from
+ * the daemon rather than from our own cache */
+static gboolean
+call_sync(GDBusConnection *dbus_conn,
+          const gchar *method,
+          GVariant *parameters)
+{
+    GVariant *ret = g_dbus_connection_call_sync(dbus_conn,
+                                                "org.blade.Blconf",
+                                                "/org/blade/Blconf",
+                                                "org.blade.Blconf",
+                                                method, parameters, NULL,
+                                                G_DBUS_CALL_FLAGS_NONE, -1,
+                                                NULL, NULL);
+
+    if(!ret)
+        return FALSE;
+    g_variant_unref(ret);
+
+    return TRUE;
+}
+
+static guint64
+get_stat(BlconfChannel *channel,
+         const gchar *name)
+{
+    GHashTable *stats = blconf_channel_get_cache_stats(channel);
+    GValue *value = g_hash_table_lookup(stats, name);
+    guint64 ret = G_MAXUINT64;
+
+    if(value && G_VALUE_HOLDS_UINT64(value))
+        ret = g_value_get_uint64(value);
+    g_hash_table_destroy(stats);
+
+    return ret;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GDBusConnection *dbus_conn;
+    SignalTestData std = { NULL, FALSE, FALSE };
+    gchar *address, *str;
+
+    std.mloop = g_main_loop_new(NULL, FALSE);
+
+    if(!blconf_tests_start())
+        return 2;
+
+    address = g_dbus_address_get_for_bus_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    TEST_OPERATION(address != NULL);
+    dbus_conn = g_dbus_connection_new_for_address_sync(address,
+                                                       G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                                                       | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                       NULL, NULL, NULL);
+    TEST_OPERATION(dbus_conn != NULL);
+    g_free(address);
+
+    channel = blconf_channel_new_with_property_base(BASE_CHANNEL_NAME,
+                                                    "/test/stringtest");
+    g_signal_connect(G_OBJECT(channel), "property-changed",
+                     G_CALLBACK(test_signal_changed), &std);
+
+    /* a new value each run, so both really change */
+    str = g_strdup_printf("%s-%" G_GINT64_FORMAT, test_string,
+                          g_get_real_time());
+
+    /* outside the property base: never sent to us at all.  the
+     * channel's prefetch went out after its subscription, so that's
+     * in place by now */
+    TEST_OPERATION(call_sync(dbus_conn, "SetProperty",
+                             g_variant_new("(ssv)", BASE_CHANNEL_NAME,
+                                           OTHER_PROPERTY,
+                                           g_variant_new_string(str))));
+    TEST_OPERATION(call_sync(dbus_conn, "SetProperty",
+                             g_variant_new("(ssv)", BASE_CHANNEL_NAME,
+                                           test_string_property,
+                                           g_variant_new_string(str))));
+
+    g_timeout_add(1500, test_watchdog, &std);
+    g_main_loop_run(std.mloop);
+
+    TEST_OPERATION(std.got_signal);
+    TEST_OPERATION(!std.got_other);
+    /* the changes went out in order, so the first one would have
+     * arrived by now */
+    TEST_OPERATION(get_stat(channel, "signals-received") == 1);
+
+    TEST_OPERATION(call_sync(dbus_conn, "ResetProperty",
+                             g_variant_new("(ssb)", BASE_CHANNEL_NAME, "/",
+                                           TRUE)));
+
+    g_free(str);
+    g_object_unref(dbus_conn);
+    g_main_loop_unref(std.mloop);
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
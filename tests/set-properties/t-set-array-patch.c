@@ -0,0 +1,127 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define PATCH_PROPERTY  "/test/patch/array"
+
+static gboolean
+check_array(BlconfChannel *channel,
+            const gint *expected,
+            guint n_expected)
+{
+    GPtrArray *arr = blconf_channel_get_arrayv(channel, PATCH_PROPERTY);
+    gboolean ret;
+    guint i;
+
+    if(!arr)
+        return FALSE;
+
+    ret = arr->len == n_expected;
+    for(i = 0; ret && i < arr->len; ++i) {
+        GValue *val = g_ptr_array_index(arr, i);
+        ret = G_VALUE_HOLDS_INT(val) && g_value_get_int(val) == expected[i];
+    }
+    blconf_array_free(arr);
+
+    return ret;
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GDBusConnection *dbus_conn;
+    GValue val = { 0, };
+    GVariant *ret;
+    GError *error = NULL;
+    const gint after_insert[] = { 1, 5, 2, 3, 4 };
+    const gint after_remove[] = { 5, 2, 3, 4 };
+    const gint after_replace[] = { 5, 2, 7, 4 };
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+
+    TEST_OPERATION(blconf_channel_set_array(channel, PATCH_PROPERTY,
+                                            G_TYPE_INT, 1, G_TYPE_INT, 2,
+                                            G_TYPE_INT, 3, G_TYPE_INT, 4,
+                                            G_TYPE_INVALID));
+
+    g_value_init(&val, G_TYPE_INT);
+
+    g_value_set_int(&val, 5);
+    TEST_OPERATION(blconf_channel_array_insert(channel, PATCH_PROPERTY, 1,
+                                               &val));
+    TEST_OPERATION(check_array(channel, after_insert,
+                               G_N_ELEMENTS(after_insert)));
+
+    TEST_OPERATION(blconf_channel_array_remove(channel, PATCH_PROPERTY, 0));
+    TEST_OPERATION(check_array(channel, after_remove,
+                               G_N_ELEMENTS(after_remove)));
+
+    g_value_set_int(&val, 7);
+    TEST_OPERATION(blconf_channel_array_replace(channel, PATCH_PROPERTY, 2,
+                                                &val));
+    TEST_OPERATION(check_array(channel, after_replace,
+                               G_N_ELEMENTS(after_replace)));
+
+    /* past the end doesn't fit, and changes nothing */
+    TEST_OPERATION(!blconf_channel_array_remove(channel, PATCH_PROPERTY, 4));
+    TEST_OPERATION(check_array(channel, after_replace,
+                               G_N_ELEMENTS(after_replace)));
+
+    g_value_unset(&val);
+
+    /* a change made against a generation the array isn't at is refused */
+    dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    TEST_OPERATION(dbus_conn != NULL);
+    ret = g_dbus_connection_call_sync(dbus_conn,
+                                      "org.blade.Blconf",
+                                      "/org/blade/Blconf",
+                                      "org.blade.Blconf",
+                                      "PatchArray",
+                                      g_variant_new_parsed("(%s, %s, %t, [(%u, %u, @av [])])",
+                                                           TEST_CHANNEL_NAME,
+                                                           PATCH_PROPERTY,
+                                                           (guint64)1,
+                                                           (guint32)0,
+                                                           (guint32)1),
+                                      G_VARIANT_TYPE("(t)"),
+                                      G_DBUS_CALL_FLAGS_NONE, -1,
+                                      NULL, &error);
+    TEST_OPERATION(ret == NULL);
+    TEST_OPERATION(g_error_matches(error, BLCONF_ERROR,
+                                   BLCONF_ERROR_CONFLICT));
+    g_error_free(error);
+    g_object_unref(dbus_conn);
+
+    TEST_OPERATION(check_array(channel, after_replace,
+                               G_N_ELEMENTS(after_replace)));
+
+    blconf_channel_reset_property(channel, "/test/patch", TRUE);
+
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
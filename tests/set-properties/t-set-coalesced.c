@@ -0,0 +1,110 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define COALESCE_CHANNEL_NAME  "test-coalesce-channel"
+
+static gboolean
+quit_loop(gpointer data)
+{
+    g_main_loop_quit(data);
+    return FALSE;
+}
+
+/* asks the daemon itself, bypassing the process' cache */
+static gint
+stored_int(const gchar *property)
+{
+    GDBusConnection *dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    GVariant *reply, *variant;
+    gint value = -1;
+
+    reply = g_dbus_connection_call_sync(dbus_conn, "org.blade.Blconf",
+                                        "/org/blade/Blconf",
+                                        "org.blade.Blconf", "GetProperty",
+                                        g_variant_new("(ss)",
+                                                      COALESCE_CHANNEL_NAME,
+                                                      property),
+                                        G_VARIANT_TYPE("(v)"),
+                                        G_DBUS_CALL_FLAGS_NONE, -1,
+                                        NULL, NULL);
+    if(reply) {
+        g_variant_get(reply, "(v)", &variant);
+        if(g_variant_is_of_type(variant, G_VARIANT_TYPE_INT32))
+            value = g_variant_get_int32(variant);
+        g_variant_unref(variant);
+        g_variant_unref(reply);
+    }
+    g_object_unref(dbus_conn);
+
+    return value;
+}
+
+static void
+wait_a_bit(void)
+{
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+
+    g_timeout_add(500, quit_loop, loop);
+    g_main_loop_run(loop);
+    g_main_loop_unref(loop);
+}
+
+/* with a write interval, only the last of many writes goes out, but
+ * the channel itself has each one right away */
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    gint i;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    channel = blconf_channel_new(COALESCE_CHANNEL_NAME);
+    TEST_OPERATION(blconf_channel_set_int(channel, "/x", 0));
+    wait_a_bit();
+
+    blconf_channel_set_write_interval(channel, 10000);
+    for(i = 1; i <= 100; ++i) {
+        TEST_OPERATION(blconf_channel_set_int(channel, "/x", i));
+        TEST_OPERATION(blconf_channel_get_int(channel, "/x", -1) == i);
+    }
+    TEST_OPERATION(stored_int("/x") == 0);
+
+    blconf_channel_flush(channel);
+    wait_a_bit();
+    TEST_OPERATION(stored_int("/x") == 100);
+
+    /* the timer sends them too */
+    blconf_channel_set_write_interval(channel, 100);
+    TEST_OPERATION(blconf_channel_set_int(channel, "/x", 101));
+    TEST_OPERATION(blconf_channel_set_int(channel, "/y", 1));
+    wait_a_bit();
+    TEST_OPERATION(stored_int("/x") == 101);
+    TEST_OPERATION(stored_int("/y") == 1);
+
+    blconf_channel_set_write_interval(channel, 0);
+    blconf_channel_reset_property(channel, "/", TRUE);
+    g_object_unref(G_OBJECT(channel));
+
+    blconf_tests_end();
+
+    return 0;
+}
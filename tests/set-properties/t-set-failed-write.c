@@ -0,0 +1,167 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "tests-common.h"
+
+#define FAILED_WRITE_CHANNEL_NAME  "test-failed-write-channel"
+
+/* the daemon's WRITE_TIMEOUT, plus time for the evict timer, which
+ * runs every second with a one second cache timeout */
+#define FAILED_WRITE_WAIT  (5 + 4)
+
+static gchar *
+get_owner(GDBusConnection *dbus_conn)
+{
+    GVariant *ret;
+    gchar *owner = NULL;
+
+    ret = g_dbus_connection_call_sync(dbus_conn,
+                                      "org.freedesktop.DBus",
+                                      "/org/freedesktop/DBus",
+                                      "org.freedesktop.DBus",
+                                      "GetNameOwner",
+                                      g_variant_new("(s)", "org.blade.Blconf"),
+                                      G_VARIANT_TYPE("(s)"),
+                                      G_DBUS_CALL_FLAGS_NONE, -1,
+                                      NULL, NULL);
+    if(ret) {
+        g_variant_get(ret, "(s)", &owner);
+        g_variant_unref(ret);
+    }
+
+    return owner;
+}
+
+static GVariant *
+call_sync(GDBusConnection *dbus_conn,
+          const gchar *method,
+          GVariant *parameters,
+          const GVariantType *reply_type)
+{
+    return g_dbus_connection_call_sync(dbus_conn,
+                                       "org.blade.Blconf",
+                                       "/org/blade/Blconf",
+                                       "org.blade.Blconf",
+                                       method, parameters, reply_type,
+                                       G_DBUS_CALL_FLAGS_NONE, -1,
+                                       NULL, NULL);
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    GDBusConnection *dbus_conn;
+    GVariant *ret, *value;
+    gchar *argv_replace[3] = { NULL, "--replace", NULL };
+    gchar **envp;
+    gchar *old_owner, *new_owner = NULL, *save_dir;
+    GTimeVal start, now;
+    gboolean survived = FALSE;
+
+    /* needs a daemon binary to start, and a user the permissions
+     * apply to */
+    if(!g_getenv("BLCONFD") || !g_getenv("XDG_CONFIG_HOME") || !geteuid())
+        return 77;
+
+    save_dir = g_build_filename(g_getenv("XDG_CONFIG_HOME"), "xfce4",
+                                "blconf", "xfce-perchannel-xml", NULL);
+
+    if(!blconf_tests_start())
+        return 1;
+
+    if(!g_file_test(save_dir, G_FILE_TEST_IS_DIR)) {
+        g_free(save_dir);
+        blconf_tests_end();
+        return 77;
+    }
+
+    dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    TEST_OPERATION(dbus_conn != NULL);
+    old_owner = get_owner(dbus_conn);
+    TEST_OPERATION(old_owner != NULL);
+
+    /* a daemon that evicts idle channels after a second */
+    envp = g_get_environ();
+    envp = g_environ_setenv(envp, "BLCONFD_CACHE_TIMEOUT", "1", TRUE);
+    argv_replace[0] = (gchar *)g_getenv("BLCONFD");
+    TEST_OPERATION(g_spawn_async(NULL, argv_replace, envp, 0, NULL, NULL,
+                                 NULL, NULL));
+    g_strfreev(envp);
+
+    g_get_current_time(&start);
+    do {
+        g_free(new_owner);
+        new_owner = get_owner(dbus_conn);
+        TEST_OPERATION(new_owner != NULL);
+        g_get_current_time(&now);
+        TEST_OPERATION(now.tv_sec - start.tv_sec <= WAIT_TIMEOUT);
+    } while(!g_strcmp0(old_owner, new_owner));
+
+    /* the write fails, and the channel has to stay around until one
+     * succeeds, however long nobody touches it */
+    TEST_OPERATION(chmod(save_dir, 0555) == 0);
+
+    ret = call_sync(dbus_conn, "SetProperty",
+                    g_variant_new("(ssv)", FAILED_WRITE_CHANNEL_NAME,
+                                  test_string_property,
+                                  g_variant_new_string(test_string)),
+                    NULL);
+    if(ret) {
+        g_variant_unref(ret);
+
+        g_usleep(FAILED_WRITE_WAIT * G_USEC_PER_SEC);
+
+        ret = call_sync(dbus_conn, "GetProperty",
+                        g_variant_new("(ss)", FAILED_WRITE_CHANNEL_NAME,
+                                      test_string_property),
+                        G_VARIANT_TYPE("(v)"));
+        if(ret) {
+            g_variant_get(ret, "(v)", &value);
+            survived = (g_variant_is_of_type(value, G_VARIANT_TYPE_STRING)
+                        && !g_strcmp0(g_variant_get_string(value, NULL),
+                                      test_string));
+            g_variant_unref(value);
+            g_variant_unref(ret);
+        }
+    }
+
+    /* before checking, so a failure doesn't break the tests after us */
+    TEST_OPERATION(chmod(save_dir, 0755) == 0);
+    TEST_OPERATION(survived);
+
+    ret = call_sync(dbus_conn, "ResetProperty",
+                    g_variant_new("(ssb)", FAILED_WRITE_CHANNEL_NAME, "/",
+                                  TRUE),
+                    NULL);
+    TEST_OPERATION(ret != NULL);
+    g_variant_unref(ret);
+
+    g_free(save_dir);
+    g_free(old_owner);
+    g_free(new_owner);
+    g_object_unref(dbus_conn);
+
+    blconf_tests_end();
+
+    return 0;
+}
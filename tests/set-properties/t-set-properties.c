@@ -0,0 +1,77 @@
+/*
+ *  blconf
+ *
+ *  Copyright (c) 2007 Brian Tarricone <bjt23@cornell.edu>
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#endif
+
+int
+main(int argc,
+     char **argv)
+{
+    BlconfChannel *channel;
+    GHashTable *props, *values;
+    GValue *val;
+    const gchar *names[] = {
+        "/test/batch/string",
+        "/test/batch/int",
+        "/test/batch/nonexistent",
+        NULL
+    };
+    
+    if(!blconf_tests_start())
+        return 1;
+    
+    channel = blconf_channel_new(TEST_CHANNEL_NAME);
+    
+    props = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                  NULL, (GDestroyNotify)g_free);
+    val = g_new0(GValue, 1);
+    g_value_init(val, G_TYPE_STRING);
+    g_value_set_static_string(val, test_string);
+    g_hash_table_insert(props, (gpointer)names[0], val);
+    val = g_new0(GValue, 1);
+    g_value_init(val, G_TYPE_INT);
+    g_value_set_int(val, test_int);
+    g_hash_table_insert(props, (gpointer)names[1], val);
+    
+    TEST_OPERATION(blconf_channel_set_properties(channel, props));
+    g_hash_table_destroy(props);
+    
+    values = blconf_channel_get_many(channel, names);
+    TEST_OPERATION(values != NULL);
+    TEST_OPERATION(g_hash_table_size(values) == 2);
+    val = g_hash_table_lookup(values, names[0]);
+    TEST_OPERATION(val && G_VALUE_HOLDS_STRING(val)
+                   && !strcmp(g_value_get_string(val), test_string));
+    val = g_hash_table_lookup(values, names[1]);
+    TEST_OPERATION(val && G_VALUE_HOLDS_INT(val)
+                   && g_value_get_int(val) == test_int);
+    g_hash_table_destroy(values);
+    
+    blconf_channel_reset_property(channel, "/test/batch", TRUE);
+    
+    g_object_unref(G_OBJECT(channel));
+    
+    blconf_tests_end();
+    
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ *  blconf
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; version 2 of the License ONLY.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Library General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "tests-common.h"
+
+#define SUPERSEDED_CHANNEL_NAME  "test-superseded-channel"
+
+/* more than the daemon lets a client write in a burst, so the calls
+ * after these wait in its throttle */
+#define N_FILLERS  1500
+
+typedef struct
+{
+    gboolean done;
+    GError *error;
+} Reply;
+
+static void
+set_done(GObject *source,
+         GAsyncResult *res,
+         gpointer user_data)
+{
+    Reply *reply = user_data;
+    GVariant *ret;
+
+    ret = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res,
+                                        &reply->error);
+    if(ret)
+        g_variant_unref(ret);
+    reply->done = TRUE;
+}
+
+static void
+set_async(GDBusConnection *dbus_conn,
+          const gchar *property,
+          GVariant *value,
+          Reply *reply)
+{
+    g_dbus_connection_call(dbus_conn,
+                           "org.blade.Blconf",
+                           "/org/blade/Blconf",
+                           "org.blade.Blconf",
+                           "SetProperty",
+                           g_variant_new("(ssv)", SUPERSEDED_CHANNEL_NAME,
+                                         property, value),
+                           NULL, G_DBUS_CALL_FLAGS_NONE, -1, NULL,
+                           reply ? set_done : NULL, reply);
+}
+
+int
+main(int argc,
+     char **argv)
+{
+    GDBusConnection *dbus_conn;
+    GVariant *ret;
+    Reply valid = { FALSE, NULL }, invalid = { FALSE, NULL };
+    GTimeVal start, now;
+    gint i;
+
+    if(!blconf_tests_start())
+        return 1;
+
+    dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, NULL);
+    TEST_OPERATION(dbus_conn != NULL);
+
+    for(i = 0; i < N_FILLERS; ++i) {
+        gchar *property = g_strdup_printf("/filler/p%d", i);
+
+        set_async(dbus_conn, property, g_variant_new_int32(i), NULL);
+        g_free(property);
+    }
+
+    /* the second replaces the first while both wait; it can't be
+     * stored, and the first has to hear about that */
+    set_async(dbus_conn, test_int_property, g_variant_new_int32(1), &valid);
+    set_async(dbus_conn, test_int_property, g_variant_new("(ii)", 1, 2),
+              &invalid);
+
+    g_get_current_time(&start);
+    while(!valid.done || !invalid.done) {
+        g_main_context_iteration(NULL, FALSE);
+        g_get_current_time(&now);
+        TEST_OPERATION(now.tv_sec - start.tv_sec <= WAIT_TIMEOUT);
+    }
+
+    TEST_OPERATION(invalid.error != NULL);
+    TEST_OPERATION(valid.error != NULL);
+    TEST_OPERATION(!g_strcmp0(valid.error->message, invalid.error->message));
+    g_error_free(valid.error);
+    g_error_free(invalid.error);
+
+    ret = g_dbus_connection_call_sync(dbus_conn,
+                                      "org.blade.Blconf",
+                                      "/org/blade/Blconf",
+                                      "org.blade.Blconf",
+                                      "ResetProperty",
+                                      g_variant_new("(ssb)",
+                                                    SUPERSEDED_CHANNEL_NAME,
+                                                    "/", TRUE),
+                                      NULL, G_DBUS_CALL_FLAGS_NONE, -1,
+                                      NULL, NULL);
+    TEST_OPERATION(ret != NULL);
+    g_variant_unref(ret);
+
+    g_object_unref(dbus_conn);
+
+    blconf_tests_end();
+
+    return 0;
+}
@@ -41,7 +41,7 @@
 #endif
 
 #include <glib.h>
-#include <dbus/dbus.h>
+#include <gio/gio.h>
 #include <blconf/blconf.h>
 
 #define TEST_CHANNEL_NAME  "test-channel"
@@ -76,41 +76,42 @@ static void blconf_tests_end();
 static gboolean
 blconf_tests_start(void)
 {
-    DBusConnection *dbus_conn;
-    DBusMessage *msg, *ret;
-    DBusError derror;
+    GDBusConnection *dbus_conn;
+    GVariant *ret;
     GTimeVal start, now;
     GError *error = NULL;
 
+#if !GLIB_CHECK_VERSION(2,36,0)
+    g_type_init();
+#endif
+
     /* wait until blconfd finishes starting */
-    dbus_error_init(&derror);
-    dbus_conn = dbus_bus_get(DBUS_BUS_SESSION, NULL);
+    dbus_conn = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
     if(!dbus_conn) {
-        g_critical("Failed to connect to D-Bus: %s", derror.message);
-        dbus_error_free(&derror);
+        g_critical("Failed to connect to D-Bus: %s", error->message);
+        g_error_free(error);
         blconf_tests_end();
         return FALSE;
     }
-    msg = dbus_message_new_method_call("org.blade.Blconf",
-                                      "/org/blade/Blconf",
-                                      "org.freedesktop.DBus.Peer",
-                                      "Ping");
     g_get_current_time(&start);
-    while(!(ret = dbus_connection_send_with_reply_and_block(dbus_conn,
-                                                            msg, 0, NULL)))
+    while(!(ret = g_dbus_connection_call_sync(dbus_conn,
+                                              "org.blade.Blconf",
+                                              "/org/blade/Blconf",
+                                              "org.freedesktop.DBus.Peer",
+                                              "Ping", NULL, NULL,
+                                              G_DBUS_CALL_FLAGS_NONE, -1,
+                                              NULL, NULL)))
     {
         g_get_current_time(&now);
         if(now.tv_sec - start.tv_sec > WAIT_TIMEOUT) {
             g_critical("blconfd failed to start after %d seconds", WAIT_TIMEOUT);
-            dbus_message_unref(msg);
-            dbus_connection_unref(dbus_conn);
+            g_object_unref(dbus_conn);
             blconf_tests_end();
             return FALSE;
         }
     }
-    dbus_message_unref(msg);
-    dbus_message_unref(ret);
-    dbus_connection_unref(dbus_conn);
+    g_variant_unref(ret);
+    g_object_unref(dbus_conn);
 
     if(!blconf_init(&error)) {
         g_critical("Failed to init libblconf: %s", error->message);